@@ -95,7 +95,7 @@ void EventContext::Cleanup()
 			//           select_removeevent(fFileDesc);//The eventqueue / select shim requires this
 
 #if defined(__linux__) && !defined(EASY_DEVICE)
-			deleteEpollEvent(fFileDesc);
+			fEventThread->fReactor.DeleteEvent(fFileDesc);
 #else
 			select_removeevent(fFileDesc);//The eventqueue / select shim requires this
 #endif           
@@ -147,6 +147,8 @@ void EventContext::SnarfEventContext(EventContext &fromContext)
 
 	fromContext.fFileDesc = kInvalidFileDesc;
 
+	// the fd stays registered with the reactor of the context we take it from
+	fEventThread = fromContext.fEventThread;
 	fWatchEventCalled = fromContext.fWatchEventCalled;
 	fUniqueID = fromContext.fUniqueID;
 	fUniqueIDStr.Set((char*)&fUniqueID, sizeof(fUniqueID)),
@@ -176,7 +178,7 @@ void EventContext::RequestEvent(int theMask)
 		if (modwatch(&fEventReq, theMask) != 0)
 #else
 #if defined(__linux__) && !defined(EASY_DEVICE)
-		if (addEpollEvent(&fEventReq, theMask) != 0)
+		if (fEventThread->fReactor.AddEvent(&fEventReq, theMask) != 0)
 #else
 		if (select_modwatch(&fEventReq, theMask) != 0)
 #endif
@@ -185,6 +187,11 @@ void EventContext::RequestEvent(int theMask)
 	}
 	else
 	{
+		//bind this context to an event thread, if the creator left the choice to us
+		if (fEventThread == NULL)
+			fEventThread = EventThreadPool::PickThread(fFileDesc, fTask);
+		Assert(fEventThread != NULL);
+
 		//allocate a Unique ID for this socket, and add it to the ref table
 
 		//johnson find the bug
@@ -249,7 +256,7 @@ void EventContext::RequestEvent(int theMask)
 		if (watchevent(&fEventReq, theMask) != 0)
 #else
 #if defined(__linux__) && !defined(EASY_DEVICE)
-		if (addEpollEvent(&fEventReq, theMask) != 0)
+		if (fEventThread->fReactor.AddEvent(&fEventReq, theMask) != 0)
 #else
 		if (select_modwatch(&fEventReq, theMask) != 0)
 #endif
@@ -260,8 +267,54 @@ void EventContext::RequestEvent(int theMask)
 	}
 }
 
+void EventThread::DispatchEvent(struct eventreq* inEvent)
+{
+	//ok, there's data waiting on this socket. Send a wakeup.
+	if (inEvent->er_data != NULL)
+	{
+		//The cookie in this event is an ObjectID. Resolve that objectID into
+		//a pointer.
+		StrPtrLen idStr((char*)&inEvent->er_data, sizeof(PointerSizedInt));
+		OSRef* ref = fRefTable.Resolve(&idStr);
+		if (ref != NULL)
+		{
+			EventContext* theContext = (EventContext*)ref->GetObject();
+#if DEBUG
+			theContext->fModwatched = false;
+#endif
+			theContext->ProcessEvent(inEvent->er_eventbits);
+			fRefTable.Release(ref);
+		}
+	}
+}
+
 void EventThread::Entry()
 {
+#if defined(__linux__) && !defined(EASY_DEVICE)
+
+	//
+	// Dispatch the whole epoll_wait result in one pass, then yield once.
+	struct eventreq* theEvents = new struct eventreq[EpollReactor::kMaxEventsPerWait];
+	::memset(theEvents, '\0', sizeof(struct eventreq) * EpollReactor::kMaxEventsPerWait);
+
+	while (true)
+	{
+		int theNumEvents = fReactor.WaitEvents(theEvents, EpollReactor::kMaxEventsPerWait, kWaitTimeoutInMilSecs);
+		if (theNumEvents < 0)
+		{
+			int theErrno = OSThread::GetErrno();
+			AssertV(theErrno == EINTR, theErrno);
+			continue;
+		}
+
+		for (int x = 0; x < theNumEvents; x++)
+			this->DispatchEvent(&theEvents[x]);
+
+		this->ThreadYield();
+	}
+
+#else
+
 	struct eventreq theCurrentEvent;
 	::memset(&theCurrentEvent, '\0', sizeof(theCurrentEvent));
 
@@ -273,12 +326,7 @@ void EventThread::Entry()
 #if MACOSXEVENTQUEUE
 			int theReturnValue = waitevent(&theCurrentEvent, NULL);
 #else
-
-#if defined(__linux__) && !defined(EASY_DEVICE)
-			int theReturnValue = epoll_waitevent(&theCurrentEvent, NULL);
-#else
 			int theReturnValue = select_waitevent(&theCurrentEvent, NULL);
-#endif
 #endif  
 			//Sort of a hack. In the POSIX version of the server, waitevent can return
 			//an actual POSIX errorcode.
@@ -290,34 +338,13 @@ void EventThread::Entry()
 
 		AssertV(theErrno == 0, theErrno);
 
-		//ok, there's data waiting on this socket. Send a wakeup.
-		if (theCurrentEvent.er_data != NULL)
-		{
-			//The cookie in this event is an ObjectID. Resolve that objectID into
-			//a pointer.
-			//StrPtrLen idStr((char*)&theCurrentEvent.er_data, sizeof(theCurrentEvent.er_data));
-			StrPtrLen idStr((char*)&theCurrentEvent.er_data, sizeof(PointerSizedInt));
-			OSRef* ref = fRefTable.Resolve(&idStr);
-			if (ref != NULL)
-			{
-				EventContext* theContext = (EventContext*)ref->GetObject();
-#if DEBUG
-				theContext->fModwatched = false;
-#endif
-				theContext->ProcessEvent(theCurrentEvent.er_eventbits);
-				fRefTable.Release(ref);
-			}
-		}
+		this->DispatchEvent(&theCurrentEvent);
 
 #if EVENT_CONTEXT_DEBUG
 		SInt64  yieldStart = OS::Milliseconds();
 #endif
 
-#if 0//defined(__linux__) && !defined(EASY_DEVICE)
-
-#else
 		this->ThreadYield();
-#endif
 
 #if EVENT_CONTEXT_DEBUG
 		SInt64  yieldDur = OS::Milliseconds() - yieldStart;
@@ -332,4 +359,64 @@ void EventThread::Entry()
 			numZeroYields++;
 #endif
 	}
+
+#endif
+}
+
+EventThread**   EventThreadPool::sEventThreadArray = NULL;
+UInt32          EventThreadPool::sNumEventThreads = 0;
+
+void EventThreadPool::AddThreads(UInt32 numToAdd)
+{
+	Assert(sEventThreadArray == NULL);
+
+#if !defined(__linux__) || defined(EASY_DEVICE)
+	numToAdd = 1; // the select() shim only supports one waiter
+#endif
+	if (numToAdd == 0)
+		numToAdd = 1;
+
+	sEventThreadArray = new EventThread*[numToAdd];
+	for (UInt32 x = 0; x < numToAdd; x++)
+	{
+		sEventThreadArray[x] = new EventThread();
+		int err = sEventThreadArray[x]->Initialize();
+		AssertV(err == 0, OSThread::GetErrno());
+	}
+	sNumEventThreads = numToAdd;
+}
+
+void EventThreadPool::StartThreads()
+{
+	for (UInt32 x = 0; x < sNumEventThreads; x++)
+		sEventThreadArray[x]->Start();
+}
+
+EventThread* EventThreadPool::GetThread(UInt32 index)
+{
+	Assert(sEventThreadArray != NULL);
+	if (index >= sNumEventThreads)
+		return NULL;
+
+	return sEventThreadArray[index];
+}
+
+EventThread* EventThreadPool::PickThread(int inFileDesc, Task* inTask)
+{
+	Assert(sNumEventThreads > 0);
+
+	UInt32 theIndex = (inFileDesc > 0) ? (UInt32)inFileDesc : 0;
+	if ((inTask != NULL) && (inTask->GetDefaultThread() != NULL))
+	{
+		for (UInt32 x = 0; x < TaskThreadPool::GetNumThreads(); x++)
+		{
+			if (TaskThreadPool::GetThread(x) == inTask->GetDefaultThread())
+			{
+				theIndex = x;
+				break;
+			}
+		}
+	}
+
+	return sEventThreadArray[theIndex % sNumEventThreads];
 }
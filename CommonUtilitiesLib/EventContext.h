@@ -63,8 +63,10 @@ public:
 
 	//
 	// Constructor. Pass in the EventThread you would like to receive
-	// events for this context, and the fd that this context applies to
-	EventContext(int inFileDesc, EventThread* inThread);
+	// events for this context, and the fd that this context applies to.
+	// Pass NULL to have EventThreadPool pick the thread (by the owning
+	// TaskThread of the task, else by fd) the first time RequestEvent is called.
+	EventContext(int inFileDesc, EventThread* inThread = NULL);
 	virtual ~EventContext() { if (fAutoCleanup) this->Cleanup(); }
 
 	//
@@ -168,12 +170,56 @@ public:
 	EventThread() : OSThread() {}
 	virtual ~EventThread() {}
 
+#if defined(__linux__) && !defined(EASY_DEVICE)
+	int             Initialize() { return fReactor.Initialize(); }
+#else
+	int             Initialize() { return 0; }
+#endif
+
 private:
 
+	enum
+	{
+		kWaitTimeoutInMilSecs = 15000   //int
+	};
+
 	virtual void Entry();
+	void            DispatchEvent(struct eventreq* inEvent);
+
 	OSRefTable      fRefTable;
 
+#if defined(__linux__) && !defined(EASY_DEVICE)
+	EpollReactor    fReactor;
+#endif
+
 	friend class EventContext;
 };
 
+//
+// Every EventThread owns its own epoll set (see EpollReactor), so the socket
+// load is sharded over all of them instead of funnelling through one thread.
+// The select() and MacOS X event queue shims are process-global, so those
+// platforms always run a single EventThread.
+class EventThreadPool
+{
+public:
+
+	// Creates (but does not start) the event threads. Call once.
+	static void         AddThreads(UInt32 numToAdd);
+	static void         StartThreads();
+
+	static EventThread* GetThread(UInt32 index);
+	static UInt32       GetNumThreads() { return sNumEventThreads; }
+
+	// Picks the thread for a new context. A task that is bound to a TaskThread
+	// gets the event thread with the same index, so a session's socket events
+	// and its Run() stay on a matching pair of cores. Otherwise we spread by fd.
+	static EventThread* PickThread(int inFileDesc, Task* inTask);
+
+private:
+
+	static EventThread**    sEventThreadArray;
+	static UInt32           sNumEventThreads;
+};
+
 #endif //__EVENT_CONTEXT_H__
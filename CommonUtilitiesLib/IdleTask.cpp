@@ -38,86 +38,53 @@
 #include "IdleTask.h"
 #include "OS.h"
 
- //IDLETASKTHREAD IMPLEMENTATION:
-IdleTaskThread*     IdleTask::sIdleThread = NULL;
-
-void IdleTaskThread::SetIdleTimer(IdleTask* activeObj, SInt64 msec)
-{
-	//note: OSHeap doesn't support a random remove, so this function
-	//won't change the timeout value if there is already one set
-	if (activeObj->fIdleElem.IsMemberOfAnyHeap())
-		return;
-	activeObj->fIdleElem.SetValue(OS::Milliseconds() + msec);
-
-	{
-		OSMutexLocker locker(&fHeapMutex);
-		fIdleHeap.Insert(&activeObj->fIdleElem);
-	}
-	fHeapCond.Signal();
-}
-
-void IdleTaskThread::CancelTimeout(IdleTask* idleObj)
+void IdleTask::Initialize()
 {
-	Assert(idleObj != NULL);
-	OSMutexLocker locker(&fHeapMutex);
-	fIdleHeap.Remove(&idleObj->fIdleElem);
+	//Idle timers are serviced by the task threads themselves
+	Assert(TaskThreadPool::GetNumThreads() > 0);
 }
 
-void
-IdleTaskThread::Entry()
+void IdleTask::SetIdleTimer(SInt64 msec)
 {
-	OSMutexLocker locker(&fHeapMutex);
-
-	while (true)
+	TaskThread* theThread = NULL;
 	{
-		//if there are no events to process, block.
-		if (fIdleHeap.CurrentHeapSize() == 0)
-			fHeapCond.Wait(&fHeapMutex);
-		SInt64 msec = OS::Milliseconds();
+		OSMutexLocker idleLocker(&fIdleMutex);
 
-		//pop elements out of the heap as long as their timeout time has arrived
-		while ((fIdleHeap.CurrentHeapSize() > 0) && (fIdleHeap.PeekMin()->GetValue() <= msec))
+		//Only one timeout can be outstanding, an existing one is left alone.
+		//The owning thread pulls fIdleElem off its wheel under fTimerMutex.
+		if (fIdleThread != NULL)
 		{
-			IdleTask* elem = (IdleTask*)fIdleHeap.ExtractMin()->GetEnclosingObject();
-			Assert(elem != NULL);
-			elem->Signal(Task::kIdleEvent);
+			OSMutexLocker locker(&fIdleThread->fTimerMutex);
+			if (fIdleElem.IsMemberOfAnyWheel())
+				return;
 		}
 
-		//we are done sending idle events. If there is a lowest tick count, then
-		//we need to sleep until that time.
-		if (fIdleHeap.CurrentHeapSize() > 0)
-		{
-			SInt64 timeoutTime = fIdleHeap.PeekMin()->GetValue();
-			//because sleep takes a 32 bit number
-			timeoutTime -= msec;
-			Assert(timeoutTime > 0);
-			UInt32 smallTime = (UInt32)timeoutTime;
-			fHeapCond.Wait(&fHeapMutex, smallTime);
-		}
+		theThread = TaskThread::PickTimerThread();
+		fIdleElem.SetValue(OS::Milliseconds() + msec);
+
+		OSMutexLocker locker(&theThread->fTimerMutex);
+		theThread->fIdleTimers.Insert(&fIdleElem);
+		fIdleThread = theThread;
 	}
+
+	if (theThread != OSThread::GetCurrent())
+		theThread->WakeForTimer();
 }
 
-void IdleTask::Initialize()
+void IdleTask::CancelTimeout()
 {
-	if (sIdleThread == NULL)
-	{
-		sIdleThread = new IdleTaskThread();
-		sIdleThread->Start();
-	}
+	OSMutexLocker idleLocker(&fIdleMutex);
+	if (fIdleThread == NULL)
+		return;
+
+	//a no-op if the timer already fired
+	OSMutexLocker locker(&fIdleThread->fTimerMutex);
+	fIdleThread->fIdleTimers.Remove(&fIdleElem);
 }
 
 IdleTask::~IdleTask()
 {
-	//clean up stuff used by idle thread routines
-	Assert(sIdleThread != NULL);
-
-	OSMutexLocker locker(&sIdleThread->fHeapMutex);
-
-	//Check to see if there is a pending timeout. If so, get this object
-	//out of the heap
-	if (fIdleElem.IsMemberOfAnyHeap())
-		sIdleThread->CancelTimeout(this);
+	//If the timer is firing right now, this waits for the owning thread
+	//to finish signalling us before pulling it off the wheel.
+	this->CancelTimeout();
 }
-
-
-
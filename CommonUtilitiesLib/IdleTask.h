@@ -31,6 +31,9 @@
 				 on one, after the time has elapsed the task object will receive an
 				 OS_IDLE event.
 
+				 Idle timers live on the timing wheels of the task threads (see
+				 TaskThread::fIdleTimers), normally the one SetIdleTimer is called from.
+
 
 
  */
@@ -42,29 +45,8 @@
 #include "Task.h"
 
 #include "OSThread.h"
-#include "OSHeap.h"
+#include "OSTimingWheel.h"
 #include "OSMutex.h"
-#include "OSCond.h"
-
-class IdleTask;
-
-//merely a private implementation detail of IdleTask
-class IdleTaskThread : private OSThread
-{
-private:
-
-	IdleTaskThread() : OSThread(), fHeapMutex() {}
-	virtual ~IdleTaskThread() { Assert(fIdleHeap.CurrentHeapSize() == 0); }
-
-	void SetIdleTimer(IdleTask* idleObj, SInt64 msec);
-	void CancelTimeout(IdleTask* idleObj);
-
-	virtual void Entry();
-	OSHeap  fIdleHeap;
-	OSMutex fHeapMutex;
-	OSCond  fHeapCond;
-	friend class IdleTask;
-};
 
 
 class IdleTask : public Task
@@ -72,10 +54,10 @@ class IdleTask : public Task
 
 public:
 
-	//Call Initialize before using this class
+	//Call Initialize before using this class. The task threads must already exist.
 	static void Initialize();
 
-	IdleTask() : Task(), fIdleElem() { this->SetTaskName("IdleTask"); fIdleElem.SetEnclosingObject(this); }
+	IdleTask() : Task(), fIdleElem(), fIdleThread(NULL) { this->SetTaskName("IdleTask"); fIdleElem.SetEnclosingObject((Task*)this); }
 
 	//This object does a "best effort" of making sure a timeout isn't
 	//pending for an object being deleted. In other words, if there is
@@ -88,21 +70,22 @@ public:
 	//This object will receive an OS_IDLE event in the following number of milliseconds.
 	//Only one timeout can be outstanding, if there is already a timeout scheduled, this
 	//does nothing.
-	void SetIdleTimer(SInt64 msec) { sIdleThread->SetIdleTimer(this, msec); }
+	void SetIdleTimer(SInt64 msec);
 
 	//CancelTimeout
 	//If there is a pending timeout for this object, this function cancels it.
 	//If there is no pending timeout, this function does nothing.
-	//Currently not supported because OSHeap doesn't support random remove
-	void CancelTimeout() { sIdleThread->CancelTimeout(this); }
+	void CancelTimeout();
 
 private:
 
-	OSHeapElem fIdleElem;
+	OSTimerElem fIdleElem;
 
-	//there is only one idle thread shared by all idle tasks.
-	static IdleTaskThread*  sIdleThread;
+	//the task thread whose fIdleTimers fIdleElem was last inserted in
+	TaskThread* fIdleThread;
 
-	friend class IdleTaskThread;
+	//Serializes SetIdleTimer and CancelTimeout, so fIdleThread always names the
+	//wheel fIdleElem is on. Taken before the task thread's fTimerMutex.
+	OSMutex     fIdleMutex;
 };
 #endif
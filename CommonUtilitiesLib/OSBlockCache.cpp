@@ -0,0 +1,542 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSBlockCache.cpp
+
+	Contains:   Implements OSBlockCache
+*/
+
+#include <string.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#ifdef __Win32__
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "OSBlockCache.h"
+#include "OSMutex.h"
+#include "OSCond.h"
+#include "OSQueue.h"
+#include "OSHashTable.h"
+#include "OSThread.h"
+
+enum
+{
+	kNumShards = 16,
+	kShardTableSize = 4096,         // power of 2, so OSHashTable masks
+	kNumReadAheadThreads = 4,
+	kMaxQueuedReadAheads = 512,
+	kReadAheadWaitMsec = 1000       // how often idle read-ahead threads check for a stop request
+};
+
+//One version of one file
+struct OSCachedFileID
+{
+	UInt64  fDevice;
+	UInt64  fInode;
+	SInt64  fModDate;
+	UInt64  fLength;
+
+	bool    operator==(const OSCachedFileID& inID) const
+	{
+		return fInode == inID.fInode && fDevice == inID.fDevice && fModDate == inID.fModDate && fLength == inID.fLength;
+	}
+};
+
+static UInt64 MixBits(UInt64 inValue)
+{
+	inValue ^= inValue >> 33;
+	inValue *= 0xff51afd7ed558ccdULL;
+	inValue ^= inValue >> 33;
+	inValue *= 0xc4ceb9fe1a85ec53ULL;
+	inValue ^= inValue >> 33;
+	return inValue;
+}
+
+static UInt64 HashFileID(const OSCachedFileID& inID)
+{
+	return MixBits(inID.fInode ^ MixBits(inID.fDevice ^ ((UInt64)inID.fModDate << 20) ^ inID.fLength));
+}
+
+class OSCachedFile
+{
+public:
+	OSCachedFile(const OSCachedFileID& inID, int inFD) : fID(inID), fFD(inFD), fRefCount(1), fNextHashEntry(NULL) {}
+	~OSCachedFile() { ::close(fFD); }
+
+	OSCachedFileID  fID;
+	int             fFD;            // our own descriptor, so queued read-aheads outlive the opener
+	UInt32          fRefCount;      // openers plus queued read-aheads, guarded by sFileMutex
+	OSCachedFile*   fNextHashEntry;
+#ifdef __Win32__
+	OSMutex         fSeekMutex;     // no pread, so reads seek the shared descriptor
+#endif
+};
+
+class OSCachedFileKey
+{
+public:
+	OSCachedFileKey(OSCachedFile* inFile) : fID(inFile->fID) {}
+	OSCachedFileKey(const OSCachedFileID& inID) : fID(inID) {}
+
+	UInt32  GetHashKey() { return (UInt32)HashFileID(fID); }
+	bool    operator==(const OSCachedFileKey& inKey) { return fID == inKey.fID; }
+
+private:
+	OSCachedFileID  fID;
+};
+
+class OSCachedBlock
+{
+public:
+	OSCachedBlock(const OSCachedFileID& inID, UInt64 inIndex)
+		: fID(inID), fIndex(inIndex), fRefCount(1), fLength(0), fErr(OS_NoErr),
+		fFilled(false), fInTable(true), fReadAheadIndex(0),
+		fLRUElem(this), fReadAheadElem(this), fReadAheadFile(NULL), fNextHashEntry(NULL)
+	{}
+
+	OSCachedFileID  fID;
+	UInt64          fIndex;
+	UInt32          fRefCount;      // readers plus a queued read-ahead, guarded by the shard mutex
+	UInt32          fLength;        // valid bytes, short for the last block of the file
+	OS_Error        fErr;
+	bool            fFilled;        // readers of an unfilled block wait on the shard's cond
+	bool            fInTable;
+	UInt64          fReadAheadIndex;    // non-zero on the block partway through a queued window: where the next window starts
+
+	OSQueueElem     fLRUElem;
+	OSQueueElem     fReadAheadElem;
+	OSCachedFile*   fReadAheadFile;
+	OSCachedBlock*  fNextHashEntry;
+
+	char            fData[OSBlockCache::kBlockSize];
+};
+
+class OSCachedBlockKey
+{
+public:
+	OSCachedBlockKey(OSCachedBlock* inBlock) : fID(inBlock->fID), fIndex(inBlock->fIndex) {}
+	OSCachedBlockKey(const OSCachedFileID& inID, UInt64 inIndex) : fID(inID), fIndex(inIndex) {}
+
+	//the low bits pick the bucket, the high bits the shard
+	UInt64  GetHash() { return MixBits(HashFileID(fID) + fIndex); }
+	UInt32  GetHashKey() { return (UInt32)this->GetHash(); }
+	UInt32  GetShard() { return (UInt32)(this->GetHash() >> 48) % kNumShards; }
+	bool    operator==(const OSCachedBlockKey& inKey) { return fIndex == inKey.fIndex && fID == inKey.fID; }
+
+private:
+	OSCachedFileID  fID;
+	UInt64          fIndex;
+};
+
+struct OSBlockCacheShard
+{
+	OSBlockCacheShard() : fTable(kShardTableSize), fBytes(0), fNumHits(0), fNumMisses(0), fBytesSaved(0), fNumEvictions(0) {}
+
+	OSMutex         fMutex;
+	OSCond          fCond;
+	OSHashTable<OSCachedBlock, OSCachedBlockKey> fTable;
+	OSQueue         fLRU;           // head is the least recently used
+
+	UInt64          fBytes;
+	UInt64          fNumHits;
+	UInt64          fNumMisses;
+	UInt64          fBytesSaved;
+	UInt64          fNumEvictions;
+};
+
+class OSBlockCacheReadAheadThread : public OSThread
+{
+public:
+	OSBlockCacheReadAheadThread() : OSThread() {}
+	virtual ~OSBlockCacheReadAheadThread() {}
+
+private:
+	virtual void Entry();
+};
+
+static OSBlockCacheShard    sShards[kNumShards];
+static UInt64               sMaxShardBytes = 0;
+static UInt32               sReadAheadSecs = 0;
+
+static OSMutex              sFileMutex;
+static OSHashTable<OSCachedFile, OSCachedFileKey> sFileTable(256);
+
+static OSQueue_Blocking*    sReadAheadQueue = NULL;   // never deleted, its threads wait on it until exit
+static OSBlockCacheReadAheadThread* sReadAheadThreads[kNumReadAheadThreads];
+static bool                 sReadAheadStarted = false;
+
+//Frees unreferenced blocks from the LRU end until the shard fits. Shard mutex must be held.
+static void TrimShard(OSBlockCacheShard* inShard)
+{
+	OSQueueIter theIter(&inShard->fLRU);
+	while (inShard->fBytes > sMaxShardBytes && !theIter.IsDone())
+	{
+		OSCachedBlock* theBlock = (OSCachedBlock*)theIter.GetCurrent()->GetEnclosingObject();
+		theIter.Next();
+		if (theBlock->fRefCount > 0)
+			continue;
+
+		inShard->fLRU.Remove(&theBlock->fLRUElem);
+		inShard->fTable.Remove(theBlock);
+		inShard->fBytes -= OSBlockCache::kBlockSize;
+		inShard->fNumEvictions++;
+		delete theBlock;
+	}
+}
+
+//Adds an unfilled block the caller holds a reference on. Shard mutex must be held.
+static OSCachedBlock* NewBlock(OSBlockCacheShard* inShard, const OSCachedFileID& inID, UInt64 inIndex)
+{
+	OSCachedBlock* theBlock = new OSCachedBlock(inID, inIndex);
+	inShard->fTable.Add(theBlock);
+	inShard->fLRU.EnQueue(&theBlock->fLRUElem);
+	inShard->fBytes += OSBlockCache::kBlockSize;
+	TrimShard(inShard);
+	return theBlock;
+}
+
+static void ReleaseBlock(OSCachedBlock* inBlock, UInt32 inBytesSaved)
+{
+	OSBlockCacheShard* theShard = &sShards[OSCachedBlockKey(inBlock).GetShard()];
+	OSMutexLocker locker(&theShard->fMutex);
+
+	theShard->fBytesSaved += inBytesSaved;
+	Assert(inBlock->fRefCount > 0);
+	if (--inBlock->fRefCount > 0)
+		return;
+
+	if (!inBlock->fInTable)
+		delete inBlock;     // failed fill, already out of the table
+	else if (theShard->fBytes > sMaxShardBytes)
+		TrimShard(theShard);
+}
+
+static void FillBlock(OSCachedFile* inFile, OSCachedBlock* inBlock)
+{
+	UInt64 thePosition = inBlock->fIndex << OSBlockCache::kBlockSizeExp;
+	UInt32 theWanted = OSBlockCache::kBlockSize;
+	if (thePosition + theWanted > inFile->fID.fLength)
+		theWanted = (UInt32)(inFile->fID.fLength - thePosition);
+
+#ifdef __Win32__
+	int theLen = -1;
+	{
+		OSMutexLocker seekLocker(&inFile->fSeekMutex);
+		if (_lseeki64(inFile->fFD, thePosition, SEEK_SET) != -1)
+			theLen = ::read(inFile->fFD, inBlock->fData, theWanted);
+	}
+#else
+	int theLen = ::pread(inFile->fFD, inBlock->fData, theWanted, thePosition);
+#endif
+
+	OSBlockCacheShard* theShard = &sShards[OSCachedBlockKey(inBlock).GetShard()];
+	OSMutexLocker locker(&theShard->fMutex);
+	if (theLen < 0)
+	{
+		//take it out so the next reader tries again. The readers holding it see the error.
+		inBlock->fErr = OSThread::GetErrno();
+		theShard->fLRU.Remove(&inBlock->fLRUElem);
+		theShard->fTable.Remove(inBlock);
+		theShard->fBytes -= OSBlockCache::kBlockSize;
+		inBlock->fInTable = false;
+	}
+	else
+		inBlock->fLength = (UInt32)theLen;
+
+	inBlock->fFilled = true;
+	theShard->fCond.Broadcast();
+}
+
+//Returns the block with a reference held, filled. Sets outReadAheadIndex to where
+//the next window starts if this read should queue one, 0 otherwise.
+static OSCachedBlock* GetBlock(OSCachedFile* inFile, UInt64 inIndex, bool* outIsHit, UInt64* outReadAheadIndex)
+{
+	OSCachedBlockKey theKey(inFile->fID, inIndex);
+	OSBlockCacheShard* theShard = &sShards[theKey.GetShard()];
+	OSCachedBlock* theBlock = NULL;
+	{
+		OSMutexLocker locker(&theShard->fMutex);
+		theBlock = theShard->fTable.Map(&theKey);
+		if (theBlock != NULL)
+		{
+			theBlock->fRefCount++;
+			theShard->fLRU.Remove(&theBlock->fLRUElem);
+			theShard->fLRU.EnQueue(&theBlock->fLRUElem);
+			theShard->fNumHits++;
+
+			*outIsHit = true;
+			*outReadAheadIndex = theBlock->fReadAheadIndex;
+			theBlock->fReadAheadIndex = 0;
+
+			while (!theBlock->fFilled)
+				theShard->fCond.Wait(&theShard->fMutex);
+			return theBlock;
+		}
+
+		theBlock = NewBlock(theShard, inFile->fID, inIndex);
+		theShard->fNumMisses++;
+	}
+
+	*outIsHit = false;
+	*outReadAheadIndex = inIndex + 1;
+	FillBlock(inFile, theBlock);
+	return theBlock;
+}
+
+static void QueueReadAhead(OSCachedFile* inFile, UInt64 inFirstIndex, UInt32 inBitRate)
+{
+	if (sReadAheadSecs == 0 || !sReadAheadStarted)
+		return;
+
+	UInt64 theNumBlocks = 1;
+	if (inBitRate > 0)
+		theNumBlocks = (((UInt64)inBitRate / 8) * sReadAheadSecs + OSBlockCache::kBlockSize - 1) >> OSBlockCache::kBlockSizeExp;
+	if (theNumBlocks > OSBlockCache::kMaxReadAheadBlocks)
+		theNumBlocks = OSBlockCache::kMaxReadAheadBlocks;
+
+	UInt64 theNumFileBlocks = (inFile->fID.fLength + OSBlockCache::kBlockSize - 1) >> OSBlockCache::kBlockSizeExp;
+	UInt64 theEndIndex = inFirstIndex + theNumBlocks;
+	if (theEndIndex > theNumFileBlocks)
+		theEndIndex = theNumFileBlocks;
+
+	//Reading halfway into this window queues the next one, starting where this
+	//one ends, so the reader stays between half a window and a window behind.
+	UInt64 theTriggerIndex = inFirstIndex + (theEndIndex - inFirstIndex) / 2;
+
+	for (UInt64 theIndex = inFirstIndex; theIndex < theEndIndex; theIndex++)
+	{
+		if (sReadAheadQueue->GetQueue()->GetLength() >= kMaxQueuedReadAheads)
+			break;  // the disk is behind already, more requests won't help
+
+		OSCachedBlockKey theKey(inFile->fID, theIndex);
+		OSBlockCacheShard* theShard = &sShards[theKey.GetShard()];
+		OSMutexLocker locker(&theShard->fMutex);
+
+		OSCachedBlock* theBlock = theShard->fTable.Map(&theKey);
+		if (theBlock == NULL)
+		{
+			theBlock = NewBlock(theShard, inFile->fID, theIndex);    // the queue's reference
+			{
+				OSMutexLocker fileLocker(&sFileMutex);
+				inFile->fRefCount++;
+			}
+			theBlock->fReadAheadFile = inFile;
+			sReadAheadQueue->EnQueue(&theBlock->fReadAheadElem);
+		}
+
+		//if the queue fills up before this, the blocks we skipped miss instead
+		if (theIndex == theTriggerIndex)
+			theBlock->fReadAheadIndex = theEndIndex;
+	}
+}
+
+void OSBlockCacheReadAheadThread::Entry()
+{
+	while (!this->IsStopRequested())
+	{
+		OSQueueElem* theElem = sReadAheadQueue->DeQueueBlocking(this, kReadAheadWaitMsec);
+		if (theElem == NULL)
+			continue;
+
+		OSCachedBlock* theBlock = (OSCachedBlock*)theElem->GetEnclosingObject();
+		OSCachedFile* theFile = theBlock->fReadAheadFile;
+		theBlock->fReadAheadFile = NULL;
+
+		FillBlock(theFile, theBlock);
+		ReleaseBlock(theBlock, 0);
+		OSBlockCache::CloseFile(theFile);
+	}
+}
+
+void OSBlockCache::Configure(UInt32 inMaxMBytes, UInt32 inReadAheadSecs)
+{
+	sMaxShardBytes = ((UInt64)inMaxMBytes << 20) / kNumShards;
+	sReadAheadSecs = inReadAheadSecs;
+
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		TrimShard(&sShards[x]);
+	}
+
+	OSMutexLocker locker(&sFileMutex);
+	if (inMaxMBytes == 0 || sReadAheadStarted)
+		return;
+
+	sReadAheadQueue = new OSQueue_Blocking();
+	for (UInt32 x = 0; x < kNumReadAheadThreads; x++)
+	{
+		sReadAheadThreads[x] = new OSBlockCacheReadAheadThread();
+		sReadAheadThreads[x]->Start();
+	}
+	sReadAheadStarted = true;
+}
+
+OSCachedFile* OSBlockCache::OpenFile(int inFD)
+{
+	if (sMaxShardBytes == 0 || inFD == -1)
+		return NULL;
+
+	struct stat theStat;
+	if (::fstat(inFD, &theStat) < 0)
+		return NULL;
+#ifdef __Win32__
+	if ((theStat.st_mode & _S_IFREG) == 0)
+		return NULL;
+#else
+	if (!S_ISREG(theStat.st_mode))
+		return NULL;
+#endif
+
+	OSCachedFileID theID;
+	theID.fDevice = (UInt64)theStat.st_dev;
+	theID.fInode = (UInt64)theStat.st_ino;
+	theID.fModDate = (SInt64)theStat.st_mtime;
+	theID.fLength = (UInt64)theStat.st_size;
+	OSCachedFileKey theKey(theID);
+
+	OSMutexLocker locker(&sFileMutex);
+	OSCachedFile* theFile = sFileTable.Map(&theKey);
+	if (theFile != NULL)
+	{
+		theFile->fRefCount++;
+		return theFile;
+	}
+
+	int theFD = ::dup(inFD);
+	if (theFD == -1)
+		return NULL;
+
+	theFile = new OSCachedFile(theID, theFD);
+	sFileTable.Add(theFile);
+	return theFile;
+}
+
+void OSBlockCache::CloseFile(OSCachedFile* inFile)
+{
+	OSMutexLocker locker(&sFileMutex);
+	Assert(inFile->fRefCount > 0);
+	if (--inFile->fRefCount > 0)
+		return;
+
+	//its blocks stay, a later open of the same file finds them by its ID
+	sFileTable.Remove(inFile);
+	delete inFile;
+}
+
+OS_Error OSBlockCache::Read(OSCachedFile* inFile, UInt64 inPosition, void* inBuffer, UInt32 inLength, UInt32* outRcvLen, UInt32 inBitRate)
+{
+	*outRcvLen = 0;
+	if (inPosition >= inFile->fID.fLength || inLength == 0)
+		return OS_NoErr;
+
+	if (inLength > inFile->fID.fLength - inPosition)
+		inLength = (UInt32)(inFile->fID.fLength - inPosition);
+
+	char* theOut = (char*)inBuffer;
+	UInt64 theIndex = inPosition >> kBlockSizeExp;
+	UInt64 theLastIndex = (inPosition + inLength - 1) >> kBlockSizeExp;
+	UInt32 theOffset = (UInt32)(inPosition & (kBlockSize - 1));
+	UInt64 theReadAheadIndex = 0;
+
+	for (; theIndex <= theLastIndex; theIndex++)
+	{
+		bool isHit = false;
+		UInt64 theBlockReadAheadIndex = 0;
+		OSCachedBlock* theBlock = GetBlock(inFile, theIndex, &isHit, &theBlockReadAheadIndex);
+		if (theBlockReadAheadIndex > theReadAheadIndex)
+			theReadAheadIndex = theBlockReadAheadIndex;
+
+		OS_Error theErr = theBlock->fErr;
+		UInt32 theCopyLen = 0;
+		if (theErr == OS_NoErr && theBlock->fLength > theOffset)
+		{
+			theCopyLen = theBlock->fLength - theOffset;
+			if (theCopyLen > inLength - *outRcvLen)
+				theCopyLen = inLength - *outRcvLen;
+			::memcpy(theOut, &theBlock->fData[theOffset], theCopyLen);
+		}
+		bool isShort = theBlock->fLength < kBlockSize;
+		ReleaseBlock(theBlock, isHit ? theCopyLen : 0);
+
+		if (theErr != OS_NoErr)
+			return theErr;
+
+		theOut += theCopyLen;
+		*outRcvLen += theCopyLen;
+		if (isShort)
+			break;  // end of the file as read, even if it has shrunk since we stat'd it
+		theOffset = 0;
+	}
+
+	//never queue blocks this read has just been through
+	if (theReadAheadIndex != 0)
+		QueueReadAhead(inFile, (theReadAheadIndex > theLastIndex) ? theReadAheadIndex : theLastIndex + 1, inBitRate);
+
+	return OS_NoErr;
+}
+
+UInt64 OSBlockCache::GetNumHits()
+{
+	UInt64 theTotal = 0;
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		theTotal += sShards[x].fNumHits;
+	}
+	return theTotal;
+}
+
+UInt64 OSBlockCache::GetNumMisses()
+{
+	UInt64 theTotal = 0;
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		theTotal += sShards[x].fNumMisses;
+	}
+	return theTotal;
+}
+
+UInt64 OSBlockCache::GetBytesSaved()
+{
+	UInt64 theTotal = 0;
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		theTotal += sShards[x].fBytesSaved;
+	}
+	return theTotal;
+}
+
+UInt64 OSBlockCache::GetNumEvictions()
+{
+	UInt64 theTotal = 0;
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		theTotal += sShards[x].fNumEvictions;
+	}
+	return theTotal;
+}
+
+UInt64 OSBlockCache::GetBytesCached()
+{
+	UInt64 theTotal = 0;
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		OSMutexLocker locker(&sShards[x].fMutex);
+		theTotal += sShards[x].fBytes;
+	}
+	return theTotal;
+}
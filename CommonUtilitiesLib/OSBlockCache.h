@@ -0,0 +1,66 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSBlockCache.h
+
+	Contains:   A process-wide cache of 32K file blocks, shared by every open of
+				the same file.
+
+				Blocks are keyed by the file's device, inode, length and mod date
+				plus the block index, so a file that is rewritten stops matching
+				its old blocks. The cache is split into shards, each with its own
+				mutex, hash table and LRU list. A block that is being read or
+				filled is referenced and is never evicted.
+
+				The first reader of a missing block fills it with a pread on its
+				own thread; other readers of that block wait for it. Reads also
+				queue blocks ahead of the caller for the read-ahead threads. The
+				window holds inReadAheadSecs of playback at the caller's bit rate.
+*/
+
+#ifndef _OSBLOCKCACHE_H_
+#define _OSBLOCKCACHE_H_
+
+#include "OSHeaders.h"
+
+class OSCachedFile;
+
+class OSBlockCache
+{
+public:
+
+	enum
+	{
+		kBlockSizeExp = 15,                 // 32K, the unit QTFile has always buffered in
+		kBlockSize = 1 << kBlockSizeExp,
+		kMaxReadAheadBlocks = 64            // 2M
+	};
+
+	//Sets the cache size and how many seconds of playback reads fetch ahead.
+	//0 Mbytes turns the cache off for files opened afterwards. The read-ahead
+	//threads are started the first time the cache is turned on.
+	static void         Configure(UInt32 inMaxMBytes, UInt32 inReadAheadSecs);
+
+	//Returns the cache's handle on the file open on inFD, or NULL if the cache
+	//is off. Handles on the same file are shared. Pair with CloseFile.
+	static OSCachedFile* OpenFile(int inFD);
+	static void         CloseFile(OSCachedFile* inFile);
+
+	//Copies up to inLength bytes at inPosition. inBitRate (bits per second)
+	//sizes the read-ahead window, 0 fetches one block ahead.
+	static OS_Error     Read(OSCachedFile* inFile, UInt64 inPosition, void* inBuffer, UInt32 inLength, UInt32* outRcvLen, UInt32 inBitRate);
+
+	//Stats since startup
+	static UInt64       GetNumHits();           // block lookups served without a disk read of their own
+	static UInt64       GetNumMisses();
+	static UInt64       GetBytesSaved();        // bytes copied out of blocks that were hits
+	static UInt64       GetNumEvictions();
+	static UInt64       GetBytesCached();
+};
+
+#endif //_OSBLOCKCACHE_H_
@@ -0,0 +1,246 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSCounters.cpp
+
+	Contains:   Implements OSCounters
+*/
+
+#include "OSCounters.h"
+#include "StringFormatter.h"
+#include "atomic.h"
+
+const SInt64 OSCounters::kHistogramBounds[kNumHistogramBuckets] = { 100, 1000, 10000, 100000 };
+
+OSMutex                 OSCounters::sShardsMutex;
+OSCounters::Shard* volatile OSCounters::sShards = NULL;
+UInt32                  OSCounters::sNumShards = 0;
+UInt32                  OSCounters::sMaxGenerations[kMaxCounters];
+
+#ifdef __Win32__
+DWORD                   OSCounters::sShardKey = TLS_OUT_OF_INDEXES;
+#else
+pthread_once_t          OSCounters::sKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t           OSCounters::sShardKey;
+#endif
+
+OSCounters::Shard::Shard()
+	: fIsOrphaned(false),
+	fNext(NULL)
+{
+	::memset((void*)fValues, 0, sizeof(fValues));
+	::memset(fMaxGenerations, 0, sizeof(fMaxGenerations));
+	fThreadName[0] = '\0';
+}
+
+void OSCounters::MakeKey()
+{
+#ifdef __Win32__
+	sShardKey = ::TlsAlloc();
+#else
+	//a thread's shard is orphaned, not deleted, when the thread goes away
+	::pthread_key_create(&sShardKey, OrphanShard);
+#endif
+}
+
+OSCounters::Shard* OSCounters::GetShard()
+{
+#ifdef __Win32__
+	if (sShardKey == TLS_OUT_OF_INDEXES)
+	{
+		OSMutexLocker locker(&sShardsMutex);
+		if (sShardKey == TLS_OUT_OF_INDEXES)
+			MakeKey();
+	}
+	Shard* theShard = (Shard*)::TlsGetValue(sShardKey);
+#else
+	::pthread_once(&sKeyOnce, MakeKey);
+	Shard* theShard = (Shard*)::pthread_getspecific(sShardKey);
+#endif
+	if (theShard != NULL)
+		return theShard;
+
+	{
+		OSMutexLocker locker(&sShardsMutex);
+
+		//take over what an exited thread left, so its counts stay in the totals
+		for (theShard = sShards; theShard != NULL; theShard = theShard->fNext)
+		{
+			if (theShard->fIsOrphaned)
+			{
+				theShard->fIsOrphaned = false;
+				break;
+			}
+		}
+
+		if (theShard == NULL)
+		{
+			theShard = new Shard();
+			qtss_snprintf(theShard->fThreadName, sizeof(theShard->fThreadName), "thread%" _U32BITARG_, sNumShards++);
+			theShard->fNext = sShards;
+
+			//readers walk the list without the mutex, so the shard has to be complete first
+			atomic_barrier();
+			sShards = theShard;
+		}
+	}
+
+#ifdef __Win32__
+	::TlsSetValue(sShardKey, theShard);
+#else
+	::pthread_setspecific(sShardKey, theShard);
+#endif
+	return theShard;
+}
+
+void OSCounters::AddToHistogram(UInt32 inHistogram, SInt64 inMicros)
+{
+	Shard* theShard = GetShard();
+	volatile SInt64* theValues = &theShard->fValues[inHistogram];
+
+	theValues[kHistogramCount] = theValues[kHistogramCount] + 1;
+	theValues[kHistogramSumMicros] = theValues[kHistogramSumMicros] + inMicros;
+
+	for (UInt32 x = 0; x < kNumHistogramBuckets; x++)
+	{
+		if (inMicros <= kHistogramBounds[x])
+		{
+			theValues[kHistogramFirstBucket + x] = theValues[kHistogramFirstBucket + x] + 1;
+			break;
+		}
+	}
+}
+
+void OSCounters::SetMax(UInt32 inCounter, SInt64 inValue)
+{
+	Shard* theShard = GetShard();
+	UInt32 theGeneration = sMaxGenerations[inCounter];
+
+	if (theShard->fMaxGenerations[inCounter] != theGeneration)
+	{
+		//first value since ResetMax. Store the value before the generation that makes it readable.
+		theShard->fValues[inCounter] = inValue;
+		atomic_barrier();
+		theShard->fMaxGenerations[inCounter] = theGeneration;
+	}
+	else if (inValue > theShard->fValues[inCounter])
+		theShard->fValues[inCounter] = inValue;
+}
+
+void OSCounters::ResetMax(UInt32 inCounter)
+{
+	(void)atomic_add((unsigned int*)&sMaxGenerations[inCounter], 1);
+}
+
+SInt64 OSCounters::Get(UInt32 inCounter)
+{
+	SInt64 theTotal = 0;
+	for (Shard* theShard = sShards; theShard != NULL; theShard = theShard->fNext)
+		theTotal += theShard->fValues[inCounter];
+	return theTotal;
+}
+
+SInt64 OSCounters::GetMax(UInt32 inCounter)
+{
+	UInt32 theGeneration = sMaxGenerations[inCounter];
+	SInt64 theMax = 0;
+	for (Shard* theShard = sShards; theShard != NULL; theShard = theShard->fNext)
+	{
+		if ((theShard->fMaxGenerations[inCounter] == theGeneration) && (theShard->fValues[inCounter] > theMax))
+			theMax = theShard->fValues[inCounter];
+	}
+	return theMax;
+}
+
+void OSCounters::SetThreadName(const char* inName)
+{
+	Shard* theShard = GetShard();
+	::strncpy(theShard->fThreadName, inName, sizeof(theShard->fThreadName) - 1);
+	theShard->fThreadName[sizeof(theShard->fThreadName) - 1] = '\0';
+}
+
+void OSCounters::WriteHeader(StringFormatter* ioOut, const char* inName, const char* inType, const char* inHelp)
+{
+	ioOut->PutFmtStr("# HELP %s %s\n# TYPE %s %s\n", inName, inHelp, inName, inType);
+}
+
+void OSCounters::WriteValue(StringFormatter* ioOut, const char* inName, const char* inLabels, SInt64 inValue)
+{
+	if (inLabels != NULL)
+		ioOut->PutFmtStr("%s{%s} %" _64BITARG_ "d\n", inName, inLabels, inValue);
+	else
+		ioOut->PutFmtStr("%s %" _64BITARG_ "d\n", inName, inValue);
+}
+
+void OSCounters::WriteValue(StringFormatter* ioOut, const char* inName, const char* inLabels, Float64 inValue)
+{
+	if (inLabels != NULL)
+		ioOut->PutFmtStr("%s{%s} %.6g\n", inName, inLabels, inValue);
+	else
+		ioOut->PutFmtStr("%s %.6g\n", inName, inValue);
+}
+
+void OSCounters::WritePerThread(StringFormatter* ioOut, const char* inName, const char* inType, const char* inHelp, UInt32 inCounter)
+{
+	WriteHeader(ioOut, inName, inType, inHelp);
+	for (Shard* theShard = sShards; theShard != NULL; theShard = theShard->fNext)
+	{
+		ioOut->PutFmtStr("%s{thread=\"", inName);
+		PutLabelValue(ioOut, theShard->fThreadName);
+		ioOut->PutFmtStr("\"} %" _64BITARG_ "d\n", theShard->Get(inCounter));
+	}
+}
+
+void OSCounters::WriteHistogram(StringFormatter* ioOut, const char* inName, const char* inHelp, UInt32 inHistogram)
+{
+	WriteHeader(ioOut, inName, "histogram", inHelp);
+	for (Shard* theShard = sShards; theShard != NULL; theShard = theShard->fNext)
+	{
+		SInt64 theCount = theShard->Get(inHistogram + kHistogramCount);
+		if (theCount == 0)
+			continue;
+
+		//Prometheus buckets are cumulative; ours each hold only their own range
+		SInt64 theCumulative = 0;
+		for (UInt32 x = 0; x < kNumHistogramBuckets; x++)
+		{
+			theCumulative += theShard->Get(inHistogram + kHistogramFirstBucket + x);
+			ioOut->PutFmtStr("%s_bucket{thread=\"", inName);
+			PutLabelValue(ioOut, theShard->fThreadName);
+			ioOut->PutFmtStr("\",le=\"%g\"} %" _64BITARG_ "d\n", (Float64)kHistogramBounds[x] / 1000000.0, theCumulative);
+		}
+
+		ioOut->PutFmtStr("%s_bucket{thread=\"", inName);
+		PutLabelValue(ioOut, theShard->fThreadName);
+		ioOut->PutFmtStr("\",le=\"+Inf\"} %" _64BITARG_ "d\n", theCount);
+
+		ioOut->PutFmtStr("%s_sum{thread=\"", inName);
+		PutLabelValue(ioOut, theShard->fThreadName);
+		ioOut->PutFmtStr("\"} %.6f\n", (Float64)theShard->Get(inHistogram + kHistogramSumMicros) / 1000000.0);
+
+		ioOut->PutFmtStr("%s_count{thread=\"", inName);
+		PutLabelValue(ioOut, theShard->fThreadName);
+		ioOut->PutFmtStr("\"} %" _64BITARG_ "d\n", theCount);
+	}
+}
+
+void OSCounters::PutLabelValue(StringFormatter* ioOut, const char* inValue)
+{
+	for (const char* theChar = inValue; *theChar != '\0'; theChar++)
+	{
+		if (*theChar == '\\' || *theChar == '"')
+		{
+			ioOut->PutChar('\\');
+			ioOut->PutChar(*theChar);
+		}
+		else if (*theChar == '\n')
+			ioOut->Put((char*)"\\n", 2);
+		else
+			ioOut->PutChar(*theChar);
+	}
+}
@@ -0,0 +1,172 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSCounters.h
+
+	Contains:   Statistics counters that cost a thread no lock and no shared
+				cache line to bump.
+
+				Every thread that counts gets a shard of its own: a cache line
+				aligned block of kMaxCounters 64 bit values that only that
+				thread writes. Add and SetMax are plain stores into the shard.
+				Get adds the shards up when somebody reads a counter, so the
+				work is on the (rare) reader rather than on every packet.
+
+				Counters are identified by index. The ones below are counted by
+				CommonUtilitiesLib itself; the application numbers its own from
+				kFirstAppCounter up. A histogram takes kHistogramSize counters
+				in a row: the count, the sum in microseconds and one counter per
+				bucket of kHistogramBounds.
+
+				A shard is never freed. When its thread exits, the next new
+				thread takes it over, so totals never go backwards.
+
+				Readers see each shard's values as the owning thread last stored
+				them. On 32 bit platforms a value read while it is being written
+				may be torn; that is a one-off error in a statistic, not a crash.
+
+				The Write functions put counters out in the Prometheus text
+				exposition format.
+*/
+
+#ifndef _OSCOUNTERS_H_
+#define _OSCOUNTERS_H_
+
+#include "OSHeaders.h"
+#include "OSMutex.h"
+
+class StringFormatter;
+
+class OSCounters
+{
+public:
+
+	enum
+	{
+		// Histogram layout, relative to its first counter
+		kHistogramCount = 0,
+		kHistogramSumMicros = 1,
+		kHistogramFirstBucket = 2,
+		kNumHistogramBuckets = 4,
+		kHistogramSize = kHistogramFirstBucket + kNumHistogramBuckets
+	};
+
+	enum
+	{
+		// Time from Signal (or a timer coming due) to Run, per task thread
+		kTaskQueueLatency = 0,      // histogram
+		kSocketReads = kTaskQueueLatency + kHistogramSize,
+		kSocketReadsWouldBlock,
+		kSocketWrites,
+		kSocketWritesWouldBlock,
+		kUDPBatchedPackets,         // packets sent through UDPSocket::QueueSendTo batches
+		kUDPBatchSyscalls,          // sendmmsg calls made for them
+
+		kFirstAppCounter = 16,
+		kMaxCounters = 64
+	};
+
+	// Upper bounds of the histogram buckets, in microseconds. Values above the
+	// last bound are only in the count.
+	static const SInt64 kHistogramBounds[kNumHistogramBuckets];
+
+	class Shard
+	{
+	public:
+
+		SInt64      Get(UInt32 inCounter) { return fValues[inCounter]; }
+		char*       GetThreadName() { return fThreadName; }
+		Shard*      GetNext() { return fNext; }
+
+	private:
+
+		friend class OSCounters;
+
+		Shard();
+
+		enum
+		{
+			kCacheLineSize = 64,
+			kThreadNameSize = 16
+		};
+
+		//the padding keeps the values off any line another shard or allocation writes
+		char            fPadBefore[kCacheLineSize];
+		volatile SInt64 fValues[kMaxCounters];
+		UInt32          fMaxGenerations[kMaxCounters];   // see SetMax
+		char            fThreadName[kThreadNameSize];
+		bool            fIsOrphaned;
+		Shard*          fNext;
+		char            fPadAfter[kCacheLineSize];
+	};
+
+	static void     Add(UInt32 inCounter, SInt64 inValue)
+	{
+		Shard* theShard = GetShard();
+		theShard->fValues[inCounter] = theShard->fValues[inCounter] + inValue;
+	}
+
+	// Counts inMicros in the histogram starting at inHistogram
+	static void     AddToHistogram(UInt32 inHistogram, SInt64 inMicros);
+
+	// Raises this thread's maximum of inCounter to inValue. ResetMax starts a new
+	// generation; a shard's old maximum is dropped the first time its thread sets
+	// the counter in the new generation, and is not read meanwhile.
+	static void     SetMax(UInt32 inCounter, SInt64 inValue);
+	static void     ResetMax(UInt32 inCounter);
+
+	// The total over all threads, or for SetMax counters the maximum
+	static SInt64   Get(UInt32 inCounter);
+	static SInt64   GetMax(UInt32 inCounter);
+
+	// Names this thread's shard for the per thread metrics
+	static void     SetThreadName(const char* inName);
+
+	// Every shard there is, to walk with Shard::GetNext
+	static Shard*   GetShards() { return sShards; }
+
+	//
+	// PROMETHEUS TEXT FORMAT
+	//
+	// inLabels is what goes between the braces, already escaped, or NULL.
+
+	static void     WriteHeader(StringFormatter* ioOut, const char* inName, const char* inType, const char* inHelp);
+	static void     WriteValue(StringFormatter* ioOut, const char* inName, const char* inLabels, SInt64 inValue);
+	static void     WriteValue(StringFormatter* ioOut, const char* inName, const char* inLabels, Float64 inValue);
+
+	// One sample per thread, labelled thread="name"
+	static void     WritePerThread(StringFormatter* ioOut, const char* inName, const char* inType, const char* inHelp, UInt32 inCounter);
+
+	// A histogram in seconds, one set of series per thread
+	static void     WriteHistogram(StringFormatter* ioOut, const char* inName, const char* inHelp, UInt32 inHistogram);
+
+	// Puts inValue into ioOut as a label value: \, " and newlines escaped
+	static void     PutLabelValue(StringFormatter* ioOut, const char* inValue);
+
+private:
+
+	static Shard*   GetShard();
+	static void     MakeKey();
+#ifndef __Win32__
+	static void     OrphanShard(void* inShard) { ((Shard*)inShard)->fIsOrphaned = true; }
+#endif
+
+	static OSMutex  sShardsMutex;   // held to add a shard or take over an orphaned one
+	static Shard* volatile sShards;
+	static UInt32   sNumShards;
+	static UInt32   sMaxGenerations[kMaxCounters];
+
+#ifdef __Win32__
+	static DWORD            sShardKey;
+#else
+	static pthread_once_t   sKeyOnce;
+	static pthread_key_t    sShardKey;
+#endif
+};
+
+#endif //_OSCOUNTERS_H_
@@ -0,0 +1,47 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSEpoch.cpp
+
+	Contains:   Implements OSEpoch
+*/
+
+#include "OSEpoch.h"
+#include "OSThread.h"
+
+void OSEpoch::Synchronize()
+{
+	//the caller's new copy has to be visible before we look at the counters
+	atomic_barrier();
+
+	UInt32 theCurrent = fEpoch & 1;
+
+	//A reader that sampled the epoch just before the previous flip can have landed on
+	//the other counter after that Synchronize stopped watching it, and may still hold
+	//what the caller is replacing now. Wait those out first.
+	this->WaitForReaders(theCurrent ^ 1);
+
+	//flip, so new read sections stop adding to the counter we are about to wait on
+	(void)atomic_add(&fEpoch, 1);
+	this->WaitForReaders(theCurrent);
+}
+
+void OSEpoch::WaitForReaders(UInt32 inIndex)
+{
+	volatile unsigned int* theCount = &fReaders[inIndex].fCount;
+	for (UInt32 theSpins = 0; *theCount != 0; theSpins++)
+	{
+		if (theSpins < kSpinsBeforeSleep)
+			OSThread::ThreadYield();
+		else
+			OSThread::Sleep(1);
+	}
+
+	//nothing the readers did may be reordered past here
+	atomic_barrier();
+}
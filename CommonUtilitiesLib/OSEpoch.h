@@ -0,0 +1,85 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSEpoch.h
+
+	Contains:   Read-copy-update for data that is read far more often than it changes.
+
+				Readers bracket their accesses with Enter/Exit (or an OSEpochReader)
+				and never block. A writer builds a new copy, publishes it with a
+				single pointer store, then calls Synchronize, which returns once
+				every read section that could still see the old copy has ended.
+				The old copy can be freed after that.
+
+				Read sections are counted on one of two counters, picked by the
+				low bit of the epoch. Synchronize flips the epoch, so readers
+				arriving after the flip land on the other counter and cannot keep
+				the writer waiting forever.
+
+				Writers must be serialized by the caller. Read sections must not
+				call Synchronize on the same OSEpoch, and must not block on
+				anything the writer holds while it synchronizes.
+*/
+
+#ifndef _OSEPOCH_H_
+#define _OSEPOCH_H_
+
+#include "OSHeaders.h"
+#include "atomic.h"
+
+class OSEpoch
+{
+public:
+
+	OSEpoch() : fEpoch(0) { fReaders[0].fCount = 0; fReaders[1].fCount = 0; }
+	~OSEpoch() {}
+
+	//Returns the counter the read section was put on, hand it back to Exit
+	UInt32  Enter()
+	{
+		UInt32 theIndex = fEpoch & 1;
+		(void)atomic_add(&fReaders[theIndex].fCount, 1);    //full barrier
+		return theIndex;
+	}
+	void    Exit(UInt32 inIndex) { (void)atomic_sub(&fReaders[inIndex].fCount, 1); }
+
+	//Waits out every read section that began before the call
+	void    Synchronize();
+
+private:
+
+	enum
+	{
+		kSpinsBeforeSleep = 100     //UInt32
+	};
+
+	void    WaitForReaders(UInt32 inIndex);
+
+	//each counter gets a cache line of its own so the two don't bounce together
+	struct Counter
+	{
+		unsigned int    fCount;
+		unsigned int    fPad[15];
+	};
+
+	unsigned int    fEpoch;     // unsigned int because we need to atomic_add
+	Counter         fReaders[2];
+};
+
+class OSEpochReader
+{
+public:
+	OSEpochReader(OSEpoch* inEpoch) : fEpoch(inEpoch), fIndex(inEpoch->Enter()) {}
+	~OSEpochReader() { fEpoch->Exit(fIndex); }
+
+private:
+	OSEpoch*    fEpoch;
+	UInt32      fIndex;
+};
+
+#endif //_OSEPOCH_H_
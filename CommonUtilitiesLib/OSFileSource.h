@@ -38,123 +38,16 @@
 
 #include "OSHeaders.h"
 #include "StrPtrLen.h"
-#include "OSQueue.h"
+#include "OSMutex.h"
+#include "OSBlockCache.h"
 
 #define READ_LOG 0
 
-class FileBlockBuffer
-{
-
-public:
-	FileBlockBuffer() : fArrayIndex(-1), fBufferSize(0), fBufferFillSize(0), fDataBuffer(NULL), fDummy(0) {}
-	~FileBlockBuffer();
-	void AllocateBuffer(UInt32 buffSize);
-	void TestBuffer();
-	void CleanBuffer() const
-	{ ::memset(fDataBuffer, 0, fBufferSize); }
-	void SetFillSize(UInt32 fillSize) { fBufferFillSize = fillSize; }
-	UInt32 GetFillSize() const
-	{ return fBufferFillSize; }
-	OSQueueElem* GetQElem() { return &fQElem; }
-	SInt64              fArrayIndex;
-	UInt32              fBufferSize;
-	UInt32              fBufferFillSize;
-	char*				fDataBuffer;
-	OSQueueElem         fQElem;
-	UInt32              fDummy;
-};
-
-class FileBlockPool
-{
-	enum
-	{
-		kDataBufferUnitSizeExp = 15,// base 2 exponent
-		kBufferUnitSize = (1 << kDataBufferUnitSizeExp) // 32Kbytes
-	};
-
-public:
-	FileBlockPool() : fMaxBuffers(1), fNumCurrentBuffers(0), fBufferInc(0), fBufferUnitSizeBytes(kBufferUnitSize), fBufferDataSizeBytes(0)
-	{}
-	~FileBlockPool();
-
-	void SetMaxBuffers(UInt32 maxBuffers) { if (maxBuffers > 0) fMaxBuffers = maxBuffers; }
-
-	void SetBuffIncValue(UInt32 bufferInc) { if (bufferInc > 0) fBufferInc = bufferInc; }
-	void IncMaxBuffers() { fMaxBuffers += fBufferInc; }
-	void DecMaxBuffers() { if (fMaxBuffers > fBufferInc) fMaxBuffers -= fBufferInc; }
-	void DecCurBuffers() { if (fNumCurrentBuffers > 0) fNumCurrentBuffers--; }
-
-	void SetBufferUnitSize(UInt32 inUnitSizeInK) { fBufferUnitSizeBytes = inUnitSizeInK * 1024; }
-	UInt32 GetBufferUnitSizeBytes() const
-	{ return fBufferUnitSizeBytes; }
-	UInt32 GetMaxBuffers() const
-	{ return fMaxBuffers; }
-	UInt32 GetIncBuffers() const
-	{ return fBufferInc; }
-	UInt32 GetNumCurrentBuffers() const
-	{ return fNumCurrentBuffers; }
-	void DeleteBlockPool();
-	FileBlockBuffer* GetBufferElement(UInt32 bufferSizeBytes);
-	void MarkUsed(FileBlockBuffer* inBuffPtr);
-
-private:
-	OSQueue fQueue;
-	UInt32  fMaxBuffers;
-	UInt32  fNumCurrentBuffers;
-	UInt32  fBufferInc;
-	UInt32  fBufferUnitSizeBytes;
-	UInt32  fBufferDataSizeBytes;
-
-};
-
-class FileMap
-{
-
-public:
-	FileMap() :fFileMapArray(NULL), fDataBufferSize(0), fMapArraySize(0), fNumBuffSizeUnits(0) {}
-	~FileMap() { fFileMapArray = NULL; }
-	void    AllocateBufferMap(UInt32 inUnitSizeInK, UInt32 inNumBuffSizeUnits, UInt32 inBufferIncCount, UInt32 inMaxBitRateBuffSizeInBlocks, UInt64 fileLen, UInt32 inBitRate);
-	char*   GetBuffer(SInt64 bufIndex, bool* outIsEmptyBuff);
-	void    TestBuffer(SInt32 bufIndex) const
-	{ Assert(bufIndex >= 0); fFileMapArray[bufIndex]->TestBuffer(); };
-	void    SetIndexBuffFillSize(SInt32 bufIndex, UInt32 fillSize) const
-	{ Assert(bufIndex >= 0); fFileMapArray[bufIndex]->SetFillSize(fillSize); }
-	UInt32  GetMaxBufSize() const
-	{ return fDataBufferSize; }
-	UInt32  GetBuffSize(SInt64 bufIndex) const
-	{ Assert(bufIndex >= 0); return fFileMapArray[bufIndex]->GetFillSize(); }
-	UInt32  GetIncBuffers() const
-	{ return fBlockPool.GetIncBuffers(); }
-	void    IncMaxBuffers() { fBlockPool.IncMaxBuffers(); }
-	void    DecMaxBuffers() { fBlockPool.DecMaxBuffers(); }
-	bool  Initialized() const
-	{ return fFileMapArray == NULL ? false : true; }
-	void    Clean();
-	void    DeleteMap();
-	void    DeleteOldBuffs();
-	SInt64  GetBuffIndex(UInt64 inPosition) const
-	{ return inPosition / this->GetMaxBufSize(); }
-	SInt64  GetMaxBuffIndex() const
-	{ Assert(fMapArraySize > 0); return fMapArraySize - 1; }
-	UInt64  GetBuffOffset(SInt64 bufIndex) const
-	{ return static_cast<UInt64>(bufIndex * this->GetMaxBufSize()); }
-	FileBlockPool fBlockPool;
-
-	FileBlockBuffer**   fFileMapArray;
-
-private:
-
-	UInt32              fDataBufferSize;
-	SInt64              fMapArraySize;
-	UInt32              fNumBuffSizeUnits;
-
-};
-
 class OSFileSource
 {
 public:
 
-	OSFileSource() : fFile(-1), fLength(0), fPosition(0), fReadPos(0), fShouldClose(true), fIsDir(false), fModDate(0), fCacheEnabled(false)
+	OSFileSource() : fFile(-1), fLength(0), fPosition(0), fReadPos(0), fShouldClose(true), fIsDir(false), fModDate(0), fCachedFile(NULL), fCacheBitRate(0), fCacheEnabled(false)
 	{
 
 #if READ_LOG 
@@ -165,7 +58,7 @@ public:
 
 	}
 
-	OSFileSource(const char* inPath) : fFile(-1), fLength(0), fPosition(0), fReadPos(0), fShouldClose(true), fIsDir(false), fCacheEnabled(false)
+	OSFileSource(const char* inPath) : fFile(-1), fLength(0), fPosition(0), fReadPos(0), fShouldClose(true), fIsDir(false), fCachedFile(NULL), fCacheBitRate(0), fCacheEnabled(false)
 	{
 		Set(inPath);
 
@@ -177,7 +70,7 @@ public:
 
 	}
 
-	~OSFileSource() { Close();  fFileMap.DeleteMap(); }
+	~OSFileSource() { Close(); }
 
 	//Sets this object to reference this file
 	void            Set(const char* inPath);
@@ -201,14 +94,15 @@ public:
 	void        EnableFileCache(bool enabled) { OSMutexLocker locker(&fMutex); fCacheEnabled = enabled; }
 	bool      GetCacheEnabled() const
 	{ return fCacheEnabled; }
-	void        AllocateFileCache(UInt32 inUnitSizeInK = 32, UInt32 bufferSizeUnits = 0, UInt32 incBuffers = 1, UInt32 inMaxBitRateBuffSizeInBlocks = 8, UInt32 inBitRate = 32768)
+	//Reads go through the shared OSBlockCache, reading ahead for inBitRate (bits per second).
+	//Does nothing if the block cache is off.
+	void        AllocateFileCache(UInt32 inBitRate = 0)
 	{
-		fFileMap.AllocateBufferMap(inUnitSizeInK, bufferSizeUnits, incBuffers, inMaxBitRateBuffSizeInBlocks, fLength, inBitRate);
+		OSMutexLocker locker(&fMutex);
+		if (fCachedFile == NULL)
+			fCachedFile = OSBlockCache::OpenFile(fFile);
+		fCacheBitRate = inBitRate;
 	}
-	void        IncMaxBuffers() { OSMutexLocker locker(&fMutex); fFileMap.IncMaxBuffers(); }
-	void        DecMaxBuffers() { OSMutexLocker locker(&fMutex); fFileMap.DecMaxBuffers(); }
-
-	OS_Error    FillBuffer(char* ioBuffer, char* buffStart, SInt32 bufIndex);
 
 	void            Close();
 	time_t          GetModDate() const
@@ -244,7 +138,8 @@ private:
 
 
 	OSMutex fMutex;
-	FileMap fFileMap;
+	OSCachedFile* fCachedFile;
+	UInt32  fCacheBitRate;
 	bool  fCacheEnabled;
 #if READ_LOG
 	FILE*               fFileLog;
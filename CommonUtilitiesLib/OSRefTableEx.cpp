@@ -7,70 +7,355 @@
 
 #include"OSRefTableEx.h"
 #include <errno.h>
+#include "atomic.h"
 
-OSRefTableEx::OSRefEx * OSRefTableEx::Resolve(const string& key)//ö󣬴ڷָ룬򷵻NULL
+OSRefTableEx::OSRefEx::OSRefEx(const string& key, UInt32 hash, void* pobject)
+	: m_Key(key), m_Hash(hash), mp_Object(pobject), m_Count(0), m_Removed(0), m_Next(NULL)
 {
-	OSMutexLocker locker(&m_Mutex);
-	if (m_Map.find(key) == m_Map.end())//
-		return NULL;
-	m_Map[key]->AddRef(1);
+	for (UInt32 x = 0; x < kNumIndexes; x++)
+	{
+		m_IndexValue[x] = 0;
+		m_IndexNext[x] = NULL;
+		m_IndexPrev[x] = NULL;
+	}
+}
+
+OSRefTableEx::OSRefTableEx(UInt32 inNumBuckets)
+	: m_BucketMask(0), m_NumRefs(0)
+{
+	UInt32 theBucketsPerShard = 1;
+	while (theBucketsPerShard * kNumShards < inNumBuckets)
+		theBucketsPerShard <<= 1;
+	m_BucketMask = theBucketsPerShard - 1;
 
-	return m_Map[key];
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		m_Shards[x].m_Buckets = new OSRefEx*[theBucketsPerShard];
+		::memset(m_Shards[x].m_Buckets, 0, theBucketsPerShard * sizeof(OSRefEx*));
+	}
 }
 
-OS_Error OSRefTableEx::Release(const string& key)//ͷ
+OSRefTableEx::~OSRefTableEx()
 {
-	OSMutexLocker locker(&m_Mutex);
-	if (m_Map.find(key) == m_Map.end())//
-		return EPERM;
-	//make sure to wakeup anyone who may be waiting for this resource to be released
-	m_Map[key]->AddRef(-1);//
-	m_Map[key]->GetCondPtr()->Signal();
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		for (UInt32 y = 0; y <= m_BucketMask; y++)
+		{
+			OSRefEx* theRef = m_Shards[x].m_Buckets[y];
+			while (theRef != NULL)
+			{
+				OSRefEx* theNext = theRef->m_Next;
+				delete theRef;
+				theRef = theNext;
+			}
+		}
+		delete[] m_Shards[x].m_Buckets;
+	}
+}
+
+UInt32 OSRefTableEx::HashKey(const string& key)
+{
+	//FNV-1a
+	UInt32 theHash = 2166136261U;
+	for (string::size_type x = 0; x < key.size(); x++)
+	{
+		theHash ^= (UInt8)key[x];
+		theHash *= 16777619U;
+	}
+	return theHash;
+}
+
+OSRefTableEx::OSRefEx* OSRefTableEx::Find(Shard* inShard, const string& key, UInt32 hash)
+{
+	//the chains change under readers that hold no lock, so every link is read once, through volatile
+	OSRefEx* theRef = *(OSRefEx* volatile*)this->GetBucket(inShard, hash);
+	while (theRef != NULL)
+	{
+		if ((theRef->m_Hash == hash) && (theRef->m_Key == key))
+			return theRef;
+		theRef = *(OSRefEx* volatile*)&theRef->m_Next;
+	}
+	return NULL;
+}
+
+bool OSRefTableEx::Unref(OSRefEx* ref)
+{
+	//atomic_sub is a full barrier. UnRegister sets m_Removed and then reads m_Count,
+	//so either it sees our reference gone or we see it waiting.
+	if (atomic_sub(&ref->m_Count, 1) != 0)
+		return false;
+	return *(volatile unsigned int*)&ref->m_Removed != 0;
+}
+
+void OSRefTableEx::Wake(Shard* inShard)
+{
+	OSMutexLocker locker(&inShard->m_Mutex);
+	inShard->m_Cond.Broadcast();
+}
+
+OSRefTableEx::OSRefEx* OSRefTableEx::Resolve(const string& key)
+{
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+	bool wake = false;
+	{
+		OSEpochReader reader(&theShard->m_Epoch);
+		OSRefEx* theRef = this->Find(theShard, key, theHash);
+		if ((theRef == NULL) || (*(volatile unsigned int*)&theRef->m_Removed != 0))
+			return NULL;
 
+		(void)atomic_add(&theRef->m_Count, 1);
+		if (*(volatile unsigned int*)&theRef->m_Removed == 0)
+			return theRef;
+
+		//lost the race with UnRegister, give the reference back
+		wake = Unref(theRef);
+	}
+
+	//outside the read section, UnRegister holds the mutex while it synchronizes
+	if (wake)
+		Wake(theShard);
+	return NULL;
+}
+
+OS_Error OSRefTableEx::Release(const string& key)
+{
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+	bool wake = false;
+	{
+		OSEpochReader reader(&theShard->m_Epoch);
+		OSRefEx* theRef = this->Find(theShard, key, theHash);
+		if (theRef == NULL)
+			return EPERM;
+		Assert(theRef->m_Count > 0);
+		wake = Unref(theRef);
+	}
+
+	if (wake)
+		Wake(theShard);
 	return OS_NoErr;
 }
 
-OS_Error OSRefTableEx::Register(const string& key, void* pObject)//뵽map
+void OSRefTableEx::Release(OSRefEx* ref)
+{
+	Shard* theShard = this->GetShard(ref->m_Hash);
+	bool wake = false;
+	{
+		//once the count drops ref may be freed by UnRegister, the read section holds that off
+		OSEpochReader reader(&theShard->m_Epoch);
+		wake = Unref(ref);
+	}
+
+	if (wake)
+		Wake(theShard);
+}
+
+OS_Error OSRefTableEx::Register(const string& key, void* pObject, SInt32 inIndex0, SInt32 inIndex1)
 {
 	Assert(pObject != NULL);
 	if (pObject == NULL)
 		return EPERM;
 
-	OSMutexLocker locker(&m_Mutex);//
-	if (m_Map.find(key) != m_Map.end())//Ѿ֣ܾظkey
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+
+	OSMutexLocker locker(&theShard->m_Mutex);
+	if (this->Find(theShard, key, theHash) != NULL)//refuse a duplicate key, even one being unregistered
 		return EPERM;
-	OSRefEx *RefTemp = new OSRefEx(pObject);//valueڴnewUnRegisterdelete
-	m_Map[key] = RefTemp;//뵽map
 
+	OSRefEx* theRef = new OSRefEx(key, theHash, pObject);
+	theRef->m_IndexValue[0] = inIndex0;
+	theRef->m_IndexValue[1] = inIndex1;
+	AddToIndexes(theShard, theRef);
+
+	//the entry has to be complete before readers can reach it
+	OSRefEx** theBucket = this->GetBucket(theShard, theHash);
+	theRef->m_Next = *theBucket;
+	atomic_barrier();
+	*(OSRefEx* volatile*)theBucket = theRef;
+
+	(void)atomic_add(&m_NumRefs, 1);
 	return OS_NoErr;
 }
 
-OS_Error OSRefTableEx::UnRegister(const string& key)//mapƳüΪ0Ƴ
+void OSRefTableEx::Remove(Shard* inShard, OSRefEx* ref)
 {
-	OSMutexLocker locker(&m_Mutex);
-	if (m_Map.find(key) == m_Map.end())//ڵǰkey
+	//with the shard mutex held, and every reference to ref released
+
+	RemoveFromIndexes(inShard, ref);
+
+	OSRefEx** theLink = this->GetBucket(inShard, ref->m_Hash);
+	while (*theLink != ref)
+		theLink = &(*theLink)->m_Next;
+	*(OSRefEx* volatile*)theLink = ref->m_Next;
+
+	(void)atomic_sub(&m_NumRefs, 1);
+
+	//readers may still be walking through ref
+	inShard->m_Epoch.Synchronize();
+	delete ref;
+}
+
+OS_Error OSRefTableEx::UnRegister(const string& key)
+{
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+
+	OSMutexLocker locker(&theShard->m_Mutex);
+	OSRefEx* theRef = this->Find(theShard, key, theHash);
+	if ((theRef == NULL) || theRef->m_Removed)
 		return EPERM;
-	//make sure that no one else is using the object
-	while (m_Map[key]->GetRefNum() > 0)
-		m_Map[key]->GetCondPtr()->Wait(&m_Mutex);
 
-	delete m_Map[key];//ͷ
-	m_Map.erase(key);//Ƴ
+	//stop new Resolves, then make sure that no one else is using the object
+	theRef->m_Removed = 1;
+	atomic_barrier();
+	while (*(volatile unsigned int*)&theRef->m_Count > 0)
+		theShard->m_Cond.Wait(&theShard->m_Mutex);
 
+	this->Remove(theShard, theRef);
 	return OS_NoErr;
 }
 
 OS_Error OSRefTableEx::TryUnRegister(const string& key)
 {
-	OSMutexLocker locker(&m_Mutex);
-	if (m_Map.find(key) == m_Map.end())//ڵǰkey
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+
+	OSMutexLocker locker(&theShard->m_Mutex);
+	OSRefEx* theRef = this->Find(theShard, key, theHash);
+	if ((theRef == NULL) || theRef->m_Removed)
 		return EPERM;
-	if (m_Map[key]->GetRefNum() > 0)
+
+	theRef->m_Removed = 1;
+	atomic_barrier();
+	if (*(volatile unsigned int*)&theRef->m_Count > 0)
+	{
+		//a Resolve got in first, leave the entry as it was
+		theRef->m_Removed = 0;
+		return EPERM;
+	}
+
+	this->Remove(theShard, theRef);
+	return OS_NoErr;
+}
+
+OS_Error OSRefTableEx::SetIndexValues(const string& key, SInt32 inIndex0, SInt32 inIndex1)
+{
+	UInt32 theHash = HashKey(key);
+	Shard* theShard = this->GetShard(theHash);
+
+	OSMutexLocker locker(&theShard->m_Mutex);
+	OSRefEx* theRef = this->Find(theShard, key, theHash);
+	if (theRef == NULL)
 		return EPERM;
-	// At this point, this is guarenteed not to block, because
-	// we've already checked that the refCount is low.
-	delete m_Map[key];//ͷ
-	m_Map.erase(key);//Ƴ
 
+	if ((theRef->m_IndexValue[0] != inIndex0) || (theRef->m_IndexValue[1] != inIndex1))
+	{
+		RemoveFromIndexes(theShard, theRef);
+		theRef->m_IndexValue[0] = inIndex0;
+		theRef->m_IndexValue[1] = inIndex1;
+		AddToIndexes(theShard, theRef);
+	}
 	return OS_NoErr;
-}
\ No newline at end of file
+}
+
+void OSRefTableEx::AddToIndexes(Shard* inShard, OSRefEx* ref)
+{
+	for (UInt32 x = 0; x < kNumIndexes; x++)
+	{
+		OSRefEx*& theHead = inShard->m_Indexes[x][ref->m_IndexValue[x]];
+		ref->m_IndexPrev[x] = NULL;
+		ref->m_IndexNext[x] = theHead;
+		if (theHead != NULL)
+			theHead->m_IndexPrev[x] = ref;
+		theHead = ref;
+	}
+}
+
+void OSRefTableEx::RemoveFromIndexes(Shard* inShard, OSRefEx* ref)
+{
+	for (UInt32 x = 0; x < kNumIndexes; x++)
+	{
+		if (ref->m_IndexNext[x] != NULL)
+			ref->m_IndexNext[x]->m_IndexPrev[x] = ref->m_IndexPrev[x];
+
+		if (ref->m_IndexPrev[x] != NULL)
+			ref->m_IndexPrev[x]->m_IndexNext[x] = ref->m_IndexNext[x];
+		else if (ref->m_IndexNext[x] != NULL)
+			inShard->m_Indexes[x][ref->m_IndexValue[x]] = ref->m_IndexNext[x];
+		else
+			inShard->m_Indexes[x].erase(ref->m_IndexValue[x]);
+
+		ref->m_IndexNext[x] = NULL;
+		ref->m_IndexPrev[x] = NULL;
+	}
+}
+
+OSRefTableEx::Snapshot* OSRefTableEx::GetSnapshot(UInt32 inIndex, const SInt32* inValues, UInt32 inNumValues)
+{
+	Assert(inIndex < kNumIndexes);
+
+	Snapshot* theSnapshot = new Snapshot;
+	theSnapshot->m_Refs.reserve(m_NumRefs);
+
+	//every shard is held at once so the snapshot is the table at a single instant.
+	//This only stops writers, and only for as long as it takes to copy pointers.
+	for (UInt32 x = 0; x < kNumShards; x++)
+		m_Shards[x].m_Mutex.Lock();
+
+	for (UInt32 x = 0; x < kNumShards; x++)
+	{
+		Shard* theShard = &m_Shards[x];
+		if (inNumValues == 0)
+		{
+			for (UInt32 y = 0; y <= m_BucketMask; y++)
+			{
+				for (OSRefEx* theRef = theShard->m_Buckets[y]; theRef != NULL; theRef = theRef->m_Next)
+				{
+					if (theRef->m_Removed)
+						continue;
+					(void)atomic_add(&theRef->m_Count, 1);
+					theSnapshot->m_Refs.push_back(theRef);
+				}
+			}
+			continue;
+		}
+
+		for (UInt32 y = 0; y < inNumValues; y++)
+		{
+			bool duplicate = false;
+			for (UInt32 z = 0; z < y; z++)
+				duplicate |= (inValues[z] == inValues[y]);
+			if (duplicate)
+				continue;
+
+			IndexMap::iterator theIter = theShard->m_Indexes[inIndex].find(inValues[y]);
+			if (theIter == theShard->m_Indexes[inIndex].end())
+				continue;
+
+			for (OSRefEx* theRef = theIter->second; theRef != NULL; theRef = theRef->m_IndexNext[inIndex])
+			{
+				if (theRef->m_Removed)
+					continue;
+				(void)atomic_add(&theRef->m_Count, 1);
+				theSnapshot->m_Refs.push_back(theRef);
+			}
+		}
+	}
+
+	for (UInt32 x = kNumShards; x > 0; x--)
+		m_Shards[x - 1].m_Mutex.Unlock();
+
+	return theSnapshot;
+}
+
+void OSRefTableEx::ReleaseSnapshot(Snapshot* inSnapshot)
+{
+	if (inSnapshot == NULL)
+		return;
+
+	for (UInt32 x = 0; x < inSnapshot->GetNumRefs(); x++)
+		this->Release(inSnapshot->GetRef(x));
+	delete inSnapshot;
+}
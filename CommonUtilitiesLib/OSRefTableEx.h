@@ -1,51 +1,149 @@
+/*
+	Copyleft (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.EasyDarwin.org
+*/
+/*
+	File:       OSRefTableEx.h
+
+	Contains:   A registry of refcounted objects keyed by string.
+
+				Keys hash to one of kNumShards shards. Each shard has its own
+				chained hash table, mutex and OSEpoch. Register, UnRegister and
+				snapshots take the shard mutex. Resolve and Release take no lock
+				at all: they walk the chains inside an epoch read section, and a
+				removed entry is only freed once those sections have ended.
+
+				An object cannot be unregistered while it is resolved. UnRegister
+				hides the entry from new Resolves and then waits for the
+				references already taken to be released.
+
+				Every entry carries kNumIndexes small integer values (EasyCMS
+				puts the app type and terminal type there). A snapshot can be
+				limited to the entries holding given values of one index, and
+				then walks only those entries instead of the whole table.
+*/
+
 #ifndef _OSREFTABLEEX_H_
 #define _OSREFTABLEEX_H_
 
-//Ϊdarwinñͬkeyַhashֲһ㡣˿ʹSTLеmapд档
-//עǺϵģDarwinԴ
-#include<map>
-#include<string>
+#include <map>
+#include <string>
+#include <vector>
 using namespace std;
 
 #include "OSCond.h"
+#include "OSEpoch.h"
 #include "OSHeaders.h"
 
 class OSRefTableEx
 {
 public:
+
+	enum
+	{
+		kNumShards = 64,                // UInt32, a power of 2
+		kNumIndexes = 2,                // UInt32
+		kDefaultNumBuckets = 65536      // UInt32, across all shards
+	};
+
 	class OSRefEx
 	{
+	public:
+
+		void*           GetObjectPtr() const { return mp_Object; }
+		const string&   GetKey() const { return m_Key; }
+		int             GetRefNum() const { return m_Count; }
+		SInt32          GetIndexValue(UInt32 inIndex) const { return m_IndexValue[inIndex]; }
 
+	private:
+
+		friend class OSRefTableEx;
+
+		OSRefEx(const string& key, UInt32 hash, void* pobject);
+
+		string          m_Key;
+		UInt32          m_Hash;
+		void*           mp_Object;
+		unsigned int    m_Count;        // references taken by Resolve and snapshots
+		unsigned int    m_Removed;      // set by UnRegister, hides the entry from Resolve
+
+		OSRefEx*        m_Next;         // hash chain, walked without the shard mutex
+
+		SInt32          m_IndexValue[kNumIndexes];
+		OSRefEx*        m_IndexNext[kNumIndexes];   // lists of entries holding the same value
+		OSRefEx*        m_IndexPrev[kNumIndexes];
+	};
+
+	// Refs taken from the whole table at one instant. Every ref in it stays
+	// resolved until the snapshot is handed back to ReleaseSnapshot.
+	class Snapshot
+	{
 	public:
-		OSRefEx() : mp_Object(NULL), m_Count(0) {}
-		OSRefEx(void* pobject) : mp_Object(pobject), m_Count(0) {}
-		void* GetObjectPtr() const { return mp_Object; }
-		int GetRefNum() const { return m_Count; }
-		OSCond* GetCondPtr() { return &m_Cond; }
-		void AddRef(int num) { m_Count += num; }
+
+		UInt32      GetNumRefs() const { return m_Refs.size(); }
+		OSRefEx*    GetRef(UInt32 inIndex) const { return m_Refs[inIndex]; }
 
 	private:
-		void* mp_Object;//õĶ
-		int m_Count;//ǰöֻΪ0ʱ
-		OSCond  m_Cond;//to block threads waiting for this ref.
+
+		friend class OSRefTableEx;
+
+		vector<OSRefEx*>    m_Refs;
 	};
 
-	OSRefEx*     Resolve(const string& key);//ö
-	OS_Error     Release(const string& key);//ͷ
-	OS_Error     Register(const string& key, void* pObject);//뵽map
-	OS_Error     UnRegister(const string& key);//mapƳ
+	OSRefTableEx(UInt32 inNumBuckets = kDefaultNumBuckets);
+	~OSRefTableEx();
+
+	OSRefEx*     Resolve(const string& key);//returns NULL if key is not registered, pair with Release
+	OS_Error     Release(const string& key);
+	void         Release(OSRefEx* ref);
+	OS_Error     Register(const string& key, void* pObject, SInt32 inIndex0 = 0, SInt32 inIndex1 = 0);
+	OS_Error     UnRegister(const string& key);//blocks until every reference is released
+
+	OS_Error     TryUnRegister(const string& key);//fails instead of blocking if key is resolved
+
+	// Moves key to new index values, e.g. after a device re-registers as another type
+	OS_Error     SetIndexValues(const string& key, SInt32 inIndex0, SInt32 inIndex1);
+
+	int          GetEleNumInMap() const { return m_NumRefs; }
 
-	OS_Error TryUnRegister(const string& key);//ƳΪ0,Ƴtrue򷵻false
-	int GetEleNumInMap() const { return m_Map.size(); }//mapеԪظ
-	OSMutex *GetMutex() { return &m_Mutex; }//ṩӿ
-	map<string, OSRefEx*> *GetMap() { return &m_Map; }
+	// With inNumValues 0 the snapshot holds every entry. Otherwise it holds the
+	// entries whose index inIndex is one of inValues.
+	Snapshot*    GetSnapshot(UInt32 inIndex = 0, const SInt32* inValues = NULL, UInt32 inNumValues = 0);
+	void         ReleaseSnapshot(Snapshot* inSnapshot);
 
 private:
-	map<string, OSRefEx*> m_Map;//stringΪkeyOSRefExΪvalue
-	OSMutex         m_Mutex;//ṩmapĻ
+
+	typedef map<SInt32, OSRefEx*> IndexMap;    // value -> first entry holding it
+
+	struct Shard
+	{
+		OSMutex         m_Mutex;
+		OSCond          m_Cond;         // UnRegister waits here for references to go
+		OSEpoch         m_Epoch;
+		OSRefEx**       m_Buckets;
+		IndexMap        m_Indexes[kNumIndexes];
+	};
+
+	static UInt32   HashKey(const string& key);
+
+	Shard*      GetShard(UInt32 hash) { return &m_Shards[hash & (kNumShards - 1)]; }
+	OSRefEx**   GetBucket(Shard* inShard, UInt32 hash) { return &inShard->m_Buckets[(hash / kNumShards) & m_BucketMask]; }
+	OSRefEx*    Find(Shard* inShard, const string& key, UInt32 hash);
+
+	// Drops a reference. Returns true if an UnRegister may be waiting on it.
+	static bool Unref(OSRefEx* ref);
+	static void Wake(Shard* inShard);
+
+	static void AddToIndexes(Shard* inShard, OSRefEx* ref);
+	static void RemoveFromIndexes(Shard* inShard, OSRefEx* ref);
+	void        Remove(Shard* inShard, OSRefEx* ref);
+
+	Shard           m_Shards[kNumShards];
+	UInt32          m_BucketMask;   // buckets per shard, minus one
+	unsigned int    m_NumRefs;
 };
-typedef map<string, OSRefTableEx::OSRefEx*> OSHashMap;
-typedef map<string, OSRefTableEx::OSRefEx*>::iterator OSRefIt;
 
 class OSRefReleaserEx
 {
@@ -60,4 +158,15 @@ private:
 	string			fOSRefKey;
 };
 
-#endif //_OSREFTABLEEX_H_
\ No newline at end of file
+class OSRefSnapshotReleaserEx
+{
+public:
+	OSRefSnapshotReleaserEx(OSRefTableEx* pTable, OSRefTableEx::Snapshot* pSnapshot) : fOSRefTable(pTable), fSnapshot(pSnapshot) {}
+	~OSRefSnapshotReleaserEx() { fOSRefTable->ReleaseSnapshot(fSnapshot); }
+
+private:
+	OSRefTableEx*			fOSRefTable;
+	OSRefTableEx::Snapshot*	fSnapshot;
+};
+
+#endif //_OSREFTABLEEX_H_
@@ -0,0 +1,237 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSTimingWheel.cpp
+
+	Contains:   Implements a hierarchical timing wheel
+*/
+
+#include <string.h>
+
+#include "OSTimingWheel.h"
+#include "OS.h"
+#include "MyAssert.h"
+
+OSTimingWheel::OSTimingWheel()
+	: fExpired(NULL),
+	fCurrentTick(0),
+	fSize(0)
+{
+	::memset(fLevel0, 0, sizeof(fLevel0));
+	::memset(fLevelN, 0, sizeof(fLevelN));
+	::memset(fLevelCount, 0, sizeof(fLevelCount));
+}
+
+void OSTimingWheel::Link(OSTimerElem** inSlot, OSTimerElem* inElem, UInt32 inLevel)
+{
+	inElem->fNext = *inSlot;
+	if (inElem->fNext != NULL)
+		inElem->fNext->fPrevNext = &inElem->fNext;
+	inElem->fPrevNext = inSlot;
+	*inSlot = inElem;
+
+	inElem->fLevel = inLevel;
+	fLevelCount[inLevel]++;
+}
+
+void OSTimingWheel::Unlink(OSTimerElem* inElem)
+{
+	*inElem->fPrevNext = inElem->fNext;
+	if (inElem->fNext != NULL)
+		inElem->fNext->fPrevNext = inElem->fPrevNext;
+	inElem->fNext = NULL;
+	inElem->fPrevNext = NULL;
+
+	Assert(fLevelCount[inElem->fLevel] > 0);
+	fLevelCount[inElem->fLevel]--;
+}
+
+void OSTimingWheel::Place(OSTimerElem* inElem)
+{
+	SInt64 theExpires = inElem->fValue;
+	if (theExpires < fCurrentTick)
+	{
+		this->Link(&fExpired, inElem, kExpiredLevel);
+		return;
+	}
+
+	SInt64 theDelta = theExpires - fCurrentTick;
+	if (theDelta < kLevel0Size)
+	{
+		this->Link(&fLevel0[theExpires & (kLevel0Size - 1)], inElem, 0);
+		return;
+	}
+
+	//too far out for the wheel: park it in the last slot, it gets re-placed when it comes around
+	if (theDelta >= kMaxTicks)
+		theExpires = fCurrentTick + kMaxTicks - 1;
+
+	for (UInt32 theLevel = 1; theLevel < kNumLevels; theLevel++)
+	{
+		UInt32 theShift = kLevel0Bits + (theLevel * kLevelNBits);
+		if ((theDelta < ((SInt64)1 << theShift)) || (theLevel == kNumLevels - 1))
+		{
+			UInt32 theIndex = (UInt32)(theExpires >> (theShift - kLevelNBits)) & (kLevelNSize - 1);
+			this->Link(&fLevelN[theLevel - 1][theIndex], inElem, theLevel);
+			return;
+		}
+	}
+}
+
+void OSTimingWheel::Insert(OSTimerElem* inElem)
+{
+	Assert(inElem != NULL);
+	Assert(inElem->fCurrentWheel == NULL);
+
+	//An empty wheel has nothing to catch up on, so resynchronize it with the clock
+	//instead of cascading through every tick since it was last used.
+	if (fSize == 0)
+	{
+		SInt64 theCurrentTime = OS::Milliseconds();
+		if (fCurrentTick < theCurrentTime)
+			fCurrentTick = theCurrentTime;
+	}
+
+	inElem->fCurrentWheel = this;
+	fSize++;
+	this->Place(inElem);
+}
+
+OSTimerElem* OSTimingWheel::Remove(OSTimerElem* inElem)
+{
+	if ((inElem == NULL) || (inElem->fCurrentWheel != this))
+		return NULL;
+
+	this->Unlink(inElem);
+	inElem->fCurrentWheel = NULL;
+	fSize--;
+	return inElem;
+}
+
+void OSTimingWheel::Cascade(UInt32 inLevel, UInt32 inIndex)
+{
+	OSTimerElem** theSlot = &fLevelN[inLevel - 1][inIndex];
+	while (*theSlot != NULL)
+	{
+		OSTimerElem* theElem = *theSlot;
+		this->Unlink(theElem);
+		this->Place(theElem);
+	}
+}
+
+void OSTimingWheel::Advance(SInt64 inCurrentTime)
+{
+	while (fCurrentTick <= inCurrentTime)
+	{
+		if (fSize == fLevelCount[kExpiredLevel])
+		{
+			//nothing left on the wheel itself
+			fCurrentTick = inCurrentTime + 1;
+			return;
+		}
+
+		UInt32 theIndex = (UInt32)fCurrentTick & (kLevel0Size - 1);
+		if (theIndex == 0)
+		{
+			//level 0 wrapped, pull the next block of timers down from the upper levels
+			for (UInt32 theLevel = 1; theLevel < kNumLevels; theLevel++)
+			{
+				UInt32 theShift = kLevel0Bits + ((theLevel - 1) * kLevelNBits);
+				UInt32 theLevelIndex = (UInt32)(fCurrentTick >> theShift) & (kLevelNSize - 1);
+				this->Cascade(theLevel, theLevelIndex);
+				if (theLevelIndex != 0)
+					break;
+			}
+		}
+
+		if (fLevelCount[0] == 0)
+		{
+			//skip straight to the next wrap of level 0
+			SInt64 theNextWrap = (fCurrentTick | (kLevel0Size - 1)) + 1;
+			fCurrentTick = (theNextWrap <= inCurrentTime) ? theNextWrap : inCurrentTime + 1;
+			continue;
+		}
+
+		OSTimerElem** theSlot = &fLevel0[theIndex];
+		while (*theSlot != NULL)
+		{
+			OSTimerElem* theElem = *theSlot;
+			this->Unlink(theElem);
+			if (theElem->fValue <= fCurrentTick)
+				this->Link(&fExpired, theElem, kExpiredLevel);
+			else
+				this->Place(theElem);   //a timer that was parked past the end of the wheel
+		}
+		fCurrentTick++;
+	}
+}
+
+OSTimerElem* OSTimingWheel::ExtractExpired(SInt64 inCurrentTime)
+{
+	if (fSize == 0)
+		return NULL;
+
+	if (fExpired == NULL)
+		this->Advance(inCurrentTime);
+
+	OSTimerElem* theElem = fExpired;
+	if (theElem == NULL)
+		return NULL;
+
+	this->Unlink(theElem);
+	theElem->fCurrentWheel = NULL;
+	fSize--;
+	return theElem;
+}
+
+SInt64 OSTimingWheel::GetTimeToNextExpiry(SInt64 inCurrentTime)
+{
+	if (fSize == 0)
+		return -1;
+
+	if ((fExpired != NULL) || (fCurrentTick <= inCurrentTime))
+		return 0;
+
+	SInt64 theNextTick = -1;
+
+	if (fLevelCount[0] > 0)
+	{
+		for (UInt32 x = 0; x < kLevel0Size; x++)
+		{
+			if (fLevel0[(fCurrentTick + x) & (kLevel0Size - 1)] != NULL)
+			{
+				theNextTick = fCurrentTick + x;
+				break;
+			}
+		}
+	}
+
+	//timers in the upper levels need a wakeup when their slot cascades
+	for (UInt32 theLevel = 1; theLevel < kNumLevels; theLevel++)
+	{
+		if (fLevelCount[theLevel] == 0)
+			continue;
+
+		UInt32 theShift = kLevel0Bits + ((theLevel - 1) * kLevelNBits);
+		SInt64 theBlock = fCurrentTick >> theShift;
+		UInt32 theFirst = ((fCurrentTick & (((SInt64)1 << theShift) - 1)) == 0) ? 0 : 1;
+		for (UInt32 x = theFirst; x <= kLevelNSize; x++)
+		{
+			if (fLevelN[theLevel - 1][(theBlock + x) & (kLevelNSize - 1)] != NULL)
+			{
+				SInt64 theCascadeTick = (theBlock + x) << theShift;
+				if ((theNextTick < 0) || (theCascadeTick < theNextTick))
+					theNextTick = theCascadeTick;
+				break;
+			}
+		}
+	}
+
+	Assert(theNextTick >= fCurrentTick);
+	return theNextTick - inCurrentTime;
+}
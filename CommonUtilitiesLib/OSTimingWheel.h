@@ -0,0 +1,124 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       OSTimingWheel.h
+
+	Contains:   A hierarchical timing wheel with 1 millisecond ticks.
+
+				Insert and Remove are O(1). Timers are kept on intrusive lists in one
+				of four levels of slots:
+
+				level 0: 256 slots of 1ms        (the next 256ms)
+				level 1:  64 slots of 256ms      (~16 seconds)
+				level 2:  64 slots of 16.4s      (~17 minutes)
+				level 3:  64 slots of 17.5min    (~18 hours)
+
+				Each time level 0 wraps, the next slot of level 1 is redistributed
+				into level 0, and so on up. Timers further out than level 3 are parked
+				in its last slot and re-placed when they come around.
+
+				The wheel is not thread safe. Callers lock it themselves, or keep it
+				private to one thread.
+*/
+
+#ifndef _OSTIMINGWHEEL_H_
+#define _OSTIMINGWHEEL_H_
+
+#include <stddef.h>
+#include "OSHeaders.h"
+
+class OSTimingWheel;
+
+class OSTimerElem
+{
+public:
+	OSTimerElem(void* enclosingObject = NULL)
+		: fValue(0), fEnclosingObject(enclosingObject), fCurrentWheel(NULL), fNext(NULL), fPrevNext(NULL), fLevel(0) {}
+	~OSTimerElem() {}
+
+	//The value is the absolute time, in OS::Milliseconds(), at which the timer expires
+	void    SetValue(SInt64 newValue) { fValue = newValue; }
+	SInt64  GetValue() { return fValue; }
+	void*   GetEnclosingObject() { return fEnclosingObject; }
+	void    SetEnclosingObject(void* obj) { fEnclosingObject = obj; }
+	bool    IsMemberOfAnyWheel() { return fCurrentWheel != NULL; }
+	OSTimingWheel* GetCurrentWheel() { return fCurrentWheel; }
+
+private:
+
+	SInt64          fValue;
+	void*           fEnclosingObject;
+	OSTimingWheel*  fCurrentWheel;
+
+	//slot list links: fPrevNext points at whatever points at us
+	OSTimerElem*    fNext;
+	OSTimerElem**   fPrevNext;
+	UInt32          fLevel;
+
+	friend class OSTimingWheel;
+};
+
+class OSTimingWheel
+{
+public:
+
+	enum
+	{
+		kLevel0Bits = 8,                        //UInt32
+		kLevelNBits = 6,                        //UInt32
+		kNumLevels = 4,                         //UInt32
+		kLevel0Size = 1 << kLevel0Bits,         //UInt32
+		kLevelNSize = 1 << kLevelNBits,         //UInt32
+		kMaxTicks = 1 << (kLevel0Bits + 3 * kLevelNBits)   //SInt64, ~18.6 hours
+	};
+
+	OSTimingWheel();
+	~OSTimingWheel() {}
+
+	//ACCESSORS
+	UInt32          CurrentSize() { return fSize; }
+
+	//MODIFIERS
+
+	//Both run in constant time
+	void            Insert(OSTimerElem* inElem);
+	//Returns inElem, or NULL if inElem is not in this wheel
+	OSTimerElem*    Remove(OSTimerElem* inElem);
+
+	//Returns one timer whose value is <= inCurrentTime, or NULL if none are due.
+	//Call repeatedly to drain every expired timer.
+	OSTimerElem*    ExtractExpired(SInt64 inCurrentTime);
+
+	//How many milliseconds from inCurrentTime until ExtractExpired may return
+	//something. 0 if a timer is already due, -1 if the wheel is empty. The answer
+	//can be early (never late) when the next timer sits in levels 1-3.
+	SInt64          GetTimeToNextExpiry(SInt64 inCurrentTime);
+
+private:
+
+	enum
+	{
+		kExpiredLevel = kNumLevels  //UInt32
+	};
+
+	void            Advance(SInt64 inCurrentTime);
+	void            Place(OSTimerElem* inElem);
+	void            Cascade(UInt32 inLevel, UInt32 inIndex);
+	void            Link(OSTimerElem** inSlot, OSTimerElem* inElem, UInt32 inLevel);
+	void            Unlink(OSTimerElem* inElem);
+
+	OSTimerElem*    fLevel0[kLevel0Size];
+	OSTimerElem*    fLevelN[kNumLevels - 1][kLevelNSize];
+	OSTimerElem*    fExpired;
+
+	SInt64          fCurrentTick;   // next tick to be processed
+	UInt32          fSize;
+	UInt32          fLevelCount[kNumLevels + 1];
+};
+
+#endif //_OSTIMINGWHEEL_H_
@@ -47,6 +47,7 @@
 
 #include "Socket.h"
 #include "SocketUtils.h"
+#include "OSCounters.h"
 
 #ifdef USE_NETLOG
 #include <netlog.h>
@@ -60,7 +61,7 @@ typedef int socklen_t; // missing from some platform includes
 EventThread* Socket::sEventThread = NULL;
 
 Socket::Socket(Task *notifytask, UInt32 inSocketType)
-	: EventContext(EventContext::kInvalidFileDesc, sEventThread),
+	: EventContext(EventContext::kInvalidFileDesc, NULL),
 	fState(inSocketType),
 	fLocalAddrStrPtr(NULL),
 	fLocalDNSStrPtr(NULL),
@@ -310,11 +311,14 @@ OS_Error Socket::Send(const char* inData, const UInt32 inLength, UInt32* outLeng
 	do {
 		err = ::send(fFileDesc, inData, inLength, 0);//flags??
 	} while ((err == -1) && (OSThread::GetErrno() == EINTR));
+	OSCounters::Add(OSCounters::kSocketWrites, 1);
 	if (err == -1)
 	{
 		//Are there any errors that can happen if the client is connected?
 		//Yes... EAGAIN. Means the socket is now flow-controleld
 		int theErr = OSThread::GetErrno();
+		if (theErr == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketWritesWouldBlock, 1);
 		if ((theErr != EAGAIN) && (this->IsConnected()))
 			fState ^= kConnected;//turn off connected state flag
 		return (OS_Error)theErr;
@@ -342,11 +346,14 @@ OS_Error Socket::WriteV(const struct iovec* iov, const UInt32 numIOvecs, UInt32*
 		err = ::writev(fFileDesc, iov, numIOvecs);//flags??
 #endif
 	} while ((err == -1) && (OSThread::GetErrno() == EINTR));
+	OSCounters::Add(OSCounters::kSocketWrites, 1);
 	if (err == -1)
 	{
 		// Are there any errors that can happen if the client is connected?
 		// Yes... EAGAIN. Means the socket is now flow-controleld
 		int theErr = OSThread::GetErrno();
+		if (theErr == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketWritesWouldBlock, 1);
 		if ((theErr != EAGAIN) && (this->IsConnected()))
 			fState ^= kConnected;//turn off connected state flag
 		return (OS_Error)theErr;
@@ -371,11 +378,14 @@ OS_Error Socket::Read(void *buffer, const UInt32 length, UInt32 *outRecvLenP)
 		theRecvLen = ::recv(fFileDesc, (char*)buffer, length, 0);//flags??
 	} while ((theRecvLen == -1) && (OSThread::GetErrno() == EINTR));
 
+	OSCounters::Add(OSCounters::kSocketReads, 1);
 	if (theRecvLen == -1)
 	{
 		// Are there any errors that can happen if the client is connected?
 		// Yes... EAGAIN. Means the socket is now flow-controleld
 		int theErr = OSThread::GetErrno();
+		if (theErr == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketReadsWouldBlock, 1);
 		if ((theErr != EAGAIN) && (this->IsConnected()))
 			fState ^= kConnected;//turn off connected state flag
 		return (OS_Error)theErr;
@@ -56,9 +56,11 @@ public:
 		kNonBlockingSocketType = 1
 	};
 
-	// This class provides a global event thread.
-	static void Initialize() { sEventThread = new EventThread(); }
-	static void StartThread() { sEventThread->Start(); }
+	// This class provides the pool of event threads. Sockets pick one of them
+	// the first time they request an event. GetEventThread returns the first
+	// thread, for callers that want a fixed one.
+	static void Initialize(UInt32 inNumEventThreads = 1) { EventThreadPool::AddThreads(inNumEventThreads); sEventThread = EventThreadPool::GetThread(0); }
+	static void StartThread() { EventThreadPool::StartThreads(); }
 	static EventThread* GetEventThread() { return sEventThread; }
 
 	//Binds the socket to the following address.
@@ -31,19 +31,25 @@
  */
 
 #include "Task.h"
+#include "TimeoutTask.h"
 #include "OS.h"
 #include "atomic.h"
 #include "OSMutexRW.h"
+#include "OSCounters.h"
 
 
 unsigned int Task::sShortTaskThreadPicker = 0;
 unsigned int Task::sBlockingTaskThreadPicker = 0;
 
 OSMutexRW       TaskThreadPool::sMutexRW;
+Bool16          TaskThreadPool::sWorkStealing = false;
+UInt32          TaskThreadPool::sNumWritersPending = 0;
+UInt32          TaskThreadPool::sMinWaitTimeInMilSecs = 10;
+unsigned int    TaskThreadPool::sTimerThreadPicker = 0;
 static char* sTaskStateStr = "live_"; //Alive
 
 Task::Task()
-	: fEvents(0), fUseThisThread(NULL), fDefaultThread(NULL), fWriteLock(false), fTimerHeapElem(), fTaskQueueElem(), pickerToUse(&Task::sShortTaskThreadPicker)
+	: fEvents(0), fUseThisThread(NULL), fDefaultThread(NULL), fWriteLock(false), fQueuedMicros(0), fTimerElem(), fTaskQueueElem(), fRunQueueNext(NULL), pickerToUse(&Task::sShortTaskThreadPicker)
 {
 #if DEBUG
 	fInRunCount = 0;
@@ -51,7 +57,7 @@ Task::Task()
 	this->SetTaskName("unknown");
 
 	fTaskQueueElem.SetEnclosingObject(this);
-	fTimerHeapElem.SetEnclosingObject(this);
+	fTimerElem.SetEnclosingObject(this);
 
 }
 
@@ -99,6 +105,8 @@ void Task::Signal(EventFlags events)
 	EventFlags oldEvents = atomic_or(&fEvents, events);
 	if ((!(oldEvents & kAlive)) && (TaskThreadPool::sNumTaskThreads > 0))
 	{
+		fQueuedMicros = OS::Microseconds();
+
 		if (fDefaultThread != NULL && fUseThisThread == NULL)
 			fUseThisThread = fDefaultThread;
 
@@ -112,7 +120,10 @@ void Task::Signal(EventFlags events)
 				if (TaskThreadPool::sTaskThreadArray[0] == fUseThisThread) qtss_printf("Task::Signal  RTSP Thread running  TaskName=%s \n", fTaskName);
 			}
 
-			fUseThisThread->fTaskQueue.EnQueue(&fTaskQueueElem);
+			if (TaskThreadPool::sWorkStealing)
+				fUseThisThread->EnQueueTask(this, true);
+			else
+				fUseThisThread->fTaskQueue.EnQueue(&fTaskQueueElem);
 		}
 		else
 		{
@@ -143,7 +154,10 @@ void Task::Signal(EventFlags events)
 			if (TASK_DEBUG) if (fTaskName[0] == 0) ::strcpy(fTaskName, " _Corrupt_Task");
 
 			if (TASK_DEBUG) qtss_printf("Task::Signal EnQueue B TaskName=%s theThreadIndex=%u thread=%p fTaskQueue.GetLength(%"   _U32BITARG_   ") q_elem=%p enclosing=%p\n", fTaskName, theThreadIndex, (void *)TaskThreadPool::sTaskThreadArray[theThreadIndex], TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.GetQueue()->GetLength(), (void *)&fTaskQueueElem, (void *) this);
-			TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.EnQueue(&fTaskQueueElem);
+			if (TaskThreadPool::sWorkStealing)
+				TaskThreadPool::sTaskThreadArray[theThreadIndex]->EnQueueTask(this, false);
+			else
+				TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.EnQueue(&fTaskQueueElem);
 			if (TASK_DEBUG) qtss_printf("Task::Signal EnQueue A TaskName=%s theThreadIndex=%u thread=%p fTaskQueue.GetLength(%"   _U32BITARG_   ") q_elem=%p enclosing=%p\n", fTaskName, theThreadIndex, (void *)TaskThreadPool::sTaskThreadArray[theThreadIndex], TaskThreadPool::sTaskThreadArray[theThreadIndex]->fTaskQueue.GetQueue()->GetLength(), (void *)&fTaskQueueElem, (void *) this);
 
 		}
@@ -186,10 +200,44 @@ void Task::SetThreadPicker(unsigned int* picker)
 
 }
 
+TaskThread::TaskThread(UInt32 inThreadIndex)
+	: OSThread(),
+	fThreadIndex(inThreadIndex),
+	fTaskThreadPoolElem(),
+	fInbox(NULL),
+	fPinnedInbox(NULL),
+	fPinnedHead(NULL),
+	fPinnedTail(NULL),
+	fOverflowHead(NULL),
+	fOverflowTail(NULL),
+	fPreferPinned(true),
+	fRunRing(NULL),
+	fRunRingTop(0),
+	fRunRingBottom(0),
+	fParked(0),
+	fRunningUnlocked(0),
+	fNumSteals(0),
+	fQueueDepth(0)
+{
+	fTaskThreadPoolElem.SetEnclosingObject(this);
+	fRunRing = new Task*[kRunRingSize];
+	::memset(fRunRing, 0, sizeof(Task*) * kRunRingSize);
+}
+
+TaskThread::~TaskThread()
+{
+	this->StopAndWaitForThread();
+	delete[] fRunRing;
+}
+
 void TaskThread::Entry()
 {
 	Task* theTask = NULL;
 
+	char theName[32];
+	qtss_snprintf(theName, sizeof(theName), "task%" _U32BITARG_, fThreadIndex);
+	OSCounters::SetThreadName(theName);
+
 	while (true)
 	{
 		theTask = this->WaitForTask();
@@ -199,6 +247,8 @@ void TaskThread::Entry()
 		if (theTask == NULL || false == theTask->Valid())
 			return;
 
+		OSCounters::AddToHistogram(OSCounters::kTaskQueueLatency, OS::Microseconds() - theTask->fQueuedMicros);
+
 		Bool16 doneProcessingEvent = false;
 
 		while (!doneProcessingEvent)
@@ -216,11 +266,43 @@ void TaskThread::Entry()
 
 			if (theTask->fWriteLock)
 			{
+				//Announce the writer first so that threads about to run unlocked fall
+				//back to the read lock, then wait out the ones already running.
+				if (TaskThreadPool::sWorkStealing)
+					(void)atomic_add(&TaskThreadPool::sNumWritersPending, 1);
+
 				OSMutexWriteLocker mutexLocker(&TaskThreadPool::sMutexRW);
+				if (TaskThreadPool::sWorkStealing)
+					TaskThreadPool::WaitForUnlockedRuns(this);
+
 				if (TASK_DEBUG) qtss_printf("TaskThread::Entry run global locked TaskName=%s CurMSec=%.3f thread=%p task=%p\n", theTask->fTaskName, OS::StartTimeMilli_Float(), (void *) this, (void *)theTask);
 
 				theTimeout = theTask->Run();
 				theTask->fWriteLock = false;
+
+				if (TaskThreadPool::sWorkStealing)
+					(void)atomic_sub(&TaskThreadPool::sNumWritersPending, 1);
+			}
+			else if (TaskThreadPool::sWorkStealing)
+			{
+				//Only fWriteLock tasks need the global lock, so ordinary tasks just
+				//flag that they are running unless a writer is waiting.
+				fRunningUnlocked = 1;
+				atomic_barrier();
+				if (TaskThreadPool::sNumWritersPending == 0)
+				{
+					if (TASK_DEBUG) qtss_printf("TaskThread::Entry run unlocked TaskName=%s CurMSec=%.3f thread=%p task=%p\n", theTask->fTaskName, OS::StartTimeMilli_Float(), (void *) this, (void *)theTask);
+
+					theTimeout = theTask->Run();
+					atomic_barrier();
+					fRunningUnlocked = 0;
+				}
+				else
+				{
+					fRunningUnlocked = 0;
+					OSMutexReadLocker mutexLocker(&TaskThreadPool::sMutexRW);
+					theTimeout = theTask->Run();
+				}
 			}
 			else
 			{
@@ -243,8 +325,8 @@ void TaskThread::Entry()
 
 					theTask->fUseThisThread = NULL;
 
-					if (NULL != fHeap.Remove(&theTask->fTimerHeapElem))
-						qtss_printf("TaskThread::Entry task still in heap before delete\n");
+					if (NULL != fTimerWheel.Remove(&theTask->fTimerElem))
+						qtss_printf("TaskThread::Entry task still in timer wheel before delete\n");
 
 					if (NULL != theTask->fTaskQueueElem.InQueue())
 						qtss_printf("TaskThread::Entry task still in queue before delete\n");
@@ -278,9 +360,9 @@ void TaskThread::Entry()
 			{
 				//note that if we get here, we don't reset theTask, so it will get passed into
 				//WaitForTask
-				if (TASK_DEBUG) qtss_printf("TaskThread::Entry insert TaskName=%s in timer heap thread=%p elem=%p task=%p timeout=%.2f\n", theTask->fTaskName, (void *) this, (void *)&theTask->fTimerHeapElem, (void *)theTask, (float)theTimeout / (float)1000);
-				theTask->fTimerHeapElem.SetValue(OS::Milliseconds() + theTimeout);
-				fHeap.Insert(&theTask->fTimerHeapElem);
+				if (TASK_DEBUG) qtss_printf("TaskThread::Entry insert TaskName=%s in timer wheel thread=%p elem=%p task=%p timeout=%.2f\n", theTask->fTaskName, (void *) this, (void *)&theTask->fTimerElem, (void *)theTask, (float)theTimeout / (float)1000);
+				theTask->fTimerElem.SetValue(OS::Milliseconds() + theTimeout);
+				fTimerWheel.Insert(&theTask->fTimerElem);
 				(void)atomic_or(&theTask->fEvents, Task::kIdleEvent);
 				doneProcessingEvent = true;
 			}
@@ -314,32 +396,42 @@ Task* TaskThread::WaitForTask()
 	{
 		SInt64 theCurrentTime = OS::Milliseconds();
 
-		if ((fHeap.PeekMin() != NULL) && (fHeap.PeekMin()->GetValue() <= theCurrentTime))
+		//IdleTask and TimeoutTask timers only signal other tasks, fire them first
+		SInt64 theSharedTimeout = this->FireSharedTimers(theCurrentTime);
+
+		OSTimerElem* theTimerElem = fTimerWheel.ExtractExpired(theCurrentTime);
+		if (theTimerElem != NULL)
 		{
-			if (TASK_DEBUG) qtss_printf("TaskThread::WaitForTask found timer-task=%s thread %p fHeap.CurrentHeapSize(%"   _U32BITARG_   ") taskElem = %p enclose=%p\n", ((Task*)fHeap.PeekMin()->GetEnclosingObject())->fTaskName, (void *) this, fHeap.CurrentHeapSize(), (void *)fHeap.PeekMin(), (void *)fHeap.PeekMin()->GetEnclosingObject());
-			return (Task*)fHeap.ExtractMin()->GetEnclosingObject();
+			//a timer task has been waiting since its deadline, not since it was put on the wheel
+			Task* theTask = (Task*)theTimerElem->GetEnclosingObject();
+			theTask->fQueuedMicros = OS::Microseconds() - (theCurrentTime - theTimerElem->GetValue()) * 1000;
+
+			if (TASK_DEBUG) qtss_printf("TaskThread::WaitForTask found timer-task=%s thread %p fTimerWheel.CurrentSize(%"   _U32BITARG_   ") taskElem = %p enclose=%p\n", ((Task*)theTimerElem->GetEnclosingObject())->fTaskName, (void *) this, fTimerWheel.CurrentSize(), (void *)theTimerElem, (void *)theTimerElem->GetEnclosingObject());
+			return theTask;
 		}
 
-		//if there is an element waiting for a timeout, figure out how long we should wait.
-		SInt64 theTimeout = 0;
-		if (fHeap.PeekMin() != NULL)
-			theTimeout = fHeap.PeekMin()->GetValue() - theCurrentTime;
-		Assert(theTimeout >= 0);
+		if (TaskThreadPool::sWorkStealing)
+		{
+			Task* theTask = this->DeQueueLocalTask();
+			if (theTask == NULL)
+				theTask = this->StealTask();
+			if (theTask != NULL)
+			{
+				if (TASK_DEBUG) qtss_printf("TaskThread::WaitForTask found signal-task=%s thread %p depth=%"   _U32BITARG_   " steals=%"   _U32BITARG_   "\n", theTask->fTaskName, (void *) this, fQueueDepth, fNumSteals);
+				return theTask;
+			}
 
-		//
-		// Make sure we can't go to sleep for some ridiculously short
-		// period of time
-		// Do not allow a timeout below 10 ms without first verifying reliable udp 1-2mbit live streams. 
-		// Test with easydarwin.xml pref reliablUDP printfs enabled and look for packet loss and check client for  buffer ahead recovery.
-		if (theTimeout < 10)
-			theTimeout = 10;
-
-		//wait...
-		OSQueueElem* theElem = fTaskQueue.DeQueueBlocking(this, (SInt32)theTimeout);
-		if (theElem != NULL)
+			this->ParkThread(this->GetWaitTime(theCurrentTime, theSharedTimeout));
+		}
+		else
 		{
-			if (TASK_DEBUG) qtss_printf("TaskThread::WaitForTask found signal-task=%s thread %p fTaskQueue.GetLength(%"   _U32BITARG_   ") taskElem = %p enclose=%p\n", ((Task*)theElem->GetEnclosingObject())->fTaskName, (void *) this, fTaskQueue.GetQueue()->GetLength(), (void *)theElem, (void *)theElem->GetEnclosingObject());
-			return (Task*)theElem->GetEnclosingObject();
+			//wait...
+			OSQueueElem* theElem = fTaskQueue.DeQueueBlocking(this, (SInt32)this->GetWaitTime(theCurrentTime, theSharedTimeout));
+			if (theElem != NULL)
+			{
+				if (TASK_DEBUG) qtss_printf("TaskThread::WaitForTask found signal-task=%s thread %p fTaskQueue.GetLength(%"   _U32BITARG_   ") taskElem = %p enclose=%p\n", ((Task*)theElem->GetEnclosingObject())->fTaskName, (void *) this, fTaskQueue.GetQueue()->GetLength(), (void *)theElem, (void *)theElem->GetEnclosingObject());
+				return (Task*)theElem->GetEnclosingObject();
+			}
 		}
 
 		//
@@ -349,6 +441,274 @@ Task* TaskThread::WaitForTask()
 	}
 }
 
+SInt64 TaskThread::GetWaitTime(SInt64 inCurrentTime, SInt64 inSharedTimeout)
+{
+	//if there is an element waiting for a timeout, figure out how long we should wait.
+	SInt64 theTimeout = fTimerWheel.GetTimeToNextExpiry(inCurrentTime);
+	if ((inSharedTimeout >= 0) && ((theTimeout < 0) || (inSharedTimeout < theTimeout)))
+		theTimeout = inSharedTimeout;
+
+	//With nothing pending, or with work stealing (idle threads go looking for
+	//work), wake up every kIdleWaitTimeInMilSecs. Otherwise still cap the sleep:
+	//a timer armed from a non task thread may miss the wakeup.
+	if ((theTimeout < 0) || (TaskThreadPool::sWorkStealing && (theTimeout > kIdleWaitTimeInMilSecs)))
+		theTimeout = kIdleWaitTimeInMilSecs;
+	else if (theTimeout > kMaxWaitTimeInMilSecs)
+		theTimeout = kMaxWaitTimeInMilSecs;
+
+	//
+	// Make sure we can't go to sleep for some ridiculously short period of time.
+	// The wheel has 1ms resolution. Before lowering run_task_min_wait_msec below
+	// 10ms, verify reliable udp 1-2mbit live streams: enable the reliableUDP printfs
+	// in easydarwin.xml, look for packet loss and check client buffer ahead recovery.
+	if (theTimeout < (SInt64)TaskThreadPool::sMinWaitTimeInMilSecs)
+		theTimeout = TaskThreadPool::sMinWaitTimeInMilSecs;
+
+	return theTimeout;
+}
+
+SInt64 TaskThread::FireSharedTimers(SInt64 inCurrentTime)
+{
+	//Unlocked peek. A timer armed from another thread is followed by WakeForTimer.
+	if ((fIdleTimers.CurrentSize() == 0) && (fTimeoutTimers.CurrentSize() == 0))
+		return -1;
+
+	OSMutexLocker locker(&fTimerMutex);
+	OSTimerElem* theElem = NULL;
+
+	while ((theElem = fIdleTimers.ExtractExpired(inCurrentTime)) != NULL)
+		((Task*)theElem->GetEnclosingObject())->Signal(Task::kIdleEvent);
+
+	while ((theElem = fTimeoutTimers.ExtractExpired(inCurrentTime)) != NULL)
+		((TimeoutTask*)theElem->GetEnclosingObject())->Expire(inCurrentTime);
+
+	SInt64 theTimeout = fIdleTimers.GetTimeToNextExpiry(inCurrentTime);
+	SInt64 theTimeoutTimeout = fTimeoutTimers.GetTimeToNextExpiry(inCurrentTime);
+	if ((theTimeoutTimeout >= 0) && ((theTimeout < 0) || (theTimeoutTimeout < theTimeout)))
+		theTimeout = theTimeoutTimeout;
+
+	return theTimeout;
+}
+
+void TaskThread::WakeForTimer()
+{
+	if (TaskThreadPool::sWorkStealing)
+		this->WakeThread();
+	else
+		fTaskQueue.GetCond()->Signal();
+}
+
+TaskThread* TaskThread::PickTimerThread()
+{
+	Assert(TaskThreadPool::sNumTaskThreads > 0);
+
+	//Prefer the calling task thread: its timers then fire on a thread that is
+	//already awake, and nobody else touches its timer mutex.
+	OSThread* theCurrentThread = OSThread::GetCurrent();
+	for (UInt32 x = 0; x < TaskThreadPool::sNumTaskThreads; x++)
+	{
+		if (TaskThreadPool::sTaskThreadArray[x] == theCurrentThread)
+			return TaskThreadPool::sTaskThreadArray[x];
+	}
+
+	unsigned int theThreadIndex = atomic_add(&TaskThreadPool::sTimerThreadPicker, 1);
+	return TaskThreadPool::sTaskThreadArray[theThreadIndex % TaskThreadPool::sNumShortTaskThreads];
+}
+
+void TaskThread::EnQueueTask(Task* inTask, Bool16 inPinned)
+{
+	Task* volatile* theInbox = inPinned ? &fPinnedInbox : &fInbox;
+	(void)atomic_add(&fQueueDepth, 1);
+
+	Task* theHead = NULL;
+	do
+	{
+		theHead = *theInbox;
+		inTask->fRunQueueNext = theHead;
+	} while (!compare_and_store_ptr(theHead, inTask, (void**)theInbox));
+
+	//The CAS above is a full barrier, so either we see fParked here or
+	//the owner sees the new task before it goes to sleep.
+	if (fParked)
+		this->WakeThread();
+}
+
+Task* TaskThread::ReverseTaskList(Task* inList, Task** outTail, UInt32* outCount)
+{
+	//The inboxes are LIFO stacks; reversing them restores signal order.
+	Task* theHead = NULL;
+	*outTail = inList;
+	*outCount = 0;
+	while (inList != NULL)
+	{
+		Task* theNext = inList->fRunQueueNext;
+		inList->fRunQueueNext = theHead;
+		theHead = inList;
+		inList = theNext;
+		(*outCount)++;
+	}
+	return theHead;
+}
+
+Task* TaskThread::DeQueueLocalTask()
+{
+	Task* theList = NULL;
+	Task* theTail = NULL;
+	UInt32 theCount = 0;
+
+	if (fPinnedInbox != NULL)
+	{
+		theList = ReverseTaskList((Task*)atomic_swap_ptr((void**)&fPinnedInbox, NULL), &theTail, &theCount);
+		if (fPinnedTail != NULL)
+			fPinnedTail->fRunQueueNext = theList;
+		else
+			fPinnedHead = theList;
+		fPinnedTail = theTail;
+	}
+
+	if (fInbox != NULL)
+	{
+		theList = ReverseTaskList((Task*)atomic_swap_ptr((void**)&fInbox, NULL), &theTail, &theCount);
+		if (fOverflowTail != NULL)
+			fOverflowTail->fRunQueueNext = theList;
+		else
+			fOverflowHead = theList;
+		fOverflowTail = theTail;
+	}
+
+	//Publish as much as fits in the ring so other threads can steal it. Read the
+	//link first: once a task is in the ring another thread may run and re-signal it.
+	while (fOverflowHead != NULL)
+	{
+		Task* theNext = fOverflowHead->fRunQueueNext;
+		if (!this->PushRunRing(fOverflowHead))
+			break;
+		fOverflowHead = theNext;
+	}
+	if (fOverflowHead == NULL)
+		fOverflowTail = NULL;
+
+	Task* theTask = NULL;
+	if ((fPinnedHead != NULL) && (fPreferPinned || (fRunRingBottom == fRunRingTop)))
+	{
+		theTask = fPinnedHead;
+		fPinnedHead = theTask->fRunQueueNext;
+		if (fPinnedHead == NULL)
+			fPinnedTail = NULL;
+		theTask->fRunQueueNext = NULL;
+	}
+	else
+		theTask = this->TakeRunRing();
+
+	fPreferPinned = !fPreferPinned;
+	if (theTask != NULL)
+		(void)atomic_sub(&fQueueDepth, 1);
+
+	return theTask;
+}
+
+Bool16 TaskThread::PushRunRing(Task* inTask)
+{
+	//owner only
+	UInt32 theBottom = fRunRingBottom;
+	if ((theBottom - fRunRingTop) >= kRunRingSize)
+		return false;
+
+	fRunRing[theBottom & (kRunRingSize - 1)] = inTask;
+	atomic_barrier();
+	fRunRingBottom = theBottom + 1;
+	return true;
+}
+
+Task* TaskThread::TakeRunRing()
+{
+	//called by the owner and by thieves
+	while (true)
+	{
+		UInt32 theTop = fRunRingTop;
+		atomic_barrier();
+		UInt32 theBottom = fRunRingBottom;
+		if ((SInt32)(theBottom - theTop) <= 0)
+			return NULL;
+
+		atomic_barrier();
+		Task* theTask = fRunRing[theTop & (kRunRingSize - 1)];
+		if (compare_and_store(theTop, theTop + 1, (unsigned int*)&fRunRingTop))
+			return theTask;
+	}
+}
+
+Task* TaskThread::StealTask()
+{
+	//Short task threads only steal from short task threads and blocking
+	//threads from blocking threads, so blocking work never lands on a short thread.
+	UInt32 theFirst = 0;
+	UInt32 theCount = TaskThreadPool::sNumShortTaskThreads;
+	if (fThreadIndex >= TaskThreadPool::sNumShortTaskThreads)
+	{
+		theFirst = TaskThreadPool::sNumShortTaskThreads;
+		theCount = TaskThreadPool::sNumTaskThreads - TaskThreadPool::sNumShortTaskThreads;
+	}
+
+	for (UInt32 x = 1; x < theCount; x++)
+	{
+		TaskThread* theVictim = TaskThreadPool::sTaskThreadArray[theFirst + ((fThreadIndex - theFirst + x) % theCount)];
+
+		Task* theTask = theVictim->TakeRunRing();
+		if (theTask != NULL)
+		{
+			(void)atomic_sub(&theVictim->fQueueDepth, 1);
+			fNumSteals++;
+			return theTask;
+		}
+
+		//A thread stuck in a long Run() never moves its inbox into its ring,
+		//so take the whole inbox. Swapping the head out is safe for any thread.
+		if (theVictim->fInbox == NULL)
+			continue;
+
+		Task* theTail = NULL;
+		UInt32 theNumTasks = 0;
+		Task* theList = ReverseTaskList((Task*)atomic_swap_ptr((void**)&theVictim->fInbox, NULL), &theTail, &theNumTasks);
+		if (theList == NULL)
+			continue;
+
+		(void)atomic_sub(&theVictim->fQueueDepth, theNumTasks);
+		(void)atomic_add(&fQueueDepth, theNumTasks - 1);
+
+		theTask = theList;
+		if (theList->fRunQueueNext != NULL)
+		{
+			if (fOverflowTail != NULL)
+				fOverflowTail->fRunQueueNext = theList->fRunQueueNext;
+			else
+				fOverflowHead = theList->fRunQueueNext;
+			fOverflowTail = theTail;
+		}
+		theTask->fRunQueueNext = NULL;
+		fNumSteals++;
+		return theTask;
+	}
+
+	return NULL;
+}
+
+void TaskThread::ParkThread(SInt64 inTimeoutInMilSecs)
+{
+	OSMutexLocker locker(&fParkMutex);
+	fParked = 1;
+	atomic_barrier();
+	if ((fInbox == NULL) && (fPinnedInbox == NULL) && !this->IsStopRequested())
+		fParkCond.Wait(&fParkMutex, (SInt32)inTimeoutInMilSecs);
+	fParked = 0;
+}
+
+void TaskThread::WakeThread()
+{
+	OSMutexLocker locker(&fParkMutex);
+	fParkCond.Signal();
+}
+
 TaskThread** TaskThreadPool::sTaskThreadArray = NULL;
 UInt32       TaskThreadPool::sNumTaskThreads = 0;
 UInt32       TaskThreadPool::sNumShortTaskThreads = 0;
@@ -359,17 +719,21 @@ Bool16 TaskThreadPool::AddThreads(UInt32 numToAdd)
 	Assert(sTaskThreadArray == NULL);
 	sTaskThreadArray = new TaskThread*[numToAdd];
 
+	//Create every thread before starting any, work-stealing threads look at their peers
 	for (UInt32 x = 0; x < numToAdd; x++)
-	{
-		sTaskThreadArray[x] = new TaskThread();
-		sTaskThreadArray[x]->Start();
-		if (TASK_DEBUG)  qtss_printf("TaskThreadPool::AddThreads sTaskThreadArray[%"   _U32BITARG_   "]=%p\n", x, sTaskThreadArray[x]);
-	}
+		sTaskThreadArray[x] = new TaskThread(x);
+
 	sNumTaskThreads = numToAdd;
 
 	if (0 == sNumShortTaskThreads)
 		sNumShortTaskThreads = numToAdd;
 
+	for (UInt32 x = 0; x < numToAdd; x++)
+	{
+		sTaskThreadArray[x]->Start();
+		if (TASK_DEBUG)  qtss_printf("TaskThreadPool::AddThreads sTaskThreadArray[%"   _U32BITARG_   "]=%p\n", x, sTaskThreadArray[x]);
+	}
+
 	return true;
 }
 
@@ -396,7 +760,10 @@ void TaskThreadPool::RemoveThreads()
 	//Because any (or all) threads may be blocked on the queue, cycle through
 	//all the threads, signalling each one
 	for (UInt32 y = 0; y < sNumTaskThreads; y++)
+	{
 		sTaskThreadArray[y]->fTaskQueue.GetCond()->Signal();
+		sTaskThreadArray[y]->WakeThread();
+	}
 
 	//Ok, now wait for the selected threads to terminate, deleting them and removing
 	//them from the queue.
@@ -405,3 +772,35 @@ void TaskThreadPool::RemoveThreads()
 
 	sNumTaskThreads = 0;
 }
+
+UInt32 TaskThreadPool::GetNumSteals()
+{
+	UInt32 theTotal = 0;
+	for (UInt32 x = 0; x < sNumTaskThreads; x++)
+		theTotal += sTaskThreadArray[x]->GetNumSteals();
+	return theTotal;
+}
+
+UInt32 TaskThreadPool::GetQueueDepth()
+{
+	UInt32 theTotal = 0;
+	for (UInt32 x = 0; x < sNumTaskThreads; x++)
+		theTotal += sTaskThreadArray[x]->GetQueueDepth();
+	return theTotal;
+}
+
+void TaskThreadPool::WaitForUnlockedRuns(TaskThread* inWriter)
+{
+	//Called with sMutexRW write locked. New runs see sNumWritersPending and
+	//queue up on the read lock, so this only waits for runs already in progress.
+	for (UInt32 x = 0; x < sNumTaskThreads; x++)
+	{
+		TaskThread* theThread = sTaskThreadArray[x];
+		if (theThread == inWriter)
+			continue;
+
+		while (theThread->fRunningUnlocked)
+			OSThread::ThreadYield();
+	}
+	atomic_barrier();
+}
@@ -46,9 +46,10 @@
 #define __TASK_H__
 
 #include "OSQueue.h"
-#include "OSHeap.h"
+#include "OSTimingWheel.h"
 #include "OSThread.h"
 #include "OSMutexRW.h"
+#include "OSCond.h"
 
 #define TASK_DEBUG 0
 
@@ -101,6 +102,7 @@ public:
 	void            SetTaskName(char* name);
 
 	void            SetDefaultThread(TaskThread* defaultThread) { fDefaultThread = defaultThread; }
+	TaskThread*     GetDefaultThread() { return fDefaultThread; }
 	void            SetThreadPicker(unsigned int* picker);
 	static unsigned int* GetBlockingTaskThreadPicker() { return &sBlockingTaskThreadPicker; }
 
@@ -143,17 +145,22 @@ private:
 	TaskThread*     fDefaultThread;
 	Bool16          fWriteLock;
 
+	//When the task was last signalled or its timer came due, for the queue latency histogram
+	SInt64          fQueuedMicros;
+
 #if DEBUG
 	//The whole premise of a task is that the Run function cannot be re-entered.
 	//This debugging variable ensures that that is always the case
 	volatile UInt32 fInRunCount;
 #endif
 
-	//This could later be optimized by using a timing wheel instead of a heap,
-	//and that way we wouldn't need both a heap elem and a queue elem here (just queue elem)
-	OSHeapElem      fTimerHeapElem;
+	//Timer for the value returned by Run(), kept on the running thread's timing wheel
+	OSTimerElem     fTimerElem;
 	OSQueueElem     fTaskQueueElem;
 
+	//Link used by the lock-free inboxes and run queues of the work-stealing scheduler
+	Task*           fRunQueueNext;
+
 	unsigned int *pickerToUse;
 	//Variable used for assigning tasks to threads in a round-robin fashion
 	static unsigned int sShortTaskThreadPicker; //default picker
@@ -168,30 +175,93 @@ public:
 
 	//Implementation detail: all tasks get run on TaskThreads.
 
-	TaskThread() : OSThread(), fTaskThreadPoolElem()
-	{
-		fTaskThreadPoolElem.SetEnclosingObject(this);
-	}
-	virtual         ~TaskThread() { this->StopAndWaitForThread(); }
+	TaskThread(UInt32 inThreadIndex = 0);
+	virtual         ~TaskThread();
+
+	UInt32          GetThreadIndex() { return fThreadIndex; }
+
+	//Work-stealing statistics. Both are only meaningful when
+	//TaskThreadPool::IsWorkStealing() is true.
+	UInt32          GetNumSteals() { return fNumSteals; }      // tasks this thread took from others
+	UInt32          GetQueueDepth() { return fQueueDepth; }    // runnable tasks queued on this thread
 
 private:
 
 	enum
 	{
-		kMinWaitTimeInMilSecs = 10  //UInt32
+		kIdleWaitTimeInMilSecs = 10,  //UInt32, longest sleep with no timers pending
+		kMaxWaitTimeInMilSecs = 100, //UInt32, longest sleep with timers pending
+		kRunRingSize = 256          //UInt32, must be a power of 2
 	};
 
 	virtual void    Entry();
 	Task*           WaitForTask();
 
+	//
+	// Timers
+	//
+	// fTimerWheel holds Run() timeouts and is only touched by this thread.
+	// fIdleTimers (IdleTask) and fTimeoutTimers (TimeoutTask) may be armed from
+	// other threads, so they sit behind fTimerMutex. Timers are armed on the
+	// calling thread's wheels whenever possible, which keeps that mutex uncontended.
+	SInt64          FireSharedTimers(SInt64 inCurrentTime);
+	SInt64          GetWaitTime(SInt64 inCurrentTime, SInt64 inSharedTimeout);
+	void            WakeForTimer();
+	static TaskThread* PickTimerThread();
+
+	//
+	// Work-stealing scheduler
+	//
+	// Any thread may push onto fInbox or fPinnedInbox with a compare-and-swap.
+	// The owner drains fInbox into fRunRing, from which idle threads of the same
+	// kind (short or blocking) steal. Tasks that asked for this particular thread
+	// (ForceSameThread, CallLocked, SetDefaultThread) go through fPinnedInbox and
+	// are never stolen.
+	void            EnQueueTask(Task* inTask, Bool16 inPinned);
+	Task*           DeQueueLocalTask();
+	Task*           StealTask();
+	Bool16          PushRunRing(Task* inTask);
+	Task*           TakeRunRing();
+	void            ParkThread(SInt64 inTimeoutInMilSecs);
+	void            WakeThread();
+	static Task*    ReverseTaskList(Task* inList, Task** outTail, UInt32* outCount);
+
+	UInt32          fThreadIndex;
 	OSQueueElem     fTaskThreadPoolElem;
 
-	OSHeap              fHeap;
+	OSTimingWheel       fTimerWheel;
 	OSQueue_Blocking    fTaskQueue;
 
+	OSMutex             fTimerMutex;
+	OSTimingWheel       fIdleTimers;
+	OSTimingWheel       fTimeoutTimers;
+
+	Task* volatile      fInbox;
+	Task* volatile      fPinnedInbox;
+	Task*               fPinnedHead;        // owner only
+	Task*               fPinnedTail;
+	Task*               fOverflowHead;      // owner only, filled when fRunRing is full
+	Task*               fOverflowTail;
+	Bool16              fPreferPinned;      // alternate pinned and stealable tasks
+	Task**              fRunRing;
+	volatile UInt32     fRunRingTop;        // advanced by owner and thieves (CAS)
+	volatile UInt32     fRunRingBottom;     // advanced by owner only
+
+	OSMutex             fParkMutex;
+	OSCond              fParkCond;
+	UInt32              fParked;
+
+	//Set while a task runs without the global read lock; checked by fWriteLock tasks
+	UInt32              fRunningUnlocked;
+
+	UInt32              fNumSteals;
+	UInt32              fQueueDepth;
+
 
 	friend class Task;
 	friend class TaskThreadPool;
+	friend class IdleTask;
+	friend class TimeoutTask;
 };
 
 //Because task threads share a global queue of tasks to execute,
@@ -206,11 +276,28 @@ public:
 	static void     RemoveThreads();
 	static TaskThread* GetThread(UInt32 index);
 	static UInt32  GetNumThreads() { return sNumTaskThreads; }
+	static UInt32  GetNumShortTaskThreads() { return sNumShortTaskThreads; }   // threads 0 to this - 1
 	static void SetNumShortTaskThreads(UInt32 numToAdd) { sNumShortTaskThreads = numToAdd; }
 	static void SetNumBlockingTaskThreads(UInt32 numToAdd) { sNumBlockingTaskThreads = numToAdd; }
 
+	//Must be called before AddThreads. When enabled, every task thread has
+	//its own lock-free run queue, idle threads steal from busy ones, and the
+	//global RW lock is only taken by tasks that asked for it (CallLocked).
+	static void     SetWorkStealing(Bool16 enabled) { Assert(sTaskThreadArray == NULL); sWorkStealing = enabled; }
+	static Bool16   IsWorkStealing() { return sWorkStealing; }
+
+	//Shortest time a task thread will sleep waiting for a timer. Defaults to 10ms;
+	//timers have 1ms resolution, so lower values buy precision at the cost of wakeups.
+	static void     SetMinWaitTime(UInt32 inMilSecs) { sMinWaitTimeInMilSecs = (inMilSecs == 0) ? 1 : inMilSecs; }
+
+	//Totals across all task threads
+	static UInt32   GetNumSteals();
+	static UInt32   GetQueueDepth();
+
 private:
 
+	static void     WaitForUnlockedRuns(TaskThread* inWriter);
+
 	static TaskThread**     sTaskThreadArray;
 	static UInt32           sNumTaskThreads;
 	static UInt32           sNumShortTaskThreads;
@@ -218,6 +305,11 @@ private:
 
 	static OSMutexRW        sMutexRW;// __attribute__((visibility("hidden")));
 
+	static Bool16           sWorkStealing;
+	static UInt32           sMinWaitTimeInMilSecs;
+	static unsigned int     sTimerThreadPicker;
+	static UInt32           sNumWritersPending;
+
 	friend class Task;
 	friend class TaskThread;
 };
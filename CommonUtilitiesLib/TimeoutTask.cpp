@@ -32,84 +32,75 @@
 
 #include "TimeoutTask.h"
 
-TimeoutTaskThread* TimeoutTask::sThread = NULL;
-
 void TimeoutTask::Initialize()
 {
-	if (sThread == NULL)
-	{
-		sThread = new TimeoutTaskThread();
-		sThread->Signal(Task::kStartEvent);
-	}
-
+	//Timeouts are serviced by the task threads themselves
+	Assert(TaskThreadPool::GetNumThreads() > 0);
 }
 
 
 TimeoutTask::TimeoutTask(Task* inTask, SInt64 inTimeoutInMilSecs)
-	: fTask(inTask), fQueueElem()
+	: fTask(inTask), fTimeoutAtThisTime(0), fTimeoutInMilSecs(0), fTimerElem(), fTimerThread(NULL)
 {
-	fQueueElem.SetEnclosingObject(this);
-	this->SetTimeout(inTimeoutInMilSecs);
+	fTimerElem.SetEnclosingObject(this);
 	if (NULL == inTask)
 		fTask = (Task *) this;
-	Assert(sThread != NULL); // this can happen if RunServer intializes tasks in the wrong order
+	Assert(TaskThreadPool::GetNumThreads() > 0); // this can happen if RunServer intializes tasks in the wrong order
 
-	OSMutexLocker locker(&sThread->fMutex);
-	sThread->fQueue.EnQueue(&fQueueElem);
+	//the timer stays on this thread's wheel for the life of the object
+	fTimerThread = TaskThread::PickTimerThread();
+	this->SetTimeout(inTimeoutInMilSecs);
 }
 
 TimeoutTask::~TimeoutTask()
 {
-	OSMutexLocker locker(&sThread->fMutex);
-	sThread->fQueue.Remove(&fQueueElem);
+	OSMutexLocker locker(&fTimerThread->fTimerMutex);
+	fTimerThread->fTimeoutTimers.Remove(&fTimerElem);
 }
 
 void TimeoutTask::SetTimeout(SInt64 inTimeoutInMilSecs)
 {
-	fTimeoutInMilSecs = inTimeoutInMilSecs;
-	if (inTimeoutInMilSecs == 0)
-		fTimeoutAtThisTime = 0;
-	else
-		fTimeoutAtThisTime = OS::Milliseconds() + fTimeoutInMilSecs;
+	{
+		OSMutexLocker locker(&fTimerThread->fTimerMutex);
+		fTimeoutInMilSecs = inTimeoutInMilSecs;
+		if (inTimeoutInMilSecs == 0)
+			fTimeoutAtThisTime = 0;
+		else
+			fTimeoutAtThisTime = OS::Milliseconds() + fTimeoutInMilSecs;
+
+		//the deadline may have moved earlier, so re-arm from scratch
+		fTimerThread->fTimeoutTimers.Remove(&fTimerElem);
+		if (fTimeoutAtThisTime == 0)
+			return;
+
+		fTimerElem.SetValue(fTimeoutAtThisTime);
+		fTimerThread->fTimeoutTimers.Insert(&fTimerElem);
+	}
+
+	if (fTimerThread != OSThread::GetCurrent())
+		fTimerThread->WakeForTimer();
 }
 
-SInt64 TimeoutTaskThread::Run()
+void TimeoutTask::Expire(SInt64 inCurrentTime)
 {
-	//ok, check for timeouts now. Go through the whole queue
-	OSMutexLocker locker(&fMutex);
-	SInt64 curTime = OS::Milliseconds();
-	SInt64 intervalMilli = kIntervalSeconds * 1000;//always default to 60 seconds but adjust to smallest interval > 0
-	SInt64 taskInterval = intervalMilli;
+	SInt64 theTimeoutAtThisTime = fTimeoutAtThisTime;
+	if (theTimeoutAtThisTime == 0)
+		return; // SetTimeout(0) re-arms us if the timeout is turned back on
 
-	for (OSQueueIter iter(&fQueue); !iter.IsDone(); iter.Next())
+	//if it's time to time this task out, signal it
+	if (inCurrentTime >= theTimeoutAtThisTime)
 	{
-		TimeoutTask* theTimeoutTask = (TimeoutTask*)iter.GetCurrent()->GetEnclosingObject();
-
-		//if it's time to time this task out, signal it
-		if ((theTimeoutTask->fTimeoutAtThisTime > 0) && (curTime >= theTimeoutTask->fTimeoutAtThisTime))
-		{
-#if TIMEOUT_DEBUGGING
-			qtss_printf("TimeoutTask %" _S32BITARG_ " timed out. Curtime = %" _64BITARG_ "d, timeout time = %" _64BITARG_ "d\n", (SInt32)theTimeoutTask, curTime, theTimeoutTask->fTimeoutAtThisTime);
-#endif
-			theTimeoutTask->fTask->Signal(Task::kTimeoutEvent);
-		}
-		else
-		{
-			taskInterval = theTimeoutTask->fTimeoutAtThisTime - curTime;
-			if ((taskInterval > 0) && (theTimeoutTask->fTimeoutInMilSecs > 0) && (intervalMilli > taskInterval))
-				intervalMilli = taskInterval + 1000; // set timeout to 1 second past this task's timeout
 #if TIMEOUT_DEBUGGING
-			qtss_printf("TimeoutTask %" _S32BITARG_ " not being timed out. Curtime = %" _64BITARG_ "d. timeout time = %" _64BITARG_ "d\n", (SInt32)theTimeoutTask, curTime, theTimeoutTask->fTimeoutAtThisTime);
+		qtss_printf("TimeoutTask %p timed out. Curtime = %" _64BITARG_ "d, timeout time = %" _64BITARG_ "d\n", (void*)this, inCurrentTime, theTimeoutAtThisTime);
 #endif
-		}
+		fTask->Signal(Task::kTimeoutEvent);
+		fTimerElem.SetValue(inCurrentTime + (kIntervalSeconds * 1000));
+	}
+	else
+	{
+		//RefreshTimeout pushed the deadline out since the timer was armed
+		fTimerElem.SetValue(theTimeoutAtThisTime);
 	}
-	(void)this->GetEvents();//we must clear the event mask!
-
-	OSThread::ThreadYield();
-
-#if TIMEOUT_DEBUGGING
-	qtss_printf("TimeoutTaskThread::Run interval seconds= %" _S32BITARG_ "\n", (SInt32)intervalMilli / 1000);
-#endif
 
-	return intervalMilli;//don't delete me!
+	fTimerThread->fTimeoutTimers.Insert(&fTimerElem);
 }
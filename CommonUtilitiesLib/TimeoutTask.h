@@ -31,6 +31,10 @@
 				 low priority timing mechanism. Timeouts may not happen exactly when
 				 they are supposed to, but who cares?
 
+				 Each TimeoutTask has one timer on a task thread's timing wheel.
+				 RefreshTimeout only moves the deadline forward; when the timer
+				 fires early it is simply re-armed for the new deadline.
+
 
 
 
@@ -44,35 +48,12 @@
 #include "IdleTask.h"
 
 #include "OSThread.h"
-#include "OSQueue.h"
+#include "OSTimingWheel.h"
 #include "OSMutex.h"
 #include "OS.h"
 
 #define TIMEOUT_DEBUGGING 0 //messages to help debugging timeouts
 
-class TimeoutTaskThread : public IdleTask
-{
-public:
-
-	//All timeout tasks get timed out from this thread
-	TimeoutTaskThread() : IdleTask(), fMutex() { this->SetTaskName("TimeoutTask"); }
-	virtual     ~TimeoutTaskThread() {}
-
-private:
-
-	//this thread runs every minute and checks for timeouts
-	enum
-	{
-		kIntervalSeconds = 15   //UInt32
-	};
-
-	virtual SInt64          Run();
-	OSMutex                 fMutex;
-	OSQueue                 fQueue;
-
-	friend class TimeoutTask;
-};
-
 class TimeoutTask
 {
 	//TimeoutTask is not a derived object off of Task, to add flexibility as
@@ -80,7 +61,7 @@ class TimeoutTask
 
 public:
 
-	//Call Initialize before using this class
+	//Call Initialize before using this class. The task threads must already exist.
 	static  void Initialize();
 	//Pass in the task you'd like to send timeouts to. 
 	//Also pass in the timeout you'd like to use. By default, the timeout is 0 (NEVER).
@@ -99,15 +80,23 @@ public:
 	void        SetTask(Task* inTask) { fTask = inTask; }
 private:
 
+	//a task that stays timed out is signalled again at this interval
+	enum
+	{
+		kIntervalSeconds = 15   //UInt32
+	};
+
+	//Called by fTimerThread, with its fTimerMutex held, when fTimerElem expires
+	void        Expire(SInt64 inCurrentTime);
+
 	Task*       fTask;
 	SInt64      fTimeoutAtThisTime;
 	SInt64      fTimeoutInMilSecs;
-	//for putting on our global queue of timeout tasks
-	OSQueueElem fQueueElem;
 
-	static TimeoutTaskThread*   sThread;
+	OSTimerElem fTimerElem;
+	TaskThread* fTimerThread;
 
-	friend class TimeoutTaskThread;
+	friend class TaskThread;
 };
 #endif //__TIMEOUTTASK_H__
 
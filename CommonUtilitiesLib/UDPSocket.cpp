@@ -50,13 +50,302 @@
 
 #include <errno.h>
 #include "UDPSocket.h"
+#include "OSCounters.h"
+#include "OS.h"
+
+#if __linux__
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#endif
 
 #ifdef USE_NETLOG
 #include <netlog.h>
 #endif
 
+#if __linux__
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef SOL_UDP
+#define SOL_UDP 17
+#endif
+#endif
+
+UInt32          UDPSocket::sSendBatchSize = 32;
+bool            UDPSocket::sGSOEnabled = true;
+
+#if __linux__
+
+//
+// UDPSendBatch
+//
+// One per thread. Queued packets become mmsghdrs; each message owns a contiguous
+// run of fIov. While GSO is usable, a packet going to the same fd and destination
+// as the last message, and no bigger than that message's first segment, is
+// appended to it instead of starting a new message. A shorter packet closes the
+// message, since only the last GSO segment may be short.
+class UDPSendBatch
+{
+public:
+
+	UDPSendBatch() : fNumMsgs(0), fNumPackets(0), fLastMsgErr(OS_NoErr) {}
+	~UDPSendBatch() {}
+
+	void        Add(int inFileDesc, UInt32 inRemoteAddr, UInt16 inRemotePort, void* inBuffer, UInt32 inLength);
+	// Returns the error of the message holding the last packet added, if it was not sent
+	OS_Error    Flush();
+	bool        IsFull() { return fNumPackets >= UDPSocket::sSendBatchSize; }
+
+	static UDPSendBatch*    GetBatch();
+	static bool             KernelHasGSO() { return sKernelHasGSO; }
+
+private:
+
+	enum
+	{
+		kMaxGSOSegments = 64,       //UInt32, UDP_MAX_SEGMENTS
+		kMaxGSOBytes = 63 * 1024    //UInt32, stay under the 64K datagram limit
+	};
+
+	struct MsgInfo
+	{
+		int     fFileDesc;
+		UInt32  fFirstIov;
+		UInt32  fNumSegments;
+		UInt32  fSegmentSize;
+		UInt32  fTotalBytes;
+		bool    fClosed;
+	};
+
+	void        SendMessages(int inFileDesc, UInt32* inMsgIndexes, UInt32 inNumMsgs);
+	OS_Error    SendSegmentsSeparately(UInt32 inMsgIndex);
+
+	struct mmsghdr      fMsgs[UDPSocket::kMaxSendBatchSize];
+	struct sockaddr_in  fAddrs[UDPSocket::kMaxSendBatchSize];
+	struct iovec        fIov[UDPSocket::kMaxSendBatchSize];
+	MsgInfo             fInfo[UDPSocket::kMaxSendBatchSize];
+	char                fControl[UDPSocket::kMaxSendBatchSize][CMSG_SPACE(sizeof(UInt16))];
+	UInt32              fNumMsgs;
+	UInt32              fNumPackets;
+	OS_Error            fLastMsgErr;
+
+	static void         MakeKey();
+	static void         DeleteBatch(void* inBatch) { delete (UDPSendBatch*)inBatch; }
+
+	static pthread_once_t   sKeyOnce;
+	static pthread_key_t    sKey;
+	static bool             sKernelHasGSO;
+};
+
+pthread_once_t  UDPSendBatch::sKeyOnce = PTHREAD_ONCE_INIT;
+pthread_key_t   UDPSendBatch::sKey;
+bool            UDPSendBatch::sKernelHasGSO = false;
+
+void UDPSendBatch::MakeKey()
+{
+	::pthread_key_create(&sKey, DeleteBatch);
+
+	//UDP_SEGMENT is only understood by Linux 4.18 and later. Older kernels silently
+	//ignore the cmsg and would send the whole run as one big datagram, so probe first.
+	int theSocket = ::socket(AF_INET, SOCK_DGRAM, 0);
+	if (theSocket >= 0)
+	{
+		int theSegmentSize = 0;
+		socklen_t theLen = sizeof(theSegmentSize);
+		sKernelHasGSO = (::getsockopt(theSocket, SOL_UDP, UDP_SEGMENT, &theSegmentSize, &theLen) == 0);
+		::close(theSocket);
+	}
+}
+
+UDPSendBatch* UDPSendBatch::GetBatch()
+{
+	::pthread_once(&sKeyOnce, MakeKey);
+	UDPSendBatch* theBatch = (UDPSendBatch*)::pthread_getspecific(sKey);
+	if (theBatch == NULL)
+	{
+		theBatch = new UDPSendBatch();
+		::pthread_setspecific(sKey, theBatch);
+	}
+	return theBatch;
+}
+
+void UDPSendBatch::Add(int inFileDesc, UInt32 inRemoteAddr, UInt16 inRemotePort, void* inBuffer, UInt32 inLength)
+{
+	Assert(fNumPackets < UDPSocket::kMaxSendBatchSize);
+
+	UInt32 theAddr = htonl(inRemoteAddr);
+	UInt16 thePort = htons(inRemotePort);
+
+	fIov[fNumPackets].iov_base = inBuffer;
+	fIov[fNumPackets].iov_len = inLength;
+
+	if (fNumMsgs > 0 && UDPSocket::sGSOEnabled && sKernelHasGSO)
+	{
+		MsgInfo& theLast = fInfo[fNumMsgs - 1];
+		if ((!theLast.fClosed) &&
+			(theLast.fFileDesc == inFileDesc) &&
+			(fAddrs[fNumMsgs - 1].sin_addr.s_addr == theAddr) &&
+			(fAddrs[fNumMsgs - 1].sin_port == thePort) &&
+			(inLength > 0) && (inLength <= theLast.fSegmentSize) &&
+			(theLast.fNumSegments < kMaxGSOSegments) &&
+			(theLast.fTotalBytes + inLength <= kMaxGSOBytes))
+		{
+			theLast.fNumSegments++;
+			theLast.fTotalBytes += inLength;
+			if (inLength < theLast.fSegmentSize)
+				theLast.fClosed = true;
+			fMsgs[fNumMsgs - 1].msg_hdr.msg_iovlen = theLast.fNumSegments;
+			fNumPackets++;
+			return;
+		}
+	}
+
+	struct sockaddr_in& theRemote = fAddrs[fNumMsgs];
+	::memset(&theRemote, 0, sizeof(theRemote));
+	theRemote.sin_family = AF_INET;
+	theRemote.sin_port = thePort;
+	theRemote.sin_addr.s_addr = theAddr;
+
+	MsgInfo& theInfo = fInfo[fNumMsgs];
+	theInfo.fFileDesc = inFileDesc;
+	theInfo.fFirstIov = fNumPackets;
+	theInfo.fNumSegments = 1;
+	theInfo.fSegmentSize = inLength;
+	theInfo.fTotalBytes = inLength;
+	theInfo.fClosed = (inLength == 0);
+
+	struct msghdr& theHdr = fMsgs[fNumMsgs].msg_hdr;
+	::memset(&theHdr, 0, sizeof(theHdr));
+	theHdr.msg_name = &theRemote;
+	theHdr.msg_namelen = sizeof(theRemote);
+	theHdr.msg_iov = &fIov[fNumPackets];
+	theHdr.msg_iovlen = 1;
+	fMsgs[fNumMsgs].msg_len = 0;
+
+	fNumMsgs++;
+	fNumPackets++;
+}
+
+OS_Error UDPSendBatch::Flush()
+{
+	if (fNumMsgs == 0)
+		return OS_NoErr;
+
+	fLastMsgErr = OS_NoErr;
+
+	//attach the segment size to every message that carries more than one packet
+	for (UInt32 x = 0; x < fNumMsgs; x++)
+	{
+		struct msghdr& theHdr = fMsgs[x].msg_hdr;
+		if (fInfo[x].fNumSegments > 1)
+		{
+			theHdr.msg_control = fControl[x];
+			theHdr.msg_controllen = sizeof(fControl[x]);
+			struct cmsghdr* theCmsg = CMSG_FIRSTHDR(&theHdr);
+			theCmsg->cmsg_level = SOL_UDP;
+			theCmsg->cmsg_type = UDP_SEGMENT;
+			theCmsg->cmsg_len = CMSG_LEN(sizeof(UInt16));
+			*(UInt16*)CMSG_DATA(theCmsg) = (UInt16)fInfo[x].fSegmentSize;
+		}
+		else
+		{
+			theHdr.msg_control = NULL;
+			theHdr.msg_controllen = 0;
+		}
+	}
+
+	//sendmmsg works on a single socket, so send each fd's messages together, in queue order
+	bool theDone[UDPSocket::kMaxSendBatchSize];
+	::memset(theDone, 0, sizeof(theDone));
+	UInt32 theIndexes[UDPSocket::kMaxSendBatchSize];
+	for (UInt32 x = 0; x < fNumMsgs; x++)
+	{
+		if (theDone[x])
+			continue;
+
+		UInt32 theCount = 0;
+		for (UInt32 y = x; y < fNumMsgs; y++)
+		{
+			if (!theDone[y] && (fInfo[y].fFileDesc == fInfo[x].fFileDesc))
+			{
+				theIndexes[theCount++] = y;
+				theDone[y] = true;
+			}
+		}
+		this->SendMessages(fInfo[x].fFileDesc, theIndexes, theCount);
+	}
+
+	OSCounters::Add(OSCounters::kUDPBatchedPackets, fNumPackets);
+	fNumMsgs = 0;
+	fNumPackets = 0;
+	return fLastMsgErr;
+}
+
+void UDPSendBatch::SendMessages(int inFileDesc, UInt32* inMsgIndexes, UInt32 inNumMsgs)
+{
+	struct mmsghdr theMsgs[UDPSocket::kMaxSendBatchSize];
+	for (UInt32 x = 0; x < inNumMsgs; x++)
+		theMsgs[x] = fMsgs[inMsgIndexes[x]];
+
+	UInt32 theSent = 0;
+	while (theSent < inNumMsgs)
+	{
+		int theResult = ::sendmmsg(inFileDesc, &theMsgs[theSent], inNumMsgs - theSent, 0);
+		OSCounters::Add(OSCounters::kUDPBatchSyscalls, 1);
+		if (theResult > 0)
+		{
+			theSent += theResult;
+			continue;
+		}
+
+		//The message at theSent failed. A GSO send can be refused where a plain one
+		//would not be (no checksum offload, path MTU smaller than the segment), so
+		//retry its packets one by one. Otherwise it is dropped like any other lost
+		//UDP packet and the rest still go out.
+		int theErr = OSThread::GetErrno();
+		if (theErr == EINTR)
+			continue;
+
+		if (theErr == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketWritesWouldBlock, 1);
+
+		UInt32 theIndex = inMsgIndexes[theSent];
+		OS_Error theMsgErr = (OS_Error)theErr;
+		if (fInfo[theIndex].fNumSegments > 1)
+		{
+			if ((theErr == EIO) || (theErr == ENOPROTOOPT) || (theErr == EOPNOTSUPP))
+				UDPSocket::sGSOEnabled = false;
+			theMsgErr = this->SendSegmentsSeparately(theIndex);
+		}
+		if (theIndex == fNumMsgs - 1)
+			fLastMsgErr = theMsgErr;
+		theSent++;
+	}
+}
+
+OS_Error UDPSendBatch::SendSegmentsSeparately(UInt32 inMsgIndex)
+{
+	//the result is the last segment's, which is the last packet added to the message
+	OS_Error theErr = OS_NoErr;
+	MsgInfo& theInfo = fInfo[inMsgIndex];
+	for (UInt32 x = 0; x < theInfo.fNumSegments; x++)
+	{
+		struct iovec& theIov = fIov[theInfo.fFirstIov + x];
+		int theResult = ::sendto(theInfo.fFileDesc, theIov.iov_base, theIov.iov_len, 0,
+			(sockaddr*)&fAddrs[inMsgIndex], sizeof(fAddrs[inMsgIndex]));
+		theErr = (theResult == -1) ? (OS_Error)OSThread::GetErrno() : OS_NoErr;
+	}
+	return theErr;
+}
+
+#endif //__linux__
+
 UDPSocket::UDPSocket(Task* inTask, UInt32 inSocketType)
-	: Socket(inTask, inSocketType), fDemuxer(NULL)
+	: Socket(inTask, inSocketType), fDemuxer(NULL),
+	fReadyQueue(NULL), fReadyElem(this), fArrivalTimestamps(false)
 {
 	if (inSocketType & kWantsDemuxer)
 		fDemuxer = new UDPDemuxer();
@@ -65,6 +354,28 @@ UDPSocket::UDPSocket(Task* inTask, UInt32 inSocketType)
 	::memset(&fMsgAddr, 0, sizeof(fMsgAddr));
 }
 
+UDPSocket::~UDPSocket()
+{
+	if (fReadyQueue != NULL)
+	{
+		//Unregister from the event thread first, so ProcessEvent can't put us
+		//back on the ready queue after we have taken ourselves off it.
+		this->Cleanup();
+		fReadyQueue->Remove(&fReadyElem);
+	}
+
+	if (fDemuxer != NULL)
+		delete fDemuxer;
+}
+
+void UDPSocket::ProcessEvent(int eventBits)
+{
+	if (fReadyQueue != NULL)
+		fReadyQueue->EnQueue(&fReadyElem);  //no-op if we are already queued
+
+	Socket::ProcessEvent(eventBits);
+}
+
 
 OS_Error
 UDPSocket::SendTo(UInt32 inRemoteAddr, UInt16 inRemotePort, void* inBuffer, UInt32 inLength)
@@ -83,11 +394,63 @@ UDPSocket::SendTo(UInt32 inRemoteAddr, UInt16 inRemotePort, void* inBuffer, UInt
 	int theErr = ::sendto(fFileDesc, (char*)inBuffer, inLength, 0, (sockaddr*)&theRemoteAddr, sizeof(theRemoteAddr));
 #endif
 
+	OSCounters::Add(OSCounters::kSocketWrites, 1);
 	if (theErr == -1)
+	{
+		if (OSThread::GetErrno() == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketWritesWouldBlock, 1);
 		return (OS_Error)OSThread::GetErrno();
+	}
 	return OS_NoErr;
 }
 
+OS_Error UDPSocket::QueueSendTo(UInt32 inRemoteAddr, UInt16 inRemotePort, void* inBuffer, UInt32 inLength)
+{
+	Assert(inBuffer != NULL);
+
+#if __linux__
+	if (sSendBatchSize > 1)
+	{
+		UDPSendBatch* theBatch = UDPSendBatch::GetBatch();
+		theBatch->Add(fFileDesc, inRemoteAddr, inRemotePort, inBuffer, inLength);
+		if (theBatch->IsFull())
+			return theBatch->Flush();
+		return OS_NoErr;
+	}
+#endif
+
+	return this->SendTo(inRemoteAddr, inRemotePort, inBuffer, inLength);
+}
+
+void UDPSocket::FlushSendBatch()
+{
+#if __linux__
+	UDPSendBatch::GetBatch()->Flush();
+#endif
+}
+
+UInt32 UDPSocket::GetNumBatchedPackets()
+{
+	return (UInt32)OSCounters::Get(OSCounters::kUDPBatchedPackets);
+}
+
+UInt32 UDPSocket::GetNumBatchSyscalls()
+{
+	return (UInt32)OSCounters::Get(OSCounters::kUDPBatchSyscalls);
+}
+
+void UDPSocket::SetSendBatchSize(UInt32 inNumPackets)
+{
+	if (inNumPackets > kMaxSendBatchSize)
+		inNumPackets = kMaxSendBatchSize;
+
+#if __linux__
+	//packets already queued on this thread go out under the old limit
+	UDPSendBatch::GetBatch()->Flush();
+#endif
+	sSendBatchSize = inNumPackets;
+}
+
 OS_Error UDPSocket::RecvFrom(UInt32* outRemoteAddr, UInt16* outRemotePort,
 	void* ioBuffer, UInt32 inBufLen, UInt32* outRecvLen)
 {
@@ -108,8 +471,13 @@ OS_Error UDPSocket::RecvFrom(UInt32* outRemoteAddr, UInt16* outRemotePort,
 	SInt32 theRecvLen = ::recvfrom(fFileDesc, (char*)ioBuffer, inBufLen, 0, (sockaddr*)&fMsgAddr, &addrLen);
 #endif
 
+	OSCounters::Add(OSCounters::kSocketReads, 1);
 	if (theRecvLen == -1)
+	{
+		if (OSThread::GetErrno() == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketReadsWouldBlock, 1);
 		return (OS_Error)OSThread::GetErrno();
+	}
 
 	*outRemoteAddr = ntohl(fMsgAddr.sin_addr.s_addr);
 	*outRemotePort = ntohs(fMsgAddr.sin_port);
@@ -118,6 +486,121 @@ OS_Error UDPSocket::RecvFrom(UInt32* outRemoteAddr, UInt16* outRemotePort,
 	return OS_NoErr;
 }
 
+OS_Error UDPSocket::RecvBatch(UDPRecvPacket* ioPackets, UInt32 inNumPackets, UInt32* outNumPackets)
+{
+	Assert(ioPackets != NULL);
+	Assert(outNumPackets != NULL);
+	*outNumPackets = 0;
+
+#if __linux__
+	if (inNumPackets > kMaxRecvBatchSize)
+		inNumPackets = kMaxRecvBatchSize;
+
+	struct mmsghdr      theMsgs[kMaxRecvBatchSize];
+	struct iovec        theIov[kMaxRecvBatchSize];
+	struct sockaddr_in  theAddrs[kMaxRecvBatchSize];
+	char                theControl[kMaxRecvBatchSize][CMSG_SPACE(sizeof(struct timespec))];
+
+	for (UInt32 x = 0; x < inNumPackets; x++)
+	{
+		theIov[x].iov_base = ioPackets[x].fBuffer;
+		theIov[x].iov_len = ioPackets[x].fBufferLen;
+
+		struct msghdr& theHdr = theMsgs[x].msg_hdr;
+		::memset(&theHdr, 0, sizeof(theHdr));
+		theHdr.msg_name = &theAddrs[x];
+		theHdr.msg_namelen = sizeof(theAddrs[x]);
+		theHdr.msg_iov = &theIov[x];
+		theHdr.msg_iovlen = 1;
+		if (fArrivalTimestamps)
+		{
+			theHdr.msg_control = theControl[x];
+			theHdr.msg_controllen = sizeof(theControl[x]);
+		}
+		theMsgs[x].msg_len = 0;
+	}
+
+	int theNumMsgs = ::recvmmsg(fFileDesc, theMsgs, inNumPackets, 0, NULL);
+	OSCounters::Add(OSCounters::kSocketReads, 1);
+	if (theNumMsgs <= 0)
+	{
+		OS_Error theErr = (theNumMsgs == 0) ? (OS_Error)EAGAIN : (OS_Error)OSThread::GetErrno();
+		if (theErr == EAGAIN)
+			OSCounters::Add(OSCounters::kSocketReadsWouldBlock, 1);
+		return theErr;
+	}
+
+	//Kernel timestamps are wall clock time. Convert them by their age relative to
+	//now, so they land on the OS::Milliseconds() time base whatever its offset.
+	SInt64 theCurrentTime = OS::Milliseconds();
+	SInt64 theWallClockNow = 0;
+	if (fArrivalTimestamps)
+	{
+		struct timespec theNow;
+		::clock_gettime(CLOCK_REALTIME, &theNow);
+		theWallClockNow = ((SInt64)theNow.tv_sec * 1000) + (theNow.tv_nsec / 1000000);
+	}
+
+	for (int x = 0; x < theNumMsgs; x++)
+	{
+		UDPRecvPacket& thePacket = ioPackets[x];
+		thePacket.fLength = theMsgs[x].msg_len;
+		thePacket.fRemoteAddr = ntohl(theAddrs[x].sin_addr.s_addr);
+		thePacket.fRemotePort = ntohs(theAddrs[x].sin_port);
+		thePacket.fArrivalTime = theCurrentTime;
+
+		if (!fArrivalTimestamps)
+			continue;
+
+		struct msghdr& theHdr = theMsgs[x].msg_hdr;
+		for (struct cmsghdr* theCmsg = CMSG_FIRSTHDR(&theHdr); theCmsg != NULL; theCmsg = CMSG_NXTHDR(&theHdr, theCmsg))
+		{
+			if ((theCmsg->cmsg_level == SOL_SOCKET) && (theCmsg->cmsg_type == SO_TIMESTAMPNS))
+			{
+				struct timespec theStamp;
+				::memcpy(&theStamp, CMSG_DATA(theCmsg), sizeof(theStamp));
+				SInt64 theAge = theWallClockNow - (((SInt64)theStamp.tv_sec * 1000) + (theStamp.tv_nsec / 1000000));
+				if ((theAge > 0) && (theAge < kMaxArrivalAgeMSec))   //ignore wall clock steps
+					thePacket.fArrivalTime = theCurrentTime - theAge;
+				break;
+			}
+		}
+	}
+
+	*outNumPackets = (UInt32)theNumMsgs;
+	return OS_NoErr;
+#else
+	SInt64 theCurrentTime = OS::Milliseconds();
+	while (*outNumPackets < inNumPackets)
+	{
+		UDPRecvPacket& thePacket = ioPackets[*outNumPackets];
+		thePacket.fLength = 0;
+		OS_Error theErr = this->RecvFrom(&thePacket.fRemoteAddr, &thePacket.fRemotePort,
+			thePacket.fBuffer, thePacket.fBufferLen, &thePacket.fLength);
+		if (theErr != OS_NoErr)
+			return (*outNumPackets > 0) ? OS_NoErr : theErr;
+
+		thePacket.fArrivalTime = theCurrentTime;
+		(*outNumPackets)++;
+	}
+	return OS_NoErr;
+#endif
+}
+
+OS_Error UDPSocket::EnableArrivalTimestamps()
+{
+#if __linux__ && defined(SO_TIMESTAMPNS)
+	int theOn = 1;
+	if (::setsockopt(fFileDesc, SOL_SOCKET, SO_TIMESTAMPNS, &theOn, sizeof(theOn)) == -1)
+		return (OS_Error)OSThread::GetErrno();
+
+	fArrivalTimestamps = true;
+	return OS_NoErr;
+#else
+	return (OS_Error)ENOTSUP;
+#endif
+}
+
 OS_Error UDPSocket::JoinMulticast(UInt32 inRemoteAddr)
 {
 	struct ip_mreq  theMulti;
@@ -43,7 +43,21 @@
 
 #include "Socket.h"
 #include "UDPDemuxer.h"
+#include "OSQueue.h"
 
+//One datagram slot for UDPSocket::RecvBatch. The caller sets fBuffer and fBufferLen,
+//RecvBatch fills in the rest.
+struct UDPRecvPacket
+{
+	void*   fBuffer;
+	UInt32  fBufferLen;
+
+	UInt32  fLength;
+	UInt32  fRemoteAddr;    //host byte order
+	UInt16  fRemotePort;
+	SInt64  fArrivalTime;   //OS::Milliseconds() time base. The kernel receive time
+							//when arrival timestamps are enabled, else when it was read
+};
 
 class UDPSocket : public Socket
 {
@@ -57,7 +71,7 @@ public:
 	};
 
 	UDPSocket(Task* inTask, UInt32 inSocketType);
-	virtual ~UDPSocket() { if (fDemuxer != NULL) delete fDemuxer; }
+	virtual ~UDPSocket();
 
 	//Open
 	OS_Error    Open() { return Socket::Open(SOCK_DGRAM); }
@@ -71,18 +85,73 @@ public:
 	OS_Error        SendTo(UInt32 inRemoteAddr, UInt16 inRemotePort,
 		void* inBuffer, UInt32 inLength);
 
+	//Batched sends. The packet is queued on the calling thread's send batch and goes
+	//out with the next FlushSendBatch() on that thread, or earlier if the batch fills.
+	//Packets are written with sendmmsg(), and runs of equal sized packets to the same
+	//destination are coalesced into one UDP GSO send when the kernel supports it.
+	//inBuffer must stay untouched until the batch has been flushed.
+	//Returns an ERRNO if the packet filled the batch and could not be sent. A packet
+	//that is only queued returns OS_NoErr; a later failure to send it is not reported.
+	OS_Error        QueueSendTo(UInt32 inRemoteAddr, UInt16 inRemotePort,
+		void* inBuffer, UInt32 inLength);
+
+	static void     FlushSendBatch();
+
+	//Maximum number of datagrams per sendmmsg() call. 0 or 1 turns batching off
+	//and QueueSendTo sends right away.
+	static void     SetSendBatchSize(UInt32 inNumPackets);
+	static void     SetGSOEnabled(bool inEnabled) { sGSOEnabled = inEnabled; }
+
+	//Totals over all threads, from OSCounters
+	static UInt32   GetNumBatchedPackets();
+	static UInt32   GetNumBatchSyscalls();
+
+	enum
+	{
+		kMaxSendBatchSize = 64, //UInt32
+		kMaxRecvBatchSize = 32, //UInt32
+		kMaxArrivalAgeMSec = 10000  //SInt64
+	};
+
 	OS_Error        RecvFrom(UInt32* outRemoteAddr, UInt16* outRemotePort,
 		void* ioBuffer, UInt32 inBufLen, UInt32* outRecvLen);
 
+	//Reads up to inNumPackets datagrams with one recvmmsg() call. *outNumPackets is
+	//the number filled in, from the front of ioPackets. Returns EAGAIN when
+	//nothing was waiting. Fewer than inNumPackets means the socket is drained.
+	OS_Error        RecvBatch(UDPRecvPacket* ioPackets, UInt32 inNumPackets, UInt32* outNumPackets);
+
+	//Asks the kernel to stamp every datagram with its arrival time (SO_TIMESTAMPNS),
+	//which RecvBatch then reports instead of the time it was read.
+	OS_Error        EnableArrivalTimestamps();
+
+	//Sockets with a ready queue put themselves on it whenever they become readable,
+	//before signalling their task, so the task only services the sockets that have
+	//data. The queue must outlive the socket.
+	void            SetReadyQueue(OSQueue* inQueue) { fReadyQueue = inQueue; }
+
 	//A UDP socket may or may not have a demuxer associated with it. The demuxer
 	//is a data structure so the socket can associate incoming data with the proper
 	//task to process that data (based on source IP addr & port)
 	UDPDemuxer*         GetDemuxer() { return fDemuxer; }
 
+protected:
+
+	virtual void    ProcessEvent(int eventBits);
+
 private:
 
 	UDPDemuxer* fDemuxer;
 	struct sockaddr_in  fMsgAddr;
+
+	OSQueue*    fReadyQueue;
+	OSQueueElem fReadyElem;
+	bool        fArrivalTimestamps;
+
+	static UInt32       sSendBatchSize;
+	static bool         sGSOEnabled;
+
+	friend class UDPSendBatch;
 };
 #endif // __UDPSOCKET_H__
 
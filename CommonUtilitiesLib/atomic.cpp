@@ -26,6 +26,52 @@
 #include "atomic.h"
 #include "OSMutex.h"
 
+#if defined(__GNUC__)
+
+//
+// gcc and clang provide real interlocked instructions, so the global mutex below
+// is only needed for compilers without the __sync builtins.
+
+unsigned int atomic_add(unsigned int* area, int val)
+{
+	return __sync_add_and_fetch(area, (unsigned int)val);
+}
+
+unsigned int atomic_sub(unsigned int* area, int val)
+{
+	return __sync_sub_and_fetch(area, (unsigned int)val);
+}
+
+unsigned int atomic_or(unsigned int* area, unsigned int val)
+{
+	return __sync_fetch_and_or(area, val);
+}
+
+unsigned int compare_and_store(unsigned int oval, unsigned int nval, unsigned int* area)
+{
+	return __sync_bool_compare_and_swap(area, oval, nval) ? 1 : 0;
+}
+
+unsigned int compare_and_store_ptr(void* oval, void* nval, void** area)
+{
+	return __sync_bool_compare_and_swap(area, oval, nval) ? 1 : 0;
+}
+
+void* atomic_swap_ptr(void** area, void* nval)
+{
+	//__sync_lock_test_and_set is only an acquire barrier
+	void* oldval = __sync_lock_test_and_set(area, nval);
+	__sync_synchronize();
+	return oldval;
+}
+
+void atomic_barrier(void)
+{
+	__sync_synchronize();
+}
+
+#else
+
 static OSMutex sAtomicMutex;
 
 unsigned int atomic_add(unsigned int* area, int val)
@@ -63,3 +109,32 @@ unsigned int compare_and_store(unsigned int oval, unsigned int nval, unsigned in
 		rv = 0;
 	return rv;
 }
+
+unsigned int compare_and_store_ptr(void* oval, void* nval, void** area)
+{
+	int rv;
+	OSMutexLocker locker(&sAtomicMutex);
+	if (oval == *area)
+	{
+		rv = 1;
+		*area = nval;
+	}
+	else
+		rv = 0;
+	return rv;
+}
+
+void* atomic_swap_ptr(void** area, void* nval)
+{
+	OSMutexLocker locker(&sAtomicMutex);
+	void* oldval = *area;
+	*area = nval;
+	return oldval;
+}
+
+void atomic_barrier(void)
+{
+	OSMutexLocker locker(&sAtomicMutex);
+}
+
+#endif
@@ -81,6 +81,16 @@ extern "C" {
 
 	extern unsigned int atomic_sub(unsigned int* area, int val);
 
+	/* Pointer sized variants, used by the lock-free task queues */
+
+	extern unsigned int compare_and_store_ptr(void* oval, void* nval, void** area);
+
+	extern void* atomic_swap_ptr(void** area, void* nval);
+
+	/* Full memory barrier */
+
+	extern void atomic_barrier(void);
+
 	extern void queue_atomic(unsigned int* anchor,
 		unsigned int* elem, unsigned int disp);
 
@@ -4,184 +4,154 @@
 	WEChat: EasyDarwin
 	Website: http://www.easydarwin.org
 	Author: Fantasy@EasyDarwin.org
-*/
-#include "epollEvent.h"
-#include <sys/errno.h>
-#include <sys/time.h>
-#include <map>
-#include "OSMutex.h"
-
-using namespace std;
-#if defined(__linux__)
-#define MAX_EPOLL_FD	20000
-
-static int epollfd = 0; 	//epoll 描述符
-static epoll_event* _events = NULL; //epoll事件接收数组
-static int m_curEventReadPos = 0;  //当前读事件位置，在epoll事件数组中的位置
-static int m_curTotalEvents = 0;   //总的事件个数，每次epoll_wait之后更新
-static OSMutex sMaxFDPosMutex;		//锁
-static bool canEpoll = false;		//是否可以执行epoll_wait,避免频繁执行，浪费CPU
-static map<int ,void *> epollFdmap;//映射 fd和对应的RTSPSession对象
-/*
-函数名:epollInit
-功能:初始化epoll，创建epollfd，申请epoll事件接收内存
-*/
-int epollInit()
-{
-    epollfd = epoll_create(MAX_EPOLL_FD);
-    
-    if(_events == NULL)
-    {
-        _events = new epoll_event[MAX_EPOLL_FD];//we only listen the read event
-    }
-    if(_events == NULL)
-    {
-        perror("new epoll_event error:");
-        exit(1);
-    }
-    m_curEventReadPos = 0;
-    m_curTotalEvents = 0;
-	return 0;
-}
-
-/*
-函数名:addEpollEvent
-功能:增加一个epoll监听事件，参数1 请求结构 参数2 事件类型
-*/
-int addEpollEvent(struct eventreq *req,int event)
-{
-    if(req == NULL)
-    {
-        return -1;
-    }
-	struct epoll_event ev;
-	memset(&ev,0x0,sizeof(ev));
-
-    int ret = -1;
-    OSMutexLocker locker(&sMaxFDPosMutex);//加锁，防止线程池中的多个线程执行该函数，导致插入监听事件失败
-    if(event == EV_RE)
-    {
-        ev.data.fd = req->er_handle;
-        ev.events = EPOLLIN|EPOLLHUP|EPOLLERR;//level triggle
-        
-        ret = epoll_ctl(epollfd,EPOLL_CTL_ADD,req->er_handle,&ev);        
-    }
-    else if(event == EV_WR)
-    {
-        ev.data.fd = req->er_handle;
-        ev.events = EPOLLOUT;//level triggle
-        
-        ret = epoll_ctl(epollfd,EPOLL_CTL_ADD,req->er_handle,&ev); 
-    }
-    else if(event == EV_RM)
-    {
-        ret = epoll_ctl(epollfd,EPOLL_CTL_DEL,req->er_handle,NULL);//remove all this fd events
-    }
-    else//epoll can not listen RESET
-    {//we dont needed
-
-    }
-
-    epollFdmap[req->er_handle] = req->er_data;
-    canEpoll = true;//每次新增事件后可以马上执行epoll_wait，新增了监听事件，意味着接下来可能马上要发生事件在这个fd上
-    return 0;
-}
-
-/*
-函数名:deleteEpollEvent
-功能:删除一个epoll监听事件，参数1 要删除的fd
-*/
-int deleteEpollEvent(int& fd)
-{
-    int ret = -1;
-    OSMutexLocker locker(&sMaxFDPosMutex);    
-    ret = epoll_ctl(epollfd,EPOLL_CTL_DEL,fd,NULL);//remove all this fd events
-    canEpoll = true;//每删除一个fd后，可以马上执行epoll_wait，可能在删除掉的fd上出现读异常
-    return 0;
-}
-
-/*
-函数名:epollwaitevent
-功能:等待epoll监听事件，返回事件个数
-*/
-int epollwaitevent()
-{
-    if(canEpoll == false)
-    {
-        return -1;
-    }
-    int nfds = 0;
-    int curreadPos = -1;//m_curEventReadPos;//start from 0
-    if(m_curTotalEvents <= 0)//当前一个epoll事件都没有的时候，执行epoll_wait
-    {        
-        m_curTotalEvents = 0;
-        m_curEventReadPos = 0;
-        nfds = epoll_wait(epollfd,_events,MAX_EPOLL_FD,15000);
-        
-        if(nfds > 0)
-        {
-            canEpoll = false;//wait到了epoll事件，先处理完再wait
-            m_curTotalEvents = nfds;
-        }
-        else if(nfds < 0)
-        {
-
-        }
-        else if(nfds == 0)
-        {
-            canEpoll = true;//这一次wait超时了，下一次继续wait
-        }
-        
-    }
-
-    if(m_curTotalEvents)//从事件数组中每次取一个，取的位置通过m_curEventReadPos设置
-    {
-        curreadPos = m_curEventReadPos;
-        m_curEventReadPos ++;
-        if(m_curEventReadPos >= m_curTotalEvents - 1)
-        {
-             m_curEventReadPos = 0;
-             m_curTotalEvents = 0;
-        }
-    }
-
-    return curreadPos;
-}
-/*
-函数名:epoll_waitevent
-功能:等待一个epoll监听事件，返回一个事件，参数1：返回事件的指针 参数2 忽略
-*/
-int epoll_waitevent(struct eventreq *req, void* onlyForMOSX)
-{    
-    int eventPos = -1;
-    eventPos = epollwaitevent();
-    if(eventPos >= 0)
-    {
-        req->er_handle = _events[eventPos].data.fd;
-        if(_events[eventPos].events == EPOLLIN|| _events[eventPos].events == EPOLLHUP|| _events[eventPos].events == EPOLLERR)
-        {
-            req->er_eventbits = EV_RE;//we only support read event
-        }
-        else if(_events[eventPos].events == EPOLLOUT)
-        {
-            req->er_eventbits = EV_WR;
-        }
-        req->er_data = epollFdmap[req->er_handle];
-        OSMutexLocker locker(&sMaxFDPosMutex);
-        deleteEpollEvent(req->er_handle);
-        return 0;
-    }
-    return EINTR;
-}
-
-/*
-函数名:epollDestory
-功能:销毁epoll，析构的时候
-*/
-int epollDestory()
-{
-    delete[] _events;
-    return 0;
-}
-#endif
-
+*/
+#include "epollEvent.h"
+#include <errno.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <stdint.h>
+
+#if defined(__linux__)
+
+EpollReactor::EpollReactor()
+	: fEpollFD(-1),
+	fEvents(NULL),
+	fFDTable(NULL),
+	fFDTableSize(0)
+{
+}
+
+EpollReactor::~EpollReactor()
+{
+	if (fEpollFD >= 0)
+		::close(fEpollFD);
+	delete[] fEvents;
+	delete[] fFDTable;
+}
+
+/*
+函数名:Initialize
+功能:创建epollfd，申请事件接收数组，按进程最大fd数申请fd索引表
+*/
+int EpollReactor::Initialize()
+{
+	fEpollFD = ::epoll_create(kMinFDTableSize);
+	if (fEpollFD < 0)
+	{
+		perror("epoll_create error:");
+		return -1;
+	}
+
+	//
+	// The table is indexed directly by fd, so it has to cover every descriptor
+	// this process may open. main() has already raised RLIMIT_NOFILE by now.
+	fFDTableSize = kMinFDTableSize;
+	struct rlimit rl;
+	if ((::getrlimit(RLIMIT_NOFILE, &rl) == 0) && (rl.rlim_cur != RLIM_INFINITY) && ((int)rl.rlim_cur > fFDTableSize))
+		fFDTableSize = (int)rl.rlim_cur;
+
+	fEvents = new epoll_event[kMaxEventsPerWait];
+	fFDTable = new FDEntry[fFDTableSize];
+	::memset(fFDTable, 0, sizeof(FDEntry) * fFDTableSize);
+	return 0;
+}
+
+/*
+函数名:AddEvent
+功能:注册或重新激活一个fd的监听事件(EPOLLONESHOT)，参数1 请求结构 参数2 事件类型
+*/
+int EpollReactor::AddEvent(struct eventreq* inReq, int inEvent)
+{
+	if (inReq == NULL)
+		return -1;
+
+	int fd = inReq->er_handle;
+	if ((fd < 0) || (fd >= fFDTableSize))
+		return -1;
+
+	if (inEvent == EV_RM)
+		return this->DeleteEvent(fd);
+
+	struct epoll_event ev;
+	::memset(&ev, 0x0, sizeof(ev));
+	ev.data.u64 = ((uint64_t)(uint32_t)(uintptr_t)inReq->er_data << 32) | (uint32_t)fd;
+	ev.events = EPOLLONESHOT;
+	if (inEvent & EV_RE)
+		ev.events |= EPOLLIN;
+	if (inEvent & EV_WR)
+		ev.events |= EPOLLOUT;
+
+	FDEntry& theEntry = fFDTable[fd];
+
+	int ret = 0;
+	if (__sync_fetch_and_or(&theEntry.fRegistered, 0) != 0)
+	{
+		//already in the set, just re-arm it
+		ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_MOD, fd, &ev);
+		if ((ret != 0) && (errno == ENOENT))
+			ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_ADD, fd, &ev);
+	}
+	else
+	{
+		ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_ADD, fd, &ev);
+		if ((ret != 0) && (errno == EEXIST))
+			ret = ::epoll_ctl(fEpollFD, EPOLL_CTL_MOD, fd, &ev);
+	}
+
+	if (ret == 0)
+		(void)__sync_lock_test_and_set(&theEntry.fRegistered, 1);
+
+	return ret;
+}
+
+/*
+函数名:DeleteEvent
+功能:从epoll集合中删除一个fd，参数1 要删除的fd
+*/
+int EpollReactor::DeleteEvent(int inFileDesc)
+{
+	if ((inFileDesc < 0) || (inFileDesc >= fFDTableSize))
+		return -1;
+
+	FDEntry& theEntry = fFDTable[inFileDesc];
+	if (__sync_lock_test_and_set(&theEntry.fRegistered, 0) == 0)
+		return 0;
+
+	return ::epoll_ctl(fEpollFD, EPOLL_CTL_DEL, inFileDesc, NULL);
+}
+
+/*
+函数名:WaitEvents
+功能:等待epoll事件，一次返回epoll_wait得到的全部事件
+*/
+int EpollReactor::WaitEvents(struct eventreq* outEvents, int inMaxEvents, int inTimeoutInMilSecs)
+{
+	if (inMaxEvents > kMaxEventsPerWait)
+		inMaxEvents = kMaxEventsPerWait;
+
+	int nfds = ::epoll_wait(fEpollFD, fEvents, inMaxEvents, inTimeoutInMilSecs);
+	if (nfds <= 0)
+		return nfds;
+
+	for (int x = 0; x < nfds; x++)
+	{
+		int fd = (int)(uint32_t)fEvents[x].data.u64;
+		struct eventreq& theReq = outEvents[x];
+
+		theReq.er_type = EV_FD;
+		theReq.er_handle = fd;
+		theReq.er_eventbits = 0;
+		if (fEvents[x].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+			theReq.er_eventbits |= EV_RE;
+		if (fEvents[x].events & EPOLLOUT)
+			theReq.er_eventbits |= EV_WR;
+
+		//if the fd was removed after epoll_wait returned, the stale cookie
+		//no longer resolves in the EventThread's ref table
+		theReq.er_data = (void*)(uintptr_t)(fEvents[x].data.u64 >> 32);
+	}
+
+	return nfds;
+}
+
+#endif
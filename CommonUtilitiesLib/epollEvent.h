@@ -4,30 +4,81 @@
 	WEChat: EasyDarwin
 	Website: http://www.easydarwin.org
 	Author: Fantasy@EasyDarwin.org
-*/
-
-#ifndef _EPOLLEVENT_H__
-#define _EPOLLEVENT_H__
-#if defined(__linux__)
-#include <stdio.h>
-#include <unistd.h>
-#include <sys/epoll.h>
-#include <stdlib.h>
-#include <string.h>
-#include "common.h"
-
-int epollInit();
-
-int addEpollEvent(struct eventreq *req,int event);//event {EV_RD,EV_RM}
-
-int deleteEpollEvent(int& fd);
-
-int epollwaitevent();
-
-int epoll_waitevent(struct eventreq *req, void* onlyForMOSX);//stay the same with old event
-
-int epollDestory();
-#endif
-
-#endif
-
+*/
+
+#ifndef _EPOLLEVENT_H__
+#define _EPOLLEVENT_H__
+#if defined(__linux__)
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.h"
+
+//
+// EpollReactor
+//
+// One epoll set plus a flat, fd-indexed table of which fds are in it.
+// Every EventThread owns one reactor, so no lock is shared between event threads.
+//
+// The er_data cookie (an EventContext unique ID, always below 2^32) travels in
+// the epoll event itself next to the fd. An fd may be armed from another thread
+// and fire before that thread returns from AddEvent, so the cookie must not
+// depend on table state the waiter could read too early.
+//
+// Descriptors are armed with EPOLLONESHOT: once an event fires the fd stays in
+// the set but is disarmed, and the next AddEvent re-arms it with EPOLL_CTL_MOD
+// instead of the old EPOLL_CTL_DEL + EPOLL_CTL_ADD pair.
+class EpollReactor
+{
+public:
+
+	EpollReactor();
+	~EpollReactor();
+
+	//
+	// Creates the epoll set and sizes the fd table from RLIMIT_NOFILE. Returns 0 on success.
+	int Initialize();
+
+	//
+	// Arms inReq->er_handle for inEvent (EV_RE and/or EV_WR). EV_RM removes the fd.
+	int AddEvent(struct eventreq* inReq, int inEvent);
+
+	//
+	// Removes the fd from this reactor. Must be called before the fd is closed.
+	int DeleteEvent(int inFileDesc);
+
+	//
+	// Blocks up to inTimeoutInMilSecs and copies every ready event into outEvents.
+	// Returns the number of events, 0 on timeout, or -1 with errno set.
+	int WaitEvents(struct eventreq* outEvents, int inMaxEvents, int inTimeoutInMilSecs);
+
+	enum
+	{
+		kMaxEventsPerWait = 1024,	//int
+		kMinFDTableSize = 20000		//int
+	};
+
+private:
+
+	//
+	// AddEvent and DeleteEvent for one fd may run on different threads, so
+	// fRegistered is only touched with __sync builtins. A stale read is harmless:
+	// AddEvent falls back between EPOLL_CTL_MOD and EPOLL_CTL_ADD on ENOENT/EEXIST,
+	// and the swap in DeleteEvent lets exactly one caller issue EPOLL_CTL_DEL.
+	struct FDEntry
+	{
+		unsigned int	fRegistered;	// non-zero while the fd is in the epoll set (armed or disarmed)
+	};
+
+	int			fEpollFD;
+	epoll_event* fEvents;
+	FDEntry*	fFDTable;
+	int			fFDTableSize;
+};
+
+#endif
+
+#endif
+
@@ -50,6 +50,10 @@ OBJECTFILES= \
 	${OBJECTDIR}/OSCond.o \
 	${OBJECTDIR}/OSFileSource.o \
 	${OBJECTDIR}/OSHeap.o \
+	${OBJECTDIR}/OSTimingWheel.o \
+	${OBJECTDIR}/OSEpoch.o \
+	${OBJECTDIR}/OSCounters.o \
+	${OBJECTDIR}/OSBlockCache.o \
 	${OBJECTDIR}/OSMapEx.o \
 	${OBJECTDIR}/OSMutex.o \
 	${OBJECTDIR}/OSMutexRW.o \
@@ -81,7 +85,6 @@ OBJECTFILES= \
 	${OBJECTDIR}/epollEvent.o \
 	${OBJECTDIR}/ev.o \
 	${OBJECTDIR}/getopt.o \
-	${OBJECTDIR}/keyframecache.o \
 	${OBJECTDIR}/md5.o \
 	${OBJECTDIR}/md5digest.o \
 	${OBJECTDIR}/sdpCache.o
@@ -188,6 +191,26 @@ ${OBJECTDIR}/OSHeap.o: OSHeap.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OSHeap.o OSHeap.cpp
 
+${OBJECTDIR}/OSTimingWheel.o: OSTimingWheel.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OSTimingWheel.o OSTimingWheel.cpp
+
+${OBJECTDIR}/OSEpoch.o: OSEpoch.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OSEpoch.o OSEpoch.cpp
+
+${OBJECTDIR}/OSCounters.o: OSCounters.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OSCounters.o OSCounters.cpp
+
+${OBJECTDIR}/OSBlockCache.o: OSBlockCache.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/OSBlockCache.o OSBlockCache.cpp
+
 ${OBJECTDIR}/OSMapEx.o: OSMapEx.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -343,11 +366,6 @@ ${OBJECTDIR}/getopt.o: getopt.c
 	${RM} "$@.d"
 	$(COMPILE.c) -O2 -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/getopt.o getopt.c
 
-${OBJECTDIR}/keyframecache.o: keyframecache.cpp
-	${MKDIR} -p ${OBJECTDIR}
-	${RM} "$@.d"
-	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DEASY_DEVICE -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I../Include -I../EasyDarwin/APICommonCode -I../EasyDarwin/APIStubLib -I../EasyDarwin/RTPMetaInfoLib -I../EasyProtocol/Include -I../RTSPUtilitiesLib -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/keyframecache.o keyframecache.cpp
-
 ${OBJECTDIR}/md5.o: md5.c
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -340,8 +340,9 @@ extern "C" {
 		qtssPrefsServiceWANPort = 24,   // "service_wan_port" //UInt16 // localhost destination port of reflected stream
 		qtssPrefsServiceWANIPAddr = 25,   // "service_wan_ip"    //char array    //client IP address the server monitor should reflect. *.*.*.* means all client addresses.
 		qtssPrefsNumMsgThreads = 26,   // "run_num_msg_threads" //UInt32 // if value is non-zero, the server will  create that many task threads; otherwise a single thread will be created.
+		qtssPrefsSnapQueueMaxEntries = 27,   // "snap_queue_max_entries" //UInt32 // posted snapshots waiting to be written to disk, a new channel's snapshot is dropped beyond this.
 
-		qtssPrefsNumParams = 27
+		qtssPrefsNumParams = 28
 	};
 
 	typedef UInt32 QTSS_PrefsAttributes;
@@ -0,0 +1,342 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       DeviceRegistryBench.cpp
+
+	Contains:   Measures the device map under a check-in storm: worker threads
+				re-register devices and resolve them for heartbeats and stream
+				requests, while one thread keeps building the device list the
+				way execNetMsgCSGetDeviceListReqRESTful does.
+
+				It runs the same load against a std::map behind one mutex (what
+				OSRefTableEx used to be) and against OSRefTableEx, and reports
+				operations per second, the worst resolve and the time a listing
+				takes. A filtered listing only asks for one app type, which the
+				sharded table serves from its index.
+
+				usage: DeviceRegistryBench [devices] [seconds per mode]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <string>
+
+#include "OS.h"
+#include "OSThread.h"
+#include "OSMutex.h"
+#include "OSRefTableEx.h"
+
+static const UInt32 kNumWorkers = 8;
+static const UInt32 kNumAppTypes = 3;
+static const UInt32 kResolvesPerRegister = 16;  // heartbeats and stream requests per check-in
+
+struct BenchDevice
+{
+	char    fName[32];
+	SInt32  fAppType;
+};
+
+//
+// The two tables the benchmark compares
+class Registry
+{
+public:
+
+	virtual ~Registry() {}
+
+	virtual bool    Register(const string& inKey, BenchDevice* inDevice) = 0;
+	virtual void    UnRegister(const string& inKey) = 0;
+	virtual bool    ResolveAndRelease(const string& inKey) = 0;
+
+	// Returns the number of devices listed, inAppType < 0 lists them all
+	virtual UInt32  List(SInt32 inAppType, string* ioList) = 0;
+};
+
+static void AppendDevice(BenchDevice* inDevice, string* ioList)
+{
+	ioList->append("{\"Serial\":\"");
+	ioList->append(inDevice->fName);
+	ioList->append("\"},");
+}
+
+class LockedMapRegistry : public Registry
+{
+public:
+
+	struct Ref
+	{
+		Ref(BenchDevice* inDevice) : fDevice(inDevice), fCount(0) {}
+		BenchDevice*    fDevice;
+		int             fCount;
+		OSCond          fCond;
+	};
+
+	virtual bool Register(const string& inKey, BenchDevice* inDevice)
+	{
+		OSMutexLocker locker(&fMutex);
+		if (fMap.find(inKey) != fMap.end())
+			return false;
+		fMap[inKey] = new Ref(inDevice);
+		return true;
+	}
+
+	virtual void UnRegister(const string& inKey)
+	{
+		OSMutexLocker locker(&fMutex);
+		map<string, Ref*>::iterator theIter = fMap.find(inKey);
+		if (theIter == fMap.end())
+			return;
+		while (theIter->second->fCount > 0)
+			theIter->second->fCond.Wait(&fMutex);
+		delete theIter->second;
+		fMap.erase(theIter);
+	}
+
+	virtual bool ResolveAndRelease(const string& inKey)
+	{
+		Ref* theRef = NULL;
+		{
+			OSMutexLocker locker(&fMutex);
+			map<string, Ref*>::iterator theIter = fMap.find(inKey);
+			if (theIter == fMap.end())
+				return false;
+			theRef = theIter->second;
+			theRef->fCount++;
+		}
+
+		volatile SInt32 theAppType = theRef->fDevice->fAppType;
+		(void)theAppType;
+
+		OSMutexLocker locker(&fMutex);
+		theRef->fCount--;
+		theRef->fCond.Signal();
+		return true;
+	}
+
+	virtual UInt32 List(SInt32 inAppType, string* ioList)
+	{
+		UInt32 theNumListed = 0;
+		OSMutexLocker locker(&fMutex);
+		for (map<string, Ref*>::iterator theIter = fMap.begin(); theIter != fMap.end(); ++theIter)
+		{
+			BenchDevice* theDevice = theIter->second->fDevice;
+			if ((inAppType >= 0) && (theDevice->fAppType != inAppType))
+				continue;
+			AppendDevice(theDevice, ioList);
+			theNumListed++;
+		}
+		return theNumListed;
+	}
+
+private:
+
+	map<string, Ref*>   fMap;
+	OSMutex             fMutex;
+};
+
+class ShardedRegistry : public Registry
+{
+public:
+
+	virtual bool Register(const string& inKey, BenchDevice* inDevice)
+	{
+		return fTable.Register(inKey, inDevice, inDevice->fAppType) == OS_NoErr;
+	}
+
+	virtual void UnRegister(const string& inKey)
+	{
+		(void)fTable.UnRegister(inKey);
+	}
+
+	virtual bool ResolveAndRelease(const string& inKey)
+	{
+		OSRefTableEx::OSRefEx* theRef = fTable.Resolve(inKey);
+		if (theRef == NULL)
+			return false;
+
+		volatile SInt32 theAppType = static_cast<BenchDevice*>(theRef->GetObjectPtr())->fAppType;
+		(void)theAppType;
+
+		fTable.Release(theRef);
+		return true;
+	}
+
+	virtual UInt32 List(SInt32 inAppType, string* ioList)
+	{
+		OSRefTableEx::Snapshot* theSnapshot = (inAppType >= 0) ? fTable.GetSnapshot(0, &inAppType, 1) : fTable.GetSnapshot();
+		OSRefSnapshotReleaserEx releaser(&fTable, theSnapshot);
+
+		for (UInt32 x = 0; x < theSnapshot->GetNumRefs(); x++)
+			AppendDevice(static_cast<BenchDevice*>(theSnapshot->GetRef(x)->GetObjectPtr()), ioList);
+		return theSnapshot->GetNumRefs();
+	}
+
+private:
+
+	OSRefTableEx    fTable;
+};
+
+static BenchDevice* sDevices = NULL;
+static string*      sKeys = NULL;
+static UInt32       sNumDevices = 0;
+static volatile bool sStop = false;
+
+class WorkerThread : public OSThread
+{
+public:
+
+	WorkerThread(Registry* inRegistry, UInt32 inWorker)
+		: fRegistry(inRegistry), fWorker(inWorker), fSeed(inWorker + 1), fNumOps(0), fWorstResolveMicros(0) {}
+	virtual ~WorkerThread() {}
+
+	virtual void Entry()
+	{
+		while (!sStop)
+		{
+			//each worker owns every kNumWorkers'th device, so check-ins never collide
+			UInt32 theDevice = (this->Random() % (sNumDevices / kNumWorkers)) * kNumWorkers + fWorker;
+			fRegistry->UnRegister(sKeys[theDevice]);
+			(void)fRegistry->Register(sKeys[theDevice], &sDevices[theDevice]);
+			fNumOps += 2;
+
+			for (UInt32 x = 0; x < kResolvesPerRegister; x++)
+			{
+				UInt32 theTarget = this->Random() % sNumDevices;
+				SInt64 theStart = OS::Microseconds();
+				(void)fRegistry->ResolveAndRelease(sKeys[theTarget]);
+				SInt64 theElapsed = OS::Microseconds() - theStart;
+				if (theElapsed > fWorstResolveMicros)
+					fWorstResolveMicros = theElapsed;
+				fNumOps++;
+			}
+		}
+	}
+
+	UInt32 Random()
+	{
+		fSeed = fSeed * 1103515245 + 12345;
+		return fSeed >> 8;
+	}
+
+	Registry*   fRegistry;
+	UInt32      fWorker;
+	UInt32      fSeed;
+	UInt64      fNumOps;
+	SInt64      fWorstResolveMicros;
+};
+
+class ListerThread : public OSThread
+{
+public:
+
+	ListerThread(Registry* inRegistry, SInt32 inAppType)
+		: fRegistry(inRegistry), fAppType(inAppType), fNumLists(0), fTotalMicros(0), fNumListed(0) {}
+	virtual ~ListerThread() {}
+
+	virtual void Entry()
+	{
+		string theList;
+		while (!sStop)
+		{
+			theList.clear();
+			SInt64 theStart = OS::Microseconds();
+			fNumListed = fRegistry->List(fAppType, &theList);
+			fTotalMicros += OS::Microseconds() - theStart;
+			fNumLists++;
+		}
+	}
+
+	Registry*   fRegistry;
+	SInt32      fAppType;
+	UInt32      fNumLists;
+	SInt64      fTotalMicros;
+	UInt32      fNumListed;
+};
+
+static void RunMode(const char* inModeName, Registry* inRegistry, SInt32 inListAppType, UInt32 inSeconds)
+{
+	for (UInt32 x = 0; x < sNumDevices; x++)
+		(void)inRegistry->Register(sKeys[x], &sDevices[x]);
+
+	sStop = false;
+	WorkerThread* theWorkers[kNumWorkers];
+	for (UInt32 x = 0; x < kNumWorkers; x++)
+	{
+		theWorkers[x] = new WorkerThread(inRegistry, x);
+		theWorkers[x]->Start();
+	}
+	ListerThread* theLister = new ListerThread(inRegistry, inListAppType);
+	theLister->Start();
+
+	OSThread::Sleep(inSeconds * 1000);
+	sStop = true;
+
+	UInt64 theNumOps = 0;
+	SInt64 theWorstMicros = 0;
+	for (UInt32 y = 0; y < kNumWorkers; y++)
+	{
+		theWorkers[y]->Join();
+		theNumOps += theWorkers[y]->fNumOps;
+		if (theWorkers[y]->fWorstResolveMicros > theWorstMicros)
+			theWorstMicros = theWorkers[y]->fWorstResolveMicros;
+		delete theWorkers[y];
+	}
+	theLister->Join();
+
+	Float64 theListMillis = (theLister->fNumLists == 0) ? 0 : (Float64)theLister->fTotalMicros / theLister->fNumLists / 1000;
+	::printf("%-18s %12.0f %12" _64BITARG_ "d %10" _U32BITARG_ " %10" _U32BITARG_ " %10.2f\n",
+		inModeName, (Float64)theNumOps / inSeconds, theWorstMicros, theLister->fNumLists, theLister->fNumListed, theListMillis);
+	delete theLister;
+
+	for (UInt32 z = 0; z < sNumDevices; z++)
+		inRegistry->UnRegister(sKeys[z]);
+}
+
+int main(int argc, char* argv[])
+{
+	sNumDevices = 50000;
+	if (argc > 1)
+		sNumDevices = ::atoi(argv[1]);
+	if (sNumDevices < kNumWorkers)
+		sNumDevices = kNumWorkers;
+
+	UInt32 theSeconds = 5;
+	if (argc > 2)
+		theSeconds = ::atoi(argv[2]);
+	if (theSeconds == 0)
+		theSeconds = 1;
+
+	OS::Initialize();
+	OSThread::Initialize();
+
+	sDevices = new BenchDevice[sNumDevices];
+	sKeys = new string[sNumDevices];
+	for (UInt32 x = 0; x < sNumDevices; x++)
+	{
+		qtss_snprintf(sDevices[x].fName, sizeof(sDevices[x].fName), "device%08" _U32BITARG_, x);
+		sDevices[x].fAppType = 1 + (x % kNumAppTypes);
+		sKeys[x] = sDevices[x].fName;
+	}
+
+	::printf("%" _U32BITARG_ " devices, %" _U32BITARG_ " worker threads, %" _U32BITARG_ " resolves per check-in, %" _U32BITARG_ " s per mode\n",
+		sNumDevices, kNumWorkers, kResolvesPerRegister, theSeconds);
+	::printf("%-18s %12s %12s %10s %10s %10s\n", "mode", "ops/s", "worst us", "lists", "listed", "ms/list");
+
+	LockedMapRegistry* theLockedMap = new LockedMapRegistry;
+	RunMode("locked map", theLockedMap, -1, theSeconds);
+	RunMode("locked map, type", theLockedMap, 1, theSeconds);
+	delete theLockedMap;
+
+	ShardedRegistry* theSharded = new ShardedRegistry;
+	RunMode("sharded", theSharded, -1, theSeconds);
+	RunMode("sharded, type", theSharded, 1, theSeconds);
+	delete theSharded;
+
+	return 0;
+}
@@ -74,6 +74,7 @@ static const PrefConversionInfo kPrefs[] =
 	/* 24 */ { "service_wan_port",						NULL,					qtssAttrDataTypeUInt16 },
 	/* 25 */ { "service_wan_ip",						NULL,                   qtssAttrDataTypeCharArray },
 	/* 26 */ { "run_num_msg_threads",					NULL,					qtssAttrDataTypeUInt32 },
+	/* 27 */ { "snap_queue_max_entries",				NULL,					qtssAttrDataTypeUInt32 },
 
 	// This element will be used if the pref is something we don't know about.
 	// Just have unknown prefs default to be server prefs with a type of char
@@ -14,12 +14,15 @@
 #include "QTSServerInterface.h"
 #include "OSArrayObjectDeleter.h"
 #include "EasyUtil.h"
+#include "EasyJsonWriter.h"
 #include "QueryParamList.h"
 #include "Format.h"
+#include "SnapWriter.h"
 
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 #include <unordered_set>
+#include <algorithm>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
@@ -73,20 +76,16 @@ HTTPSession::~HTTPSession()
 {
 	if (GetSessionType() == EasyHTTPSession)
 	{
-		OSMutex* mutexMap = QTSServerInterface::GetServer()->GetDeviceSessionMap()->GetMutex();
-		OSHashMap* deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap()->GetMap();
-		OSRefIt itRef;
-		{
-			OSMutexLocker lock(mutexMap);
-			int iDevNum = 0;
+		OSRefTableEx* deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap();
+		OSRefTableEx::Snapshot* snapshot = deviceMap->GetSnapshot();
+		OSRefSnapshotReleaserEx releaser(deviceMap, snapshot);
 
-			for (itRef = deviceMap->begin(); itRef != deviceMap->end(); ++itRef)
+		for (UInt32 i = 0; i < snapshot->GetNumRefs(); ++i)
+		{
+			HTTPSession* session = static_cast<HTTPSession*>(snapshot->GetRef(i)->GetObjectPtr());
+			if (session->GetTalkbackSession() == sessionId_)
 			{
-				HTTPSession* session = static_cast<HTTPSession*>(itRef->second->GetObjectPtr());
-				if (session->GetTalkbackSession() == sessionId_)
-				{
-					session->SetTalkbackSession("");
-				}
+				session->SetTalkbackSession("");
 			}
 		}
 	}
@@ -121,6 +120,9 @@ SInt64 HTTPSession::Run()
 	if (events & kKillEvent)
 		fLiveSession = false;
 
+	if (events & kUpdateEvent)
+		holdPostedSnapPaths();
+
 	if (events & kTimeoutEvent)
 	{
 		string msgStr = Format("Timeout HTTPSessionDevice_serial[%s]\n", device_->serial_);
@@ -338,12 +340,36 @@ QTSS_Error HTTPSession::SendHTTPPacket(const string& msg, bool connectionClose,
 			httpAck.AppendConnectionCloseHeader();
 
 		StrPtrLen* ackPtr = httpAck.GetCompleteHTTPHeader();
-		string sendString(ackPtr->Ptr, ackPtr->Len);
-		if (!msg.empty())
-			sendString.append(msg.c_str(), msg.size());
+
+		//header and body go out in one writev, only a partial send copies what is left
+		struct iovec theVec[2];
+		theVec[0].iov_base = ackPtr->Ptr;
+		theVec[0].iov_len = ackPtr->Len;
+		theVec[1].iov_base = const_cast<char*>(msg.data());
+		theVec[1].iov_len = msg.size();
 
 		UInt32 theLengthSent = 0;
-		UInt32 amtInBuffer = sendString.size();
+		QTSS_Error theErr = fOutputSocketP->WriteV(theVec, msg.empty() ? 1 : 2, &theLengthSent);
+		if (theErr != QTSS_NoErr && theErr != EAGAIN)
+			return theErr;
+
+		UInt32 amtInBuffer = ackPtr->Len + msg.size();
+		if (theLengthSent == amtInBuffer)
+			return QTSS_NoErr;
+
+		string sendString;
+		if (theLengthSent < ackPtr->Len)
+		{
+			sendString.assign(ackPtr->Ptr + theLengthSent, ackPtr->Len - theLengthSent);
+			sendString.append(msg);
+		}
+		else
+		{
+			sendString.assign(msg, theLengthSent - ackPtr->Len, string::npos);
+		}
+
+		theLengthSent = 0;
+		amtInBuffer = sendString.size();
 		do
 		{
 			QTSS_Error theErr = fOutputSocketP->Send(sendString.c_str(), amtInBuffer, &theLengthSent);
@@ -431,6 +457,11 @@ QTSS_Error HTTPSession::setupRequest()
 					return execNetMsgCSSetBaseConfigReqRESTful(fRequest->GetQueryString());
 				}
 
+				if (path[0] == "api" && path[1] == EASY_PROTOCOL_VERSION && path[2] == "getserverinfo")
+				{
+					return execNetMsgCSGetServerInfoReqRESTful(fRequest->GetQueryString());
+				}
+
 				if (path[0] == "api" && path[1] == EASY_PROTOCOL_VERSION && path[2] == "restart")
 				{
 					return execNetMsgCSRestartReqRESTful(fRequest->GetQueryString());
@@ -612,32 +643,34 @@ QTSS_Error HTTPSession::execNetMsgDSPostSnapReq(const char* json)
 		return QTSS_BadArgument;
 	}
 
-	image = EasyUtil::Base64Decode(image.data(), image.size());
+	if (!EasyUtil::Base64DecodeInPlace(image))
+	{
+		return QTSS_BadArgument;
+	}
 
 	string jpgDir = string(QTSServerInterface::GetServer()->GetPrefs()->GetSnapLocalPath()).append(device_serial);
-	OS::RecursiveMakeDir(const_cast<char*>(jpgDir.c_str()));
 	string jpgPath = Format("%s/%s_%s_%s.%s", jpgDir, device_serial, channel, strTime, EasyProtocol::GetSnapTypeString(EASY_SNAP_TYPE_JPEG));
 
 	auto picType = EasyProtocol::GetSnapType(strType);
 
+	//web path
+	string snapURL = Format("%s%s/%s_%s_%s.%s", string(QTSServerInterface::GetServer()->GetPrefs()->GetSnapWebPath()), device_serial,
+		device_serial, channel, strTime, EasyProtocol::GetSnapTypeString(EASY_SNAP_TYPE_JPEG));
+
 	if (picType == EASY_SNAP_TYPE_JPEG)
 	{
-		FILE* fSnap = ::fopen(jpgPath.c_str(), "wb");
-		if (!fSnap)
+		//written on a blocking task thread, which sets the snap URL once the file exists;
+		//a full queue drops the snapshot and keeps the last snap URL
+		if (!SnapWriter::Enqueue(device_serial + "/" + channel, jpgDir, jpgPath, image, device_serial, channel, snapURL))
 		{
 			return QTSS_NoErr;
 		}
-		fwrite(image.data(), 1, image.size(), fSnap);
-		fclose(fSnap);
 	}
 
-	//web path
-
 	device_->channels_[channel].status_ = "online";
 
-	string snapURL = Format("%s%s/%s_%s_%s.%s", string(QTSServerInterface::GetServer()->GetPrefs()->GetSnapWebPath()), device_serial,
-		device_serial, channel, strTime, EasyProtocol::GetSnapTypeString(EASY_SNAP_TYPE_JPEG));
-	device_->HoldSnapPath(snapURL, channel);
+	if (picType != EASY_SNAP_TYPE_JPEG)
+		device_->HoldSnapPath(snapURL, channel);
 
 	EasyProtocolACK rsp(MSG_SD_POST_SNAP_ACK);
 	EasyJsonValue header, body;
@@ -659,6 +692,27 @@ QTSS_Error HTTPSession::execNetMsgDSPostSnapReq(const char* json)
 	return QTSS_NoErr;
 }
 
+void HTTPSession::PostSnapPath(const string& inChannel, const string& inSnapURL)
+{
+	{
+		OSMutexLocker locker(&fSnapMutex);
+		fPostedSnapPaths[inChannel] = inSnapURL;
+	}
+	this->Signal(kUpdateEvent);
+}
+
+void HTTPSession::holdPostedSnapPaths()
+{
+	map<string, string> snapPaths;
+	{
+		OSMutexLocker locker(&fSnapMutex);
+		snapPaths.swap(fPostedSnapPaths);
+	}
+
+	for (auto it = snapPaths.begin(); it != snapPaths.end(); ++it)
+		device_->HoldSnapPath(it->second, it->first);
+}
+
 QTSS_Error HTTPSession::execNetMsgErrorReqHandler(HTTPStatusCode errCode)
 {
 	//HTTP Header
@@ -744,10 +798,8 @@ QTSS_Error HTTPSession::execNetMsgDSRegisterReq(const char* json)
 {
 	QTSS_Error theErr = QTSS_NoErr;
 
-	EasyMsgDSRegisterREQ regREQ(json);
-
-	//update info each time
-	if (!device_->GetDevInfo(json))
+	//update info each time, devices register again as their keepalive
+	if (!device_->GetDevInfo(fMessage))
 	{
 		return  QTSS_BadArgument;
 	}
@@ -755,7 +807,7 @@ QTSS_Error HTTPSession::execNetMsgDSRegisterReq(const char* json)
 	while (!fAuthenticated)
 	{
 		//1.ȡTerminalTypeAppType,߼֤򷵻400 httpBadRequest;
-		int appType = regREQ.GetAppType();
+		int appType = device_->eAppType;
 		//int terminalType = regREQ.GetTerminalType();
 		switch (appType)
 		{
@@ -779,10 +831,7 @@ QTSS_Error HTTPSession::execNetMsgDSRegisterReq(const char* json)
 		}
 
 		//2.֤SerialTokenȨ֤򷵻401 httpUnAuthorized;
-		string serial = regREQ.GetBodyValue(EASY_TAG_SERIAL);
-		string token = regREQ.GetBodyValue(EASY_TAG_TOKEN);
-
-		if (serial.empty())
+		if (device_->serial_.empty())
 		{
 			theErr = QTSS_AttrDoesntExist;
 			break;
@@ -796,7 +845,7 @@ QTSS_Error HTTPSession::execNetMsgDSRegisterReq(const char* json)
 		}*/
 
 		auto deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap();
-		auto regErr = deviceMap->Register(device_->serial_, this);
+		auto regErr = deviceMap->Register(device_->serial_, this, device_->eAppType, device_->eDeviceType);
 		if (regErr == OS_NoErr)
 		{
 			auto msgStr = Format("Device registerDevice_serial[%s]\n", device_->serial_);
@@ -824,21 +873,12 @@ QTSS_Error HTTPSession::execNetMsgDSRegisterReq(const char* json)
 
 	if (theErr != QTSS_NoErr)	return theErr;
 
-	//ߵ˵豸ɹע
-	EasyProtocol req(json);
-	EasyProtocolACK rsp(MSG_SD_REGISTER_ACK);
-	EasyJsonValue header, body;
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_CSEQ] = req.GetHeaderValue(EASY_TAG_CSEQ);
-	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
-	body[EASY_TAG_SERIAL] = device_->serial_;
+	//a registered device may report new types, keep the listing indexes in step
+	QTSServerInterface::GetServer()->GetDeviceSessionMap()->SetIndexValues(device_->serial_, device_->eAppType, device_->eDeviceType);
 
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
+	//ߵ˵豸ɹע
+	string msg;
+	EasyMsgWriter::SDRegisterACK(msg, fMessage.GetHeaderValue(EASY_TAG_CSEQ), device_->serial_);
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -851,18 +891,16 @@ QTSS_Error HTTPSession::execNetMsgCSFreeStreamReq(const char* json)//
 	if(!fAuthenticated)//ûн֤
 	return httpUnAuthorized;
 	*/
-	EasyProtocol req(json);
-
-	string strDeviceSerial = req.GetBodyValue(EASY_TAG_SERIAL);
-	string strChannel = req.GetBodyValue(EASY_TAG_CHANNEL);
-
-	if (strDeviceSerial.empty())
+	boost::string_ref serialRef = fMessage.GetBodyValue(EASY_TAG_SERIAL);
+	if (serialRef.empty())
 	{
 		return QTSS_BadArgument;
 	}
 
-	string strReserve = req.GetBodyValue(EASY_TAG_RESERVE);
-	string strProtocol = req.GetBodyValue(EASY_TAG_PROTOCOL);
+	string strDeviceSerial(serialRef.data(), serialRef.size());
+	boost::string_ref strChannel = fMessage.GetBodyValue(EASY_TAG_CHANNEL);
+	boost::string_ref strReserve = fMessage.GetBodyValue(EASY_TAG_RESERVE);
+	boost::string_ref strProtocol = fMessage.GetBodyValue(EASY_TAG_PROTOCOL);
 
 	//ΪѡĬֵ
 	if (strChannel.empty())
@@ -879,43 +917,16 @@ QTSS_Error HTTPSession::execNetMsgCSFreeStreamReq(const char* json)//
 	//ߵ˵ָ豸豸ֹͣ
 	auto pDevSession = static_cast<HTTPSession*>(theDevRef->GetObjectPtr());//õǰ豸ػ
 
-	EasyProtocolACK reqreq(MSG_SD_STREAM_STOP_REQ);
-	EasyJsonValue headerheader, bodybody;
-
-	headerheader[EASY_TAG_CSEQ] = EasyUtil::ToString(pDevSession->GetCSeq());//עطֱӽUINT32->int,Ϊʧ
-	headerheader[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-
-	bodybody[EASY_TAG_SERIAL] = strDeviceSerial;
-	bodybody[EASY_TAG_CHANNEL] = strChannel;
-	bodybody[EASY_TAG_RESERVE] = strReserve;
-	bodybody[EASY_TAG_PROTOCOL] = strProtocol;
-	bodybody[EASY_TAG_FROM] = sessionId_;
-	bodybody[EASY_TAG_TO] = pDevSession->GetValue(EasyHTTPSessionID)->GetAsCString();
-	bodybody[EASY_TAG_VIA] = QTSServerInterface::GetServer()->GetCloudServiceNodeID();
-
-	reqreq.SetHead(headerheader);
-	reqreq.SetBody(bodybody);
+	StrPtrLen* devSessionID = pDevSession->GetValue(EasyHTTPSessionID);
 
-	string buffer = reqreq.GetMsg();
+	string buffer;
+	EasyMsgWriter::SDStopStreamREQ(buffer, EasyUtil::ToString(pDevSession->GetCSeq()), strDeviceSerial, strChannel, strReserve, strProtocol,
+		sessionId_, boost::string_ref(devSessionID->Ptr, devSessionID->Len), QTSServerInterface::GetServer()->GetCloudServiceNodeID());
 	pDevSession->SendHTTPPacket(buffer, false, false);
 
-	//ֱӶԿͻˣEasyDarWin)ȷӦ
-	EasyProtocolACK rsp(MSG_SC_FREE_STREAM_ACK);
-	EasyJsonValue header, body;
-	header[EASY_TAG_CSEQ] = req.GetHeaderValue(EASY_TAG_CSEQ);
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
-	body[EASY_TAG_SERIAL] = strDeviceSerial;
-	body[EASY_TAG_CHANNEL] = strChannel;
-	body[EASY_TAG_RESERVE] = strReserve;
-	body[EASY_TAG_PROTOCOL] = strProtocol;
-
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
+	//ֱӶԿͻˣEasyDarWin)ȷӦ
+	string msg;
+	EasyMsgWriter::SCFreeStreamACK(msg, fMessage.GetHeaderValue(EASY_TAG_CSEQ), strDeviceSerial, strChannel, strReserve, strProtocol);
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -1018,27 +1029,13 @@ QTSS_Error HTTPSession::execNetMsgCSStartStreamReqRESTful(const char* queryStrin
 
 		if (!theParams.GetAssociatedDarwinParams.isOn)
 		{
-			EasyProtocolACK reqreq(MSG_SD_PUSH_STREAM_REQ);
-			EasyJsonValue headerheader, bodybody;
-
-			headerheader[EASY_TAG_CSEQ] = EasyUtil::ToString(pDevSession->GetCSeq());
-			headerheader[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-
-			bodybody[EASY_TAG_SERVER_IP] = strDssIP;
-			bodybody[EASY_TAG_SERVER_PORT] = strDssPort;
-			bodybody[EASY_TAG_SERIAL] = chSerial;
-			bodybody[EASY_TAG_CHANNEL] = chChannel;
-			bodybody[EASY_TAG_RESERVE] = chReserve;
-			bodybody[EASY_TAG_FROM] = sessionId_;
-			bodybody[EASY_TAG_TO] = pDevSession->GetValue(EasyHTTPSessionID)->GetAsCString();
-			bodybody[EASY_TAG_VIA] = QTSServerInterface::GetServer()->GetCloudServiceNodeID();
+			StrPtrLen* devSessionID = pDevSession->GetValue(EasyHTTPSessionID);
 
 			darwinHttpPort_ = strHttpPort;
 
-			reqreq.SetHead(headerheader);
-			reqreq.SetBody(bodybody);
-
-			string buffer = reqreq.GetMsg();
+			string buffer;
+			EasyMsgWriter::SDPushStreamREQ(buffer, EasyUtil::ToString(pDevSession->GetCSeq()), strDssIP, strDssPort, chSerial, chChannel, chReserve,
+				sessionId_, boost::string_ref(devSessionID->Ptr, devSessionID->Len), QTSServerInterface::GetServer()->GetCloudServiceNodeID());
 			pDevSession->SendHTTPPacket(buffer, false, false);
 
 			fTimeoutTask.SetTimeout(3 * 1000);
@@ -1053,22 +1050,9 @@ QTSS_Error HTTPSession::execNetMsgCSStartStreamReqRESTful(const char* queryStrin
 	}
 
 	//ߵ˵Կͻ˵ȷӦ,ΪӦֱӷء
-	EasyProtocolACK rsp(MSG_SC_START_STREAM_ACK);
-	EasyJsonValue header, body;
-	body[EASY_TAG_SERVICE] = service;
-	body[EASY_TAG_SERIAL] = chSerial;
-	body[EASY_TAG_CHANNEL] = chChannel;
-	body[EASY_TAG_RESERVE] = chReserve;//ǰѾ򷵻ģ򷵻ʵ
-
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_CSEQ] = EasyUtil::ToString(strCSeq);
-	header[EASY_TAG_ERROR_NUM] = errorNo;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(errorNo);
-
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
+	//ǰѾ򷵻ģ򷵻ʵ
+	string msg;
+	EasyMsgWriter::SCStartStreamACK(msg, EasyUtil::ToString(strCSeq), errorNo, service, chSerial, chChannel, chReserve);
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -1112,42 +1096,16 @@ QTSS_Error HTTPSession::execNetMsgCSStopStreamReqRESTful(const char* queryString
 	//ߵ˵ָ豸豸ֹͣ
 	HTTPSession* pDevSession = static_cast<HTTPSession*>(theDevRef->GetObjectPtr());//õǰ豸ػ
 
-	EasyProtocolACK reqreq(MSG_SD_STREAM_STOP_REQ);
-	EasyJsonValue headerheader, bodybody;
-
-	headerheader[EASY_TAG_CSEQ] = EasyUtil::ToString(pDevSession->GetCSeq());//עطֱӽUINT32->int,Ϊʧ
-	headerheader[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-
-	bodybody[EASY_TAG_SERIAL] = strDeviceSerial;
-	bodybody[EASY_TAG_CHANNEL] = strChannel;
-	bodybody[EASY_TAG_RESERVE] = strReserve;
-	bodybody[EASY_TAG_PROTOCOL] = "";
-	bodybody[EASY_TAG_FROM] = sessionId_;
-	bodybody[EASY_TAG_TO] = pDevSession->GetValue(EasyHTTPSessionID)->GetAsCString();
-	bodybody[EASY_TAG_VIA] = QTSServerInterface::GetServer()->GetCloudServiceNodeID();
-
-	reqreq.SetHead(headerheader);
-	reqreq.SetBody(bodybody);
+	StrPtrLen* devSessionID = pDevSession->GetValue(EasyHTTPSessionID);
 
-	string buffer = reqreq.GetMsg();
+	string buffer;
+	EasyMsgWriter::SDStopStreamREQ(buffer, EasyUtil::ToString(pDevSession->GetCSeq()), strDeviceSerial, strChannel, strReserve, "",
+		sessionId_, boost::string_ref(devSessionID->Ptr, devSessionID->Len), QTSServerInterface::GetServer()->GetCloudServiceNodeID());
 	pDevSession->SendHTTPPacket(buffer, false, false);
 
 	//ֱӶԿͻˣEasyDarWin)ȷӦ
-	EasyProtocolACK rsp(MSG_SC_STOP_STREAM_ACK);
-	EasyJsonValue header, body;
-	header[EASY_TAG_CSEQ] = EasyUtil::ToString(GetCSeq());
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
-	body[EASY_TAG_SERIAL] = strDeviceSerial;
-	body[EASY_TAG_CHANNEL] = strChannel;
-	body[EASY_TAG_RESERVE] = strReserve;
-
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
+	string msg;
+	EasyMsgWriter::SCStopStreamACK(msg, EasyUtil::ToString(GetCSeq()), strDeviceSerial, strChannel, strReserve);
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -1160,20 +1118,14 @@ QTSS_Error HTTPSession::execNetMsgDSPushStreamAck(const char* json) const
 		return httpUnAuthorized;
 
 	//豸ӦǲҪڽлӦģֱӽҵӦĿͻSessionֵ	
-	EasyProtocol req(json);
+	boost::string_ref strDeviceSerial = fMessage.GetBodyValue(EASY_TAG_SERIAL);//豸к
+	boost::string_ref strChannel = fMessage.GetBodyValue(EASY_TAG_CHANNEL);//ͷк
+	boost::string_ref strReserve = fMessage.GetBodyValue(EASY_TAG_RESERVE);//
+	boost::string_ref strDssIP = fMessage.GetBodyValue(EASY_TAG_SERVER_IP);//豸ʵַ
+	boost::string_ref toRef = fMessage.GetBodyValue(EASY_TAG_TO);
+	string strTo(toRef.data(), toRef.size());
 
-	string strDeviceSerial = req.GetBodyValue(EASY_TAG_SERIAL);//豸к
-	string strChannel = req.GetBodyValue(EASY_TAG_CHANNEL);//ͷк
-	string strProtocol = req.GetBodyValue(EASY_TAG_PROTOCOL);//Э,ն˽֧RTSP
-	string strReserve = req.GetBodyValue(EASY_TAG_RESERVE);//
-	string strDssIP = req.GetBodyValue(EASY_TAG_SERVER_IP);//豸ʵַ
-	string strDssPort = req.GetBodyValue(EASY_TAG_SERVER_PORT);//Ͷ˿
-	string strFrom = req.GetBodyValue(EASY_TAG_FROM);
-	string strTo = req.GetBodyValue(EASY_TAG_TO);
-	string strVia = req.GetBodyValue(EASY_TAG_VIA);
-
-	string strCSeq = req.GetHeaderValue(EASY_TAG_CSEQ);//ǹؼ
-	string strStateCode = req.GetHeaderValue(EASY_TAG_ERROR_NUM);//״̬
+	boost::string_ref strCSeq = fMessage.GetHeaderValue(EASY_TAG_CSEQ);//ǹؼ
 
 	if (strChannel.empty())
 		strChannel = "1";
@@ -1190,25 +1142,11 @@ QTSS_Error HTTPSession::execNetMsgDSPushStreamAck(const char* json) const
 
 	if (httpSession->IsLiveSession())
 	{
-		string service = string("IP=") + strDssIP + ";Port=" + httpSession->GetDarwinHTTPPort() + ";Type=EasyDarwin";
+		string service = "IP=" + strDssIP.to_string() + ";Port=" + httpSession->GetDarwinHTTPPort() + ";Type=EasyDarwin";
 
 		//ߵ˵Կͻ˵ȷӦ,ΪӦֱӷء
-		EasyProtocolACK rsp(MSG_SC_START_STREAM_ACK);
-		EasyJsonValue header, body;
-		body[EASY_TAG_SERVICE] = service;
-		body[EASY_TAG_SERIAL] = strDeviceSerial;
-		body[EASY_TAG_CHANNEL] = strChannel;
-		body[EASY_TAG_RESERVE] = strReserve;
-
-		header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-		header[EASY_TAG_CSEQ] = strCSeq;
-		header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-		header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
-		rsp.SetHead(header);
-		rsp.SetBody(body);
-
-		string msg = rsp.GetMsg();
+		string msg;
+		EasyMsgWriter::SCStartStreamACK(msg, strCSeq, EASY_ERROR_SUCCESS_OK, service, strDeviceSerial, strChannel, strReserve);
 		httpSession->SendHTTPPacket(msg, false, false);
 	}
 
@@ -1230,14 +1168,6 @@ QTSS_Error HTTPSession::execNetMsgCSGetDeviceListReqRESTful(const char* queryStr
 	const char* chAppType = parList.DoFindCGIValueForParam(EASY_TAG_APP_TYPE);//APPType
 	const char* chTerminalType = parList.DoFindCGIValueForParam(EASY_TAG_TERMINAL_TYPE);//TerminalType
 
-	EasyProtocolACK rsp(MSG_SC_DEVICE_LIST_ACK);
-	EasyJsonValue header, body;
-
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_CSEQ] = 1;
-	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
 	unordered_set<string> terminalSet;
 	if (chTerminalType != nullptr)
 	{
@@ -1250,50 +1180,61 @@ QTSS_Error HTTPSession::execNetMsgCSGetDeviceListReqRESTful(const char* queryStr
 		boost::split(terminalSet, terminalTemp, boost::is_any_of("|"), boost::token_compress_on);
 	}
 
-	OSMutex* mutexMap = QTSServerInterface::GetServer()->GetDeviceSessionMap()->GetMutex();
-	OSHashMap* deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap()->GetMap();
-	Json::Value* proot = rsp.GetRoot();
+	vector<SInt32> terminalTypes;
+	for (auto itTerminal = terminalSet.begin(); itTerminal != terminalSet.end(); ++itTerminal)
+	{
+		terminalTypes.push_back(EasyProtocol::GetTerminalType(*itTerminal));
+	}
+
+	//take the devices from the app type or terminal type index rather than walking every device
+	OSRefTableEx* deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap();
+	OSRefTableEx::Snapshot* snapshot;
+	if (chAppType != nullptr)
+	{
+		SInt32 appType = EasyProtocol::GetAppType(chAppType);
+		snapshot = deviceMap->GetSnapshot(QTSServerInterface::kDeviceAppTypeIndex, &appType, 1);
+	}
+	else if (chTerminalType != nullptr)
+	{
+		snapshot = deviceMap->GetSnapshot(QTSServerInterface::kDeviceTerminalTypeIndex, terminalTypes.data(), terminalTypes.size());
+	}
+	else
+	{
+		snapshot = deviceMap->GetSnapshot();
+	}
+	OSRefSnapshotReleaserEx releaser(deviceMap, snapshot);
+
+	//written straight into the response, a device costs its own bytes and nothing more
+	string msg;
+	msg.reserve(256 + snapshot->GetNumRefs() * 160);
+	EasyMsgWriter rsp(msg, MSG_SC_DEVICE_LIST_ACK, "1", EASY_ERROR_SUCCESS_OK);
+	rsp.StartBody();
+	rsp.StartArray(EASY_TAG_DEVICES);
 
 	{
-		OSMutexLocker lock(mutexMap);
 		int iDevNum = 0;
 
-		for (auto itRef = deviceMap->begin(); itRef != deviceMap->end(); ++itRef)
+		for (UInt32 i = 0; i < snapshot->GetNumRefs(); ++i)
 		{
-			auto deviceInfo = static_cast<HTTPSession*>(itRef->second->GetObjectPtr())->GetDeviceInfo();
-			if (chAppType != nullptr)// AppType fileter
-			{
-				if (EasyProtocol::GetAppTypeString(deviceInfo->eAppType) != string(chAppType))
-					continue;
-			}
-			if (chTerminalType != nullptr)// TerminateType fileter
+			OSRefTableEx::OSRefEx* theDevRef = snapshot->GetRef(i);
+			if (chAppType != nullptr && chTerminalType != nullptr)// TerminateType fileter
 			{
-				if (terminalSet.find(EasyProtocol::GetTerminalTypeString(deviceInfo->eDeviceType)) == terminalSet.end())
+				SInt32 terminalType = theDevRef->GetIndexValue(QTSServerInterface::kDeviceTerminalTypeIndex);
+				if (find(terminalTypes.begin(), terminalTypes.end(), terminalType) == terminalTypes.end())
 					continue;
 			}
 
+			auto deviceInfo = static_cast<HTTPSession*>(theDevRef->GetObjectPtr())->GetDeviceInfo();
+
 			iDevNum++;
 
-			Json::Value value;
-			value[EASY_TAG_SERIAL] = deviceInfo->serial_;//ط˱,deviceMapݣdeviceInfoݶǿ
-			value[EASY_TAG_NAME] = deviceInfo->name_;
-			value[EASY_TAG_TAG] = deviceInfo->tag_;
-			value[EASY_TAG_APP_TYPE] = EasyProtocol::GetAppTypeString(deviceInfo->eAppType);
-			value[EASY_TAG_TERMINAL_TYPE] = EasyProtocol::GetTerminalTypeString(deviceInfo->eDeviceType);
-			//豸EasyCamera,򷵻豸Ϣ
-			if (deviceInfo->eAppType == EASY_APP_TYPE_CAMERA)
-			{
-				value[EASY_TAG_SNAP_URL] = deviceInfo->snapJpgPath_;
-			}
-			(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_DEVICES].append(value);
+			rsp.Device(*deviceInfo);
 		}
-		body[EASY_TAG_DEVICE_COUNT] = iDevNum;
+		rsp.EndArray();
+		rsp.IntString(EASY_TAG_DEVICE_COUNT, iDevNum);
 	}
+	rsp.Finish();
 
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -1305,46 +1246,23 @@ QTSS_Error HTTPSession::execNetMsgCSDeviceListReq(const char* json)//
 	if(!fAuthenticated)//ûн֤
 	return httpUnAuthorized;
 	*/
-	EasyProtocol req(json);
-
-	EasyProtocolACK rsp(MSG_SC_DEVICE_LIST_ACK);
-	EasyJsonValue header, body;
-
-	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-	header[EASY_TAG_CSEQ] = req.GetHeaderValue(EASY_TAG_CSEQ);
-	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
-	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
-
 	OSRefTableEx* deviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap();
-	OSMutex* mutexMap = deviceMap->GetMutex();
-	OSHashMap* deviceHashMap = deviceMap->GetMap();
-	Json::Value* proot = rsp.GetRoot();
+	OSRefTableEx::Snapshot* snapshot = deviceMap->GetSnapshot();
+	OSRefSnapshotReleaserEx releaser(deviceMap, snapshot);
 
+	string msg;
+	msg.reserve(256 + snapshot->GetNumRefs() * 160);
+	EasyMsgWriter rsp(msg, MSG_SC_DEVICE_LIST_ACK, fMessage.GetHeaderValue(EASY_TAG_CSEQ), EASY_ERROR_SUCCESS_OK);
+	rsp.StartBody();
+	rsp.IntString(EASY_TAG_DEVICE_COUNT, snapshot->GetNumRefs());
+	rsp.StartArray(EASY_TAG_DEVICES);
+	for (UInt32 i = 0; i < snapshot->GetNumRefs(); ++i)
 	{
-		OSMutexLocker lock(mutexMap);
-		body[EASY_TAG_DEVICE_COUNT] = deviceMap->GetEleNumInMap();
-		for (auto itRef = deviceHashMap->begin(); itRef != deviceHashMap->end(); ++itRef)
-		{
-			Json::Value value;
-			auto deviceInfo = static_cast<HTTPSession*>(itRef->second->GetObjectPtr())->GetDeviceInfo();
-			value[EASY_TAG_SERIAL] = deviceInfo->serial_;
-			value[EASY_TAG_NAME] = deviceInfo->name_;
-			value[EASY_TAG_TAG] = deviceInfo->tag_;
-			value[EASY_TAG_APP_TYPE] = EasyProtocol::GetAppTypeString(deviceInfo->eAppType);
-			value[EASY_TAG_TERMINAL_TYPE] = EasyProtocol::GetTerminalTypeString(deviceInfo->eDeviceType);
-			//豸EasyCamera,򷵻豸Ϣ
-			if (deviceInfo->eAppType == EASY_APP_TYPE_CAMERA)
-			{
-				value[EASY_TAG_SNAP_URL] = deviceInfo->snapJpgPath_;
-			}
-			(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_DEVICES].append(value);
-		}
+		rsp.Device(*static_cast<HTTPSession*>(snapshot->GetRef(i)->GetObjectPtr())->GetDeviceInfo());
 	}
+	rsp.EndArray();
+	rsp.Finish();
 
-	rsp.SetHead(header);
-	rsp.SetBody(body);
-
-	string msg = rsp.GetMsg();
 	this->SendHTTPPacket(msg, false, false);
 
 	return QTSS_NoErr;
@@ -1489,8 +1407,9 @@ QTSS_Error HTTPSession::processRequest()//
 
 	//Ϣ
 	QTSS_Error theErr;
-	EasyProtocol protocol(fRequestBody);
-	int nNetMsg = protocol.GetMessageType(), nRspMsg = MSG_SC_EXCEPTION;
+	//parsed once here, the handlers read their fields from fMessage
+	fMessage.Parse(fRequestBody, ::strlen(fRequestBody));
+	int nNetMsg = fMessage.GetMessageType(), nRspMsg = MSG_SC_EXCEPTION;
 
 	switch (nNetMsg)
 	{
@@ -1546,11 +1465,10 @@ QTSS_Error HTTPSession::processRequest()//
 	//ԶһҪQTSS_NoErr
 	if (theErr != QTSS_NoErr)//ȷӦǵȴضQTSS_NoErrִ󣬶ԴͳһӦ
 	{
-		EasyProtocol req(fRequestBody);
 		EasyProtocolACK rsp(nRspMsg);
 		EasyJsonValue header;
 		header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
-		header[EASY_TAG_CSEQ] = req.GetHeaderValue(EASY_TAG_CSEQ);
+		header[EASY_TAG_CSEQ] = fMessage.GetHeaderValue(EASY_TAG_CSEQ).to_string();
 
 		switch (theErr)
 		{
@@ -2062,6 +1980,40 @@ QTSS_Error HTTPSession::execNetMsgCSGetBaseConfigReqRESTful(const char* queryStr
 	return QTSS_NoErr;
 }
 
+QTSS_Error HTTPSession::execNetMsgCSGetServerInfoReqRESTful(const char* queryString)
+{
+	EasyProtocolACK rsp(MSG_SC_SERVER_INFO_ACK);
+	EasyJsonValue header, body;
+
+	header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
+	header[EASY_TAG_CSEQ] = 1;
+	header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
+	header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
+
+	body[EASY_TAG_DEVICE_COUNT] = QTSServerInterface::GetServer()->GetDeviceSessionMap()->GetEleNumInMap();
+
+	SnapWriter::Stats snapStats;
+	SnapWriter::GetStats(&snapStats);
+
+	body[EASY_TAG_SNAP_QUEUE_DEPTH] = static_cast<int>(snapStats.fQueueDepth);
+	body[EASY_TAG_SNAP_QUEUE_MAX_DEPTH] = static_cast<int>(snapStats.fMaxQueueDepth);
+	body[EASY_TAG_SNAP_WRITTEN] = Format("%" _64BITARG_ "u", snapStats.fNumWritten);
+	body[EASY_TAG_SNAP_FAILED] = Format("%" _64BITARG_ "u", snapStats.fNumFailed);
+	body[EASY_TAG_SNAP_SUPERSEDED] = Format("%" _64BITARG_ "u", snapStats.fNumSuperseded);
+	body[EASY_TAG_SNAP_DROPPED] = Format("%" _64BITARG_ "u", snapStats.fNumDropped);
+	body[EASY_TAG_SNAP_AVG_WRITE_MSEC] = snapStats.fAvgWriteMicros / 1000.0f;
+	body[EASY_TAG_SNAP_MAX_WRITE_MSEC] = snapStats.fMaxWriteMicros / 1000.0f;
+	body[EASY_TAG_SNAP_AVG_DELAY_MSEC] = snapStats.fAvgDelayMicros / 1000.0f;
+
+	rsp.SetHead(header);
+	rsp.SetBody(body);
+
+	string msg = rsp.GetMsg();
+	this->SendHTTPPacket(msg, false, false);
+
+	return QTSS_NoErr;
+}
+
 QTSS_Error HTTPSession::execNetMsgCSSetBaseConfigReqRESTful(const char* queryString)
 {
 	//if (!fAuthenticated)//ûн֤
@@ -2224,6 +2176,16 @@ QTSS_Error HTTPSession::execNetMsgCSGetUsagesReqRESTful(const char* queryString)
 		(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_API].append(value);
 	}
 
+	{
+		Json::Value value;
+		value[EASY_TAG_HTTP_METHOD] = EASY_TAG_HTTP_GET;
+		value[EASY_TAG_ACTION] = "GetServerInfo";
+		value[EASY_TAG_PARAMETER] = "";
+		value[EASY_TAG_EXAMPLE] = "http://ip:port/api/v1/getserverinfo";
+		value[EASY_TAG_DESCRIPTION] = "device count and snapshot write queue";
+		(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_API].append(value);
+	}
+
 	{
 		Json::Value value;
 		value[EASY_TAG_HTTP_METHOD] = EASY_TAG_HTTP_POST;
@@ -15,6 +15,8 @@
 #include "QTSSModule.h"
 #include "OSQueue.h"
 
+#include <map>
+
 using namespace std;
 
 class HTTPSession : public HTTPSessionInterface
@@ -30,9 +32,15 @@ public:
 
 	string GetDarwinHTTPPort() const { return darwinHttpPort_; }
 
+	// Called by SnapWriter once a snapshot of this device is on disk. The URL is
+	// handed to the session's own thread, which alone touches device_.
+	void PostSnapPath(const string& inChannel, const string& inSnapURL);
+
 private:
 	SInt64 Run() override;
 
+	void holdPostedSnapPaths();
+
 	// Does request prep & request cleanup, respectively
 	QTSS_Error setupRequest();
 	void cleanupRequest();
@@ -63,6 +71,7 @@ private:
 
 	QTSS_Error execNetMsgCSGetBaseConfigReqRESTful(const char* queryString);
 	QTSS_Error execNetMsgCSSetBaseConfigReqRESTful(const char* queryString);
+	QTSS_Error execNetMsgCSGetServerInfoReqRESTful(const char* queryString);
 
 	static QTSS_Error execNetMsgCSRestartReqRESTful(const char* queryString);
 
@@ -102,6 +111,12 @@ private:
 
 	string darwinHttpPort_;
 
+	// The request body, parsed once by processRequest for the handlers that read it
+	EasyJsonReader fMessage;
+
+	OSMutex fSnapMutex;
+	map<string, string> fPostedSnapPaths;//channel -> snap URL written since the last Run
+
 };
 
 #endif // __HTTP_SESSION_H__
@@ -59,6 +59,7 @@
 #include "HTTPSessionInterface.h"
 #include "HTTPSession.h"
 #include "QTSSFile.h"
+#include "SnapWriter.h"
 
 //Compile time modules
 #include "QTSSErrorLogModule.h"
@@ -245,6 +246,9 @@ void QTSServer::InitModules(QTSS_ServerState inEndState)
 
 void QTSServer::StartTasks()
 {
+	// Posted snapshots are written to disk on the blocking task threads
+	SnapWriter::Initialize(fSrvrPrefs->GetNumBlockingThreads(), fSrvrPrefs->GetSnapQueueMaxEntries());
+
 	// Start listening
 	for (UInt32 x = 0; x < fNumListeners; x++)
 		fListeners[x]->RequestEvent(EV_RE);
@@ -932,6 +936,7 @@ QTSS_Error QTSServer::RereadPrefsService(QTSS_ServiceFunctionArgsPtr /*inArgs*/)
 	// Reread preferences
 	sPrefsSource->Parse();
 	thePrefs->RereadServerPreferences(true);
+	SnapWriter::SetMaxEntries(thePrefs->GetSnapQueueMaxEntries());
 
 	{
 		//
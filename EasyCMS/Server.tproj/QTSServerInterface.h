@@ -131,6 +131,13 @@ public:
 
     static QTSServerInterface*  GetServer() { return sServer; }
 
+    // fDeviceMap entries are indexed by the device's app type and terminal type
+    enum
+    {
+        kDeviceAppTypeIndex = 0,
+        kDeviceTerminalTypeIndex = 1
+    };
+
     OSRefTableEx*		GetDeviceSessionMap() { return &fDeviceMap; }
     OSRefTableEx*		GetHTTPSessionMap() { return &fSessionMap; };
 
@@ -77,7 +77,8 @@ QTSServerPrefs::PrefInfo QTSServerPrefs::sPrefInfo[] =
 	{ kDontAllowMultipleValues, "10000",    nullptr                     }, //23 service_lan_port
 	{ kDontAllowMultipleValues, "10000",    nullptr                     }, //24 service_wan_port
 	{ kDontAllowMultipleValues, "0.0.0.0",  nullptr                     }, //25 service_wan_ip
-	{ kDontAllowMultipleValues, "2",        nullptr                     }  //26 run_num_msg_threads
+	{ kDontAllowMultipleValues, "2",        nullptr                     }, //26 run_num_msg_threads
+	{ kDontAllowMultipleValues, "1024",     nullptr                     }  //27 snap_queue_max_entries
 };
 
 QTSSAttrInfoDict::AttrInfo  QTSServerPrefs::sAttributes[] =
@@ -108,7 +109,8 @@ QTSSAttrInfoDict::AttrInfo  QTSServerPrefs::sAttributes[] =
 	/* 23 */ { "service_lan_port",						nullptr,					qtssAttrDataTypeUInt16,     qtssAttrModeRead | qtssAttrModeWrite },
 	/* 24 */ { "service_wan_port",						nullptr,					qtssAttrDataTypeUInt16,     qtssAttrModeRead | qtssAttrModeWrite },
 	/* 25 */ { "service_wan_ip",						nullptr,                   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModeWrite },
-	/* 26 */ { "run_num_msg_threads",					nullptr,					qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite }
+	/* 26 */ { "run_num_msg_threads",					nullptr,					qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 27 */ { "snap_queue_max_entries",				nullptr,					qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite }
 };
 
 QTSServerPrefs::QTSServerPrefs(XMLPrefsParser* inPrefsSource, bool inWriteMissingPrefs)
@@ -126,6 +128,7 @@ QTSServerPrefs::QTSServerPrefs(XMLPrefsParser* inPrefsSource, bool inWriteMissin
 	fEnableMSGDebugPrintfs(false),
 	fNumThreads(0),
 	fNumMsgThreads(0),
+	fSnapQueueMaxEntries(0),
 	fEnableMonitorStatsFile(false),
 	fStatsFileIntervalSeconds(10),
 	fCloseLogsOnWrite(false),
@@ -178,6 +181,7 @@ void QTSServerPrefs::setupAttributes()
 	this->SetVal(qtssPrefsServiceWANIPAddr, &fMonitorWANAddr, sizeof(fMonitorWANAddr));
 
 	this->SetVal(qtssPrefsNumMsgThreads, &fNumMsgThreads, sizeof(fNumMsgThreads));
+	this->SetVal(qtssPrefsSnapQueueMaxEntries, &fSnapQueueMaxEntries, sizeof(fSnapQueueMaxEntries));
 }
 
 
@@ -116,6 +116,7 @@ public:
 
 	UInt32  GetNumThreads() { return fNumThreads; }
 	UInt32  GetNumBlockingThreads() { return fNumMsgThreads; }
+	UInt32  GetSnapQueueMaxEntries() { return fSnapQueueMaxEntries; }
 
 	UInt16  GetServiceLANPort() { return fMonitorLANPort; }
 	UInt16  GetServiceWANPort() { return fMonitorWANPort; }
@@ -149,6 +150,7 @@ private:
 
 	UInt32  fNumThreads;
 	UInt32  fNumMsgThreads;
+	UInt32  fSnapQueueMaxEntries;
 
 	bool  fEnableMonitorStatsFile;
 	UInt32  fStatsFileIntervalSeconds;
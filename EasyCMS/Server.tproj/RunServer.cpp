@@ -94,9 +94,7 @@ QTSS_ServerState StartServer(XMLPrefsParser* inPrefsSource, PrefsSource* inMessa
 	#endif
 	*/
 #if !MACOSXEVENTQUEUE
-#ifndef __Win32__    
-	::epollInit();
-#else
+#ifdef __Win32__    
 	::select_startevents();//initialize the select() implementation of the event queue        
 #endif
 
@@ -0,0 +1,196 @@
+/*
+Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+Github: https://github.com/EasyDarwin
+WEChat: EasyDarwin
+Website: http://www.easydarwin.org
+*/
+/*
+	File:       SnapWriter.cpp
+
+	Contains:   Implementation of SnapWriter
+*/
+
+#include "SnapWriter.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "OS.h"
+#include "atomic.h"
+#include "QTSServerInterface.h"
+#include "HTTPSession.h"
+
+static const SInt64 kAverageWeight = 8;    // moving averages follow the last ~8 writes
+
+OSMutex                     SnapWriter::sMutex;
+std::deque<SnapWriter::Job*> SnapWriter::sQueue;
+std::map<string, SnapWriter::Job*> SnapWriter::sPending;
+UInt32                      SnapWriter::sMaxEntries = 0;
+
+SnapWriter**                SnapWriter::sWriters = NULL;
+UInt32                      SnapWriter::sNumWriters = 0;
+unsigned int                SnapWriter::sNextWriter = 0;
+
+SnapWriter::Stats           SnapWriter::sStats;
+
+SnapWriter::SnapWriter()
+{
+	this->SetTaskName("SnapWriter");
+	this->SetThreadPicker(Task::GetBlockingTaskThreadPicker());
+}
+
+void SnapWriter::Initialize(UInt32 inNumWriters, UInt32 inMaxEntries)
+{
+	Assert(sWriters == NULL);
+	if (inNumWriters == 0)
+		inNumWriters = 1;
+
+	::memset(&sStats, 0, sizeof(sStats));
+	SetMaxEntries(inMaxEntries);
+
+	sWriters = new SnapWriter*[inNumWriters];
+	for (UInt32 x = 0; x < inNumWriters; x++)
+		sWriters[x] = new SnapWriter();
+	sNumWriters = inNumWriters;
+}
+
+void SnapWriter::SetMaxEntries(UInt32 inMaxEntries)
+{
+	OSMutexLocker locker(&sMutex);
+	sMaxEntries = (inMaxEntries == 0) ? 1 : inMaxEntries;
+}
+
+bool SnapWriter::Enqueue(const string& inChannelKey, const string& inDir, const string& inPath, string& ioImage,
+	const string& inSerial, const string& inChannel, const string& inSnapURL)
+{
+	if (sNumWriters == 0)
+		return false;
+
+	{
+		OSMutexLocker locker(&sMutex);
+
+		std::map<string, Job*>::iterator theIter = sPending.find(inChannelKey);
+		if (theIter != sPending.end())
+		{
+			// The older snapshot has not reached the disk yet, write this one in its place
+			Job* theJob = theIter->second;
+			theJob->fDir = inDir;
+			theJob->fPath = inPath;
+			theJob->fImage.swap(ioImage);
+			theJob->fEnqueueTime = OS::Microseconds();
+			theJob->fSerial = inSerial;
+			theJob->fChannel = inChannel;
+			theJob->fSnapURL = inSnapURL;
+			ioImage.clear();
+			sStats.fNumSuperseded++;
+			return true;
+		}
+
+		if (sQueue.size() >= sMaxEntries)
+		{
+			sStats.fNumDropped++;
+			return false;
+		}
+
+		Job* theJob = new Job;
+		theJob->fChannelKey = inChannelKey;
+		theJob->fDir = inDir;
+		theJob->fPath = inPath;
+		theJob->fImage.swap(ioImage);
+		theJob->fEnqueueTime = OS::Microseconds();
+		theJob->fSerial = inSerial;
+		theJob->fChannel = inChannel;
+		theJob->fSnapURL = inSnapURL;
+
+		sQueue.push_back(theJob);
+		sPending[inChannelKey] = theJob;
+
+		sStats.fQueueDepth = sQueue.size();
+		if (sStats.fQueueDepth > sStats.fMaxQueueDepth)
+			sStats.fMaxQueueDepth = sStats.fQueueDepth;
+	}
+
+	// Writers drain the whole queue once woken, so waking them in turn spreads
+	// a burst over all the blocking threads
+	UInt32 theWriter = atomic_add(&sNextWriter, 1) % sNumWriters;
+	sWriters[theWriter]->Signal(Task::kStartEvent);
+	return true;
+}
+
+void SnapWriter::GetStats(Stats* outStats)
+{
+	OSMutexLocker locker(&sMutex);
+	*outStats = sStats;
+}
+
+SnapWriter::Job* SnapWriter::PopJob()
+{
+	OSMutexLocker locker(&sMutex);
+	if (sQueue.empty())
+		return NULL;
+
+	Job* theJob = sQueue.front();
+	sQueue.pop_front();
+	sPending.erase(theJob->fChannelKey);
+	sStats.fQueueDepth = sQueue.size();
+	return theJob;
+}
+
+void SnapWriter::WriteJob(Job* inJob)
+{
+	SInt64 theStart = OS::Microseconds();
+
+	bool theWritten = false;
+	OS::RecursiveMakeDir(const_cast<char*>(inJob->fDir.c_str()));
+	FILE* theFile = ::fopen(inJob->fPath.c_str(), "wb");
+	if (theFile != NULL)
+	{
+		theWritten = (::fwrite(inJob->fImage.data(), 1, inJob->fImage.size(), theFile) == inJob->fImage.size());
+		if (::fclose(theFile) != 0)
+			theWritten = false;
+	}
+
+	SInt64 theEnd = OS::Microseconds();
+	SInt64 theWriteMicros = theEnd - theStart;
+	SInt64 theDelayMicros = theEnd - inJob->fEnqueueTime;
+
+	// Only now does the file behind the URL exist. The device's channels belong to
+	// its session's thread, so the URL goes to the session rather than the device.
+	if (theWritten)
+	{
+		OSRefTableEx* theDeviceMap = QTSServerInterface::GetServer()->GetDeviceSessionMap();
+		OSRefTableEx::OSRefEx* theDevRef = theDeviceMap->Resolve(inJob->fSerial);
+		if (theDevRef != NULL)
+		{
+			OSRefReleaserEx releaser(theDeviceMap, inJob->fSerial);
+			static_cast<HTTPSession*>(theDevRef->GetObjectPtr())->PostSnapPath(inJob->fChannel, inJob->fSnapURL);
+		}
+	}
+
+	OSMutexLocker locker(&sMutex);
+	if (!theWritten)
+	{
+		sStats.fNumFailed++;
+		return;
+	}
+
+	sStats.fNumWritten++;
+	if (theWriteMicros > sStats.fMaxWriteMicros)
+		sStats.fMaxWriteMicros = (UInt32)theWriteMicros;
+	sStats.fAvgWriteMicros = (UInt32)(sStats.fAvgWriteMicros + (theWriteMicros - (SInt64)sStats.fAvgWriteMicros) / kAverageWeight);
+	sStats.fAvgDelayMicros = (UInt32)(sStats.fAvgDelayMicros + (theDelayMicros - (SInt64)sStats.fAvgDelayMicros) / kAverageWeight);
+}
+
+SInt64 SnapWriter::Run()
+{
+	(void)this->GetEvents();
+
+	Job* theJob = NULL;
+	while ((theJob = PopJob()) != NULL)
+	{
+		WriteJob(theJob);
+		delete theJob;
+	}
+
+	return 0;
+}
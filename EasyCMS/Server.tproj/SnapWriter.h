@@ -0,0 +1,101 @@
+/*
+Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+Github: https://github.com/EasyDarwin
+WEChat: EasyDarwin
+Website: http://www.easydarwin.org
+*/
+/*
+	File:       SnapWriter.h
+
+	Contains:   Writes posted device snapshots to disk on the blocking task
+				threads, so an HTTPSession never waits on fopen/fwrite.
+
+				The queue is bounded by snap_queue_max_entries. It holds at most
+				one snapshot per device channel: a newer snapshot for a channel
+				that is still queued takes the older one's place, since only the
+				latest picture of a channel is ever shown. A snapshot for a new
+				channel that finds the queue full is dropped.
+
+				A channel's snap URL is advertised only once its file has been
+				written, so a failed, superseded or dropped snapshot leaves the
+				previous URL in place.
+*/
+
+#ifndef __SNAP_WRITER_H__
+#define __SNAP_WRITER_H__
+
+#include <deque>
+#include <map>
+#include <string>
+
+#include "Task.h"
+#include "OSMutex.h"
+
+using std::string;
+
+class SnapWriter : public Task
+{
+public:
+
+	// Starts inNumWriters writer tasks, call once the task threads exist
+	static void Initialize(UInt32 inNumWriters, UInt32 inMaxEntries);
+	static void SetMaxEntries(UInt32 inMaxEntries);
+
+	// Queues ioImage to be written to inPath, creating inDir first. ioImage is
+	// swapped into the queue and left empty. inChannelKey names the device
+	// channel. Once the file is written inSnapURL is posted as inChannel's snap
+	// URL to the session of device inSerial, if it is still connected. Returns
+	// false, leaving ioImage alone, if the snapshot was dropped.
+	static bool Enqueue(const string& inChannelKey, const string& inDir, const string& inPath, string& ioImage,
+		const string& inSerial, const string& inChannel, const string& inSnapURL);
+
+	struct Stats
+	{
+		UInt32  fQueueDepth;
+		UInt32  fMaxQueueDepth;     // since startup
+		UInt64  fNumWritten;
+		UInt64  fNumFailed;         // could not be opened or fully written
+		UInt64  fNumSuperseded;     // replaced by a newer snapshot of the same channel
+		UInt64  fNumDropped;        // queue was full
+		UInt32  fAvgWriteMicros;    // moving average of the time spent writing one file
+		UInt32  fMaxWriteMicros;    // since startup
+		UInt32  fAvgDelayMicros;    // moving average from Enqueue to the file being closed
+	};
+	static void GetStats(Stats* outStats);
+
+	virtual SInt64 Run();
+
+private:
+
+	struct Job
+	{
+		string  fChannelKey;
+		string  fDir;
+		string  fPath;
+		string  fImage;
+		SInt64  fEnqueueTime;
+
+		string  fSerial;
+		string  fChannel;
+		string  fSnapURL;
+	};
+
+	SnapWriter();
+	virtual ~SnapWriter() {}
+
+	static Job* PopJob();
+	static void WriteJob(Job* inJob);
+
+	static OSMutex              sMutex;
+	static std::deque<Job*>     sQueue;
+	static std::map<string, Job*> sPending;   // channel key -> its job in sQueue
+	static UInt32               sMaxEntries;
+
+	static SnapWriter**         sWriters;
+	static UInt32               sNumWriters;
+	static unsigned int         sNextWriter;
+
+	static Stats                sStats;
+};
+
+#endif //__SNAP_WRITER_H__
@@ -65,6 +65,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/Server.tproj/QTSServerInterface.o \
 	${OBJECTDIR}/Server.tproj/QTSServerPrefs.o \
 	${OBJECTDIR}/Server.tproj/RunServer.o \
+	${OBJECTDIR}/Server.tproj/SnapWriter.o \
 	${OBJECTDIR}/Server.tproj/main.o
 
 
@@ -242,6 +243,11 @@ ${OBJECTDIR}/Server.tproj/RunServer.o: Server.tproj/RunServer.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -g -IAPICommonCode -IAPIStubLib -IPrefsSourceLib -IServer.tproj -I../CommonUtilitiesLib -I../HTTPUtilitiesLib -I../Include -I. -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyAuthModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../Include/FFmpeg/linux -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Server.tproj/RunServer.o Server.tproj/RunServer.cpp
 
+${OBJECTDIR}/Server.tproj/SnapWriter.o: Server.tproj/SnapWriter.cpp 
+	${MKDIR} -p ${OBJECTDIR}/Server.tproj
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -IAPICommonCode -IAPIStubLib -IPrefsSourceLib -IServer.tproj -I../CommonUtilitiesLib -I../HTTPUtilitiesLib -I../Include -I. -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyAuthModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../Include/FFmpeg/linux -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/Server.tproj/SnapWriter.o Server.tproj/SnapWriter.cpp
+
 ${OBJECTDIR}/Server.tproj/main.o: Server.tproj/main.cpp 
 	${MKDIR} -p ${OBJECTDIR}/Server.tproj
 	${RM} "$@.d"
@@ -37,6 +37,7 @@
 #include "StringParser.h"
 #include "QTSSModuleUtils.h"
 #include "QTAccessFile.h"
+#include "QTAccessFileCache.h"
 #include "OSArrayObjectDeleter.h"
 
 #ifdef __MacOSX__
@@ -88,6 +89,8 @@ UInt8 QTAccessFile::sWhitespaceAndGreaterThanMask[] =
 char*       QTAccessFile::sQTAccessFileName = "qtaccess";
 bool      QTAccessFile::sAllocatedName = false;
 OSMutex*    QTAccessFile::sAccessFileMutex = NULL;//QTAccessFile isn't reentrant
+QTAccessRules* QTAccessFile::sValidUserRules = NULL;
+QTAccessRules* QTAccessFile::sAnyUserRules = NULL;
 const int kBuffLen = 512;
 
 void QTAccessFile::Initialize() // called by server at initialize never call again
@@ -95,6 +98,15 @@ void QTAccessFile::Initialize() // called by server at initialize never call aga
     if (NULL == sAccessFileMutex)
     {   sAccessFileMutex = new OSMutex();
     }
+    
+    if (NULL == sValidUserRules)
+    {   StrPtrLen validUser(sAccessValidUser);
+        StrPtrLen anyUser(sAccessAnyUser);
+        sValidUserRules = new QTAccessRules(&validUser, NULL);
+        sAnyUserRules = new QTAccessRules(&anyUser, NULL);
+    }
+    
+    QTAccessFileCache::Initialize();
 }
 
 void QTAccessFile::SetAccessFileName(const char *inQTAccessFileName)
@@ -113,6 +125,7 @@ void QTAccessFile::SetAccessFileName(const char *inQTAccessFileName)
     sQTAccessFileName = new char[strlen(inQTAccessFileName)+1];
     ::strcpy(sQTAccessFileName, inQTAccessFileName);
     
+    QTAccessFileCache::SetAccessFileName(inQTAccessFileName);
 }
 
 
@@ -191,13 +204,22 @@ bool QTAccessFile::AccessAllowed  (   char *userName, char**groupArray, UInt32 n
     if (NULL == accessFileBufPtr || NULL == accessFileBufPtr->Ptr || 0 == accessFileBufPtr->Len)
         return true; // nothing to check
         
+    QTAccessRules* theRules = new QTAccessRules(accessFileBufPtr, NULL);
+    QTAccessRulesReleaser theRulesReleaser(theRules);
+    
+    return this->AccessAllowed(userName, groupArray, numGroups, theRules, inFlags, ioRealmNameStr, outAllowAnyUserPtr, extraDataPtr);
+}
+
+bool QTAccessFile::AccessAllowed  (   char *userName, char**groupArray, UInt32 numGroups, QTAccessRules* inRules,
+                                        QTSS_ActionFlags inFlags,StrPtrLen* ioRealmNameStr, bool *outAllowAnyUserPtr, void *extraDataPtr
+                                    )
+{       
+    if (NULL == inRules || inRules->IsEmpty())
+        return true; // nothing to check
+        
     if (ioRealmNameStr != NULL && ioRealmNameStr->Ptr != NULL && ioRealmNameStr->Len > 0)
         ioRealmNameStr->Ptr[0] = 0;
         
-    StringParser            accessFileParser(accessFileBufPtr);
-    QTSS_ActionFlags        currentFlags = qtssActionFlagsRead; 
-    StrPtrLen               line;
-    StrPtrLen               word;
     bool                  haveUserName = false;
     bool                  haveRealmResultBuffer = false;
     bool                  haveGroups = false;
@@ -209,173 +231,130 @@ bool QTAccessFile::AccessAllowed  (   char *userName, char**groupArray, UInt32 n
     haveGroups = HaveGroups(groupArray, numGroups, extraDataPtr);
 
     haveRealmResultBuffer =  HaveRealm(userName, ioRealmNameStr, extraDataPtr );
-  
-    while( accessFileParser.GetDataRemaining() != 0 ) 
+    
+    // Without extra data the answer only depends on the rules, the action, the user and the groups
+    char keyBuff[QTAccessRules::kMaxResultKeyLen];
+    StrPtrLen resultKey(keyBuff, 0);
+    bool cacheResult = (NULL == extraDataPtr) && this->CacheAccessResults()
+                        && MakeResultKey(&resultKey, sizeof(keyBuff), userName, groupArray, numGroups, inFlags);
+    
+    bool allowed = false;
+    SInt32 realmRule = -1;
+    if (cacheResult && inRules->FindResult(&resultKey, &allowed, outAllowAnyUserPtr, &realmRule))
     {
-        accessFileParser.GetThruEOL(&line);  // Read each line  
-        StringParser lineParser(&line);
-        lineParser.ConsumeWhitespace();//skip over leading whitespace
-        if (lineParser.GetDataRemaining() == 0) // must be an empty line
-            continue;
-
-        char firstChar = lineParser.PeekFast();
-        if ( (firstChar == '#') || (firstChar == '\0') )
-            continue; //skip over comments and blank lines...
-        
-        lineParser.ConsumeUntilWhitespace(&word);
-        if ( word.Equal("<Limit") ) // a limit line
-        {
-            currentFlags = qtssActionFlagsNoFlags; // clear to no access
-            lineParser.ConsumeWhitespace();
-            lineParser.ConsumeUntil( &word, sWhitespaceAndGreaterThanMask); // the flag <limit Read> or <limit Read >
-            while (word.Len != 0) // compare each word in the line
-            {   
-                if (word.Equal("WRITE")  ) 
-                {   currentFlags |= inFlags & qtssActionFlagsWrite; // accept following lines if inFlags has write
-                }
-                
-                if (word.Equal("READ") ) 
-                {   currentFlags |= inFlags & qtssActionFlagsRead; // accept following lines if inFlags has read
-                }
-                lineParser.ConsumeWhitespace();
-                lineParser.ConsumeUntil(&word, sWhitespaceAndGreaterThanMask);
-            }
-            continue; //done with limit line
+        if (haveRealmResultBuffer && realmRule >= 0)
+        {   StrPtrLen realm(inRules->GetRule(realmRule)->fValue);
+            GetRealm(&realm, ioRealmNameStr, userName, extraDataPtr );
         }
-        if ( word.Equal("</Limit>") )
-            currentFlags = qtssActionFlagsRead; // set the current access state to the default of read access
+        return allowed;
+    }
+    
+    allowed = this->EvaluateRules(inRules, userName, groupArray, numGroups, inFlags, ioRealmNameStr,
+                                    haveUserName, haveGroups, haveRealmResultBuffer, outAllowAnyUserPtr, &realmRule, extraDataPtr);
+    if (cacheResult)
+        inRules->AddResult(&resultKey, allowed, *outAllowAnyUserPtr, realmRule);
         
-        if (0 == (currentFlags & inFlags))
-            continue; // ignore lines because inFlags doesn't match the current access state
+    return allowed;
+}
+
+bool QTAccessFile::EvaluateRules(QTAccessRules* inRules, char *userName, char**groupArray, UInt32 numGroups, QTSS_ActionFlags inFlags,
+                                    StrPtrLen* ioRealmNameStr, bool haveUserName, bool haveGroups, bool haveRealmResultBuffer,
+                                    bool* outAllowAnyUserPtr, SInt32* outRealmRule, void *extraDataPtr)
+{
+    for (UInt32 index = 0; index < inRules->GetNumRules(); index++)
+    {
+        QTAccessRules::Rule* rule = inRules->GetRule(index);
+        if (0 == (rule->fScope & inFlags))
+            continue; // ignore lines because inFlags doesn't match the <Limit> they are in
             
-        if (haveRealmResultBuffer && word.Equal("AuthName") ) //realm name
+        if (rule->fType == QTAccessRules::kAuthName) //realm name
         {   
-            lineParser.ConsumeWhitespace();
-            lineParser.GetThruEOL(&word);
-            StringParser::UnQuote(&word);// if the parsed string is surrounded by quotes then remove them.
-            
-            GetRealm(&word, ioRealmNameStr, userName, extraDataPtr );
-
+            *outRealmRule = index;
+            if (haveRealmResultBuffer)
+            {   StrPtrLen realm(rule->fValue);
+                GetRealm(&realm, ioRealmNameStr, userName, extraDataPtr );
+            }
             // we don't change the buffer len ioRealmNameStr->Len because we might have another AuthName tag to copy
             continue; // done with AuthName (realm)
         }
         
-        
-        if (word.Equal("require") )
-        {
-            lineParser.ConsumeWhitespace();
-            lineParser.ConsumeUntilWhitespace(&word);       
-
-            if (haveUserName && word.Equal("valid-user") ) 
-            {   return true; 
-            }
+        if (rule->fType < QTAccessRules::kRequireValidUser)
+            continue; // AuthUserFile and the like are for FindUsersAndGroupsFilesAndAuthScheme
             
-            if ( word.Equal("any-user")  ) 
-            {   
-                *outAllowAnyUserPtr = true;
-                return true; 
-            }
+        if (haveUserName && rule->fType == QTAccessRules::kRequireValidUser) 
+            return true; 
+            
+        if (rule->fType == QTAccessRules::kRequireAnyUser) 
+        {   
+            *outAllowAnyUserPtr = true;
+            return true; 
+        }
     
-            if (!haveUserName)
-                continue;
-                
-            if (word.Equal("user") )
-            {   
-                lineParser.ConsumeWhitespace();
-                lineParser.ConsumeUntilWhitespace(&word);   
-                    
-                while (word.Len != 0) // compare each word in the line
-                {   
-                    if (TestUser(&word, userName, extraDataPtr ))
-                        return true;
-
-                    lineParser.ConsumeWhitespace();
-                    lineParser.ConsumeUntilWhitespace(&word);       
-                }
-                continue; // done with "require user" line
-            }
+        if (!haveUserName)
+            continue;
             
-            if (haveGroups && word.Equal("group")) // check if we have groups for the user
-            {
-                lineParser.ConsumeWhitespace();
-                lineParser.ConsumeUntilWhitespace(&word);       
-                
-                while (word.Len != 0) // compare each word in the line
-                {   
-                    if (TestGroup(&word, userName, groupArray, numGroups, extraDataPtr) )
-                        return true;
-
-                    lineParser.ConsumeWhitespace();
-                    lineParser.ConsumeUntilWhitespace(&word);
-                }
-                continue; // done with "require group" line
+        if (rule->fType == QTAccessRules::kRequireUser)
+        {   
+            for (UInt32 nameIndex = 0; nameIndex < rule->fNumNames; nameIndex++) // compare each word in the line
+            {   StrPtrLen name(rule->fNames[nameIndex]);
+                if (TestUser(&name, userName, extraDataPtr ))
+                    return true;
             }
-            
-            if (TestExtraData(&word, &lineParser, extraDataPtr))
-                return true;
-                
-                    
-            continue; // done with unparsed "require" line
+            continue; // done with "require user" line
         }
         
+        if (haveGroups && rule->fType == QTAccessRules::kRequireGroup) // check if we have groups for the user
+        {
+            for (UInt32 nameIndex = 0; nameIndex < rule->fNumNames; nameIndex++) // compare each word in the line
+            {   StrPtrLen name(rule->fNames[nameIndex]);
+                if (TestGroup(&name, userName, groupArray, numGroups, extraDataPtr) )
+                    return true;
+            }
+            continue; // done with "require group" line
+        }
+        
+        StrPtrLen word(rule->fValue);
+        StringParser lineParser(&rule->fRest);
+        if (TestExtraData(&word, &lineParser, extraDataPtr))
+            return true;
     }
     
     return false; // user or group not found
 }
 
-char*  QTAccessFile::GetAccessFile_Copy( const char* movieRootDir, const char* dirPath)
-{   
-    OSMutexLocker locker(sAccessFileMutex);
-
-    char* currentDir= NULL;
-    char* lastSlash = NULL;
-    int movieRootDirLen = ::strlen(movieRootDir);
-    int maxLen = strlen(dirPath)+strlen(sQTAccessFileName) + strlen(kPathDelimiterString) + 1;
-    currentDir = new char[maxLen];
-
-    ::strcpy(currentDir, dirPath);
-
-    //strip off filename
-    lastSlash = ::strrchr(currentDir, kPathDelimiterChar);
-    if (lastSlash != NULL)
-        lastSlash[0] = '\0';
-    
-    //check qtaccess files
+bool QTAccessFile::MakeResultKey(StrPtrLen* ioKey, UInt32 inMaxLen, char *userName, char**groupArray, UInt32 numGroups, QTSS_ActionFlags inFlags)
+{
+    // the flags, then the user and each group, each ending in a 0
+    if (inMaxLen < sizeof(inFlags))
+        return false;
+    ::memcpy(ioKey->Ptr, &inFlags, sizeof(inFlags));
+    ioKey->Len = sizeof(inFlags);
     
-    while ( true )  //walk backward up the dir tree.
+    UInt32 numNames = (groupArray != NULL) ? numGroups + 1 : 1;
+    for (UInt32 index = 0; index < numNames; index++)
     {
-        int curLen = strlen(currentDir) + strlen(sQTAccessFileName) + strlen(kPathDelimiterString);
-
-        if ( curLen >= maxLen )
-            break;
-    
-        ::strcat(currentDir, kPathDelimiterString);
-        ::strcat(currentDir, sQTAccessFileName);
-    
-        QTSS_Object fileObject = NULL;
-        if( QTSS_OpenFileObject(currentDir, qtssOpenFileNoFlags, &fileObject) == QTSS_NoErr) 
-        {
-            (void)QTSS_CloseFileObject(fileObject);
-            return currentDir;
-        }
-                
-        //strip off the "/qtaccess"
-        lastSlash = ::strrchr(currentDir, kPathDelimiterChar);
-        lastSlash[0] = '\0';
-            
-        //strip of the tailing directory
-        lastSlash = ::strrchr(currentDir, kPathDelimiterChar);
-        if (lastSlash == NULL)
-            break;
-        else
-            lastSlash[0] = '\0';
-        
-        if ( (lastSlash-currentDir) < movieRootDirLen ) //bail if we start eating our way out of fMovieRootDir
-            break;
+        char* name = (index == 0) ? userName : groupArray[index - 1];
+        UInt32 nameLen = (name != NULL) ? ::strlen(name) : 0;
+        if (ioKey->Len + nameLen + 1 > inMaxLen)
+            return false; // too long to remember
+        if (nameLen > 0)
+            ::memcpy(ioKey->Ptr + ioKey->Len, name, nameLen);
+        ioKey->Len += nameLen;
+        ioKey->Ptr[ioKey->Len++] = 0;
     }
+    return true;
+}
+
+char*  QTAccessFile::GetAccessFile_Copy( const char* movieRootDir, const char* dirPath)
+{   
+    QTAccessRules* theRules = QTAccessFileCache::FindRules(movieRootDir, dirPath);
+    if (NULL == theRules)
+        return NULL;
+    QTAccessRulesReleaser theRulesReleaser(theRules);
     
-    delete[] currentDir;
-    return NULL;
+    char* accessFilePath = new char[::strlen(theRules->GetPath()) + 1];
+    ::strcpy(accessFilePath, theRules->GetPath());
+    return accessFilePath;
 }
 
 // allocates memory for outUsersFilePath and outGroupsFilePath - remember to delete
@@ -383,7 +362,6 @@ char*  QTAccessFile::GetAccessFile_Copy( const char* movieRootDir, const char* d
 QTSS_AuthScheme QTAccessFile::FindUsersAndGroupsFilesAndAuthScheme(char* inAccessFilePath, QTSS_ActionFlags inAction, char** outUsersFilePath, char** outGroupsFilePath)
 {
     QTSS_AuthScheme authScheme = qtssAuthNone;
-    QTSS_ActionFlags currentFlags = qtssActionFlagsRead;
     
     if (inAccessFilePath == NULL)
     return authScheme;
@@ -393,98 +371,19 @@ QTSS_AuthScheme QTAccessFile::FindUsersAndGroupsFilesAndAuthScheme(char* inAcces
     //Assert(outUsersFilePath == NULL);
     //Assert(outGroupsFilePath == NULL);
     
-    StrPtrLen accessFileBuf;
-    (void)QTSSModuleUtils::ReadEntireFile(inAccessFilePath, &accessFileBuf);
-    OSCharArrayDeleter accessFileBufDeleter(accessFileBuf.Ptr);
-    
-    StringParser accessFileParser(&accessFileBuf);
-    StrPtrLen line;
-    StrPtrLen word;
+    QTAccessRules* theRules = QTAccessFileCache::GetRules(inAccessFilePath);
+    if (NULL == theRules)
+        return authScheme;
+    QTAccessRulesReleaser theRulesReleaser(theRules);
     
-    while( accessFileParser.GetDataRemaining() != 0 ) 
-    {
-        accessFileParser.GetThruEOL(&line);     // Read each line   
-        StringParser lineParser(&line);
-        lineParser.ConsumeWhitespace();         //skip over leading whitespace
-        if (lineParser.GetDataRemaining() == 0)     // must be an empty line
-            continue;
-
-        char firstChar = lineParser.PeekFast();
-        if ( (firstChar == '#') || (firstChar == '\0') )
-            continue;               //skip over comments and blank lines...
-        
-        lineParser.ConsumeUntilWhitespace(&word);
-               
-        if ( word.Equal("<Limit") ) // a limit line
-        {
-            currentFlags = qtssActionFlagsNoFlags; // clear to no access
-            lineParser.ConsumeWhitespace();
-            lineParser.ConsumeUntil( &word, sWhitespaceAndGreaterThanMask); // the flag <limit Read> or <limit Read >
-            while (word.Len != 0) // compare each word in the line
-            {   
-                if (word.Equal("WRITE")  ) 
-                {   
-                    currentFlags |= inAction & qtssActionFlagsWrite; // accept following lines if inFlags has write
-                }
-                    
-                if (word.Equal("READ") ) 
-                {   
-                    currentFlags |= inAction & qtssActionFlagsRead; // accept following lines if inFlags has read
-                }
-                            
-                lineParser.ConsumeWhitespace();
-                lineParser.ConsumeUntil(&word, sWhitespaceAndGreaterThanMask);
-            }
-            continue; //done with limit line
-        }
-        
-        if ( word.Equal("</Limit>") )
-            currentFlags = qtssActionFlagsRead; // set the current access state to the default of read access
-        
-        if (0 == (currentFlags & inAction))
-            continue; // ignore lines because inFlags doesn't match the current access state
-            
-        if (word.Equal("AuthUserFile") )
-        {
-            lineParser.ConsumeWhitespace();
-            lineParser.GetThruEOL(&word);
-            StringParser::UnQuote(&word);// if the parsed string is surrounded by quotes then remove them.
+    StrPtrLen usersFilePath;
+    StrPtrLen groupsFilePath;
+    authScheme = theRules->GetUsersAndGroupsFiles(inAction, &usersFilePath, &groupsFilePath);
     
-            if(*outUsersFilePath != NULL)       // we are encountering the AuthUserFile keyword twice!
-                delete[] *outUsersFilePath; // The last one found takes precedence...delete the previous path
-            
-            *outUsersFilePath = word.GetAsCString();
-            continue;
-        }
-        
-        if (word.Equal("AuthGroupFile") )
-        {
-            lineParser.ConsumeWhitespace();
-            lineParser.GetThruEOL(&word);
-            StringParser::UnQuote(&word);// if the parsed string is surrounded by quotes then remove them.
-
-            if(*outGroupsFilePath != NULL)      // we are encountering the AuthGroupFile keyword twice!
-                delete[] *outGroupsFilePath;    // The last one found takes precedence...delete the previous path       
-            
-            *outGroupsFilePath = word.GetAsCString();
-            
-            continue;
-        }
-        
-        if (word.Equal("AuthScheme") )
-        {
-            lineParser.ConsumeWhitespace();
-            lineParser.GetThruEOL(&word);
-            StringParser::UnQuote(&word);// if the parsed string is surrounded by quotes then remove them.
-
-            if (word.Equal("basic"))
-                authScheme = qtssAuthBasic;
-            else if (word.Equal("digest"))
-                authScheme = qtssAuthDigest;
-                
-            continue;
-        }
-    }
+    if (usersFilePath.Ptr != NULL)
+        *outUsersFilePath = usersFilePath.GetAsCString();
+    if (groupsFilePath.Ptr != NULL)
+        *outGroupsFilePath = groupsFilePath.GetAsCString();
     
     return authScheme;
 }
@@ -524,8 +423,8 @@ QTSS_Error QTAccessFile::AuthorizeRequest(QTSS_StandardRTSP_Params* inParams, bo
     if (NULL == theUserProfile)
         return QTSS_RequestFailed;
 
-    char* accessFilePath = QTAccessFile::GetAccessFile_Copy(movieRootDirStr, pathBuffStr);
-    OSCharArrayDeleter accessFilePathDeleter(accessFilePath);
+    QTAccessRules* accessRules = QTAccessFileCache::FindRules(movieRootDirStr, pathBuffStr);
+    QTAccessRulesReleaser accessRulesReleaser(accessRules);
         
     char* username = QTSSModuleUtils::GetUserName_Copy(theUserProfile);
     OSCharArrayDeleter usernameDeleter(username);
@@ -534,18 +433,18 @@ QTSS_Error QTAccessFile::AuthorizeRequest(QTSS_StandardRTSP_Params* inParams, bo
     char** groupCharPtrArray =  QTSSModuleUtils::GetGroupsArray_Copy(theUserProfile, &numGroups);
     OSCharPointerArrayDeleter groupCharPtrArrayDeleter(groupCharPtrArray);
     
-    StrPtrLen accessFileBuf;
-    (void)QTSSModuleUtils::ReadEntireFile(accessFilePath, &accessFileBuf);
-    OSCharArrayDeleter accessFileBufDeleter(accessFileBuf.Ptr);
+    if (NULL == sValidUserRules)
+        QTAccessFile::Initialize();
         
-    if (accessFileBuf.Len == 0 && !allowNoAccessFiles)
-    {   accessFileBuf.Set(sAccessValidUser);
+    QTAccessRules* rules = accessRules;
+    if ((NULL == rules || rules->IsEmpty()) && !allowNoAccessFiles)
+    {   rules = sValidUserRules;
         if (DEBUG_QTACCESS) 
             qtss_printf("QTAccessFile::AuthorizeRequest SET Accessfile valid user for no accessfile %s\n", sAccessValidUser);
     }
       
-    if (accessFileBuf.Len == 0 && allowNoAccessFiles)
-    {   accessFileBuf.Set(sAccessAnyUser);
+    if ((NULL == rules || rules->IsEmpty()) && allowNoAccessFiles)
+    {   rules = sAnyUserRules;
         if (DEBUG_QTACCESS) 
             qtss_printf("QTAccessFile::AuthorizeRequest SET Accessfile any user for no access file %s\n", sAccessAnyUser);
     }
@@ -554,7 +453,7 @@ QTSS_Error QTAccessFile::AuthorizeRequest(QTSS_StandardRTSP_Params* inParams, bo
     StrPtrLen   realmNameStr(realmName,kBuffLen -1);
     
     //check if this user is allowed to see this movie
-    bool allowRequest = this->AccessAllowed(username, groupCharPtrArray, numGroups,  &accessFileBuf, authorizeAction,&realmNameStr, outAllowAnyUserPtr );
+    bool allowRequest = this->AccessAllowed(username, groupCharPtrArray, numGroups,  rules, authorizeAction,&realmNameStr, outAllowAnyUserPtr );
     debug_printf("accessFile.AccessAllowed for user=%s returned %d\n", username, allowRequest);
     
     // Get the auth scheme
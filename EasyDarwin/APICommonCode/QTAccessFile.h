@@ -40,6 +40,8 @@
 #include "StringParser.h"
 #include "OSMutex.h"
 
+class QTAccessRules;
+
 class QTAccessFile
 {
     public:
@@ -51,6 +53,7 @@ class QTAccessFile
         //GetGroupsArrayCopy 
         //
         // GetGroupsArrayCopy allocates outGroupCharPtrArray. Caller must "delete [] outGroupCharPtrArray" when done.
+        // The access file is found in QTAccessFileCache; the disk is only looked at the first time.
         static char*  GetAccessFile_Copy( const char* movieRootDir, const char* dirPath);
 
         //over ride these in a sub class
@@ -63,6 +66,10 @@ class QTAccessFile
         virtual void   GetRealm(StrPtrLen* accessRealm, StrPtrLen* ioRealmNameStr, char *userName,void *extraDataPtr );
         virtual bool ValidUser(char* userName, void* extraDataPtr) { return false; };
 
+        // Return false if the above look at anything but their arguments, and the
+        // answers AccessAllowed gives can't be remembered for the access file.
+        virtual bool CacheAccessResults() { return true; }
+
         //AccessAllowed
         //
         // This routine is used to get the Realm to send back to a user and to check if a user has access
@@ -78,6 +85,14 @@ class QTAccessFile
                                         void *extraDataPtr = NULL
                                     );
 
+        // The same, for an access file compiled by QTAccessFileCache. Without extraDataPtr,
+        // the answer is remembered by the rules for the next user that asks with the same groups.
+        bool AccessAllowed (   char *userName, char**groupArray, UInt32 numGroups, 
+                                        QTAccessRules* inRules,QTSS_ActionFlags inFlags,StrPtrLen* ioRealmNameStr,
+                                        bool* outAllowAnyUserPtr,
+                                        void *extraDataPtr = NULL
+                                    );
+
         static void SetAccessFileName(const char *inQTAccessFileName); //makes a copy and stores it
         static char* GetAccessFileName() { return sQTAccessFileName; }; // a reference. Don't delete!
         
@@ -89,11 +104,18 @@ class QTAccessFile
         virtual ~QTAccessFile() {};
         
     private:    
+        bool EvaluateRules(QTAccessRules* inRules, char *userName, char**groupArray, UInt32 numGroups, QTSS_ActionFlags inFlags,
+                                        StrPtrLen* ioRealmNameStr, bool haveUserName, bool haveGroups, bool haveRealmResultBuffer,
+                                        bool* outAllowAnyUserPtr, SInt32* outRealmRule, void *extraDataPtr);
+        static bool MakeResultKey(StrPtrLen* ioKey, UInt32 inMaxLen, char *userName, char**groupArray, UInt32 numGroups, QTSS_ActionFlags inFlags);
+
         static char* sQTAccessFileName; // managed by the QTAccess module
         static bool sAllocatedName;
         static OSMutex* sAccessFileMutex;
         static char* sAccessValidUser;
         static char* sAccessAnyUser;
+        static QTAccessRules* sValidUserRules;  // sAccessValidUser and sAccessAnyUser compiled
+        static QTAccessRules* sAnyUserRules;
         
 
 };
@@ -108,6 +130,7 @@ class DSAccessFile : public QTAccessFile
             return this->CheckGroupMembership(userName, deleter.Ptr );
         }
        virtual bool ValidUser(char* userName, void* extraDataPtr);
+       virtual bool CacheAccessResults() { return false; } // group membership comes from the directory service
 	   bool CheckGroupMembership(const char* inUsername, const char* inGroupName);
 
 };
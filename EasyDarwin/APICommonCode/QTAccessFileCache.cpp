@@ -0,0 +1,859 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       QTAccessFileCache.cpp
+
+	Contains:   Implements QTAccessRules and QTAccessFileCache
+*/
+
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#include "QTAccessFileCache.h"
+#include "QTAccessFile.h"
+#include "StringParser.h"
+#include "OSFileSource.h"
+#include "OSHashTable.h"
+#include "OSArrayObjectDeleter.h"
+#include "OS.h"
+#include "atomic.h"
+
+//
+// QTAccessRules
+
+QTAccessRules::QTAccessRules(StrPtrLen* inText, const char* inPath)
+	: fPath(NULL),
+	fRules(NULL),
+	fNumRules(0),
+	fRefCount(1)
+{
+	if (inPath != NULL)
+	{
+		fPath = new char[::strlen(inPath) + 1];
+		::strcpy(fPath, inPath);
+	}
+
+	fText.Len = (inText != NULL) ? inText->Len : 0;
+	fText.Ptr = new char[fText.Len + 1];
+	if (fText.Len > 0)
+		::memcpy(fText.Ptr, inText->Ptr, fText.Len);
+	fText.Ptr[fText.Len] = '\0';
+
+	::memset(fResults, 0, sizeof(fResults));
+	this->Compile();
+}
+
+QTAccessRules::~QTAccessRules()
+{
+	for (UInt32 x = 0; x < fNumRules; x++)
+		delete[] fRules[x].fNames;
+	delete[] fRules;
+	delete[] fText.Ptr;
+	delete[] fPath;
+}
+
+void QTAccessRules::Retain()
+{
+	(void)atomic_add(&fRefCount, 1);
+}
+
+void QTAccessRules::Release()
+{
+	if (atomic_sub(&fRefCount, 1) == 0)
+		delete this;
+}
+
+// Parses the file the way QTAccessFile::AccessAllowed used to on every request.
+// Rules point into fText.
+void QTAccessRules::Compile()
+{
+	UInt32 theMaxRules = 1;
+	for (UInt32 x = 0; x < fText.Len; x++)
+	{
+		if ((fText.Ptr[x] == '\n') || (fText.Ptr[x] == '\r'))
+			theMaxRules++;
+	}
+	fRules = new Rule[theMaxRules];
+
+	StringParser        theFileParser(&fText);
+	QTSS_ActionFlags    theScope = qtssActionFlagsRead;
+	StrPtrLen           theLine;
+	StrPtrLen           theWord;
+
+	while (theFileParser.GetDataRemaining() != 0)
+	{
+		theFileParser.GetThruEOL(&theLine);
+		StringParser theLineParser(&theLine);
+		theLineParser.ConsumeWhitespace();//skip over leading whitespace
+		if (theLineParser.GetDataRemaining() == 0) // must be an empty line
+			continue;
+
+		char firstChar = theLineParser.PeekFast();
+		if ((firstChar == '#') || (firstChar == '\0'))
+			continue; //skip over comments and blank lines...
+
+		theLineParser.ConsumeUntilWhitespace(&theWord);
+		if (theWord.Equal("<Limit")) // the lines that follow apply only to the listed actions
+		{
+			theScope = qtssActionFlagsNoFlags;
+			theLineParser.ConsumeWhitespace();
+			theLineParser.ConsumeUntil(&theWord, QTAccessFile::sWhitespaceAndGreaterThanMask);
+			while (theWord.Len != 0)
+			{
+				if (theWord.Equal("WRITE"))
+					theScope |= qtssActionFlagsWrite;
+				if (theWord.Equal("READ"))
+					theScope |= qtssActionFlagsRead;
+
+				theLineParser.ConsumeWhitespace();
+				theLineParser.ConsumeUntil(&theWord, QTAccessFile::sWhitespaceAndGreaterThanMask);
+			}
+			continue;
+		}
+
+		if (theWord.Equal("</Limit>"))
+		{
+			theScope = qtssActionFlagsRead; // back to the default of read access
+			continue;
+		}
+
+		Rule* theRule = &fRules[fNumRules];
+		theRule->fScope = theScope;
+		theRule->fNames = NULL;
+		theRule->fNumNames = 0;
+
+		if (theWord.Equal("require"))
+		{
+			theLineParser.ConsumeWhitespace();
+			theLineParser.ConsumeUntilWhitespace(&theRule->fValue);
+			theRule->fRest.Set(theLineParser.GetCurrentPosition(), theLineParser.GetDataRemaining());
+
+			if (theRule->fValue.Equal("valid-user"))
+				theRule->fType = kRequireValidUser;
+			else if (theRule->fValue.Equal("any-user"))
+				theRule->fType = kRequireAnyUser;
+			else if (theRule->fValue.Equal("user"))
+				theRule->fType = kRequireUser;
+			else if (theRule->fValue.Equal("group"))
+				theRule->fType = kRequireGroup;
+			else
+				theRule->fType = kRequireOther;
+
+			if ((theRule->fType == kRequireUser) || (theRule->fType == kRequireGroup))
+			{
+				// count the names, then keep them
+				StringParser theCountParser(&theRule->fRest);
+				theCountParser.ConsumeWhitespace();
+				theCountParser.ConsumeUntilWhitespace(&theWord);
+				UInt32 theNumNames = 0;
+				while (theWord.Len != 0)
+				{
+					theNumNames++;
+					theCountParser.ConsumeWhitespace();
+					theCountParser.ConsumeUntilWhitespace(&theWord);
+				}
+
+				if (theNumNames > 0)
+					theRule->fNames = new StrPtrLen[theNumNames];
+
+				StringParser theNameParser(&theRule->fRest);
+				for (UInt32 x = 0; x < theNumNames; x++)
+				{
+					theNameParser.ConsumeWhitespace();
+					theNameParser.ConsumeUntilWhitespace(&theRule->fNames[x]);
+				}
+				theRule->fNumNames = theNumNames;
+			}
+
+			fNumRules++;
+			continue;
+		}
+
+		if (theWord.Equal("AuthName"))
+			theRule->fType = kAuthName;
+		else if (theWord.Equal("AuthUserFile"))
+			theRule->fType = kAuthUserFile;
+		else if (theWord.Equal("AuthGroupFile"))
+			theRule->fType = kAuthGroupFile;
+		else if (theWord.Equal("AuthScheme"))
+			theRule->fType = kAuthScheme;
+		else
+			continue; // not a line anybody looks at
+
+		theLineParser.ConsumeWhitespace();
+		theLineParser.GetThruEOL(&theRule->fValue);
+		StringParser::UnQuote(&theRule->fValue);// if the parsed string is surrounded by quotes then remove them.
+		theRule->fRest.Set(NULL, 0);
+		fNumRules++;
+	}
+}
+
+QTSS_AuthScheme QTAccessRules::GetUsersAndGroupsFiles(QTSS_ActionFlags inAction, StrPtrLen* outUsersFilePath, StrPtrLen* outGroupsFilePath)
+{
+	QTSS_AuthScheme theAuthScheme = qtssAuthNone;
+	outUsersFilePath->Set(NULL, 0);
+	outGroupsFilePath->Set(NULL, 0);
+
+	for (UInt32 x = 0; x < fNumRules; x++)
+	{
+		Rule* theRule = &fRules[x];
+		if (0 == (theRule->fScope & inAction))
+			continue;
+
+		// The last one found takes precedence
+		if (theRule->fType == kAuthUserFile)
+			*outUsersFilePath = theRule->fValue;
+		else if (theRule->fType == kAuthGroupFile)
+			*outGroupsFilePath = theRule->fValue;
+		else if (theRule->fType == kAuthScheme)
+		{
+			if (theRule->fValue.Equal("basic"))
+				theAuthScheme = qtssAuthBasic;
+			else if (theRule->fValue.Equal("digest"))
+				theAuthScheme = qtssAuthDigest;
+		}
+	}
+
+	return theAuthScheme;
+}
+
+UInt32 QTAccessRules::GetResultIndex(StrPtrLen* inKey)
+{
+	UInt32 theHash = 0;
+	for (UInt32 x = 0; x < inKey->Len; x++)
+		theHash = (theHash * 31) + (UInt8)inKey->Ptr[x];
+	return theHash % kNumResults;
+}
+
+bool QTAccessRules::FindResult(StrPtrLen* inKey, bool* outAllowed, bool* outAllowAnyUser, SInt32* outRealmRule)
+{
+	if ((inKey->Len == 0) || (inKey->Len > kMaxResultKeyLen))
+		return false;
+
+	OSMutexLocker locker(&fResultsMutex);
+	Result* theResult = &fResults[this->GetResultIndex(inKey)];
+	if ((theResult->fKeyLen != inKey->Len) || (::memcmp(theResult->fKey, inKey->Ptr, inKey->Len) != 0))
+		return false;
+
+	*outAllowed = theResult->fAllowed;
+	*outAllowAnyUser = theResult->fAllowAnyUser;
+	*outRealmRule = theResult->fRealmRule;
+	return true;
+}
+
+void QTAccessRules::AddResult(StrPtrLen* inKey, bool inAllowed, bool inAllowAnyUser, SInt32 inRealmRule)
+{
+	if ((inKey->Len == 0) || (inKey->Len > kMaxResultKeyLen))
+		return;
+
+	// one answer per slot; a collision replaces the older one
+	OSMutexLocker locker(&fResultsMutex);
+	Result* theResult = &fResults[this->GetResultIndex(inKey)];
+	::memcpy(theResult->fKey, inKey->Ptr, inKey->Len);
+	theResult->fKeyLen = inKey->Len;
+	theResult->fAllowed = inAllowed;
+	theResult->fAllowAnyUser = inAllowAnyUser;
+	theResult->fRealmRule = inRealmRule;
+}
+
+//
+// QTAccessFileCache
+
+// What stat said about a path, to see whether it has changed when it can't be watched
+struct QTAccessFileStamp
+{
+	bool    fExists;
+	bool    fIsDir;
+	SInt64  fModDate;
+	UInt64  fLength;
+	UInt64  fInode;
+};
+
+static void GetStamp(const char* inPath, QTAccessFileStamp* outStamp)
+{
+	::memset(outStamp, 0, sizeof(QTAccessFileStamp));
+
+	struct stat theStat;
+	if (::stat(inPath, &theStat) != 0)
+		return;
+
+	outStamp->fExists = true;
+#ifdef __Win32__
+	outStamp->fIsDir = (theStat.st_mode & _S_IFDIR) != 0;
+#else
+	outStamp->fIsDir = S_ISDIR(theStat.st_mode);
+#endif
+	outStamp->fModDate = theStat.st_mtime;
+	outStamp->fLength = theStat.st_size;
+	outStamp->fInode = theStat.st_ino;
+}
+
+static bool SameStamp(QTAccessFileStamp* inStamp1, QTAccessFileStamp* inStamp2)
+{
+	return (inStamp1->fExists == inStamp2->fExists) && (inStamp1->fIsDir == inStamp2->fIsDir) &&
+		(inStamp1->fModDate == inStamp2->fModDate) && (inStamp1->fLength == inStamp2->fLength) &&
+		(inStamp1->fInode == inStamp2->fInode);
+}
+
+// A directory that has been asked about
+class QTAccessFileCacheDir
+{
+public:
+
+	QTAccessFileCacheDir(const char* inPath, UInt32 inHashValue);
+	~QTAccessFileCacheDir();
+
+	char*                   fPath;
+	char*                   fAccessFilePath;
+	UInt32                  fHashValue;
+	QTAccessFileCacheDir*   fNextHashEntry;
+
+	SInt32                  fParentLen;     // length of the parent's path, -1 at the top
+	QTAccessFileCacheDir*   fParent;        // NULL until somebody walks up
+
+	QTAccessRules*          fRules;         // of the access file in this directory, or NULL
+
+	int                     fWatch;         // inotify watch of the directory, or -1
+	bool                    fPolled;        // not watched, so stat'ed for changes
+	QTAccessFileStamp       fDirStamp;
+	QTAccessFileStamp       fAccessFileStamp;
+};
+
+class QTAccessFileCacheKey
+{
+public:
+
+	QTAccessFileCacheKey(const char* inPath)
+		: fPath(inPath), fHashValue(0)
+	{
+		for (const char* theChar = inPath; *theChar != '\0'; theChar++)
+			fHashValue = (fHashValue * 31) + (UInt8)*theChar;
+	}
+	QTAccessFileCacheKey(QTAccessFileCacheDir* inDir)
+		: fPath(inDir->fPath), fHashValue(inDir->fHashValue) {}
+
+	UInt32  GetHashKey() { return fHashValue; }
+
+	bool operator==(const QTAccessFileCacheKey& inKey) const
+	{
+		return (fHashValue == inKey.fHashValue) && (::strcmp(fPath, inKey.fPath) == 0);
+	}
+
+private:
+
+	const char* fPath;
+	UInt32      fHashValue;
+};
+
+// A users or groups file
+class QTAccessFileCacheWatch
+{
+public:
+
+	char*                   fPath;
+	char*                   fName;          // the part of fPath after the directory
+	int                     fWatch;         // of the directory, or -1 if polled
+	QTAccessFileStamp       fStamp;
+	QTAccessFileCacheWatch* fNext;
+};
+
+static const UInt32 kDirTableSize = 1024;
+
+OSMutexRW               QTAccessFileCache::sMutex;
+OSMutex                 QTAccessFileCache::sCheckMutex;
+OSHashTable<QTAccessFileCacheDir, QTAccessFileCacheKey>* QTAccessFileCache::sDirs = NULL;
+QTAccessFileCacheWatch* QTAccessFileCache::sWatches = NULL;
+char*                   QTAccessFileCache::sAccessFileName = NULL;
+UInt32                  QTAccessFileCache::sGeneration = 1;
+SInt64                  QTAccessFileCache::sNextCheckMsec = 0;
+int                     QTAccessFileCache::sInotifyFD = -1;
+
+// Reads the directory and its access file. Called with sMutex held for writing.
+QTAccessFileCacheDir::QTAccessFileCacheDir(const char* inPath, UInt32 inHashValue)
+	: fHashValue(inHashValue),
+	fNextHashEntry(NULL),
+	fParent(NULL),
+	fRules(NULL),
+	fWatch(-1),
+	fPolled(false)
+{
+	fPath = new char[::strlen(inPath) + 1];
+	::strcpy(fPath, inPath);
+
+	char* theLastSlash = ::strrchr(fPath, kPathDelimiterChar);
+	fParentLen = (theLastSlash != NULL) ? (SInt32)(theLastSlash - fPath) : -1;
+
+	fAccessFilePath = new char[::strlen(inPath) + ::strlen(kPathDelimiterString) + ::strlen(QTAccessFileCache::sAccessFileName) + 1];
+	::strcpy(fAccessFilePath, inPath);
+	::strcat(fAccessFilePath, kPathDelimiterString);
+	::strcat(fAccessFilePath, QTAccessFileCache::sAccessFileName);
+
+	// the top of the file system is the empty path
+	const char* theDirPath = (inPath[0] != '\0') ? inPath : kPathDelimiterString;
+
+	// Start watching before reading, so that a change made meanwhile isn't missed
+	fWatch = QTAccessFileCache::AddWatch(theDirPath);
+	if (fWatch == -1)
+	{
+		int theErr = errno;
+		if ((QTAccessFileCache::sInotifyFD == -1) || ((theErr != ENOENT) && (theErr != ENOTDIR)))
+		{
+			// A directory that doesn't exist needs no polling. Its nearest
+			// parent that does exist sees it, or an access file in it, appear.
+			::GetStamp(theDirPath, &fDirStamp);
+			fPolled = fDirStamp.fIsDir;
+			if (fPolled)
+				::GetStamp(fAccessFilePath, &fAccessFileStamp);
+		}
+	}
+
+	StrPtrLen theData;
+	if (QTAccessFileCache::ReadFile(fAccessFilePath, &theData) == QTSS_NoErr)
+	{
+		OSCharArrayDeleter theDataDeleter(theData.Ptr);
+		fRules = new QTAccessRules(&theData, fAccessFilePath);
+	}
+}
+
+QTAccessFileCacheDir::~QTAccessFileCacheDir()
+{
+	QTAccessFileCache::RemoveWatch(fWatch);
+	if (fRules != NULL)
+		fRules->Release();
+	delete[] fAccessFilePath;
+	delete[] fPath;
+}
+
+void QTAccessFileCache::Initialize()
+{
+	OSMutexWriteLocker locker(&sMutex);
+	if (sDirs != NULL)
+		return;
+
+	sDirs = new OSHashTable<QTAccessFileCacheDir, QTAccessFileCacheKey>(kDirTableSize);
+	if (sAccessFileName == NULL)
+	{
+		sAccessFileName = new char[::strlen(QTAccessFile::GetAccessFileName()) + 1];
+		::strcpy(sAccessFileName, QTAccessFile::GetAccessFileName());
+	}
+
+#ifdef __linux__
+	sInotifyFD = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+void QTAccessFileCache::SetAccessFileName(const char* inName)
+{
+	OSMutexWriteLocker locker(&sMutex);
+	if ((sAccessFileName != NULL) && (::strcmp(sAccessFileName, inName) == 0))
+		return;
+
+	// the nodes point at files of the old name
+	Flush(false);
+	delete[] sAccessFileName;
+	sAccessFileName = new char[::strlen(inName) + 1];
+	::strcpy(sAccessFileName, inName);
+}
+
+int QTAccessFileCache::AddWatch(const char* inDirPath)
+{
+#ifdef __linux__
+	if (sInotifyFD == -1)
+		return -1;
+
+	// Directories appearing or going away change where the access files are.
+	// Writes to a file only matter when it is one we know of.
+	return ::inotify_add_watch(sInotifyFD, inDirPath, IN_ONLYDIR | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO |
+		IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF);
+#else
+	return -1;
+#endif
+}
+
+// Called with sMutex held for writing, as a directory node is dropped
+void QTAccessFileCache::RemoveWatch(int inWatch)
+{
+#ifdef __linux__
+	if ((sInotifyFD == -1) || (inWatch == -1))
+		return;
+
+	// inotify hands out one watch per directory, so a users or groups file in
+	// this directory may be sharing it. Those are watched for good.
+	for (QTAccessFileCacheWatch* theWatch = sWatches; theWatch != NULL; theWatch = theWatch->fNext)
+	{
+		if (theWatch->fWatch == inWatch)
+			return;
+	}
+
+	// Fails harmlessly if the directory is gone and inotify dropped the watch itself
+	(void)::inotify_rm_watch(sInotifyFD, inWatch);
+#endif
+}
+
+// Called with sMutex held for writing
+QTAccessFileCacheDir* QTAccessFileCache::GetDir(const char* inDirPath)
+{
+	QTAccessFileCacheKey theKey(inDirPath);
+	QTAccessFileCacheDir* theDir = sDirs->Map(&theKey);
+	if (theDir == NULL)
+	{
+		theDir = new QTAccessFileCacheDir(inDirPath, theKey.GetHashKey());
+		sDirs->Add(theDir);
+	}
+	return theDir;
+}
+
+// Walks up from inDirPath to the first directory with an access file. Returns
+// false if that needs a node that isn't there and inCreate is false.
+bool QTAccessFileCache::Resolve(const char* inDirPath, SInt32 inRootLen, bool inCreate, QTAccessRules** outRules)
+{
+	*outRules = NULL;
+
+	QTAccessFileCacheKey theKey(inDirPath);
+	QTAccessFileCacheDir* theDir = sDirs->Map(&theKey);
+	if (theDir == NULL)
+	{
+		if (!inCreate)
+			return false;
+		theDir = GetDir(inDirPath);
+	}
+
+	while (true)
+	{
+		if (theDir->fRules != NULL)
+		{
+			theDir->fRules->Retain();
+			*outRules = theDir->fRules;
+			return true;
+		}
+
+		//bail if we start eating our way out of the movie folder
+		if ((theDir->fParentLen < 0) || (theDir->fParentLen < inRootLen))
+			return true;
+
+		if (theDir->fParent == NULL)
+		{
+			if (!inCreate)
+				return false;
+
+			char* theParentPath = new char[theDir->fParentLen + 1];
+			OSCharArrayDeleter theParentPathDeleter(theParentPath);
+			::memcpy(theParentPath, theDir->fPath, theDir->fParentLen);
+			theParentPath[theDir->fParentLen] = '\0';
+			theDir->fParent = GetDir(theParentPath);
+		}
+		theDir = theDir->fParent;
+	}
+}
+
+QTAccessRules* QTAccessFileCache::FindRules(const char* inMovieRootDir, const char* inPath)
+{
+	if (sDirs == NULL)
+		Initialize();
+	CheckForChanges();
+
+	//strip off filename
+	char* theDirPath = new char[::strlen(inPath) + 1];
+	OSCharArrayDeleter theDirPathDeleter(theDirPath);
+	::strcpy(theDirPath, inPath);
+	char* theLastSlash = ::strrchr(theDirPath, kPathDelimiterChar);
+	if (theLastSlash != NULL)
+		theLastSlash[0] = '\0';
+
+	SInt32 theRootLen = ::strlen(inMovieRootDir);
+	QTAccessRules* theRules = NULL;
+	{
+		OSMutexReadLocker locker(&sMutex);
+		if (Resolve(theDirPath, theRootLen, false, &theRules))
+			return theRules;
+	}
+
+	OSMutexWriteLocker locker(&sMutex);
+	if (sDirs->GetNumEntries() >= kMaxDirs)
+		Flush(false);
+	(void)Resolve(theDirPath, theRootLen, true, &theRules);
+	return theRules;
+}
+
+QTAccessRules* QTAccessFileCache::GetRules(const char* inAccessFilePath)
+{
+	if (inAccessFilePath == NULL)
+		return NULL;
+
+	if (sDirs == NULL)
+		Initialize();
+	CheckForChanges();
+
+	char* theDirPath = new char[::strlen(inAccessFilePath) + 1];
+	OSCharArrayDeleter theDirPathDeleter(theDirPath);
+	::strcpy(theDirPath, inAccessFilePath);
+	char* theName = ::strrchr(theDirPath, kPathDelimiterChar);
+
+	{
+		OSMutexReadLocker locker(&sMutex);
+		if ((theName == NULL) || (::strcmp(theName + 1, sAccessFileName) != 0))
+		{
+			// not an access file the cache knows about: read it as it is now
+			locker.UnLock();
+			locker.SetMutex(NULL);
+
+			StrPtrLen theData;
+			if (ReadFile(inAccessFilePath, &theData) != QTSS_NoErr)
+				return NULL;
+			OSCharArrayDeleter theDataDeleter(theData.Ptr);
+			return new QTAccessRules(&theData, inAccessFilePath);
+		}
+
+		theName[0] = '\0';
+		QTAccessFileCacheKey theKey(theDirPath);
+		QTAccessFileCacheDir* theDir = sDirs->Map(&theKey);
+		if (theDir != NULL)
+		{
+			if (theDir->fRules != NULL)
+				theDir->fRules->Retain();
+			return theDir->fRules;
+		}
+	}
+
+	OSMutexWriteLocker locker(&sMutex);
+	if (sDirs->GetNumEntries() >= kMaxDirs)
+		Flush(false);
+	QTAccessFileCacheDir* theDir = GetDir(theDirPath);
+	if (theDir->fRules != NULL)
+		theDir->fRules->Retain();
+	return theDir->fRules;
+}
+
+void QTAccessFileCache::WatchFile(const char* inPath)
+{
+	if (inPath == NULL)
+		return;
+
+	if (sDirs == NULL)
+		Initialize();
+
+	OSMutexWriteLocker locker(&sMutex);
+	for (QTAccessFileCacheWatch* theWatch = sWatches; theWatch != NULL; theWatch = theWatch->fNext)
+	{
+		if (::strcmp(theWatch->fPath, inPath) == 0)
+			return;
+	}
+
+	QTAccessFileCacheWatch* theWatch = new QTAccessFileCacheWatch;
+	theWatch->fPath = new char[::strlen(inPath) + 1];
+	::strcpy(theWatch->fPath, inPath);
+	theWatch->fWatch = -1;
+
+	char* theLastSlash = ::strrchr(theWatch->fPath, kPathDelimiterChar);
+	if (theLastSlash != NULL)
+	{
+		// watch the directory, so that a file replaced by a rename is seen too
+		theLastSlash[0] = '\0';
+		theWatch->fWatch = AddWatch((theWatch->fPath[0] != '\0') ? theWatch->fPath : kPathDelimiterString);
+		theLastSlash[0] = kPathDelimiterChar;
+		theWatch->fName = theLastSlash + 1;
+	}
+	else
+		theWatch->fName = theWatch->fPath;
+
+	::GetStamp(theWatch->fPath, &theWatch->fStamp);
+	theWatch->fNext = sWatches;
+	sWatches = theWatch;
+}
+
+UInt32 QTAccessFileCache::GetGeneration()
+{
+	if (sDirs == NULL)
+		Initialize();
+	CheckForChanges();
+	return sGeneration;
+}
+
+void QTAccessFileCache::CheckForChanges()
+{
+	SInt64 theNow = OS::Milliseconds();
+	if (theNow < sNextCheckMsec)
+		return;
+
+	// one request looks; the others go on with what is cached
+	if (!sCheckMutex.TryLock())
+		return;
+
+	if (theNow >= sNextCheckMsec)
+	{
+		sNextCheckMsec = theNow + kCheckIntervalMsec;
+
+		bool theChanged = ReadEvents();
+		if (PollForChanges())
+			theChanged = true;
+
+		if (theChanged)
+		{
+			OSMutexWriteLocker locker(&sMutex);
+			Flush(true);
+		}
+	}
+
+	sCheckMutex.Unlock();
+}
+
+bool QTAccessFileCache::ReadEvents()
+{
+	bool theChanged = false;
+
+#ifdef __linux__
+	if (sInotifyFD == -1)
+		return false;
+
+	char theBuffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	while (true)
+	{
+		ssize_t theLen = ::read(sInotifyFD, theBuffer, sizeof(theBuffer));
+		if (theLen <= 0)
+			break;
+
+		OSMutexReadLocker locker(&sMutex);
+		for (char* thePtr = theBuffer; thePtr < theBuffer + theLen; )
+		{
+			struct inotify_event* theEvent = (struct inotify_event*)thePtr;
+			thePtr += sizeof(struct inotify_event) + theEvent->len;
+
+			if (theEvent->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_ISDIR))
+			{
+				theChanged = true;
+				continue;
+			}
+
+			if ((theEvent->len == 0) || (sAccessFileName == NULL))
+				continue;
+
+			if (::strcmp(theEvent->name, sAccessFileName) == 0)
+			{
+				theChanged = true;
+				continue;
+			}
+
+			for (QTAccessFileCacheWatch* theWatch = sWatches; theWatch != NULL; theWatch = theWatch->fNext)
+			{
+				if ((theWatch->fWatch == theEvent->wd) && (::strcmp(theEvent->name, theWatch->fName) == 0))
+				{
+					theChanged = true;
+					break;
+				}
+			}
+		}
+	}
+#endif
+
+	return theChanged;
+}
+
+// Stats what isn't watched. Only the request holding sCheckMutex writes the stamps.
+bool QTAccessFileCache::PollForChanges()
+{
+	bool theChanged = false;
+	QTAccessFileStamp theStamp;
+
+	OSMutexReadLocker locker(&sMutex);
+	if (sDirs == NULL)
+		return false;
+
+	for (OSHashTableIter<QTAccessFileCacheDir, QTAccessFileCacheKey> theIter(sDirs); !theIter.IsDone() && !theChanged; theIter.Next())
+	{
+		QTAccessFileCacheDir* theDir = theIter.GetCurrent();
+		if (!theDir->fPolled)
+			continue;
+
+		::GetStamp((theDir->fPath[0] != '\0') ? theDir->fPath : kPathDelimiterString, &theStamp);
+		if (!::SameStamp(&theStamp, &theDir->fDirStamp))
+			theChanged = true;
+
+		::GetStamp(theDir->fAccessFilePath, &theStamp);
+		if (!::SameStamp(&theStamp, &theDir->fAccessFileStamp))
+			theChanged = true;
+	}
+
+	for (QTAccessFileCacheWatch* theWatch = sWatches; theWatch != NULL; theWatch = theWatch->fNext)
+	{
+		if (theWatch->fWatch != -1)
+			continue;
+
+		::GetStamp(theWatch->fPath, &theStamp);
+		if (!::SameStamp(&theStamp, &theWatch->fStamp))
+		{
+			theWatch->fStamp = theStamp;
+			theChanged = true;
+		}
+	}
+
+	return theChanged;
+}
+
+// Drops every node, and with it the watch of its directory. Called with sMutex held for writing.
+void QTAccessFileCache::Flush(bool inChanged)
+{
+	if (inChanged)
+		sGeneration++;
+
+	if (sDirs == NULL)
+		return;
+
+	for (UInt32 x = 0; x < sDirs->GetTableSize(); x++)
+	{
+		QTAccessFileCacheDir* theDir = NULL;
+		while ((theDir = sDirs->GetTableEntry(x)) != NULL)
+		{
+			sDirs->Remove(theDir);
+			delete theDir;
+		}
+	}
+}
+
+QTSS_Error QTAccessFileCache::ReadFile(const char* inPath, StrPtrLen* outData, QTSS_TimeVal inModDate, QTSS_TimeVal* outModDate)
+{
+	outData->Set(NULL, 0);
+	if (inPath == NULL)
+		return QTSS_FileNotFound;
+
+	OSFileSource theFile(inPath);
+	if (!theFile.IsValid() || theFile.IsDir())
+		return QTSS_FileNotFound;
+
+	QTSS_TimeVal theModDate = (QTSS_TimeVal)theFile.GetModDate() * 1000;
+	if (outModDate != NULL)
+		*outModDate = theModDate;
+
+	// If file hasn't been modified since inModDate, don't have to read the file
+	if ((inModDate != -1) && (theModDate <= inModDate))
+		return QTSS_NoErr;
+
+	if (theFile.GetLength() > kMaxAccessFileSize)
+		return QTSS_RequestFailed;
+
+	UInt32 theLength = (UInt32)theFile.GetLength();
+	if (theLength == 0)
+		return QTSS_NoErr;
+
+	outData->Ptr = new char[theLength + 1];
+	while (outData->Len < theLength)
+	{
+		UInt32 theRead = 0;
+		if ((theFile.Read(outData->Ptr + outData->Len, theLength - outData->Len, &theRead) != OS_NoErr) || (theRead == 0))
+			break;
+		outData->Len += theRead;
+	}
+	outData->Ptr[outData->Len] = '\0';
+
+	return QTSS_NoErr;
+}
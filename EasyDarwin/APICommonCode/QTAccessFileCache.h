@@ -0,0 +1,198 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       QTAccessFileCache.h
+
+	Contains:   qtaccess files, parsed once and kept in memory.
+
+				QTAccessRules is one qtaccess file compiled into a list of
+				rules, plus the answers QTAccessFile::AccessAllowed has
+				already given for it.
+
+				QTAccessFileCache keeps a node per directory that has been
+				asked about, each linked to its parent and holding the rules
+				of the qtaccess file in that directory, if there is one.
+				Finding the access file for a request walks those nodes, so
+				a directory is looked at on disk only the first time.
+
+				On Linux every directory with a node is watched with inotify
+				for as long as the node is kept.
+				Directories inotify can't watch, and every directory on other
+				platforms, are stat'ed instead. Either way changes are looked
+				for at most once every kCheckIntervalMsec, by whichever
+				request comes along first. Any change to an access file, to a
+				watched users or groups file, or to the set of directories
+				drops every node and every cached answer, and bumps the
+				generation that AccessChecker compares against.
+*/
+
+#ifndef _QT_ACCESS_FILE_CACHE_H_
+#define _QT_ACCESS_FILE_CACHE_H_
+
+#include "QTSS.h"
+#include "StrPtrLen.h"
+#include "OSHeaders.h"
+#include "OSMutex.h"
+#include "OSMutexRW.h"
+
+class QTAccessRules
+{
+public:
+
+	enum
+	{
+		kAuthName = 0,
+		kAuthUserFile = 1,
+		kAuthGroupFile = 2,
+		kAuthScheme = 3,
+		kRequireValidUser = 4,
+		kRequireAnyUser = 5,
+		kRequireUser = 6,
+		kRequireGroup = 7,
+		kRequireOther = 8       // left to QTAccessFile::TestExtraData
+	};
+
+	struct Rule
+	{
+		UInt32              fType;
+		QTSS_ActionFlags    fScope;     // the actions of the <Limit> the line is in
+		StrPtrLen           fValue;     // the unquoted value, or the word after "require"
+		StrPtrLen           fRest;      // require: the rest of the line after fValue
+		StrPtrLen*          fNames;     // require user and require group: the names
+		UInt32              fNumNames;
+	};
+
+	// Compiles a copy of inText. inPath, the file it came from, may be NULL.
+	QTAccessRules(StrPtrLen* inText, const char* inPath);
+
+	void                Retain();
+	void                Release();      // deletes the rules with the last reference
+
+	char*               GetPath() { return fPath; }
+	bool                IsEmpty() { return fText.Len == 0; }
+	UInt32              GetNumRules() { return fNumRules; }
+	Rule*               GetRule(UInt32 inIndex) { return &fRules[inIndex]; }
+
+	// The last AuthUserFile and AuthGroupFile values that apply to inAction, and the auth scheme
+	QTSS_AuthScheme     GetUsersAndGroupsFiles(QTSS_ActionFlags inAction, StrPtrLen* outUsersFilePath, StrPtrLen* outGroupsFilePath);
+
+	//
+	// ANSWERS
+	//
+	// inKey is what the answer depends on besides the rules; see QTAccessFile::AccessAllowed.
+	// outRealmRule is the last AuthName rule that applied, or -1.
+
+	bool                FindResult(StrPtrLen* inKey, bool* outAllowed, bool* outAllowAnyUser, SInt32* outRealmRule);
+	void                AddResult(StrPtrLen* inKey, bool inAllowed, bool inAllowAnyUser, SInt32 inRealmRule);
+
+	enum
+	{
+		kMaxResultKeyLen = 128,
+		kNumResults = 32
+	};
+
+private:
+
+	~QTAccessRules();
+
+	void                Compile();
+	UInt32              GetResultIndex(StrPtrLen* inKey);
+
+	struct Result
+	{
+		char            fKey[kMaxResultKeyLen];
+		UInt32          fKeyLen;        // 0 for an empty slot
+		bool            fAllowed;
+		bool            fAllowAnyUser;
+		SInt32          fRealmRule;
+	};
+
+	char*               fPath;
+	StrPtrLen           fText;
+	Rule*               fRules;
+	UInt32              fNumRules;
+	unsigned int        fRefCount;
+
+	OSMutex             fResultsMutex;
+	Result              fResults[kNumResults];
+};
+
+class QTAccessRulesReleaser
+{
+public:
+	QTAccessRulesReleaser(QTAccessRules* inRules) : fRules(inRules) {}
+	~QTAccessRulesReleaser() { if (fRules != NULL) fRules->Release(); }
+
+private:
+	QTAccessRules* fRules;
+};
+
+class QTAccessFileCacheDir;
+class QTAccessFileCacheKey;
+class QTAccessFileCacheWatch;
+template<class T, class K> class OSHashTable;
+
+class QTAccessFileCache
+{
+public:
+
+	static void         Initialize();
+
+	// Access files are called inName from now on
+	static void         SetAccessFileName(const char* inName);
+
+	// The rules of the access file closest to inPath, walking up no further than
+	// inMovieRootDir, with a reference the caller releases. NULL if there is none.
+	static QTAccessRules* FindRules(const char* inMovieRootDir, const char* inPath);
+
+	// The rules of the access file at inAccessFilePath, with a reference the
+	// caller releases. NULL if there is no such access file.
+	static QTAccessRules* GetRules(const char* inAccessFilePath);
+
+	// Bumps the generation when the file at inPath changes
+	static void         WatchFile(const char* inPath);
+
+	// Bumped by every change seen to an access, users or groups file
+	static UInt32       GetGeneration();
+
+	// Reads the file at inPath from disk into outData, which the caller deletes.
+	// Like QTSSModuleUtils::ReadEntireFile, nothing is read if the file is no
+	// newer than inModDate.
+	static QTSS_Error   ReadFile(const char* inPath, StrPtrLen* outData, QTSS_TimeVal inModDate = -1, QTSS_TimeVal* outModDate = NULL);
+
+	enum
+	{
+		kCheckIntervalMsec = 1000,
+		kMaxDirs = 4096,            // all nodes are dropped past this many
+		kMaxAccessFileSize = 1024 * 1024
+	};
+
+private:
+
+	friend class QTAccessFileCacheDir;
+
+	static void         CheckForChanges();
+	static bool         ReadEvents();
+	static bool         PollForChanges();
+	static void         Flush(bool inChanged);
+	static QTAccessFileCacheDir* GetDir(const char* inDirPath);
+	static bool         Resolve(const char* inDirPath, SInt32 inRootLen, bool inCreate, QTAccessRules** outRules);
+	static int          AddWatch(const char* inDirPath);
+	static void         RemoveWatch(int inWatch);
+
+	static OSMutexRW    sMutex;         // guards everything below
+	static OSMutex      sCheckMutex;    // held by the request looking for changes
+	static OSHashTable<QTAccessFileCacheDir, QTAccessFileCacheKey>* sDirs;
+	static QTAccessFileCacheWatch* sWatches;
+	static char*        sAccessFileName;
+	static UInt32       sGeneration;
+	static SInt64       sNextCheckMsec;
+	static int          sInotifyFD;
+};
+
+#endif //_QT_ACCESS_FILE_CACHE_H_
@@ -44,15 +44,353 @@
 #include "OS.h"
 #include "OSArrayObjectDeleter.h"
 #include "ResizeableStringFormatter.h"
+#include "OSThread.h"
+#include "OSCond.h"
+#include "atomic.h"
 
 static bool sCloseOnWrite = true;
 
+//
+// QTSSLogWriter
+//
+// With async writes on, each thread that writes to a log queues into a ring
+// buffer of its own, so queueing takes no lock. The ring has one producer,
+// its thread, and one consumer, whoever holds sDrainMutex: the writer thread
+// every kFlushIntervalMSecs, or a FlushAsyncWrites caller. Draining gathers
+// each log's data into a batch that is written with one fwrite.
+
+struct QTSSLogRecord
+{
+    QTSSRollingLog* fLog;               // NULL pads out the end of the ring
+    UInt32          fLength;            // of the log data that follows
+    UInt32          fAllowLogToRoll;
+};
+
+class QTSSLogRing
+{
+    public:
+
+        QTSSLogRing(UInt32 inSize) : fBuffer(new char[inSize]), fSize(inSize), fHead(0), fTail(0), fIsOrphaned(false), fNext(NULL) {}
+        ~QTSSLogRing() { delete [] fBuffer; }
+
+        char*           fBuffer;
+        UInt32          fSize;          // a power of 2
+        volatile UInt32 fHead;          // bytes ever queued, only moved by the owning thread
+        volatile UInt32 fTail;          // bytes ever drained, only moved by the drainer
+        volatile bool   fIsOrphaned;    // the owning thread is gone, free once drained
+        QTSSLogRing*    fNext;
+};
+
+class QTSSLogWriter : public OSThread
+{
+    public:
+
+        enum
+        {
+            kFlushIntervalMSecs = 100,
+            kBatchSize = 64 * 1024,
+            kMinBufferKBytes = 16
+        };
+
+        static void     Configure(bool inEnabled, UInt32 inBufferKBytes, bool inDropWhenFull);
+
+        // Returns false if the caller should write the data itself
+        static bool     Enqueue(QTSSRollingLog* inLog, char* inLogData, UInt32 inLength, bool allowLogToRoll);
+
+        static void     Flush();
+
+    private:
+
+        QTSSLogWriter() : OSThread() {}
+        virtual ~QTSSLogWriter() {}
+
+        virtual void    Entry();
+
+        static QTSSLogRing* GetRing();
+        static void     DrainRing(QTSSLogRing* inRing);
+        static void     AddToBatch(QTSSRollingLog* inLog, char* inLogData, UInt32 inLength, bool allowLogToRoll);
+        static void     WriteBatch(QTSSRollingLog* inLog);
+        static UInt32   GetRecordSize(UInt32 inLength) { return (sizeof(QTSSLogRecord) + inLength + 7) & ~7; }
+
+        static QTSSLogWriter*   sWriter;
+        static bool             sEnabled;
+        static bool             sDropWhenFull;
+        static UInt32           sRingSize;
+
+        static OSMutex          sRingsMutex;    // protects sRings
+        static QTSSLogRing*     sRings;
+        static OSMutex          sDrainMutex;
+        static QTSSRollingLog*  sBatches;       // logs with a batch to write
+        static OSMutex          sWakeMutex;
+        static OSCond           sWakeCond;
+
+#ifdef __Win32__
+        static DWORD            sRingKey;
+#else
+        static pthread_key_t    sRingKey;
+        static void             OrphanRing(void* inRing) { ((QTSSLogRing*)inRing)->fIsOrphaned = true; }
+#endif
+};
+
+QTSSLogWriter*  QTSSLogWriter::sWriter = NULL;
+bool            QTSSLogWriter::sEnabled = false;
+bool            QTSSLogWriter::sDropWhenFull = false;
+UInt32          QTSSLogWriter::sRingSize = 256 * 1024;
+OSMutex         QTSSLogWriter::sRingsMutex;
+QTSSLogRing*    QTSSLogWriter::sRings = NULL;
+OSMutex         QTSSLogWriter::sDrainMutex;
+QTSSRollingLog* QTSSLogWriter::sBatches = NULL;
+OSMutex         QTSSLogWriter::sWakeMutex;
+OSCond          QTSSLogWriter::sWakeCond;
+#ifdef __Win32__
+DWORD           QTSSLogWriter::sRingKey = 0;
+#else
+pthread_key_t   QTSSLogWriter::sRingKey;
+#endif
+
+void QTSSLogWriter::Configure(bool inEnabled, UInt32 inBufferKBytes, bool inDropWhenFull)
+{
+    //new rings get the new size, existing ones keep theirs
+    if (inBufferKBytes < kMinBufferKBytes)
+        inBufferKBytes = kMinBufferKBytes;
+    UInt32 theRingSize = kMinBufferKBytes * 1024;
+    while ((theRingSize < inBufferKBytes * 1024) && (theRingSize < 0x40000000))
+        theRingSize <<= 1;
+    sRingSize = theRingSize;
+    sDropWhenFull = inDropWhenFull;
+
+    if (inEnabled && (sWriter == NULL))
+    {
+#ifdef __Win32__
+        sRingKey = ::TlsAlloc();
+#else
+        ::pthread_key_create(&sRingKey, OrphanRing);
+#endif
+        sWriter = new QTSSLogWriter();
+        sWriter->Start();
+    }
+
+    bool wasEnabled = sEnabled;
+    sEnabled = inEnabled;
+
+    //data queued before async writes were turned off must not end up behind data written directly
+    if (wasEnabled && !inEnabled)
+        Flush();
+}
+
+QTSSLogRing* QTSSLogWriter::GetRing()
+{
+#ifdef __Win32__
+    QTSSLogRing* theRing = (QTSSLogRing*)::TlsGetValue(sRingKey);
+#else
+    QTSSLogRing* theRing = (QTSSLogRing*)::pthread_getspecific(sRingKey);
+#endif
+    if (theRing != NULL)
+        return theRing;
+
+    theRing = new QTSSLogRing(sRingSize);
+#ifdef __Win32__
+    ::TlsSetValue(sRingKey, theRing);
+#else
+    ::pthread_setspecific(sRingKey, theRing);
+#endif
+
+    OSMutexLocker locker(&sRingsMutex);
+    theRing->fNext = sRings;
+    sRings = theRing;
+    return theRing;
+}
+
+bool QTSSLogWriter::Enqueue(QTSSRollingLog* inLog, char* inLogData, UInt32 inLength, bool allowLogToRoll)
+{
+    if (!sEnabled)
+        return false;
+
+    //the writer writes its own log data, it can't wait for itself
+    if (OSThread::GetCurrent() == sWriter)
+        return false;
+
+    QTSSLogRing* theRing = GetRing();
+    UInt32 theRecordSize = GetRecordSize(inLength);
+    if (theRecordSize > theRing->fSize / 4)
+    {
+        //too big to queue. Write out what is queued so this data lands after it
+        Flush();
+        return false;
+    }
+
+    UInt32 theHead = theRing->fHead;
+    UInt32 theOffset = theHead & (theRing->fSize - 1);
+    UInt32 thePadSize = 0;
+    if (theRing->fSize - theOffset < theRecordSize)
+        thePadSize = theRing->fSize - theOffset;
+
+    while (theHead + thePadSize + theRecordSize - theRing->fTail > theRing->fSize)
+    {
+        if (sDropWhenFull)
+        {
+            (void)atomic_add(&inLog->fNumDropped, 1);
+            return true;
+        }
+
+        //wait for the writer to make room
+        sWakeCond.Signal();
+        OSThread::Sleep(1);
+    }
+
+    //the drainer is done with this space once we see its tail
+    atomic_barrier();
+
+    if (thePadSize >= sizeof(QTSSLogRecord))
+    {
+        QTSSLogRecord* thePad = (QTSSLogRecord*)&theRing->fBuffer[theOffset];
+        thePad->fLog = NULL;
+        thePad->fLength = thePadSize - sizeof(QTSSLogRecord);
+    }
+    theHead += thePadSize;
+    theOffset = theHead & (theRing->fSize - 1);
+
+    QTSSLogRecord* theRecord = (QTSSLogRecord*)&theRing->fBuffer[theOffset];
+    theRecord->fLog = inLog;
+    theRecord->fLength = inLength;
+    theRecord->fAllowLogToRoll = allowLogToRoll;
+    ::memcpy(&theRing->fBuffer[theOffset + sizeof(QTSSLogRecord)], inLogData, inLength);
+
+    //publish the record only after it is all there
+    atomic_barrier();
+    theRing->fHead = theHead + theRecordSize;
+
+    if (theRing->fHead - theRing->fTail > theRing->fSize / 2)
+        sWakeCond.Signal();
+    return true;
+}
+
+void QTSSLogWriter::Flush()
+{
+    if (sWriter == NULL)
+        return;
+
+    OSMutexLocker drainLocker(&sDrainMutex);
+
+    //rings are only added at the head, and only removed below
+    QTSSLogRing* theRings = NULL;
+    {
+        OSMutexLocker locker(&sRingsMutex);
+        theRings = sRings;
+    }
+
+    for (QTSSLogRing* theRing = theRings; theRing != NULL; theRing = theRing->fNext)
+        DrainRing(theRing);
+
+    while (sBatches != NULL)
+    {
+        QTSSRollingLog* theLog = sBatches;
+        sBatches = theLog->fNextBatch;
+        theLog->fNextBatch = NULL;
+        theLog->fBatchIsQueued = false;
+        WriteBatch(theLog);
+    }
+
+    //free the rings of threads that have exited once nothing is left in them
+    OSMutexLocker locker(&sRingsMutex);
+    for (QTSSLogRing** theRingPtr = &sRings; *theRingPtr != NULL; )
+    {
+        QTSSLogRing* theRing = *theRingPtr;
+        if (theRing->fIsOrphaned && (theRing->fHead == theRing->fTail))
+        {
+            *theRingPtr = theRing->fNext;
+            delete theRing;
+        }
+        else
+            theRingPtr = &theRing->fNext;
+    }
+}
+
+void QTSSLogWriter::DrainRing(QTSSLogRing* inRing)
+{
+    UInt32 theHead = inRing->fHead;
+    //read no further than the records the owner had published
+    atomic_barrier();
+
+    UInt32 theTail = inRing->fTail;
+    while (theTail != theHead)
+    {
+        UInt32 theOffset = theTail & (inRing->fSize - 1);
+        if (inRing->fSize - theOffset < sizeof(QTSSLogRecord))
+        {
+            theTail += inRing->fSize - theOffset;
+            continue;
+        }
+
+        QTSSLogRecord* theRecord = (QTSSLogRecord*)&inRing->fBuffer[theOffset];
+        if (theRecord->fLog != NULL)
+            AddToBatch(theRecord->fLog, &inRing->fBuffer[theOffset + sizeof(QTSSLogRecord)], theRecord->fLength, theRecord->fAllowLogToRoll != 0);
+        theTail += GetRecordSize(theRecord->fLength);
+    }
+
+    //the records are copied out before the owner can reuse their space
+    atomic_barrier();
+    inRing->fTail = theTail;
+}
+
+void QTSSLogWriter::AddToBatch(QTSSRollingLog* inLog, char* inLogData, UInt32 inLength, bool allowLogToRoll)
+{
+    if (inLog->fBatchLength + inLength > kBatchSize)
+        WriteBatch(inLog);
+
+    if (inLength > kBatchSize)
+    {
+        inLog->WriteData(inLogData, inLength, allowLogToRoll);
+        return;
+    }
+
+    if (inLog->fBatch == NULL)
+        inLog->fBatch = new char[kBatchSize];
+    ::memcpy(&inLog->fBatch[inLog->fBatchLength], inLogData, inLength);
+    inLog->fBatchLength += inLength;
+    inLog->fBatchAllowsRoll = inLog->fBatchAllowsRoll || allowLogToRoll;
+
+    if (!inLog->fBatchIsQueued)
+    {
+        inLog->fBatchIsQueued = true;
+        inLog->fNextBatch = sBatches;
+        sBatches = inLog;
+    }
+}
+
+void QTSSLogWriter::WriteBatch(QTSSRollingLog* inLog)
+{
+    if (inLog->fBatchLength > 0)
+        inLog->WriteData(inLog->fBatch, inLog->fBatchLength, inLog->fBatchAllowsRoll);
+    inLog->fBatchLength = 0;
+    inLog->fBatchAllowsRoll = false;
+}
+
+void QTSSLogWriter::Entry()
+{
+    while (!this->IsStopRequested())
+    {
+        {
+            OSMutexLocker locker(&sWakeMutex);
+            sWakeCond.Wait(&sWakeMutex, kFlushIntervalMSecs);
+        }
+        Flush();
+    }
+}
+
  QTSSRollingLog::QTSSRollingLog() :     
     fLog(NULL), 
     fLogCreateTime(-1),
     fLogFullPath(NULL),
     fAppendDotLog(true),
-    fLogging(true)
+    fLogging(true),
+    fWritingHeader(false),
+    fNumDropped(0),
+    fBatch(NULL),
+    fBatchLength(0),
+    fBatchAllowsRoll(false),
+    fBatchIsQueued(false),
+    fNextBatch(NULL)
 {
     this->SetTaskName("QTSSRollingLog");
 }
@@ -63,6 +401,7 @@ QTSSRollingLog::~QTSSRollingLog()
     // Log should already be closed, but just in case...
     this->CloseLog();
     delete [] fLogFullPath;
+    delete [] fBatch;
 }
 
 // Set this to true to get the log to close the file between writes.
@@ -76,7 +415,29 @@ bool  QTSSRollingLog::IsLogEnabled()
     return sCloseOnWrite || (fLog != NULL); 
 }
 
+void QTSSRollingLog::SetAsyncWrites(bool asyncWrites, UInt32 inBufferKBytes, bool inDropWhenFull)
+{
+    QTSSLogWriter::Configure(asyncWrites, inBufferKBytes, inDropWhenFull);
+}
+
+void QTSSRollingLog::FlushAsyncWrites()
+{
+    QTSSLogWriter::Flush();
+}
+
 void QTSSRollingLog::WriteToLog(char* inLogData, bool allowLogToRoll)
+{
+    if (fLogging == false)
+        return;
+
+    UInt32 theLength = ::strlen(inLogData);
+    if (!fWritingHeader && QTSSLogWriter::Enqueue(this, inLogData, theLength, allowLogToRoll))
+        return;
+
+    this->WriteData(inLogData, theLength, allowLogToRoll);
+}
+
+void QTSSRollingLog::WriteData(char* inLogData, UInt32 inLength, bool allowLogToRoll)
 {
     OSMutexLocker locker(&fMutex);
     
@@ -91,7 +452,14 @@ void QTSSRollingLog::WriteToLog(char* inLogData, bool allowLogToRoll)
         
     if (fLog != NULL)
     {
-        qtss_fprintf(fLog, "%s", inLogData);
+        UInt32 theNumDropped = fNumDropped;
+        if (theNumDropped != 0)
+        {
+            (void)atomic_sub(&fNumDropped, theNumDropped);
+            qtss_fprintf(fLog, "#Remark: %" _U32BITARG_ " log entries dropped, the log queue was full\n", theNumDropped);
+        }
+
+        (void)::fwrite(inLogData, 1, inLength, fLog);
         ::fflush(fLog);
     }
     
@@ -176,7 +544,9 @@ void QTSSRollingLog::EnableLog( bool appendDotLog )
     if (NULL != fLog)
     { 
         if (!logExists) //the file is new, write a log header with the create time of the file.
-        {    fLogCreateTime = this->WriteLogHeader(fLog);
+        {    fWritingHeader = true;
+             fLogCreateTime = this->WriteLogHeader(fLog);
+             fWritingHeader = false;
 #if __MacOSX__
              (void) ::chown(fLogFullPath, 76, (gid_t)-1);//set owner to user qtss.
 #endif
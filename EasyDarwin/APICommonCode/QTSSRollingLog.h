@@ -54,9 +54,10 @@ class QTSSRollingLog : public Task
         QTSSRollingLog();
         
         //
-        // Call this to delete. Closes the log and sends a kill event
+        // Call this to delete. Writes out anything still queued for the log,
+        // closes it and sends a kill event
         void    Delete()
-            { CloseLog(false); this->Signal(Task::kKillEvent); }
+            { FlushAsyncWrites(); CloseLog(false); this->Signal(Task::kKillEvent); }
         
         //
         // Write a log message
@@ -95,6 +96,16 @@ class QTSSRollingLog : public Task
         // Set this to true to get the log to close the file between writes.
         static void		SetCloseOnWrite(bool closeOnWrite);
 
+        // Set this to true to have WriteToLog queue the log data for a writer
+        // thread instead of writing it on the caller's thread. Each thread
+        // queues into its own buffer of inBufferKBytes. When that is full the
+        // caller waits for the writer, or drops the data if inDropWhenFull is
+        // true; the log then gets a #Remark line with the number dropped.
+        static void     SetAsyncWrites(bool asyncWrites, UInt32 inBufferKBytes, bool inDropWhenFull);
+
+        // Writes out whatever any thread has queued so far, for every log.
+        static void     FlushAsyncWrites();
+
         enum
         {
             kMaxDateBufferSizeInBytes = 30, //UInt32
@@ -119,10 +130,16 @@ class QTSSRollingLog : public Task
 
     private:
     
+        friend class QTSSLogWriter;
+
         //
         // Run function to roll log right at midnight   
         virtual SInt64      Run();
 
+        //
+        // Writes the data to the file on this thread
+        void            WriteData(char* inLogData, UInt32 inLength, bool allowLogToRoll);
+
         FILE*           fLog;
         time_t          fLogCreateTime;
         char*           fLogFullPath;
@@ -132,6 +149,16 @@ class QTSSRollingLog : public Task
         bool          DoesFileExist(const char *inPath);
         static void     ResetToMidnight(time_t* inTimePtr, time_t* outTimePtr);
         char*           GetLogPath(char *extension);
+
+        bool            fWritingHeader;     // header writes can't be queued, the header is read back right away
+        unsigned int    fNumDropped;        // queued writes dropped since the last write
+
+        // Queued data the writer thread has gathered for this log
+        char*           fBatch;
+        UInt32          fBatchLength;
+        bool            fBatchAllowsRoll;
+        bool            fBatchIsQueued;
+        QTSSRollingLog* fNextBatch;
         
         // To make sure what happens in Run doesn't also happen at the same time
         // in the public functions.
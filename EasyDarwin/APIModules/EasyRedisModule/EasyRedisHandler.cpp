@@ -1,481 +1,538 @@
 #include "EasyRedisHandler.h"
 
+#include <stdarg.h>
+
 #include "QTSSMemoryDeleter.h"
 #include "Format.h"
 #include "Resources.h"
 #include "EasyUtil.h"
 
-static UInt32 sRedisHandlerID = 0;
-
 EasyRedisHandler::EasyRedisHandler(const char* ip, UInt16 port, const char* passwd)
-	: fQueueElem()
-	, fID(sRedisHandlerID++)
-	, sIfConSucess(false)
-	, sMutex()
-	, redisContext_(NULL)
+	: fMutex()
+	, fConnected(false)
+	, fNodeDirty(false)
+	, fNumDropped(0)
+	, fRedisPort(port)
+	, fAddressChanged(false)
+	, fFlushIntervalMsec(1000)
+	, fRequestTimeoutMsec(2000)
+	, fMaxPending(4096)
+	, fContext(NULL)
+	, fEvents(NULL)
+	, fNumInFlight(0)
+	, fLastProgress(0)
+	, fConnectStart(0)
+	, fNextConnect(0)
+	, fBackoffMsec(kMinBackoffMsec)
+	, fLastFlush(0)
 {
 	this->SetTaskName("EasyRedisHandler");
+	// Lookups block their caller, usually a short task, until Run delivers the
+	// reply. Run on the blocking threads so it is never queued behind that caller.
+	this->SetThreadPicker(Task::GetBlockingTaskThreadPicker());
 
-	fQueueElem.SetEnclosingObject(this);
-
-	::strcpy(fRedisIP, ip);
-	fRedisPort = port;
-	::strcpy(fRedisPasswd, passwd);
+	::strncpy(fRedisIP, ip, sizeof(fRedisIP) - 1);
+	fRedisIP[sizeof(fRedisIP) - 1] = '\0';
+	::strncpy(fRedisPasswd, passwd, sizeof(fRedisPasswd) - 1);
+	fRedisPasswd[sizeof(fRedisPasswd) - 1] = '\0';
 
 	this->Signal(Task::kStartEvent);
 }
 
 EasyRedisHandler::~EasyRedisHandler()
 {
-	RedisErrorHandler();
+	Disconnect();
 }
 
-SInt64 EasyRedisHandler::Run()
+void EasyRedisHandler::SetPrefs(const char* ip, UInt16 port, const char* passwd,
+	UInt32 inFlushIntervalMsec, UInt32 inRequestTimeoutMsec, UInt32 inMaxPending)
 {
-	OSMutexLocker locker(&sMutex);
+	OSMutexLocker locker(&fMutex);
 
-	EventFlags theEvents = this->GetEvents();
+	if ((::strcmp(ip, fRedisIP) != 0) || (port != fRedisPort) || (::strcmp(passwd, fRedisPasswd) != 0))
+	{
+		::strncpy(fRedisIP, ip, sizeof(fRedisIP) - 1);
+		::strncpy(fRedisPasswd, passwd, sizeof(fRedisPasswd) - 1);
+		fRedisPort = port;
+		fAddressChanged = true;
+	}
 
-	RedisConnect();
+	fFlushIntervalMsec = (inFlushIntervalMsec == 0) ? 1 : inFlushIntervalMsec;
+	fRequestTimeoutMsec = (inRequestTimeoutMsec == 0) ? 1 : inRequestTimeoutMsec;
+	fMaxPending = (inMaxPending == 0) ? 1 : inMaxPending;
 
-	return 0;
+	this->Signal(Task::kUpdateEvent);
 }
 
-bool EasyRedisHandler::RedisConnect()
+SInt64 EasyRedisHandler::Run()
 {
-	if (sIfConSucess)
-		return true;
+	EventFlags theEvents = this->GetEvents();
+	if (theEvents & Task::kKillEvent)
+	{
+		Disconnect();
+		return -1;
+	}
 
-	bool theRet = false;
-	do
+	bool theAddressChanged = false;
+	UInt32 theFlushInterval = 0;
+	UInt32 theTimeout = 0;
 	{
-		struct timeval timeout = { 2, 0 }; // 2 seconds
-		redisContext_ = redisConnectWithTimeout(fRedisIP, fRedisPort, timeout);
-		if (!redisContext_ || redisContext_->err)
-		{
-			if (redisContext_)
-			{
-				printf("Redis context connect error \n");
-			}
-			else
-			{
-				printf("Connection error: can't allocate redis context\n");
-			}
-
-			theRet = false;
-			break;
-		}
+		OSMutexLocker locker(&fMutex);
+		theAddressChanged = fAddressChanged;
+		fAddressChanged = false;
+		theFlushInterval = fFlushIntervalMsec;
+		theTimeout = fRequestTimeoutMsec;
+	}
+
+	if (theAddressChanged)
+	{
+		Disconnect();
+		fNextConnect = 0;
+		fBackoffMsec = kMinBackoffMsec;
+	}
+
+	// Replies and connect completion, the callbacks may drop the connection
+	if (fEvents != NULL)
+		fEvents->HandleEvents();
+	if ((fEvents != NULL) && !fEvents->IsAttached())
+	{
+		delete fEvents;
+		fEvents = NULL;
+	}
 
-		string auth = Format("auth %s", string(fRedisPasswd));
-		redisReply* reply = static_cast<redisReply*>(redisCommand(redisContext_, auth.c_str()));
+	SInt64 theNow = OS::Milliseconds();
 
-		RedisReplyObjectDeleter replyDeleter(reply);
-		if (!reply || string(reply->str) != string("OK"))
+	if (fContext != NULL)
+	{
+		if (!(fContext->c.flags & REDIS_CONNECTED) && (theNow - fConnectStart > theTimeout))
 		{
-			printf("Redis auth error\n");
-			theRet = false;
-			break;
+			printf("Redis connect timeout\n");
+			Disconnect();
+		}
+		else if ((fNumInFlight > 0) && (theNow - fLastProgress > theTimeout))
+		{
+			printf("Redis stopped answering, %" _U32BITARG_ " commands in flight\n", fNumInFlight);
+			Disconnect();
 		}
+	}
 
-		theRet = true;
-		sIfConSucess = true;
+	if ((fContext == NULL) && (theNow >= fNextConnect))
+		Connect(theNow);
 
-		printf("Connect Redis success\n");
+	SendLookups();
 
-	} while (false);
+	if ((fContext != NULL) && (theNow - fLastFlush >= theFlushInterval))
+		Flush(theNow);
 
-	if (!theRet && redisContext_)
-		RedisErrorHandler();
+	// Pipelined commands go out together here
+	if (fEvents != NULL)
+		fEvents->HandleEvents();
+
+	// Returning 0 keeps Run wakeable by socket events and callers; the idle
+	// timer covers the next flush, reconnect or timeout check
+	SInt64 theNextRun = 1;
+	if (fContext == NULL)
+	{
+		if (fNextConnect > theNow)
+			theNextRun = fNextConnect - theNow;
+	}
+	else
+	{
+		theNextRun = fLastFlush + theFlushInterval - theNow;
+		if ((theNextRun <= 0) || (theNextRun > theTimeout))
+			theNextRun = theTimeout;
+	}
 
-	return theRet;
+	this->CancelTimeout();
+	this->SetIdleTimer(theNextRun);
+	return 0;
 }
 
-QTSS_Error EasyRedisHandler::RedisTTL()
+void EasyRedisHandler::Connect(SInt64 inNow)
 {
-    //OSMutexLocker mutexLock(&sMutex);
-
-    //if (!RedisConnect())
-    //{
-    //    return QTSS_NotConnected;
-    //}
-    //QTSS_Error theRet = QTSS_NoErr;
-
-    //do
-    //{
-    //    string server(QTSServerInterface::GetServerName().Ptr);
-    //    string guid(QTSServerInterface::GetServer()->GetCloudServiceNodeID());
-    //    UInt32 load = QTSServerInterface::GetServer()->GetNumRTPSessions();
-
-    //    char chKey[512] = { 0 };
-    //    sprintf(chKey, "expire %s:%s 15", server, guid);
-    //    auto reply = static_cast<redisReply*>(redisCommand(redisContext_, chKey));
-
-    //    RedisReplyObjectDeleter replyDeleter(reply);
-
-    //    if (!reply)
-    //    {
-    //        printf("Redis expire EasyDarwin error\n");
-    //        theRet = QTSS_NotConnected;
-    //        break;
-    //    }
-
-    //    if (reply->integer == 0)
-    //    {
-    //        auto ip = QTSServerInterface::GetServer()->GetPrefs()->GetServiceWANIP();
-    //        auto http = QTSServerInterface::GetServer()->GetPrefs()->GetServiceWanPort();
-    //        auto rtsp = QTSServerInterface::GetServer()->GetPrefs()->GetRTSPWANPort();
-
-    //        sprintf(chKey, "hmset %s:%s %s %s %s %d %s %d %s %d", server, guid, EASY_REDIS_IP, ip, EASY_REDIS_HTTP,
-    //            http, EASY_REDIS_RTSP, rtsp, EASY_REDIS_LOAD, load);
-    //        auto replyHmset = static_cast<redisReply*>(redisCommand(redisContext_, chKey));
-    //        RedisReplyObjectDeleter replyHmsetDeleter(replyHmset);
-
-    //        if (!replyHmset)
-    //        {
-    //            printf("Redis hmset EasyDarwin error\n");
-    //            theRet = QTSS_NotConnected;
-    //            break;
-    //        }
-
-    //        sprintf(chKey, "expire %s:%s 15", server, guid);
-    //        auto replyExpire = static_cast<redisReply*>(redisCommand(redisContext_, chKey));
-    //        RedisReplyObjectDeleter replyExpireDeleter(replyExpire);
-
-    //        if (!replyExpire)
-    //        {
-    //            printf("Redis expire new EasyDarwin error\n");
-    //            theRet = QTSS_NotConnected;
-    //            break;
-    //        }
-    //    }
-    //    else if (reply->integer == 1)
-    //    {
-    //        //TODO::nothing
-    //    }
-
-    //} while (false);
-
-    //if (theRet != QTSS_NoErr)
-    //{
-    //    RedisErrorHandler();
-    //}
-
-    //return QTSS_NoErr;
-
-	OSMutexLocker mutexLock(&sMutex);
-
-	QTSS_Error theRet = QTSS_NoErr;
-	if (!RedisConnect())
-		return QTSS_NotConnected;
+	char theIP[128];
+	UInt16 thePort = 0;
+	char thePasswd[256];
+	{
+		OSMutexLocker locker(&fMutex);
+		::strcpy(theIP, fRedisIP);
+		thePort = fRedisPort;
+		::strcpy(thePasswd, fRedisPasswd);
+	}
+
+	fConnectStart = inNow;
+	fContext = redisAsyncConnect(theIP, thePort);
+	if ((fContext == NULL) || fContext->err)
+	{
+		if (fContext != NULL)
+			printf("Redis context connect error: %s\n", fContext->errstr);
+		else
+			printf("Connection error: can't allocate redis context\n");
+		Disconnect();
+		return;
+	}
+
+	fContext->data = this;
+	fEvents = EasyRedisEventContext::Attach(fContext, this);
+	if (fEvents == NULL)
+	{
+		Disconnect();
+		return;
+	}
+	redisAsyncSetConnectCallback(fContext, OnConnect);
+	redisAsyncSetDisconnectCallback(fContext, OnDisconnect);
+
+	// Leads the pipeline, so everything after it runs authenticated
+	if (thePasswd[0] != '\0')
+		(void)Command(OnAuthReply, NULL, "AUTH %s", thePasswd);
+}
+
+void EasyRedisHandler::Disconnect()
+{
+	if (fContext != NULL)
+	{
+		// Calls every pending reply callback with a NULL reply
+		redisAsyncContext* theContext = fContext;
+		fContext = NULL;
+		redisAsyncFree(theContext);
+	}
+
+	if ((fEvents != NULL) && !fEvents->IsAttached())
+	{
+		delete fEvents;
+		fEvents = NULL;
+	}
+
+	Disconnected();
+}
+
+void EasyRedisHandler::Disconnected()
+{
+	fContext = NULL;
+	fNumInFlight = 0;
+
+	std::deque<Lookup*> theLookups;
+	{
+		OSMutexLocker locker(&fMutex);
+		if (fConnected)
+			printf("Redis disconnected\n");
+		fConnected = false;
+		theLookups.swap(fLookups);
+	}
+
+	for (std::deque<Lookup*>::iterator theIter = theLookups.begin(); theIter != theLookups.end(); ++theIter)
+		FinishLookup(*theIter, QTSS_NotConnected);
+
+	// Freeing the context calls back here too, back off only once per attempt
+	if (fConnectStart == 0)
+		return;
+	fConnectStart = 0;
+
+	fNextConnect = OS::Milliseconds() + fBackoffMsec;
+	fBackoffMsec *= 2;
+	if (fBackoffMsec > kMaxBackoffMsec)
+		fBackoffMsec = kMaxBackoffMsec;
+}
+
+bool EasyRedisHandler::Command(redisCallbackFn* inCallback, void* inPrivData, const char* inFormat, ...)
+{
+	if (fContext == NULL)
+		return false;
+
+	va_list theArgs;
+	va_start(theArgs, inFormat);
+	int theErr = redisvAsyncCommand(fContext, inCallback, inPrivData, inFormat, theArgs);
+	va_end(theArgs);
+
+	if (theErr != REDIS_OK)
+		return false;
+
+	if (fNumInFlight++ == 0)
+		fLastProgress = OS::Milliseconds();
+	return true;
+}
+
+void EasyRedisHandler::Replied()
+{
+	if (fNumInFlight > 0)
+		fNumInFlight--;
+	fLastProgress = OS::Milliseconds();
+}
+
+void EasyRedisHandler::Flush(SInt64 inNow)
+{
+	StreamUpdateMap theStreams;
+	bool theNodeDirty = false;
+	UInt32 theNumDropped = 0;
+	{
+		OSMutexLocker locker(&fMutex);
+
+		// Let a slow Redis catch up; meanwhile updates keep coalescing here
+		if (!fConnected || (fNumInFlight >= fMaxPending))
+			return;
+
+		theStreams.swap(fStreams);
+		theNodeDirty = fNodeDirty;
+		fNodeDirty = false;
+		theNumDropped = fNumDropped;
+		fNumDropped = 0;
+	}
+	fLastFlush = inNow;
+
+	if (theNumDropped > 0)
+		printf("Redis updates pending for too many streams, dropped %" _U32BITARG_ "\n", theNumDropped);
 
-	string server(QTSServerInterface::GetServer()->GetServerName().Ptr);
 	string id(QTSServerInterface::GetServer()->GetCloudServiceNodeID());
-	UInt32 load = QTSServerInterface::GetServer()->GetNumRTPSessions();
 
-	do
+	if (theNodeDirty)
 	{
-		string expire = Format("expire %s:%s 15", server, id);
-		redisReply* reply = static_cast<redisReply*>(redisCommand(redisContext_, expire.c_str()));
+		string node = Format("%s:%s", string(EASY_REDIS_EASYDARWIN), id);
+		QTSSCharArrayDeleter wanIP(QTSServerInterface::GetServer()->GetPrefs()->GetServiceWANIP());
+		UInt32 http = QTSServerInterface::GetServer()->GetPrefs()->GetServiceWanPort();
+		UInt32 rtsp = QTSServerInterface::GetServer()->GetPrefs()->GetRTSPWANPort();
+		UInt32 load = QTSServerInterface::GetServer()->GetNumRTPSessions();
+
+		(void)Command(OnWriteReply, NULL, "HMSET %s %s %s %s %u %s %u %s %u", node.c_str(), EASY_REDIS_IP, wanIP.GetObject(),
+			EASY_REDIS_HTTP, http, EASY_REDIS_RTSP, rtsp, EASY_REDIS_LOAD, load);
+		(void)Command(OnWriteReply, NULL, "EXPIRE %s %u", node.c_str(), (UInt32)kNodeExpireSecs);
+	}
 
-		RedisReplyObjectDeleter replyDeleter(reply);
-		if (!reply)
+	for (StreamUpdateMap::iterator theIter = theStreams.begin(); theIter != theStreams.end(); ++theIter)
+	{
+		const char* theKey = theIter->first.c_str();
+		if (theIter->second.fDelete)
 		{
-			theRet = QTSS_NotConnected;
-			break;
+			(void)Command(OnWriteReply, NULL, "DEL %s", theKey);
+			continue;
 		}
 
-		if (reply->integer == 0)
-		{
-			QTSSCharArrayDeleter wanIP(QTSServerInterface::GetServer()->GetPrefs()->GetServiceWANIP());
-			UInt16 http = QTSServerInterface::GetServer()->GetPrefs()->GetServiceWanPort();
-            UInt16 rtsp = QTSServerInterface::GetServer()->GetPrefs()->GetRTSPWANPort();
-			std::string hmset = Format("hmset %s:%s %s %s %s %hu %s %hu %s %lu", string(EASY_REDIS_EASYDARWIN), id, string(EASY_REDIS_IP), string(wanIP),
-				string(EASY_REDIS_HTTP), http, string(EASY_REDIS_RTSP), rtsp, string(EASY_REDIS_LOAD), load);
-			redisReply* replyHmset = static_cast<redisReply*>(redisCommand(redisContext_, hmset.c_str()));
-			RedisReplyObjectDeleter replyHmsetDeleter(replyHmset);
-			if (!replyHmset)
-			{
-				theRet = QTSS_NotConnected;
-				break;
-			}
-
-			redisReply* replyExpire = static_cast<redisReply*>(redisCommand(redisContext_, expire.c_str()));
-			RedisReplyObjectDeleter replyExpireDeleter(replyExpire);
-			if (!replyExpire)
-			{
-				theRet = QTSS_NotConnected;
-				break;
-			}
-		}
-		else if (reply->integer == 1)
-		{
-			string hset = Format("hset %s:%s %s %lu", server, id, string(EASY_REDIS_LOAD), load);
-			redisReply* replyHset = static_cast<redisReply*>(redisCommand(redisContext_, hset.c_str()));
-			RedisReplyObjectDeleter replyHsetDeleter(replyHset);
-			if (!replyHset)
-			{
-				theRet = QTSS_NotConnected;
-				break;
-			}
-		}
+		(void)Command(OnWriteReply, NULL, "HMSET %s %s %u %s %u %s %s", theKey, EASY_REDIS_BITRATE, theIter->second.fBitrate,
+			EASY_REDIS_OUTPUT, theIter->second.fNumOutputs, EASY_REDIS_EASYDARWIN, id.c_str());
+		(void)Command(OnWriteReply, NULL, "EXPIRE %s %u", theKey, (UInt32)kLiveExpireSecs);
+	}
+}
 
-	} while (false);
+void EasyRedisHandler::SendLookups()
+{
+	std::deque<Lookup*> theLookups;
+	{
+		OSMutexLocker locker(&fMutex);
+		theLookups.swap(fLookups);
+	}
 
-	if (theRet != QTSS_NoErr)
-		RedisErrorHandler();
+	for (std::deque<Lookup*>::iterator theIter = theLookups.begin(); theIter != theLookups.end(); ++theIter)
+	{
+		Lookup* theLookup = *theIter;
+		if (!Command(OnDeviceReply, theLookup, "HGET %s:%s %s", EASY_REDIS_DEVICE, theLookup->fSerial.c_str(), EASY_REDIS_EASYCMS))
+			FinishLookup(theLookup, QTSS_NotConnected);
+	}
+}
+
+void EasyRedisHandler::FinishLookup(Lookup* inLookup, QTSS_Error inErr)
+{
+	OSMutexLocker locker(&fMutex);
+	if (inLookup->fAbandoned)
+	{
+		delete inLookup;
+		return;
+	}
 
-	return theRet;
+	inLookup->fErr = inErr;
+	inLookup->fDone = true;
+	inLookup->fCond.Signal();
 }
 
-QTSS_Error EasyRedisHandler::RedisUpdateStream(Easy_StreamInfo_Params* inParams)
+void EasyRedisHandler::OnConnect(const redisAsyncContext* ac, int status)
 {
-    OSMutexLocker mutexLock(&sMutex);
-
-    if (!RedisConnect())
-    {
-        return QTSS_NotConnected;
-    }
-    QTSS_Error theRet = QTSS_NoErr;
-
-    do
-    {
-        if (inParams->inAction == easyRedisActionDelete)
-        {
-            string del = Format("del %s:%s/%lu", string(EASY_REDIS_LIVE), string(inParams->inStreamName), inParams->inChannel);
-            redisReply* replyDel = static_cast<redisReply*>(redisCommand(redisContext_, del.c_str()));
-            RedisReplyObjectDeleter replyDeleter(replyDel);
-
-            if (!replyDel)
-            {
-                printf("Redis del Live error\n");
-                theRet = QTSS_NotConnected;
-                break;
-            }
-            return QTSS_NoErr;
-        }
-        string id(QTSServerInterface::GetServer()->GetCloudServiceNodeID());
-        string hmset = Format("hmset %s:%s/%lu %s %lu %s %lu %s %s", string(EASY_REDIS_LIVE), string(inParams->inStreamName), inParams->inChannel,
-            string(EASY_REDIS_BITRATE), inParams->inBitrate, string(EASY_REDIS_OUTPUT), inParams->inNumOutputs,
-            string(EASY_REDIS_EASYDARWIN), id);
-        redisReply* replyHmset = static_cast<redisReply*>(redisCommand(redisContext_, hmset.c_str()));
-        RedisReplyObjectDeleter replyDeleter(replyHmset);
-
-        if (!replyHmset)
-        {
-            printf("Redis hmset Live error\n");
-            theRet = QTSS_NotConnected;
-            break;
-        }
-
-        if (replyHmset->str && (replyHmset->str) == string("OK"))
-        {
-            string expire = Format("expire %s:%s/%lu 150", string(EASY_REDIS_LIVE), string(inParams->inStreamName), inParams->inChannel);
-            redisReply* replyExpire = static_cast<redisReply*>(redisCommand(redisContext_, expire.c_str()));
-            RedisReplyObjectDeleter replyExpireDeleter(replyExpire);
-
-            if (!replyExpire)
-            {
-                printf("Redis expire Live error\n");
-
-                theRet = QTSS_NotConnected;
-                break;
-            }
-        }
-        else
-        {
-            theRet = QTSS_NotConnected;
-            break;
-        }
-
-    } while (false);
-
-    if (theRet != QTSS_NoErr)
-    {
-        RedisErrorHandler();
-    }
-
-    return QTSS_NoErr;
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	if (status != REDIS_OK)
+	{
+		printf("Redis context connect error: %s\n", ac->errstr);
+		// hiredis frees the context right after this, without OnDisconnect
+		theHandler->Disconnected();
+		return;
+	}
+
+	OSMutexLocker locker(&theHandler->fMutex);
+	theHandler->fConnected = true;
+	theHandler->fNodeDirty = true;
+	if (theHandler->fRedisPasswd[0] == '\0')
+	{
+		theHandler->fBackoffMsec = kMinBackoffMsec;
+		printf("Connect Redis success\n");
+	}
 }
 
-QTSS_Error EasyRedisHandler::RedisSetRTSPLoad()
+void EasyRedisHandler::OnDisconnect(const redisAsyncContext* ac, int status)
 {
-    OSMutexLocker mutexLock(&sMutex);
-
-    if (!RedisConnect())
-    {
-        return QTSS_NotConnected;
-    }
-    QTSS_Error theRet = QTSS_NoErr;
-
-    do
-    {
-        string server(QTSServerInterface::GetServer()->GetServerName().Ptr);
-        string id(QTSServerInterface::GetServer()->GetCloudServiceNodeID());
-        UInt32 load = QTSServerInterface::GetServer()->GetNumRTPSessions();
-
-        string expire = Format("expire %s:%s 15", server, id);
-        redisReply* reply = static_cast<redisReply*>(redisCommand(redisContext_, expire.c_str()));
-        RedisReplyObjectDeleter replyDeleter(reply);
-
-        if (!reply)
-        {
-            printf("Redis expire EasyDarwin error\n");
-            theRet = QTSS_NotConnected;
-            break;
-        }
-
-        if (reply->integer == 1)
-        {
-            string hset = Format("hset %s:%s %s %lu", server, id, string(EASY_REDIS_LOAD), load);
-            redisReply* replyHset = static_cast<redisReply*>(redisCommand(redisContext_, hset.c_str()));
-            RedisReplyObjectDeleter replyHsetDeleter(replyHset);
-
-            if (!replyHset)
-            {
-                printf("Redis hset EasyDarwin Load error\n");
-                theRet = QTSS_NotConnected;
-                break;
-            }
-        }
-    } while (false);
-
-    if (theRet != QTSS_NoErr)
-    {
-        RedisErrorHandler();
-    }
-    return theRet;
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	if (status != REDIS_OK)
+		printf("Connection error: %s\n", ac->errstr);
+	theHandler->Disconnected();
 }
 
-QTSS_Error EasyRedisHandler::RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams)
+void EasyRedisHandler::OnAuthReply(redisAsyncContext* ac, void* reply, void* privdata)
+{
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	theHandler->Replied();
+
+	redisReply* theReply = static_cast<redisReply*>(reply);
+	if (theReply == NULL)
+		return;
+
+	if ((theReply->type != REDIS_REPLY_STATUS) || (theReply->str == NULL) || (string(theReply->str) != string("OK")))
+	{
+		printf("Redis auth error\n");
+		redisAsyncDisconnect(ac);
+		return;
+	}
+
+	theHandler->fBackoffMsec = kMinBackoffMsec;
+	printf("Connect Redis success\n");
+}
+
+void EasyRedisHandler::OnWriteReply(redisAsyncContext* ac, void* reply, void* privdata)
 {
-    OSMutexLocker mutexLock(&sMutex);
-
-    if (!RedisConnect())
-    {
-        return QTSS_NotConnected;
-    }
-
-    QTSS_Error theRet = QTSS_NoErr;
-
-    do
-    {
-        string exists = Format("exists %s:%s", string(EASY_REDIS_DEVICE), string(inParams->inSerial));
-        redisReply* reply = static_cast<redisReply*>(redisCommand(redisContext_, exists.c_str()));
-        RedisReplyObjectDeleter replyDeleter(reply);
-
-        if (!reply)
-        {
-            printf("Redis exists Device error\n");
-            theRet = QTSS_NotConnected;
-            break;
-        }
-
-        if (reply->integer == 1)
-        {
-            string strTemp = Format("hmget %s:%s %s", string(EASY_REDIS_DEVICE), string(inParams->inSerial),
-                string(EASY_REDIS_EASYCMS));
-            redisReply* replyHmget = static_cast<redisReply*>(redisCommand(redisContext_, strTemp.c_str()));
-            RedisReplyObjectDeleter replyHmgetDeleter(replyHmget);
-
-            if (!replyHmget)
-            {
-                printf("Redis hmget Device error\n");
-                theRet = QTSS_NotConnected;
-                break;
-            }
-
-            string easycms = Format("%s:", string(EASY_REDIS_EASYCMS));
-            easycms += replyHmget->element[0]->str;
-
-            strTemp = Format("hmget %s %s %s ", easycms, string(EASY_REDIS_IP), string(EASY_REDIS_PORT));
-            redisReply* replyHmgetEasyDarwin = static_cast<redisReply*>(redisCommand(redisContext_, strTemp.c_str()));
-            RedisReplyObjectDeleter replyHmgetEasyDarwinDeleter(replyHmgetEasyDarwin);
-
-            if (!replyHmgetEasyDarwin)
-            {
-                printf("Redis hmget EasyCMS error\n");
-
-                theRet = QTSS_NotConnected;
-                break;
-            }
-
-            if (replyHmgetEasyDarwin->type == REDIS_REPLY_NIL)
-            {
-                theRet = QTSS_RequestFailed;
-                break;
-            }
-
-            if (replyHmgetEasyDarwin->type == REDIS_REPLY_ARRAY && replyHmgetEasyDarwin->elements == 2)
-            {
-                bool ok = true;
-                for (int i = 0; i < replyHmgetEasyDarwin->elements; ++i)
-                {
-                    if (replyHmgetEasyDarwin->element[i]->type == REDIS_REPLY_NIL)
-                    {
-                        ok = ok && false;
-                    }
-                }
-
-                if (ok)
-                {
-                    memcpy(inParams->outCMSIP, replyHmgetEasyDarwin->element[0]->str, replyHmgetEasyDarwin->element[0]->len);
-                    memcpy(inParams->outCMSPort, replyHmgetEasyDarwin->element[1]->str, replyHmgetEasyDarwin->element[1]->len);
-                }
-                else
-                {
-                    theRet = QTSS_RequestFailed;
-                    break;
-                }
-            }
-        }
-
-    } while (false);
-
-    if (theRet != QTSS_NoErr)
-    {
-        RedisErrorHandler();
-    }
-    return theRet;
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	theHandler->Replied();
+
+	redisReply* theReply = static_cast<redisReply*>(reply);
+	if ((theReply != NULL) && (theReply->type == REDIS_REPLY_ERROR))
+		printf("Redis write error: %s\n", theReply->str);
 }
 
-QTSS_Error EasyRedisHandler::RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams)
+void EasyRedisHandler::OnDeviceReply(redisAsyncContext* ac, void* reply, void* privdata)
 {
-    ////㷨ɾָsessionIDӦkeyɹɾSessionIDڣ֤֤ͨʧ
-    //OSMutexLocker mutexLock(&sMutex);
-    //if (!sIfConSucess)
-    //	return QTSS_NotConnected;
-
-    //char chKey[128] = { 0 };
-    //sprintf(chKey, "SessionID_%s", inParams->inStreanID);//key򷵻1򷵻0
-
-    //int ret = sRedisClient->Delete(chKey);
-
-    //if (ret == -1)//fatal err,need reconnect
-    //{
-    //	sRedisClient->Free();
-    //	sIfConSucess = false;
-
-    //	return QTSS_NotConnected;
-    //}
-    //else if (ret == 0)
-    //{
-    //	*(inParams->outresult) == 1;
-    //	return QTSS_NoErr;
-    //}
-    //else
-    //{
-    //	return ret;
-    //}
-    return 0;
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	theHandler->Replied();
+
+	Lookup* theLookup = static_cast<Lookup*>(privdata);
+	redisReply* theReply = static_cast<redisReply*>(reply);
+	if (theReply == NULL)
+	{
+		theHandler->FinishLookup(theLookup, QTSS_NotConnected);
+		return;
+	}
+
+	if (theReply->type != REDIS_REPLY_STRING)
+	{
+		theHandler->FinishLookup(theLookup, QTSS_ValueNotFound);
+		return;
+	}
+
+	theLookup->fCMS.assign(theReply->str, theReply->len);
+	if (!theHandler->Command(OnCMSReply, theLookup, "HMGET %s:%s %s %s", EASY_REDIS_EASYCMS, theLookup->fCMS.c_str(), EASY_REDIS_IP, EASY_REDIS_PORT))
+		theHandler->FinishLookup(theLookup, QTSS_NotConnected);
 }
 
-void EasyRedisHandler::RedisErrorHandler()
+void EasyRedisHandler::OnCMSReply(redisAsyncContext* ac, void* reply, void* privdata)
 {
-	sIfConSucess = false;
-	if (redisContext_)
+	EasyRedisHandler* theHandler = static_cast<EasyRedisHandler*>(ac->data);
+	theHandler->Replied();
+
+	Lookup* theLookup = static_cast<Lookup*>(privdata);
+	redisReply* theReply = static_cast<redisReply*>(reply);
+	if (theReply == NULL)
 	{
-		printf("Connection error: %s\n", redisContext_->errstr);
-		redisFree(redisContext_);
+		theHandler->FinishLookup(theLookup, QTSS_NotConnected);
+		return;
 	}
-	redisContext_ = NULL;
+
+	if ((theReply->type != REDIS_REPLY_ARRAY) || (theReply->elements != 2) ||
+		(theReply->element[0]->type != REDIS_REPLY_STRING) || (theReply->element[1]->type != REDIS_REPLY_STRING))
+	{
+		theHandler->FinishLookup(theLookup, QTSS_RequestFailed);
+		return;
+	}
+
+	theLookup->fIP.assign(theReply->element[0]->str, theReply->element[0]->len);
+	theLookup->fPort.assign(theReply->element[1]->str, theReply->element[1]->len);
+	theHandler->FinishLookup(theLookup, QTSS_NoErr);
+}
+
+QTSS_Error EasyRedisHandler::RedisTTL()
+{
+	OSMutexLocker locker(&fMutex);
+	fNodeDirty = true;
+	return fConnected ? QTSS_NoErr : QTSS_NotConnected;
+}
+
+QTSS_Error EasyRedisHandler::RedisUpdateStream(Easy_StreamInfo_Params* inParams)
+{
+	string key = Format("%s:%s/%u", string(EASY_REDIS_LIVE), string(inParams->inStreamName), inParams->inChannel);
+
+	OSMutexLocker locker(&fMutex);
+
+	StreamUpdateMap::iterator theIter = fStreams.find(key);
+	if (theIter == fStreams.end())
+	{
+		if (fStreams.size() >= fMaxPending)
+		{
+			fNumDropped++;
+			return QTSS_RequestFailed;
+		}
+		theIter = fStreams.insert(StreamUpdateMap::value_type(key, StreamUpdate())).first;
+	}
+
+	// The latest update wins, a delete after a set only sends the DEL
+	theIter->second.fDelete = (inParams->inAction == easyRedisActionDelete);
+	theIter->second.fBitrate = inParams->inBitrate;
+	theIter->second.fNumOutputs = inParams->inNumOutputs;
+
+	return fConnected ? QTSS_NoErr : QTSS_NotConnected;
+}
+
+QTSS_Error EasyRedisHandler::RedisSetRTSPLoad()
+{
+	// The load goes out with the node record, coalesced with the next TTL
+	OSMutexLocker locker(&fMutex);
+	fNodeDirty = true;
+	return fConnected ? QTSS_NoErr : QTSS_NotConnected;
+}
+
+QTSS_Error EasyRedisHandler::RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams)
+{
+	OSMutexLocker locker(&fMutex);
+
+	if (!fConnected)
+		return QTSS_NotConnected;
+
+	if (fLookups.size() >= fMaxPending)
+		return QTSS_RequestFailed;
+
+	Lookup* theLookup = new Lookup(inParams->inSerial);
+	fLookups.push_back(theLookup);
+	this->Signal(Task::kUpdateEvent);
+
+	SInt64 theDeadline = OS::Milliseconds() + fRequestTimeoutMsec;
+	while (!theLookup->fDone)
+	{
+		SInt64 theTimeLeft = theDeadline - OS::Milliseconds();
+		if (theTimeLeft <= 0)
+			break;
+		theLookup->fCond.Wait(&fMutex, (SInt32)theTimeLeft);
+	}
+
+	if (!theLookup->fDone)
+	{
+		// Run deletes it once the reply, or the disconnect, comes in
+		theLookup->fAbandoned = true;
+		printf("Redis lookup of %s timed out\n", inParams->inSerial);
+		return QTSS_RequestFailed;
+	}
+
+	QTSS_Error theErr = theLookup->fErr;
+	if (theErr == QTSS_NoErr)
+	{
+		::memcpy(inParams->outCMSIP, theLookup->fIP.data(), theLookup->fIP.size());
+		::memcpy(inParams->outCMSPort, theLookup->fPort.data(), theLookup->fPort.size());
+	}
+	delete theLookup;
+
+	return theErr;
+}
+
+QTSS_Error EasyRedisHandler::RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams)
+{
+	return 0;
 }
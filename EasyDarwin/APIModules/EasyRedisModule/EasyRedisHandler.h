@@ -1,78 +1,129 @@
 #ifndef __EASY_REDIS_HANDLER_H__
 #define __EASY_REDIS_HANDLER_H__
 
+#include <deque>
+#include <map>
+#include <string>
+
 #include "OSHeaders.h"
+#include "OS.h"
+#include "OSCond.h"
+#include "OSMutex.h"
 #include "QTSServerInterface.h"
-#ifdef WIN32
-#include "Windows/hiredis.h"
-#else
-#include "hiredis.h"
-#endif //WIN32
-
-#include "Task.h"
-
-class RedisReplyObjectDeleter
-{
-public:
-	RedisReplyObjectDeleter()
-		: fReply(NULL)
-	{}
-
-    explicit RedisReplyObjectDeleter(redisReply* reply)
-		: fReply(reply)
-	{}
-
-    ~RedisReplyObjectDeleter() 
-	{ 
-		if (fReply)
-			freeReplyObject(fReply);
-	}
-        
-    void ClearObject() { fReply = NULL; }
-
-    void SetObject(redisReply* reply) 
-    {
-        fReply = reply; 
-    }
-
-    redisReply* GetObject() const { return fReply; }
-    
-private:    
-    redisReply* fReply;
-
-};
-
-class EasyRedisHandler : public Task
+#include "async.h"
+#include "EasyRedisEventAdapter.h"
+
+#include "IdleTask.h"
+
+//
+// One non-blocking, pipelined connection to Redis, driven by this Task.
+//
+// Callers on any thread never touch the connection. Stream and load updates
+// are written behind: they only change a table here, and Run sends whatever
+// changed every flush interval as one pipelined batch, so a stream updated
+// many times in between costs one HMSET. Lookups that need an answer are
+// queued for Run and wait for their reply for at most the request timeout;
+// Run stays on the blocking task threads so a waiting short task can't hold it up.
+//
+// While Redis is down or unreachable nothing blocks. Lookups fail at once
+// with QTSS_NotConnected, pending updates keep coalescing (new streams past
+// max pending are dropped, a live stream reports again within 20 seconds),
+// and Run reconnects with a backoff of up to kMaxBackoffMsec. A connection
+// that stops answering for the request timeout is dropped the same way.
+class EasyRedisHandler : public IdleTask
 {
 public:
 	EasyRedisHandler(const char* ip, UInt16 port, const char* passwd);
 	virtual ~EasyRedisHandler();
 
+	// Takes effect on the next Run; a new address reconnects
+	void SetPrefs(const char* ip, UInt16 port, const char* passwd,
+		UInt32 inFlushIntervalMsec, UInt32 inRequestTimeoutMsec, UInt32 inMaxPending);
+
 	QTSS_Error RedisTTL();
 
-    QTSS_Error RedisUpdateStream(Easy_StreamInfo_Params* inParams);
-    QTSS_Error RedisSetRTSPLoad();
-    QTSS_Error RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams);
-    QTSS_Error RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams);
-	
-	OSQueueElem		fQueueElem;	
-	UInt32			fID;
-private:
-	virtual SInt64	Run();
-	bool RedisConnect();
-	void RedisErrorHandler();
-
-	bool			sIfConSucess;
-	OSMutex			sMutex;
-	redisContext*	redisContext_;
-
-	char			fRedisIP[128];
-	UInt16			fRedisPort;
-	char			fRedisPasswd[256];
-	
-};
+	QTSS_Error RedisUpdateStream(Easy_StreamInfo_Params* inParams);
+	QTSS_Error RedisSetRTSPLoad();
+	QTSS_Error RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams);
+	QTSS_Error RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams);
 
+private:
 
+	enum
+	{
+		kMinBackoffMsec = 1000,
+		kMaxBackoffMsec = 30000,
+		kNodeExpireSecs = 15,
+		kLiveExpireSecs = 150
+	};
+
+	struct StreamUpdate
+	{
+		bool    fDelete;
+		UInt32  fBitrate;
+		UInt32  fNumOutputs;
+	};
+	typedef std::map<std::string, StreamUpdate> StreamUpdateMap;   // "Live:name/channel" -> last update
+
+	struct Lookup
+	{
+		Lookup(const char* inSerial) : fSerial(inSerial), fDone(false), fAbandoned(false), fErr(QTSS_RequestFailed) {}
+
+		std::string fSerial;
+		std::string fCMS;
+		std::string fIP;
+		std::string fPort;
+		bool        fDone;
+		bool        fAbandoned;     // the caller timed out, whoever finishes last deletes
+		QTSS_Error  fErr;
+		OSCond      fCond;
+	};
+
+	virtual SInt64 Run();
+
+	void Connect(SInt64 inNow);
+	void Disconnect();
+	void Disconnected();
+	void Flush(SInt64 inNow);
+	void SendLookups();
+	void FinishLookup(Lookup* inLookup, QTSS_Error inErr);
+
+	// Queues one command on the connection, counting it as in flight
+	bool Command(redisCallbackFn* inCallback, void* inPrivData, const char* inFormat, ...);
+	void Replied();
+
+	static void OnConnect(const redisAsyncContext* ac, int status);
+	static void OnDisconnect(const redisAsyncContext* ac, int status);
+	static void OnAuthReply(redisAsyncContext* ac, void* reply, void* privdata);
+	static void OnWriteReply(redisAsyncContext* ac, void* reply, void* privdata);
+	static void OnDeviceReply(redisAsyncContext* ac, void* reply, void* privdata);
+	static void OnCMSReply(redisAsyncContext* ac, void* reply, void* privdata);
+
+	// Shared with the callers, under fMutex
+	OSMutex             fMutex;
+	bool                fConnected;
+	bool                fNodeDirty;
+	StreamUpdateMap     fStreams;
+	std::deque<Lookup*> fLookups;
+	UInt32              fNumDropped;
+
+	char                fRedisIP[128];
+	UInt16              fRedisPort;
+	char                fRedisPasswd[256];
+	bool                fAddressChanged;
+	UInt32              fFlushIntervalMsec;
+	UInt32              fRequestTimeoutMsec;
+	UInt32              fMaxPending;
+
+	// Only touched by Run and the hiredis callbacks it makes
+	redisAsyncContext*      fContext;
+	EasyRedisEventContext*  fEvents;
+	UInt32                  fNumInFlight;
+	SInt64                  fLastProgress;  // last reply, or when the first of fNumInFlight went out
+	SInt64                  fConnectStart;
+	SInt64                  fNextConnect;
+	UInt32                  fBackoffMsec;
+	SInt64                  fLastFlush;
+};
 
 #endif //__EASY_REDIS_HANDLER_H__
-
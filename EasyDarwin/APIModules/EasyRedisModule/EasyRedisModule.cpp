@@ -13,8 +13,6 @@
 #include "ReflectorSession.h"
 #include "EasyUtil.h"
 
-#include "Windows/hiredis.h"
-
 #include "EasyRedisHandler.h"
 
 // STATIC VARIABLES
@@ -32,16 +30,18 @@ static UInt16			sDefaultRedisPort = 6379;
 static char*            sRedisPassword = NULL;
 static char*            sDefaultRedisPassword = "EasyDSSEasyDarwinEasyCMSEasyCamera";
 
-static OSMutex			sMutex;
-
-// RedisClientPoolSize
-static UInt16			sRedisClientPoolSize = 16;
-static UInt16			sDefaultRedisClientPoolSize = 16;
-// MaxRedisClientPoolSize
-static UInt16			sMaxRedisClientPoolSize = 64;
-static UInt16			sDefaultMaxRedisClientPoolSize = 64;
+// Redis flush interval, stream and load updates are batched this long
+static UInt32			sRedisFlushIntervalMsec = 1000;
+static UInt32			sDefaultRedisFlushIntervalMsec = 1000;
+// Redis request timeout
+static UInt32			sRedisRequestTimeoutMsec = 2000;
+static UInt32			sDefaultRedisRequestTimeoutMsec = 2000;
+// Redis max pending, bounds the updates and commands held for Redis
+static UInt32			sRedisMaxPending = 4096;
+static UInt32			sDefaultRedisMaxPending = 4096;
 
-static OSQueue			sFreeHandlerQueue;
+// The one connection to Redis, shared by every caller
+static EasyRedisHandler*	sRedisHandler = NULL;
 
 // FUNCTION PROTOTYPES
 static QTSS_Error   EasyRedisModuleDispatch(QTSS_Role inRole, QTSS_RoleParamPtr inParamBlock);
@@ -54,9 +54,6 @@ static QTSS_Error	RedisSetRTSPLoad();
 static QTSS_Error	RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams);
 static QTSS_Error	RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams);
 
-static EasyRedisHandler* GetRedisHandler();
-static void RedisHandlerReclaim(EasyRedisHandler* handler);
-
 
 QTSS_Error EasyRedisModule_Main(void* inPrivateArgs)
 {
@@ -115,11 +112,8 @@ QTSS_Error Initialize(QTSS_Initialize_Params* inParams)
 
 	RereadPrefs();
 
-    for (UInt32 numPackets = 0; numPackets < 16; numPackets++)
-    {
-        EasyRedisHandler* handler = new EasyRedisHandler(sRedis_IP, sRedisPort, sRedisPassword);
-        sFreeHandlerQueue.EnQueue(&handler->fQueueElem);//put this packet onto the free queue
-    }
+	sRedisHandler = new EasyRedisHandler(sRedis_IP, sRedisPort, sRedisPassword);
+	sRedisHandler->SetPrefs(sRedis_IP, sRedisPort, sRedisPassword, sRedisFlushIntervalMsec, sRedisRequestTimeoutMsec, sRedisMaxPending);
 
 	return QTSS_NoErr;
 }
@@ -134,95 +128,52 @@ QTSS_Error RereadPrefs()
 	delete[] sRedisPassword;
 	sRedisPassword = QTSSModuleUtils::GetStringAttribute(modulePrefs, "redis_password", sDefaultRedisPassword);
 
-    QTSSModuleUtils::GetAttribute(modulePrefs, "redis_client_pool_size", qtssAttrDataTypeUInt16, &sRedisClientPoolSize, &sDefaultRedisClientPoolSize, sizeof(sDefaultRedisClientPoolSize));
-    QTSSModuleUtils::GetAttribute(modulePrefs, "max_redis_client_pool_size", qtssAttrDataTypeUInt16, &sMaxRedisClientPoolSize, &sDefaultMaxRedisClientPoolSize, sizeof(sDefaultMaxRedisClientPoolSize));
+	QTSSModuleUtils::GetAttribute(modulePrefs, "redis_flush_interval_msec", qtssAttrDataTypeUInt32, &sRedisFlushIntervalMsec, &sDefaultRedisFlushIntervalMsec, sizeof(sRedisFlushIntervalMsec));
+	QTSSModuleUtils::GetAttribute(modulePrefs, "redis_request_timeout_msec", qtssAttrDataTypeUInt32, &sRedisRequestTimeoutMsec, &sDefaultRedisRequestTimeoutMsec, sizeof(sRedisRequestTimeoutMsec));
+	QTSSModuleUtils::GetAttribute(modulePrefs, "redis_max_pending", qtssAttrDataTypeUInt32, &sRedisMaxPending, &sDefaultRedisMaxPending, sizeof(sRedisMaxPending));
+
+	if (sRedisHandler != NULL)
+		sRedisHandler->SetPrefs(sRedis_IP, sRedisPort, sRedisPassword, sRedisFlushIntervalMsec, sRedisRequestTimeoutMsec, sRedisMaxPending);
 
 	return QTSS_NoErr;
 }
 
 QTSS_Error RedisTTL()
 {
-    QTSS_Error theRet = QTSS_Unimplemented;
-
-    EasyRedisHandler* handler = GetRedisHandler();
-    if (handler)
-    {
-        theRet = handler->RedisTTL();
-        RedisHandlerReclaim(handler);
-    }
-    return theRet;
+	if (sRedisHandler == NULL)
+		return QTSS_Unimplemented;
+
+	return sRedisHandler->RedisTTL();
 }
 
 QTSS_Error RedisUpdateStream(Easy_StreamInfo_Params* inParams)
 {
-    QTSS_Error theRet = QTSS_Unimplemented;
-
-    EasyRedisHandler* handler = GetRedisHandler();
-    if (handler)
-    {
-        theRet = handler->RedisUpdateStream(inParams);
-        RedisHandlerReclaim(handler);
-    }
-    return theRet;
+	if (sRedisHandler == NULL)
+		return QTSS_Unimplemented;
+
+	return sRedisHandler->RedisUpdateStream(inParams);
 }
 
 QTSS_Error RedisGetAssociatedCMS(QTSS_GetAssociatedCMS_Params* inParams)
 {
-    QTSS_Error theRet = QTSS_Unimplemented;
-
-    EasyRedisHandler* handler = GetRedisHandler();
-    if (handler)
-    {
-        theRet = handler->RedisGetAssociatedCMS(inParams);
-        RedisHandlerReclaim(handler);
-    }
-    return theRet;
+	if (sRedisHandler == NULL)
+		return QTSS_Unimplemented;
+
+	return sRedisHandler->RedisGetAssociatedCMS(inParams);
 }
 
 QTSS_Error RedisSetRTSPLoad()
 {
-    QTSS_Error theRet = QTSS_Unimplemented;
-
-    EasyRedisHandler* handler = GetRedisHandler();
-    if (handler)
-    {
-        theRet = handler->RedisSetRTSPLoad();
-        RedisHandlerReclaim(handler);
-    }
-    return theRet;
+	if (sRedisHandler == NULL)
+		return QTSS_Unimplemented;
+
+	return sRedisHandler->RedisSetRTSPLoad();
 }
 
 QTSS_Error RedisJudgeStreamID(QTSS_JudgeStreamID_Params* inParams)
 {
-    QTSS_Error theRet = QTSS_Unimplemented;
-
-    EasyRedisHandler* handler = GetRedisHandler();
-    if (handler)
-    {
-        theRet = handler->RedisJudgeStreamID(inParams);
-        RedisHandlerReclaim(handler);
-    }
-    return theRet;
-}
+	if (sRedisHandler == NULL)
+		return QTSS_Unimplemented;
 
-EasyRedisHandler* GetRedisHandler()
-{
-    OSMutexLocker locker(&sMutex);
-    if (sFreeHandlerQueue.GetLength() == 0)
-        //if the port number of this socket is odd, this packet is an RTCP packet.
-        return new EasyRedisHandler(sRedis_IP, sRedisPort, sRedisPassword);
-    else
-        return (EasyRedisHandler*)sFreeHandlerQueue.DeQueue()->GetEnclosingObject();
-}
-
-void RedisHandlerReclaim(EasyRedisHandler* handler)
-{
-    if (handler)
-    {
-        //printf("RedisHandlerReclaim ID:%d \n", handler->fID);
-        if (sFreeHandlerQueue.GetLength() > sMaxRedisClientPoolSize)
-            handler->Signal(Task::kKillEvent);
-        else
-            sFreeHandlerQueue.EnQueue(&handler->fQueueElem);
-    }
-}
\ No newline at end of file
+	return sRedisHandler->RedisJudgeStreamID(inParams);
+}
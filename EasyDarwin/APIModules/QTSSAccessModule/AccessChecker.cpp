@@ -46,6 +46,7 @@
 #include "OSHeaders.h"
 #include "AccessChecker.h"
 #include "QTSSModuleUtils.h"
+#include "QTAccessFileCache.h"
 #include "OSArrayObjectDeleter.h"
 
 static StrPtrLen sAuthWord("realm", 5);
@@ -59,7 +60,9 @@ AccessChecker::AccessChecker() :
 	fGroupsFileModDate(-1),
 	fProfiles(NULL),
 	fNumUsers(0),
-	fCurrentSize(0)
+	fCurrentSize(0),
+	fGeneration(0),
+	fLastErr(kNoErr)
 {
 }
 
@@ -92,6 +95,9 @@ void AccessChecker::UpdateFilePaths(const char* inUsersFilePath, const char* inG
 
 	fGroupsFilePath = new char[strlen(inGroupsFilePath) + 1];
 	::strcpy(fGroupsFilePath, inGroupsFilePath);
+
+	// read the new files on the next UpdateUserProfiles
+	fGeneration = 0;
 }
 
 // Function to delete memory allocated for all the profiles, and the authRealm
@@ -164,11 +170,33 @@ void AccessChecker::deleteProfilesAndRealm()
 	fCurrentSize = 0;
 }
 
+// Called before every lookup. Costs nothing unless QTAccessFileCache has seen
+// the users or groups file (or some access file) change since the last read.
+UInt32 AccessChecker::UpdateUserProfiles() {
+
+	UInt32 theGeneration = QTAccessFileCache::GetGeneration();
+	if (theGeneration == fGeneration)
+		return fLastErr;
+
+	QTAccessFileCache::WatchFile(fUsersFilePath);
+	QTAccessFileCache::WatchFile(fGroupsFilePath);
+
+	// The mod dates can't tell apart two changes within a second, so read
+	// both files again. Profiles of a file that is now empty are dropped.
+	deleteProfilesAndRealm();
+	fUsersFileModDate = -1;
+	fGroupsFileModDate = -1;
+
+	fLastErr = ReadUserProfiles();
+	fGeneration = theGeneration;
+	return fLastErr;
+}
+
 // Memory is allocated for each username record found in the users file
 // Memory is also allocated for each group name found in the groups file per user
 // All this memory must be deleted if the profiles are deleted, before parsing
 // the file again
-UInt32 AccessChecker::UpdateUserProfiles() {
+UInt32 AccessChecker::ReadUserProfiles() {
 
 	UInt32 index = 0;
 	UInt32 i = 0, j = 0;
@@ -184,8 +212,8 @@ UInt32 AccessChecker::UpdateUserProfiles() {
 	// Read the users file into a buffer
 	StrPtrLen userData;
 	QTSS_TimeVal newModDate = -1;
-	// QTSSModuleUtils::ReadEntireFile allocates memory for userData
-	QTSS_Error err = QTSSModuleUtils::ReadEntireFile(fUsersFilePath, &userData, fUsersFileModDate, &newModDate);
+	// QTAccessFileCache::ReadFile allocates memory for userData
+	QTSS_Error err = QTAccessFileCache::ReadFile(fUsersFilePath, &userData, fUsersFileModDate, &newModDate);
 	if (err == QTSS_FileNotFound)
 		resultErr |= kUsersFileNotFoundErr;
 	else if (err != QTSS_NoErr)
@@ -202,8 +230,8 @@ UInt32 AccessChecker::UpdateUserProfiles() {
 
 	// Read the groups file into a buffer
 	StrPtrLen groupData;
-	// QTSSModuleUtils::ReadEntireFile allocates memory for groupData
-	err = QTSSModuleUtils::ReadEntireFile(fGroupsFilePath, &groupData, fGroupsFileModDate, &newModDate);
+	// QTAccessFileCache::ReadFile allocates memory for groupData
+	err = QTAccessFileCache::ReadFile(fGroupsFilePath, &groupData, fGroupsFileModDate, &newModDate);
 	if (err == QTSS_FileNotFound)
 		resultErr |= kGroupsFileNotFoundErr;
 	else if (err != QTSS_NoErr)
@@ -233,9 +261,9 @@ UInt32 AccessChecker::UpdateUserProfiles() {
 
 	// Since one or both of the files has changed, reread the files and create user profiles    
 	if (userData.Len == 0)
-		(void)QTSSModuleUtils::ReadEntireFile(fUsersFilePath, &userData, -1, NULL);
+		(void)QTAccessFileCache::ReadFile(fUsersFilePath, &userData, -1, NULL);
 	if (groupData.Len == 0 && !groupFileErrors)
-		(void)QTSSModuleUtils::ReadEntireFile(fGroupsFilePath, &groupData, -1, NULL);
+		(void)QTAccessFileCache::ReadFile(fGroupsFilePath, &groupData, -1, NULL);
 
 
 	// This will delete the memory allocated for userData when we return from this function
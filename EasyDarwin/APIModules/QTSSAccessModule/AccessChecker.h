@@ -55,9 +55,8 @@ class AccessChecker
 				If not found,
 					deny access
 
-		ToDo:
-			would probably be a good idea to do some caching of ".qtaccess" data to avoid
-			multiple directory walks
+		The ".qtaccess" files are found and parsed through QTAccessFileCache. The users
+		and groups files are read again only when QTAccessFileCache has seen a change.
 	*/
 
 public:
@@ -111,6 +110,10 @@ protected:
 
 private:
 	void deleteProfilesAndRealm();
+	UInt32 ReadUserProfiles();
+
+	UInt32              fGeneration;    // of QTAccessFileCache when the files were last read
+	UInt32              fLastErr;       // what reading them returned
 };
 
 #endif //_QTSSACCESSCHECKER_H_
@@ -37,6 +37,7 @@
 
 #include "QTRTPFile.h"
 #include "QTFile.h"
+#include "QTFileIndex.h"
 #include "OSMemory.h"
 #include "OSArrayObjectDeleter.h"
 #include "QTSSMemoryDeleter.h"
@@ -134,14 +135,14 @@ static Float32              sDefaultMaxAllowedSpeed = 4;
 static bool               sEnableSharedBuffers = false;
 static bool               sEnablePrivateBuffers = false;
 
-static UInt32               sSharedBufferUnitKSize = 0;
-static UInt32               sSharedBufferInc = 0;
-static UInt32               sSharedBufferUnitSize = 0;
-static UInt32               sSharedBufferMaxUnits = 0;
+// Parsed movie cache prefs
+static UInt32               sMovieCacheMBytes = 64;
+static UInt32               sDefaultMovieCacheMBytes = 64;
+static QTSS_AttributeID     sMovieCachePrewarmListID = qtssIllegalAttrID;
 
-static UInt32               sPrivateBufferUnitKSize = 0;
-static UInt32               sPrivateBufferUnitSize = 0;
-static UInt32               sPrivateBufferMaxUnits = 0;
+// Seek index prefs
+static bool               sEnableSeekIndex = true;
+static bool               sEnableSeekIndexFiles = false;
 
 static Float32              sAddClientBufferDelaySecs = 0;
 
@@ -182,6 +183,7 @@ static QTSS_Error DestroySession(QTSS_ClientSessionClosing_Params* inParams);
 static void       DeleteFileSession(FileSession* inFileSession);
 static UInt32   WriteSDPHeader(FILE* sdpFile, iovec *theSDPVec, SInt16 *ioVectorIndex, StrPtrLen *sdpHeader);
 static void     BuildPrefBasedHeaders();
+static void     PrewarmMovieCache();
 
 QTSS_Error QTSSFileModule_Main(void* inPrivateArgs)
 {
@@ -378,6 +380,8 @@ QTSS_Error Initialize(QTSS_Initialize_Params* inParams)
 	// Read our preferences
 	RereadPrefs();
 
+	PrewarmMovieCache();
+
 	// Report to the server that this module handles DESCRIBE, SETUP, PLAY, PAUSE, and TEARDOWN
 	static QTSS_RTSPMethod sSupportedMethods[] = { qtssDescribeMethod, qtssSetupMethod, qtssTeardownMethod, qtssPlayMethod, qtssPauseMethod };
 	QTSSModuleUtils::SetupSupportedMethods(inParams->inServer, sSupportedMethods, 5);
@@ -385,6 +389,44 @@ QTSS_Error Initialize(QTSS_Initialize_Params* inParams)
 	return QTSS_NoErr;
 }
 
+void PrewarmMovieCache()
+{
+	// Parse the listed movies into the cache so their first viewers don't wait on it.
+	// Relative paths are in the movie folder.
+	char* movieFolderString = NULL;
+	(void)QTSS_GetValueAsString(sServerPrefs, qtssPrefsMovieFolder, 0, &movieFolderString);
+	OSCharArrayDeleter movieFolderDeleter(movieFolderString);
+
+	UInt32 numValues = 0;
+	(void)QTSS_GetNumValues(sPrefs, sMovieCachePrewarmListID, &numValues);
+
+	for (UInt32 index = 0; index < numValues; index++)
+	{
+		char* theTitleStr = NULL;
+		(void)QTSS_GetValueAsString(sPrefs, sMovieCachePrewarmListID, index, &theTitleStr);
+		OSCharArrayDeleter titleDeleter(theTitleStr);
+		if ((theTitleStr == NULL) || (theTitleStr[0] == '\0'))
+			continue;
+
+		ResizeableStringFormatter thePath(NULL, 0);
+		if ((theTitleStr[0] != kPathDelimiterChar) && (movieFolderString != NULL))
+		{
+			thePath.Put(movieFolderString);
+			if (thePath.GetBytesWritten() > 0 && kPathDelimiterChar != thePath.GetBufPtr()[thePath.GetBytesWritten() - 1])
+				thePath.PutChar(kPathDelimiterChar);
+		}
+		thePath.Put(theTitleStr);
+		thePath.PutTerminator();
+
+		if (QTRTPFile::PrewarmFileCache(thePath.GetBufPtr()) != QTRTPFile::errNoError)
+		{
+			char theMessage[256];
+			qtss_snprintf(theMessage, sizeof(theMessage), "entry %s could not be loaded", theTitleStr);
+			QTSSModuleUtils::LogPrefErrorStr(qtssWarningVerbosity, "movie_cache_prewarm_list", theMessage);
+		}
+	}
+}
+
 void BuildPrefBasedHeaders()
 {
 	//build the sdp that looks like: \r\ne=http://streaming.apple.com\r\ne=qts@apple.com.
@@ -470,26 +512,22 @@ QTSS_Error RereadPrefs()
 	sEnablePrivateBuffers = false;
 	QTSSModuleUtils::GetIOAttribute(sPrefs, "enable_private_file_buffers", qtssAttrDataTypeBool16, &sEnablePrivateBuffers, sizeof(sEnablePrivateBuffers));
 
-	sSharedBufferInc = 8;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "num_shared_buffer_increase_per_session", qtssAttrDataTypeUInt32, &sSharedBufferInc, sizeof(sSharedBufferInc));
-
-	sSharedBufferUnitKSize = 256;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "shared_buffer_unit_k_size", qtssAttrDataTypeUInt32, &sSharedBufferUnitKSize, sizeof(sSharedBufferUnitKSize));
+	QTSSModuleUtils::GetAttribute(sPrefs, "movie_cache_max_mbytes", qtssAttrDataTypeUInt32,
+		&sMovieCacheMBytes, &sDefaultMovieCacheMBytes, sizeof(sMovieCacheMBytes));
+	QTRTPFile::SetFileCacheSize(sMovieCacheMBytes);
 
-	sPrivateBufferUnitKSize = 256;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "private_buffer_unit_k_size", qtssAttrDataTypeUInt32, &sPrivateBufferUnitKSize, sizeof(sPrivateBufferUnitKSize));
+	delete[] QTSSModuleUtils::GetStringAttribute(sPrefs, "movie_cache_prewarm_list", ""); // initialize if there isn't one
+	sMovieCachePrewarmListID = QTSSModuleUtils::GetAttrID(sPrefs, "movie_cache_prewarm_list");
 
-	sSharedBufferUnitSize = 1;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "num_shared_buffer_units_per_buffer", qtssAttrDataTypeUInt32, &sSharedBufferUnitSize, sizeof(sSharedBufferUnitSize));
+	// Seek index prefs, for movies parsed from now on
 
-	sPrivateBufferUnitSize = 1;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "num_private_buffer_units_per_buffer", qtssAttrDataTypeUInt32, &sPrivateBufferUnitSize, sizeof(sPrivateBufferUnitSize));
+	sEnableSeekIndex = true;
+	QTSSModuleUtils::GetIOAttribute(sPrefs, "enable_seek_index", qtssAttrDataTypeBool16, &sEnableSeekIndex, sizeof(sEnableSeekIndex));
 
-	sSharedBufferMaxUnits = 8;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "max_shared_buffer_units_per_buffer", qtssAttrDataTypeUInt32, &sSharedBufferMaxUnits, sizeof(sSharedBufferMaxUnits));
+	sEnableSeekIndexFiles = false;
+	QTSSModuleUtils::GetIOAttribute(sPrefs, "enable_seek_index_files", qtssAttrDataTypeBool16, &sEnableSeekIndexFiles, sizeof(sEnableSeekIndexFiles));
 
-	sPrivateBufferMaxUnits = 8;
-	QTSSModuleUtils::GetIOAttribute(sPrefs, "max_private_buffer_units_per_buffer", qtssAttrDataTypeUInt32, &sPrivateBufferMaxUnits, sizeof(sPrivateBufferMaxUnits));
+	QTFileIndex::Configure(sEnableSeekIndex, sEnableSeekIndexFiles);
 
 	sAddClientBufferDelaySecs = 0;
 	QTSSModuleUtils::GetIOAttribute(sPrefs, "add_seconds_to_client_buffer_delay", qtssAttrDataTypeFloat32, &sAddClientBufferDelaySecs, sizeof(sAddClientBufferDelaySecs));
@@ -1171,11 +1209,12 @@ QTSS_Error SetupCacheBuffers(QTSS_StandardRTSP_Params* inParamBlock, FileSession
 			return QTSS_RequestFailed;
 	}
 
-	if (sEnableSharedBuffers && playCount == 1) // increments num buffers after initialization so do only once per session
-		(*theFile)->fFile.AllocateSharedBuffers(sSharedBufferUnitKSize, sSharedBufferInc, sSharedBufferUnitSize, sSharedBufferMaxUnits);
+	// both read through the process-wide block cache, sized by the QTSSPosixFileSysModule prefs
+	if (sEnableSharedBuffers && playCount == 1)
+		(*theFile)->fFile.AllocateSharedBuffers();
 
-	if (sEnablePrivateBuffers) // reinitializes buffers to current location so do every time 
-		(*theFile)->fFile.AllocatePrivateBuffers(sSharedBufferUnitKSize, sPrivateBufferUnitSize, sPrivateBufferMaxUnits);
+	if (sEnablePrivateBuffers)
+		(*theFile)->fFile.AllocatePrivateBuffers();
 
 	playCount++;
 	theErr = QTSS_SetValue(inParamBlock->inClientSession, sFileSessionPlayCountAttrID, 0, &playCount, sizeof(playCount));
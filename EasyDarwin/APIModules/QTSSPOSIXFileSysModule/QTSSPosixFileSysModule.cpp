@@ -34,6 +34,7 @@
 #include "QTSSModuleUtils.h"
 
 #include "OSFileSource.h"
+#include "OSBlockCache.h"
 #include "Socket.h"
 #include "QTSSModule.h"
 
@@ -41,11 +42,20 @@
 static QTSS_AttributeID         sOSFileSourceAttr = qtssIllegalAttrID;
 static QTSS_AttributeID         sEventContextAttr = qtssIllegalAttrID;
 
+// PREFS
+static QTSS_ModulePrefsObject   sPrefs = NULL;
+
+static UInt32                   sBlockCacheMBytes = 256;
+static UInt32                   sDefaultBlockCacheMBytes = 256;
+static UInt32                   sBlockCacheReadAheadSecs = 4;
+static UInt32                   sDefaultBlockCacheReadAheadSecs = 4;
+
 // FUNCTION PROTOTYPES
 
 static QTSS_Error   QTSSPosixFileSysModuleDispatch(QTSS_Role inRole, QTSS_RoleParamPtr inParams);
 static QTSS_Error   Register(QTSS_Register_Params* inParams);
 static QTSS_Error   Initialize(QTSS_Initialize_Params* inParams);
+static QTSS_Error   RereadPrefs();
 static QTSS_Error   OpenFile(QTSS_OpenFile_Params* inParams);
 static QTSS_Error   AdviseFile(QTSS_AdviseFile_Params* inParams);
 static QTSS_Error   ReadFile(QTSS_ReadFile_Params* inParams);
@@ -68,6 +78,8 @@ QTSS_Error  QTSSPosixFileSysModuleDispatch(QTSS_Role inRole, QTSS_RoleParamPtr i
 		return Register(&inParams->regParams);
 	case QTSS_Initialize_Role:
 		return Initialize(&inParams->initParams);
+	case QTSS_RereadPrefs_Role:
+		return RereadPrefs();
 	case QTSS_OpenFile_Role:
 		return OpenFile(&inParams->openFileParams);
 	case QTSS_AdviseFile_Role:
@@ -88,6 +100,7 @@ QTSS_Error Register(QTSS_Register_Params* inParams)
 {
 	// Do role & attribute setup
 	(void)QTSS_AddRole(QTSS_Initialize_Role);
+	(void)QTSS_AddRole(QTSS_RereadPrefs_Role);
 
 	// Only open needs to be registered for, the rest happen naturally
 	(void)QTSS_AddRole(QTSS_OpenFile_Role);
@@ -112,6 +125,20 @@ QTSS_Error Initialize(QTSS_Initialize_Params* inParams)
 {
 	// Setup module utils
 	QTSSModuleUtils::Initialize(inParams->inMessages, inParams->inServer, inParams->inErrorLogStream);
+	sPrefs = QTSSModuleUtils::GetModulePrefsObject(inParams->inModule);
+
+	return RereadPrefs();
+}
+
+QTSS_Error RereadPrefs()
+{
+	// The block cache is shared by every file opened through this module. 0 Mbytes turns it off.
+	QTSSModuleUtils::GetAttribute(sPrefs, "file_block_cache_mbytes", qtssAttrDataTypeUInt32,
+		&sBlockCacheMBytes, &sDefaultBlockCacheMBytes, sizeof(sBlockCacheMBytes));
+	QTSSModuleUtils::GetAttribute(sPrefs, "file_block_cache_read_ahead_sec", qtssAttrDataTypeUInt32,
+		&sBlockCacheReadAheadSecs, &sDefaultBlockCacheReadAheadSecs, sizeof(sBlockCacheReadAheadSecs));
+
+	OSBlockCache::Configure(sBlockCacheMBytes, sBlockCacheReadAheadSecs);
 	return QTSS_NoErr;
 }
 
@@ -88,6 +88,7 @@ static QTSS_AttributeID         sRTPInfoWaitTimeAttr = qtssIllegalAttrID;
 // ref to the prefs dictionary object
 static OSRefTable*      sSessionMap = NULL;
 static const StrPtrLen  kCacheControlHeader("no-cache");
+static const UInt32     kPushBatchSize = 64;    // packets per channel handed to PushPackets at once
 static QTSS_PrefsObject sServerPrefs = NULL;
 static QTSS_ServerObject sServer = NULL;
 static QTSS_ModulePrefsObject sPrefs = NULL;
@@ -203,10 +204,12 @@ ReflectorSession* FindOrCreateSession(StrPtrLen* inName, QTSS_StandardRTSP_Param
 static QTSS_Error DoSetup(QTSS_StandardRTSP_Params* inParams);
 static QTSS_Error DoPlay(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inSession);
 static QTSS_Error DestroySession(QTSS_ClientSessionClosing_Params* inParams);
+static QTSS_Error ProcessRTCPPacket(QTSS_RTCPProcess_Params* inParams);
 static void RemoveOutput(ReflectorOutput* inOutput, ReflectorSession* inSession, bool killClients);
 static ReflectorSession* DoSessionSetup(QTSS_StandardRTSP_Params* inParams, QTSS_AttributeID inPathType, bool isPush = false, bool *foundSessionPtr = NULL, char** resultFilePath = NULL);
 static QTSS_Error RereadPrefs();
 static QTSS_Error ProcessRTPData(QTSS_IncomingData_Params* inParams);
+static void PushInterleavedPackets(void* inCookie, Easy_InterleavedPacket* inPackets, UInt32 inNumPackets);
 static QTSS_Error ReflectorAuthorizeRTSPRequest(QTSS_StandardRTSP_Params* inParams);
 static bool InfoPortsOK(QTSS_StandardRTSP_Params* inParams, SDPSourceInfo* theInfo, StrPtrLen* inPath);
 void KillCommandPathInList();
@@ -248,6 +251,8 @@ QTSS_Error  QTSSReflectorModuleDispatch(QTSS_Role inRole, QTSS_RoleParamPtr inPa
 		return ProcessRTPData(&inParams->rtspIncomingDataParams);
 	case QTSS_ClientSessionClosing_Role:
 		return DestroySession(&inParams->clientSessionClosingParams);
+	case QTSS_RTCPProcess_Role:
+		return ProcessRTCPPacket(&inParams->rtcpProcessParams);
 	case QTSS_Shutdown_Role:
 		return Shutdown();
 	case QTSS_RTSPAuthorize_Role:
@@ -269,6 +274,7 @@ QTSS_Error Register(QTSS_Register_Params* inParams)
 	(void)QTSS_AddRole(QTSS_Shutdown_Role);
 	(void)QTSS_AddRole(QTSS_RTSPPreProcessor_Role);
 	(void)QTSS_AddRole(QTSS_ClientSessionClosing_Role);
+	(void)QTSS_AddRole(QTSS_RTCPProcess_Role);
 	(void)QTSS_AddRole(QTSS_RTSPIncomingData_Role);
 	(void)QTSS_AddRole(QTSS_RTSPAuthorize_Role);
 	(void)QTSS_AddRole(QTSS_RereadPrefs_Role);
@@ -678,6 +684,55 @@ QTSS_Error ProcessRTPData(QTSS_IncomingData_Params* inParams)
 }
 
 
+void PushInterleavedPackets(void* inCookie, Easy_InterleavedPacket* inPackets, UInt32 inNumPackets)
+{
+	if (!sBroadcastPushEnabled)
+		return;
+
+	ReflectorSession* theSession = (ReflectorSession*)inCookie;
+	if (theSession->GetSourceInfo() == NULL)
+		return;
+
+	// Hand each channel's packets to its stream in one go, in arrival order.
+	// Channels are few, so a pass per channel is cheaper than sorting.
+	StrPtrLen thePackets[kPushBatchSize];
+	bool channelDone[256];
+	::memset(channelDone, 0, sizeof(channelDone));
+
+	UInt32  numStreams = theSession->GetNumStreams();
+	for (UInt32 x = 0; x < inNumPackets; x++)
+	{
+		UInt8 packetChannel = (UInt8)inPackets[x].inPacketData[1];
+		if (channelDone[packetChannel])
+			continue;
+		channelDone[packetChannel] = true;
+
+		UInt32 inIndex = packetChannel / 2; // one stream per every 2 channels, odd channel is rtcp
+		if (inIndex >= numStreams)
+			continue;
+		ReflectorStream* theStream = theSession->GetStreamByIndex(inIndex);
+		if (theStream == NULL)
+			continue;
+
+		bool isRTCP = (packetChannel & 1) != 0;
+		UInt32 numPackets = 0;
+		for (UInt32 y = x; y < inNumPackets; y++)
+		{
+			if ((UInt8)inPackets[y].inPacketData[1] != packetChannel)
+				continue;
+
+			thePackets[numPackets++].Set(inPackets[y].inPacketData + 4, inPackets[y].inPacketLen - 4);
+			if (numPackets == kPushBatchSize)
+			{
+				theStream->PushPackets(thePackets, numPackets, isRTCP);
+				numPackets = 0;
+			}
+		}
+		if (numPackets > 0)
+			theStream->PushPackets(thePackets, numPackets, isRTCP);
+	}
+}
+
 QTSS_Error ProcessRTSPRequest(QTSS_StandardRTSP_Params* inParams)
 {
 	OSMutexLocker locker(sSessionMap->GetMutex()); //operating on sOutputAttr
@@ -1173,6 +1228,75 @@ void DoDescribeAddRequiredSDPLines(QTSS_StandardRTSP_Params* inParams, Reflector
 
 }
 
+// Offers an FEC track (see ReflectorFECEncoder) for every FEC protected stream: an
+// m= section of its own with the ulpfec payload, grouped with the stream it protects
+// by mid (RFC 5956). A source SDP that has mids of its own is left alone.
+// Returns false if there is no FEC track to offer.
+bool DoDescribeAddFECTracks(ReflectorSession* theSession, StrPtrLen* theSessionHeaders, StrPtrLen* theMediaHeaders, ResizeableStringFormatter* editedSessionHeaders, ResizeableStringFormatter* editedMediaHeaders)
+{
+	if ((theSessionHeaders->FindStringCase((char*)"a=mid:", NULL, true) != NULL) || (theMediaHeaders->FindStringCase((char*)"a=mid:", NULL, true) != NULL))
+		return false;
+
+	editedSessionHeaders->Put(*theSessionHeaders);
+
+	bool haveFECTracks = false;
+	for (UInt32 x = 0; x < theSession->GetNumStreams(); x++)
+	{
+		ReflectorStream* theStream = theSession->GetStreamByIndex(x);
+		if ((theStream == NULL) || !theStream->IsFECProtected())
+			continue;
+
+		UInt32 theTrackID = theStream->GetStreamInfo()->fTrackID;
+		editedSessionHeaders->PutFmtStr("a=group:FEC %" _U32BITARG_ " %" _U32BITARG_ "\r\n", theTrackID, theTrackID + ReflectorFECEncoder::kTrackIDOffset);
+		haveFECTracks = true;
+	}
+
+	if (!haveFECTracks)
+		return false;
+
+	// the protected tracks get a mid after their control line
+	StringParser theMediaParser(theMediaHeaders);
+	StrPtrLen theLine;
+	while (theMediaParser.GetDataRemaining() > 0)
+	{
+		theMediaParser.GetThruEOL(&theLine);
+		editedMediaHeaders->Put(theLine);
+		editedMediaHeaders->PutEOL();
+
+		if (!theLine.NumEqualIgnoreCase("a=control:trackID=", 18))
+			continue;
+
+		StringParser theLineParser(&theLine);
+		theLineParser.GetThru(NULL, '=');
+		theLineParser.GetThru(NULL, '=');
+		UInt32 theTrackID = theLineParser.ConsumeInteger(NULL);
+		if (theSession->GetStreamCookie(theTrackID + ReflectorFECEncoder::kTrackIDOffset) != NULL)
+			editedMediaHeaders->PutFmtStr("a=mid:%" _U32BITARG_ "\r\n", theTrackID);
+	}
+
+	for (UInt32 x = 0; x < theSession->GetNumStreams(); x++)
+	{
+		ReflectorStream* theStream = theSession->GetStreamByIndex(x);
+		if ((theStream == NULL) || !theStream->IsFECProtected())
+			continue;
+
+		// the parity packets run on the clock of the media they protect
+		StringParser thePayloadParser(&theStream->GetStreamInfo()->fPayloadName);
+		thePayloadParser.GetThru(NULL, '/');
+		UInt32 theClockRate = thePayloadParser.ConsumeInteger(NULL);
+		if (theClockRate == 0)
+			theClockRate = 90000;
+
+		UInt32 theFECTrackID = theStream->GetStreamInfo()->fTrackID + ReflectorFECEncoder::kTrackIDOffset;
+		editedMediaHeaders->PutFmtStr("m=video 0 RTP/AVP %d\r\n", ReflectorFECEncoder::kPayloadType);
+		editedMediaHeaders->PutFmtStr("a=rtpmap:%d ulpfec/%" _U32BITARG_ "\r\n", ReflectorFECEncoder::kPayloadType, theClockRate);
+		editedMediaHeaders->PutFmtStr("a=control:trackID=%" _U32BITARG_ "\r\n", theFECTrackID);
+		editedMediaHeaders->PutFmtStr("a=mid:%" _U32BITARG_ "\r\n", theFECTrackID);
+	}
+
+	return true;
+}
+
 QTSS_Error DoDescribe(QTSS_StandardRTSP_Params* inParams)
 {
 	UInt32 theRefCount = 0;
@@ -1307,15 +1431,27 @@ QTSS_Error DoDescribe(QTSS_StandardRTSP_Params* inParams)
 	SDPLineSorter sortedSDP(&checkedSDPContainer, adjustMediaBandwidthPercent, insertMediaLines);
 	delete insertMediaLines;
 
+	// ------------ Offer FEC tracks
+
+	StrPtrLen theSessionHeaders(*sortedSDP.GetSessionHeaders());
+	StrPtrLen theMediaHeaders(*sortedSDP.GetMediaHeaders());
+	ResizeableStringFormatter fecSessionHeaders(NULL, 0);
+	ResizeableStringFormatter fecMediaHeaders(NULL, 0);
+	if (DoDescribeAddFECTracks(theSession, &theSessionHeaders, &theMediaHeaders, &fecSessionHeaders, &fecMediaHeaders))
+	{
+		theSessionHeaders.Set(fecSessionHeaders.GetBufPtr(), fecSessionHeaders.GetBytesWritten());
+		theMediaHeaders.Set(fecMediaHeaders.GetBufPtr(), fecMediaHeaders.GetBytesWritten());
+	}
+
 	// ------------ Write the SDP 
 
-	UInt32 sessLen = sortedSDP.GetSessionHeaders()->Len;
-	UInt32 mediaLen = sortedSDP.GetMediaHeaders()->Len;
-	theDescribeVec[1].iov_base = sortedSDP.GetSessionHeaders()->Ptr;
-	theDescribeVec[1].iov_len = sortedSDP.GetSessionHeaders()->Len;
+	UInt32 sessLen = theSessionHeaders.Len;
+	UInt32 mediaLen = theMediaHeaders.Len;
+	theDescribeVec[1].iov_base = theSessionHeaders.Ptr;
+	theDescribeVec[1].iov_len = theSessionHeaders.Len;
 
-	theDescribeVec[2].iov_base = sortedSDP.GetMediaHeaders()->Ptr;
-	theDescribeVec[2].iov_len = sortedSDP.GetMediaHeaders()->Len;
+	theDescribeVec[2].iov_base = theMediaHeaders.Ptr;
+	theDescribeVec[2].iov_len = theMediaHeaders.Len;
 
 	(void)QTSS_AppendRTSPHeader(inParams->inRTSPRequest, qtssCacheControlHeader,
 		kCacheControlHeader.Ptr, kCacheControlHeader.Len);
@@ -1571,27 +1707,14 @@ void DeleteReflectorPushSession(QTSS_StandardRTSP_Params* inParams, ReflectorSes
 
 QTSS_Error AddRTPStream(ReflectorSession* theSession, QTSS_StandardRTSP_Params* inParams, QTSS_RTPStreamObject *newStreamPtr)
 {
-	// Ok, this is completely crazy but I can't think of a better way to do this that's
-	// safe so we'll do it this way for now. Because the ReflectorStreams use this session's
-	// stream queue, we need to make sure that each ReflectorStream is not reflecting to this
-	// session while we call QTSS_AddRTPStream. One brutal way to do this is to grab each
-	// ReflectorStream's mutex, which will stop every reflector stream from running.
+	// The broadcaster's client session is never one of the ReflectorStreams' outputs,
+	// so no sender can be walking its stream array while we add to it.
 	Assert(newStreamPtr != NULL);
 
-	if (theSession != NULL)
-		for (UInt32 x = 0; x < theSession->GetNumStreams(); x++)
-			theSession->GetStreamByIndex(x)->GetMutex()->Lock();
-
 	//
 	// Turn off reliable UDP transport, because we are not yet equipped to
 	// do overbuffering.
-	QTSS_Error theErr = QTSS_AddRTPStream(inParams->inClientSession, inParams->inRTSPRequest, newStreamPtr, qtssASFlagsForceUDPTransport);
-
-	if (theSession != NULL)
-		for (UInt32 y = 0; y < theSession->GetNumStreams(); y++)
-			theSession->GetStreamByIndex(y)->GetMutex()->Unlock();
-
-	return theErr;
+	return QTSS_AddRTPStream(inParams->inClientSession, inParams->inRTSPRequest, newStreamPtr, qtssASFlagsForceUDPTransport);
 }
 
 QTSS_Error DoSetup(QTSS_StandardRTSP_Params* inParams)
@@ -1722,10 +1845,14 @@ QTSS_Error DoSetup(QTSS_StandardRTSP_Params* inParams)
 	}
 
 
+	// An FEC track offered by DoDescribeAddFECTracks is set up with the info of the track it protects
+	bool isFECTrack = (theTrackID >= ReflectorFECEncoder::kTrackIDOffset);
+	UInt32 theMediaTrackID = isFECTrack ? theTrackID - ReflectorFECEncoder::kTrackIDOffset : theTrackID;
+
 	// Get info about this trackID
-	SourceInfo::StreamInfo* theStreamInfo = theSession->GetSourceInfo()->GetStreamInfoByTrackID(theTrackID);
+	SourceInfo::StreamInfo* theStreamInfo = theSession->GetSourceInfo()->GetStreamInfoByTrackID(theMediaTrackID);
 	// If theStreamInfo is NULL, we don't have a legit track, so return an error
-	if (theStreamInfo == NULL)
+	if ((theStreamInfo == NULL) || (isFECTrack && (theSession->GetStreamCookie(theTrackID) == NULL)))
 		return QTSSModuleUtils::SendErrorResponse(inParams->inRTSPRequest, qtssClientBadRequest,
 			sReflectorBadTrackIDErr);
 
@@ -1739,22 +1866,30 @@ QTSS_Error DoSetup(QTSS_StandardRTSP_Params* inParams)
 	if (theStreamInfo->fTimeScale == 0)
 		theStreamInfo->fTimeScale = 90000;
 
-	QTSS_RTPStreamObject newStream = NULL;
+	char theFECPayloadNameBuf[32];
+	StrPtrLen theFECPayloadName;
+	if (isFECTrack)
 	{
-		// Ok, this is completely crazy but I can't think of a better way to do this that's
-		// safe so we'll do it this way for now. Because the ReflectorStreams use this session's
-		// stream queue, we need to make sure that each ReflectorStream is not reflecting to this
-		// session while we call QTSS_AddRTPStream. One brutal way to do this is to grab each
-		// ReflectorStream's mutex, which will stop every reflector stream from running.
+		qtss_snprintf(theFECPayloadNameBuf, sizeof(theFECPayloadNameBuf), "ulpfec/%" _U32BITARG_, theStreamInfo->fTimeScale);
+		theFECPayloadName.Set(theFECPayloadNameBuf);
+		thePayloadName = &theFECPayloadName;
+		thePayloadType = qtssUnknownPayloadType;
+	}
 
-		for (UInt32 x = 0; x < theSession->GetNumStreams(); x++)
-			theSession->GetStreamByIndex(x)->GetMutex()->Lock();
+	QTSS_RTPStreamObject newStream = NULL;
+	{
+		// The ReflectorStreams write to this session through its RTPSessionOutput, which
+		// walks the session's stream array. They do that holding the output's mutex, so
+		// holding it here keeps them out while QTSS_AddRTPStream grows the array.
+		RTPSessionOutput** theSessionOutput = NULL;
+		theLen = 0;
+		(void)QTSS_GetValuePtr(inParams->inClientSession, sOutputAttr, 0, (void**)&theSessionOutput, &theLen);
+		OSMutex* theOutputMutex = NULL;
+		if ((theLen == sizeof(RTPSessionOutput*)) && (theSessionOutput != NULL) && (*theSessionOutput != NULL))
+			theOutputMutex = &(*theSessionOutput)->fMutex;
 
+		OSMutexLocker locker(theOutputMutex);
 		theErr = QTSS_AddRTPStream(inParams->inClientSession, inParams->inRTSPRequest, &newStream, 0);
-
-		for (UInt32 y = 0; y < theSession->GetNumStreams(); y++)
-			theSession->GetStreamByIndex(y)->GetMutex()->Unlock();
-
 		if (theErr != QTSS_NoErr)
 			return theErr;
 	}
@@ -1807,14 +1942,9 @@ bool HaveStreamBuffers(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inS
 		return false;
 
 	bool haveBufferedStreams = true; // set to false and return if we can't set the packets
-	UInt32 y = 0;
 
 	SInt64 packetArrivalTime = 0;
 
-	//lock all streams
-	for (y = 0; y < inSession->GetNumStreams(); y++)
-		inSession->GetStreamByIndex(y)->GetMutex()->Lock();
-
 	QTSS_RTPStreamObject* theRef = NULL;
 	UInt32 theLen = 0;
 	UInt32 theStreamIndex = 0;
@@ -1822,7 +1952,16 @@ bool HaveStreamBuffers(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inS
 		QTSS_GetValuePtr(inParams->inClientSession, qtssCliSesStreamObjects, theStreamIndex, (void**)&theRef, &theLen) == QTSS_NoErr;
 		theStreamIndex++)
 	{
-		ReflectorStream* theReflectorStream = inSession->GetStreamByIndex(theStreamIndex);
+		// The client may not have set up every track, or may have set up an FEC track,
+		// so its streams are matched by the cookie DoSetup gave them
+		void** theStreamCookie = NULL;
+		UInt32 theCookieLen = 0;
+		(void)QTSS_GetValuePtr(*theRef, sStreamCookieAttr, 0, (void**)&theStreamCookie, &theCookieLen);
+
+		bool isFECStream = false;
+		ReflectorStream* theReflectorStream = NULL;
+		if ((theStreamCookie != NULL) && (theCookieLen == sizeof(void*)))
+			theReflectorStream = inSession->GetStreamByCookie(*theStreamCookie, &isFECStream);
 
 		//  if (!theReflectorStream->HasFirstRTCP())
 		//      printf("theStreamIndex =%"   _U32BITARG_   " no rtcp\n", theStreamIndex);
@@ -1840,7 +1979,10 @@ bool HaveStreamBuffers(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inS
 		UInt16 firstSeqNum = 0;
 		UInt32 firstTimeStamp = 0;
 		ReflectorSender* theSender = theReflectorStream->GetRTPSender();
-		haveBufferedStreams = theSender->GetFirstPacketInfo(&firstSeqNum, &firstTimeStamp, &packetArrivalTime);
+		if (isFECStream)
+			haveBufferedStreams = theSender->GetFirstFECPacketInfo(&firstSeqNum, &firstTimeStamp);
+		else
+			haveBufferedStreams = theSender->GetFirstPacketInfo(&firstSeqNum, &firstTimeStamp, &packetArrivalTime);
 		//printf("theStreamIndex= %"   _U32BITARG_   " haveBufferedStreams=%d, seqnum=%d, timestamp=%"   _U32BITARG_   "\n", theStreamIndex, haveBufferedStreams, firstSeqNum, firstTimeStamp);
 
 		if (!haveBufferedStreams)
@@ -1857,9 +1999,6 @@ bool HaveStreamBuffers(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inS
 
 
 	}
-	//unlock all streams
-	for (y = 0; y < inSession->GetNumStreams(); y++)
-		inSession->GetStreamByIndex(y)->GetMutex()->Unlock();
 
 	return haveBufferedStreams;
 }
@@ -1891,6 +2030,10 @@ QTSS_Error DoPlay(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inSessio
 		if (theErr != QTSS_NoErr)
 			return QTSS_RequestFailed;
 
+		// Interleaved data from the pusher goes straight to the streams from now on,
+		// ProcessRTPData only sees it if the handler is gone
+		(void)Easy_SetRTSPIngestHandler(inParams->inRTSPSession, inParams->inClientSession, PushInterleavedPackets, inSession);
+
 		//qtss_printf("QTSSReflectorModule:SET for att err=%" _S32BITARG_ " id=%" _S32BITARG_ "\n",theErr,inParams->inRTSPSession);
 
 		// this code needs to be cleaned up
@@ -2130,6 +2273,22 @@ QTSS_Error DestroySession(QTSS_ClientSessionClosing_Params* inParams)
 	return QTSS_NoErr;
 }
 
+QTSS_Error ProcessRTCPPacket(QTSS_RTCPProcess_Params* inParams)
+{
+	// RTPStream has parsed the NACKs and key frame requests out of the packet already
+	if ((inParams->inNumLostSeqNums == 0) && !inParams->inKeyFrameRequested)
+		return QTSS_NoErr;
+
+	RTPSessionOutput** theOutput = NULL;
+	UInt32 theLen = 0;
+	QTSS_Error theErr = QTSS_GetValuePtr(inParams->inClientSession, sOutputAttr, 0, (void**)&theOutput, &theLen);
+	if ((theErr != QTSS_NoErr) || (theLen != sizeof(RTPSessionOutput*)) || (theOutput == NULL) || (*theOutput == NULL))
+		return QTSS_NoErr; // not one of our viewers
+
+	(*theOutput)->ProcessFeedback(inParams->inRTPStream, inParams->inLostSeqNums, inParams->inNumLostSeqNums, inParams->inKeyFrameRequested);
+	return QTSS_NoErr;
+}
+
 void RemoveOutput(ReflectorOutput* inOutput, ReflectorSession* theSession, bool killClients)
 {
 	// ReflectorSessionü,Ͷ˺Ϳͻ
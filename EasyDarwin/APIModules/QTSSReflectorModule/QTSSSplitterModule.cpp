@@ -522,20 +522,18 @@ QTSS_Error DoSetup(QTSS_StandardRTSP_Params* inParams, ReflectorSession* inSessi
 
     QTSS_RTPStreamObject newStream = NULL;
     {
-        // Ok, this is completely crazy but I can't think of a better way to do this that's
-        // safe so we'll do it this way for now. Because the ReflectorStreams use this session's
-        // stream queue, we need to make sure that each ReflectorStream is not reflecting to this
-        // session while we call QTSS_AddRTPStream. One brutal way to do this is to grab each
-        // ReflectorStream's mutex, which will stop every reflector stream from running.
-        
-        for (UInt32 x = 0; x < inSession->GetNumStreams(); x++)
-            inSession->GetStreamByIndex(x)->GetMutex()->Lock();
-            
-        theErr = QTSS_AddRTPStream(inParams->inClientSession, inParams->inRTSPRequest, &newStream, 0);
+        // The ReflectorStreams write to this session through its RTPSessionOutput, which
+        // walks the session's stream array. They do that holding the output's mutex, so
+        // holding it here keeps them out while QTSS_AddRTPStream grows the array.
+        RTPSessionOutput** theOutput = NULL;
+        UInt32 theLen = 0;
+        (void)QTSS_GetValuePtr(inParams->inClientSession, sOutputAttr, 0, (void**)&theOutput, &theLen);
+        OSMutex* theOutputMutex = NULL;
+        if ((theLen == sizeof(RTPSessionOutput*)) && (theOutput != NULL) && (*theOutput != NULL))
+            theOutputMutex = &(*theOutput)->fMutex;
 
-        for (UInt32 y = 0; y < inSession->GetNumStreams(); y++)
-            inSession->GetStreamByIndex(y)->GetMutex()->Unlock();
-            
+        OSMutexLocker locker(theOutputMutex);
+        theErr = QTSS_AddRTPStream(inParams->inClientSession, inParams->inRTSPRequest, &newStream, 0);
         if (theErr != QTSS_NoErr)
             return theErr;
     }
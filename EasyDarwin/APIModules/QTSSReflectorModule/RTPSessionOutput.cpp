@@ -70,6 +70,8 @@ static QTSS_AttributeID     sLastRTPTimeStampAttr = qtssIllegalAttrID;
 
 static QTSS_AttributeID     sLastRTCPTransmitAttr = qtssIllegalAttrID;
 
+static QTSS_AttributeID     sLastKeyFrameReplayAttr = qtssIllegalAttrID;
+
 RTPSessionOutput::RTPSessionOutput(QTSS_ClientSessionObject inClientSession, ReflectorSession* inReflectorSession,
 	QTSS_Object serverPrefs, QTSS_AttributeID inCookieAddrID)
 	: fClientSession(inClientSession),
@@ -116,6 +118,8 @@ void RTPSessionOutput::Register()
 	static char*        sStreamPacketCount = "qtssReflectorStreamPacketCount";
 	static char*        sStreamByteCount = "qtssReflectorStreamByteCount";
 
+	static char*        sLastKeyFrameReplay = "qtssReflectorStreamLastKeyFrameReplay";
+
 
 
 	(void)QTSS_AddStaticAttribute(qtssRTPStreamObjectType, sLastRTCPTransmit, NULL, qtssAttrDataTypeUInt16);
@@ -176,6 +180,9 @@ void RTPSessionOutput::Register()
 	(void)QTSS_AddStaticAttribute(qtssRTPStreamObjectType, sStreamByteCount, NULL, qtssAttrDataTypeUInt32);
 	(void)QTSS_IDForAttr(qtssRTPStreamObjectType, sStreamByteCount, &sStreamByteCountAttr);
 
+	(void)QTSS_AddStaticAttribute(qtssRTPStreamObjectType, sLastKeyFrameReplay, NULL, qtssAttrDataTypeSInt64);
+	(void)QTSS_IDForAttr(qtssRTPStreamObjectType, sLastKeyFrameReplay, &sLastKeyFrameReplayAttr);
+
 }
 
 bool RTPSessionOutput::IsPlaying()
@@ -484,7 +491,7 @@ QTSS_Error  RTPSessionOutput::TrackRTPPackets(QTSS_RTPStreamObject *theStreamPtr
 		return QTSS_NoErr;
 
 	ReflectorPacket packetContainer;
-	packetContainer.SetPacketData(inPacketStrPtr->Ptr, inPacketStrPtr->Len);
+	packetContainer.WrapPacketData(inPacketStrPtr->Ptr, inPacketStrPtr->Len);
 	packetContainer.fIsRTCP = false;
 	SInt64 *theTimePtr = NULL;
 	UInt32 theLen = 0;
@@ -607,7 +614,12 @@ QTSS_Error  RTPSessionOutput::WritePacket(StrPtrLen* inPacket, void* inStreamCoo
 			if (fBufferDelayMSecs > 0)
 				thePacket.packetTransmitTime += delayMSecs; // add buffer time where oldest buffered packet as now == 0 and newest is entire buffer time in the future.
 
-			writeErr = QTSS_Write(*theStreamPtr, &thePacket, inPacket->Len, NULL, inFlags | qtssWriteFlagsWriteBurstBegin);
+			// UDP packets go onto the thread's send batch, which the ReflectorSender flushes at the end of its pass
+			UInt32 theWriteFlags = inFlags | qtssWriteFlagsWriteBurstBegin;
+			if (this->IsUDP())
+				theWriteFlags |= qtssWriteFlagsBufferData;
+
+			writeErr = QTSS_Write(*theStreamPtr, &thePacket, inPacket->Len, NULL, theWriteFlags);
 			if (writeErr == QTSS_WouldBlock)
 			{
 				//qtss_printf("QTSS_Write == QTSS_WouldBlock\n");
@@ -772,6 +784,69 @@ bool RTPSessionOutput::PacketShouldBeThinned(QTSS_RTPStreamObject inStream, StrP
 	}
 }
 
+void RTPSessionOutput::ProcessFeedback(QTSS_RTPStreamObject inStream, UInt16* inSeqNums, UInt32 inNumSeqNums, bool inKeyFrameRequested)
+{
+	void** theStreamCookie = NULL;
+	UInt32 theLen = 0;
+	(void)QTSS_GetValuePtr(inStream, fCookieAttrID, 0, (void**)&theStreamCookie, &theLen);
+	if ((theStreamCookie == NULL) || (*theStreamCookie == NULL))
+		return;
+
+	// Parity packets are not kept in the history, so feedback on the FEC track goes unanswered
+	bool isFEC = false;
+	ReflectorStream* theStream = fReflectorSession->GetStreamByCookie(*theStreamCookie, &isFEC);
+	if ((theStream == NULL) || isFEC)
+		return;
+
+	SInt64 theCurrentTime = OS::Milliseconds();
+
+	// We send exactly what every viewer was sent, so the seq numbers NACKed are the source's
+	for (UInt32 x = 0; x < inNumSeqNums; x++)
+	{
+		ReflectorPacket* thePacket = theStream->GetPacketHistory()->GetPacket(inSeqNums[x]);
+		if (thePacket == NULL)
+			continue; // too old
+
+		QTSS_Error theErr = this->RetransmitPacket(inStream, thePacket, theCurrentTime);
+		thePacket->Release();
+		if (theErr == QTSS_WouldBlock)
+			return; // out of retransmit budget, the rest would be refused too
+	}
+
+	if (!inKeyFrameRequested)
+		return;
+
+	//
+	// We relay, so we can't make the source encode a key frame. The newest one in the
+	// GOP cache is the closest thing; a viewer asking over and over gets it once a second.
+	SInt64* theLastReplay = NULL;
+	theLen = 0;
+	(void)QTSS_GetValuePtr(inStream, sLastKeyFrameReplayAttr, 0, (void**)&theLastReplay, &theLen);
+	if ((theLastReplay != NULL) && (theLen == sizeof(SInt64)) && ((theCurrentTime - *theLastReplay) < kKeyFrameReplayIntervalMSec))
+		return;
+	(void)QTSS_SetValue(inStream, sLastKeyFrameReplayAttr, 0, &theCurrentTime, sizeof(theCurrentTime));
+
+	ReflectorPacket* thePackets[kMaxKeyFramePackets];
+	UInt32 theNumPackets = theStream->GetKeyFramePackets(thePackets, kMaxKeyFramePackets);
+	bool isBlocked = false;
+	for (UInt32 y = 0; y < theNumPackets; y++)
+	{
+		if (!isBlocked)
+			isBlocked = (this->RetransmitPacket(inStream, thePackets[y], theCurrentTime) == QTSS_WouldBlock);
+		thePackets[y]->Release();
+	}
+}
+
+QTSS_Error RTPSessionOutput::RetransmitPacket(QTSS_RTPStreamObject inStream, ReflectorPacket* inPacket, SInt64 inCurrentTime)
+{
+	QTSS_PacketStruct thePacket;
+	thePacket.packetData = inPacket->fPacketPtr.Ptr;
+	thePacket.packetTransmitTime = inCurrentTime;
+	thePacket.suggestedWakeupTime = -1;
+
+	return QTSS_Write(inStream, &thePacket, inPacket->fPacketPtr.Len, NULL, qtssWriteFlagsIsRTP | qtssWriteFlagsIsRetransmission);
+}
+
 void RTPSessionOutput::TearDown()
 {
 	QTSS_CliSesTeardownReason reason = qtssCliSesTearDownBroadcastEnded;
@@ -68,6 +68,16 @@ public:
 
 	void SetBufferDelay(UInt32 delay) { fBufferDelayMSecs = delay; }
 
+	// Answers a viewer's RTCP feedback on inStream: sends the packets it NACKed
+	// again, and replays the cached key frame if it asked for one.
+	void ProcessFeedback(QTSS_RTPStreamObject inStream, UInt16* inSeqNums, UInt32 inNumSeqNums, bool inKeyFrameRequested);
+
+	enum
+	{
+		kMaxKeyFramePackets = 256,      //UInt32
+		kKeyFrameReplayIntervalMSec = 1000  //SInt64, per stream
+	};
+
 private:
 
 	QTSS_ClientSessionObject fClientSession;
@@ -84,6 +94,7 @@ private:
 	void SetPacketSeqNumber(StrPtrLen* inPacket, UInt16 inSeqNumber);
 	bool PacketShouldBeThinned(QTSS_RTPStreamObject inStream, StrPtrLen* inPacket);
 	bool  FilterPacket(QTSS_RTPStreamObject *theStreamPtr, StrPtrLen* inPacket);
+	QTSS_Error RetransmitPacket(QTSS_RTPStreamObject inStream, ReflectorPacket* inPacket, SInt64 inCurrentTime);
 
 	UInt32 GetPacketRTPTime(StrPtrLen* packetStrPtr);
 	inline  bool PacketMatchesStream(void* inStreamCookie, QTSS_RTPStreamObject *theStreamPtr);
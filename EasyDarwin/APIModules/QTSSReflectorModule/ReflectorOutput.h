@@ -49,7 +49,7 @@ class ReflectorOutput
 {
 	public:
     
-		ReflectorOutput() : fBookmarkedPacketsElemsArray(NULL), fNumBookmarks(0), fAvailPosition(0), fLastIntervalMilliSec(5), fLastPacketTransmitTime(0) {}   
+		ReflectorOutput() : fBookmarkedPacketsElemsArray(NULL), fNumBookmarks(0), fAvailPosition(0), fLastIntervalMilliSec(5), fLastPacketTransmitTime(0), fPlayTime(0) {}   
 
         virtual ~ReflectorOutput() 
         {
@@ -73,6 +73,7 @@ class ReflectorOutput
 	private:
 		UInt64			fU64Seq;
 		bool			fNewOutput;
+		SInt64			fPlayTime;
 	public:
 		UInt64 outPutSeq()
 		{
@@ -98,6 +99,17 @@ class ReflectorOutput
 		{
 			fNewOutput = flag;
 		}
+
+		// when the output was added to its streams, at PLAY
+		SInt64 getPlayTime()
+		{
+			return fPlayTime;
+		}
+
+		void setPlayTime(SInt64 inTime)
+		{
+			fPlayTime = inTime;
+		}
 //end add
 
 
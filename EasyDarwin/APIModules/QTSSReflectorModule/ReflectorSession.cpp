@@ -28,6 +28,7 @@
 */
 
 #include "ReflectorSession.h"
+#include "ReflectorSessionCatalog.h"
 #include "SocketUtils.h"
 #include "OS.h"
 #include "QTSServerInterface.h"
@@ -57,7 +58,7 @@ FileDeleter::~FileDeleter()
 
 void ReflectorSession::Initialize()
 {
-	;
+	ReflectorSessionCatalog::Initialize();
 }
 
 ReflectorSession::ReflectorSession(StrPtrLen* inSourceID, UInt32 inChannelNum, SourceInfo* inInfo) : Task(),
@@ -73,7 +74,9 @@ ReflectorSession::ReflectorSession(StrPtrLen* inSourceID, UInt32 inChannelNum, S
 	fInitTimeMS(OS::Milliseconds()),
 	fNoneOutputStartTimeMS(OS::Milliseconds()),
 	fHasBufferedStreams(false),
-	fHasVideoKeyFrameUpdate(false)
+	fHasVideoKeyFrameUpdate(false),
+	fCatalogRefs(0),
+	fIsKilled(false)
 {
 	this->SetTaskName("ReflectorSession");
 
@@ -204,6 +207,11 @@ void ReflectorSession::AddBroadcasterClientSession(QTSS_StandardRTSP_Params* inP
 		}
 	}
 	fBroadcasterSession = inParams->inClientSession;
+
+	char* theFullURL = NULL;
+	(void)QTSS_GetValueAsString(inParams->inClientSession, qtssCliSesFullURL, 0, &theFullURL);
+	ReflectorSessionCatalog::Add(this, theFullURL);
+	delete[] theFullURL;
 }
 
 void    ReflectorSession::AddOutput(ReflectorOutput* inOutput, bool isClient)
@@ -292,6 +300,7 @@ void    ReflectorSession::RemoveSessionFromOutput(QTSS_ClientSessionObject inSes
 		((ReflectorSocket*)fStreamArray[x]->GetSocketPair()->GetSocketB())->RemoveBroadcasterSession(inSession);
 	}
 	fBroadcasterSession = NULL;
+	ReflectorSessionCatalog::Remove(this);
 }
 
 UInt32  ReflectorSession::GetBitRate()
@@ -310,6 +319,90 @@ UInt32  ReflectorSession::GetBitRate()
 	return retval;
 }
 
+UInt64  ReflectorSession::GetBytesReceived()
+{
+	UInt64 retval = 0;
+	if (fStreamArray)
+	{
+		for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+		{
+			if (fStreamArray[x])
+				retval += fStreamArray[x]->GetBytesReceived();
+		}
+	}
+	return retval;
+}
+
+UInt64  ReflectorSession::GetBytesReflected()
+{
+	UInt64 retval = 0;
+	if (fStreamArray)
+	{
+		for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+		{
+			if (fStreamArray[x])
+				retval += fStreamArray[x]->GetBytesReflected();
+		}
+	}
+	return retval;
+}
+
+UInt32  ReflectorSession::GetPacketMemory()
+{
+	UInt32 retval = 0;
+	if (fStreamArray)
+	{
+		for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+		{
+			if (fStreamArray[x])
+			{
+				retval += fStreamArray[x]->GetPacketMemory();
+			}
+		}
+	}
+	return retval;
+}
+
+UInt32  ReflectorSession::GetCopyRate()
+{
+	UInt32 retval = 0;
+	if (fStreamArray)
+	{
+		for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+		{
+			if (fStreamArray[x])
+			{
+				retval += fStreamArray[x]->GetCopyRate();
+			}
+		}
+	}
+	return retval;
+}
+
+void    ReflectorSession::GetGOPCacheStats(UInt32* outHits, UInt32* outMisses, UInt32* outFirstFrameMSec)
+{
+	UInt32 theHits = 0;
+	UInt32 theMisses = 0;
+	UInt32 theFirstFrameMSecTotal = 0;
+	if (fStreamArray)
+	{
+		for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+		{
+			if (fStreamArray[x])
+			{
+				ReflectorGOPCache* theCache = fStreamArray[x]->GetGOPCache();
+				theHits += theCache->GetHits();
+				theMisses += theCache->GetMisses();
+				theFirstFrameMSecTotal += theCache->GetFirstFrameMSecTotal();
+			}
+		}
+	}
+
+	*outHits = theHits;
+	*outMisses = theMisses;
+	*outFirstFrameMSec = (theHits > 0) ? theFirstFrameMSecTotal / theHits : 0;
+}
+
 bool ReflectorSession::Equal(SourceInfo* inInfo)
 {
 	return fSourceInfo->Equal(inInfo);
@@ -317,10 +410,35 @@ bool ReflectorSession::Equal(SourceInfo* inInfo)
 
 void*   ReflectorSession::GetStreamCookie(UInt32 inStreamID)
 {
+	bool isFEC = (inStreamID >= ReflectorFECEncoder::kTrackIDOffset);
+	if (isFEC)
+		inStreamID -= ReflectorFECEncoder::kTrackIDOffset;
+
 	for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
 	{
 		if (fSourceInfo->GetStreamInfo(x)->fTrackID == inStreamID)
-			return fStreamArray[x]->GetStreamCookie();
+		{
+			if (!isFEC)
+				return fStreamArray[x]->GetStreamCookie();
+			return fStreamArray[x]->IsFECProtected() ? fStreamArray[x]->GetFECStreamCookie() : NULL;
+		}
+	}
+	return NULL;
+}
+
+ReflectorStream* ReflectorSession::GetStreamByCookie(void* inCookie, bool* outIsFEC)
+{
+	for (UInt32 x = 0; x < fSourceInfo->GetNumStreams(); x++)
+	{
+		if (fStreamArray[x] == NULL)
+			continue;
+
+		if ((inCookie == fStreamArray[x]->GetStreamCookie()) || (inCookie == fStreamArray[x]->GetFECStreamCookie()))
+		{
+			if (outIsFEC != NULL)
+				*outIsFEC = (inCookie == fStreamArray[x]->GetFECStreamCookie());
+			return fStreamArray[x];
+		}
 	}
 	return NULL;
 }
@@ -344,8 +462,15 @@ SInt64 ReflectorSession::Run()
 {
 	EventFlags events = this->GetEvents();
 
-	if (events & Task::kKillEvent)
+	if ((events & Task::kKillEvent) || fIsKilled)
 	{
+		fIsKilled = true;
+		ReflectorSessionCatalog::Remove(this);
+
+		// A session listing may still be reading this session's stats
+		if (fCatalogRefs > 0)
+			return 10;
+
 		return -1;
 	}
 
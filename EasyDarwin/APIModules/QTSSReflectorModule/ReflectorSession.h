@@ -134,7 +134,18 @@ public:
 	// A ReflectorSession keeps track of the aggregate bit rate each
 	// stream is reflecting (RTP only). Initially, this will return 0
 	// until enough time passes to compute an accurate average.
-	UInt32          GetBitRate();
+	UInt32          GetBitRate();
+
+	// RTP bytes pushed to this session and RTP bytes it has written to its
+	// viewers since it started, over all streams
+	UInt64          GetBytesReceived();
+	UInt64          GetBytesReflected();
+	UInt32          GetPacketMemory();  // bytes of packet buffers held by all streams
+	UInt32          GetCopyRate();      // bytes per second copied into packet buffers
+
+	// New outputs that started with a GOP cache, ones that had to wait for a key
+	// frame, and the average milliseconds from PLAY to the replay for the former
+	void            GetGOPCacheStats(UInt32* outHits, UInt32* outMisses, UInt32* outFirstFrameMSec);
 
 	// Returns true if this SourceInfo structure is equivalent to this
 	// ReflectorSession.
@@ -144,8 +155,13 @@ public:
 	// to an output, this cookie is used to identify which stream is writing the packet.
 	// The below function is useful so outputs can get the cookie value for a stream ID,
 	// and therefore mux the cookie to the right output stream.
+	// An FEC track's ID (see ReflectorFECEncoder) gets the cookie of the parity packets
+	// protecting its media track, or NULL if that track isn't protected.
 	void*   GetStreamCookie(UInt32 inStreamID);
 
+	// The stream a cookie belongs to, and whether it is the stream's FEC cookie
+	ReflectorStream* GetStreamByCookie(void* inCookie, bool* outIsFEC);
+
 	//Reflector quality levels:
 	enum
 	{
@@ -195,6 +211,12 @@ private:
 	bool		fHasBufferedStreams;
 	bool		fHasVideoKeyFrameUpdate;
 
+	// Catalog entries that point at this session, see ReflectorSessionCatalog.h.
+	// Once killed, the session waits for them to go before deleting itself.
+	friend class ReflectorSessionCatalog;
+	unsigned int	fCatalogRefs;
+	bool			fIsKilled;
+
 private:
 	virtual SInt64 Run();
 };
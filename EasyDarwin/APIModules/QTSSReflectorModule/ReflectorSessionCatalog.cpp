@@ -0,0 +1,228 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       ReflectorSessionCatalog.cpp
+
+	Contains:   Implementation of object defined in ReflectorSessionCatalog.h.
+*/
+
+#include "ReflectorSessionCatalog.h"
+#include "ReflectorSession.h"
+#include "atomic.h"
+#include "OSCounters.h"
+#include "ResizeableStringFormatter.h"
+
+OSMutex ReflectorSessionCatalog::sWriteMutex;
+OSMutex ReflectorSessionCatalog::sSnapshotMutex;
+ReflectorSessionCatalog::Snapshot* ReflectorSessionCatalog::sSnapshot = NULL;
+UInt32 ReflectorSessionCatalog::sVersion = 0;
+
+static char* CopyString(const char* inString)
+{
+	if (inString == NULL)
+		inString = "";
+
+	UInt32 theLen = ::strlen(inString);
+	char* theCopy = new char[theLen + 1];
+	::memcpy(theCopy, inString, theLen + 1);
+	return theCopy;
+}
+
+ReflectorSessionCatalog::Entry::Entry(ReflectorSession* inSession, const char* inURL)
+	: fSession(inSession),
+	fName(CopyString(inSession->GetStreamName()->Ptr)),
+	fURL(CopyString(inURL)),
+	fChannel(inSession->GetChannelNum()),
+	fRefCount(0)
+{
+	// The session stays around until this entry is gone
+	(void)atomic_add(&fSession->fCatalogRefs, 1);
+}
+
+ReflectorSessionCatalog::Entry::~Entry()
+{
+	delete[] fName;
+	delete[] fURL;
+	(void)atomic_sub(&fSession->fCatalogRefs, 1);
+}
+
+ReflectorSessionCatalog::Snapshot::Snapshot(UInt32 inVersion, UInt32 inNumEntries)
+	: fEntries(NULL),
+	fNumEntries(inNumEntries),
+	fVersion(inVersion),
+	fRefCount(1)
+{
+	if (inNumEntries > 0)
+		fEntries = new Entry*[inNumEntries];
+}
+
+ReflectorSessionCatalog::Snapshot::~Snapshot()
+{
+	delete[] fEntries;
+}
+
+void ReflectorSessionCatalog::Initialize()
+{
+	OSMutexLocker locker(&sWriteMutex);
+	if (sSnapshot == NULL)
+		Publish(new Snapshot(sVersion, 0));
+}
+
+UInt32 ReflectorSessionCatalog::Find(Snapshot* inSnapshot, const char* inName, UInt32 inChannel)
+{
+	if (inSnapshot == NULL)
+		return 0;
+
+	UInt32 theLow = 0;
+	UInt32 theHigh = inSnapshot->fNumEntries;
+	while (theLow < theHigh)
+	{
+		UInt32 theMid = theLow + (theHigh - theLow) / 2;
+		Entry* theEntry = inSnapshot->fEntries[theMid];
+
+		int theResult = ::strcmp(theEntry->fName, inName);
+		if ((theResult < 0) || ((theResult == 0) && (theEntry->fChannel < inChannel)))
+			theLow = theMid + 1;
+		else
+			theHigh = theMid;
+	}
+	return theLow;
+}
+
+void ReflectorSessionCatalog::Add(ReflectorSession* inSession, const char* inURL)
+{
+	OSMutexLocker locker(&sWriteMutex);
+
+	Entry* theNewEntry = new Entry(inSession, inURL);
+
+	// Only writers change sSnapshot, so it can be read here without sSnapshotMutex
+	Snapshot* theOld = sSnapshot;
+	UInt32 theOldCount = (theOld == NULL) ? 0 : theOld->fNumEntries;
+	UInt32 theIndex = Find(theOld, theNewEntry->fName, theNewEntry->fChannel);
+
+	bool isReplacing = (theIndex < theOldCount)
+		&& (::strcmp(theOld->fEntries[theIndex]->fName, theNewEntry->fName) == 0)
+		&& (theOld->fEntries[theIndex]->fChannel == theNewEntry->fChannel);
+
+	Snapshot* theNew = new Snapshot(++sVersion, isReplacing ? theOldCount : theOldCount + 1);
+	UInt32 theOut = 0;
+	for (UInt32 x = 0; x < theIndex; x++)
+		theNew->fEntries[theOut++] = theOld->fEntries[x];
+	theNew->fEntries[theOut++] = theNewEntry;
+	for (UInt32 y = isReplacing ? theIndex + 1 : theIndex; y < theOldCount; y++)
+		theNew->fEntries[theOut++] = theOld->fEntries[y];
+
+	Publish(theNew);
+}
+
+void ReflectorSessionCatalog::Remove(ReflectorSession* inSession)
+{
+	OSMutexLocker locker(&sWriteMutex);
+
+	Snapshot* theOld = sSnapshot;
+	if (theOld == NULL)
+		return;
+
+	UInt32 theIndex = Find(theOld, inSession->GetStreamName()->Ptr, inSession->GetChannelNum());
+	if ((theIndex == theOld->fNumEntries) || (theOld->fEntries[theIndex]->fSession != inSession))
+		return;
+
+	Snapshot* theNew = new Snapshot(++sVersion, theOld->fNumEntries - 1);
+	UInt32 theOut = 0;
+	for (UInt32 x = 0; x < theOld->fNumEntries; x++)
+	{
+		if (x != theIndex)
+			theNew->fEntries[theOut++] = theOld->fEntries[x];
+	}
+
+	Publish(theNew);
+}
+
+void ReflectorSessionCatalog::Publish(Snapshot* inSnapshot)
+{
+	for (UInt32 x = 0; x < inSnapshot->fNumEntries; x++)
+		(void)atomic_add(&inSnapshot->fEntries[x]->fRefCount, 1);
+
+	Snapshot* theOld = NULL;
+	{
+		OSMutexLocker locker(&sSnapshotMutex);
+		theOld = sSnapshot;
+		sSnapshot = inSnapshot;
+	}
+
+	// Readers still walking the old snapshot keep it, and the entries only it holds
+	if (theOld != NULL)
+		Release(theOld);
+}
+
+ReflectorSessionCatalog::Snapshot* ReflectorSessionCatalog::GetSnapshot()
+{
+	OSMutexLocker locker(&sSnapshotMutex);
+	if (sSnapshot == NULL)
+		return NULL;
+
+	(void)atomic_add(&sSnapshot->fRefCount, 1);
+	return sSnapshot;
+}
+
+void ReflectorSessionCatalog::Release(Snapshot* inSnapshot)
+{
+	if (atomic_sub(&inSnapshot->fRefCount, 1) != 0)
+		return;
+
+	for (UInt32 x = 0; x < inSnapshot->fNumEntries; x++)
+		Release(inSnapshot->fEntries[x]);
+	delete inSnapshot;
+}
+
+void ReflectorSessionCatalog::WriteMetrics(StringFormatter* ioOut)
+{
+	Snapshot* theSnapshot = GetSnapshot();
+	if (theSnapshot == NULL)
+		return;
+
+	//The labels of every entry, written once and used for each metric
+	char** theLabels = new char*[theSnapshot->fNumEntries + 1];
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+	{
+		Entry* theEntry = theSnapshot->fEntries[x];
+		ResizeableStringFormatter theLabel(NULL, 0);
+		theLabel.Put("stream=\"");
+		OSCounters::PutLabelValue(&theLabel, theEntry->GetName());
+		theLabel.PutFmtStr("\",channel=\"%" _U32BITARG_ "\"", theEntry->GetChannel());
+		theLabel.PutTerminator();
+		theLabels[x] = CopyString(theLabel.GetBufPtr());
+	}
+
+	OSCounters::WriteHeader(ioOut, "easydarwin_stream_received_bytes_total", "counter", "RTP bytes pushed to the stream");
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+		OSCounters::WriteValue(ioOut, "easydarwin_stream_received_bytes_total", theLabels[x], (SInt64)theSnapshot->fEntries[x]->GetSession()->GetBytesReceived());
+
+	OSCounters::WriteHeader(ioOut, "easydarwin_stream_reflected_bytes_total", "counter", "RTP bytes written to all viewers of the stream");
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+		OSCounters::WriteValue(ioOut, "easydarwin_stream_reflected_bytes_total", theLabels[x], (SInt64)theSnapshot->fEntries[x]->GetSession()->GetBytesReflected());
+
+	OSCounters::WriteHeader(ioOut, "easydarwin_stream_bitrate_bits", "gauge", "RTP bits per second pushed to the stream, averaged over the last 30 seconds");
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+		OSCounters::WriteValue(ioOut, "easydarwin_stream_bitrate_bits", theLabels[x], (SInt64)theSnapshot->fEntries[x]->GetSession()->GetBitRate());
+
+	OSCounters::WriteHeader(ioOut, "easydarwin_stream_viewers", "gauge", "Viewers of the stream");
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+		OSCounters::WriteValue(ioOut, "easydarwin_stream_viewers", theLabels[x], (SInt64)theSnapshot->fEntries[x]->GetSession()->GetNumOutputs());
+
+	for (UInt32 x = 0; x < theSnapshot->fNumEntries; x++)
+		delete[] theLabels[x];
+	delete[] theLabels;
+	Release(theSnapshot);
+}
+
+void ReflectorSessionCatalog::Release(Entry* inEntry)
+{
+	if (atomic_sub(&inEntry->fRefCount, 1) == 0)
+		delete inEntry;
+}
@@ -0,0 +1,113 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       ReflectorSessionCatalog.h
+
+	Contains:   The list of pushed sessions the live session API reports.
+
+				Every change publishes a new, versioned snapshot of the list,
+				sorted by stream name and channel. Readers take a reference
+				to the current snapshot and walk it without any server lock,
+				so listing thousands of sessions never holds up the session
+				map that every DESCRIBE, SETUP and PLAY goes through.
+
+				A session that is still in some snapshot is not deleted
+				until the last reader releases that snapshot.
+*/
+
+#ifndef __REFLECTOR_SESSION_CATALOG_H__
+#define __REFLECTOR_SESSION_CATALOG_H__
+
+#include "OSHeaders.h"
+#include "OSMutex.h"
+
+class ReflectorSession;
+class StringFormatter;
+
+class ReflectorSessionCatalog
+{
+public:
+
+	class Entry
+	{
+	public:
+
+		ReflectorSession*	GetSession() { return fSession; }
+		char*				GetName() { return fName; }
+		char*				GetURL() { return fURL; }
+		UInt32				GetChannel() { return fChannel; }
+
+	private:
+
+		friend class ReflectorSessionCatalog;
+
+		Entry(ReflectorSession* inSession, const char* inURL);
+		~Entry();
+
+		ReflectorSession*	fSession;
+		char*				fName;
+		char*				fURL;
+		UInt32				fChannel;
+		unsigned int		fRefCount;	// snapshots holding this entry
+	};
+
+	class Snapshot
+	{
+	public:
+
+		UInt32		GetVersion() { return fVersion; }
+		UInt32		GetNumEntries() { return fNumEntries; }
+		Entry*		GetEntry(UInt32 inIndex) { return fEntries[inIndex]; }
+
+	private:
+
+		friend class ReflectorSessionCatalog;
+
+		Snapshot(UInt32 inVersion, UInt32 inNumEntries);
+		~Snapshot();
+
+		Entry**			fEntries;
+		UInt32			fNumEntries;
+		UInt32			fVersion;
+		unsigned int	fRefCount;	// readers, plus one while it is the current snapshot
+	};
+
+	// Called by ReflectorSession::Initialize. Until then there is no snapshot.
+	static void			Initialize();
+
+	// Lists inSession as pushed from inURL, replacing any entry with the
+	// same stream name and channel.
+	static void			Add(ReflectorSession* inSession, const char* inURL);
+
+	// Takes inSession off the list. Does nothing if it is not listed.
+	static void			Remove(ReflectorSession* inSession);
+
+	// Returns the current snapshot, or NULL if the reflector is not loaded.
+	// Every snapshot returned must be given back to Release.
+	static Snapshot*	GetSnapshot();
+	static void			Release(Snapshot* inSnapshot);
+
+	// Writes per stream byte counters, bit rates and viewer counts in the
+	// Prometheus text format, labelled with the stream name and channel
+	static void			WriteMetrics(StringFormatter* ioOut);
+
+private:
+
+	static void			Publish(Snapshot* inSnapshot);
+	static void			Release(Entry* inEntry);
+
+	// Index of the first entry that does not sort before inName and inChannel
+	static UInt32		Find(Snapshot* inSnapshot, const char* inName, UInt32 inChannel);
+
+	static OSMutex		sWriteMutex;	// serializes Add and Remove
+	static OSMutex		sSnapshotMutex;	// held just long enough to take a reference to sSnapshot
+	static Snapshot*	sSnapshot;
+	static UInt32		sVersion;
+};
+
+#endif //__REFLECTOR_SESSION_CATALOG_H__
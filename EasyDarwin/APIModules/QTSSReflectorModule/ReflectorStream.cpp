@@ -33,6 +33,13 @@
 #include "SocketUtils.h"
 #include "RTCPPacket.h"
 #include "ReflectorSession.h"
+#include "QTSServerInterface.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 
 #if DEBUG
@@ -55,8 +62,15 @@ static UInt32					sDefaultRTPReflectorThresholdMsec = 2000;
 
 static UInt32                   sDefaultBucketDelayInMsec = 73;
 static bool						sDefaultUsePacketReceiveTime = false;
+static bool						sDefaultUseKernelArrivalTime = true;
 static UInt32                   sDefaultMaxFuturePacketTimeSec = 60;
 static UInt32                   sDefaultFirstPacketOffsetMsec = 500;
+static UInt32                   sDefaultOutputsPerShard = 500;
+static UInt32                   sDefaultGOPCacheMSec = 10000;
+static UInt32                   sDefaultGOPCacheKBytes = 4096;
+static UInt32                   sDefaultNACKHistoryPackets = 1024;
+static UInt32                   sDefaultFECWindowPackets = 10;
+static UInt32                   sDefaultFECParityPackets = 0;
 
 UInt32                          ReflectorStream::sBucketSize = 16;
 UInt32                          ReflectorStream::sOverBufferInMsec = 10000; // more or less what the client over buffer will be
@@ -67,9 +81,21 @@ UInt32                          ReflectorStream::sMaxFuturePacketSec = 60; // ma
 UInt32                          ReflectorStream::sOverBufferInSec = 10;
 UInt32                          ReflectorStream::sBucketDelayInMsec = 73;
 bool							ReflectorStream::sUsePacketReceiveTime = false;
+bool							ReflectorStream::sUseKernelArrivalTime = true;
 UInt32                          ReflectorStream::sFirstPacketOffsetMsec = 500;
 
 UInt32                          ReflectorStream::sRelocatePacketAgeMSec = 1000;
+UInt32                          ReflectorStream::sOutputsPerShard = 500;
+
+unsigned int                    ReflectorSender::sShardThreadPicker = 0;
+
+UInt32                          ReflectorGOPCache::sMaxMSec = 10000;
+UInt32                          ReflectorGOPCache::sMaxBytes = 4096 * 1024;
+
+UInt32                          ReflectorPacketHistory::sNumPackets = 1024;
+
+UInt32                          ReflectorFECEncoder::sWindowPackets = 10;
+UInt32                          ReflectorFECEncoder::sParityPackets = 0;
 
 void ReflectorStream::Register()
 {
@@ -103,12 +129,57 @@ void ReflectorStream::Initialize(QTSS_ModulePrefsObject inPrefs)
 	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_use_in_packet_receive_time", qtssAttrDataTypeBool16,
 		&ReflectorStream::sUsePacketReceiveTime, &sDefaultUsePacketReceiveTime, sizeof(sDefaultUsePacketReceiveTime));
 
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_use_kernel_arrival_time", qtssAttrDataTypeBool16,
+		&ReflectorStream::sUseKernelArrivalTime, &sDefaultUseKernelArrivalTime, sizeof(sDefaultUseKernelArrivalTime));
+
 	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_in_packet_max_receive_sec", qtssAttrDataTypeUInt32,
 		&ReflectorStream::sMaxFuturePacketSec, &sDefaultMaxFuturePacketTimeSec, sizeof(sDefaultMaxFuturePacketTimeSec));
 
 	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_rtp_info_offset_msec", qtssAttrDataTypeUInt32,
 		&ReflectorStream::sFirstPacketOffsetMsec, &sDefaultFirstPacketOffsetMsec, sizeof(sDefaultFirstPacketOffsetMsec));
 
+	// 0 keeps every stream's fan-out on its socket's thread
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_outputs_per_shard", qtssAttrDataTypeUInt32,
+		&ReflectorStream::sOutputsPerShard, &sDefaultOutputsPerShard, sizeof(sDefaultOutputsPerShard));
+
+	// 0 turns the GOP cache off
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_gop_cache_msec", qtssAttrDataTypeUInt32,
+		&ReflectorGOPCache::sMaxMSec, &sDefaultGOPCacheMSec, sizeof(sDefaultGOPCacheMSec));
+
+	UInt32 theGOPCacheKBytes = 0;
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_gop_cache_kbytes", qtssAttrDataTypeUInt32,
+		&theGOPCacheKBytes, &sDefaultGOPCacheKBytes, sizeof(sDefaultGOPCacheKBytes));
+	ReflectorGOPCache::sMaxBytes = theGOPCacheKBytes * 1024;
+
+	// 0 turns NACK retransmission off. Rounded up to a power of 2.
+	UInt32 theHistoryPackets = 0;
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_nack_history_packets", qtssAttrDataTypeUInt32,
+		&theHistoryPackets, &sDefaultNACKHistoryPackets, sizeof(sDefaultNACKHistoryPackets));
+	if (theHistoryPackets > 65536)
+		theHistoryPackets = 65536;
+	ReflectorPacketHistory::sNumPackets = 0;
+	if (theHistoryPackets > 0)
+	{
+		ReflectorPacketHistory::sNumPackets = 1;
+		while (ReflectorPacketHistory::sNumPackets < theHistoryPackets)
+			ReflectorPacketHistory::sNumPackets <<= 1;
+	}
+
+	// 0 parity packets turns FEC off
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_fec_window_packets", qtssAttrDataTypeUInt32,
+		&ReflectorFECEncoder::sWindowPackets, &sDefaultFECWindowPackets, sizeof(sDefaultFECWindowPackets));
+	if (ReflectorFECEncoder::sWindowPackets < 2)
+		ReflectorFECEncoder::sWindowPackets = 2;
+	if (ReflectorFECEncoder::sWindowPackets > ReflectorFECEncoder::kMaxWindowPackets)
+		ReflectorFECEncoder::sWindowPackets = ReflectorFECEncoder::kMaxWindowPackets;
+
+	QTSSModuleUtils::GetAttribute(inPrefs, "reflector_fec_parity_packets", qtssAttrDataTypeUInt32,
+		&ReflectorFECEncoder::sParityPackets, &sDefaultFECParityPackets, sizeof(sDefaultFECParityPackets));
+	if (ReflectorFECEncoder::sParityPackets > ReflectorFECEncoder::kMaxParityPackets)
+		ReflectorFECEncoder::sParityPackets = ReflectorFECEncoder::kMaxParityPackets;
+	if (ReflectorFECEncoder::sParityPackets > ReflectorFECEncoder::sWindowPackets)
+		ReflectorFECEncoder::sParityPackets = ReflectorFECEncoder::sWindowPackets;
+
 	ReflectorStream::sOverBufferInMsec = sOverBufferInSec * 1000;
 	ReflectorStream::sMaxFuturePacketMSec = sMaxFuturePacketSec * 1000;
 	ReflectorStream::sMaxPacketAgeMSec = (UInt32)(sOverBufferInMsec * 10.0); //allow a little time before deleting.
@@ -129,10 +200,8 @@ ReflectorStream::ReflectorStream(SourceInfo::StreamInfo* inInfo)
 	fSockets(NULL),
 	fRTPSender(NULL, qtssWriteFlagsIsRTP),
 	fRTCPSender(NULL, qtssWriteFlagsIsRTCP),
-	fOutputArray(NULL),
-	fNumBuckets(kMinNumBuckets),
-	fNumElements(0),
-	fBucketMutex(),
+	fOutputSet(NewOutputSet(0)),
+	fOutputSetMutex(),
 
 	fDestRTCPAddr(0),
 	fDestRTCPPort(0),
@@ -140,6 +209,10 @@ ReflectorStream::ReflectorStream(SourceInfo::StreamInfo* inInfo)
 	fCurrentBitRate(0),
 	fLastBitRateSample(OS::Milliseconds()), // don't calculate our first bit rate until kBitRateAvgIntervalInMilSecs has passed!
 	fBytesSentInThisInterval(0),
+	fBytesReceived(0),
+	fBytesReflected(0),
+	fCurrentCopyRate(0),
+	fBytesCopiedInThisInterval(0),
 
 	fRTPChannel(-1),
 	fRTCPChannel(-1),
@@ -158,9 +231,6 @@ ReflectorStream::ReflectorStream(SourceInfo::StreamInfo* inInfo)
 
 	fStreamInfo.Copy(*inInfo);
 
-	// ALLOCATE BUCKET ARRAY
-	this->AllocateBucketArray(fNumBuckets);
-
 	// WRITE RTCP PACKET
 
 	//write as much of the RTCP RR as is possible right now (most of it never changes)
@@ -207,15 +277,15 @@ ReflectorStream::ReflectorStream(SourceInfo::StreamInfo* inInfo)
 		fDestRTCPAddr = fStreamInfo.fDestIPAddr;
 		fDestRTCPPort = fStreamInfo.fPort + 1;
 	}
-
-	pkeyFrameCache = new CKeyFrameCache(MAX_CACHE_SIZE);
-
 }
 
 
 ReflectorStream::~ReflectorStream()
 {
-	Assert(fNumElements == 0);
+	Assert(fOutputSet->fNumOutputs == 0);
+
+	fRTPSender.StopShards();
+	fRTCPSender.StopShards();
 
 	if (fSockets != NULL)
 	{
@@ -239,148 +309,149 @@ ReflectorStream::~ReflectorStream()
 			sSocketPool.DestructUDPSocketPair(fSockets);
 	}
 
-	// ͷŹؼ֡
-	if (pkeyFrameCache)
-	{
-		delete pkeyFrameCache;
-		pkeyFrameCache = NULL;
-	}
+	DeleteOutputSet(fOutputSet);
+}
 
-	//delete every client Bucket
-	for (UInt32 y = 0; y < fNumBuckets; y++)
-		delete[] fOutputArray[y];
-	delete[] fOutputArray;
+ReflectorStream::OutputSet* ReflectorStream::NewOutputSet(UInt32 inNumOutputs)
+{
+	UInt32 theSize = sizeof(OutputSet) + (sizeof(OutputEntry) * inNumOutputs);
+	OutputSet* theSet = (OutputSet*)new char[theSize];
+	theSet->fNumOutputs = inNumOutputs;
+	return theSet;
 }
 
-void ReflectorStream::AllocateBucketArray(UInt32 inNumBuckets)
+SInt32 ReflectorStream::FindBucket(OutputSet* inSet)
 {
-	Bucket* oldArray = fOutputArray;
-	//allocate the 2-dimensional array
-	fOutputArray = new Bucket[inNumBuckets];
-	for (UInt32 x = 0; x < inNumBuckets; x++)
+	//The set is in bucket order. Find the first bucket that has room, which may be
+	//one nobody is in anymore.
+	UInt32 theBucket = 0;
+	UInt32 theCount = 0;
+	for (UInt32 x = 0; x < inSet->fNumOutputs; x++)
 	{
-		fOutputArray[x] = new ReflectorOutput*[sBucketSize];
-		::memset(fOutputArray[x], 0, sizeof(ReflectorOutput*) * sBucketSize);
+		if (inSet->fEntries[x].fBucket != theBucket)
+		{
+			if (theCount < sBucketSize)
+				return theBucket;
+			theBucket++;
+			theCount = 0;
+			if (inSet->fEntries[x].fBucket != theBucket)
+				return theBucket;
+		}
+		theCount++;
 	}
+	return (theCount < sBucketSize) ? theBucket : theBucket + 1;
+}
 
-	//copy over the old information if there was an old array
-	if (oldArray != NULL)
+UInt32 ReflectorStream::GetBucketCount(OutputSet* inSet, UInt32 inBucket)
+{
+	UInt32 theCount = 0;
+	for (UInt32 x = 0; x < inSet->fNumOutputs; x++)
 	{
-		Assert(inNumBuckets > fNumBuckets);
-		for (UInt32 y = 0; y < fNumBuckets; y++)
-		{
-			::memcpy(fOutputArray[y], oldArray[y], sBucketSize * sizeof(ReflectorOutput*));
-			delete[] oldArray[y];
-		}
-		delete[] oldArray;
+		if (inSet->fEntries[x].fBucket == inBucket)
+			theCount++;
 	}
-	fNumBuckets = inNumBuckets;
+	return theCount;
 }
 
+void ReflectorStream::PublishOutputSet(OutputSet* inNewSet)
+{
+	OutputSet* theOldSet = fOutputSet;
+	fOutputSet = inNewSet;
+
+	//a sender may still be walking the old set
+	fOutputEpoch.Synchronize();
+	DeleteOutputSet(theOldSet);
+}
 
 SInt32 ReflectorStream::AddOutput(ReflectorOutput* inOutput, SInt32 putInThisBucket)
 {
-	OSMutexLocker locker(&fBucketMutex);
+	OSMutexLocker locker(&fOutputSetMutex);
+	OutputSet* theOldSet = fOutputSet;
 
 #if DEBUG
 	// We should never be adding an output twice to a stream
-	for (UInt32 dOne = 0; dOne < fNumBuckets; dOne++)
-		for (UInt32 dTwo = 0; dTwo < sBucketSize; dTwo++)
-			Assert(fOutputArray[dOne][dTwo] != inOutput);
+	for (UInt32 dOne = 0; dOne < theOldSet->fNumOutputs; dOne++)
+		Assert(theOldSet->fEntries[dOne].fOutput != inOutput);
 #endif
 	if (inOutput)
 	{
 		inOutput->setNewFlag(true);
+		inOutput->setPlayTime(OS::Milliseconds());
 	}
 
 	// If caller didn't specify a bucket, find a bucket
 	if (putInThisBucket < 0)
-		putInThisBucket = this->FindBucket();
+		putInThisBucket = FindBucket(theOldSet);
+	else if (GetBucketCount(theOldSet, putInThisBucket) >= sBucketSize)
+		return -1;  // There is no empty spot in the specified bucket. Return an error
 
 	Assert(putInThisBucket >= 0);
 
-	if (fNumBuckets <= (UInt32)putInThisBucket)
-		this->AllocateBucketArray(putInThisBucket * 2);
+	//keep the set in bucket order: the new output goes after the rest of its bucket
+	UInt32 theIndex = 0;
+	while ((theIndex < theOldSet->fNumOutputs) && (theOldSet->fEntries[theIndex].fBucket <= (UInt32)putInThisBucket))
+		theIndex++;
+
+	OutputSet* theNewSet = NewOutputSet(theOldSet->fNumOutputs + 1);
+	::memcpy(&theNewSet->fEntries[0], &theOldSet->fEntries[0], theIndex * sizeof(OutputEntry));
+	theNewSet->fEntries[theIndex].fOutput = inOutput;
+	theNewSet->fEntries[theIndex].fBucket = putInThisBucket;
+	::memcpy(&theNewSet->fEntries[theIndex + 1], &theOldSet->fEntries[theIndex], (theOldSet->fNumOutputs - theIndex) * sizeof(OutputEntry));
 
-	for (UInt32 y = 0; y < sBucketSize; y++)
-	{
-		if (fOutputArray[putInThisBucket][y] == NULL)
-		{
-			fOutputArray[putInThisBucket][y] = inOutput;
 #if REFLECTOR_STREAM_DEBUGGING 
-			qtss_printf("Adding new output (0x%lx) to bucket %" _S32BITARG_ ", index %" _S32BITARG_ ",\nnum buckets %li bucketSize: %li \n", (SInt32)inOutput, putInThisBucket, y, (SInt32)fNumBuckets, (SInt32)sBucketSize);
+	qtss_printf("Adding new output (0x%lx) to bucket %" _S32BITARG_ ", index %" _S32BITARG_ ",\nnum outputs %li bucketSize: %li \n", (SInt32)inOutput, putInThisBucket, theIndex, (SInt32)theNewSet->fNumOutputs, (SInt32)sBucketSize);
 #endif
-			fNumElements++;
-			return putInThisBucket;
-		}
-	}
-	// There was no empty spot in the specified bucket. Return an error
-	return -1;
+	this->PublishOutputSet(theNewSet);
+	return putInThisBucket;
 }
 
-SInt32 ReflectorStream::FindBucket()
+void  ReflectorStream::RemoveOutput(ReflectorOutput* inOutput)
 {
-	// If we need more buckets, allocate them.
-	if (fNumElements == (sBucketSize * fNumBuckets))
-		this->AllocateBucketArray(fNumBuckets * 2);
+	OSMutexLocker locker(&fOutputSetMutex);
+	OutputSet* theOldSet = fOutputSet;
+	Assert(theOldSet->fNumOutputs > 0);
+
+	UInt32 theIndex = 0;
+	while ((theIndex < theOldSet->fNumOutputs) && (theOldSet->fEntries[theIndex].fOutput != inOutput))
+		theIndex++;
 
-	//find the first open spot in the array
-	for (SInt32 putInThisBucket = 0; (UInt32)putInThisBucket < fNumBuckets; putInThisBucket++)
+	if (theIndex == theOldSet->fNumOutputs)
 	{
-		for (UInt32 y = 0; y < sBucketSize; y++)
-			if (fOutputArray[putInThisBucket][y] == NULL)
-				return putInThisBucket;
+		Assert(0);
+		return;
 	}
-	Assert(0);
-	return 0;
-}
-
-void  ReflectorStream::RemoveOutput(ReflectorOutput* inOutput)
-{
-	OSMutexLocker locker(&fBucketMutex);
-	Assert(fNumElements > 0);
 
-	//look at all the indexes in the array
-	for (UInt32 x = 0; x < fNumBuckets; x++)
-	{
-		for (UInt32 y = 0; y < sBucketSize; y++)
-		{
-			//The array may have blank spaces!
-			if (fOutputArray[x][y] == inOutput)
-			{
-				fOutputArray[x][y] = NULL;//just clear out the pointer
+	OutputSet* theNewSet = NewOutputSet(theOldSet->fNumOutputs - 1);
+	::memcpy(&theNewSet->fEntries[0], &theOldSet->fEntries[0], theIndex * sizeof(OutputEntry));
+	::memcpy(&theNewSet->fEntries[theIndex], &theOldSet->fEntries[theIndex + 1], (theNewSet->fNumOutputs - theIndex) * sizeof(OutputEntry));
 
 #if REFLECTOR_STREAM_DEBUGGING  
-				qtss_printf("Removing output %x from bucket %" _S32BITARG_ ", index %" _S32BITARG_ "\n", inOutput, x, y);
+	qtss_printf("Removing output %x from bucket %" _S32BITARG_ ", index %" _S32BITARG_ "\n", inOutput, theOldSet->fEntries[theIndex].fBucket, theIndex);
 #endif
-				fNumElements--;
-				return;
-			}
-		}
-	}
-	Assert(0);
+	//once this returns the senders are done with the output
+	this->PublishOutputSet(theNewSet);
+
+	//the output may still hold bookmarks into our senders' queues, and each one
+	//holds a reference on its packet
+	OSMutexLocker outputLocker(&inOutput->fMutex);
+	OSQueueElem* theBookmark = NULL;
+	while ((theBookmark = inOutput->GetBookMarkedPacket(&fRTPSender.fPacketQueue)) != NULL)
+		((ReflectorPacket*)theBookmark->GetEnclosingObject())->Release();
+	while ((theBookmark = inOutput->GetBookMarkedPacket(&fRTCPSender.fPacketQueue)) != NULL)
+		((ReflectorPacket*)theBookmark->GetEnclosingObject())->Release();
 }
 
 void  ReflectorStream::TearDownAllOutputs()
 {
+	OSMutexLocker locker(&fOutputSetMutex);
+	OutputSet* theSet = fOutputSet;
 
-	OSMutexLocker locker(&fBucketMutex);
-
-	//look at all the indexes in the array
-	for (UInt32 x = 0; x < fNumBuckets; x++)
+	for (UInt32 x = 0; x < theSet->fNumOutputs; x++)
 	{
-		for (UInt32 y = 0; y < sBucketSize; y++)
-		{
-			ReflectorOutput* theOutputPtr = fOutputArray[x][y];
-			//The array may have blank spaces!
-			if (theOutputPtr != NULL)
-			{
-				theOutputPtr->TearDown();
+		theSet->fEntries[x].fOutput->TearDown();
 #if REFLECTOR_STREAM_DEBUGGING  
-				qtss_printf("TearDownAllOutputs Removing output from bucket %" _S32BITARG_ ", index %" _S32BITARG_ "\n", x, y);
+		qtss_printf("TearDownAllOutputs Removing output from bucket %" _S32BITARG_ ", index %" _S32BITARG_ "\n", theSet->fEntries[x].fBucket, x);
 #endif
-			}
-		}
 	}
 }
 
@@ -528,74 +599,90 @@ void ReflectorStream::SendReceiverReport()
 
 void ReflectorStream::PushPacket(char *packet, UInt32 packetLen, bool isRTCP)
 {
-	FU_Head *head = (FU_Head*)&packet[13];
+	StrPtrLen thePacket(packet, packetLen);
+	this->PushPackets(&thePacket, 1, isRTCP);
+}
+
+void ReflectorStream::PushPackets(StrPtrLen* inPackets, UInt32 inNumPackets, bool isRTCP)
+{
+	ReflectorSocket* theSocket = (ReflectorSocket*)(isRTCP ? fSockets->GetSocketB() : fSockets->GetSocketA());
+	ReflectorPacket* thePackets[kPushBatchSize];
+	SInt64 theMilliseconds = OS::Milliseconds();
+	UInt32 theBytesCopied = 0;
 
-	if (packetLen > 0)
 	{
-		ReflectorPacket* thePacket = NULL;
-		if (isRTCP)
+		OSMutexLocker locker(theSocket->GetDemuxer()->GetMutex());
+		for (UInt32 theFirst = 0; theFirst < inNumPackets; theFirst += kPushBatchSize)
 		{
-			//qtss_printf("ReflectorStream::PushPacket RTCP packetlen = %"   _U32BITARG_   "\n",packetLen);
-			thePacket = ((ReflectorSocket*)fSockets->GetSocketB())->GetPacket();
-			if (thePacket == NULL)
-			{
-				//qtss_printf("ReflectorStream::PushPacket RTCP GetPacket() is NULL\n");
-				return;
-			}
+			UInt32 theBatchSize = inNumPackets - theFirst;
+			if (theBatchSize > kPushBatchSize)
+				theBatchSize = kPushBatchSize;
 
-			OSMutexLocker locker(((ReflectorSocket*)(fSockets->GetSocketB()))->GetDemuxer()->GetMutex());
-			thePacket->SetPacketData(packet, packetLen);
-			((ReflectorSocket*)fSockets->GetSocketB())->ProcessPacket(OS::Milliseconds(), thePacket, 0, 0);
-			((ReflectorSocket*)fSockets->GetSocketB())->Signal(Task::kIdleEvent);
-		}
-		else
-		{
-			//qtss_printf("ReflectorStream::PushPacket RTP packetlen = %"   _U32BITARG_   "\n",packetLen);
-			thePacket = ((ReflectorSocket*)fSockets->GetSocketA())->GetPacket();
-			if (thePacket == NULL)
+			theSocket->GetPackets(thePackets, theBatchSize);
+			UInt32 theNumUsed = 0;
+			for (UInt32 x = 0; x < theBatchSize; x++)
 			{
-				//qtss_printf("ReflectorStream::PushPacket GetPacket() is NULL\n");
-				return;
-			}
-
-			OSMutexLocker locker(((ReflectorSocket*)(fSockets->GetSocketA()))->GetDemuxer()->GetMutex());
-			thePacket->SetPacketData(packet, packetLen);
-
-			//if(this->fStreamInfo.fPayloadName.Equal("H264/90000"))
-			//{
-			//	if(head->nalu_type != 0)
-			//	{
-			//		pkeyFrameCache->PutOnePacket(packet,packetLen,head->nalu_type,head->s);
-			//	}
-			//}
+				StrPtrLen* thePacketData = &inPackets[theFirst + x];
+				if (thePacketData->Len == 0)
+				{
+					// ProcessPacket would take an empty packet for a drained socket
+					thePackets[x]->Release();
+					continue;
+				}
 
-			((ReflectorSocket*)fSockets->GetSocketA())->ProcessPacket(OS::Milliseconds(), thePacket, 0, 0);
-			((ReflectorSocket*)fSockets->GetSocketA())->Signal(Task::kIdleEvent);
+				thePackets[x]->SetPacketData(thePacketData->Ptr, thePacketData->Len);
+				theBytesCopied += thePacketData->Len;
+				theNumUsed++;
+				theSocket->ProcessPacket(theMilliseconds, thePackets[x], 0, 0);
+			}
+			theSocket->CountPackets(theNumUsed);
 		}
 	}
+
+	if (theBytesCopied == 0)
+		return;
+
+	(void)atomic_add(&fBytesCopiedInThisInterval, theBytesCopied);
+	theSocket->Signal(Task::kIdleEvent);
 }
 
 ReflectorSender::ReflectorSender(ReflectorStream* inStream, UInt32 inWriteFlag)
-	: fStream(inStream),
+	: fNumShardTasks(0),
+	fNumShardsInPass(0),
+	fShardsRunning(0),
+	fShardsStopped(false),
+	fPassLastPacket(NULL),
+	fPassKeyFramePacket(NULL),
+	fPassTime(0),
+	fPassInterval(0),
+	fPassNextTimeToRun(0),
+	fStream(inStream),
 	fWriteFlag(inWriteFlag),
 	fFirstNewPacketInQueue(NULL),
 	fFirstPacketInQueueForNewOutput(NULL),
-	fKeyFrameStartPacketElementPointer(NULL),
+	fGOPCache(),
+	fHistory(),
 	fHasNewPackets(false),
 	fNextTimeToRun(0),
 	fLastRRTime(0),
-	fSocketQueueElem()
+	fSocketQueueElem(),
+	fSocket(NULL)
 {
 	fSocketQueueElem.SetEnclosingObject(this);
+	::memset(fShards, 0, sizeof(fShards));
 }
 
 ReflectorSender::~ReflectorSender()
 {
-	//dequeue and delete every buffer
+	this->StopShards();
+	fGOPCache.Clear();
+	fHistory.Clear();
+
+	//dequeue every buffer and drop the queue's reference, the pool takes it back
 	while (fPacketQueue.GetLength() > 0)
 	{
 		ReflectorPacket* packet = (ReflectorPacket*)fPacketQueue.DeQueue()->GetEnclosingObject();
-		delete packet;
+		packet->Release();
 	}
 }
 
@@ -608,9 +695,10 @@ bool ReflectorSender::ShouldReflectNow(const SInt64& inCurrentTime, SInt64* ioWa
 	{
 		//We don't need to do work right now, but
 		//this stream must still communicate when it needs to be woken up next
-		SInt64 theWakeupTime = fNextTimeToRun + inCurrentTime;
+		//fNextTimeToRun is in real time, *ioWakeupTime is relative
+		SInt64 theWakeupTime = fNextTimeToRun - inCurrentTime;
 		//qtss_printf("ReflectorSender::ShouldReflectNow theWakeupTime=%qd newWakeUpTime=%qd  ioWakepTime=%qd\n", theWakeupTime, fNextTimeToRun + inCurrentTime,*ioWakeupTime);
-		if ((fNextTimeToRun > 0) && (theWakeupTime < *ioWakeupTime))
+		if ((fNextTimeToRun > 0) && ((*ioWakeupTime == 0) || (theWakeupTime < *ioWakeupTime)))
 			*ioWakeupTime = theWakeupTime;
 		return false;
 	}
@@ -621,7 +709,7 @@ UInt32 ReflectorSender::GetOldestPacketRTPTime(bool *foundPtr)
 {
 	if (foundPtr != NULL)
 		*foundPtr = false;
-	OSMutexLocker locker(&fStream->fBucketMutex);
+	OSMutexLocker locker(this->GetQueueMutex());
 	OSQueueElem* packetElem = this->GetClientBufferStartPacket();
 	if (packetElem == NULL)
 		return 0;
@@ -642,7 +730,7 @@ UInt16 ReflectorSender::GetFirstPacketRTPSeqNum(bool *foundPtr)
 		*foundPtr = false;
 
 	UInt16 resultSeqNum = 0;
-	OSMutexLocker locker(&fStream->fBucketMutex);
+	OSMutexLocker locker(this->GetQueueMutex());
 	OSQueueElem* packetElem = this->GetClientBufferStartPacket();
 
 	if (packetElem == NULL)
@@ -671,15 +759,19 @@ OSQueueElem*    ReflectorSender::GetClientBufferNextPacketTime(UInt32 inRTPTime)
 	{
 		elem = qIter.GetCurrent();
 
-		if (requestedPacket == NULL)
-			requestedPacket = elem;
-
-		if (requestedPacket == NULL)
-			break;
-
 		ReflectorPacket* thePacket = (ReflectorPacket*)elem->GetEnclosingObject();
 		Assert(thePacket);
 
+		// parity packets have sequence numbers of their own
+		if (thePacket->fIsFEC)
+		{
+			qIter.Next();
+			continue;
+		}
+
+		if (requestedPacket == NULL)
+			requestedPacket = elem;
+
 		if (thePacket->GetPacketRTPTime() > inRTPTime)
 		{
 			requestedPacket = elem; // return the first packet we have that has a later time
@@ -695,7 +787,7 @@ OSQueueElem*    ReflectorSender::GetClientBufferNextPacketTime(UInt32 inRTPTime)
 
 bool ReflectorSender::GetFirstRTPTimePacket(UInt16* outSeqNumPtr, UInt32* outRTPTimePtr, SInt64* outArrivalTimePtr)
 {
-	OSMutexLocker locker(&fStream->fBucketMutex);
+	OSMutexLocker locker(this->GetQueueMutex());
 	OSQueueElem* packetElem = this->GetClientBufferStartPacketOffset(ReflectorStream::sFirstPacketOffsetMsec);
 
 	if (packetElem == NULL)
@@ -727,9 +819,12 @@ bool ReflectorSender::GetFirstRTPTimePacket(UInt16* outSeqNumPtr, UInt32* outRTP
 
 bool ReflectorSender::GetFirstPacketInfo(UInt16* outSeqNumPtr, UInt32* outRTPTimePtr, SInt64* outArrivalTimePtr)
 {
-	OSMutexLocker locker(&fStream->fBucketMutex);
-	OSQueueElem* packetElem = this->GetClientBufferStartPacketOffset(ReflectorStream::sFirstPacketOffsetMsec);
-	//    OSQueueElem* packetElem = this->GetClientBufferStartPacket();
+	OSMutexLocker locker(this->GetQueueMutex());
+
+	//a new output starts with the GOP cache when there is one
+	OSQueueElem* packetElem = fGOPCache.GetFirstPacket();
+	if (packetElem == NULL)
+		packetElem = this->GetClientBufferStartPacketOffset(ReflectorStream::sFirstPacketOffsetMsec);
 
 	if (packetElem == NULL)
 		return false;
@@ -752,6 +847,38 @@ bool ReflectorSender::GetFirstPacketInfo(UInt16* outSeqNumPtr, UInt32* outRTPTim
 	return true;
 }
 
+bool ReflectorSender::GetFirstFECPacketInfo(UInt16* outSeqNumPtr, UInt32* outRTPTimePtr)
+{
+	OSMutexLocker locker(this->GetQueueMutex());
+
+	//where GetFirstPacketInfo starts a new output
+	OSQueueElem* packetElem = fGOPCache.GetFirstPacket();
+	if (packetElem == NULL)
+		packetElem = this->GetClientBufferStartPacketOffset(ReflectorStream::sFirstPacketOffsetMsec);
+
+	if (packetElem == NULL)
+		return false;
+
+	ReflectorPacket* theStartPacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
+	ReflectorPacket* thePacket = NULL;
+	for (OSQueueIter qIter(&fPacketQueue, packetElem); !qIter.IsDone(); qIter.Next())
+	{
+		thePacket = (ReflectorPacket*)qIter.GetCurrent()->GetEnclosingObject();
+		if (thePacket->fIsFEC)
+			break;
+		thePacket = NULL;
+	}
+
+	//no parity packet made since then, the output starts with the next one
+	if (outSeqNumPtr)
+		*outSeqNumPtr = (thePacket != NULL) ? thePacket->GetPacketRTPSeqNum() : fFEC.GetNextSeqNum();
+
+	if (outRTPTimePtr)
+		*outRTPTimePtr = (thePacket != NULL) ? thePacket->GetPacketRTPTime() : theStartPacket->GetPacketRTPTime();
+
+	return true;
+}
+
 
 #if REFLECTOR_STREAM_DEBUGGING
 static UInt16 DGetPacketSeqNumber(StrPtrLen* inPacket)
@@ -769,7 +896,7 @@ static UInt16 DGetPacketSeqNumber(StrPtrLen* inPacket)
 #endif
 
 
-void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue)
+void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime)
 {
 	//Most of this code is useless i.e. buckets and bookmarks. This code will get cleaned up eventually
 
@@ -798,12 +925,13 @@ void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQ
 #endif	
 	}
 
-	//the rest of this function must be atomic wrt the ReflectorSession, because
-	//it involves iterating through the RTPSession array, which isn't thread safe
-	OSMutexLocker locker(&fStream->fBucketMutex);
+	//Walk the output set as it is now. Outputs added or removed while we run don't
+	//wait for us, and the ones being removed stay alive until we leave the read section.
+	OSEpochReader reader(&fStream->fOutputEpoch);
+	ReflectorStream::OutputSet* theOutputSet = fStream->fOutputSet;
 
-	// Check to see if we should update the session's bitrate average
-	if ((fStream->fLastBitRateSample + ReflectorStream::kBitRateAvgIntervalInMilSecs) < currentTime)
+	// Check to see if we should update the session's bitrate average (the RTCP sender leaves it to the RTP one)
+	if ((fWriteFlag == qtssWriteFlagsIsRTP) && ((fStream->fLastBitRateSample + ReflectorStream::kBitRateAvgIntervalInMilSecs) < currentTime))
 	{
 		unsigned int intervalBytes = fStream->fBytesSentInThisInterval;
 		(void)atomic_sub(&fStream->fBytesSentInThisInterval, intervalBytes);
@@ -817,143 +945,148 @@ void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQ
 		fStream->fLastBitRateSample = currentTime;
 	}
 
-	for (UInt32 bucketIndex = 0; bucketIndex < fStream->fNumBuckets; bucketIndex++)
+	for (UInt32 outputIndex = 0; outputIndex < theOutputSet->fNumOutputs; outputIndex++)
 	{
-		for (UInt32 bucketMemberIndex = 0; bucketMemberIndex < fStream->sBucketSize; bucketMemberIndex++)
-		{
-			ReflectorOutput* theOutput = fStream->fOutputArray[bucketIndex][bucketMemberIndex];
+		ReflectorOutput* theOutput = theOutputSet->fEntries[outputIndex].fOutput;
+		UInt32 bucketIndex = theOutputSet->fEntries[outputIndex].fBucket;
 
+		//the RTCP sender and RemoveOutput work on the same bookmarks
+		OSMutexLocker outputLocker(&theOutput->fMutex);
+		SInt32			availBookmarksPosition = -1;	// -1 == invalid position
+		OSQueueElem*	packetElem = NULL;
+		UInt32			curBookmark = 0;
 
-			if (theOutput != NULL)
-			{
-				SInt32			availBookmarksPosition = -1;	// -1 == invalid position
-				OSQueueElem*	packetElem = NULL;
-				UInt32			curBookmark = 0;
+		Assert(curBookmark < theOutput->fNumBookmarks);
 
-				Assert(curBookmark < theOutput->fNumBookmarks);
+		// see if we've bookmarked a held packet for this Sender in this Output
+		while (curBookmark < theOutput->fNumBookmarks)
+		{
+			OSQueueElem* 	bookmarkedElem = theOutput->fBookmarkedPacketsElemsArray[curBookmark];
 
-				// see if we've bookmarked a held packet for this Sender in this Output
-				while (curBookmark < theOutput->fNumBookmarks)
+			if (bookmarkedElem)	// there may be holes in this array
+			{
+				if (bookmarkedElem->IsMember(fPacketQueue))
 				{
-					OSQueueElem* 	bookmarkedElem = theOutput->fBookmarkedPacketsElemsArray[curBookmark];
-
-					if (bookmarkedElem)	// there may be holes in this array
-					{
-						if (bookmarkedElem->IsMember(fPacketQueue))
-						{
-							// this packet was previously bookmarked for this specific queue
-							// remove if from the bookmark list and use it
-							// to jump ahead into the Sender's over all packet queue						
-							theOutput->fBookmarkedPacketsElemsArray[curBookmark] = NULL;
-							availBookmarksPosition = curBookmark;
-							packetElem = bookmarkedElem;
-							break;
-						}
+					// this packet was previously bookmarked for this specific queue
+					// remove if from the bookmark list and use it
+					// to jump ahead into the Sender's over all packet queue						
+					theOutput->fBookmarkedPacketsElemsArray[curBookmark] = NULL;
+					availBookmarksPosition = curBookmark;
+					packetElem = bookmarkedElem;
+					//the bookmark's reference; the packet is still on our queue
+					((ReflectorPacket*)packetElem->GetEnclosingObject())->Release();
+					break;
+				}
 
-					}
-					else
-					{
-						availBookmarksPosition = curBookmark;
-					}
+			}
+			else
+			{
+				availBookmarksPosition = curBookmark;
+			}
 
-					curBookmark++;
+			curBookmark++;
 
-				}
+		}
 
-				Assert(availBookmarksPosition != -1);
+		Assert(availBookmarksPosition != -1);
 
 #if REFLECTOR_STREAM_DEBUGGING > 1
-				if (packetElem)	// show 'em what we got johnny
-				{
-					ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
-					printf("Bookmarked packet time: %li, packetSeq %i\n", (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
-				}
+		if (packetElem)	// show 'em what we got johnny
+		{
+			ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
+			printf("Bookmarked packet time: %li, packetSeq %i\n", (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
+		}
 #endif
 
-				// the output did not have a bookmarked packet if it's own
-				// so show it the first new packet we have in this sender.
-				// ( since TCP flow control may delay the sending of packets, this may not
-				// be the same as the first packet in the queue
-				if (packetElem == NULL)
-				{
-					packetElem = fFirstNewPacketInQueue;
+		// the output did not have a bookmarked packet if it's own
+		// so show it the first new packet we have in this sender.
+		// ( since TCP flow control may delay the sending of packets, this may not
+		// be the same as the first packet in the queue
+		if (packetElem == NULL)
+		{
+			packetElem = fFirstNewPacketInQueue;
 
 #if REFLECTOR_STREAM_DEBUGGING > 1
-					if (packetElem)	// show 'em what we got johnny
-					{
-						ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
-						printf("1st new packet from Sender sess 0x%lx time: %li, packetSeq %i\n", (SInt32)theOutput, (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
-					}
-					else
-						printf("no new packets\n");
+			if (packetElem)	// show 'em what we got johnny
+			{
+				ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
+				printf("1st new packet from Sender sess 0x%lx time: %li, packetSeq %i\n", (SInt32)theOutput, (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
+			}
+			else
+				printf("no new packets\n");
 #endif
-				}
+		}
 
-				OSQueueIter qIter(&fPacketQueue, packetElem);  // starts from beginning if packetElem == NULL, else from packetElem
+		OSQueueIter qIter(&fPacketQueue, packetElem);  // starts from beginning if packetElem == NULL, else from packetElem
 
-				bool			dodBookmarkPacket = false;
+		bool			dodBookmarkPacket = false;
 
-				while (!qIter.IsDone())
-				{
-					packetElem = qIter.GetCurrent();
+		while (!qIter.IsDone())
+		{
+			packetElem = qIter.GetCurrent();
 
-					ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
-					QTSS_Error			err = QTSS_NoErr;
+			ReflectorPacket* 	thePacket = (ReflectorPacket*)packetElem->GetEnclosingObject();
+			QTSS_Error			err = QTSS_NoErr;
 
 #if REFLECTOR_STREAM_DEBUGGING > 2
-					printf("packet time: %li, packetSeq %i\n", (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
+			printf("packet time: %li, packetSeq %i\n", (SInt32)thePacket->fTimeArrived, DGetPacketSeqNumber(&thePacket->fPacketPtr));
 #endif
 
-					// once we see a packet we cant' send, we need to stop trying
-					// during this pass mark remaining as still needed
-					if (!dodBookmarkPacket)
-					{
-						SInt64  packetLateness = currentTime - thePacket->fTimeArrived - (ReflectorStream::sBucketDelayInMsec * (SInt64)bucketIndex);
-						// packetLateness measures how late this packet it after being corrected for the bucket delay
+			// once we see a packet we cant' send, we need to stop trying
+			// during this pass mark remaining as still needed
+			if (!dodBookmarkPacket)
+			{
+				SInt64  packetLateness = currentTime - thePacket->fTimeArrived - (ReflectorStream::sBucketDelayInMsec * (SInt64)bucketIndex);
+				// packetLateness measures how late this packet it after being corrected for the bucket delay
 
 #if REFLECTOR_STREAM_DEBUGGING > 2
-						printf("packetLateness %li, seq# %li\n", (SInt32)packetLateness, (SInt32)DGetPacketSeqNumber(&thePacket->fPacketPtr));
+				printf("packetLateness %li, seq# %li\n", (SInt32)packetLateness, (SInt32)DGetPacketSeqNumber(&thePacket->fPacketPtr));
 #endif
 
-						SInt64 timeToSendPacket = -1;
-						err = theOutput->WritePacket(&thePacket->fPacketPtr, fStream, fWriteFlag, packetLateness, &timeToSendPacket, NULL, NULL, false);
+				SInt64 timeToSendPacket = -1;
+				void* theCookie = thePacket->fIsFEC ? fStream->GetFECStreamCookie() : fStream;
+				err = theOutput->WritePacket(&thePacket->fPacketPtr, theCookie, fWriteFlag, packetLateness, &timeToSendPacket, NULL, NULL, false);
 
-						if (err == QTSS_WouldBlock)
-						{
+				if (err == QTSS_WouldBlock)
+				{
 #if REFLECTOR_STREAM_DEBUGGING > 2
-							printf("EAGAIN bookmark: %li, packetSeq %i\n", (SInt32)packetLateness, DGetPacketSeqNumber(&thePacket->fPacketPtr));
+					printf("EAGAIN bookmark: %li, packetSeq %i\n", (SInt32)packetLateness, DGetPacketSeqNumber(&thePacket->fPacketPtr));
 #endif
-							// tag it and bookmark it
-							thePacket->fNeededByOutput = true;
-
-							Assert(availBookmarksPosition != -1);
-							if (availBookmarksPosition != -1)
-								theOutput->fBookmarkedPacketsElemsArray[availBookmarksPosition] = packetElem;
-
-							dodBookmarkPacket = true;
-
-							// call us again in # ms to retry on an EAGAIN
-							if ((timeToSendPacket > 0) && (fNextTimeToRun > timeToSendPacket))
-								fNextTimeToRun = timeToSendPacket;
-							if (timeToSendPacket == -1)
-								this->SetNextTimeToRun(5); // keep in synch with delay on would block for on-demand lower is better for high-bit rate movies.
+					// tag it and bookmark it
+					thePacket->fNeededByOutput = true;
 
-						}
-					}
-					else
+					Assert(availBookmarksPosition != -1);
+					if (availBookmarksPosition != -1)
 					{
-						if (thePacket->fNeededByOutput)	// optimization: if the packet is already marked, another Output has been through this already
-							break;
-						thePacket->fNeededByOutput = true;
+						thePacket->Retain();
+						theOutput->fBookmarkedPacketsElemsArray[availBookmarksPosition] = packetElem;
 					}
 
-					qIter.Next();
-				}
+					dodBookmarkPacket = true;
 
+					// call us again in # ms to retry on an EAGAIN
+					if ((timeToSendPacket > 0) && (fNextTimeToRun > timeToSendPacket))
+						fNextTimeToRun = timeToSendPacket;
+					if (timeToSendPacket == -1)
+						this->SetNextTimeToRun(5); // keep in synch with delay on would block for on-demand lower is better for high-bit rate movies.
+
+				}
+			}
+			else
+			{
+				if (thePacket->fNeededByOutput)	// optimization: if the packet is already marked, another Output has been through this already
+					break;
+				thePacket->fNeededByOutput = true;
 			}
+
+			qIter.Next();
 		}
+
 	}
 
+	// UDP outputs only queued their packets. Send them while the packets are still in the queue.
+	UDPSocket::FlushSendBatch();
+
 	// reset our first new packet bookmark
 	fFirstNewPacketInQueue = NULL;
 
@@ -972,11 +1105,11 @@ void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQ
 		ReflectorPacket* thePacket = (ReflectorPacket*)elem->GetEnclosingObject();
 		Assert(thePacket);
 
-		if (thePacket->fNeededByOutput == false)
+		if ((thePacket->fNeededByOutput == false) && !thePacket->IsShared())
 		{
 			thePacket->fNeededByOutput = true;
 			fPacketQueue.Remove(elem);
-			inFreeQueue->EnQueue(elem);
+			thePacket->Release();
 
 		}
 		else	// reset for next call to ReflectPackets
@@ -1018,17 +1151,20 @@ void ReflectorSender::ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQ
 /
 /
 /   intputs     ioWakeupTime - relative time to call us again in MSec
-/               inFreeQueue - queue of free packets.
 */
 
-void ReflectorSender::ReflectPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue)
+void ReflectorSender::ReflectPackets(SInt64* ioWakeupTime)
 {
 	if (!fStream->BufferEnabled()) // Call old routine for relays; they don't want buffering.
 	{
-		this->ReflectRelayPackets(ioWakeupTime, inFreeQueue);
+		this->ReflectRelayPackets(ioWakeupTime);
 		return;
 	}
 
+	//a sharded pass is still going, the last of its shards wakes our socket up
+	if (fShardsRunning > 0)
+		return;
+
 	SInt64 currentTime = OS::Milliseconds();
 
 	//make sure to reset these state variables
@@ -1046,27 +1182,14 @@ void ReflectorSender::ReflectPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue)
 		fStream->SendReceiverReport();
 	}
 
-	//the rest of this function must be atomic wrt the ReflectorSession, because
-	//it involves iterating through the RTPSession array, which isn't thread safe
-	OSMutexLocker locker(&fStream->fBucketMutex);
-
-	// Check to see if we should update the session's bitrate average
-	fStream->UpdateBitRate(currentTime);
-
-	// ƵֱӶλһؼ֡ʼƵʱһЩ
-
-	fFirstPacketInQueueForNewOutput = NULL;
-
-	if (fKeyFrameStartPacketElementPointer)
-	{
-		fFirstPacketInQueueForNewOutput = fKeyFrameStartPacketElementPointer;
-	}
+	// Check to see if we should update the session's bitrate average (the RTCP sender leaves it to the RTP one)
+	if (fWriteFlag == qtssWriteFlagsIsRTP)
+		fStream->UpdateBitRate(currentTime);
 
+	// new outputs start with the GOP cache, or at the buffer delay if there is none
+	fFirstPacketInQueueForNewOutput = fGOPCache.GetFirstPacket();
 	if (fFirstPacketInQueueForNewOutput == NULL)
-	{
-		// where to start new clients in the q
 		fFirstPacketInQueueForNewOutput = this->GetClientBufferStartPacketOffset(0);
-	}
 
 #if (0) //test code 
 	if (NULL != fFirstPacketInQueueForNewOutput)
@@ -1083,43 +1206,42 @@ void ReflectorSender::ReflectPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue)
 
 #endif
 
-	bool firstPacket = false;
+	fPassKeyFramePacket = fGOPCache.GetFirstPacket();
+	fPassTime = currentTime;
 
-	for (UInt32 bucketIndex = 0; bucketIndex < fStream->fNumBuckets; bucketIndex++)
+	UInt32 theNumShards = this->GetNumShards();
+	if ((theNumShards > 1) && (fPacketQueue.GetLength() > 0))
 	{
-		for (UInt32 bucketMemberIndex = 0; bucketMemberIndex < fStream->sBucketSize; bucketMemberIndex++)
-		{
-			ReflectorOutput* theOutput = fStream->fOutputArray[bucketIndex][bucketMemberIndex];
-			if (theOutput != NULL)
-			{
-				if (false == theOutput->IsPlaying())
-					continue;
-				{
-					OSMutexLocker locker(&theOutput->fMutex);
-					OSQueueElem* packetElem = theOutput->GetBookMarkedPacket(&fPacketQueue);
-					if (packetElem == NULL) // should only be a new output
-					{
-						packetElem = fFirstPacketInQueueForNewOutput; // everybody starts at the oldest packet in the buffer delay or uses a bookmark
-						firstPacket = true;
-						theOutput->setNewFlag(false);
-					}
+		//no shard is running, so this is the one safe moment to trim the queue
+		this->RemoveOldPackets();
+		fPassLastPacket = fPacketQueue.GetTail();
+		fPassInterval = fNextTimeToRun;
+		this->DispatchShards(theNumShards);
+		fFirstNewPacketInQueue = NULL;
+
+		//the last shard sets this and tells our socket
+		fNextTimeToRun = 0;
+		return;
+	}
 
-					SInt64  bucketDelay = ReflectorStream::sBucketDelayInMsec * (SInt64)bucketIndex;
-					packetElem = this->SendPacketsToOutput(theOutput, packetElem, currentTime, bucketDelay, firstPacket);
-					if (packetElem)
-					{
-						OSQueueElem* newElem = NeedRelocateBookMark(packetElem);
+	//Walk the output set as it is now. Outputs added or removed while we run don't
+	//wait for us, and the ones being removed stay alive until we leave the read section.
+	OSEpochReader reader(&fStream->fOutputEpoch);
+	ReflectorStream::OutputSet* theOutputSet = fStream->fOutputSet;
+	fPassLastPacket = NULL;
 
-						ReflectorPacket* thePacket = (ReflectorPacket*)newElem->GetEnclosingObject();
-						thePacket->fNeededByOutput = true; 				// flag to prevent removal in RemoveOldPackets
-						(void)theOutput->SetBookMarkPacket(newElem); 	// store a reference to the packet
-					}
-				}
-			}
-		}
-	}
+	SInt64 theFanOutStart = OS::Microseconds();
+	UInt32 theBytesSent = this->ReflectOutputs(theOutputSet, 0, theOutputSet->fNumOutputs, &fNextTimeToRun);
+
+	// UDP outputs only queued their packets. Send them while the packets are still in the queue.
+	UDPSocket::FlushSendBatch();
+
+	if (fWriteFlag == qtssWriteFlagsIsRTP)
+		fStream->fBytesReflected += theBytesSent;
+	if (theBytesSent > 0)
+		OSCounters::AddToHistogram(QTSServerInterface::kReflectorFanOutCounter, OS::Microseconds() - theFanOutStart);
 
-	this->RemoveOldPackets(inFreeQueue);
+	this->RemoveOldPackets();
 	fFirstNewPacketInQueue = NULL;
 
 	//Don't forget that the caller also wants to know when we next want to run
@@ -1135,7 +1257,159 @@ void ReflectorSender::ReflectPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue)
 
 }
 
-OSQueueElem*    ReflectorSender::SendPacketsToOutput(ReflectorOutput* theOutput, OSQueueElem* currentPacket, SInt64 currentTime, SInt64  bucketDelay, bool firstPacket)
+UInt32 ReflectorSender::ReflectOutputs(ReflectorOutputSet* inSet, UInt32 inFirst, UInt32 inEnd, SInt64* ioNextTimeToRun)
+{
+	UInt32 theBytesSent = 0;
+	for (UInt32 outputIndex = inFirst; outputIndex < inEnd; outputIndex++)
+	{
+		ReflectorOutput* theOutput = inSet->fEntries[outputIndex].fOutput;
+		UInt32 bucketIndex = inSet->fEntries[outputIndex].fBucket;
+		if (false == theOutput->IsPlaying())
+			continue;
+		{
+			OSMutexLocker locker(&theOutput->fMutex);
+			bool firstPacket = false;
+			OSQueueElem* packetElem = theOutput->GetBookMarkedPacket(&fPacketQueue);
+			if (packetElem != NULL) // the bookmark's reference; the packet is still on our queue
+				((ReflectorPacket*)packetElem->GetEnclosingObject())->Release();
+			if (packetElem == NULL) // should only be a new output
+			{
+				packetElem = fFirstPacketInQueueForNewOutput; // everybody starts at the oldest packet in the buffer delay or uses a bookmark
+				firstPacket = true;
+				theOutput->setNewFlag(false);
+
+				if (fGOPCache.HasStarted())
+				{
+					if (fPassKeyFramePacket != NULL)
+						fGOPCache.CountHit(fPassTime - theOutput->getPlayTime());
+					else
+						fGOPCache.CountMiss();
+				}
+			}
+
+			SInt64  bucketDelay = ReflectorStream::sBucketDelayInMsec * (SInt64)bucketIndex;
+			packetElem = this->SendPacketsToOutput(theOutput, packetElem, fPassTime, bucketDelay, firstPacket, fPassLastPacket, ioNextTimeToRun, &theBytesSent);
+			if (packetElem)
+			{
+				OSQueueElem* newElem = NeedRelocateBookMark(packetElem, fPassKeyFramePacket);
+
+				ReflectorPacket* thePacket = (ReflectorPacket*)newElem->GetEnclosingObject();
+				thePacket->fNeededByOutput = true; 				// flag to prevent removal in RemoveOldPackets
+				if (theOutput->fAvailPosition != -1)
+				{
+					thePacket->Retain();
+					(void)theOutput->SetBookMarkPacket(newElem); 	// store a reference to the packet
+				}
+			}
+		}
+	}
+	return theBytesSent;
+}
+
+UInt32 ReflectorSender::GetNumShards()
+{
+	if (fShardsStopped || (ReflectorStream::sOutputsPerShard == 0))
+		return 1;
+
+	UInt32 theNumShards = (fStream->GetEyeCount() + ReflectorStream::sOutputsPerShard - 1) / ReflectorStream::sOutputsPerShard;
+
+	//one slice per short task thread at most, more would only queue up behind each other
+	UInt32 theMaxShards = TaskThreadPool::GetNumShortTaskThreads();
+	if (theMaxShards > kMaxShards)
+		theMaxShards = kMaxShards;
+	if (theNumShards > theMaxShards)
+		theNumShards = theMaxShards;
+
+	return (theNumShards > 0) ? theNumShards : 1;
+}
+
+void ReflectorSender::DispatchShards(UInt32 inNumShards)
+{
+	Assert(fShardsRunning == 0);
+	Assert(inNumShards <= kMaxShards);
+
+	//shards are kept once made, each on its own thread
+	while (fNumShardTasks < inNumShards)
+	{
+		ReflectorShard* theShard = new ReflectorShard(this, fNumShardTasks);
+		UInt32 theThreadIndex = atomic_add(&sShardThreadPicker, 1) % TaskThreadPool::GetNumShortTaskThreads();
+		theShard->SetDefaultThread(TaskThreadPool::GetThread(theThreadIndex));
+		fShards[fNumShardTasks++] = theShard;
+	}
+
+	fPassNextTimeToRun = fPassInterval;
+	fNumShardsInPass = inNumShards;
+	fShardsRunning = inNumShards;
+
+	for (UInt32 x = 0; x < inNumShards; x++)
+		fShards[x]->Signal(Task::kStartEvent);
+}
+
+void ReflectorSender::ReflectShard(UInt32 inShardIndex)
+{
+	Assert(inShardIndex < fNumShardsInPass);
+
+	SInt64 theNextTimeToRun = fPassInterval;
+	SInt64 theFanOutStart = OS::Microseconds();
+	UInt32 theBytesSent = 0;
+	{
+		//An output added or removed since the pass began may land in two slices or in
+		//none. Two shards then take turns on it under its fMutex, and one it missed
+		//picks up from its bookmark next pass.
+		OSEpochReader reader(&fStream->fOutputEpoch);
+		ReflectorStream::OutputSet* theOutputSet = fStream->fOutputSet;
+		UInt32 theNumOutputs = theOutputSet->fNumOutputs;
+		UInt32 theFirst = (UInt32)(((UInt64)theNumOutputs * inShardIndex) / fNumShardsInPass);
+		UInt32 theEnd = (UInt32)(((UInt64)theNumOutputs * (inShardIndex + 1)) / fNumShardsInPass);
+
+		theBytesSent = this->ReflectOutputs(theOutputSet, theFirst, theEnd, &theNextTimeToRun);
+	}
+
+	// UDP outputs only queued their packets on this thread
+	UDPSocket::FlushSendBatch();
+	if (theBytesSent > 0)
+		OSCounters::AddToHistogram(QTSServerInterface::kReflectorFanOutCounter, OS::Microseconds() - theFanOutStart);
+
+	OSMutexLocker locker(this->GetQueueMutex());
+	if (fWriteFlag == qtssWriteFlagsIsRTP)
+		fStream->fBytesReflected += theBytesSent;
+	if (theNextTimeToRun < fPassNextTimeToRun)
+		fPassNextTimeToRun = theNextTimeToRun;
+
+	Assert(fShardsRunning > 0);
+	if (fShardsRunning > 1)
+	{
+		fShardsRunning--;
+		return;
+	}
+
+	//last one out
+	fShardsRunning = 0;
+	fNextTimeToRun = fPassTime + fPassNextTimeToRun;
+	if (fSocket != NULL)
+		fSocket->Signal(Task::kIdleEvent);
+}
+
+void ReflectorSender::StopShards()
+{
+	ReflectorShard* theShards[kMaxShards];
+	UInt32 theNumShards = 0;
+	{
+		//no more passes get dispatched after this
+		OSMutexLocker locker(this->GetQueueMutex());
+		fShardsStopped = true;
+		theNumShards = fNumShardTasks;
+		::memcpy(theShards, fShards, sizeof(theShards));
+		::memset(fShards, 0, sizeof(fShards));
+		fNumShardTasks = 0;
+	}
+
+	//shards of a pass in flight that have not run yet never will
+	for (UInt32 x = 0; x < theNumShards; x++)
+		theShards[x]->Detach();
+}
+
+OSQueueElem*    ReflectorSender::SendPacketsToOutput(ReflectorOutput* theOutput, OSQueueElem* currentPacket, SInt64 currentTime, SInt64  bucketDelay, bool firstPacket, OSQueueElem* inLastPacket, SInt64* ioNextTimeToRun, UInt32* ioBytesSent)
 {
 	OSQueueElem* lastPacket = currentPacket;
 	OSQueueIter qIter(&fPacketQueue, currentPacket);  // starts from beginning if currentPacket == NULL, else from currentPacket                
@@ -1153,30 +1427,32 @@ OSQueueElem*    ReflectorSender::SendPacketsToOutput(ReflectorOutput* theOutput,
 
 		//printf("packetLateness %qd, seq# %li\n", packetLateness, (SInt32) DGetPacketSeqNumber( &thePacket->fPacketPtr ) );          
 
-		err = theOutput->WritePacket(&thePacket->fPacketPtr, fStream, fWriteFlag, packetLateness, &timeToSendPacket, &thePacket->fStreamCountID, &thePacket->fTimeArrived, firstPacket);
+		//parity packets only go to the viewers that set up the FEC track
+		void* theCookie = thePacket->fIsFEC ? fStream->GetFECStreamCookie() : fStream;
+		err = theOutput->WritePacket(&thePacket->fPacketPtr, theCookie, fWriteFlag, packetLateness, &timeToSendPacket, &thePacket->fStreamCountID, &thePacket->fTimeArrived, firstPacket);
 
 		if (err == QTSS_WouldBlock)
 		{ // call us again in # ms to retry on an EAGAIN
 
-			if ((timeToSendPacket > 0) && ((fNextTimeToRun + currentTime) > timeToSendPacket)) // blocked but we are scheduled to wake up later
-				fNextTimeToRun = timeToSendPacket - currentTime;
+			if ((timeToSendPacket > 0) && ((*ioNextTimeToRun + currentTime) > timeToSendPacket)) // blocked but we are scheduled to wake up later
+				*ioNextTimeToRun = timeToSendPacket - currentTime;
 
 			if (theOutput->fLastIntervalMilliSec < 5)
 				theOutput->fLastIntervalMilliSec = 5;
 
 			if (timeToSendPacket < 0) // blocked and we are behind
 			{    //qtss_printf("fNextTimeToRun = theOutput->fLastIntervalMilliSec=%qd;\n", theOutput->fLastIntervalMilliSec); // Use the last packet interval 
-				this->SetNextTimeToRun(theOutput->fLastIntervalMilliSec);
+				*ioNextTimeToRun = theOutput->fLastIntervalMilliSec;
 			}
 
-			if (fNextTimeToRun > 100) //don't wait that long
+			if (*ioNextTimeToRun > 100) //don't wait that long
 			{    //qtss_printf("fNextTimeToRun = %qd now 100;\n", fNextTimeToRun);
-				this->SetNextTimeToRun(100);
+				*ioNextTimeToRun = 100;
 			}
 
-			if (fNextTimeToRun < 5) //wait longer
+			if (*ioNextTimeToRun < 5) //wait longer
 			{    //qtss_printf("fNextTimeToRun = 5;\n");
-				this->SetNextTimeToRun(5);
+				*ioNextTimeToRun = 5;
 			}
 
 			if (theOutput->fLastIntervalMilliSec >= 100) // allow up to 1 second max -- allow some time for the socket to clear and don't go into a tight loop if the client is gone.
@@ -1190,6 +1466,12 @@ OSQueueElem*    ReflectorSender::SendPacketsToOutput(ReflectorOutput* theOutput,
 		}
 
 		count++;
+		*ioBytesSent += thePacket->fPacketPtr.Len;
+
+		//anything newer arrived after the pass began, and may still be being linked in
+		if (currentPacket == inLastPacket)
+			break;
+
 		qIter.Next();
 
 	}
@@ -1197,24 +1479,460 @@ OSQueueElem*    ReflectorSender::SendPacketsToOutput(ReflectorOutput* theOutput,
 	return lastPacket;
 }
 
+ReflectorShard::ReflectorShard(ReflectorSender* inSender, UInt32 inShardIndex)
+	: Task(),
+	fMutex(),
+	fSender(inSender),
+	fShardIndex(inShardIndex)
+{
+	this->SetTaskName("ReflectorShard");
+}
 
-OSQueueElem* ReflectorSender::GetClientBufferStartPacketOffset(SInt64 offsetMsec, bool needKeyFrameFirstPacket)
+SInt64 ReflectorShard::Run()
 {
-	OSQueueIter qIter(&fPacketQueue);// start at oldest packet in q
-	SInt64 theCurrentTime = OS::Milliseconds();
-	SInt64 packetDelay = 0;
-	OSQueueElem* oldestPacketInClientBufferTime = NULL;
+	Task::EventFlags theEvents = this->GetEvents();
+	if (theEvents & Task::kKillEvent)
+		return -1;
 
+	OSMutexLocker locker(&fMutex);
+	if ((fSender != NULL) && (theEvents & Task::kStartEvent))
+		fSender->ReflectShard(fShardIndex);
 
-	while (!qIter.IsDone()) // start at oldest packet in q
-	{
-		OSQueueElem* elem = qIter.GetCurrent();
+	return 0;
+}
+
+void ReflectorShard::Detach()
+{
+	{
+		OSMutexLocker locker(&fMutex);
+		fSender = NULL;
+	}
+	this->Signal(Task::kKillEvent);
+}
+
+ReflectorGOPCache::ReflectorGOPCache()
+	: fPackets(NULL),
+	fNumPackets(0),
+	fCapacity(0),
+	fNumBytes(0),
+	fGroupRTPTime(0),
+	fHasStarted(false),
+	fHits(0),
+	fMisses(0),
+	fFirstFrameMSecTotal(0)
+{
+}
+
+ReflectorGOPCache::~ReflectorGOPCache()
+{
+	this->Clear();
+	delete[] fPackets;
+}
+
+bool ReflectorGOPCache::StartsNewGroup(ReflectorPacket* inPacket)
+{
+	//the SPS, the PPS and every slice of an IDR picture carry the same timestamp
+	return (!fHasStarted) || (inPacket->GetPacketRTPTime() != fGroupRTPTime);
+}
+
+void ReflectorGOPCache::StartGroup(ReflectorPacket* inPacket)
+{
+	this->Clear();
+	if (sMaxMSec == 0)
+		return;
+
+	fHasStarted = true;
+	fGroupRTPTime = inPacket->GetPacketRTPTime();
+	this->Append(inPacket);
+}
+
+void ReflectorGOPCache::AddPacket(ReflectorPacket* inPacket)
+{
+	if (fNumPackets == 0)
+		return; // no group yet, or it was dropped
+
+	//a group we can't hold whole is no use to a new output
+	if (((inPacket->fTimeArrived - fPackets[0]->fTimeArrived) > (SInt64)sMaxMSec) || ((fNumBytes + inPacket->fPacketPtr.Len) > sMaxBytes))
+	{
+		this->Clear();
+		return;
+	}
+
+	this->Append(inPacket);
+}
+
+void ReflectorGOPCache::Append(ReflectorPacket* inPacket)
+{
+	if (fNumPackets == fCapacity)
+	{
+		UInt32 theCapacity = (fCapacity > 0) ? fCapacity * 2 : (UInt32)kMinCapacity;
+		ReflectorPacket** thePackets = new ReflectorPacket*[theCapacity];
+		if (fNumPackets > 0)
+			::memcpy(thePackets, fPackets, fNumPackets * sizeof(ReflectorPacket*));
+		delete[] fPackets;
+		fPackets = thePackets;
+		fCapacity = theCapacity;
+	}
+
+	inPacket->Retain();
+	fPackets[fNumPackets++] = inPacket;
+	fNumBytes += inPacket->fPacketPtr.Len;
+}
+
+void ReflectorGOPCache::Clear()
+{
+	//the sender queue still holds its own reference on each of these
+	for (UInt32 x = 0; x < fNumPackets; x++)
+		fPackets[x]->Release();
+
+	fNumPackets = 0;
+	fNumBytes = 0;
+}
+
+UInt32 ReflectorGOPCache::GetKeyFramePackets(ReflectorPacket** outPackets, UInt32 inMaxPackets)
+{
+	//a video group starts with its key frame, and every packet of it has the same timestamp
+	UInt32 theNumPackets = 0;
+	while ((theNumPackets < fNumPackets) && (theNumPackets < inMaxPackets) && (fPackets[theNumPackets]->GetPacketRTPTime() == fGroupRTPTime))
+	{
+		fPackets[theNumPackets]->Retain();
+		outPackets[theNumPackets] = fPackets[theNumPackets];
+		theNumPackets++;
+	}
+	return theNumPackets;
+}
+
+void ReflectorGOPCache::CountHit(SInt64 inFirstFrameMSec)
+{
+	if (inFirstFrameMSec < 0)
+		inFirstFrameMSec = 0;
+
+	(void)atomic_add(&fHits, 1);
+	(void)atomic_add(&fFirstFrameMSecTotal, (unsigned int)inFirstFrameMSec);
+}
+
+ReflectorPacketHistory::ReflectorPacketHistory()
+	: fPackets(NULL),
+	fMask(0)
+{
+}
+
+ReflectorPacketHistory::~ReflectorPacketHistory()
+{
+	this->Clear();
+	delete[] fPackets;
+}
+
+void ReflectorPacketHistory::AddPacket(ReflectorPacket* inPacket)
+{
+	ReflectorPacket* theOldPacket = NULL;
+	{
+		OSMutexLocker locker(&fMutex);
+		if (fPackets == NULL)
+		{
+			if (sNumPackets == 0)
+				return;
+
+			fPackets = new ReflectorPacket*[sNumPackets];
+			::memset(fPackets, 0, sNumPackets * sizeof(ReflectorPacket*));
+			fMask = sNumPackets - 1;
+		}
+
+		UInt32 theIndex = inPacket->GetPacketRTPSeqNum() & fMask;
+		theOldPacket = fPackets[theIndex];
+		inPacket->Retain();
+		fPackets[theIndex] = inPacket;
+	}
+
+	//the last release of a packet takes the pool's lock
+	if (theOldPacket != NULL)
+		theOldPacket->Release();
+}
+
+ReflectorPacket* ReflectorPacketHistory::GetPacket(UInt16 inSeqNum)
+{
+	OSMutexLocker locker(&fMutex);
+	if (fPackets == NULL)
+		return NULL;
+
+	ReflectorPacket* thePacket = fPackets[inSeqNum & fMask];
+	if ((thePacket == NULL) || (thePacket->GetPacketRTPSeqNum() != inSeqNum))
+		return NULL;
+
+	thePacket->Retain();
+	return thePacket;
+}
+
+void ReflectorPacketHistory::Clear()
+{
+	OSMutexLocker locker(&fMutex);
+	if (fPackets == NULL)
+		return;
+
+	for (UInt32 x = 0; x <= fMask; x++)
+	{
+		if (fPackets[x] != NULL)
+			fPackets[x]->Release();
+		fPackets[x] = NULL;
+	}
+}
+
+ReflectorFECEncoder::ReflectorFECEncoder()
+	: fParity(NULL),
+	fWindowPackets(0),
+	fNumParity(0),
+	fNumPackets(0),
+	fLastOffset(0),
+	fSeqNumBase(0),
+	fNextSeqNum(1)
+{
+	::memset(fTimeStamp, 0, sizeof(fTimeStamp));
+	::memset(fSSRC, 0, sizeof(fSSRC));
+}
+
+ReflectorFECEncoder::~ReflectorFECEncoder()
+{
+	delete[] fParity;
+}
+
+bool ReflectorFECEncoder::BelongsToWindow(StrPtrLen* inPacket)
+{
+	if ((fNumPackets == 0) || (inPacket->Len < kRTPHeaderSize))
+		return true;
+
+	UInt8* thePacket = (UInt8*)inPacket->Ptr;
+	UInt16 theOffset = (UInt16)(((thePacket[2] << 8) | thePacket[3]) - fSeqNumBase);
+	return theOffset < fWindowPackets;
+}
+
+void ReflectorFECEncoder::AddPacket(StrPtrLen* inPacket)
+{
+	if ((inPacket->Len < kRTPHeaderSize) || (inPacket->Len - kRTPHeaderSize > kMaxProtectionLength))
+		return;
+
+	UInt8* thePacket = (UInt8*)inPacket->Ptr;
+	UInt16 theSeqNum = (UInt16)((thePacket[2] << 8) | thePacket[3]);
+
+	if (fNumPackets == 0)
+	{
+		//the prefs only take effect between windows
+		fWindowPackets = sWindowPackets;
+		fNumParity = sParityPackets;
+		if (fNumParity == 0)
+			return;
+
+		if (fParity == NULL)
+		{
+			fParity = new Parity[kMaxParityPackets];
+			::memset(fParity, 0, kMaxParityPackets * sizeof(Parity));
+		}
+		fSeqNumBase = theSeqNum;
+	}
+
+	UInt32 theOffset = (UInt16)(theSeqNum - fSeqNumBase);
+	if (theOffset >= fWindowPackets)
+		return;
+
+	Parity* theParity = &fParity[theOffset % fNumParity];
+	UInt64 theBit = (UInt64)1 << theOffset;
+	if (theParity->fMask & theBit)
+		return; // a duplicate would XOR itself back out
+
+	theParity->fMask |= theBit;
+	for (UInt32 x = 0; x < sizeof(theParity->fHeader); x++)
+		theParity->fHeader[x] ^= thePacket[x];
+
+	UInt16 theLength = (UInt16)(inPacket->Len - kRTPHeaderSize);
+	theParity->fLength ^= theLength;
+	if (theLength > theParity->fProtectionLength)
+		theParity->fProtectionLength = theLength;
+	XORBytes(theParity->fPayload, thePacket + kRTPHeaderSize, theLength);
+
+	if ((fNumPackets == 0) || (theOffset > fLastOffset))
+	{
+		fLastOffset = theOffset;
+		::memcpy(fTimeStamp, thePacket + 4, sizeof(fTimeStamp));
+	}
+	::memcpy(fSSRC, thePacket + 8, sizeof(fSSRC));
+	fNumPackets++;
+}
+
+UInt32 ReflectorFECEncoder::WriteParityPacket(UInt32 inIndex, char* ioBuffer, UInt32 inBufferLen)
+{
+	if (inIndex >= this->GetNumParityPackets())
+		return 0;
+
+	Parity* theParity = &fParity[inIndex];
+	if (theParity->fMask == 0)
+		return 0;
+
+	//SN base is the first packet covered, the mask's most significant bit
+	UInt32 theFirstOffset = 0;
+	while ((theParity->fMask & ((UInt64)1 << theFirstOffset)) == 0)
+		theFirstOffset++;
+
+	UInt64 theMask = theParity->fMask >> theFirstOffset;
+	bool isLong = (theMask >> 16) != 0;
+	UInt32 theMaskBits = isLong ? 48 : 16;
+	UInt32 theLevelHeaderSize = isLong ? kLongLevelHeaderSize : kShortLevelHeaderSize;
+	UInt32 theLength = kRTPHeaderSize + kFECHeaderSize + theLevelHeaderSize + theParity->fProtectionLength;
+	if (theLength > inBufferLen)
+		return 0;
+
+	UInt8* theBuffer = (UInt8*)ioBuffer;
+	UInt16 theSeqNumBase = (UInt16)(fSeqNumBase + theFirstOffset);
+
+	//RTP header: version 2, our own sequence numbers, the media's clock and SSRC
+	theBuffer[0] = 0x80;
+	theBuffer[1] = kPayloadType;
+	theBuffer[2] = (UInt8)(fNextSeqNum >> 8);
+	theBuffer[3] = (UInt8)fNextSeqNum;
+	::memcpy(theBuffer + 4, fTimeStamp, sizeof(fTimeStamp));
+	::memcpy(theBuffer + 8, fSSRC, sizeof(fSSRC));
+	fNextSeqNum++;
+
+	//FEC header: E = 0, L, the P X CC M PT recovery, SN base, TS and length recovery
+	UInt8* theFECHeader = theBuffer + kRTPHeaderSize;
+	theFECHeader[0] = (isLong ? 0x40 : 0) | (theParity->fHeader[0] & 0x3F);
+	theFECHeader[1] = theParity->fHeader[1];
+	theFECHeader[2] = (UInt8)(theSeqNumBase >> 8);
+	theFECHeader[3] = (UInt8)theSeqNumBase;
+	::memcpy(theFECHeader + 4, theParity->fHeader + 4, 4);
+	theFECHeader[8] = (UInt8)(theParity->fLength >> 8);
+	theFECHeader[9] = (UInt8)theParity->fLength;
+
+	//level 0 header: protection length, then the mask with SN base in its top bit
+	UInt8* theLevelHeader = theFECHeader + kFECHeaderSize;
+	theLevelHeader[0] = (UInt8)(theParity->fProtectionLength >> 8);
+	theLevelHeader[1] = (UInt8)theParity->fProtectionLength;
+
+	UInt64 theWireMask = 0;
+	for (UInt32 x = 0; x < theMaskBits; x++)
+	{
+		if (theMask & ((UInt64)1 << x))
+			theWireMask |= (UInt64)1 << (theMaskBits - 1 - x);
+	}
+	for (UInt32 x = 0; x < theMaskBits / 8; x++)
+		theLevelHeader[2 + x] = (UInt8)(theWireMask >> (theMaskBits - 8 - (8 * x)));
+
+	::memcpy(theLevelHeader + theLevelHeaderSize, theParity->fPayload, theParity->fProtectionLength);
+	return theLength;
+}
+
+void ReflectorFECEncoder::FinishWindow()
+{
+	if (fParity != NULL)
+	{
+		for (UInt32 x = 0; x < fNumParity; x++)
+		{
+			Parity* theParity = &fParity[x];
+			::memset(theParity->fPayload, 0, theParity->fProtectionLength);
+			::memset(theParity->fHeader, 0, sizeof(theParity->fHeader));
+			theParity->fLength = 0;
+			theParity->fProtectionLength = 0;
+			theParity->fMask = 0;
+		}
+	}
+
+	fNumPackets = 0;
+	fLastOffset = 0;
+}
+
+void ReflectorFECEncoder::XORBytes(UInt8* ioDest, const UInt8* inSource, UInt32 inLength)
+{
+	UInt32 x = 0;
+
+#if defined(__SSE2__)
+	for (; x + 16 <= inLength; x += 16)
+	{
+		__m128i theDest = _mm_loadu_si128((const __m128i*)(ioDest + x));
+		__m128i theSource = _mm_loadu_si128((const __m128i*)(inSource + x));
+		_mm_storeu_si128((__m128i*)(ioDest + x), _mm_xor_si128(theDest, theSource));
+	}
+#elif defined(__ARM_NEON)
+	for (; x + 16 <= inLength; x += 16)
+		vst1q_u8(ioDest + x, veorq_u8(vld1q_u8(ioDest + x), vld1q_u8(inSource + x)));
+#endif
+
+	//memcpy, because neither pointer need be 8 byte aligned
+	for (; x + 8 <= inLength; x += 8)
+	{
+		UInt64 theDest, theSource;
+		::memcpy(&theDest, ioDest + x, 8);
+		::memcpy(&theSource, inSource + x, 8);
+		theDest ^= theSource;
+		::memcpy(ioDest + x, &theDest, 8);
+	}
+
+	for (; x < inLength; x++)
+		ioDest[x] ^= inSource[x];
+}
+
+void ReflectorSender::ProtectPacket(ReflectorSocket* inSocket, ReflectorPacket* inPacket, SInt64 inMilliseconds)
+{
+	if (!fFEC.BelongsToWindow(&inPacket->fPacketPtr))
+		this->QueueParityPackets(inSocket, inMilliseconds);
+
+	fFEC.AddPacket(&inPacket->fPacketPtr);
+
+	if (fFEC.IsWindowFull())
+		this->QueueParityPackets(inSocket, inMilliseconds);
+}
+
+void ReflectorSender::QueueParityPackets(ReflectorSocket* inSocket, SInt64 inMilliseconds)
+{
+	UInt32 theNumParity = fFEC.GetNumParityPackets();
+	UInt32 theNumQueued = 0;
+
+	for (UInt32 x = 0; x < theNumParity; x++)
+	{
+		ReflectorPacket* theParity = inSocket->GetPacket();
+		theParity->fPacketPtr.Len = fFEC.WriteParityPacket(x, theParity->fPacketPtr.Ptr, ReflectorPacket::kMaxReflectorPacketSize);
+		if (theParity->fPacketPtr.Len == 0)
+		{
+			theParity->Release();
+			continue;
+		}
+
+		theParity->fIsFEC = true;
+		theParity->fStreamCountID = ++(fStream->fPacketCount);
+		theParity->fBucketsSeenThisPacket = 0;
+		theParity->fTimeArrived = inMilliseconds;
+		fPacketQueue.EnQueue(&theParity->fQueueElem);
+
+		if (fFirstNewPacketInQueue == NULL)
+			fFirstNewPacketInQueue = &theParity->fQueueElem;
+		fHasNewPackets = true;
+		theNumQueued++;
+	}
+
+	fFEC.FinishWindow();
+	if (theNumQueued > 0)
+		OSCounters::Add(QTSServerInterface::kFECPacketsCounter, theNumQueued);
+}
+
+
+OSQueueElem* ReflectorSender::GetClientBufferStartPacketOffset(SInt64 offsetMsec, bool needKeyFrameFirstPacket)
+{
+	OSQueueIter qIter(&fPacketQueue);// start at oldest packet in q
+	SInt64 theCurrentTime = OS::Milliseconds();
+	SInt64 packetDelay = 0;
+	OSQueueElem* oldestPacketInClientBufferTime = NULL;
+
+
+	while (!qIter.IsDone()) // start at oldest packet in q
+	{
+		OSQueueElem* elem = qIter.GetCurrent();
 		Assert(elem);
 		qIter.Next();
 
 		ReflectorPacket* thePacket = (ReflectorPacket*)elem->GetEnclosingObject();
 		Assert(thePacket);
 
+		//outputs start on a media packet
+		if (thePacket->fIsFEC)
+			continue;
+
 		packetDelay = theCurrentTime - thePacket->fTimeArrived;
 		if (offsetMsec > ReflectorStream::sOverBufferInMsec)
 			offsetMsec = ReflectorStream::sOverBufferInMsec;
@@ -1230,7 +1948,7 @@ OSQueueElem* ReflectorSender::GetClientBufferStartPacketOffset(SInt64 offsetMsec
 	return oldestPacketInClientBufferTime;
 }
 
-void    ReflectorSender::RemoveOldPackets(OSQueue* inFreeQueue)
+void    ReflectorSender::RemoveOldPackets()
 {
 
 	// Iterate through the senders queue to clear out packets
@@ -1259,22 +1977,19 @@ void    ReflectorSender::RemoveOldPackets(OSQueue* inFreeQueue)
 		packetDelay = theCurrentTime - thePacket->fTimeArrived;
 
 		// walk q and remove packets that are too old
-		if (!thePacket->fNeededByOutput && packetDelay > currentMaxPacketDelay) // delete based on late tolerance and whether a client is blocked on the packet
+		// a shared packet is bookmarked by an output that has not caught up yet
+		if (!thePacket->fNeededByOutput && !thePacket->IsShared() && packetDelay > currentMaxPacketDelay) // delete based on late tolerance and whether a client is blocked on the packet
 		{   // not needed and older than our required buffer
-			thePacket->Reset();
 			fPacketQueue.Remove(elem);
-			inFreeQueue->EnQueue(elem);
+			thePacket->Release();
 		}
 		else
 		{   // we want to keep all of these but we should reset the ones that should be aged out unless marked
 			// as need the next time through reflect packets.
 
-			if (fKeyFrameStartPacketElementPointer)
-			{
-				ReflectorPacket* keyPacket = (ReflectorPacket*)(fKeyFrameStartPacketElementPointer->GetEnclosingObject());
-				if (keyPacket == thePacket)
-					break;
-			}
+			// the GOP cache holds everything from here on
+			if (elem == fGOPCache.GetFirstPacket())
+				break;
 
 			//if(IsKeyFrameFirstPacket(thePacket))
 			//	break;
@@ -1289,8 +2004,8 @@ void    ReflectorSender::RemoveOldPackets(OSQueue* inFreeQueue)
 }
 
 // if current packet over max packetAgeTime, we need relocate the BookMark to
-// the new fKeyFrameStartPacketElementPointer
-OSQueueElem* ReflectorSender::NeedRelocateBookMark(OSQueueElem* elem)
+// the start of the GOP cache
+OSQueueElem* ReflectorSender::NeedRelocateBookMark(OSQueueElem* elem, OSQueueElem* inKeyFrameElem)
 {
 	//1жϵǰPacketǷѾ󻺳ʱ(ж/ƵI/P֡)
 	//2ʱ䳬˷ֵ,µfKeyFrameStartPacketElementPointer
@@ -1308,13 +2023,13 @@ OSQueueElem* ReflectorSender::NeedRelocateBookMark(OSQueueElem* elem)
 
 	if ((packetDelay > currentMaxPacketDelay) /*&& IsFrameFirstPacket(thePacket)*/)//or IsFrameFirstPacket
 	{
-		if (fKeyFrameStartPacketElementPointer)
+		if (inKeyFrameElem)
 		{
-			ReflectorPacket* keyPacket = (ReflectorPacket*)(fKeyFrameStartPacketElementPointer->GetEnclosingObject());
+			ReflectorPacket* keyPacket = (ReflectorPacket*)(inKeyFrameElem->GetEnclosingObject());
 			if (keyPacket->fTimeArrived > thePacket->fTimeArrived)
 			{
 				this->fStream->GetMyReflectorSession()->SetHasVideoKeyFrameUpdate(true);
-				return fKeyFrameStartPacketElementPointer;
+				return inKeyFrameElem;
 			}
 		}
 	}
@@ -1352,50 +2067,6 @@ OSQueueElem* ReflectorSender::NeedRelocateBookMark(OSQueueElem* elem)
 	//return false;
 }
 
-OSQueueElem*    ReflectorSender::GetNewestKeyFrameFirstPacket(OSQueueElem* currentElem, SInt64 offsetMsec)
-{
-	//printf("[geyijun] GetNewestKeyFrameFirstPacket---------------->1\n");
-	SInt64 theCurrentTime = OS::Milliseconds();
-	SInt64 packetDelay = 0;
-	OSQueueElem* requestedPacket = NULL;
-	OSQueueIter qIter(&fPacketQueue, currentElem);
-	while (!qIter.IsDone()) // start at oldest packet in q
-	{
-		OSQueueElem* elem = qIter.GetCurrent();
-		Assert(elem);
-		qIter.Next();
-
-		ReflectorPacket* thePacket = (ReflectorPacket*)elem->GetEnclosingObject();
-		if (thePacket == NULL)
-		{
-			break;
-		}
-		if (IsKeyFrameFirstPacket(thePacket))
-		{
-			requestedPacket = &thePacket->fQueueElem;
-			//printf("[geyijun]Maybe,GetNewestKeyFrameFirstPacket --->[%#x]\n",requestedPacket);	
-
-			//
-			packetDelay = theCurrentTime - thePacket->fTimeArrived;
-			if (offsetMsec > ReflectorStream::sOverBufferInMsec)
-				offsetMsec = ReflectorStream::sOverBufferInMsec;
-			if (packetDelay <= (ReflectorStream::sOverBufferInMsec - offsetMsec))
-			{
-				break;
-			}
-		}
-	}
-	if (requestedPacket == NULL)
-	{
-		printf("[geyijun]GetNewestKeyFrameFirstPacket --->[NotFound]\n");
-	}
-	else
-	{
-		printf("[geyijun]Final,GetNewestKeyFrameFirstPacket --->[%#x]\n", requestedPacket);
-	}
-	return requestedPacket;
-}
-
 /*
 	жϵǰRTPǷΪH.264 Iؼ֡ĵһRTP
 	д̫ܲϽ(H264 δʽ)
@@ -1581,6 +2252,12 @@ void ReflectorSocketPool::SetUDPSocketOptions(UDPSocketPair* inPair)
 	//inPair->GetSocketA()->ReuseAddr();
 	//inPair->GetSocketA()->ReuseAddr();
 
+	// kernel receive times for fTimeArrived, see GetIncomingData
+	if (ReflectorStream::sUseKernelArrivalTime)
+	{
+		(void)inPair->GetSocketA()->EnableArrivalTimestamps();
+		(void)inPair->GetSocketB()->EnableArrivalTimestamps();
+	}
 }
 
 
@@ -1623,6 +2300,7 @@ ReflectorSocket::ReflectorSocket()
 	UDPSocket(NULL, Socket::kNonBlockingSocketType | UDPSocket::kWantsDemuxer),
 	fBroadcasterClientSession(NULL),
 	fLastBroadcasterTimeOutRefresh(0),
+	fPacketPool(new ReflectorPacketPool()),
 	fSleepTime(0),
 	fValidSSRC(0),
 	fLastValidSSRCTime(0),
@@ -1634,27 +2312,15 @@ ReflectorSocket::ReflectorSocket()
 	fCurrentSSRC(0)
 
 {
-	//construct all the preallocated packets
 	this->SetTaskName("ReflectorSocket");
 	this->SetTask(this);
-
-	for (UInt32 numPackets = 0; numPackets < kNumPreallocatedPackets; numPackets++)
-	{
-		//If the local port # of this socket is odd, then all the packets
-		//used for this socket are rtcp packets.
-		ReflectorPacket* packet = new ReflectorPacket();
-		fFreeQueue.EnQueue(&packet->fQueueElem);//put this packet onto the free queue
-	}
 }
 
 ReflectorSocket::~ReflectorSocket()
 {
 	//printf("ReflectorSocket::~ReflectorSocket\n");
-	while (fFreeQueue.GetLength() > 0)
-	{
-		ReflectorPacket* packet = (ReflectorPacket*)fFreeQueue.DeQueue()->GetEnclosingObject();
-		delete packet;
-	}
+	//senders may still hold packets from the pool, it goes away with the last of them
+	fPacketPool->Detach();
 }
 
 void    ReflectorSocket::AddSender(ReflectorSender* inSender)
@@ -1663,12 +2329,14 @@ void    ReflectorSocket::AddSender(ReflectorSender* inSender)
 	QTSS_Error err = this->GetDemuxer()->RegisterTask(inSender->fStream->fStreamInfo.fSrcIPAddr, 0, inSender);
 	Assert(err == QTSS_NoErr);
 	fSenderQueue.EnQueue(&inSender->fSocketQueueElem);
+	inSender->fSocket = this;
 }
 
 void    ReflectorSocket::RemoveSender(ReflectorSender* inSender)
 {
 	OSMutexLocker locker(this->GetDemuxer()->GetMutex());
 	fSenderQueue.Remove(&inSender->fSocketQueueElem);
+	inSender->fSocket = NULL;
 	QTSS_Error err = this->GetDemuxer()->UnregisterTask(inSender->fStream->fStreamInfo.fSrcIPAddr, 0, inSender);
 	Assert(err == QTSS_NoErr);
 }
@@ -1710,7 +2378,7 @@ SInt64 ReflectorSocket::Run()
 	{
 		ReflectorSender* theSender2 = (ReflectorSender*)iter2.GetCurrent()->GetEnclosingObject();
 		if (theSender2 != NULL && theSender2->ShouldReflectNow(theMilliseconds, &fSleepTime))
-			theSender2->ReflectPackets(&fSleepTime, &fFreeQueue);
+			theSender2->ReflectPackets(&fSleepTime);
 	}
 
 #if DEBUG
@@ -1787,9 +2455,9 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 
 		if (thePacket->fPacketPtr.Len == 0)
 		{
-			//put the packet back on the free queue, because we didn't actually
+			//put the packet back in the pool, because we didn't actually
 			//get any data here.
-			fFreeQueue.EnQueue(&thePacket->fQueueElem);
+			thePacket->Release();
 			this->RequestEvent(EV_RE);
 			done = true;
 			//qtss_printf("ReflectorSocket::ProcessPacket no more packets on this socket!\n");
@@ -1808,7 +2476,7 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 				(theRTCPPacket.GetPacketType() != RTCPSRPacket::kSRPacketType))
 			{
 				//pretend as if we never got this packet
-				fFreeQueue.EnQueue(&thePacket->fQueueElem);
+				thePacket->Release();
 				done = true;
 				break;
 			}
@@ -1829,7 +2497,7 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 		{
 			//UInt16* theSeqNumberP = (UInt16*)thePacket->fPacketPtr.Ptr;
 			//qtss_printf("ReflectorSocket::ProcessPacket no sender found for packet! sequence number=%d\n",ntohs(theSeqNumberP[1]));
-			fFreeQueue.EnQueue(&thePacket->fQueueElem); // don't process the packet
+			thePacket->Release(); // don't process the packet
 			done = true;
 			break;
 		}
@@ -1873,68 +2541,34 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 		thePacket->fTimeArrived = inMilliseconds;
 		theSender->fPacketQueue.EnQueue(&thePacket->fQueueElem);
 
-		// TODO:AH264ƵRTPйؼ֡ˣ¹ؼ֡׸RTPָ
-		// 1жǷΪƵH.264 RTP
+		// Keep the newest packets around for viewers that NACK them
+		if (!(thePacket->IsRTCP()))
+			theSender->fHistory.AddPacket(thePacket);
+
+		// Keep the newest GOP of H.264 video. A key frame starts a new group, and the
+		// session's audio starts its group with its next packet.
 		SourceInfo::StreamInfo* streamInfo = theSender->fStream->GetStreamInfo();
 		if (!(thePacket->IsRTCP()) && (streamInfo->fPayloadType == qtssVideoPayloadType) && (streamInfo->fPayloadName.Equal("H264/90000")))
 		{
-			// 2жthePacketǷΪؼ֡ʼRTPǣ¼thePacket->fQueueElem
-			if (theSender->IsKeyFrameFirstPacket(thePacket))
+			if (theSender->IsKeyFrameFirstPacket(thePacket) && theSender->fGOPCache.StartsNewGroup(thePacket))
 			{
-				//printf("\nI");
-				//3ȡԭfKeyFrameStartPacketElementPointer
-				if (theSender->fKeyFrameStartPacketElementPointer)
-				{
-					ReflectorPacket* oldKeyFramePacket = (ReflectorPacket*)theSender->fKeyFrameStartPacketElementPointer->GetEnclosingObject();
-					oldKeyFramePacket->fNeededByOutput = false;
-				}
-
-				//4µfKeyFrameStartPacketElementPointer
-				{
-					//ؼ֡ᱻRemove
-					thePacket->fNeededByOutput = true;
-					//µĹؼ֡ʼ
-					theSender->fKeyFrameStartPacketElementPointer = &thePacket->fQueueElem;
-				}
-
-				//5ReflectorSession־λNotifyƵؼ֡Ƶи
-				{
-					theSender->fStream->GetMyReflectorSession()->SetHasVideoKeyFrameUpdate(true);
-				}
+				theSender->fGOPCache.StartGroup(thePacket);
+				theSender->fStream->GetMyReflectorSession()->SetHasVideoKeyFrameUpdate(true);
 			}
-			//else if(theSender->IsFrameFirstPacket(thePacket))
-			//{
-			//	printf("P");
-			//}
+			else
+				theSender->fGOPCache.AddPacket(thePacket);
 		}
-
-		// TODO:BƵؼ֡и£ƵҲƵĸи
-		// 1жǷΪƵRTPƵؼ֡Notify
-		if (!(thePacket->IsRTCP()) && (streamInfo->fPayloadType == qtssAudioPayloadType) && (theSender->fStream->GetMyReflectorSession()->HasVideoKeyFrameUpdate()))
+		else if (!(thePacket->IsRTCP()) && (streamInfo->fPayloadType == qtssAudioPayloadType))
 		{
-			//2ȡԭƵfKeyFrameStartPacketElementPointer
-			if (theSender->fKeyFrameStartPacketElementPointer)
-			{
-				ReflectorPacket* oldKeyFramePacket = (ReflectorPacket*)theSender->fKeyFrameStartPacketElementPointer->GetEnclosingObject();
-				oldKeyFramePacket->fNeededByOutput = false;
-			}
-
-			//4µƵfKeyFrameStartPacketElementPointer
-			{
-				//ؼ֡ᱻRemove
-				thePacket->fNeededByOutput = true;
-				//µĹؼ֡ʼ
-				theSender->fKeyFrameStartPacketElementPointer = &thePacket->fQueueElem;
-			}
-
-			//5ReflectorSession־λNotifyƵؼ֡Ƶи
+			if (theSender->fStream->GetMyReflectorSession()->HasVideoKeyFrameUpdate())
 			{
+				theSender->fGOPCache.StartGroup(thePacket);
 				theSender->fStream->GetMyReflectorSession()->SetHasVideoKeyFrameUpdate(false);
 			}
+			else
+				theSender->fGOPCache.AddPacket(thePacket);
 		}
 
-
-
 		if (theSender->fFirstNewPacketInQueue == NULL)
 			theSender->fFirstNewPacketInQueue = &thePacket->fQueueElem;
 		theSender->fHasNewPackets = true;
@@ -1945,6 +2579,7 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 			// Because this is an RTP packet make sure to atomic add this because
 			// multiple sockets can be adding to this variable simultaneously
 			(void)atomic_add(&theSender->fStream->fBytesSentInThisInterval, thePacket->fPacketPtr.Len);
+			theSender->fStream->fBytesReceived += thePacket->fPacketPtr.Len;
 			//printf("ReflectorSocket::ProcessPacket received RTP id=%qu\n", thePacket->fStreamCountID); 
 			theSender->fStream->SetHasFirstRTP(true);
 		}
@@ -1993,6 +2628,10 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 
 		}
 
+		// The parity packets of the window this packet completes go right behind it
+		if (!(thePacket->IsRTCP()) && theSender->fStream->IsFECProtected())
+			theSender->ProtectPacket(this, thePacket, thePacket->fTimeArrived);
+
 		//printf("ReflectorSocket::GetIncomingData has packet from time=%qd src addr=%"   _U32BITARG_   " src port=%u packetlen=%"   _U32BITARG_   "\n",inMilliseconds, theRemoteAddr,theRemotePort,thePacket->fPacketPtr.Len);
 		if (0) //turn on / off buffer size checking --  pref can go here if we find we need to adjust this
 			if (theSender->fPacketQueue.GetLength() > maxQSize) //don't grow memory too big
@@ -2013,22 +2652,53 @@ bool ReflectorSocket::ProcessPacket(const SInt64& inMilliseconds, ReflectorPacke
 void ReflectorSocket::GetIncomingData(const SInt64& inMilliseconds)
 {
 	OSMutexLocker locker(this->GetDemuxer()->GetMutex());
-	UInt32 theRemoteAddr = 0;
-	UInt16 theRemotePort = 0;
-	//get all the outstanding packets for this socket
+
+	ReflectorPacket*	thePackets[kRecvBatchSize];
+	UDPRecvPacket		theRecvPackets[kRecvBatchSize];
+
+	//get all the outstanding packets for this socket, kRecvBatchSize per recvmmsg
 	while (true)
 	{
-		//get a packet off the free queue.
-		ReflectorPacket* thePacket = this->GetPacket();
+		//receive straight into pool packets
+		this->GetPackets(thePackets, kRecvBatchSize);
+		for (UInt32 x = 0; x < kRecvBatchSize; x++)
+		{
+			thePackets[x]->fPacketPtr.Len = 0;
+			theRecvPackets[x].fBuffer = thePackets[x]->fPacketPtr.Ptr;
+			theRecvPackets[x].fBufferLen = ReflectorPacket::kMaxReflectorPacketSize;
+		}
 
-		thePacket->fPacketPtr.Len = 0;
-		(void)this->RecvFrom(&theRemoteAddr, &theRemotePort, thePacket->fPacketPtr.Ptr,
-			ReflectorPacket::kMaxReflectorPacketSize, &thePacket->fPacketPtr.Len);
+		UInt32 theNumPackets = 0;
+		(void)this->RecvBatch(theRecvPackets, kRecvBatchSize, &theNumPackets);
 
-		if (this->ProcessPacket(inMilliseconds, thePacket, theRemoteAddr, theRemotePort))
-			break;
+		//only what recvmmsg filled counts toward the pool's reserve, the spares go straight back
+		this->CountPackets(theNumPackets);
+
+		for (UInt32 x = 0; x < kRecvBatchSize; x++)
+		{
+			if (x >= theNumPackets)
+			{
+				thePackets[x]->Release();
+				continue;
+			}
 
-		//printf("ReflectorSocket::GetIncomingData \n");
+			// An empty datagram would read as "socket drained" to ProcessPacket
+			thePackets[x]->fPacketPtr.Len = theRecvPackets[x].fLength;
+			if (thePackets[x]->fPacketPtr.Len == 0)
+			{
+				thePackets[x]->Release();
+				continue;
+			}
+
+			SInt64 theArrivalTime = ReflectorStream::sUseKernelArrivalTime ? theRecvPackets[x].fArrivalTime : inMilliseconds;
+			(void)this->ProcessPacket(theArrivalTime, thePackets[x], theRecvPackets[x].fRemoteAddr, theRecvPackets[x].fRemotePort);
+		}
+
+		if (theNumPackets < kRecvBatchSize)
+		{
+			this->RequestEvent(EV_RE);
+			break;//no more packets on this socket!
+		}
 	}
 
 }
@@ -2038,10 +2708,160 @@ void ReflectorSocket::GetIncomingData(const SInt64& inMilliseconds)
 
 ReflectorPacket* ReflectorSocket::GetPacket()
 {
-	OSMutexLocker locker(this->GetDemuxer()->GetMutex());
+	return fPacketPool->GetPacket();
+}
+
+unsigned int ReflectorPacketPool::sTotalMemoryBytes = 0;
+
+ReflectorPacketPool::ReflectorPacketPool()
+	: fNumSlabs(0),
+	fReservePackets(kMinReservePackets),
+	fPacketsThisInterval(0),
+	fIntervalStart(OS::Milliseconds()),
+	fDetached(false)
+{
+	OSMutexLocker locker(&fMutex);
+	this->AllocateSlab();
+}
+
+ReflectorPacketPool::~ReflectorPacketPool()
+{
+	Assert(fFreeQueue.GetLength() == fNumSlabs * kPacketsPerSlab);
+	while (fSlabQueue.GetLength() > 0)
+		this->FreeSlab((Slab*)fSlabQueue.GetHead()->GetEnclosingObject());
+}
+
+void ReflectorPacketPool::AllocateSlab()
+{
+	Slab* theSlab = new Slab;
+	theSlab->fSlabElem.SetEnclosingObject(theSlab);
+	theSlab->fNumFree = kPacketsPerSlab;
+	for (UInt32 x = 0; x < kPacketsPerSlab; x++)
+	{
+		ReflectorPacket* thePacket = &theSlab->fPackets[x];
+		thePacket->fPacketData = theSlab->fData[x];
+		thePacket->fPool = this;
+		thePacket->fSlab = theSlab;
+		thePacket->Reset();
+		fFreeQueue.EnQueue(&thePacket->fQueueElem);
+	}
+	fSlabQueue.EnQueue(&theSlab->fSlabElem);
+	fNumSlabs++;
+	(void)atomic_add(&sTotalMemoryBytes, sizeof(Slab));
+}
+
+void ReflectorPacketPool::FreeSlab(Slab* inSlab)
+{
+	Assert(inSlab->fNumFree == kPacketsPerSlab);
+	for (UInt32 x = 0; x < kPacketsPerSlab; x++)
+		fFreeQueue.Remove(&inSlab->fPackets[x].fQueueElem);
+	fSlabQueue.Remove(&inSlab->fSlabElem);
+	fNumSlabs--;
+	(void)atomic_sub(&sTotalMemoryBytes, sizeof(Slab));
+	delete inSlab;
+}
+
+void ReflectorPacketPool::UpdateReserve(SInt64 inCurrentTime)
+{
+	// Keep kReserveMSec worth of packets at the rate we handed them out over the last interval
+	SInt64 theInterval = inCurrentTime - fIntervalStart;
+	if (theInterval < kRateIntervalMSec)
+		return;
+
+	UInt32 theReserve = (UInt32)(((SInt64)fPacketsThisInterval * kReserveMSec) / theInterval);
+	fReservePackets = (theReserve < kMinReservePackets) ? kMinReservePackets : theReserve;
+	fPacketsThisInterval = 0;
+	fIntervalStart = inCurrentTime;
+}
+
+ReflectorPacket* ReflectorPacketPool::TakePacket()
+{
 	if (fFreeQueue.GetLength() == 0)
-		//if the port number of this socket is odd, this packet is an RTCP packet.
-		return new ReflectorPacket();
-	else
-		return (ReflectorPacket*)fFreeQueue.DeQueue()->GetEnclosingObject();
+		this->AllocateSlab();
+
+	// Reuse the most recently returned packet: its buffer is still warm, and slabs
+	// at the cold end of the queue get a chance to drain completely
+	OSQueueElem* theElem = fFreeQueue.GetTail();
+	fFreeQueue.Remove(theElem);
+
+	ReflectorPacket* thePacket = (ReflectorPacket*)theElem->GetEnclosingObject();
+	((Slab*)thePacket->fSlab)->fNumFree--;
+	thePacket->fRefCount = 1;
+	return thePacket;
+}
+
+ReflectorPacket* ReflectorPacketPool::GetPacket()
+{
+	OSMutexLocker locker(&fMutex);
+	ReflectorPacket* thePacket = this->TakePacket();
+
+	fPacketsThisInterval++;
+	this->UpdateReserve(OS::Milliseconds());
+	return thePacket;
+}
+
+void ReflectorPacketPool::GetPackets(ReflectorPacket** outPackets, UInt32 inNumPackets)
+{
+	OSMutexLocker locker(&fMutex);
+	for (UInt32 x = 0; x < inNumPackets; x++)
+		outPackets[x] = this->TakePacket();
+}
+
+void ReflectorPacketPool::CountPackets(UInt32 inNumPackets)
+{
+	OSMutexLocker locker(&fMutex);
+	fPacketsThisInterval += inNumPackets;
+	this->UpdateReserve(OS::Milliseconds());
+}
+
+void ReflectorPacketPool::ReturnPacket(ReflectorPacket* inPacket)
+{
+	Assert(inPacket->fPool == this);
+	Assert(inPacket->fRefCount == 0);
+
+	fMutex.Lock();
+	inPacket->Reset();
+	fFreeQueue.EnQueue(&inPacket->fQueueElem);
+
+	// Give a slab back to the heap once it is entirely free and we have
+	// more than the reserve plus a slab of slack
+	Slab* theSlab = (Slab*)inPacket->fSlab;
+	theSlab->fNumFree++;
+	if ((theSlab->fNumFree == kPacketsPerSlab) && (fNumSlabs > 1) && (fFreeQueue.GetLength() >= fReservePackets + 2 * kPacketsPerSlab))
+		this->FreeSlab(theSlab);
+
+	bool deleteSelf = fDetached && (fFreeQueue.GetLength() == fNumSlabs * kPacketsPerSlab);
+	fMutex.Unlock();
+
+	if (deleteSelf)
+		delete this;
+}
+
+void ReflectorPacketPool::Detach()
+{
+	fMutex.Lock();
+	fDetached = true;
+	bool deleteSelf = (fFreeQueue.GetLength() == fNumSlabs * kPacketsPerSlab);
+	fMutex.Unlock();
+
+	if (deleteSelf)
+		delete this;
+}
+
+UInt32 ReflectorStream::GetKeyFramePackets(ReflectorPacket** outPackets, UInt32 inMaxPackets)
+{
+	if (fStreamInfo.fPayloadType != qtssVideoPayloadType)
+		return 0;
+
+	OSMutexLocker locker(fRTPSender.GetQueueMutex());
+	return fRTPSender.fGOPCache.GetKeyFramePackets(outPackets, inMaxPackets);
+}
+
+UInt32 ReflectorStream::GetPacketMemory()
+{
+	if (fSockets == NULL)
+		return 0;
+
+	return ((ReflectorSocket*)fSockets->GetSocketA())->GetPacketPool()->GetMemoryBytes()
+		+ ((ReflectorSocket*)fSockets->GetSocketB())->GetPacketPool()->GetMemoryBytes();
 }
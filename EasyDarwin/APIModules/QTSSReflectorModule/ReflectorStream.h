@@ -47,17 +47,14 @@
 #include "OSMutex.h"
 #include "OSQueue.h"
 #include "OSRef.h"
+#include "OSEpoch.h"
 
 #include "RTCPSRPacket.h"
 #include "ReflectorOutput.h"
 #include "atomic.h"
 
- /*fantasy add this*/
-#include "keyframecache.h"
-
 //This will add some printfs that are useful for checking the thinning
 #define REFLECTOR_THINNING_DEBUGGING 0 
-#define MAX_CACHE_SIZE  1024*1024*2
 
 //Define to use new potential workaround for NAT problems
 #define NAT_WORKAROUND 1
@@ -79,22 +76,29 @@ typedef struct FU_Head_tag
 
 
 class ReflectorPacket;
+class ReflectorPacketPool;
 class ReflectorSender;
+class ReflectorSocket;
 class ReflectorStream;
 class RTPSessionOutput;
 class ReflectorSession;
 
+// A ReflectorPacket is a header around a buffer carved out of a ReflectorPacketPool slab.
+// Packets are reference counted: the sender queue holds one reference and every
+// ReflectorOutput bookmark holds another, so the buffer only goes back to its slab
+// once nobody can still write it to the network.
 class ReflectorPacket
 {
 public:
 
-	ReflectorPacket() : fQueueElem() { fQueueElem.SetEnclosingObject(this); this->Reset(); }
+	ReflectorPacket() : fQueueElem(), fPacketData(NULL), fPool(NULL), fRefCount(0), fSlab(NULL) { fQueueElem.SetEnclosingObject(this); this->Reset(); }
 	void Reset() { // make packet ready to reuse fQueueElem is always in use
 		fBucketsSeenThisPacket = 0;
 		fTimeArrived = 0;
 		//fQueueElem -- should be set to this
 		fPacketPtr.Set(fPacketData, 0);
 		fIsRTCP = false;
+		fIsFEC = false;
 		fStreamCountID = 0;
 		fNeededByOutput = false;
 	}
@@ -104,6 +108,7 @@ public:
 	void    SetPacketData(char *data, UInt32 len)
 	{
 		Assert(kMaxReflectorPacketSize > len);
+		Assert(fPacketData != NULL);
 
 		if (len > kMaxReflectorPacketSize)
 			len = kMaxReflectorPacketSize;
@@ -113,7 +118,18 @@ public:
 		this->fPacketPtr.Len = len;
 	}
 
+	// Points this packet at memory owned by the caller, without copying it.
+	// Only for packets that are not in a pool (parsing helpers on the stack).
+	void    WrapPacketData(char *data, UInt32 len) { Assert(fPool == NULL); fPacketPtr.Set(data, len); }
+
+	// Reference counting. A packet comes out of ReflectorPacketPool::GetPacket
+	// with one reference; Release hands it back to the pool when the last one goes.
+	void    Retain() { (void)atomic_add(&fRefCount, 1); }
+	inline  void    Release();
+	bool    IsShared() { return fRefCount > 1; }
+
 	bool  IsRTCP() { return fIsRTCP; }
+	bool  IsFEC() { return fIsFEC; }    // a parity packet made by ReflectorFECEncoder
 	inline  UInt32  GetPacketRTPTime();
 	inline  UInt16  GetPacketRTPSeqNum();
 	inline  UInt32  GetSSRC(bool isRTCP);
@@ -129,19 +145,112 @@ private:
 	UInt32      fBucketsSeenThisPacket;
 	SInt64      fTimeArrived;
 	OSQueueElem fQueueElem;
-	char        fPacketData[kMaxReflectorPacketSize];
+	char*       fPacketData;    // kMaxReflectorPacketSize bytes inside a pool slab
 	StrPtrLen   fPacketPtr;
 	bool      fIsRTCP;
+	bool      fIsFEC;
 	bool      fNeededByOutput; // is this packet still needed for output?
 	UInt64      fStreamCountID;
 
+	ReflectorPacketPool*    fPool;
+	unsigned int            fRefCount;  // unsigned int because we need to atomic_add
+	void*                   fSlab;      // the ReflectorPacketPool::Slab this packet lives in
+
 	friend class ReflectorSender;
 	friend class ReflectorSocket;
+	friend class ReflectorPacketPool;
+	friend class ReflectorStream;
 	friend class RTPSessionOutput;
+	friend class ReflectorGOPCache;
 
 
 };
 
+// ReflectorPacketPool
+//
+// Slab allocator for the ReflectorPackets of one ReflectorSocket. Packets and their
+// data buffers are allocated kPacketsPerSlab at a time, so receiving a packet never
+// touches the heap once the pool is warm.
+//
+// The pool sizes itself from the packet rate it sees: it keeps about kReserveMSec
+// worth of free packets around and gives whole slabs back to the heap beyond that.
+//
+// The owning socket calls Detach instead of deleting the pool. Packets may still be
+// queued on ReflectorSenders at that point, so the pool deletes itself when the last
+// of them is released.
+class ReflectorPacketPool
+{
+public:
+
+	ReflectorPacketPool();
+
+	// Returns a packet holding one reference. Never returns NULL.
+	ReflectorPacket*    GetPacket();
+	// Takes inNumPackets packets under one lock. They are not counted toward the
+	// reserve rate; report the ones actually used with CountPackets.
+	void                GetPackets(ReflectorPacket** outPackets, UInt32 inNumPackets);
+	void                CountPackets(UInt32 inNumPackets);
+
+	// Called by ReflectorPacket::Release when the last reference goes away.
+	void                ReturnPacket(ReflectorPacket* inPacket);
+
+	// The owner is done with the pool.
+	void                Detach();
+
+	// ACCESSORS
+	UInt32              GetNumPackets() { return fNumSlabs * kPacketsPerSlab; }
+	UInt32              GetNumFreePackets() { return fFreeQueue.GetLength(); }
+	UInt32              GetMemoryBytes() { return fNumSlabs * sizeof(Slab); }
+
+	enum
+	{
+		kPacketsPerSlab = 32,           //UInt32
+		kMinReservePackets = 20,        //UInt32
+		kReserveMSec = 1000,            //SInt64, worth of traffic kept on the free queue
+		kRateIntervalMSec = 2000        //SInt64, how often the reserve is recomputed
+	};
+
+	static UInt32       GetTotalMemoryBytes() { return sTotalMemoryBytes; }
+
+private:
+
+	struct Slab
+	{
+		OSQueueElem     fSlabElem;
+		UInt32          fNumFree;
+		ReflectorPacket fPackets[kPacketsPerSlab];
+		char            fData[kPacketsPerSlab][ReflectorPacket::kMaxReflectorPacketSize];
+	};
+
+	~ReflectorPacketPool();
+
+	void    AllocateSlab();
+	void    FreeSlab(Slab* inSlab);
+	ReflectorPacket*    TakePacket();   // fMutex must be held
+	void    UpdateReserve(SInt64 inCurrentTime);
+
+	OSMutex     fMutex;
+	OSQueue     fFreeQueue;
+	OSQueue     fSlabQueue;
+	UInt32      fNumSlabs;
+	UInt32      fReservePackets;
+	UInt32      fPacketsThisInterval;
+	SInt64      fIntervalStart;
+	bool        fDetached;
+
+	static unsigned int sTotalMemoryBytes;
+};
+
+void ReflectorPacket::Release()
+{
+	Assert(fRefCount > 0);
+	if (atomic_sub(&fRefCount, 1) == 0)
+	{
+		Assert(fPool != NULL);
+		fPool->ReturnPacket(this);
+	}
+}
+
 UInt32 ReflectorPacket::GetSSRC(bool isRTCP)
 {
 	if (fPacketPtr.Ptr == NULL || fPacketPtr.Len < 8)
@@ -220,6 +329,9 @@ public:
 	bool  HasSender() { return (this->GetDemuxer()->GetHashTable()->GetNumEntries() > 0); }
 	bool  ProcessPacket(const SInt64& inMilliseconds, ReflectorPacket* thePacket, UInt32 theRemoteAddr, UInt16 theRemotePort);
 	ReflectorPacket*    GetPacket();
+	void                GetPackets(ReflectorPacket** outPackets, UInt32 inNumPackets) { fPacketPool->GetPackets(outPackets, inNumPackets); }
+	void                CountPackets(UInt32 inNumPackets) { fPacketPool->CountPackets(inNumPackets); }
+	ReflectorPacketPool* GetPacketPool() { return fPacketPool; }
 	virtual SInt64      Run();
 	void    SetSSRCFilter(bool state, UInt32 timeoutSecs) { fFilterSSRCs = state; fTimeoutSecs = timeoutSecs; }
 private:
@@ -228,17 +340,16 @@ private:
 	void    GetIncomingData(const SInt64& inMilliseconds);
 	void    FilterInvalidSSRCs(ReflectorPacket* thePacket, bool isRTCP);
 
-	//Number of packets to allocate when the socket is first created
 	enum
 	{
-		kNumPreallocatedPackets = 20,   //UInt32
 		kRefreshBroadcastSessionIntervalMilliSecs = 10000,
-		kSSRCTimeOut = 30000 // milliseconds before clearing the SSRC if no new ssrcs have come in
+		kSSRCTimeOut = 30000, // milliseconds before clearing the SSRC if no new ssrcs have come in
+		kRecvBatchSize = 16 // packets per recvmmsg in GetIncomingData
 	};
 	QTSS_ClientSessionObject    fBroadcasterClientSession;
 	SInt64                      fLastBroadcasterTimeOutRefresh;
-	// Queue of available ReflectorPackets
-	OSQueue fFreeQueue;
+	// Slabs of available ReflectorPackets
+	ReflectorPacketPool* fPacketPool;
 	// Queue of senders
 	OSQueue fSenderQueue;
 	SInt64  fSleepTime;
@@ -271,6 +382,254 @@ public:
 
 };
 
+// ReflectorOutputSet
+//
+// The outputs of a ReflectorStream, kept in one flat array in bucket order. Writers
+// copy the array, change the copy and publish it with a single pointer store. The
+// senders walk whichever copy was current when their pass began, inside an
+// OSEpoch read section, without taking a lock.
+struct ReflectorOutputEntry
+{
+	ReflectorOutput*    fOutput;
+	UInt32              fBucket;    // packets reach this output sBucketDelayInMsec * fBucket late
+};
+
+struct ReflectorOutputSet
+{
+	UInt32                  fNumOutputs;
+	ReflectorOutputEntry    fEntries[1];    // really fNumOutputs long
+};
+
+// ReflectorShard
+//
+// Reflects one slice of a sender's outputs on its own TaskThread. See ReflectorSender.
+// A shard may still be queued on its thread when the sender goes away, so Detach
+// cuts it loose instead of waiting for it to run.
+class ReflectorShard : public Task
+{
+public:
+
+	ReflectorShard(ReflectorSender* inSender, UInt32 inShardIndex);
+	virtual ~ReflectorShard() {}
+
+	virtual SInt64  Run();
+
+	//Waits for a slice that is running right now, then the shard deletes itself
+	void    Detach();
+
+private:
+
+	OSMutex             fMutex;     // held while a slice runs
+	ReflectorSender*    fSender;
+	UInt32              fShardIndex;
+};
+
+// ReflectorGOPCache
+//
+// The newest group of pictures of one stream, held as references on its packets:
+// from the first packet of the latest key frame (SPS, PPS or IDR) to the newest
+// packet. An audio stream starts its group at its first packet after a video key
+// frame, so every track of a new viewer starts at the same point.
+//
+// A packet held here is shared, so RemoveOldPackets leaves it on the sender queue.
+// A new output only has to start its bookmark at GetFirstPacket to get the whole
+// group in its first pass.
+//
+// A group that grows past reflector_gop_cache_msec or reflector_gop_cache_kbytes is
+// dropped, and the cache stays empty until the next key frame. New outputs then
+// start at the buffer delay, as they did before there was a cache.
+//
+// The group is only changed under the sender's queue mutex. The counters are
+// bumped by whichever thread starts a new output.
+class ReflectorGOPCache
+{
+public:
+
+	ReflectorGOPCache();
+	~ReflectorGOPCache();
+
+	// true if inPacket, the first packet of a key frame, belongs to a later frame
+	// than the group we hold
+	bool            StartsNewGroup(ReflectorPacket* inPacket);
+
+	// Drops the group we hold and starts a new one at inPacket
+	void            StartGroup(ReflectorPacket* inPacket);
+
+	// Adds inPacket to the group, if there is one
+	void            AddPacket(ReflectorPacket* inPacket);
+	void            Clear();
+
+	// NULL when there is no group
+	OSQueueElem*    GetFirstPacket() { return (fNumPackets > 0) ? &fPackets[0]->fQueueElem : NULL; }
+
+	// The packets of the key frame the group starts with, each with a reference
+	// the caller releases. Returns how many were put in outPackets.
+	UInt32          GetKeyFramePackets(ReflectorPacket** outPackets, UInt32 inMaxPackets);
+	UInt32          GetNumPackets() { return fNumPackets; }
+	UInt32          GetNumBytes() { return fNumBytes; }
+
+	// A stream that never saw a group (audio only, or a codec we can't find key
+	// frames in) doesn't count hits or misses
+	bool            HasStarted() { return fHasStarted; }
+
+	// STATS
+	// inFirstFrameMSec is how long the output waited between PLAY and its replay
+	void            CountHit(SInt64 inFirstFrameMSec);
+	void            CountMiss() { (void)atomic_add(&fMisses, 1); }
+	UInt32          GetHits() { return fHits; }
+	UInt32          GetMisses() { return fMisses; }
+	UInt32          GetFirstFrameMSecTotal() { return fFirstFrameMSecTotal; }
+
+	static UInt32   sMaxMSec;      // 0 turns the cache off
+	static UInt32   sMaxBytes;
+
+private:
+
+	enum
+	{
+		kMinCapacity = 256  //UInt32
+	};
+
+	void                Append(ReflectorPacket* inPacket);
+
+	ReflectorPacket**   fPackets;
+	UInt32              fNumPackets;
+	UInt32              fCapacity;
+	UInt32              fNumBytes;
+	UInt32              fGroupRTPTime;
+	bool                fHasStarted;
+
+	unsigned int        fHits;      // unsigned int because we need to atomic_add
+	unsigned int        fMisses;
+	unsigned int        fFirstFrameMSecTotal;
+};
+
+// ReflectorPacketHistory
+//
+// The newest RTP packets of one stream, indexed by sequence number, so a viewer's
+// NACK is answered with the very packet every viewer was sent. Viewers share the
+// packets by reference; nothing is copied per viewer.
+//
+// The reflector doesn't renumber packets, so a viewer NACKs the source's sequence
+// numbers. A slot holds whichever packet last hashed to it, and GetPacket checks
+// that it is the one asked for.
+//
+// The history has a mutex of its own, taken for no longer than a lookup, so the
+// RTCP thread answering a NACK never waits for the socket thread.
+class ReflectorPacketHistory
+{
+public:
+
+	ReflectorPacketHistory();
+	~ReflectorPacketHistory();
+
+	void                AddPacket(ReflectorPacket* inPacket);
+	void                Clear();
+
+	// The packet with sequence number inSeqNum, with a reference the caller
+	// releases, or NULL if it is no longer held.
+	ReflectorPacket*    GetPacket(UInt16 inSeqNum);
+
+	static UInt32       sNumPackets;    // a power of 2, 0 turns the history off
+
+private:
+
+	OSMutex             fMutex;
+	ReflectorPacket**   fPackets;       // allocated with the first packet
+	UInt32              fMask;
+};
+
+// ReflectorFECEncoder
+//
+// RFC 5109 ULPFEC for one RTP stream. The parity packets are made once, as the
+// media packets come in, and queued behind them on the same sender, so a stream
+// costs the same XORs whether one viewer takes the FEC or a thousand do.
+//
+// The media packets are taken in windows of reflector_fec_window_packets sequence
+// numbers, and each window gets reflector_fec_parity_packets parity packets. The
+// protection is interleaved: parity packet j covers the packets at offsets j,
+// j + parity, j + 2 * parity... of the window, so a burst of up to parity packets
+// in a row can be recovered.
+//
+// RTSP has no SDP answer to negotiate FEC in, so it is offered as a track of its
+// own (RFC 5109 section 9), grouped with the track it protects (RFC 5956).
+// A viewer that doesn't SETUP the FEC track never sees a parity packet: they go
+// out under GetFECStreamCookie, which only the FEC track's RTP stream carries.
+//
+// Only the socket thread, under the sender's queue mutex, touches an encoder.
+class ReflectorFECEncoder
+{
+public:
+
+	ReflectorFECEncoder();
+	~ReflectorFECEncoder();
+
+	enum
+	{
+		kPayloadType = 127,         // dynamic, offered as ulpfec in the SDP
+		kTrackIDOffset = 1000,      // the FEC track's ID is the protected track's plus this
+		kMaxWindowPackets = 48,     // the longest mask ULPFEC has
+		kMaxParityPackets = 16,
+		kRTPHeaderSize = 12,
+		kFECHeaderSize = 10,
+		kLongLevelHeaderSize = 8,   // with the 48 bit mask
+		kShortLevelHeaderSize = 4,  // with the 16 bit mask
+		// Media packets longer than this are not protected, so that the parity packet
+		// fits ReflectorPacket's kMaxReflectorPacketSize (2060) bytes
+		kMaxProtectionLength = 2060 - kRTPHeaderSize - kFECHeaderSize - kLongLevelHeaderSize
+	};
+
+	// false if inPacket has to go in a new window: call FinishWindow, then AddPacket
+	bool            BelongsToWindow(StrPtrLen* inPacket);
+
+	// XORs inPacket into its parity packet. Duplicates, and packets that are too
+	// short or too long to protect, are left out.
+	void            AddPacket(StrPtrLen* inPacket);
+
+	// true once the window's last sequence number is in
+	bool            IsWindowFull() { return (fNumPackets > 0) && (fLastOffset + 1 == fWindowPackets); }
+
+	// How many parity packets the window needs written (some may turn out empty)
+	UInt32          GetNumParityPackets() { return (fNumPackets > 0) ? fNumParity : 0; }
+
+	// Writes parity packet inIndex of the window to ioBuffer and returns its length,
+	// or 0 if no packet of the window went into it.
+	UInt32          WriteParityPacket(UInt32 inIndex, char* ioBuffer, UInt32 inBufferLen);
+
+	// Clears the window, picking up any change to the prefs
+	void            FinishWindow();
+
+	// The sequence number the next parity packet will get
+	UInt16          GetNextSeqNum() { return fNextSeqNum; }
+
+	// ioDest ^= inSource, 16 bytes at a time where the CPU has vector registers for it
+	static void     XORBytes(UInt8* ioDest, const UInt8* inSource, UInt32 inLength);
+
+	static UInt32   sWindowPackets;
+	static UInt32   sParityPackets;     // 0 turns FEC off
+
+private:
+
+	struct Parity
+	{
+		UInt8       fHeader[8];         // XOR of the first 8 bytes of the RTP headers
+		UInt16      fLength;            // XOR of the lengths after the RTP header
+		UInt16      fProtectionLength;  // the longest of those lengths
+		UInt64      fMask;              // bit x is the packet at window offset x
+		UInt8       fPayload[kMaxProtectionLength];   // zero from fProtectionLength on
+	};
+
+	Parity*         fParity;            // kMaxParityPackets of them, allocated with the first packet
+	UInt32          fWindowPackets;
+	UInt32          fNumParity;
+	UInt32          fNumPackets;        // in the window so far
+	UInt32          fLastOffset;        // of the newest packet in the window
+	UInt16          fSeqNumBase;        // of the window's first packet
+	UInt16          fNextSeqNum;
+	UInt8           fTimeStamp[4];      // of the newest packet, for the parity packets' RTP headers
+	UInt8           fSSRC[4];
+};
+
 class ReflectorSender : public UDPDemuxerTask
 {
 public:
@@ -291,12 +650,62 @@ public:
 
 	//This function gets data from the multicast source and reflects.
 	//Returns the time at which it next needs to be invoked
-	void        ReflectPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue);
+	void        ReflectPackets(SInt64* ioWakeupTime);
 
 	//this is the old way of doing reflect packets. It is only here until the relay code can be cleaned up.
-	void        ReflectRelayPackets(SInt64* ioWakeupTime, OSQueue* inFreeQueue);
+	void        ReflectRelayPackets(SInt64* ioWakeupTime);
+
+	//Sends theOutput everything from currentPacket on, stopping after inLastPacket if that is not NULL.
+	//Lowers *ioNextTimeToRun when the output would block.
+	//Adds the bytes written to *ioBytesSent.
+	OSQueueElem*    SendPacketsToOutput(ReflectorOutput* theOutput, OSQueueElem* currentPacket, SInt64 currentTime, SInt64  bucketDelay, bool firstPacket, OSQueueElem* inLastPacket, SInt64* ioNextTimeToRun, UInt32* ioBytesSent);
+
+	// SHARDS
+	//
+	// Once a stream has more than reflector_outputs_per_shard viewers, ReflectPackets
+	// stops walking the outputs itself. It splits the output set into up to one slice
+	// per short TaskThread and signals a ReflectorShard for each slice. The shards read
+	// fPacketQueue without its mutex, so a pass only ever sends up to fPassLastPacket,
+	// the newest packet when the pass began, and RemoveOldPackets waits for the next
+	// pass. The socket keeps enqueuing packets meanwhile. An output is in exactly one
+	// slice and its bookmark is only moved under its fMutex, so each output still gets
+	// its packets in order.
+	//
+	// Each shard walks the output set that is current when it runs, inside its own
+	// fOutputEpoch read section. A read section never spans a wait for another task,
+	// which may be queued on the very thread that is removing an output. The last
+	// shard of a pass wakes the socket, which starts the next pass if there is work.
+	enum
+	{
+		kMaxShards = 16     //UInt32
+	};
+
+	UInt32      GetNumShards();
+	void        DispatchShards(UInt32 inNumShards);
+	void        ReflectShard(UInt32 inShardIndex);     // runs on the shard's thread
+	void        StopShards();
 
-	OSQueueElem*    SendPacketsToOutput(ReflectorOutput* theOutput, OSQueueElem* currentPacket, SInt64 currentTime, SInt64  bucketDelay, bool firstPacket);
+	//Walks outputs [inFirst, inEnd) of inSet. Returns the bytes written to them.
+	UInt32      ReflectOutputs(ReflectorOutputSet* inSet, UInt32 inFirst, UInt32 inEnd, SInt64* ioNextTimeToRun);
+
+	ReflectorShard*     fShards[kMaxShards];
+	UInt32              fNumShardTasks;     // created so far, they live as long as the sender
+	UInt32              fNumShardsInPass;
+	UInt32              fShardsRunning;     // all of these are guarded by the queue mutex
+	bool                fShardsStopped;
+
+	// Fixed for the length of a pass
+	OSQueueElem*        fPassLastPacket;
+	OSQueueElem*        fPassKeyFramePacket;
+	SInt64              fPassTime;
+	SInt64              fPassInterval;
+	SInt64              fPassNextTimeToRun;
+
+	static unsigned int sShardThreadPicker;
+
+	//fPacketQueue is filled and drained by our socket's Run, under its demuxer mutex.
+	//The accessors below take it themselves.
+	OSMutex*    GetQueueMutex() { return (fSocket != NULL) ? fSocket->GetDemuxer()->GetMutex() : NULL; }
 
 	UInt32      GetOldestPacketRTPTime(bool *foundPtr);
 	UInt16      GetFirstPacketRTPSeqNum(bool *foundPtr);
@@ -305,14 +714,13 @@ public:
 	OSQueueElem*GetClientBufferNextPacketTime(UInt32 inRTPTime);
 	bool      GetFirstRTPTimePacket(UInt16* outSeqNumPtr, UInt32* outRTPTimePtr, SInt64* outArrivalTimePtr);
 
-	void        RemoveOldPackets(OSQueue* inFreeQueue);
+	void        RemoveOldPackets();
 	OSQueueElem* GetClientBufferStartPacketOffset(SInt64 offsetMsec, bool needKeyFrameFirstPacket = false);
 	OSQueueElem* GetClientBufferStartPacket() { return this->GetClientBufferStartPacketOffset(0); };
 
 	// ->geyijyn@20150427
 	// 关键帧索引及丢帧方案
-	OSQueueElem* NeedRelocateBookMark(OSQueueElem* currentElem);
-	OSQueueElem* GetNewestKeyFrameFirstPacket(OSQueueElem* currentElem, SInt64 offsetMsec);
+	OSQueueElem* NeedRelocateBookMark(OSQueueElem* currentElem, OSQueueElem* inKeyFrameElem);
 	bool IsKeyFrameFirstPacket(ReflectorPacket* thePacket);
 	bool IsFrameFirstPacket(ReflectorPacket* thePacket);
 	bool IsFrameLastPacket(ReflectorPacket* thePacket);
@@ -323,7 +731,17 @@ public:
 	OSQueue         fPacketQueue;
 	OSQueueElem*    fFirstNewPacketInQueue;
 	OSQueueElem*    fFirstPacketInQueueForNewOutput;
-	OSQueueElem*	fKeyFrameStartPacketElementPointer;//最新关键帧指针
+	ReflectorGOPCache   fGOPCache;  // RTP senders only
+	ReflectorPacketHistory  fHistory;   // RTP senders only
+	ReflectorFECEncoder fFEC;       // RTP senders only
+
+	// Feeds a media packet to fFEC, and queues the parity packets of any window it
+	// completes. Called by the socket with the queue mutex held.
+	void        ProtectPacket(ReflectorSocket* inSocket, ReflectorPacket* inPacket, SInt64 inMilliseconds);
+	void        QueueParityPackets(ReflectorSocket* inSocket, SInt64 inMilliseconds);
+
+	// The sequence number and RTP time an FEC viewer starting now gets first
+	bool        GetFirstFECPacketInfo(UInt16* outSeqNumPtr, UInt32* outRTPTimePtr);
 
 	//these serve as an optimization, keeping track of when this
 	//sender needs to run so it doesn't run unnecessarily
@@ -345,6 +763,7 @@ public:
 
 	SInt64      fLastRRTime;
 	OSQueueElem fSocketQueueElem;
+	ReflectorSocket*    fSocket;    // set while we are on its sender queue
 
 	friend class ReflectorSocket;
 	friend class ReflectorStream;
@@ -396,7 +815,8 @@ public:
 
 	SInt32  AddOutput(ReflectorOutput* inOutput, SInt32 putInThisBucket);
 
-	// Removes the specified output from this ReflectorStream.
+	// Removes the specified output from this ReflectorStream. Once this returns, neither
+	// sender will touch the output again.
 	void    RemoveOutput(ReflectorOutput* inOutput); // Removes this output from all tracks
 
 	void	TearDownAllOutputs(); // causes a tear down and then a remove
@@ -406,18 +826,40 @@ public:
 	void	SetRTPChannelNum(SInt16 inChannel) { fRTPChannel = inChannel; }
 	void	SetRTCPChannelNum(SInt16 inChannel) { fRTCPChannel = inChannel; }
 	void	PushPacket(char *packet, UInt32 packetLen, bool isRTCP);
+	// Copies a batch of pushed packets in, taking the socket's demuxer lock once
+	void	PushPackets(StrPtrLen* inPackets, UInt32 inNumPackets, bool isRTCP);
 
 	//
 	// ACCESSORS
 	UInt32                  GetBitRate() { return fCurrentBitRate; }
+
+	// RTP bytes pushed to us, and RTP bytes written to all viewers together, since the
+	// stream started. Only the RTP socket's demuxer mutex holder changes them.
+	UInt64                  GetBytesReceived() { return fBytesReceived; }
+	UInt64                  GetBytesReflected() { return fBytesReflected; }
+	// Bytes per second memcpy'd on the way into the packet buffers (pushed streams only,
+	// UDP sources are received straight into them), and the bytes of packet slabs held
+	// by this stream's sockets.
+	UInt32                  GetCopyRate() { return fCurrentCopyRate; }
+	UInt32                  GetPacketMemory();
 	SourceInfo::StreamInfo* GetStreamInfo() { return &fStreamInfo; }
-	OSMutex*                GetMutex() { return &fBucketMutex; }
+	UInt32                  GetNumOutputs() { return fOutputSet->fNumOutputs; }
 	void*                   GetStreamCookie() { return this; }
 	SInt16                  GetRTPChannel() { return fRTPChannel; }
 	SInt16                  GetRTCPChannel() { return fRTCPChannel; }
 	UDPSocketPair*          GetSocketPair() { return fSockets; }
 	ReflectorSender*        GetRTPSender() { return &fRTPSender; }
 	ReflectorSender*        GetRTCPSender() { return &fRTCPSender; }
+	ReflectorGOPCache*      GetGOPCache() { return &fRTPSender.fGOPCache; }
+	ReflectorPacketHistory* GetPacketHistory() { return &fRTPSender.fHistory; }
+
+	// Parity packets are written to outputs with this cookie instead of GetStreamCookie
+	void*                   GetFECStreamCookie() { return &fRTPSender.fFEC; }
+	bool                    IsFECProtected() { return (ReflectorFECEncoder::sParityPackets > 0) && (fStreamInfo.fPayloadType == qtssVideoPayloadType); }
+
+	// The packets of the newest cached video key frame, each with a reference the
+	// caller releases. Returns how many were put in outPackets.
+	UInt32                  GetKeyFramePackets(ReflectorPacket** outPackets, UInt32 inMaxPackets);
 
 	void                    SetHasFirstRTCP(bool hasPacket) { fHasFirstRTCPPacket = hasPacket; }
 	bool                  HasFirstRTCP() { return fHasFirstRTCPPacket; }
@@ -441,9 +883,9 @@ public:
 	inline  void                    UpdateBitRate(SInt64 currentTime);
 	static UInt32           sOverBufferInMsec;
 
-	void                    IncEyeCount() { OSMutexLocker locker(&fBucketMutex); fEyeCount++; }
-	void                    DecEyeCount() { OSMutexLocker locker(&fBucketMutex); fEyeCount--; }
-	UInt32                  GetEyeCount() { OSMutexLocker locker(&fBucketMutex); return fEyeCount; }
+	void                    IncEyeCount() { (void)atomic_add(&fEyeCount, 1); }
+	void                    DecEyeCount() { (void)atomic_sub(&fEyeCount, 1); }
+	UInt32                  GetEyeCount() { return fEyeCount; }
 
 	void					SetMyReflectorSession(ReflectorSession* reflector) { fMyReflectorSession = reflector; }
 	ReflectorSession*		GetMyReflectorSession() { return fMyReflectorSession; }
@@ -452,8 +894,20 @@ private:
 
 	//Sends an RTCP receiver report to the broadcast source
 	void    SendReceiverReport();
-	void    AllocateBucketArray(UInt32 inNumBuckets);
-	SInt32  FindBucket();
+
+	// OUTPUT SET
+	// Adding or removing an output never holds up a sender, see ReflectorOutputSet.
+	typedef ReflectorOutputEntry    OutputEntry;
+	typedef ReflectorOutputSet      OutputSet;
+
+	static OutputSet*   NewOutputSet(UInt32 inNumOutputs);
+	static void         DeleteOutputSet(OutputSet* inSet) { delete[] (char*)inSet; }
+	static SInt32       FindBucket(OutputSet* inSet);
+	static UInt32       GetBucketCount(OutputSet* inSet, UInt32 inBucket);
+
+	// Swaps in inNewSet and frees the old set once no sender can still be using it.
+	// fOutputSetMutex must be held.
+	void    PublishOutputSet(OutputSet* inNewSet);
 
 	// Reflector sockets, retrieved from the socket pool
 	UDPSocketPair*      fSockets;
@@ -471,20 +925,15 @@ private:
 	{
 		kReceiverReportSize = 16,               //UInt32
 		kAppSize = 36,                          //UInt32
-		kMinNumBuckets = 16,                    //UInt32
-		kBitRateAvgIntervalInMilSecs = 30000 // time between bitrate averages
+		kBitRateAvgIntervalInMilSecs = 30000, // time between bitrate averages
+		kPushBatchSize = 32                     //UInt32, pool packets taken at once by PushPackets
 	};
 
-	// BUCKET ARRAY
-	//ReflectorOutputs are kept in a 2-dimensional array, "Buckets"
-	typedef ReflectorOutput** Bucket;
-	Bucket*     fOutputArray;
+	OutputSet* volatile fOutputSet;
+	OSEpoch             fOutputEpoch;
 
-	UInt32      fNumBuckets;        //Number of buckets currently
-	UInt32      fNumElements;       //Number of reflector outputs in the array
-
-	//Bucket array can't be modified while we are sending packets.
-	OSMutex     fBucketMutex;
+	//Serializes changes to fOutputSet. The senders never take it.
+	OSMutex             fOutputSetMutex;
 
 	// RTCP RR information
 
@@ -503,6 +952,10 @@ private:
 	SInt64              fLastBitRateSample;
 	
 	unsigned int        fBytesSentInThisInterval;// unsigned int because we need to atomic_add 
+	UInt64              fBytesReceived;
+	UInt64              fBytesReflected;
+	UInt32              fCurrentCopyRate;
+	unsigned int        fBytesCopiedInThisInterval;
 
 	// If incoming data is RTSP interleaved
 	SInt16              fRTPChannel; //These will be -1 if not set to anything
@@ -512,7 +965,7 @@ private:
 	bool              fHasFirstRTPPacket;
 
 	bool              fEnableBuffer;
-	UInt32              fEyeCount;
+	unsigned int        fEyeCount;  // unsigned int because we need to atomic_add
 
 	UInt32              fFirst_RTCP_RTP_Time;
 	SInt64              fFirst_RTCP_Arrival_Time;
@@ -527,15 +980,15 @@ private:
 	static UInt32       sOverBufferInSec;
 	static UInt32       sBucketDelayInMsec;
 	static bool       sUsePacketReceiveTime;
+	static bool       sUseKernelArrivalTime;
 	static UInt32       sFirstPacketOffsetMsec;
 
 	static UInt32       sRelocatePacketAgeMSec;
+	static UInt32       sOutputsPerShard;
 
 	friend class ReflectorSocket;
+	friend class ReflectorSocketPool;
 	friend class ReflectorSender;
-
-public:
-	CKeyFrameCache*		pkeyFrameCache;
 };
 
 
@@ -551,6 +1004,10 @@ void    ReflectorStream::UpdateBitRate(SInt64 currentTime)
 		bps *= 1000;
 		fCurrentBitRate = (UInt32)bps;
 
+		unsigned int copiedBytes = fBytesCopiedInThisInterval;
+		(void)atomic_sub(&fBytesCopiedInThisInterval, copiedBytes);
+		fCurrentCopyRate = (UInt32)(((Float32)copiedBytes * 1000) / (Float32)(currentTime - fLastBitRateSample));
+
 		// Don't check again for awhile!
 		fLastBitRateSample = currentTime;
 	}
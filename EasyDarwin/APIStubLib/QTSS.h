@@ -109,7 +109,8 @@ enum
     qtssWriteFlagsIsRTP             = 0x00000001,
     qtssWriteFlagsIsRTCP            = 0x00000002,   
     qtssWriteFlagsWriteBurstBegin   = 0x00000004,
-    qtssWriteFlagsBufferData        = 0x00000008
+    qtssWriteFlagsBufferData        = 0x00000008,
+    qtssWriteFlagsIsRetransmission  = 0x00000010    // with IsRTP: a packet a client NACKed, sent again
 };
 typedef UInt32 QTSS_WriteFlags;
 
@@ -695,7 +696,12 @@ enum
     qtssSvrRTSPServerComment        = 35,   //read      //char array //RTSP comment for the server header    
     qtssSvrNumThinned               = 36,   //read      //SInt32    //Number of thinned sessions
     qtssSvrNumThreads               = 37,   //read		//UInt32    //Number of task threads // see also qtssPrefsRunNumThreads
-    qtssSvrNumParams                = 38
+    qtssSvrFileCacheHitPercent      = 38,   //read      //Float32   //% of file block cache lookups that did not read the disk
+    qtssSvrFileCacheBytesSaved      = 39,   //read      //UInt64    //Bytes read out of the file block cache instead of the disk
+    qtssSvrFileCacheEvictions       = 40,   //read      //UInt64    //Blocks evicted from the file block cache
+    qtssSvrMovieCacheHitPercent     = 41,   //read      //Float32   //% of movie opens that found the movie already parsed
+    qtssSvrMovieCacheAvgOpenMsec    = 42,   //read      //Float32   //Average msec a movie open waits for the parsed movie
+    qtssSvrNumParams                = 43
 };
 typedef UInt32 QTSS_ServerAttributes;
 
@@ -813,7 +819,21 @@ enum
 	easyPrefsServiceWANIPAddr				= 84,	// "service_wan_ip"		//char array
 	easyPrefsRTSPWANPort					= 85,	// "rtsp_wan_port"		//UInt16
 
-	qtssPrefsNumParams                      = 86
+	qtssPrefsNumEventThreads                = 86,   // "run_num_event_threads" //UInt32 // number of epoll event threads; 0 means one per short task thread.
+
+	qtssPrefsEnableWorkStealing              = 87,   // "enable_work_stealing_scheduler" //bool // per-thread lock-free run queues; idle task threads steal from busy ones
+
+	qtssPrefsTaskMinWaitTime                 = 88,   // "run_task_min_wait_msec" //UInt32 // shortest sleep, in milliseconds, of a task thread waiting for a timer
+
+	qtssPrefsUDPSendBatchSize                = 89,   // "udp_send_batch_size" //UInt32 // packets per sendmmsg() call for UDP viewers, 0 or 1 sends each packet on its own
+
+	qtssPrefsEnableUDPGSO                    = 90,   // "enable_udp_gso" //bool // coalesce equal sized packets to one UDP viewer with UDP generic segmentation offload
+
+	qtssPrefsEnableAsyncLogs                 = 91,   // "enable_async_logs" //bool // log writes are queued per thread and written in batches by a writer thread
+	qtssPrefsAsyncLogBufferKBytes            = 92,   // "async_log_buffer_kbytes" //UInt32 // size of each thread's log queue
+	qtssPrefsAsyncLogDropWhenFull            = 93,   // "async_log_drop_when_full" //bool // drop log entries when a thread's log queue is full instead of waiting for the writer
+
+	qtssPrefsNumParams                      = 94
 };
 
 typedef UInt32 QTSS_PrefsAttributes;
@@ -1128,6 +1148,18 @@ typedef struct
 
 } QTSS_IncomingData_Params;
 
+// One interleaved frame, '$' header included, as handed to an Easy_IngestProcPtr
+typedef struct
+{
+    char*                       inPacketData;
+    UInt32                      inPacketLen;
+
+} Easy_InterleavedPacket;
+
+// Called with the RTSP session's read lock and the client session mutex held.
+// Must not block, and must not call back into the RTSP session.
+typedef void (*Easy_IngestProcPtr)(void* inCookie, Easy_InterleavedPacket* inPackets, UInt32 inNumPackets);
+
 typedef struct
 {
     QTSS_RTSPSessionObject      inRTSPSession;
@@ -1152,6 +1184,9 @@ typedef struct
     QTSS_RTPStreamObject        inRTPStream;
     void*                       inRTCPPacketData;
     UInt32                      inRTCPPacketDataLen;
+    UInt16*                     inLostSeqNums;          // the packets RFC 4585 generic NACKs in the packet ask for
+    UInt32                      inNumLostSeqNums;
+    bool                        inKeyFrameRequested;    // the packet has a PLI or FIR
 } QTSS_RTCPProcess_Params;
 
 typedef struct
@@ -2035,8 +2070,24 @@ QTSS_Error    QTSS_Authorize(QTSS_RTSPRequestObject inAuthRequestObject, char**
 void        QTSS_LockStdLib();
 void        QTSS_UnlockStdLib();
 
-// Get HLS Sessions(json)
-void*	Easy_GetRTSPPushSessions();
+//  Easy_GetRTSPPushSessions
+//
+//  Returns the pushed sessions as a json message, to be deleted with delete [].
+//  Only sessions whose name contains inName (if not NULL) and whose channel is
+//  inChannel (if not -1) are listed, inPageSize of them (or all if 0) starting
+//  with page inPageNum, counting from 1. Does not hold up the reflector session map.
+void*	Easy_GetRTSPPushSessions(const char* inName, SInt32 inChannel, UInt32 inPageNum, UInt32 inPageSize);
+
+//  Easy_SetRTSPIngestHandler
+//
+//  Hands every interleaved data packet that arrives on inRTSPSession for
+//  inClientSession to inProc, in batches, instead of running them one at a time
+//  through the QTSS_RTSPIncomingData_Role. Pass a NULL inProc to go back to the role.
+//  The handler is dropped by the server when inClientSession goes away.
+//
+//  Returns:            QTSS_NoErr
+//                      QTSS_BadArgument        if inRTSPSession or inClientSession is NULL
+QTSS_Error	Easy_SetRTSPIngestHandler(QTSS_RTSPSessionObject inRTSPSession, QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie);
 
 #ifdef QTSS_OLDROUTINENAMES
 
@@ -396,7 +396,12 @@ void  QTSS_UnlockStdLib()
     (sCallbacks->addr [kUnlockStdLibCallback])  ();
 }
 
-void* Easy_GetRTSPPushSessions()
+void* Easy_GetRTSPPushSessions(const char* inName, SInt32 inChannel, UInt32 inPageNum, UInt32 inPageSize)
 {
-	return (void *) ((QTSS_CallbackPtrProcPtr) sCallbacks->addr [kGetRTSPPushSessionsCallback]) ();
+	return (void *) ((QTSS_CallbackPtrProcPtr) sCallbacks->addr [kGetRTSPPushSessionsCallback]) (inName, inChannel, inPageNum, inPageSize);
+}
+
+QTSS_Error Easy_SetRTSPIngestHandler(QTSS_RTSPSessionObject inRTSPSession, QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie)
+{
+	return (sCallbacks->addr [kSetRTSPIngestHandlerCallback]) (inRTSPSession, inClientSession, inProc, inCookie);
 }
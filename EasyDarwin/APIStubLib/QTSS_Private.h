@@ -119,7 +119,8 @@ enum
     kLockStdLibCallback             = 59,
     kUnlockStdLibCallback           = 60,
 	kGetRTSPPushSessionsCallback	= 61,
-	kLastCallback                   = 62
+	kSetRTSPIngestHandlerCallback	= 62,
+	kLastCallback                   = 63
 };
 
 typedef struct {
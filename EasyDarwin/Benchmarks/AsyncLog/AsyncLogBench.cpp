@@ -0,0 +1,214 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       AsyncLogBench.cpp
+
+	Contains:   Measures what QTSSRollingLog::WriteToLog costs the threads that
+				call it when eight of them log at once, the way task threads do
+				when many sessions tear down together.
+
+				Each mode writes the same access-log sized entries to a fresh
+				log: written directly with the file closed after each write
+				(force_logs_close_on_write), written directly, queued for the
+				writer thread, and queued into the smallest buffers with
+				entries dropped when they fill.
+
+				The log is then read back to check that every entry is there
+				once and in each thread's order, or for the last mode that the
+				#Remark lines account for every entry missing.
+
+				usage: AsyncLogBench [entries per thread] [log dir]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "OS.h"
+#include "OSThread.h"
+#include "QTSSRollingLog.h"
+
+static const UInt32 kNumThreads = 8;
+
+class BenchLog : public QTSSRollingLog
+{
+public:
+
+	BenchLog(const char* inDir, const char* inName) : QTSSRollingLog(), fDir(inDir), fName(inName) {}
+
+	virtual char* GetLogName() { return Copy(fName); }
+	virtual char* GetLogDir() { return Copy(fDir); }
+	virtual UInt32 GetRollIntervalInDays() { return 0; }
+	virtual UInt32 GetMaxLogBytes() { return 0; }
+
+private:
+
+	virtual ~BenchLog() {}
+
+	//the log deletes the strings it gets
+	static char* Copy(const char* inString)
+	{
+		char* theCopy = new char[::strlen(inString) + 1];
+		::strcpy(theCopy, inString);
+		return theCopy;
+	}
+
+	const char* fDir;
+	const char* fName;
+};
+
+class WriterThread : public OSThread
+{
+public:
+
+	WriterThread(QTSSRollingLog* inLog, UInt32 inThreadID, UInt32 inNumEntries)
+		: fLog(inLog), fThreadID(inThreadID), fNumEntries(inNumEntries), fTotalMicros(0), fWorstMicros(0) {}
+	virtual ~WriterThread() {}
+
+	virtual void Entry()
+	{
+		char theEntry[256];
+		for (UInt32 x = 0; x < fNumEntries; x++)
+		{
+			//about the size of an access log entry
+			qtss_snprintf(theEntry, sizeof(theEntry), "%" _U32BITARG_ " %" _U32BITARG_ " 2016-01-01 00:00:00 127.0.0.1 rtsp://example.com/live/stream.sdp"
+				" RTP/AVP 200 1234567 7654321 0.0 10.0 EasyPlayer/1.0\n", fThreadID, x);
+
+			SInt64 theStart = OS::Microseconds();
+			fLog->WriteToLog(theEntry, kAllowLogToRoll);
+			SInt64 theElapsed = OS::Microseconds() - theStart;
+
+			fTotalMicros += theElapsed;
+			if (theElapsed > fWorstMicros)
+				fWorstMicros = theElapsed;
+		}
+	}
+
+	QTSSRollingLog* fLog;
+	UInt32          fThreadID;
+	UInt32          fNumEntries;
+	SInt64          fTotalMicros;
+	SInt64          fWorstMicros;
+};
+
+//
+// Reads the log back. Returns the number of entries found, or 0 if one is
+// out of order or repeated
+static UInt32 CheckLog(const char* inPath, UInt32 inNumEntries, UInt32* outNumDropped)
+{
+	*outNumDropped = 0;
+	FILE* theFile = ::fopen(inPath, "r");
+	if (theFile == NULL)
+		return 0;
+
+	UInt32 theNextEntry[kNumThreads];
+	::memset(theNextEntry, 0, sizeof(theNextEntry));
+
+	UInt32 theNumFound = 0;
+	bool isInOrder = true;
+	char theLine[512];
+	while (::fgets(theLine, sizeof(theLine), theFile) != NULL)
+	{
+		UInt32 theNumDropped = 0;
+		if (::sscanf(theLine, "#Remark: %" _U32BITARG_, &theNumDropped) == 1)
+		{
+			*outNumDropped += theNumDropped;
+			continue;
+		}
+		if (theLine[0] == '#')
+			continue;
+
+		UInt32 theThreadID = 0;
+		UInt32 theEntry = 0;
+		if ((::sscanf(theLine, "%" _U32BITARG_ " %" _U32BITARG_, &theThreadID, &theEntry) != 2) || (theThreadID >= kNumThreads))
+			continue;
+
+		//dropped entries leave gaps, never repeats or reordering
+		if ((theEntry < theNextEntry[theThreadID]) || (theEntry >= inNumEntries))
+			isInOrder = false;
+		theNextEntry[theThreadID] = theEntry + 1;
+		theNumFound++;
+	}
+	::fclose(theFile);
+
+	return isInOrder ? theNumFound : 0;
+}
+
+static void RunMode(const char* inModeName, const char* inLogDir, UInt32 inNumEntries,
+	bool inCloseOnWrite, bool inAsyncWrites, UInt32 inBufferKBytes, bool inDropWhenFull)
+{
+	QTSSRollingLog::SetCloseOnWrite(inCloseOnWrite);
+	QTSSRollingLog::SetAsyncWrites(inAsyncWrites, inBufferKBytes, inDropWhenFull);
+
+	char thePath[1024];
+	qtss_snprintf(thePath, sizeof(thePath), "%s/AsyncLogBench.log", inLogDir);
+	(void)::unlink(thePath);
+
+	BenchLog* theLog = new BenchLog(inLogDir, "AsyncLogBench");
+	theLog->EnableLog();
+
+	WriterThread* theThreads[kNumThreads];
+	SInt64 theRunStart = OS::Microseconds();
+	for (UInt32 x = 0; x < kNumThreads; x++)
+	{
+		theThreads[x] = new WriterThread(theLog, x, inNumEntries);
+		theThreads[x]->Start();
+	}
+
+	SInt64 theTotalMicros = 0;
+	SInt64 theWorstMicros = 0;
+	for (UInt32 y = 0; y < kNumThreads; y++)
+	{
+		theThreads[y]->Join();
+		theTotalMicros += theThreads[y]->fTotalMicros;
+		if (theThreads[y]->fWorstMicros > theWorstMicros)
+			theWorstMicros = theThreads[y]->fWorstMicros;
+		delete theThreads[y];
+	}
+	SInt64 theWriteMicros = OS::Microseconds() - theRunStart;
+
+	//Delete writes out what is still queued; the log itself is a task nobody runs here
+	theLog->Delete();
+	SInt64 theFlushedMicros = OS::Microseconds() - theRunStart;
+
+	UInt32 theNumDropped = 0;
+	UInt32 theNumFound = CheckLog(thePath, inNumEntries, &theNumDropped);
+	UInt32 theNumMissing = (kNumThreads * inNumEntries) - theNumFound - theNumDropped;
+	(void)::unlink(thePath);
+
+	UInt32 theNumWrites = kNumThreads * inNumEntries;
+	::printf("%-14s %10.2f %10" _64BITARG_ "d %10.1f %10.1f %10" _U32BITARG_ " %10" _U32BITARG_ "\n",
+		inModeName, (Float64)theTotalMicros / theNumWrites, theWorstMicros,
+		(Float64)theWriteMicros / 1000, (Float64)theFlushedMicros / 1000, theNumDropped, theNumMissing);
+}
+
+int main(int argc, char* argv[])
+{
+	UInt32 theNumEntries = 20000;
+	if (argc > 1)
+		theNumEntries = ::atoi(argv[1]);
+	if (theNumEntries == 0)
+		theNumEntries = 1;
+
+	const char* theLogDir = "/tmp";
+	if (argc > 2)
+		theLogDir = argv[2];
+
+	OS::Initialize();
+	OSThread::Initialize();
+
+	::printf("%" _U32BITARG_ " threads, %" _U32BITARG_ " entries each\n", kNumThreads, theNumEntries);
+	::printf("%-14s %10s %10s %10s %10s %10s %10s\n", "mode", "us/write", "worst us", "write ms", "flushed ms", "dropped", "missing");
+	RunMode("close each", theLogDir, theNumEntries, true, false, 0, false);
+	RunMode("direct", theLogDir, theNumEntries, false, false, 0, false);
+	RunMode("queued", theLogDir, theNumEntries, false, true, 256, false);
+	RunMode("queued, drop", theLogDir, theNumEntries, false, true, 16, true);
+
+	return 0;
+}
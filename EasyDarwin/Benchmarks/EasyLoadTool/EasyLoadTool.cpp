@@ -0,0 +1,519 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       EasyLoadTool.cpp
+
+	Contains:   An RTSP load generator for a running EasyDarwin, and the scenarios
+				it plays out.
+
+				Pushers ANNOUNCE and RECORD /<name><n>.sdp, replaying an rtpdump
+				file or a synthetic H.264 stream; players DESCRIBE, SETUP and PLAY
+				those streams (or -u) over UDP or TCP, spread evenly across them.
+				Every session is a Task on the CommonUtilitiesLib thread pool, so
+				a few threads drive thousands of them.
+
+				ramp    players join at -r per second until there are -n, then
+				        the load is held for -d seconds
+				churn   as ramp, then every second -c percent of the players
+				        leave and as many new ones join, for -d seconds
+				burst   all -n players join at once, then the load is held for
+				        -d seconds
+
+				Per stream it measures time to first packet, jitter, loss and
+				reordering; with -k it samples the server's CPU every second and
+				divides it by the streams being served. Results go to stdout as
+				a table and, with -j, to a JSON file with full histograms and a
+				per second timeline. Each -l limit is checked at the end and the
+				exit status is 2 if any is broken, so a script can catch
+				regressions.
+
+				usage: EasyLoadTool -h
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <arpa/inet.h>
+
+#include <string>
+#include <vector>
+
+#include "OS.h"
+#include "OSThread.h"
+#include "Socket.h"
+#include "Task.h"
+#include "atomic.h"
+#include "LoadSession.h"
+#include "LoadMedia.h"
+#include "LoadStats.h"
+
+struct LoadLimit
+{
+	std::string fName;
+	bool        fIsMax;
+	Float64     fValue;
+};
+
+struct LoadOptions
+{
+	LoadOptions() : fServer("127.0.0.1"), fPort(554), fScenario("ramp"), fPlayers(100), fPushers(1),
+		fName("EasyLoad"), fDumpFile(NULL), fSDPFile(NULL), fKbps(1000), fTCP(false), fRate(50),
+		fDuration(30), fChurnPercent(5), fServerPid(0), fThreads(0), fUDPPortBase(20000), fJSONFile(NULL) {}
+
+	const char* fServer;
+	UInt16      fPort;
+	const char* fScenario;
+	UInt32      fPlayers;
+	UInt32      fPushers;
+	std::string fURL;
+	const char* fName;
+	const char* fDumpFile;
+	const char* fSDPFile;
+	UInt32      fKbps;
+	bool        fTCP;
+	UInt32      fRate;
+	UInt32      fDuration;
+	UInt32      fChurnPercent;
+	UInt32      fServerPid;
+	UInt32      fThreads;
+	UInt16      fUDPPortBase;
+	const char* fJSONFile;
+	std::vector<LoadLimit> fLimits;
+};
+
+class LoadScenario
+{
+public:
+
+	LoadScenario(const LoadOptions& inOptions, UInt32 inServerAddr, const LoadMediaSource* inSource)
+		: fOptions(inOptions), fServerAddr(inServerAddr), fSource(inSource), fMeasuring(false),
+		fStartMSec(OS::Milliseconds()), fNextSampleMSec(fStartMSec + 1000), fLastSampleMSec(fStartMSec),
+		fLastServerCPU(0), fLastPackets(0) {}
+
+	bool    Run();
+
+	LoadReport  fReport;
+
+private:
+
+	void    StartPushers();
+	void    StartPlayer();
+	void    StopPlayer(UInt32 inIndex);
+	void    RampTo(UInt32 inPlayers);
+	void    Hold(bool inChurn);
+	void    StopAll();
+	void    Wait(SInt64 inMSec);
+	void    Sample();
+
+	std::string GetStreamURL(UInt32 inIndex);
+
+	const LoadOptions&          fOptions;
+	UInt32                      fServerAddr;
+	const LoadMediaSource*      fSource;
+	std::vector<LoadPlayer*>    fPlayers;
+	std::vector<LoadPusher*>    fPushers;
+	bool                        fMeasuring;     // server CPU is only sampled with the full load on
+	SInt64                      fStartMSec;
+	SInt64                      fNextSampleMSec;
+	SInt64                      fLastSampleMSec;
+	UInt64                      fLastServerCPU;
+	UInt32                      fLastPackets;
+};
+
+// utime + stime of a process from /proc/<pid>/stat, in microseconds
+static bool GetProcessCPUMicros(UInt32 inPid, UInt64* outMicros)
+{
+	char thePath[64];
+	::snprintf(thePath, sizeof(thePath), "/proc/%"   _U32BITARG_   "/stat", inPid);
+	FILE* theFile = ::fopen(thePath, "r");
+	if (theFile == NULL)
+		return false;
+
+	char theLine[1024];
+	bool isOK = (::fgets(theLine, sizeof(theLine), theFile) != NULL);
+	::fclose(theFile);
+
+	// The command name is in parentheses and may hold spaces; utime and stime
+	// are the 12th and 13th fields after it
+	char* theFields = isOK ? ::strrchr(theLine, ')') : NULL;
+	unsigned long long theUser = 0, theSystem = 0;
+	if (theFields == NULL || ::sscanf(theFields + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu", &theUser, &theSystem) != 2)
+		return false;
+
+	*outMicros = (UInt64)(theUser + theSystem) * 1000000 / (UInt64)::sysconf(_SC_CLK_TCK);
+	return true;
+}
+
+std::string LoadScenario::GetStreamURL(UInt32 inIndex)
+{
+	if (fOptions.fPushers == 0)
+		return fOptions.fURL;
+
+	char theURL[256];
+	::snprintf(theURL, sizeof(theURL), "rtsp://%s:%u/%s%"   _U32BITARG_   ".sdp", fOptions.fServer, fOptions.fPort, fOptions.fName, inIndex % fOptions.fPushers);
+	return theURL;
+}
+
+void LoadScenario::StartPushers()
+{
+	for (UInt32 x = 0; x < fOptions.fPushers; x++)
+	{
+		LoadPusher* thePusher = new LoadPusher(&fReport, fServerAddr, fOptions.fPort, this->GetStreamURL(x), fSource);
+		fPushers.push_back(thePusher);
+		thePusher->Start();
+	}
+
+	// Give them a few seconds to get going, then play what there is
+	SInt64 theGiveUp = OS::Milliseconds() + 5000;
+	while (fReport.fPushing < fOptions.fPushers && OS::Milliseconds() < theGiveUp)
+		this->Wait(10);
+	if (fReport.fPushing < fOptions.fPushers)
+		::fprintf(stderr, "only %u of %"   _U32BITARG_   " pushers are recording\n", fReport.fPushing, fOptions.fPushers);
+}
+
+void LoadScenario::StartPlayer()
+{
+	LoadPlayer* thePlayer = new LoadPlayer(&fReport, fServerAddr, fOptions.fPort, this->GetStreamURL(fReport.fStarted), fOptions.fTCP);
+	fPlayers.push_back(thePlayer);
+	thePlayer->Start();
+}
+
+void LoadScenario::StopPlayer(UInt32 inIndex)
+{
+	// The player deletes itself once it has reported
+	fPlayers[inIndex]->Stop();
+	fPlayers[inIndex] = fPlayers.back();
+	fPlayers.pop_back();
+}
+
+void LoadScenario::RampTo(UInt32 inPlayers)
+{
+	SInt64 theStart = OS::Milliseconds();
+	UInt32 theFirst = (UInt32)fPlayers.size();
+	while (fPlayers.size() < inPlayers)
+	{
+		UInt32 theDue = theFirst + (UInt32)(((OS::Milliseconds() - theStart) * fOptions.fRate) / 1000) + 1;
+		while (fPlayers.size() < theDue && fPlayers.size() < inPlayers)
+			this->StartPlayer();
+		this->Wait(10);
+	}
+}
+
+void LoadScenario::Hold(bool inChurn)
+{
+	fMeasuring = true;
+	for (UInt32 theSecond = 0; theSecond < fOptions.fDuration; theSecond++)
+	{
+		if (inChurn && !fPlayers.empty())
+		{
+			UInt32 theChurn = (UInt32)((fPlayers.size() * fOptions.fChurnPercent) / 100);
+			if (theChurn == 0)
+				theChurn = 1;
+			for (UInt32 x = 0; x < theChurn; x++)
+				this->StopPlayer((UInt32)(::rand() % fPlayers.size()));
+			for (UInt32 x = 0; x < theChurn; x++)
+				this->StartPlayer();
+		}
+		this->Wait(1000);
+	}
+	fMeasuring = false;
+}
+
+void LoadScenario::StopAll()
+{
+	UInt32 theNumPushers = (UInt32)fPushers.size();
+	while (!fPlayers.empty())
+		this->StopPlayer((UInt32)fPlayers.size() - 1);
+
+	SInt64 theGiveUp = OS::Milliseconds() + 10000;
+	while (fReport.fFinished + theNumPushers < fReport.fStarted && OS::Milliseconds() < theGiveUp)
+		OSThread::Sleep(10);
+
+	for (UInt32 x = 0; x < theNumPushers; x++)
+		fPushers[x]->Stop();
+	fPushers.clear();
+
+	theGiveUp = OS::Milliseconds() + 10000;
+	while (fReport.fFinished < fReport.fStarted && OS::Milliseconds() < theGiveUp)
+		OSThread::Sleep(10);
+}
+
+void LoadScenario::Wait(SInt64 inMSec)
+{
+	SInt64 theEnd = OS::Milliseconds() + inMSec;
+	for (SInt64 theNow = OS::Milliseconds(); theNow < theEnd; theNow = OS::Milliseconds())
+	{
+		if (theNow >= fNextSampleMSec)
+			this->Sample();
+		SInt64 theSleep = theEnd - theNow;
+		if (theSleep > fNextSampleMSec - theNow)
+			theSleep = fNextSampleMSec - theNow;
+		if (theSleep > 0)
+			OSThread::Sleep((UInt32)theSleep);
+	}
+}
+
+void LoadScenario::Sample()
+{
+	SInt64 theNow = OS::Milliseconds();
+	SInt64 theElapsed = theNow - fLastSampleMSec;
+	fLastSampleMSec = theNow;
+	fNextSampleMSec += 1000;
+	if (theElapsed <= 0)
+		return;
+
+	UInt32 theStreams = fReport.fPlaying + fReport.fPushing;
+	Float64 theServerPercent = 0;
+	UInt64 theServerCPU = 0;
+	if (fOptions.fServerPid != 0 && GetProcessCPUMicros(fOptions.fServerPid, &theServerCPU))
+	{
+		if (fLastServerCPU != 0)
+		{
+			UInt64 theUsed = theServerCPU - fLastServerCPU;
+			theServerPercent = (Float64)theUsed / (Float64)(theElapsed * 10);
+			if (fMeasuring && theStreams > 0)
+				fReport.AddServerCPUSample((theUsed * 1000) / (UInt64)theElapsed / theStreams);
+		}
+		fLastServerCPU = theServerCPU;
+	}
+
+	UInt32 thePackets = fReport.fPacketsReceived;
+	UInt32 theSecond = (UInt32)((theNow - fStartMSec + 500) / 1000);
+	fReport.AddTimelineSample(theSecond, fReport.fPlaying, fReport.fPushing, theServerPercent, thePackets - fLastPackets);
+
+	::printf("%4"   _U32BITARG_   "s  players %5u/%-5u pushers %3u  server cpu %6.1f%%  %8"   _U32BITARG_   " pkts/s\n",
+		theSecond, fReport.fPlaying, (unsigned int)fPlayers.size(), fReport.fPushing, theServerPercent,
+		(UInt32)(((UInt64)(thePackets - fLastPackets) * 1000) / (UInt64)theElapsed));
+	::fflush(stdout);
+	fLastPackets = thePackets;
+}
+
+bool LoadScenario::Run()
+{
+	this->StartPushers();
+
+	if (::strcmp(fOptions.fScenario, "burst") == 0)
+	{
+		// Let the pushed streams settle so everyone joins a running stream
+		this->Wait(1000);
+		while (fPlayers.size() < fOptions.fPlayers)
+			this->StartPlayer();
+		this->Hold(false);
+	}
+	else
+	{
+		this->RampTo(fOptions.fPlayers);
+		this->Hold(::strcmp(fOptions.fScenario, "churn") == 0);
+	}
+
+	this->StopAll();
+	return true;
+}
+
+static void Usage(const char* inName)
+{
+	::printf("usage: %s [options]\n"
+		"  -s addr     server address (127.0.0.1)\n"
+		"  -p port     RTSP port (554)\n"
+		"  -S name     scenario: ramp, churn or burst (ramp)\n"
+		"  -n num      players (100)\n"
+		"  -P num      pushers (1); with 0 the players play -u\n"
+		"  -u url      what the players play when there are no pushers\n"
+		"  -a name     pushers publish /<name><n>.sdp (EasyLoad)\n"
+		"  -f file     rtpdump file for the pushers to replay, with -m\n"
+		"  -m file     the SDP that goes with -f\n"
+		"  -b kbps     bitrate of the synthetic stream pushed without -f (1000)\n"
+		"  -t proto    player transport, udp or tcp (udp)\n"
+		"  -r num      players that join per second in ramp and churn (50)\n"
+		"  -d secs     how long the full load is held (30)\n"
+		"  -c pct      percent of the players replaced every second in churn (5)\n"
+		"  -k pid      the server process, to measure its CPU\n"
+		"  -T num      task threads (one per processor)\n"
+		"  -o port     first UDP port for the players (20000)\n"
+		"  -j file     write the results as JSON\n"
+		"  -l limit    name<=value or name>=value, checked at the end; may be repeated.\n"
+		"              names: started, failed, streams, dropped, or a histogram and a\n"
+		"              statistic such as ttfp_us.p99 or loss_ppm.max\n", inName);
+}
+
+static bool ParseLimit(const char* inArg, LoadLimit* outLimit)
+{
+	const char* theOp = ::strstr(inArg, "<=");
+	if (theOp == NULL)
+		theOp = ::strstr(inArg, ">=");
+	if (theOp == NULL || theOp == inArg)
+		return false;
+
+	outLimit->fName.assign(inArg, theOp - inArg);
+	outLimit->fIsMax = (theOp[0] == '<');
+	char* theEnd = NULL;
+	outLimit->fValue = ::strtod(theOp + 2, &theEnd);
+	return theEnd != theOp + 2 && *theEnd == '\0';
+}
+
+static bool CheckLimits(LoadReport* inReport, const std::vector<LoadLimit>& inLimits)
+{
+	bool isOK = true;
+	for (UInt32 x = 0; x < inLimits.size(); x++)
+	{
+		const LoadLimit& theLimit = inLimits[x];
+		Float64 theValue = 0;
+		if (!inReport->GetValue(theLimit.fName.c_str(), &theValue))
+		{
+			::printf("limit %s: unknown\n", theLimit.fName.c_str());
+			isOK = false;
+			continue;
+		}
+
+		bool isMet = theLimit.fIsMax ? (theValue <= theLimit.fValue) : (theValue >= theLimit.fValue);
+		::printf("limit %s %s %g: %g %s\n", theLimit.fName.c_str(), theLimit.fIsMax ? "<=" : ">=", theLimit.fValue, theValue, isMet ? "ok" : "BROKEN");
+		isOK = isOK && isMet;
+	}
+	return isOK;
+}
+
+int main(int argc, char* argv[])
+{
+	LoadOptions theOptions;
+
+	int ch;
+	while ((ch = ::getopt(argc, argv, "s:p:S:n:P:u:a:f:m:b:t:r:d:c:k:T:o:j:l:h")) != -1)
+	{
+		switch (ch)
+		{
+		case 's': theOptions.fServer = optarg; break;
+		case 'p': theOptions.fPort = (UInt16)::atoi(optarg); break;
+		case 'S': theOptions.fScenario = optarg; break;
+		case 'n': theOptions.fPlayers = (UInt32)::atoi(optarg); break;
+		case 'P': theOptions.fPushers = (UInt32)::atoi(optarg); break;
+		case 'u': theOptions.fURL = optarg; break;
+		case 'a': theOptions.fName = optarg; break;
+		case 'f': theOptions.fDumpFile = optarg; break;
+		case 'm': theOptions.fSDPFile = optarg; break;
+		case 'b': theOptions.fKbps = (UInt32)::atoi(optarg); break;
+		case 't': theOptions.fTCP = (::strcmp(optarg, "tcp") == 0); break;
+		case 'r': theOptions.fRate = (UInt32)::atoi(optarg); break;
+		case 'd': theOptions.fDuration = (UInt32)::atoi(optarg); break;
+		case 'c': theOptions.fChurnPercent = (UInt32)::atoi(optarg); break;
+		case 'k': theOptions.fServerPid = (UInt32)::atoi(optarg); break;
+		case 'T': theOptions.fThreads = (UInt32)::atoi(optarg); break;
+		case 'o': theOptions.fUDPPortBase = (UInt16)::atoi(optarg); break;
+		case 'j': theOptions.fJSONFile = optarg; break;
+		case 'l':
+		{
+			LoadLimit theLimit;
+			if (!ParseLimit(optarg, &theLimit))
+			{
+				::fprintf(stderr, "bad limit %s\n", optarg);
+				return 1;
+			}
+			theOptions.fLimits.push_back(theLimit);
+			break;
+		}
+		default:
+			Usage(argv[0]);
+			return 1;
+		}
+	}
+
+	UInt32 theServerAddr = ::inet_addr(theOptions.fServer);
+	bool isScenarioKnown = ::strcmp(theOptions.fScenario, "ramp") == 0 || ::strcmp(theOptions.fScenario, "churn") == 0
+		|| ::strcmp(theOptions.fScenario, "burst") == 0;
+	if (theServerAddr == INADDR_NONE || !isScenarioKnown || theOptions.fRate == 0
+		|| (theOptions.fPushers == 0 && theOptions.fURL.empty()) || ((theOptions.fDumpFile == NULL) != (theOptions.fSDPFile == NULL)))
+	{
+		Usage(argv[0]);
+		return 1;
+	}
+	theServerAddr = ntohl(theServerAddr);
+
+	OS::Initialize();
+	OSThread::Initialize();
+	::signal(SIGPIPE, SIG_IGN);
+
+	// Every player holds a TCP socket and two UDP sockets per track
+	struct rlimit theLimit;
+	if (::getrlimit(RLIMIT_NOFILE, &theLimit) == 0 && theLimit.rlim_cur < theLimit.rlim_max)
+	{
+		theLimit.rlim_cur = theLimit.rlim_max;
+		(void)::setrlimit(RLIMIT_NOFILE, &theLimit);
+	}
+
+	LoadMediaSource theSource;
+	if (theOptions.fDumpFile != NULL)
+	{
+		if (!theSource.ReadFile(theOptions.fDumpFile, theOptions.fSDPFile))
+			return 1;
+	}
+	else
+		theSource.Synthesize(theOptions.fKbps, theOptions.fServer);
+
+	UInt32 theNumThreads = theOptions.fThreads;
+	if (theNumThreads == 0)
+		theNumThreads = OS::GetNumProcessors();
+	if (theNumThreads == 0)
+		theNumThreads = 2;
+
+	TaskThreadPool::SetNumShortTaskThreads(theNumThreads);
+	TaskThreadPool::SetNumBlockingTaskThreads(1);
+	TaskThreadPool::AddThreads(theNumThreads + 1);
+	Socket::Initialize(theNumThreads);
+	Socket::StartThread();
+	LoadSession::SetUDPPortBase(theOptions.fUDPPortBase);
+	::srand((unsigned int)OS::Milliseconds());
+
+	struct rusage theUsageStart;
+	::getrusage(RUSAGE_SELF, &theUsageStart);
+	SInt64 theStartMSec = OS::Milliseconds();
+
+	LoadScenario theScenario(theOptions, theServerAddr, &theSource);
+	theScenario.Run();
+
+	// How busy the load generator was; near 100% per thread means the numbers say more about it than the server
+	struct rusage theUsageEnd;
+	::getrusage(RUSAGE_SELF, &theUsageEnd);
+	SInt64 theCPUMicros = ((SInt64)theUsageEnd.ru_utime.tv_sec - theUsageStart.ru_utime.tv_sec + theUsageEnd.ru_stime.tv_sec - theUsageStart.ru_stime.tv_sec) * 1000000
+		+ theUsageEnd.ru_utime.tv_usec - theUsageStart.ru_utime.tv_usec + theUsageEnd.ru_stime.tv_usec - theUsageStart.ru_stime.tv_usec;
+	SInt64 theWallMSec = OS::Milliseconds() - theStartMSec;
+	Float64 theClientPercent = theWallMSec > 0 ? (Float64)theCPUMicros / (Float64)(theWallMSec * 10) : 0;
+
+	::printf("\n%s: %"   _U32BITARG_   " players, %"   _U32BITARG_   " pushers, %s, EasyLoadTool used %.1f%% cpu\n",
+		theOptions.fScenario, theOptions.fPlayers, theOptions.fPushers, theOptions.fTCP ? "tcp" : "udp", theClientPercent);
+	theScenario.fReport.PrintSummary(stdout);
+
+	if (theOptions.fJSONFile != NULL)
+	{
+		char theParams[1024];
+		::snprintf(theParams, sizeof(theParams),
+			"\"server\": \"%s:%u\", \"players\": %"   _U32BITARG_   ", \"pushers\": %"   _U32BITARG_   ", \"transport\": \"%s\", "
+			"\"rate\": %"   _U32BITARG_   ", \"duration\": %"   _U32BITARG_   ", \"churn_pct\": %"   _U32BITARG_   ", \"source\": \"%s\", \"kbps\": %"   _U32BITARG_   ", \"threads\": %"   _U32BITARG_   "",
+			theOptions.fServer, theOptions.fPort, theOptions.fPlayers, theOptions.fPushers, theOptions.fTCP ? "tcp" : "udp",
+			theOptions.fRate, theOptions.fDuration, theOptions.fChurnPercent,
+			theOptions.fPushers == 0 ? "url" : (theOptions.fDumpFile != NULL ? "rtpdump" : "synthetic"), theOptions.fKbps, theNumThreads);
+
+		FILE* theFile = ::fopen(theOptions.fJSONFile, "w");
+		if (theFile == NULL)
+		{
+			::fprintf(stderr, "can't write %s\n", theOptions.fJSONFile);
+			return 1;
+		}
+		theScenario.fReport.WriteJSON(theFile, theOptions.fScenario, theParams, theClientPercent);
+		::fclose(theFile);
+	}
+
+	bool isOK = CheckLimits(&theScenario.fReport, theOptions.fLimits);
+
+	// The task threads may still hold sessions that missed the deadline in StopAll
+	::fflush(stdout);
+	::_exit(isOK ? 0 : 2);
+	return 0;
+}
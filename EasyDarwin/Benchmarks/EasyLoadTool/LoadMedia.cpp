@@ -0,0 +1,277 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadMedia.cpp
+
+	Contains:   Implementation of LoadMediaSource
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "LoadMedia.h"
+
+static const UInt32 kPayloadType = 96;
+static const UInt32 kMaxRTPPayload = 1400;
+static const UInt32 kFramesPerSec = 25;
+static const UInt32 kFramesPerGOP = 50;
+
+// Baseline profile, 640x480
+static const UInt8 sSPS[] = { 0x67, 0x42, 0x00, 0x1f, 0x95, 0xa8, 0x14, 0x01, 0x6e, 0x40 };
+static const UInt8 sPPS[] = { 0x68, 0xce, 0x3c, 0x80 };
+
+static UInt32 GetUInt16(const UInt8* inP) { return ((UInt32)inP[0] << 8) | inP[1]; }
+static UInt32 GetUInt32(const UInt8* inP) { return ((UInt32)inP[0] << 24) | ((UInt32)inP[1] << 16) | ((UInt32)inP[2] << 8) | inP[3]; }
+
+bool LoadMediaSource::ParseSDP(const char* inSDP, UInt32 inLen, std::vector<LoadTrack>* outTracks)
+{
+	outTracks->clear();
+
+	const char* theLine = inSDP;
+	const char* theEnd = inSDP + inLen;
+	while (theLine < theEnd)
+	{
+		const char* theEOL = theLine;
+		while (theEOL < theEnd && *theEOL != '\r' && *theEOL != '\n')
+			theEOL++;
+		std::string theText(theLine, theEOL - theLine);
+		while (theEOL < theEnd && (*theEOL == '\r' || *theEOL == '\n'))
+			theEOL++;
+		theLine = theEOL;
+
+		if (theText.compare(0, 2, "m=") == 0)
+		{
+			// m=<media> <port> <proto> <fmt> ...
+			LoadTrack theTrack;
+			char theMedia[32] = "";
+			unsigned int thePort = 0, thePayloadType = 0;
+			if (::sscanf(theText.c_str(), "m=%31s %u %*s %u", theMedia, &thePort, &thePayloadType) < 3)
+				continue;
+			theTrack.fPayloadType = thePayloadType;
+			if (::strcmp(theMedia, "audio") == 0 || thePayloadType == 0 || thePayloadType == 8)
+				theTrack.fClockRate = 8000;
+			outTracks->push_back(theTrack);
+		}
+		else if (outTracks->empty())
+		{
+			continue;   // session level
+		}
+		else if (theText.compare(0, 9, "a=rtpmap:") == 0)
+		{
+			unsigned int thePayloadType = 0, theClockRate = 0;
+			if (::sscanf(theText.c_str(), "a=rtpmap:%u %*[^/]/%u", &thePayloadType, &theClockRate) == 2
+				&& thePayloadType == outTracks->back().fPayloadType && theClockRate != 0)
+				outTracks->back().fClockRate = theClockRate;
+		}
+		else if (theText.compare(0, 10, "a=control:") == 0)
+		{
+			outTracks->back().fControl = theText.substr(10);
+		}
+	}
+	return !outTracks->empty();
+}
+
+void LoadMediaSource::AddPacket(UInt32 inTrack, UInt32 inTimeMSec, const UInt8* inData, UInt32 inLen)
+{
+	Packet thePacket = { inTrack, inTimeMSec, (UInt32)fData.size(), inLen };
+	fPackets.push_back(thePacket);
+	fData.append((const char*)inData, inLen);
+
+	if (fFirstTimestamps.size() <= inTrack)
+	{
+		fFirstTimestamps.resize(inTrack + 1, 0);
+		fHaveTimestamp.resize(inTrack + 1, false);
+	}
+	if (!fHaveTimestamp[inTrack])
+	{
+		fFirstTimestamps[inTrack] = GetUInt32(inData + 4);
+		fHaveTimestamp[inTrack] = true;
+	}
+}
+
+bool LoadMediaSource::ReadFile(const char* inDumpPath, const char* inSDPPath)
+{
+	FILE* theSDPFile = ::fopen(inSDPPath, "rb");
+	if (theSDPFile == NULL)
+	{
+		::fprintf(stderr, "can't open %s\n", inSDPPath);
+		return false;
+	}
+	char theBuffer[65536];
+	size_t theLen = ::fread(theBuffer, 1, sizeof(theBuffer), theSDPFile);
+	::fclose(theSDPFile);
+	fSDP.assign(theBuffer, theLen);
+	if (!ParseSDP(fSDP.data(), (UInt32)fSDP.size(), &fTracks))
+	{
+		::fprintf(stderr, "%s has no m= lines\n", inSDPPath);
+		return false;
+	}
+
+	FILE* theFile = ::fopen(inDumpPath, "rb");
+	if (theFile == NULL)
+	{
+		::fprintf(stderr, "can't open %s\n", inDumpPath);
+		return false;
+	}
+
+	// "#!rtpplay1.0 address/port\n", then a 16 byte binary header we don't need
+	if (::fgets(theBuffer, sizeof(theBuffer), theFile) == NULL || ::strncmp(theBuffer, "#!rtpplay1.0 ", 13) != 0
+		|| ::fread(theBuffer, 1, 16, theFile) != 16)
+	{
+		::fprintf(stderr, "%s is not an rtpdump file\n", inDumpPath);
+		::fclose(theFile);
+		return false;
+	}
+
+	// Each packet: UInt16 length including these 8 bytes, UInt16 RTP length (0 for RTCP),
+	// UInt32 milliseconds since the start of the recording
+	UInt8 theHeader[8];
+	bool haveFirstTime = false;
+	UInt32 theFirstTime = 0;
+	UInt32 theLastTime = 0;
+	while (::fread(theHeader, 1, sizeof(theHeader), theFile) == sizeof(theHeader))
+	{
+		UInt32 theRecordLen = GetUInt16(theHeader);
+		UInt32 theRTPLen = GetUInt16(theHeader + 2);
+		UInt32 theTime = GetUInt32(theHeader + 4);
+		if (theRecordLen < sizeof(theHeader))
+			break;
+		theRecordLen -= sizeof(theHeader);
+		if (::fread(theBuffer, 1, theRecordLen, theFile) != theRecordLen)
+			break;
+
+		// RTCP, or a packet cut short when it was recorded
+		if (theRTPLen == 0 || theRTPLen > theRecordLen || theRTPLen < 12 || ((UInt8)theBuffer[0] & 0xC0) != 0x80)
+			continue;
+
+		UInt32 thePayloadType = (UInt8)theBuffer[1] & 0x7F;
+		UInt32 theTrack = 0;
+		while (theTrack < fTracks.size() && fTracks[theTrack].fPayloadType != thePayloadType)
+			theTrack++;
+		if (theTrack == fTracks.size())
+		{
+			if (fTracks.size() != 1)
+				continue;
+			theTrack = 0;
+		}
+
+		if (!haveFirstTime)
+		{
+			theFirstTime = theTime;
+			haveFirstTime = true;
+		}
+		theLastTime = theTime - theFirstTime;
+		this->AddPacket(theTrack, theLastTime, (const UInt8*)theBuffer, theRTPLen);
+	}
+	::fclose(theFile);
+
+	if (fPackets.empty())
+	{
+		::fprintf(stderr, "%s has no RTP packets for the tracks in %s\n", inDumpPath, inSDPPath);
+		return false;
+	}
+
+	// Leave one average packet gap between the last packet and the next pass
+	fDurationMSec = theLastTime + (fPackets.size() > 1 ? theLastTime / (UInt32)(fPackets.size() - 1) : 0) + 1;
+	return true;
+}
+
+void LoadMediaSource::AddNAL(UInt32 inTimeMSec, UInt32 inTimestamp, UInt16* ioSeq, const UInt8* inNAL, UInt32 inLen, bool inLastOfFrame)
+{
+	UInt8 thePacket[12 + 2 + kMaxRTPPayload];
+	thePacket[0] = 0x80;
+	thePacket[4] = (UInt8)(inTimestamp >> 24);
+	thePacket[5] = (UInt8)(inTimestamp >> 16);
+	thePacket[6] = (UInt8)(inTimestamp >> 8);
+	thePacket[7] = (UInt8)inTimestamp;
+	::memset(&thePacket[8], 0, 4);
+
+	// Fragment with FU-A when the NAL doesn't fit one packet
+	bool isFragmented = (inLen > kMaxRTPPayload);
+	const UInt8* theData = isFragmented ? inNAL + 1 : inNAL;
+	UInt32 theLeft = isFragmented ? inLen - 1 : inLen;
+	bool isStart = true;
+	while (theLeft > 0)
+	{
+		UInt32 theHeaderLen = 12;
+		UInt32 theChunk = theLeft;
+		if (isFragmented)
+		{
+			if (theChunk > kMaxRTPPayload - 2)
+				theChunk = kMaxRTPPayload - 2;
+			thePacket[12] = (inNAL[0] & 0xE0) | 28;
+			thePacket[13] = (isStart ? 0x80 : 0) | (theChunk == theLeft ? 0x40 : 0) | (inNAL[0] & 0x1F);
+			theHeaderLen = 14;
+		}
+
+		bool isMarker = inLastOfFrame && (theChunk == theLeft);
+		thePacket[1] = (UInt8)(kPayloadType | (isMarker ? 0x80 : 0));
+		thePacket[2] = (UInt8)(*ioSeq >> 8);
+		thePacket[3] = (UInt8)*ioSeq;
+		(*ioSeq)++;
+
+		::memcpy(&thePacket[theHeaderLen], theData, theChunk);
+		this->AddPacket(0, inTimeMSec, thePacket, theHeaderLen + theChunk);
+
+		theData += theChunk;
+		theLeft -= theChunk;
+		isStart = false;
+	}
+}
+
+void LoadMediaSource::Synthesize(UInt32 inKbps, const char* inServerAddr)
+{
+	char theSDP[1024];
+	::snprintf(theSDP, sizeof(theSDP),
+		"v=0\r\n"
+		"o=- 0 0 IN IP4 %s\r\n"
+		"s=EasyLoadTool\r\n"
+		"c=IN IP4 %s\r\n"
+		"t=0 0\r\n"
+		"a=control:*\r\n"
+		"m=video 0 RTP/AVP %u\r\n"
+		"a=rtpmap:%u H264/90000\r\n"
+		"a=fmtp:%u packetization-mode=1;profile-level-id=42001F;sprop-parameter-sets=Z0IAH5WoFAFuQA==,aM48gA==\r\n"
+		"a=control:trackID=1\r\n",
+		inServerAddr, inServerAddr, kPayloadType, kPayloadType, kPayloadType);
+	fSDP = theSDP;
+	(void)ParseSDP(fSDP.data(), (UInt32)fSDP.size(), &fTracks);
+
+	// An IDR frame is five times a P frame
+	UInt32 theGOPBytes = (inKbps * 1000 / 8) * kFramesPerGOP / kFramesPerSec;
+	UInt32 thePFrameBytes = theGOPBytes / (kFramesPerGOP + 4);
+	if (thePFrameBytes < 64)
+		thePFrameBytes = 64;
+
+	std::string theNAL;
+	UInt32 theRandom = 0x2545F491;
+	UInt16 theSeq = 0;
+	for (UInt32 theFrame = 0; theFrame < kFramesPerGOP; theFrame++)
+	{
+		UInt32 theTimeMSec = theFrame * 1000 / kFramesPerSec;
+		UInt32 theTimestamp = theFrame * (90000 / kFramesPerSec);
+		bool isIDR = (theFrame == 0);
+		if (isIDR)
+		{
+			this->AddNAL(theTimeMSec, theTimestamp, &theSeq, sSPS, sizeof(sSPS), false);
+			this->AddNAL(theTimeMSec, theTimestamp, &theSeq, sPPS, sizeof(sPPS), false);
+		}
+
+		theNAL.assign(isIDR ? thePFrameBytes * 5 : thePFrameBytes, '\0');
+		theNAL[0] = isIDR ? 0x65 : 0x41;
+		for (UInt32 x = 1; x < theNAL.size(); x++)
+		{
+			theRandom = theRandom * 1103515245 + 12345;
+			theNAL[x] = (char)(theRandom >> 16);
+		}
+		this->AddNAL(theTimeMSec, theTimestamp, &theSeq, (const UInt8*)theNAL.data(), (UInt32)theNAL.size(), true);
+	}
+
+	fDurationMSec = kFramesPerGOP * 1000 / kFramesPerSec;
+}
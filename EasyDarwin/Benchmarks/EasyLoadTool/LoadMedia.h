@@ -0,0 +1,90 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadMedia.h
+
+	Contains:   What the pushers send, and the SDP both sides go by.
+
+				LoadMediaSource holds the RTP packets of a stream in memory, each
+				with its track and its time in milliseconds from the start. They
+				come either from an rtpdump file (the rtptools format, as written
+				by rtpdump -F dump) with the SDP it was recorded from, or from
+				Synthesize(), which builds two seconds of H.264 packetized the way
+				a camera does: SPS and PPS, an IDR frame, then P frames, with FU-A
+				fragments. One source is shared read-only by every pusher, which
+				plays it in a loop.
+*/
+
+#ifndef __LOAD_MEDIA_H__
+#define __LOAD_MEDIA_H__
+
+#include <string>
+#include <vector>
+
+#include "OSHeaders.h"
+
+struct LoadTrack
+{
+	LoadTrack() : fPayloadType(0), fClockRate(90000) {}
+
+	UInt32      fPayloadType;
+	UInt32      fClockRate;
+	std::string fControl;       // as in the SDP, which may be relative
+};
+
+class LoadMediaSource
+{
+public:
+
+	struct Packet
+	{
+		UInt32  fTrack;
+		UInt32  fTimeMSec;
+		UInt32  fOffset;        // of the RTP header in the source's data
+		UInt32  fLen;
+	};
+
+	LoadMediaSource() : fDurationMSec(0) {}
+
+	// The media tracks of an SDP, in order; false if it has none
+	static bool ParseSDP(const char* inSDP, UInt32 inLen, std::vector<LoadTrack>* outTracks);
+
+	// Returns false and prints why if either file can't be used
+	bool    ReadFile(const char* inDumpPath, const char* inSDPPath);
+
+	// inKbps of 25 fps video with an IDR frame every two seconds
+	void    Synthesize(UInt32 inKbps, const char* inServerAddr);
+
+	const std::string&  GetSDP() const { return fSDP; }
+	UInt32              GetNumTracks() const { return (UInt32)fTracks.size(); }
+	const LoadTrack&    GetTrack(UInt32 inIndex) const { return fTracks[inIndex]; }
+	UInt32              GetNumPackets() const { return (UInt32)fPackets.size(); }
+	const Packet&       GetPacket(UInt32 inIndex) const { return fPackets[inIndex]; }
+	const UInt8*        GetData(const Packet& inPacket) const { return (const UInt8*)fData.data() + inPacket.fOffset; }
+
+	// How long one pass takes; the next pass starts this much after the first
+	UInt32              GetDurationMSec() const { return fDurationMSec; }
+
+	// The RTP timestamp of each track's first packet
+	UInt32              GetFirstTimestamp(UInt32 inTrack) const { return inTrack < fFirstTimestamps.size() ? fFirstTimestamps[inTrack] : 0; }
+
+private:
+
+	void    AddPacket(UInt32 inTrack, UInt32 inTimeMSec, const UInt8* inData, UInt32 inLen);
+	void    AddNAL(UInt32 inTimeMSec, UInt32 inTimestamp, UInt16* ioSeq, const UInt8* inNAL, UInt32 inLen, bool inLastOfFrame);
+
+	std::string             fSDP;
+	std::vector<LoadTrack>  fTracks;
+	std::vector<Packet>     fPackets;
+	std::string             fData;
+	std::vector<UInt32>     fFirstTimestamps;
+	std::vector<bool>       fHaveTimestamp;
+	UInt32                  fDurationMSec;
+};
+
+#endif //__LOAD_MEDIA_H__
@@ -0,0 +1,747 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadSession.cpp
+
+	Contains:   Implementation of LoadSession, LoadPlayer and LoadPusher
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "LoadSession.h"
+#include "OS.h"
+#include "atomic.h"
+
+UInt32 LoadSession::sUDPPortBase = 20000;
+unsigned int LoadSession::sUDPPairs = 0;
+
+static UInt32 GetUInt32(const UInt8* inP) { return ((UInt32)inP[0] << 24) | ((UInt32)inP[1] << 16) | ((UInt32)inP[2] << 8) | inP[3]; }
+
+static void PutUInt32(UInt8* inP, UInt32 inValue)
+{
+	inP[0] = (UInt8)(inValue >> 24);
+	inP[1] = (UInt8)(inValue >> 16);
+	inP[2] = (UInt8)(inValue >> 8);
+	inP[3] = (UInt8)inValue;
+}
+
+static UInt32 NewSSRC(void* inSeed)
+{
+	UInt32 theSSRC = (UInt32)OS::Microseconds() ^ (UInt32)(PointerSizedInt)inSeed;
+	theSSRC ^= theSSRC >> 16;
+	return theSSRC * 0x45d9f3b;
+}
+
+LoadSession::LoadSession(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL)
+	: fReport(inReport),
+	fServerAddr(inServerAddr),
+	fURL(inURL),
+	fBaseURL(inURL),
+	fStartMicros(0),
+	fFailed(false),
+	fClosed(false),
+	fEstablished(false),
+	fSocket(this, Socket::kNonBlockingSocketType),
+	fServerPort(inServerPort),
+	fCSeq(0),
+	fOutSent(0),
+	fIn(new char[kInBufferSize]),
+	fInStart(0),
+	fInLen(0)
+{
+	this->SetTaskName("LoadSession");
+	fResponse.fStatus = 0;
+	(void)atomic_add(&fReport->fStarted, 1);
+}
+
+LoadSession::~LoadSession()
+{
+	delete[] fIn;
+}
+
+UInt16 LoadSession::GetUDPPortPair()
+{
+	UInt32 thePair = atomic_add(&sUDPPairs, 1) - 1;
+	return (UInt16)(sUDPPortBase + (thePair % ((65536 - sUDPPortBase) / 2)) * 2);
+}
+
+SInt64 LoadSession::Run()
+{
+	EventFlags theEvents = this->GetEvents();
+
+	if (theEvents & Task::kKillEvent)
+	{
+		if (!fClosed && !fSessionID.empty())
+		{
+			// Best effort, nobody waits for the reply
+			this->SendRequest("TEARDOWN", fURL.c_str());
+			this->Flush();
+		}
+		this->Finish();
+		(void)atomic_add(&fReport->fFinished, 1);
+		return -1;
+	}
+
+	if (theEvents & Task::kStartEvent)
+	{
+		fStartMicros = OS::Microseconds();
+		OS_Error theErr = fSocket.Open();
+		if (theErr == OS_NoErr)
+		{
+			fSocket.NoDelay();
+			theErr = fSocket.Connect(fServerAddr, fServerPort);
+		}
+		if (theErr != OS_NoErr && theErr != EINPROGRESS && theErr != EAGAIN)
+		{
+			fClosed = true;
+			this->Fail(LoadReport::kNoConnection);
+			return 0;
+		}
+		this->Begin();
+	}
+
+	if (!fClosed)
+	{
+		this->ReadSocket();
+		this->Flush();
+	}
+	return this->Tick();
+}
+
+void LoadSession::Fail(UInt32 inStatus)
+{
+	if (fFailed)
+		return;
+	fFailed = true;
+	fReport->AddError(inStatus);
+}
+
+void LoadSession::Closed()
+{
+	fClosed = true;
+	if (!fEstablished)
+		this->Fail(LoadReport::kNoConnection);
+}
+
+void LoadSession::SendRequest(const char* inMethod, const char* inURL, const char* inHeaders, const std::string& inBody)
+{
+	char theLine[64];
+	fOut += inMethod;
+	fOut += ' ';
+	fOut += inURL;
+	::snprintf(theLine, sizeof(theLine), " RTSP/1.0\r\nCSeq: %"   _U32BITARG_   "\r\n", ++fCSeq);
+	fOut += theLine;
+	fOut += "User-Agent: EasyLoadTool\r\n";
+	if (!fSessionID.empty())
+	{
+		fOut += "Session: ";
+		fOut += fSessionID;
+		fOut += "\r\n";
+	}
+	fOut += inHeaders;
+	if (!inBody.empty())
+	{
+		::snprintf(theLine, sizeof(theLine), "Content-Length: %u\r\n", (unsigned int)inBody.size());
+		fOut += theLine;
+	}
+	fOut += "\r\n";
+	fOut += inBody;
+
+	fPendingMethods.push_back(inMethod);
+}
+
+void LoadSession::SendInterleaved(UInt8 inChannel, const UInt8* inHeader, UInt32 inHeaderLen, const UInt8* inData, UInt32 inDataLen)
+{
+	UInt32 theLen = inHeaderLen + inDataLen;
+	char thePrefix[4] = { '$', (char)inChannel, (char)(theLen >> 8), (char)theLen };
+	fOut.append(thePrefix, sizeof(thePrefix));
+	fOut.append((const char*)inHeader, inHeaderLen);
+	if (inDataLen > 0)
+		fOut.append((const char*)inData, inDataLen);
+}
+
+void LoadSession::Flush()
+{
+	while (fOutSent < fOut.size())
+	{
+		UInt32 theSent = 0;
+		OS_Error theErr = fSocket.Send(fOut.data() + fOutSent, (UInt32)fOut.size() - fOutSent, &theSent);
+		if (theErr == EAGAIN)
+		{
+			fSocket.RequestEvent(EV_RE | EV_WR);
+
+			// Don't let what was sent pile up at the front of the buffer
+			if (fOutSent > kInBufferSize)
+			{
+				fOut.erase(0, fOutSent);
+				fOutSent = 0;
+			}
+			return;
+		}
+		if (theErr != OS_NoErr)
+		{
+			this->Closed();
+			return;
+		}
+		fOutSent += theSent;
+	}
+	fOut.clear();
+	fOutSent = 0;
+}
+
+void LoadSession::ReadSocket()
+{
+	for (UInt32 theReads = 0; theReads < kMaxReadsPerRun; theReads++)
+	{
+		if (fInStart > 0)
+		{
+			::memmove(fIn, fIn + fInStart, fInLen);
+			fInStart = 0;
+		}
+		if (fInLen == kInBufferSize)
+		{
+			// Nothing we understand is this long
+			fClosed = true;
+			this->Fail(LoadReport::kBadReply);
+			return;
+		}
+
+		UInt32 theLen = 0;
+		OS_Error theErr = fSocket.Read(fIn + fInLen, kInBufferSize - fInLen, &theLen);
+		if (theErr == EAGAIN)
+		{
+			fSocket.RequestEvent(EV_RE);
+			return;
+		}
+		if (theErr != OS_NoErr)
+		{
+			this->Closed();
+			return;
+		}
+		fInLen += theLen;
+
+		this->ParseInput();
+		if (fClosed)
+			return;
+	}
+
+	// There is more; let the other sessions have a turn first
+	this->Signal(Task::kReadEvent);
+}
+
+void LoadSession::ParseInput()
+{
+	while (fInLen > 0 && !fClosed)
+	{
+		char* theData = fIn + fInStart;
+		if (theData[0] == '$')
+		{
+			if (fInLen < 4)
+				break;
+			UInt32 thePacketLen = ((UInt32)(UInt8)theData[2] << 8) | (UInt8)theData[3];
+			if (fInLen < 4 + thePacketLen)
+				break;
+			fInStart += 4 + thePacketLen;
+			fInLen -= 4 + thePacketLen;
+			this->Interleaved((UInt8)theData[1], (UInt8*)theData + 4, thePacketLen);
+			continue;
+		}
+
+		// A response: headers up to a blank line, then Content-Length bytes of body
+		char* theEnd = (char*)::memmem(theData, fInLen, "\r\n\r\n", 4);
+		if (theEnd == NULL)
+			break;
+		UInt32 theHeaderLen = (UInt32)(theEnd - theData) + 4;
+		UInt32 theBodyLen = 0;
+		const char* theLine = theData;
+		while ((theLine = (const char*)::memchr(theLine, '\n', theEnd - theLine)) != NULL)
+		{
+			theLine++;
+			if (::strncasecmp(theLine, "Content-Length:", 15) == 0)
+				theBodyLen = (UInt32)::strtoul(theLine + 15, NULL, 10);
+		}
+		if (fInLen < theHeaderLen + theBodyLen)
+			break;
+
+		bool isResponse = this->ParseResponse(theData, theHeaderLen, theBodyLen);
+		fInStart += theHeaderLen + theBodyLen;
+		fInLen -= theHeaderLen + theBodyLen;
+		if (isResponse)
+			this->Response();
+	}
+
+	if (fInLen == 0)
+		fInStart = 0;
+}
+
+bool LoadSession::ParseResponse(const char* inData, UInt32 inHeaderLen, UInt32 inBodyLen)
+{
+	// The headers end with a blank line, so every line below ends with \r\n
+	std::string theHeaders(inData, inHeaderLen);
+	unsigned int theStatus = 0;
+	if (::sscanf(theHeaders.c_str(), "RTSP/1.0 %u", &theStatus) != 1)
+		return false;   // a request from the server, which we don't answer
+
+	fResponse.fStatus = theStatus;
+	fResponse.fMethod.clear();
+	fResponse.fTransport.clear();
+	fResponse.fContentBase.clear();
+	fResponse.fBody.assign(inData + inHeaderLen, inBodyLen);
+
+	std::string::size_type theLine = theHeaders.find("\r\n") + 2;
+	while (theLine < theHeaders.size())
+	{
+		std::string::size_type theEOL = theHeaders.find("\r\n", theLine);
+		std::string::size_type theColon = theHeaders.find(':', theLine);
+		if (theColon != std::string::npos && theColon < theEOL)
+		{
+			std::string theName = theHeaders.substr(theLine, theColon - theLine);
+			std::string::size_type theValueStart = theHeaders.find_first_not_of(' ', theColon + 1);
+			std::string theValue = theHeaders.substr(theValueStart, theEOL - theValueStart);
+
+			if (::strcasecmp(theName.c_str(), "CSeq") == 0)
+			{
+				UInt32 theCSeq = (UInt32)::strtoul(theValue.c_str(), NULL, 10);
+				if (theCSeq > 0 && theCSeq <= fPendingMethods.size())
+					fResponse.fMethod = fPendingMethods[theCSeq - 1];
+			}
+			else if (::strcasecmp(theName.c_str(), "Session") == 0)
+			{
+				if (fSessionID.empty())
+					fSessionID = theValue.substr(0, theValue.find(';'));
+			}
+			else if (::strcasecmp(theName.c_str(), "Transport") == 0)
+				fResponse.fTransport = theValue;
+			else if (::strcasecmp(theName.c_str(), "Content-Base") == 0)
+				fResponse.fContentBase = theValue;
+		}
+		theLine = theEOL + 2;
+	}
+	return true;
+}
+
+std::string LoadSession::GetTrackURL(const std::string& inControl)
+{
+	if (inControl.compare(0, 7, "rtsp://") == 0)
+		return inControl;
+	if (inControl.empty() || inControl == "*")
+		return fBaseURL;
+
+	std::string theURL(fBaseURL);
+	if (theURL[theURL.size() - 1] != '/')
+		theURL += '/';
+	return theURL + inControl;
+}
+
+LoadPlayer::LoadPlayer(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL, bool inTCP)
+	: LoadSession(inReport, inServerAddr, inServerPort, inURL),
+	fTCP(inTCP),
+	fNumTracks(0),
+	fTracksSetUp(0),
+	fPlaying(false),
+	fFirstPacketMicros(0),
+	fNextReportMSec(0),
+	fSSRC(NewSSRC(this)),
+	fUncountedPackets(0)
+{
+	this->SetTaskName("LoadPlayer");
+}
+
+LoadPlayer::~LoadPlayer()
+{
+	for (UInt32 x = 0; x < kMaxTracks; x++)
+	{
+		delete fTracks[x].fRTPSocket;
+		delete fTracks[x].fRTCPSocket;
+	}
+}
+
+void LoadPlayer::Begin()
+{
+	this->SendRequest("DESCRIBE", fURL.c_str(), "Accept: application/sdp\r\n");
+}
+
+void LoadPlayer::Response()
+{
+	if (fResponse.fStatus != 200)
+	{
+		this->Fail(fResponse.fStatus);
+		return;
+	}
+
+	if (fResponse.fMethod == "DESCRIBE")
+	{
+		std::vector<LoadTrack> theTracks;
+		if (!LoadMediaSource::ParseSDP(fResponse.fBody.data(), (UInt32)fResponse.fBody.size(), &theTracks))
+		{
+			this->Fail(LoadReport::kBadReply);
+			return;
+		}
+		if (!fResponse.fContentBase.empty())
+			fBaseURL = fResponse.fContentBase;
+
+		fNumTracks = theTracks.size() < kMaxTracks ? (UInt32)theTracks.size() : (UInt32)kMaxTracks;
+		for (UInt32 x = 0; x < fNumTracks; x++)
+		{
+			fTracks[x].fTrack = theTracks[x];
+			fTracks[x].fStats.SetClockRate(theTracks[x].fClockRate);
+		}
+		this->SetupNextTrack();
+	}
+	else if (fResponse.fMethod == "SETUP")
+	{
+		if (!fTCP)
+		{
+			// server_port=<rtp>-<rtcp>; receiver reports go to the second
+			unsigned int theRTPPort = 0, theRTCPPort = 0;
+			std::string::size_type thePorts = fResponse.fTransport.find("server_port=");
+			if (thePorts != std::string::npos)
+			{
+				int theCount = ::sscanf(fResponse.fTransport.c_str() + thePorts, "server_port=%u-%u", &theRTPPort, &theRTCPPort);
+				fTracks[fTracksSetUp].fServerRTCPPort = (UInt16)(theCount == 2 ? theRTCPPort : theRTPPort + 1);
+			}
+		}
+
+		if (++fTracksSetUp < fNumTracks)
+			this->SetupNextTrack();
+		else
+			this->SendRequest("PLAY", fURL.c_str(), "Range: npt=0.000-\r\n");
+	}
+	else if (fResponse.fMethod == "PLAY")
+	{
+		fPlaying = true;
+		fEstablished = true;
+		fNextReportMSec = OS::Milliseconds() + kReceiverReportIntervalMSec;
+		(void)atomic_add(&fReport->fPlaying, 1);
+	}
+}
+
+void LoadPlayer::SetupNextTrack()
+{
+	PlayerTrack& theTrack = fTracks[fTracksSetUp];
+	char theTransport[128];
+
+	if (fTCP)
+	{
+		::snprintf(theTransport, sizeof(theTransport), "Transport: RTP/AVP/TCP;unicast;interleaved=%"   _U32BITARG_   "-%"   _U32BITARG_   "\r\n",
+			fTracksSetUp * 2, fTracksSetUp * 2 + 1);
+	}
+	else
+	{
+		// An even port for RTP and the next one for RTCP
+		UInt16 thePort = 0;
+		for (UInt32 theTries = 0; theTries < 1000 && theTrack.fRTCPSocket == NULL; theTries++)
+		{
+			thePort = GetUDPPortPair();
+			theTrack.fRTPSocket = new UDPSocket(this, Socket::kNonBlockingSocketType);
+			theTrack.fRTCPSocket = new UDPSocket(NULL, Socket::kNonBlockingSocketType);
+			if (theTrack.fRTPSocket->Open() != OS_NoErr || theTrack.fRTCPSocket->Open() != OS_NoErr)
+				theTries = 1000;    // out of descriptors, trying other ports won't help
+			else if (theTrack.fRTPSocket->Bind(INADDR_ANY, thePort) == OS_NoErr
+				&& theTrack.fRTCPSocket->Bind(INADDR_ANY, thePort + 1) == OS_NoErr)
+				break;
+
+			delete theTrack.fRTPSocket;
+			delete theTrack.fRTCPSocket;
+			theTrack.fRTPSocket = theTrack.fRTCPSocket = NULL;
+		}
+		if (theTrack.fRTPSocket == NULL)
+		{
+			this->Fail(LoadReport::kNoConnection);
+			return;
+		}
+
+		(void)theTrack.fRTPSocket->SetSocketRcvBufSize(256 * 1024);
+		theTrack.fRTPSocket->RequestEvent(EV_RE);
+		::snprintf(theTransport, sizeof(theTransport), "Transport: RTP/AVP;unicast;client_port=%u-%u\r\n", thePort, thePort + 1);
+	}
+
+	this->SendRequest("SETUP", this->GetTrackURL(theTrack.fTrack.fControl).c_str(), theTransport);
+}
+
+void LoadPlayer::Interleaved(UInt8 inChannel, UInt8* inData, UInt32 inLen)
+{
+	// Even channels carry RTP; the server's RTCP on the odd ones is ignored
+	UInt32 theTrack = inChannel / 2;
+	if ((inChannel & 1) == 0 && theTrack < fNumTracks)
+		this->RTPPacket(theTrack, inData, inLen);
+}
+
+void LoadPlayer::RTPPacket(UInt32 inTrack, UInt8* inData, UInt32 inLen)
+{
+	SInt64 theNow = OS::Microseconds();
+	if (fFirstPacketMicros == 0)
+		fFirstPacketMicros = theNow;
+	if (inLen >= 12)
+		fTracks[inTrack].fSSRC = GetUInt32(inData + 8);
+	fTracks[inTrack].fStats.Packet(inData, inLen, theNow);
+
+	if (++fUncountedPackets == kPacketCountBatch)
+	{
+		(void)atomic_add(&fReport->fPacketsReceived, fUncountedPackets);
+		fUncountedPackets = 0;
+	}
+}
+
+SInt64 LoadPlayer::Tick()
+{
+	if (!fTCP)
+	{
+		enum { kBatch = 16, kMaxPacketSize = 2048 };
+		static __thread UInt8 sBuffers[kBatch][kMaxPacketSize];
+		UDPRecvPacket thePackets[kBatch];
+		for (UInt32 x = 0; x < kBatch; x++)
+		{
+			thePackets[x].fBuffer = sBuffers[x];
+			thePackets[x].fBufferLen = kMaxPacketSize;
+		}
+
+		for (UInt32 theTrack = 0; theTrack < fNumTracks; theTrack++)
+		{
+			UDPSocket* theSocket = fTracks[theTrack].fRTPSocket;
+			if (theSocket == NULL)
+				continue;
+
+			UInt32 theNumPackets = kBatch;
+			while (theNumPackets == kBatch)
+			{
+				if (theSocket->RecvBatch(thePackets, kBatch, &theNumPackets) != OS_NoErr)
+					break;
+				for (UInt32 x = 0; x < theNumPackets; x++)
+					this->RTPPacket(theTrack, (UInt8*)thePackets[x].fBuffer, thePackets[x].fLength);
+			}
+			theSocket->RequestEvent(EV_RE);
+		}
+	}
+
+	if (fPlaying && !fClosed && OS::Milliseconds() >= fNextReportMSec)
+	{
+		this->SendReceiverReports();
+		fNextReportMSec += kReceiverReportIntervalMSec;
+	}
+	return 0;
+}
+
+void LoadPlayer::SendReceiverReports()
+{
+	for (UInt32 x = 0; x < fNumTracks; x++)
+	{
+		PlayerTrack& theTrack = fTracks[x];
+		RTPStreamStats& theStats = theTrack.fStats;
+		if (theStats.GetReceived() == 0)
+			continue;
+
+		// Fraction lost since the last report, as RFC 3550 appendix A.3 has it
+		UInt32 theExpected = theStats.GetExpected();
+		UInt32 theExpectedInterval = theExpected - theTrack.fExpectedPrior;
+		UInt32 theReceivedInterval = theStats.GetReceived() - theTrack.fReceivedPrior;
+		theTrack.fExpectedPrior = theExpected;
+		theTrack.fReceivedPrior = theStats.GetReceived();
+		UInt32 theFraction = 0;
+		if (theExpectedInterval > theReceivedInterval)
+			theFraction = ((theExpectedInterval - theReceivedInterval) << 8) / theExpectedInterval;
+
+		// One report block; LSR and DLSR stay zero since sender reports aren't tracked
+		UInt8 theReport[32];
+		::memset(theReport, 0, sizeof(theReport));
+		theReport[0] = 0x81;
+		theReport[1] = 201;
+		theReport[3] = 7;
+		PutUInt32(&theReport[4], fSSRC);
+		PutUInt32(&theReport[8], theTrack.fSSRC);
+		PutUInt32(&theReport[12], (theFraction << 24) | (theStats.GetLost() & 0xFFFFFF));
+		PutUInt32(&theReport[16], theStats.GetExtendedMaxSeq());
+		PutUInt32(&theReport[20], theStats.GetJitter());
+
+		if (fTCP)
+			this->SendInterleaved((UInt8)(x * 2 + 1), theReport, sizeof(theReport), NULL, 0);
+		else if (theTrack.fRTCPSocket != NULL && theTrack.fServerRTCPPort != 0)
+			(void)theTrack.fRTCPSocket->SendTo(fServerAddr, theTrack.fServerRTCPPort, theReport, sizeof(theReport));
+	}
+
+	if (fTCP)
+		this->Flush();
+}
+
+void LoadPlayer::Finish()
+{
+	if (fPlaying)
+		(void)atomic_sub(&fReport->fPlaying, 1);
+	(void)atomic_add(&fReport->fPacketsReceived, fUncountedPackets);
+
+	RTPStreamStats theStats[kMaxTracks];
+	for (UInt32 x = 0; x < fNumTracks; x++)
+		theStats[x] = fTracks[x].fStats;
+
+	SInt64 theTimeToFirstPacket = (fFirstPacketMicros != 0) ? fFirstPacketMicros - fStartMicros : -1;
+	fReport->AddPlayer(theTimeToFirstPacket, theStats, fNumTracks);
+}
+
+LoadPusher::LoadPusher(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL, const LoadMediaSource* inSource)
+	: LoadSession(inReport, inServerAddr, inServerPort, inURL),
+	fSource(inSource),
+	fTracksSetUp(0),
+	fRecording(false),
+	fRecordStartMSec(0),
+	fNextPacket(0),
+	fLoop(0),
+	fSSRC(NewSSRC(this)),
+	fSeq(inSource->GetNumTracks(), 0),
+	fPacketsSent(inSource->GetNumTracks(), 0),
+	fOctetsSent(inSource->GetNumTracks(), 0),
+	fLastTimestamp(inSource->GetNumTracks(), 0),
+	fNextReportMSec(0)
+{
+	this->SetTaskName("LoadPusher");
+
+	// Start each stream at its own sequence number like a real sender
+	for (UInt32 x = 0; x < fSeq.size(); x++)
+		fSeq[x] = (UInt16)(fSSRC >> (x * 4));
+}
+
+void LoadPusher::Begin()
+{
+	this->SendRequest("ANNOUNCE", fURL.c_str(), "Content-Type: application/sdp\r\n", fSource->GetSDP());
+}
+
+void LoadPusher::Response()
+{
+	if (fResponse.fStatus != 200)
+	{
+		this->Fail(fResponse.fStatus);
+		return;
+	}
+
+	if (fResponse.fMethod == "ANNOUNCE" || fResponse.fMethod == "SETUP")
+	{
+		if (fResponse.fMethod == "SETUP")
+			fTracksSetUp++;
+
+		if (fTracksSetUp < fSource->GetNumTracks())
+		{
+			char theTransport[128];
+			::snprintf(theTransport, sizeof(theTransport), "Transport: RTP/AVP/TCP;unicast;mode=record;interleaved=%"   _U32BITARG_   "-%"   _U32BITARG_   "\r\n",
+				fTracksSetUp * 2, fTracksSetUp * 2 + 1);
+			this->SendRequest("SETUP", this->GetTrackURL(fSource->GetTrack(fTracksSetUp).fControl).c_str(), theTransport);
+		}
+		else
+			this->SendRequest("RECORD", fURL.c_str(), "Range: npt=0.000-\r\n");
+	}
+	else if (fResponse.fMethod == "RECORD")
+	{
+		fRecording = true;
+		fEstablished = true;
+		fRecordStartMSec = OS::Milliseconds();
+		fNextReportMSec = fRecordStartMSec + kSenderReportIntervalMSec;
+		(void)atomic_add(&fReport->fPushing, 1);
+	}
+}
+
+void LoadPusher::SendPacket(const LoadMediaSource::Packet& inPacket)
+{
+	UInt32 theTrack = inPacket.fTrack;
+	const UInt8* theData = fSource->GetData(inPacket);
+	const LoadTrack& theSourceTrack = fSource->GetTrack(theTrack);
+
+	// Every pass through the source moves the timestamps on by its duration
+	UInt32 theTimestamp = GetUInt32(theData + 4) - fSource->GetFirstTimestamp(theTrack)
+		+ (UInt32)(((UInt64)fLoop * fSource->GetDurationMSec() * theSourceTrack.fClockRate) / 1000) + fSSRC;
+	UInt16 theSeq = fSeq[theTrack]++;
+
+	// Past this much the server isn't reading; drop the packet like a full network would
+	if (this->GetQueuedLength() > kMaxQueuedBytes)
+	{
+		(void)atomic_add(&fReport->fPacketsDropped, 1);
+		return;
+	}
+
+	UInt8 theHeader[12];
+	::memcpy(theHeader, theData, sizeof(theHeader));
+	theHeader[2] = (UInt8)(theSeq >> 8);
+	theHeader[3] = (UInt8)theSeq;
+	PutUInt32(&theHeader[4], theTimestamp);
+	PutUInt32(&theHeader[8], fSSRC + theTrack);
+	this->SendInterleaved((UInt8)(theTrack * 2), theHeader, sizeof(theHeader), theData + sizeof(theHeader), inPacket.fLen - sizeof(theHeader));
+
+	fPacketsSent[theTrack]++;
+	fOctetsSent[theTrack] += inPacket.fLen - sizeof(theHeader);
+	fLastTimestamp[theTrack] = theTimestamp;
+	(void)atomic_add(&fReport->fPacketsSent, 1);
+}
+
+void LoadPusher::SendSenderReports(SInt64 inNowMSec)
+{
+	SInt64 theNTPTime = OS::TimeMilli_To_1900Fixed64Secs(inNowMSec);
+	for (UInt32 x = 0; x < fSeq.size(); x++)
+	{
+		if (fPacketsSent[x] == 0)
+			continue;
+
+		// The RTP timestamp is that of the last packet sent, which is close enough for a load test
+		UInt8 theReport[28];
+		theReport[0] = 0x80;
+		theReport[1] = 200;
+		theReport[2] = 0;
+		theReport[3] = 6;
+		PutUInt32(&theReport[4], fSSRC + x);
+		PutUInt32(&theReport[8], (UInt32)((UInt64)theNTPTime >> 32));
+		PutUInt32(&theReport[12], (UInt32)theNTPTime);
+		PutUInt32(&theReport[16], fLastTimestamp[x]);
+		PutUInt32(&theReport[20], fPacketsSent[x]);
+		PutUInt32(&theReport[24], fOctetsSent[x]);
+		this->SendInterleaved((UInt8)(x * 2 + 1), theReport, sizeof(theReport), NULL, 0);
+	}
+}
+
+SInt64 LoadPusher::Tick()
+{
+	// Until RECORD is answered the session waits on its socket
+	if (!fRecording || fClosed)
+		return 0;
+
+	SInt64 theNow = OS::Milliseconds();
+	SInt64 theElapsed = theNow - fRecordStartMSec;
+	SInt64 theDuration = fSource->GetDurationMSec();
+	SInt64 theDue = 0;
+	for (;;)
+	{
+		const LoadMediaSource::Packet& thePacket = fSource->GetPacket(fNextPacket);
+		theDue = fLoop * theDuration + thePacket.fTimeMSec;
+		if (theDue > theElapsed)
+			break;
+
+		this->SendPacket(thePacket);
+		if (++fNextPacket == fSource->GetNumPackets())
+		{
+			fNextPacket = 0;
+			fLoop++;
+		}
+	}
+
+	if (theNow >= fNextReportMSec)
+	{
+		this->SendSenderReports(theNow);
+		fNextReportMSec += kSenderReportIntervalMSec;
+	}
+	this->Flush();
+
+	// Come back when the next packet is due; socket events in between wait for it
+	SInt64 theWait = theDue - theElapsed;
+	return theWait > 0 ? theWait : 1;
+}
+
+void LoadPusher::Finish()
+{
+	if (fRecording)
+		(void)atomic_sub(&fReport->fPushing, 1);
+	else
+		fReport->AddFailed();
+}
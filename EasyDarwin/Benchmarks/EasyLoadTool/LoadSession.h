@@ -0,0 +1,222 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadSession.h
+
+	Contains:   The RTSP clients EasyLoadTool runs thousands of.
+
+				LoadSession is one RTSP connection as a Task: a non-blocking
+				TCPSocket, requests queued on an output buffer, and responses and
+				interleaved packets pulled out of what comes back. The task wakes on
+				socket events, so an idle session costs nothing.
+
+				LoadPlayer plays a URL: DESCRIBE, SETUP of every track over UDP or
+				interleaved TCP, then PLAY, and it measures every RTP packet it gets.
+				It sends receiver reports every few seconds like a real player.
+
+				LoadPusher publishes a LoadMediaSource: ANNOUNCE, SETUP with
+				mode=record over interleaved TCP, RECORD, and then it sends each
+				packet when it is due, looping the source with fresh sequence
+				numbers and timestamps. While recording it runs off the task timer.
+
+				Stop() tears a session down; the task then reports to the
+				LoadReport and deletes itself, so the caller must drop its pointer.
+*/
+
+#ifndef __LOAD_SESSION_H__
+#define __LOAD_SESSION_H__
+
+#include <string>
+#include <vector>
+
+#include "Task.h"
+#include "TCPSocket.h"
+#include "UDPSocket.h"
+#include "LoadMedia.h"
+#include "LoadStats.h"
+
+class LoadSession : public Task
+{
+public:
+
+	LoadSession(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL);
+	virtual ~LoadSession();
+
+	void    Start() { this->Signal(Task::kStartEvent); }
+	void    Stop() { this->Signal(Task::kKillEvent); }
+
+	// Players take UDP port pairs from here up, wrapping around at the top
+	static void SetUDPPortBase(UInt16 inPort) { sUDPPortBase = inPort & ~1; }
+
+protected:
+
+	virtual SInt64  Run();
+
+	// Sends the first request once the connect is under way
+	virtual void    Begin() = 0;
+	// fResponse holds the response to the last request
+	virtual void    Response() = 0;
+	virtual void    Interleaved(UInt8 /*inChannel*/, UInt8* /*inData*/, UInt32 /*inLen*/) {}
+	// Called at the end of every Run; the return value is Run's
+	virtual SInt64  Tick() { return 0; }
+	// The session is going away; report what it measured
+	virtual void    Finish() = 0;
+
+	void    SendRequest(const char* inMethod, const char* inURL, const char* inHeaders = "", const std::string& inBody = std::string());
+	void    SendInterleaved(UInt8 inChannel, const UInt8* inHeader, UInt32 inHeaderLen, const UInt8* inData, UInt32 inDataLen);
+	void    Fail(UInt32 inStatus);
+	void    Closed();
+	void    Flush();
+
+	// Bytes queued but not yet taken by the socket
+	UInt32  GetQueuedLength() { return (UInt32)fOut.size() - fOutSent; }
+
+	// A track's control URL relative to fBaseURL
+	std::string     GetTrackURL(const std::string& inControl);
+
+	struct RTSPResponse
+	{
+		UInt32      fStatus;
+		std::string fMethod;        // of the request it answers
+		std::string fTransport;
+		std::string fContentBase;
+		std::string fBody;
+	};
+
+	LoadReport*     fReport;
+	UInt32          fServerAddr;
+	std::string     fURL;
+	std::string     fBaseURL;
+	std::string     fSessionID;
+	RTSPResponse    fResponse;
+	SInt64          fStartMicros;
+	bool            fFailed;
+	bool            fClosed;
+	bool            fEstablished;   // playing or recording
+
+	static UInt16   GetUDPPortPair();
+
+private:
+
+	void    ReadSocket();
+	void    ParseInput();
+	bool    ParseResponse(const char* inData, UInt32 inHeaderLen, UInt32 inBodyLen);
+
+	enum
+	{
+		kInBufferSize = 65536 + 4,      // big enough for any interleaved packet
+		kMaxReadsPerRun = 32
+	};
+
+	TCPSocket       fSocket;
+	UInt16          fServerPort;
+	UInt32          fCSeq;
+	std::vector<std::string> fPendingMethods;   // indexed by CSeq - 1
+	std::string     fOut;
+	UInt32          fOutSent;
+	char*           fIn;
+	UInt32          fInStart;
+	UInt32          fInLen;
+
+	static UInt32       sUDPPortBase;
+	static unsigned int sUDPPairs;
+};
+
+class LoadPlayer : public LoadSession
+{
+public:
+
+	LoadPlayer(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL, bool inTCP);
+	virtual ~LoadPlayer();
+
+protected:
+
+	virtual void    Begin();
+	virtual void    Response();
+	virtual void    Interleaved(UInt8 inChannel, UInt8* inData, UInt32 inLen);
+	virtual SInt64  Tick();
+	virtual void    Finish();
+
+private:
+
+	void    SetupNextTrack();
+	void    RTPPacket(UInt32 inTrack, UInt8* inData, UInt32 inLen);
+	void    SendReceiverReports();
+
+	enum
+	{
+		kMaxTracks = 4,
+		kReceiverReportIntervalMSec = 5000,
+		kPacketCountBatch = 64
+	};
+
+	struct PlayerTrack
+	{
+		PlayerTrack() : fRTPSocket(NULL), fRTCPSocket(NULL), fServerRTCPPort(0), fSSRC(0), fExpectedPrior(0), fReceivedPrior(0) {}
+
+		LoadTrack       fTrack;
+		UDPSocket*      fRTPSocket;
+		UDPSocket*      fRTCPSocket;
+		UInt16          fServerRTCPPort;
+		UInt32          fSSRC;      // of the server's stream, from its packets
+		UInt32          fExpectedPrior;
+		UInt32          fReceivedPrior;
+		RTPStreamStats  fStats;
+	};
+
+	bool            fTCP;
+	UInt32          fNumTracks;
+	UInt32          fTracksSetUp;
+	PlayerTrack     fTracks[kMaxTracks];
+	bool            fPlaying;
+	SInt64          fFirstPacketMicros;
+	SInt64          fNextReportMSec;
+	UInt32          fSSRC;
+	UInt32          fUncountedPackets;
+};
+
+class LoadPusher : public LoadSession
+{
+public:
+
+	LoadPusher(LoadReport* inReport, UInt32 inServerAddr, UInt16 inServerPort, const std::string& inURL, const LoadMediaSource* inSource);
+	virtual ~LoadPusher() {}
+
+protected:
+
+	virtual void    Begin();
+	virtual void    Response();
+	virtual SInt64  Tick();
+	virtual void    Finish();
+
+private:
+
+	void    SendPacket(const LoadMediaSource::Packet& inPacket);
+	void    SendSenderReports(SInt64 inNowMSec);
+
+	enum
+	{
+		kMaxQueuedBytes = 512 * 1024,   // past this the server isn't keeping up and packets are dropped
+		kSenderReportIntervalMSec = 5000
+	};
+
+	const LoadMediaSource*  fSource;
+	UInt32                  fTracksSetUp;
+	bool                    fRecording;
+	SInt64                  fRecordStartMSec;
+	UInt32                  fNextPacket;
+	UInt32                  fLoop;
+	UInt32                  fSSRC;
+	std::vector<UInt16>     fSeq;
+	std::vector<UInt32>     fPacketsSent;
+	std::vector<UInt32>     fOctetsSent;
+	std::vector<UInt32>     fLastTimestamp;
+	SInt64                  fNextReportMSec;
+};
+
+#endif //__LOAD_SESSION_H__
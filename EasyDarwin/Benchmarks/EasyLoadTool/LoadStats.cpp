@@ -0,0 +1,324 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadStats.cpp
+
+	Contains:   Implementation of LoadHistogram, RTPStreamStats and LoadReport
+*/
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "LoadStats.h"
+
+static const char* sHistogramNames[LoadReport::kNumHistograms] =
+{
+	"ttfp_us",
+	"jitter_us",
+	"loss_ppm",
+	"reorder",
+	"server_cpu_us_per_stream"
+};
+
+void LoadHistogram::Reset()
+{
+	::memset(fBuckets, 0, sizeof(fBuckets));
+	fCount = fSum = fMax = 0;
+	fMin = ~(UInt64)0;
+}
+
+UInt32 LoadHistogram::BucketOf(UInt64 inValue)
+{
+	if (inValue < kSubBuckets)
+		return (UInt32)inValue;
+
+	// The top kSubBits bits below the leading one pick the bucket within its power of two
+	UInt32 theShift = 63 - __builtin_clzll(inValue) - kSubBits;
+	return (theShift + 1) * kSubBuckets + (UInt32)((inValue >> theShift) & (kSubBuckets - 1));
+}
+
+UInt64 LoadHistogram::BucketTop(UInt32 inBucket)
+{
+	if (inBucket < kSubBuckets)
+		return inBucket;
+
+	UInt32 theShift = inBucket / kSubBuckets - 1;
+	UInt64 theBottom = (UInt64)(kSubBuckets + inBucket % kSubBuckets) << theShift;
+	return theBottom + ((UInt64)1 << theShift) - 1;
+}
+
+void LoadHistogram::Add(UInt64 inValue)
+{
+	fBuckets[BucketOf(inValue)]++;
+	fCount++;
+	fSum += inValue;
+	if (inValue < fMin)
+		fMin = inValue;
+	if (inValue > fMax)
+		fMax = inValue;
+}
+
+void LoadHistogram::Merge(const LoadHistogram& inOther)
+{
+	for (UInt32 x = 0; x < kNumBuckets; x++)
+		fBuckets[x] += inOther.fBuckets[x];
+	fCount += inOther.fCount;
+	fSum += inOther.fSum;
+	if (inOther.fMin < fMin)
+		fMin = inOther.fMin;
+	if (inOther.fMax > fMax)
+		fMax = inOther.fMax;
+}
+
+UInt64 LoadHistogram::GetPercentile(Float64 inPercent) const
+{
+	if (fCount == 0)
+		return 0;
+
+	UInt64 theRank = (UInt64)((inPercent / 100.0) * (Float64)fCount + 0.5);
+	if (theRank == 0)
+		theRank = 1;
+
+	UInt64 theSeen = 0;
+	for (UInt32 x = 0; x < kNumBuckets; x++)
+	{
+		theSeen += fBuckets[x];
+		if (theSeen >= theRank)
+			return BucketTop(x) < fMax ? BucketTop(x) : fMax;
+	}
+	return fMax;
+}
+
+bool LoadHistogram::GetStat(const char* inName, Float64* outValue) const
+{
+	if (::strcmp(inName, "count") == 0)		*outValue = (Float64)fCount;
+	else if (::strcmp(inName, "min") == 0)	*outValue = (Float64)this->GetMin();
+	else if (::strcmp(inName, "mean") == 0)	*outValue = this->GetMean();
+	else if (::strcmp(inName, "max") == 0)	*outValue = (Float64)fMax;
+	else if (::strcmp(inName, "p50") == 0)	*outValue = (Float64)this->GetPercentile(50);
+	else if (::strcmp(inName, "p90") == 0)	*outValue = (Float64)this->GetPercentile(90);
+	else if (::strcmp(inName, "p99") == 0)	*outValue = (Float64)this->GetPercentile(99);
+	else if (::strcmp(inName, "p999") == 0)	*outValue = (Float64)this->GetPercentile(99.9);
+	else
+		return false;
+	return true;
+}
+
+void LoadHistogram::WriteJSON(FILE* inFile) const
+{
+	::fprintf(inFile, "{\"count\": %llu, \"min\": %llu, \"mean\": %.1f, \"p50\": %llu, \"p90\": %llu, \"p99\": %llu, \"p999\": %llu, \"max\": %llu, \"buckets\": [",
+		(unsigned long long)fCount, (unsigned long long)this->GetMin(), this->GetMean(),
+		(unsigned long long)this->GetPercentile(50), (unsigned long long)this->GetPercentile(90),
+		(unsigned long long)this->GetPercentile(99), (unsigned long long)this->GetPercentile(99.9),
+		(unsigned long long)fMax);
+
+	// Only the buckets in use, as [upper bound, count]
+	bool isFirst = true;
+	for (UInt32 x = 0; x < kNumBuckets; x++)
+	{
+		if (fBuckets[x] == 0)
+			continue;
+		::fprintf(inFile, "%s[%llu, %llu]", isFirst ? "" : ", ", (unsigned long long)BucketTop(x), (unsigned long long)fBuckets[x]);
+		isFirst = false;
+	}
+	::fprintf(inFile, "]}");
+}
+
+void RTPStreamStats::Packet(const UInt8* inPacket, UInt32 inLen, SInt64 inArrivalMicros)
+{
+	if (inLen < 12 || (inPacket[0] & 0xC0) != 0x80)
+		return;
+
+	UInt32 theSeq = ((UInt32)inPacket[2] << 8) | inPacket[3];
+	UInt32 theTimestamp = ((UInt32)inPacket[4] << 24) | ((UInt32)inPacket[5] << 16) | ((UInt32)inPacket[6] << 8) | inPacket[7];
+
+	if (fReceived == 0)
+	{
+		fBaseSeq = fMaxSeq = theSeq;
+	}
+	else
+	{
+		UInt16 theDelta = (UInt16)(theSeq - fMaxSeq);
+		if (theDelta == 0)
+			return; // a duplicate
+		if (theDelta < 0x8000)
+		{
+			if (theSeq < fMaxSeq)
+				fCycles += 0x10000;
+			fMaxSeq = theSeq;
+		}
+		else
+			fReordered++;
+	}
+
+	fReceived++;
+	fBytes += inLen;
+
+	// Arrival time in timestamp units; only differences of the transit time matter
+	SInt64 theArrival = (inArrivalMicros * (SInt64)fClockRate) / 1000000;
+	SInt64 theTransit = (SInt64)(UInt32)(theArrival - (SInt64)theTimestamp);
+	if (fReceived > 1)
+	{
+		SInt64 theDiff = (SInt64)(SInt32)(UInt32)(theTransit - fTransit);
+		if (theDiff < 0)
+			theDiff = -theDiff;
+		fJitter += ((Float64)theDiff - fJitter) / 16.0;
+	}
+	fTransit = theTransit;
+}
+
+UInt32 RTPStreamStats::GetLost() const
+{
+	UInt32 theExpected = this->GetExpected();
+	return theExpected > fReceived ? theExpected - fReceived : 0;
+}
+
+UInt32 RTPStreamStats::GetJitterMicros() const
+{
+	return (UInt32)((fJitter * 1000000.0) / (Float64)fClockRate);
+}
+
+LoadReport::LoadReport()
+	: fStarted(0), fPlaying(0), fPushing(0), fFinished(0), fFailed(0),
+	fPacketsReceived(0), fPacketsSent(0), fPacketsDropped(0),
+	fStreams(0), fStreamPackets(0), fStreamBytes(0)
+{
+}
+
+const char* LoadReport::GetHistogramName(UInt32 inIndex)
+{
+	return inIndex < kNumHistograms ? sHistogramNames[inIndex] : "";
+}
+
+void LoadReport::AddPlayer(SInt64 inTimeToFirstPacketMicros, RTPStreamStats* inStreams, UInt32 inNumStreams)
+{
+	OSMutexLocker locker(&fMutex);
+
+	if (inTimeToFirstPacketMicros < 0)
+	{
+		fFailed++;
+		return;
+	}
+
+	fHistograms[kTimeToFirstPacket].Add((UInt64)inTimeToFirstPacketMicros);
+	for (UInt32 x = 0; x < inNumStreams; x++)
+	{
+		RTPStreamStats& theStream = inStreams[x];
+		if (theStream.GetReceived() == 0)
+			continue;
+
+		fStreams++;
+		fStreamPackets += theStream.GetReceived();
+		fStreamBytes += theStream.GetBytes();
+		fHistograms[kJitter].Add(theStream.GetJitterMicros());
+		fHistograms[kLoss].Add(((UInt64)theStream.GetLost() * 1000000) / theStream.GetExpected());
+		fHistograms[kReorder].Add(theStream.GetReordered());
+	}
+}
+
+void LoadReport::AddFailed()
+{
+	OSMutexLocker locker(&fMutex);
+	fFailed++;
+}
+
+void LoadReport::AddServerCPUSample(UInt64 inMicrosPerStream)
+{
+	OSMutexLocker locker(&fMutex);
+	fHistograms[kServerCPU].Add(inMicrosPerStream);
+}
+
+void LoadReport::AddError(UInt32 inRTSPStatus)
+{
+	OSMutexLocker locker(&fMutex);
+	fErrors[inRTSPStatus]++;
+}
+
+void LoadReport::AddTimelineSample(UInt32 inSecond, UInt32 inPlaying, UInt32 inPushing, Float64 inServerCPUPercent, UInt64 inPackets)
+{
+	TimelineSample theSample = { inSecond, inPlaying, inPushing, inServerCPUPercent, inPackets };
+
+	OSMutexLocker locker(&fMutex);
+	fTimeline.push_back(theSample);
+}
+
+bool LoadReport::GetValue(const char* inName, Float64* outValue)
+{
+	OSMutexLocker locker(&fMutex);
+
+	if (::strcmp(inName, "started") == 0)		*outValue = fStarted;
+	else if (::strcmp(inName, "failed") == 0)	*outValue = fFailed;
+	else if (::strcmp(inName, "streams") == 0)	*outValue = fStreams;
+	else if (::strcmp(inName, "dropped") == 0)	*outValue = fPacketsDropped;
+	else
+	{
+		const char* theDot = ::strchr(inName, '.');
+		if (theDot == NULL)
+			return false;
+
+		for (UInt32 x = 0; x < kNumHistograms; x++)
+		{
+			if (::strncmp(inName, sHistogramNames[x], theDot - inName) == 0 && sHistogramNames[x][theDot - inName] == '\0')
+				return fHistograms[x].GetStat(theDot + 1, outValue);
+		}
+		return false;
+	}
+	return true;
+}
+
+void LoadReport::WriteJSON(FILE* inFile, const char* inScenario, const char* inParams, Float64 inClientCPUPercent)
+{
+	OSMutexLocker locker(&fMutex);
+
+	::fprintf(inFile, "{\n  \"scenario\": \"%s\",\n  \"params\": {%s},\n", inScenario, inParams);
+	::fprintf(inFile, "  \"sessions\": {\"started\": %u, \"finished\": %u, \"failed\": %u},\n", fStarted, fFinished, fFailed);
+	::fprintf(inFile, "  \"streams\": %"   _U32BITARG_   ", \"packets\": %llu, \"bytes\": %llu, \"packets_sent\": %u, \"packets_dropped\": %u,\n",
+		fStreams, (unsigned long long)fStreamPackets, (unsigned long long)fStreamBytes, fPacketsSent, fPacketsDropped);
+	::fprintf(inFile, "  \"client_cpu_pct\": %.1f,\n", inClientCPUPercent);
+
+	::fprintf(inFile, "  \"errors\": {");
+	for (std::map<UInt32, UInt32>::iterator theIter = fErrors.begin(); theIter != fErrors.end(); ++theIter)
+		::fprintf(inFile, "%s\"%"   _U32BITARG_   "\": %"   _U32BITARG_   "", theIter == fErrors.begin() ? "" : ", ", theIter->first, theIter->second);
+	::fprintf(inFile, "},\n");
+
+	for (UInt32 x = 0; x < kNumHistograms; x++)
+	{
+		::fprintf(inFile, "  \"%s\": ", sHistogramNames[x]);
+		fHistograms[x].WriteJSON(inFile);
+		::fprintf(inFile, ",\n");
+	}
+
+	::fprintf(inFile, "  \"timeline\": [");
+	for (UInt32 x = 0; x < fTimeline.size(); x++)
+	{
+		TimelineSample& theSample = fTimeline[x];
+		::fprintf(inFile, "%s\n    {\"t\": %"   _U32BITARG_   ", \"playing\": %"   _U32BITARG_   ", \"pushing\": %"   _U32BITARG_   ", \"server_cpu_pct\": %.1f, \"packets\": %llu}",
+			x == 0 ? "" : ",", theSample.fSecond, theSample.fPlaying, theSample.fPushing, theSample.fServerCPUPercent, (unsigned long long)theSample.fPackets);
+	}
+	::fprintf(inFile, "\n  ]\n}\n");
+}
+
+void LoadReport::PrintSummary(FILE* inFile)
+{
+	OSMutexLocker locker(&fMutex);
+
+	::fprintf(inFile, "sessions %u started, %u failed; %"   _U32BITARG_   " streams, %llu packets, %u dropped by pushers\n",
+		fStarted, fFailed, fStreams, (unsigned long long)fStreamPackets, fPacketsDropped);
+	for (std::map<UInt32, UInt32>::iterator theIter = fErrors.begin(); theIter != fErrors.end(); ++theIter)
+		::fprintf(inFile, "  %"   _U32BITARG_   " sessions got %"   _U32BITARG_   "%s\n", theIter->second, theIter->first, theIter->first == kNoConnection ? " (no connection)" : theIter->first == kBadReply ? " (bad reply)" : "");
+
+	::fprintf(inFile, "%-26s %10s %10s %10s %10s %10s %10s\n", "", "count", "mean", "p50", "p99", "p999", "max");
+	for (UInt32 x = 0; x < kNumHistograms; x++)
+	{
+		LoadHistogram& theHistogram = fHistograms[x];
+		::fprintf(inFile, "%-26s %10llu %10.1f %10llu %10llu %10llu %10llu\n", sHistogramNames[x],
+			(unsigned long long)theHistogram.GetCount(), theHistogram.GetMean(),
+			(unsigned long long)theHistogram.GetPercentile(50), (unsigned long long)theHistogram.GetPercentile(99),
+			(unsigned long long)theHistogram.GetPercentile(99.9), (unsigned long long)theHistogram.GetMax());
+	}
+}
@@ -0,0 +1,185 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       LoadStats.h
+
+	Contains:   What EasyLoadTool measures.
+
+				LoadHistogram is a log-linear histogram: 16 buckets for every power
+				of two, so a percentile is never off by more than 1/16 of its value
+				and the whole thing is a fixed array that merges by adding.
+
+				RTPStreamStats follows one received RTP stream the way RFC 3550
+				appendix A does: extended sequence numbers for loss, the
+				interarrival jitter estimate, and a count of packets that came in
+				behind one with a higher sequence number.
+
+				LoadReport collects every finished stream under a mutex, keeps the
+				counters the scenario driver polls, and writes it all as JSON.
+*/
+
+#ifndef __LOAD_STATS_H__
+#define __LOAD_STATS_H__
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <map>
+
+#include "OSHeaders.h"
+#include "OSMutex.h"
+
+class LoadHistogram
+{
+public:
+
+	LoadHistogram() { this->Reset(); }
+
+	void    Reset();
+	void    Add(UInt64 inValue);
+	void    Merge(const LoadHistogram& inOther);
+
+	UInt64  GetCount() const { return fCount; }
+	UInt64  GetMin() const { return fCount == 0 ? 0 : fMin; }
+	UInt64  GetMax() const { return fMax; }
+	Float64 GetMean() const { return fCount == 0 ? 0 : (Float64)fSum / (Float64)fCount; }
+
+	// The smallest bucket bound at or above inPercent of the values, capped at the max
+	UInt64  GetPercentile(Float64 inPercent) const;
+
+	// "min", "mean", "max", "p50", "p90", "p99", "p999" or "count"; false if unknown
+	bool    GetStat(const char* inName, Float64* outValue) const;
+
+	void    WriteJSON(FILE* inFile) const;
+
+private:
+
+	enum
+	{
+		kSubBits = 4,
+		kSubBuckets = 1 << kSubBits,
+		kNumBuckets = (64 - kSubBits + 1) * kSubBuckets
+	};
+
+	static UInt32   BucketOf(UInt64 inValue);
+	static UInt64   BucketTop(UInt32 inBucket);
+
+	UInt64  fBuckets[kNumBuckets];
+	UInt64  fCount;
+	UInt64  fSum;
+	UInt64  fMin;
+	UInt64  fMax;
+};
+
+class RTPStreamStats
+{
+public:
+
+	RTPStreamStats() : fClockRate(90000), fReceived(0), fBaseSeq(0), fMaxSeq(0), fCycles(0),
+		fReordered(0), fBytes(0), fTransit(0), fJitter(0) {}
+
+	void    SetClockRate(UInt32 inClockRate) { if (inClockRate != 0) fClockRate = inClockRate; }
+
+	// inPacket points at the RTP header
+	void    Packet(const UInt8* inPacket, UInt32 inLen, SInt64 inArrivalMicros);
+
+	UInt32  GetReceived() const { return fReceived; }
+	UInt32  GetReordered() const { return fReordered; }
+	UInt64  GetBytes() const { return fBytes; }
+	UInt32  GetExpected() const { return fReceived == 0 ? 0 : fCycles + fMaxSeq - fBaseSeq + 1; }
+	UInt32  GetLost() const;
+	UInt32  GetJitterMicros() const;
+
+	// Last sequence number seen, extended, for RTCP receiver reports
+	UInt32  GetExtendedMaxSeq() const { return fCycles + fMaxSeq; }
+	UInt32  GetJitter() const { return (UInt32)fJitter; }
+
+private:
+
+	UInt32  fClockRate;
+	UInt32  fReceived;
+	UInt32  fBaseSeq;
+	UInt32  fMaxSeq;
+	UInt32  fCycles;
+	UInt32  fReordered;
+	UInt64  fBytes;
+	SInt64  fTransit;
+	Float64 fJitter;
+};
+
+class LoadReport
+{
+public:
+
+	// The histograms, in the order they are written
+	enum
+	{
+		kTimeToFirstPacket = 0,     // microseconds from connect to the first RTP packet
+		kJitter = 1,                // microseconds, each stream's final RFC 3550 estimate
+		kLoss = 2,                  // parts per million of the packets each stream expected
+		kReorder = 3,               // packets per stream that arrived out of order
+		kServerCPU = 4,             // microseconds of server CPU per stream per second
+		kNumHistograms = 5
+	};
+
+	// Failures that have no RTSP status
+	enum
+	{
+		kNoConnection = 0,          // the connection failed or closed before the session got going
+		kBadReply = 1               // a reply that couldn't be parsed, or an SDP without tracks
+	};
+
+	LoadReport();
+
+	static const char*  GetHistogramName(UInt32 inIndex);
+
+	// A player that stopped adds its streams here
+	void    AddPlayer(SInt64 inTimeToFirstPacketMicros, RTPStreamStats* inStreams, UInt32 inNumStreams);
+	// A session that never got to playing or recording
+	void    AddFailed();
+	void    AddServerCPUSample(UInt64 inMicrosPerStream);
+	void    AddError(UInt32 inRTSPStatus);
+	void    AddTimelineSample(UInt32 inSecond, UInt32 inPlaying, UInt32 inPushing, Float64 inServerCPUPercent, UInt64 inPackets);
+
+	// Counters the sessions bump as they go, and the driver polls
+	unsigned int    fStarted;
+	unsigned int    fPlaying;
+	unsigned int    fPushing;
+	unsigned int    fFinished;
+	unsigned int    fFailed;
+	unsigned int    fPacketsReceived;
+	unsigned int    fPacketsSent;
+	unsigned int    fPacketsDropped;
+
+	// "failed", "started", or "<histogram>.<stat>" such as "ttfp.p99"
+	bool    GetValue(const char* inName, Float64* outValue);
+
+	void    WriteJSON(FILE* inFile, const char* inScenario, const char* inParams, Float64 inClientCPUPercent);
+	void    PrintSummary(FILE* inFile);
+
+private:
+
+	struct TimelineSample
+	{
+		UInt32  fSecond;
+		UInt32  fPlaying;
+		UInt32  fPushing;
+		Float64 fServerCPUPercent;
+		UInt64  fPackets;
+	};
+
+	OSMutex         fMutex;
+	LoadHistogram   fHistograms[kNumHistograms];
+	UInt32          fStreams;
+	UInt64          fStreamPackets;
+	UInt64          fStreamBytes;
+	std::map<UInt32, UInt32>  fErrors;  // by RTSP status or one of the above
+	std::vector<TimelineSample> fTimeline;
+};
+
+#endif //__LOAD_STATS_H__
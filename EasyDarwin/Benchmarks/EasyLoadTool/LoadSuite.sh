@@ -0,0 +1,51 @@
+#!/bin/sh
+#  LoadSuite.sh: runs the ramp, churn and burst scenarios of EasyLoadTool against a
+#  running EasyDarwin and keeps the JSON of each, so runs can be compared.
+#
+#     ./LoadSuite.sh [-s addr] [-p port] [-k server pid] [-n players] [-t udp|tcp] [-o outdir]
+#
+#  Exits non-zero if any scenario broke one of the limits below. Override a limit
+#  by setting its variable, e.g. MAX_TTFP_P99=500000 ./LoadSuite.sh
+
+SERVER=127.0.0.1
+PORT=554
+PID=
+PLAYERS=500
+TRANSPORT=udp
+OUT=results/`date +%Y%m%d-%H%M%S`
+
+while getopts "s:p:k:n:t:o:" opt; do
+	case $opt in
+	s) SERVER=$OPTARG ;;
+	p) PORT=$OPTARG ;;
+	k) PID=$OPTARG ;;
+	n) PLAYERS=$OPTARG ;;
+	t) TRANSPORT=$OPTARG ;;
+	o) OUT=$OPTARG ;;
+	*) sed -n '2,9p' $0; exit 1 ;;
+	esac
+done
+
+# microseconds, parts per million, sessions
+: ${MAX_TTFP_P99:=2000000}
+: ${MAX_JITTER_P99:=30000}
+: ${MAX_LOSS_P99:=1000}
+: ${MAX_FAILED:=0}
+
+TOOL=`dirname $0`/EasyLoadTool
+mkdir -p $OUT
+
+COMMON="-s $SERVER -p $PORT -n $PLAYERS -t $TRANSPORT"
+if [ -n "$PID" ]; then
+	COMMON="$COMMON -k $PID"
+fi
+LIMITS="-l ttfp_us.p99<=$MAX_TTFP_P99 -l jitter_us.p99<=$MAX_JITTER_P99 -l loss_ppm.p99<=$MAX_LOSS_P99 -l failed<=$MAX_FAILED"
+
+STATUS=0
+for scenario in ramp churn burst; do
+	echo "== $scenario"
+	$TOOL $COMMON -S $scenario -a Load_$scenario -d 30 -j $OUT/$scenario.json $LIMITS || STATUS=1
+done
+
+echo "results in $OUT"
+exit $STATUS
@@ -0,0 +1,453 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       FECBench.cpp
+
+	Contains:   What ReflectorFECEncoder's parity packets buy and what they cost.
+
+				A synthetic H.264 stream (25 fps, a key frame every 50 frames,
+				key frames of 30 packets and other frames of 4) goes through
+				ReflectorFECEncoder at a range of window and parity sizes, and
+				the media and parity packets are dropped together, as a viewer
+				would lose them. Loss is either random or comes in bursts (a
+				Gilbert-Elliott channel with a mean burst of 3 packets).
+
+				The receiver here is a plain RFC 5109 decoder: any parity packet
+				missing exactly one of its media packets restores it, until no
+				more can be. Every restored packet is checked byte for byte
+				against the one that was sent.
+
+				For each case the table has the bandwidth the parity packets add,
+				the media packets lost before and after recovery, and the frames
+				that arrive whole: without FEC, with it, and the share of the
+				frames lost without FEC that FEC brought back.
+
+				Last, the XOR kernel is timed against a byte at a time loop.
+
+				usage: FECBench [frames]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "OS.h"
+#include "ReflectorStream.h"
+
+enum
+{
+	kFramesPerSecond = 25,
+	kGOPFrames = 50,
+	kKeyFramePackets = 30,
+	kFramePackets = 4,
+	kMaxPacketSize = 1400,
+	kMediaPayloadType = 96,
+	kBurstLength = 3,
+	kBufferSize = 2060,
+	kMaxFrames = 13000      // the receiver below files packets by sequence number, which must not wrap
+};
+
+struct BenchPacket
+{
+	std::vector<UInt8>  fData;
+	UInt32              fFrame;     // media packets only
+	bool                fIsFEC;
+};
+
+static UInt32 sRandomState = 2463534242U;
+
+static UInt32 Random()
+{
+	sRandomState ^= sRandomState << 13;
+	sRandomState ^= sRandomState >> 17;
+	sRandomState ^= sRandomState << 5;
+	return sRandomState;
+}
+
+static Float64 RandomUnit()
+{
+	return (Float64)Random() / 4294967296.0;
+}
+
+static UInt16 GetSeqNum(const UInt8* inPacket)
+{
+	return (UInt16)((inPacket[2] << 8) | inPacket[3]);
+}
+
+// The media stream, in the order it is sent
+static void MakeStream(UInt32 inNumFrames, std::vector<BenchPacket>* outPackets)
+{
+	UInt16 theSeqNum = 1000;
+	UInt32 theTimeStamp = 0;
+
+	for (UInt32 theFrame = 0; theFrame < inNumFrames; theFrame++)
+	{
+		UInt32 theNumPackets = ((theFrame % kGOPFrames) == 0) ? kKeyFramePackets : kFramePackets;
+		for (UInt32 x = 0; x < theNumPackets; x++)
+		{
+			bool isLast = (x + 1 == theNumPackets);
+			UInt32 theLength = isLast ? 200 + (Random() % 1000) : kMaxPacketSize - (Random() % 100);
+
+			BenchPacket thePacket;
+			thePacket.fFrame = theFrame;
+			thePacket.fIsFEC = false;
+			thePacket.fData.resize(theLength);
+
+			UInt8* theData = &thePacket.fData[0];
+			theData[0] = 0x80;
+			theData[1] = kMediaPayloadType | (isLast ? 0x80 : 0);
+			theData[2] = (UInt8)(theSeqNum >> 8);
+			theData[3] = (UInt8)theSeqNum;
+			theData[4] = (UInt8)(theTimeStamp >> 24);
+			theData[5] = (UInt8)(theTimeStamp >> 16);
+			theData[6] = (UInt8)(theTimeStamp >> 8);
+			theData[7] = (UInt8)theTimeStamp;
+			theData[8] = 0x12;
+			theData[9] = 0x34;
+			theData[10] = 0x56;
+			theData[11] = 0x78;
+			for (UInt32 y = 12; y < theLength; y++)
+				theData[y] = (UInt8)Random();
+
+			outPackets->push_back(thePacket);
+			theSeqNum++;
+		}
+		theTimeStamp += 90000 / kFramesPerSecond;
+	}
+}
+
+static void QueueParity(ReflectorFECEncoder* inEncoder, std::vector<BenchPacket>* ioPackets)
+{
+	char theBuffer[kBufferSize];
+	UInt32 theNumParity = inEncoder->GetNumParityPackets();
+
+	for (UInt32 x = 0; x < theNumParity; x++)
+	{
+		UInt32 theLength = inEncoder->WriteParityPacket(x, theBuffer, sizeof(theBuffer));
+		if (theLength == 0)
+			continue;
+
+		BenchPacket thePacket;
+		thePacket.fFrame = 0;
+		thePacket.fIsFEC = true;
+		thePacket.fData.assign((UInt8*)theBuffer, (UInt8*)theBuffer + theLength);
+		ioPackets->push_back(thePacket);
+	}
+	inEncoder->FinishWindow();
+}
+
+// The media with the parity packets slotted in where ReflectorSender::ProtectPacket puts them
+static void Protect(const std::vector<BenchPacket>& inMedia, std::vector<BenchPacket>* outPackets)
+{
+	ReflectorFECEncoder theEncoder;
+
+	for (UInt32 x = 0; x < inMedia.size(); x++)
+	{
+		outPackets->push_back(inMedia[x]);
+		StrPtrLen thePacket((char*)&inMedia[x].fData[0], inMedia[x].fData.size());
+
+		if (ReflectorFECEncoder::sParityPackets == 0)
+			continue;
+
+		if (!theEncoder.BelongsToWindow(&thePacket))
+			QueueParity(&theEncoder, outPackets);
+
+		theEncoder.AddPacket(&thePacket);
+
+		if (theEncoder.IsWindowFull())
+			QueueParity(&theEncoder, outPackets);
+	}
+	QueueParity(&theEncoder, outPackets);
+}
+
+// Which packets arrive. inBurstLength 1 is random loss.
+static void Drop(UInt32 inNumPackets, Float64 inLossRate, UInt32 inBurstLength, std::vector<bool>* outArrived)
+{
+	// Gilbert-Elliott: the bad state loses every packet, and lasts inBurstLength on average
+	Float64 theGoodToBad = inLossRate / ((1.0 - inLossRate) * inBurstLength);
+	Float64 theBadToGood = 1.0 / inBurstLength;
+	bool isBad = false;
+
+	outArrived->resize(inNumPackets);
+	for (UInt32 x = 0; x < inNumPackets; x++)
+	{
+		if (inBurstLength <= 1)
+			isBad = (RandomUnit() < inLossRate);
+		else if (isBad)
+			isBad = (RandomUnit() >= theBadToGood);
+		else
+			isBad = (RandomUnit() < theGoodToBad);
+
+		(*outArrived)[x] = !isBad;
+	}
+}
+
+struct Receiver
+{
+	UInt16                              fFirstSeqNum;
+	std::vector<const std::vector<UInt8>*> fMedia;      // by seq num - fFirstSeqNum, NULL if missing
+	std::vector<std::vector<UInt8> >    fRecovered;
+	std::vector<const std::vector<UInt8>*> fParity;
+	UInt32                              fMismatches;
+};
+
+// Restores the one media packet inParity is missing, if it is missing exactly one
+static bool Recover(Receiver* ioReceiver, const std::vector<UInt8>& inParity, std::vector<UInt8>* outPacket)
+{
+	const UInt8* theFEC = &inParity[ReflectorFECEncoder::kRTPHeaderSize];
+	bool isLong = (theFEC[0] & 0x40) != 0;
+	UInt16 theSeqNumBase = (UInt16)((theFEC[2] << 8) | theFEC[3]);
+	const UInt8* theLevel = theFEC + ReflectorFECEncoder::kFECHeaderSize;
+	UInt32 theProtectionLength = (theLevel[0] << 8) | theLevel[1];
+	UInt32 theMaskBits = isLong ? 48 : 16;
+	const UInt8* thePayload = theLevel + (isLong ? ReflectorFECEncoder::kLongLevelHeaderSize : ReflectorFECEncoder::kShortLevelHeaderSize);
+
+	UInt64 theMask = 0;
+	for (UInt32 x = 0; x < theMaskBits / 8; x++)
+		theMask = (theMask << 8) | theLevel[2 + x];
+
+	SInt32 theMissing = -1;
+	for (UInt32 x = 0; x < theMaskBits; x++)
+	{
+		if ((theMask & ((UInt64)1 << (theMaskBits - 1 - x))) == 0)
+			continue;
+
+		UInt32 theIndex = (UInt16)(theSeqNumBase + x - ioReceiver->fFirstSeqNum);
+		if ((theIndex < ioReceiver->fMedia.size()) && (ioReceiver->fMedia[theIndex] != NULL))
+			continue;
+		if (theMissing >= 0)
+			return false;
+		theMissing = x;
+	}
+	if (theMissing < 0)
+		return false;
+
+	UInt8 theHeader[8];
+	theHeader[0] = theFEC[0];
+	theHeader[1] = theFEC[1];
+	::memcpy(theHeader + 4, theFEC + 4, 4);
+	UInt16 theLength = (UInt16)((theFEC[8] << 8) | theFEC[9]);
+
+	std::vector<UInt8> thePayloadXOR(thePayload, thePayload + theProtectionLength);
+	for (UInt32 x = 0; x < theMaskBits; x++)
+	{
+		if (((theMask & ((UInt64)1 << (theMaskBits - 1 - x))) == 0) || ((SInt32)x == theMissing))
+			continue;
+
+		const std::vector<UInt8>& thePacket = *ioReceiver->fMedia[(UInt16)(theSeqNumBase + x - ioReceiver->fFirstSeqNum)];
+		for (UInt32 y = 0; y < 8; y++)
+			theHeader[y] ^= thePacket[y];
+		theLength ^= (UInt16)(thePacket.size() - ReflectorFECEncoder::kRTPHeaderSize);
+		ReflectorFECEncoder::XORBytes(&thePayloadXOR[0], &thePacket[ReflectorFECEncoder::kRTPHeaderSize], thePacket.size() - ReflectorFECEncoder::kRTPHeaderSize);
+	}
+
+	if (theLength > theProtectionLength)
+		return false;
+
+	UInt16 theSeqNum = (UInt16)(theSeqNumBase + theMissing);
+	outPacket->resize(ReflectorFECEncoder::kRTPHeaderSize + theLength);
+	UInt8* theData = &(*outPacket)[0];
+	theData[0] = 0x80 | (theHeader[0] & 0x3F);
+	theData[1] = theHeader[1];
+	theData[2] = (UInt8)(theSeqNum >> 8);
+	theData[3] = (UInt8)theSeqNum;
+	::memcpy(theData + 4, theHeader + 4, 4);
+	::memcpy(theData + 8, &inParity[8], 4);     // the parity packet carries the media SSRC
+	::memcpy(theData + ReflectorFECEncoder::kRTPHeaderSize, &thePayloadXOR[0], theLength);
+	return true;
+}
+
+static void Receive(const std::vector<BenchPacket>& inMedia, const std::vector<BenchPacket>& inSent, const std::vector<bool>& inArrived, Receiver* outReceiver)
+{
+	outReceiver->fFirstSeqNum = GetSeqNum(&inMedia[0].fData[0]);
+	outReceiver->fMedia.assign(inMedia.size(), NULL);
+	outReceiver->fRecovered.clear();
+	outReceiver->fRecovered.reserve(inMedia.size());
+	outReceiver->fParity.clear();
+	outReceiver->fMismatches = 0;
+
+	for (UInt32 x = 0; x < inSent.size(); x++)
+	{
+		if (!inArrived[x])
+			continue;
+		if (inSent[x].fIsFEC)
+			outReceiver->fParity.push_back(&inSent[x].fData);
+		else
+			outReceiver->fMedia[(UInt16)(GetSeqNum(&inSent[x].fData[0]) - outReceiver->fFirstSeqNum)] = &inSent[x].fData;
+	}
+
+	//a restored packet may complete another parity packet, so go round until nothing changes
+	bool isProgressing = true;
+	while (isProgressing)
+	{
+		isProgressing = false;
+		for (UInt32 x = 0; x < outReceiver->fParity.size(); x++)
+		{
+			std::vector<UInt8> thePacket;
+			if (!Recover(outReceiver, *outReceiver->fParity[x], &thePacket))
+				continue;
+
+			UInt32 theIndex = (UInt16)(GetSeqNum(&thePacket[0]) - outReceiver->fFirstSeqNum);
+			if (thePacket != inMedia[theIndex].fData)
+				outReceiver->fMismatches++;
+
+			outReceiver->fRecovered.push_back(thePacket);
+			outReceiver->fMedia[theIndex] = &outReceiver->fRecovered.back();
+			isProgressing = true;
+		}
+	}
+}
+
+static UInt32 CountWholeFrames(const std::vector<BenchPacket>& inMedia, const std::vector<bool>& inHave, UInt32 inNumFrames)
+{
+	std::vector<bool> isWhole(inNumFrames, true);
+	for (UInt32 x = 0; x < inMedia.size(); x++)
+	{
+		if (!inHave[x])
+			isWhole[inMedia[x].fFrame] = false;
+	}
+
+	UInt32 theCount = 0;
+	for (UInt32 x = 0; x < inNumFrames; x++)
+		theCount += isWhole[x] ? 1 : 0;
+	return theCount;
+}
+
+static void RunCase(const std::vector<BenchPacket>& inMedia, UInt32 inNumFrames, UInt32 inWindow, UInt32 inParity, Float64 inLossRate, UInt32 inBurstLength)
+{
+	ReflectorFECEncoder::sWindowPackets = inWindow;
+	ReflectorFECEncoder::sParityPackets = inParity;
+
+	std::vector<BenchPacket> theSent;
+	theSent.reserve(inMedia.size() * 2);
+	Protect(inMedia, &theSent);
+
+	UInt64 theMediaBytes = 0;
+	UInt64 theParityBytes = 0;
+	for (UInt32 x = 0; x < theSent.size(); x++)
+	{
+		if (theSent[x].fIsFEC)
+			theParityBytes += theSent[x].fData.size();
+		else
+			theMediaBytes += theSent[x].fData.size();
+	}
+
+	std::vector<bool> theArrived;
+	Drop(theSent.size(), inLossRate, inBurstLength, &theArrived);
+
+	//what arrived of the media alone, in media order
+	std::vector<bool> theMediaArrived(inMedia.size(), false);
+	UInt32 theMediaLost = 0;
+	for (UInt32 x = 0; x < theSent.size(); x++)
+	{
+		if (theSent[x].fIsFEC)
+			continue;
+		UInt32 theIndex = (UInt16)(GetSeqNum(&theSent[x].fData[0]) - GetSeqNum(&inMedia[0].fData[0]));
+		theMediaArrived[theIndex] = theArrived[x];
+		theMediaLost += theArrived[x] ? 0 : 1;
+	}
+
+	Receiver theReceiver;
+	Receive(inMedia, theSent, theArrived, &theReceiver);
+
+	std::vector<bool> theMediaHave(inMedia.size(), false);
+	UInt32 theStillLost = 0;
+	for (UInt32 x = 0; x < inMedia.size(); x++)
+	{
+		theMediaHave[x] = (theReceiver.fMedia[x] != NULL);
+		theStillLost += theMediaHave[x] ? 0 : 1;
+	}
+
+	UInt32 theWholeBefore = CountWholeFrames(inMedia, theMediaArrived, inNumFrames);
+	UInt32 theWholeAfter = CountWholeFrames(inMedia, theMediaHave, inNumFrames);
+	UInt32 theFramesLost = inNumFrames - theWholeBefore;
+	Float64 theRecoveredShare = (theFramesLost > 0) ? 100.0 * (theWholeAfter - theWholeBefore) / theFramesLost : 100.0;
+
+	qtss_printf("%-7s %5.1f%%  %6" _U32BITARG_ " %6" _U32BITARG_ " %8.1f%%  %7.2f%% %7.2f%%  %7.2f%% %7.2f%%  %8.1f%%%s\n",
+		(inBurstLength > 1) ? "burst" : "random", inLossRate * 100.0, inWindow, inParity,
+		100.0 * theParityBytes / theMediaBytes,
+		100.0 * theMediaLost / inMedia.size(), 100.0 * theStillLost / inMedia.size(),
+		100.0 * theWholeBefore / inNumFrames, 100.0 * theWholeAfter / inNumFrames,
+		theRecoveredShare, (theReceiver.fMismatches > 0) ? "  MISMATCH" : "");
+}
+
+static void ByteXOR(UInt8* ioDest, const UInt8* inSource, UInt32 inLength)
+{
+	for (UInt32 x = 0; x < inLength; x++)
+		ioDest[x] ^= inSource[x];
+}
+
+static void TimeXOR()
+{
+	enum
+	{
+		kLength = kMaxPacketSize - 12,
+		kRounds = 2000000
+	};
+
+	static UInt8 sDest[kLength];
+	static UInt8 sSource[kLength];
+	for (UInt32 x = 0; x < kLength; x++)
+		sSource[x] = (UInt8)Random();
+
+	SInt64 theStart = OS::Microseconds();
+	for (UInt32 x = 0; x < kRounds; x++)
+		ReflectorFECEncoder::XORBytes(sDest, sSource, kLength);
+	SInt64 theKernelMicros = OS::Microseconds() - theStart;
+
+	//volatile, so the compiler doesn't vectorize the baseline behind our back
+	void (*volatile theByteXOR)(UInt8*, const UInt8*, UInt32) = ByteXOR;
+	theStart = OS::Microseconds();
+	for (UInt32 x = 0; x < kRounds / 10; x++)
+		theByteXOR(sDest, sSource, kLength);
+	SInt64 theByteMicros = (OS::Microseconds() - theStart) * 10;
+
+	Float64 theMBytes = (Float64)kLength * kRounds / (1024.0 * 1024.0);
+	qtss_printf("\nXOR of %d byte payloads: XORBytes %.0f MB/s, byte loop %.0f MB/s (%d check byte)\n",
+		(int)kLength, theMBytes / (theKernelMicros / 1000000.0), theMBytes / (theByteMicros / 1000000.0), (int)sDest[0]);
+}
+
+int main(int argc, char* argv[])
+{
+	UInt32 theNumFrames = 10000;
+	if (argc > 1)
+		theNumFrames = ::atoi(argv[1]);
+	if (theNumFrames < kGOPFrames)
+		theNumFrames = kGOPFrames;
+	if (theNumFrames > kMaxFrames)
+		theNumFrames = kMaxFrames;
+
+	OS::Initialize();
+
+	std::vector<BenchPacket> theMedia;
+	MakeStream(theNumFrames, &theMedia);
+	qtss_printf("%" _U32BITARG_ " frames, %u media packets\n\n", theNumFrames, (unsigned int)theMedia.size());
+
+	static const UInt32 sCases[][2] =
+	{
+		{ 10, 0 }, { 10, 1 }, { 20, 2 }, { 10, 2 }, { 20, 4 }, { 10, 3 }, { 48, 16 }, { 10, 5 }
+	};
+	static const Float64 sLossRates[] = { 0.01, 0.05, 0.10 };
+
+	qtss_printf("loss    rate    window parity  overhead  media lost        whole frames      recovered\n");
+	qtss_printf("                                         before   after    before   after    of lost frames\n");
+
+	for (UInt32 theBurst = 1; theBurst <= kBurstLength; theBurst += kBurstLength - 1)
+	{
+		for (UInt32 x = 0; x < sizeof(sLossRates) / sizeof(sLossRates[0]); x++)
+		{
+			for (UInt32 y = 0; y < sizeof(sCases) / sizeof(sCases[0]); y++)
+				RunCase(theMedia, theNumFrames, sCases[y][0], sCases[y][1], sLossRates[x], theBurst);
+			qtss_printf("\n");
+		}
+	}
+
+	TimeXOR();
+	return 0;
+}
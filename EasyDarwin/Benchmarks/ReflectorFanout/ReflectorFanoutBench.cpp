@@ -0,0 +1,196 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       ReflectorFanoutBench.cpp
+
+	Contains:   Measures what one ReflectorSender::ReflectPackets pass costs with
+				1, 100, 1000 and 5000 outputs attached to a ReflectorStream.
+
+				Packets go through the real ReflectorSocket::ProcessPacket and
+				ReflectorSender::ReflectPackets. Only the outputs are stand-ins:
+				they accept every packet and count it, so the numbers are the
+				cost of the fan-out itself and not of any socket.
+
+				The mean is taken over the whole run, so it also carries the fixed
+				cost of handing each packet to the sender; that only shows at
+				small sizes. The worst case is timed per pass.
+
+				Every size is run twice, the second time with another thread
+				adding and removing an output as fast as it can, to show that
+				changes to the output set don't hold up the sender.
+
+				usage: ReflectorFanoutBench [packets per size]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "OS.h"
+#include "OSThread.h"
+#include "OSMutex.h"
+#include "ReflectorStream.h"
+
+class BenchOutput : public ReflectorOutput
+{
+public:
+
+	BenchOutput() : fPackets(0), fLastPacketID(0), fCheckSum(0)
+	{
+		this->InititializeBookmarks(1);
+		this->setNewFlag(true);
+	}
+	virtual ~BenchOutput() {}
+
+	virtual QTSS_Error  WritePacket(StrPtrLen* inPacket, void* inStreamCookie, UInt32 inFlags, SInt64 packetLatenessInMSec, SInt64* timeToSendThisPacketAgain, UInt64* packetIDPtr, SInt64* arrivalTimeMSec, bool firstPacket)
+	{
+		//each pass starts again at the bookmarked packet, which RTPSessionOutput skips the same way
+		if ((packetIDPtr != NULL) && (*packetIDPtr <= fLastPacketID))
+			return QTSS_NoErr;
+		if (packetIDPtr != NULL)
+			fLastPacketID = *packetIDPtr;
+
+		fCheckSum += (UInt8)inPacket->Ptr[inPacket->Len - 1];
+		fPackets++;
+		return QTSS_NoErr;
+	}
+
+	virtual void        TearDown() {}
+	virtual bool        IsUDP() { return true; }
+	virtual bool        IsPlaying() { return true; }
+
+	UInt32      fPackets;
+	UInt64      fLastPacketID;
+	UInt32      fCheckSum;
+};
+
+class ChurnThread : public OSThread
+{
+public:
+
+	ChurnThread(ReflectorStream* inStream) : fStream(inStream), fCycles(0) {}
+	virtual ~ChurnThread() {}
+
+	virtual void Entry()
+	{
+		while (!this->IsStopRequested())
+		{
+			BenchOutput* theOutput = new BenchOutput();
+			(void)fStream->AddOutput(theOutput, -1);
+			fStream->RemoveOutput(theOutput);
+			delete theOutput;
+			fCycles++;
+		}
+	}
+
+	ReflectorStream*    fStream;
+	UInt32              fCycles;
+};
+
+static void RunFanout(UInt32 inNumOutputs, UInt32 inNumPackets, bool inChurn)
+{
+	SourceInfo::StreamInfo theInfo;
+	ReflectorStream* theStream = new ReflectorStream(&theInfo);
+	theStream->SetEnableBuffer(true);
+
+	//never opened, it only feeds packets to the sender the way a receiving socket would
+	ReflectorSocket* theSocket = new ReflectorSocket();
+	theSocket->SetSSRCFilter(false, 0);
+	theSocket->AddSender(theStream->GetRTPSender());
+
+	BenchOutput* theOutputs = new BenchOutput[inNumOutputs];
+	for (UInt32 x = 0; x < inNumOutputs; x++)
+		(void)theStream->AddOutput(&theOutputs[x], -1);
+
+	ChurnThread* theChurn = NULL;
+	if (inChurn)
+	{
+		theChurn = new ChurnThread(theStream);
+		theChurn->Start();
+	}
+
+	char thePacketData[1200];
+	::memset(thePacketData, 0, sizeof(thePacketData));
+	thePacketData[0] = (char)0x80;
+	thePacketData[1] = 96;
+
+	SInt64 theWorstMicros = 0;
+	SInt64 theRunStart = OS::Microseconds();
+	for (UInt32 thePacketNum = 0; thePacketNum < inNumPackets; thePacketNum++)
+	{
+		UInt16 theSeqNum = htons((UInt16)thePacketNum);
+		::memcpy(&thePacketData[2], &theSeqNum, sizeof(theSeqNum));
+		thePacketData[sizeof(thePacketData) - 1] = (char)thePacketNum;
+
+		ReflectorPacket* thePacket = theSocket->GetPacket();
+		thePacket->SetPacketData(thePacketData, sizeof(thePacketData));
+
+		OSMutexLocker locker(theSocket->GetDemuxer()->GetMutex());
+		(void)theSocket->ProcessPacket(OS::Milliseconds(), thePacket, 0, 0);
+
+		SInt64 theWakeupTime = 0;
+		SInt64 theStart = OS::Microseconds();
+		theStream->GetRTPSender()->ReflectPackets(&theWakeupTime);
+		SInt64 theElapsed = OS::Microseconds() - theStart;
+		if (theElapsed > theWorstMicros)
+			theWorstMicros = theElapsed;
+	}
+	SInt64 theTotalMicros = OS::Microseconds() - theRunStart;
+
+	UInt32 theCycles = 0;
+	if (theChurn != NULL)
+	{
+		theChurn->StopAndWaitForThread();
+		theCycles = theChurn->fCycles;
+		delete theChurn;
+	}
+
+	//every output should have seen every packet
+	UInt32 theMissing = 0;
+	for (UInt32 y = 0; y < inNumOutputs; y++)
+	{
+		if (theOutputs[y].fPackets != inNumPackets)
+			theMissing++;
+	}
+
+	Float64 thePassMicros = (Float64)theTotalMicros / inNumPackets;
+	::printf("%7" _U32BITARG_ " %-6s %10.2f %10.1f %10" _64BITARG_ "d %10" _U32BITARG_ " %8" _U32BITARG_ "\n",
+		inNumOutputs, inChurn ? "churn" : "-", thePassMicros, (thePassMicros * 1000) / inNumOutputs,
+		theWorstMicros, theCycles, theMissing);
+
+	for (UInt32 z = 0; z < inNumOutputs; z++)
+		theStream->RemoveOutput(&theOutputs[z]);
+	delete[] theOutputs;
+
+	theSocket->RemoveSender(theStream->GetRTPSender());
+	delete theStream;
+	delete theSocket;
+}
+
+int main(int argc, char* argv[])
+{
+	UInt32 theNumPackets = 2000;
+	if (argc > 1)
+		theNumPackets = ::atoi(argv[1]);
+	if (theNumPackets == 0)
+		theNumPackets = 1;
+
+	OS::Initialize();
+	OSThread::Initialize();
+
+	static const UInt32 kNumOutputs[] = { 1, 100, 1000, 5000 };
+
+	::printf("%7s %-6s %10s %10s %10s %10s %8s\n", "outputs", "", "us/pass", "ns/output", "worst us", "add+rm", "missing");
+	for (UInt32 x = 0; x < sizeof(kNumOutputs) / sizeof(kNumOutputs[0]); x++)
+	{
+		RunFanout(kNumOutputs[x], theNumPackets, false);
+		RunFanout(kNumOutputs[x], theNumPackets, true);
+	}
+
+	return 0;
+}
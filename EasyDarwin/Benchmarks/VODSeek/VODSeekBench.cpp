@@ -0,0 +1,391 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+/*
+	File:       VODSeekBench.cpp
+
+	Contains:   Measures how long QTRTPFile takes to open a two hour movie and
+				to seek to random points in it, with the seek index off, with
+				it built in memory, and with it kept in an index file.
+
+				The movie is written first: one H.264 track at 30 fps with no
+				hint track, so it streams through QTPacketizerTrack. Samples
+				alternate between two durations and chunks between one and two
+				samples, which gives stts and stsc one entry per sample or
+				chunk, the worst case for the table walks. The samples are tiny
+				so the file stays small.
+
+				An open is timed up to its first packet, since a track's sample
+				tables are only read when it is added. The movie cache is kept
+				at 0, so every open parses the movie. The first open with index
+				files on also writes the index file; the opens after it map it.
+
+				A seek is timed up to the first packet after it. Each mode
+				seeks to the same random times, and the seek times and RTP
+				timestamps they land on are checked against the first mode.
+
+				usage: VODSeekBench [seeks per mode] [movie path]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "OS.h"
+#include "OSThread.h"
+#include "QTRTPFile.h"
+#include "QTFileIndex.h"
+
+static const UInt32 kFrameRate = 30;
+static const UInt32 kNumSamples = 2 * 60 * 60 * kFrameRate;
+static const UInt32 kSyncInterval = 2 * kFrameRate;
+static const UInt32 kTimeScale = 90000;
+static const UInt32 kNumOpens = 5;
+
+//
+// Big-endian box writer for the test movie
+class MovieWriter
+{
+public:
+
+	MovieWriter() : fData(NULL), fLength(0), fMaxLength(0), fDepth(0) {}
+	~MovieWriter() { delete[] fData; }
+
+	void Put8(UInt32 inValue) { this->Grow(1); fData[fLength++] = (char)inValue; }
+	void Put16(UInt32 inValue) { this->Put8(inValue >> 8); this->Put8(inValue); }
+	void Put32(UInt32 inValue) { this->Put16(inValue >> 16); this->Put16(inValue); }
+	void PutZeros(UInt32 inCount) { while (inCount-- > 0) this->Put8(0); }
+	void PutBytes(const char* inData, UInt32 inLength) { this->Grow(inLength); ::memcpy(&fData[fLength], inData, inLength); fLength += inLength; }
+
+	void StartBox(const char* inType)
+	{
+		fBoxStart[fDepth++] = fLength;
+		this->Put32(0);
+		this->PutBytes(inType, 4);
+	}
+	void StartFullBox(const char* inType, UInt32 inVersionFlags) { this->StartBox(inType); this->Put32(inVersionFlags); }
+	void EndBox()
+	{
+		UInt32 theStart = fBoxStart[--fDepth];
+		UInt32 theSize = fLength - theStart;
+		fData[theStart] = (char)(theSize >> 24);
+		fData[theStart + 1] = (char)(theSize >> 16);
+		fData[theStart + 2] = (char)(theSize >> 8);
+		fData[theStart + 3] = (char)theSize;
+	}
+
+	UInt32  GetLength() { return fLength; }
+	bool    WriteTo(FILE* inFile) { return ::fwrite(fData, 1, fLength, inFile) == fLength; }
+
+private:
+
+	void Grow(UInt32 inLength)
+	{
+		if (fLength + inLength <= fMaxLength)
+			return;
+		fMaxLength = (fLength + inLength) * 2;
+		char* theData = new char[fMaxLength];
+		if (fData != NULL)
+			::memcpy(theData, fData, fLength);
+		delete[] fData;
+		fData = theData;
+	}
+
+	char*   fData;
+	UInt32  fLength;
+	UInt32  fMaxLength;
+	UInt32  fBoxStart[16];
+	UInt32  fDepth;
+};
+
+static const char kSPS[] = { 0x67, 0x42, (char)0xc0, 0x1e, (char)0xda, 0x02, (char)0x80, (char)0xbf, (char)0xe5, (char)0xc0, 0x44 };
+static const char kPPS[] = { 0x68, (char)0xce, 0x3c, (char)0x80 };
+static const UInt32 kNALLength = 8;
+
+static UInt32 GetSampleDuration(UInt32 inSample) { return (inSample & 1) ? 3001 : 2999; }
+static UInt32 GetChunkSamples(UInt32 inChunk) { return (inChunk & 1) ? 2 : 1; }
+
+static bool WriteMovie(const char* inPath)
+{
+	MovieWriter theMovie;
+	UInt32 theMovieDuration = kNumSamples / kFrameRate * 1000;
+	UInt32 theMediaDuration = 0;
+	for (UInt32 x = 0; x < kNumSamples; x++)
+		theMediaDuration += GetSampleDuration(x);
+
+	theMovie.StartBox("ftyp");
+	theMovie.PutBytes("isom", 4);
+	theMovie.Put32(0);
+	theMovie.PutBytes("isom", 4);
+	theMovie.EndBox();
+
+	//mdat first, so the chunk offsets are known when moov is written
+	UInt32 theDataOffset = theMovie.GetLength() + 8;
+	theMovie.StartBox("mdat");
+	for (UInt32 x = 0; x < kNumSamples; x++)
+	{
+		theMovie.Put32(kNALLength);
+		theMovie.Put8((x % kSyncInterval) == 0 ? 0x65 : 0x41);
+		theMovie.Put32(x);
+		theMovie.PutZeros(kNALLength - 5);
+	}
+	theMovie.EndBox();
+
+	theMovie.StartBox("moov");
+	theMovie.StartFullBox("mvhd", 0);
+	theMovie.Put32(0); theMovie.Put32(0); theMovie.Put32(1000); theMovie.Put32(theMovieDuration);
+	theMovie.Put32(0x10000); theMovie.Put16(0x100); theMovie.PutZeros(10);
+	theMovie.Put32(0x10000); theMovie.PutZeros(12); theMovie.Put32(0x10000); theMovie.PutZeros(12); theMovie.Put32(0x40000000);
+	theMovie.PutZeros(24); theMovie.Put32(2);
+	theMovie.EndBox();
+
+	theMovie.StartBox("trak");
+	theMovie.StartFullBox("tkhd", 7);
+	theMovie.Put32(0); theMovie.Put32(0); theMovie.Put32(1); theMovie.Put32(0); theMovie.Put32(theMovieDuration);
+	theMovie.PutZeros(16);
+	theMovie.Put32(0x10000); theMovie.PutZeros(12); theMovie.Put32(0x10000); theMovie.PutZeros(12); theMovie.Put32(0x40000000);
+	theMovie.Put32(320 << 16); theMovie.Put32(240 << 16);
+	theMovie.EndBox();
+
+	theMovie.StartBox("mdia");
+	theMovie.StartFullBox("mdhd", 0);
+	theMovie.Put32(0); theMovie.Put32(0); theMovie.Put32(kTimeScale); theMovie.Put32(theMediaDuration);
+	theMovie.Put16(0x55c4); theMovie.Put16(0);
+	theMovie.EndBox();
+	theMovie.StartFullBox("hdlr", 0);
+	theMovie.Put32(0); theMovie.PutBytes("vide", 4); theMovie.PutZeros(13);
+	theMovie.EndBox();
+
+	theMovie.StartBox("minf");
+	theMovie.StartFullBox("vmhd", 1);
+	theMovie.PutZeros(8);
+	theMovie.EndBox();
+	theMovie.StartBox("dinf");
+	theMovie.StartFullBox("dref", 0);
+	theMovie.Put32(1);
+	theMovie.StartFullBox("url ", 1);
+	theMovie.EndBox();
+	theMovie.EndBox();
+	theMovie.EndBox();
+
+	theMovie.StartBox("stbl");
+	theMovie.StartFullBox("stsd", 0);
+	theMovie.Put32(1);
+	theMovie.StartBox("avc1");
+	theMovie.PutZeros(6); theMovie.Put16(1); theMovie.PutZeros(16);
+	theMovie.Put16(320); theMovie.Put16(240); theMovie.Put32(0x480000); theMovie.Put32(0x480000); theMovie.Put32(0);
+	theMovie.Put16(1); theMovie.PutZeros(32); theMovie.Put16(0x18); theMovie.Put16(0xffff);
+	theMovie.StartBox("avcC");
+	theMovie.Put8(1); theMovie.Put8(kSPS[1]); theMovie.Put8(kSPS[2]); theMovie.Put8(kSPS[3]); theMovie.Put8(0xff);
+	theMovie.Put8(0xe1); theMovie.Put16(sizeof(kSPS)); theMovie.PutBytes(kSPS, sizeof(kSPS));
+	theMovie.Put8(1); theMovie.Put16(sizeof(kPPS)); theMovie.PutBytes(kPPS, sizeof(kPPS));
+	theMovie.EndBox();
+	theMovie.EndBox();
+	theMovie.EndBox();
+
+	theMovie.StartFullBox("stts", 0);
+	theMovie.Put32(kNumSamples);
+	for (UInt32 x = 0; x < kNumSamples; x++)
+	{
+		theMovie.Put32(1);
+		theMovie.Put32(GetSampleDuration(x));
+	}
+	theMovie.EndBox();
+
+	UInt32 theNumChunks = 0;
+	for (UInt32 theSample = 0; theSample < kNumSamples; theNumChunks++)
+		theSample += GetChunkSamples(theNumChunks);
+
+	theMovie.StartFullBox("stsc", 0);
+	theMovie.Put32(theNumChunks);
+	for (UInt32 x = 0; x < theNumChunks; x++)
+	{
+		theMovie.Put32(x + 1);
+		theMovie.Put32(GetChunkSamples(x));
+		theMovie.Put32(1);
+	}
+	theMovie.EndBox();
+
+	theMovie.StartFullBox("stsz", 0);
+	theMovie.Put32(kNALLength + 4);
+	theMovie.Put32(kNumSamples);
+	theMovie.EndBox();
+
+	theMovie.StartFullBox("stco", 0);
+	theMovie.Put32(theNumChunks);
+	for (UInt32 x = 0, theOffset = theDataOffset; x < theNumChunks; x++)
+	{
+		theMovie.Put32(theOffset);
+		theOffset += GetChunkSamples(x) * (kNALLength + 4);
+	}
+	theMovie.EndBox();
+
+	theMovie.StartFullBox("stss", 0);
+	theMovie.Put32((kNumSamples + kSyncInterval - 1) / kSyncInterval);
+	for (UInt32 x = 0; x < kNumSamples; x += kSyncInterval)
+		theMovie.Put32(x + 1);
+	theMovie.EndBox();
+
+	theMovie.EndBox();  // stbl
+	theMovie.EndBox();  // minf
+	theMovie.EndBox();  // mdia
+	theMovie.EndBox();  // trak
+	theMovie.EndBox();  // moov
+
+	FILE* theFile = ::fopen(inPath, "wb");
+	if (theFile == NULL)
+		return false;
+	bool theResult = theMovie.WriteTo(theFile);
+	::fclose(theFile);
+	return theResult;
+}
+
+static int CompareMicros(const void* inA, const void* inB)
+{
+	SInt64 theA = *(const SInt64*)inA;
+	SInt64 theB = *(const SInt64*)inB;
+	return (theA < theB) ? -1 : (theA > theB) ? 1 : 0;
+}
+
+//
+// Opens the movie and plays it up to its first packet, which is when a
+// track's sample tables are read
+static QTRTPFile* OpenMovie(const char* inMoviePath)
+{
+	QTRTPFile* theFile = new QTRTPFile();
+	if ((theFile->Initialize(inMoviePath) != QTRTPFile::errNoError) || (theFile->AddTrack(1, false) != QTRTPFile::errNoError))
+	{
+		delete theFile;
+		return NULL;
+	}
+	theFile->SetTrackSSRC(1, 0x1234);
+
+	char* thePacket = NULL;
+	int thePacketLength = 0;
+	(void)theFile->Seek(0.0);
+	(void)theFile->GetNextPacket(&thePacket, &thePacketLength);
+	return theFile;
+}
+
+//
+// Where each seek landed in the first mode, to check the others against
+static Float64* sSeekTimes = NULL;
+static UInt32* sTimestamps = NULL;
+
+static bool RunMode(const char* inName, const char* inMoviePath, bool inEnabled, bool inUseIndexFiles,
+	Float64* inTargets, UInt32 inNumSeeks, bool inRecord)
+{
+	QTFileIndex::Configure(inEnabled, inUseIndexFiles);
+
+	//the first open, which writes the index file when they are on
+	SInt64 theStart = OS::Microseconds();
+	QTRTPFile* theFile = OpenMovie(inMoviePath);
+	if (theFile == NULL)
+	{
+		::printf("%s: can't open %s\n", inName, inMoviePath);
+		return false;
+	}
+	Float64 theFirstOpenMsec = (Float64)(OS::Microseconds() - theStart) / 1000;
+	delete theFile;
+
+	theStart = OS::Microseconds();
+	for (UInt32 x = 0; x < kNumOpens; x++)
+		delete OpenMovie(inMoviePath);
+	Float64 theOpenMsec = (Float64)(OS::Microseconds() - theStart) / 1000 / kNumOpens;
+
+	theFile = OpenMovie(inMoviePath);
+
+	SInt64* theMicros = new SInt64[inNumSeeks];
+	SInt64 theTotalMicros = 0;
+	UInt32 theMismatches = 0;
+	for (UInt32 x = 0; x < inNumSeeks; x++)
+	{
+		char* thePacket = NULL;
+		int thePacketLength = 0;
+
+		theStart = OS::Microseconds();
+		(void)theFile->Seek(inTargets[x]);
+		(void)theFile->GetNextPacket(&thePacket, &thePacketLength);
+		theMicros[x] = OS::Microseconds() - theStart;
+		theTotalMicros += theMicros[x];
+
+		UInt32 theTimestamp = 0;
+		if ((thePacket != NULL) && (thePacketLength >= 8))
+			theTimestamp = ntohl(*(UInt32*)&thePacket[4]);
+
+		if (inRecord)
+		{
+			sSeekTimes[x] = theFile->GetActualSeekTime();
+			sTimestamps[x] = theTimestamp;
+		}
+		else if ((sSeekTimes[x] != theFile->GetActualSeekTime()) || (sTimestamps[x] != theTimestamp))
+			theMismatches++;
+	}
+	delete theFile;
+
+	::qsort(theMicros, inNumSeeks, sizeof(SInt64), CompareMicros);
+	::printf("%-12s %10.2f %10.2f %10.1f %10" _64BITARG_ "d %10" _64BITARG_ "d %10" _U32BITARG_ "\n",
+		inName, theFirstOpenMsec, theOpenMsec, (Float64)theTotalMicros / inNumSeeks,
+		theMicros[(inNumSeeks * 99) / 100], theMicros[inNumSeeks - 1], theMismatches);
+
+	delete[] theMicros;
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	UInt32 theNumSeeks = 2000;
+	if (argc > 1)
+		theNumSeeks = ::atoi(argv[1]);
+	if (theNumSeeks == 0)
+		theNumSeeks = 1;
+
+	const char* theMoviePath = "/tmp/VODSeekBench.mp4";
+	if (argc > 2)
+		theMoviePath = argv[2];
+
+	OS::Initialize();
+	OSThread::Initialize();
+	QTRTPFile::Initialize();
+
+	//every open parses the movie
+	QTRTPFile::SetFileCacheSize(0);
+
+	if (!WriteMovie(theMoviePath))
+	{
+		::printf("can't write %s\n", theMoviePath);
+		return 1;
+	}
+
+	char theIndexPath[1024];
+	::snprintf(theIndexPath, sizeof(theIndexPath), "%s.qtindex", theMoviePath);
+	(void)::unlink(theIndexPath);
+
+	Float64 theDuration = (Float64)kNumSamples / kFrameRate;
+	Float64* theTargets = new Float64[theNumSeeks];
+	::srand(1);
+	for (UInt32 x = 0; x < theNumSeeks; x++)
+		theTargets[x] = theDuration * ((Float64)::rand() / ((Float64)RAND_MAX + 1));
+
+	sSeekTimes = new Float64[theNumSeeks];
+	sTimestamps = new UInt32[theNumSeeks];
+
+	::printf("%" _U32BITARG_ " samples, %" _U32BITARG_ " seeks per mode\n", kNumSamples, theNumSeeks);
+	::printf("%-12s %10s %10s %10s %10s %10s %10s\n", "index", "1st open ms", "open ms", "seek us", "p99 us", "worst us", "mismatch");
+	bool theResult = RunMode("off", theMoviePath, false, false, theTargets, theNumSeeks, true)
+		&& RunMode("memory", theMoviePath, true, false, theTargets, theNumSeeks, false)
+		&& RunMode("file", theMoviePath, true, true, theTargets, theNumSeeks, false);
+
+	(void)::unlink(theIndexPath);
+	(void)::unlink(theMoviePath);
+	delete[] theTargets;
+	delete[] sSeekTimes;
+	delete[] sTimestamps;
+
+	return theResult ? 0 : 1;
+}
@@ -126,7 +126,8 @@ void QTAtom_stsc_SampleTableControlBlock::Reset()
 //
 QTAtom_stsc::QTAtom_stsc(QTFile * File, QTFile::AtomTOCEntry * TOCEntry, bool Debug, bool DeepDebug)
 	: QTAtom(File, TOCEntry, Debug, DeepDebug),
-	fNumEntries(0), fSampleToChunkTable(NULL), fTableSize(0)
+	fNumEntries(0), fSampleToChunkTable(NULL), fTableSize(0),
+	fIndex(NULL)
 {
 }
 
@@ -450,6 +451,33 @@ bool QTAtom_stsc::SampleToChunkInfo(UInt32 SampleNumber, UInt32 *samplesPerChunk
 	}
 	//  qtss_printf("QTAtom_stsc::SampleToChunkInfo missed cache SampleNumber = %" _S32BITARG_ "\n",SampleNumber);
 
+	//
+	// Start at the last checkpoint at or before this sample if it's ahead of
+	// us, or if we would otherwise have to start over.
+	if (fIndex != NULL)
+	{
+		UInt32 first = 0, last = this->GetNumIndexEntries();
+		while (first < last)
+		{
+			UInt32 middle = first + ((last - first) / 2);
+			if (fIndex[middle].fCurSample <= SampleNumber)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+
+		QTAtom_stsc_IndexEntry* indexEntry = (first > 0) ? &fIndex[first - 1] : NULL;
+		if ((indexEntry != NULL) && ((STCB->fCurSample_SampleToChunkInfo > SampleNumber) || (STCB->fCurEntry_SampleToChunkInfo < indexEntry->fEntry)))
+		{
+			missedCache = (STCB->fCurSample_SampleToChunkInfo > SampleNumber);
+			STCB->fCurEntry_SampleToChunkInfo = indexEntry->fEntry;
+			STCB->fCurSample_SampleToChunkInfo = indexEntry->fCurSample;
+			STCB->fLastFirstChunk_SampleToChunkInfo = indexEntry->fLastFirstChunk;
+			STCB->fLastSamplesPerChunk_SampleToChunkInfo = indexEntry->fLastSamplesPerChunk;
+			STCB->fLastSampleDescription_SampleToChunkInfo = indexEntry->fLastSampleDescription;
+		}
+	}
+
 		//
 		// Assume that this sample came out of the last chunk.
 	aChunkNumber = STCB->fLastFirstChunk_SampleToChunkInfo + ((SampleNumber - STCB->fCurSample_SampleToChunkInfo) / STCB->fLastSamplesPerChunk_SampleToChunkInfo);
@@ -576,6 +604,45 @@ done:
 
 
 
+// -------------------------------------
+// Seek index
+//
+void QTAtom_stsc::BuildIndex(QTAtom_stsc_IndexEntry * outIndex)
+{
+	// General vars
+	UInt32      FirstChunk = 0, SamplesPerChunk = 0, SampleDescription = 0;
+	UInt32      CurSample = 1, LastFirstChunk = 1, LastSamplesPerChunk = 1, LastSampleDescription = 0;
+
+	//
+	// Walk the table the way SampleToChunkInfo does, from a reset STCB.
+	for (UInt32 CurEntry = 0; CurEntry < fNumEntries; CurEntry++)
+	{
+		if ((CurEntry % kIndexInterval) == 0)
+		{
+			outIndex->fEntry = CurEntry;
+			outIndex->fCurSample = CurSample;
+			outIndex->fLastFirstChunk = LastFirstChunk;
+			outIndex->fLastSamplesPerChunk = LastSamplesPerChunk;
+			outIndex->fLastSampleDescription = LastSampleDescription;
+			outIndex++;
+		}
+
+		memcpy(&FirstChunk, fSampleToChunkTable + (CurEntry * 12) + 0, 4);
+		FirstChunk = ntohl(FirstChunk);
+		memcpy(&SamplesPerChunk, fSampleToChunkTable + (CurEntry * 12) + 4, 4);
+		SamplesPerChunk = ntohl(SamplesPerChunk);
+		memcpy(&SampleDescription, fSampleToChunkTable + (CurEntry * 12) + 8, 4);
+		SampleDescription = ntohl(SampleDescription);
+
+		CurSample += (FirstChunk - LastFirstChunk) * LastSamplesPerChunk;
+		LastFirstChunk = FirstChunk;
+		LastSamplesPerChunk = SamplesPerChunk;
+		LastSampleDescription = SampleDescription;
+	}
+}
+
+
+
 // -------------------------------------
 // Debugging functions
 //
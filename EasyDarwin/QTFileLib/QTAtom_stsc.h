@@ -37,6 +37,16 @@
 #include "QTAtom.h"
 
 
+//
+// Seek index entry: SampleToChunkInfo's table walk state at the start of
+// entry fEntry. The other fields describe the entry before it.
+struct QTAtom_stsc_IndexEntry {
+	UInt32      fEntry;
+	UInt32      fCurSample;
+	UInt32      fLastFirstChunk, fLastSamplesPerChunk, fLastSampleDescription;
+};
+
+
 //
 // Class state cookie
 class QTAtom_stsc_SampleTableControlBlock {
@@ -132,6 +142,15 @@ public:
 	}
 
 	UInt32  GetChunkFirstSample(UInt32 chunkNumber);
+
+	//
+	// Seek index (see QTFileIndex), a checkpoint every kIndexInterval entries.
+	enum { kIndexInterval = 32 };
+
+	UInt32      GetNumIndexEntries() { return (fNumEntries + kIndexInterval - 1) / kIndexInterval; }
+	void        BuildIndex(QTAtom_stsc_IndexEntry * outIndex);
+	void        SetIndex(QTAtom_stsc_IndexEntry * inIndex) { fIndex = inIndex; }
+
 	//
 	// Debugging functions.
 	virtual void        DumpAtom();
@@ -147,6 +166,8 @@ protected:
 	UInt32      fNumEntries;
 	char        *fSampleToChunkTable;
 	UInt32      fTableSize;
+
+	QTAtom_stsc_IndexEntry  *fIndex;    // not ours, GetNumIndexEntries() long
 };
 
 #endif // QTAtom_stsc_H
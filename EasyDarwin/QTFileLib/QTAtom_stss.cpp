@@ -172,14 +172,11 @@ void QTAtom_stss::PreviousSyncSample(UInt32 SampleNumber, UInt32 *SyncSampleNumb
 	*SyncSampleNumber = SampleNumber;
 
 	//
-	// Scan the table until we find a sample number greater than our current
-	// sample number; then return that.
-	for (UInt32 CurEntry = 0; CurEntry < fNumEntries; CurEntry++) {
-		//
-		// Take this entry if it is before (or equal to) our current entry.
-		if (fTable[CurEntry] <= SampleNumber)
-			*SyncSampleNumber = fTable[CurEntry];
-	}
+	// Take the entry just before the first one greater than our current
+	// sample number.
+	UInt32 nextEntry = FindNextEntry(SampleNumber, 0);
+	if (nextEntry > 0)
+		*SyncSampleNumber = fTable[nextEntry - 1];
 }
 
 void QTAtom_stss::NextSyncSample(UInt32 SampleNumber, UInt32 *SyncSampleNumber)
@@ -189,16 +186,10 @@ void QTAtom_stss::NextSyncSample(UInt32 SampleNumber, UInt32 *SyncSampleNumber)
 	*SyncSampleNumber = SampleNumber + 1;
 
 	//
-	// Scan the table until we find a sample number greater than our current
-	// sample number; then return that.
-	for (UInt32 CurEntry = 0; CurEntry < fNumEntries; CurEntry++) {
-		//
-		// Take this entry if it is greater than our current entry.
-		if (fTable[CurEntry] > SampleNumber) {
-			*SyncSampleNumber = fTable[CurEntry];
-			break;
-		}
-	}
+	// Take the first entry greater than our current sample number.
+	UInt32 nextEntry = FindNextEntry(SampleNumber, 0);
+	if (nextEntry < fNumEntries)
+		*SyncSampleNumber = fTable[nextEntry];
 }
 
 
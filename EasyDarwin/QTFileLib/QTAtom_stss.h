@@ -61,14 +61,8 @@ public:
 	inline bool       IsSyncSample(UInt32 SampleNumber, UInt32 inCursor)
 	{
 		Assert(inCursor <= fNumEntries);
-		for (UInt32 curEntry = inCursor; curEntry < fNumEntries; curEntry++)
-		{
-			if (fTable[curEntry] == SampleNumber)
-				return true;
-			else if (fTable[curEntry] > SampleNumber)
-				return false;
-		}
-		return false;
+		UInt32 nextEntry = FindNextEntry(SampleNumber, inCursor);
+		return (nextEntry > inCursor) && (fTable[nextEntry - 1] == SampleNumber);
 	}
 
 
@@ -88,6 +82,23 @@ protected:
 	char        *fSyncSampleTable;
 	UInt32      *fTable; // longword-aligned version of the above
 	UInt32      fTableSize;
+
+	//
+	// Binary search of the (sorted) table, starting at inFirstEntry, for the
+	// first entry after SampleNumber. Returns fNumEntries if there is none.
+	inline UInt32   FindNextEntry(UInt32 SampleNumber, UInt32 inFirstEntry)
+	{
+		UInt32 first = inFirstEntry, last = fNumEntries;
+		while (first < last)
+		{
+			UInt32 middle = first + ((last - first) / 2);
+			if (fTable[middle] <= SampleNumber)
+				first = middle + 1;
+			else
+				last = middle;
+		}
+		return first;
+	}
 };
 
 #endif // QTAtom_stss_H
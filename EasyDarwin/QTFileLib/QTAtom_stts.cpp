@@ -97,7 +97,8 @@ void QTAtom_stts_SampleTableControlBlock::Reset()
 //
 QTAtom_stts::QTAtom_stts(QTFile * File, QTFile::AtomTOCEntry * TOCEntry, bool Debug, bool DeepDebug)
 	: QTAtom(File, TOCEntry, Debug, DeepDebug),
-	fNumEntries(0), fTimeToSampleTable(NULL), fTableSize(0)
+	fNumEntries(0), fTimeToSampleTable(NULL), fTableSize(0),
+	fIndex(NULL)
 {
 }
 
@@ -187,6 +188,16 @@ bool QTAtom_stts::MediaTimeToSampleNumber(UInt32 MediaTime, UInt32 * SampleNumbe
 		//      qtss_printf(" QTAtom_stts::MediaTimeToSampleNumber RESET \n");
 		STCB->Reset();
 	}
+
+	//
+	// Start at the last checkpoint before this time if it's ahead of us.
+	QTAtom_stts_IndexEntry* indexEntry = this->FindIndexEntryByTime(MediaTime);
+	if ((indexEntry != NULL) && (indexEntry->fMediaTime > STCB->fMTtSN_CurMediaTime))
+	{
+		STCB->fMTtSN_CurEntry = indexEntry->fEntry;
+		STCB->fMTtSN_CurMediaTime = indexEntry->fMediaTime;
+		STCB->fMTtSN_CurSample = indexEntry->fSampleNumber;
+	}
 	//
 	// Linearly search through the sample table until we find the sample
 	// which fits inside the given media time.
@@ -247,6 +258,14 @@ bool QTAtom_stts::SampleNumberToMediaTime(UInt32 SampleNumber, UInt32 * MediaTim
 		//      qtss_printf(" QTAtom_stts::SampleNumberToMediaTime reset \n");
 		STCB->Reset();
 	}
+
+	QTAtom_stts_IndexEntry* indexEntry = this->FindIndexEntryBySample(SampleNumber);
+	if ((indexEntry != NULL) && (indexEntry->fSampleNumber > STCB->fSNtMT_CurSample))
+	{
+		STCB->fSNtMT_CurEntry = indexEntry->fEntry;
+		STCB->fSNtMT_CurMediaTime = indexEntry->fMediaTime;
+		STCB->fSNtMT_CurSample = indexEntry->fSampleNumber;
+	}
 	//
 	// Linearly search through the sample table until we find the sample
 	// which fits inside the given media time.
@@ -284,6 +303,77 @@ bool QTAtom_stts::SampleNumberToMediaTime(UInt32 SampleNumber, UInt32 * MediaTim
 
 
 
+// -------------------------------------
+// Seek index
+//
+void QTAtom_stts::BuildIndex(QTAtom_stts_IndexEntry * outIndex)
+{
+	// General vars
+	UInt32      SampleCount, SampleDuration;
+	UInt32      CurMediaTime = 0, CurSample = 1;
+
+	//
+	// Record the same running totals the lookups keep in their STCBs.
+	for (UInt32 CurEntry = 0; CurEntry < fNumEntries; CurEntry++)
+	{
+		if ((CurEntry % kIndexInterval) == 0)
+		{
+			outIndex->fEntry = CurEntry;
+			outIndex->fSampleNumber = CurSample;
+			outIndex->fMediaTime = CurMediaTime;
+			outIndex++;
+		}
+
+		memcpy(&SampleCount, fTimeToSampleTable + (CurEntry * 8), 4);
+		SampleCount = ntohl(SampleCount);
+		memcpy(&SampleDuration, fTimeToSampleTable + (CurEntry * 8) + 4, 4);
+		SampleDuration = ntohl(SampleDuration);
+
+		CurMediaTime += SampleCount * SampleDuration;
+		CurSample += SampleCount;
+	}
+}
+
+QTAtom_stts_IndexEntry * QTAtom_stts::FindIndexEntryByTime(UInt32 MediaTime)
+{
+	if (fIndex == NULL)
+		return NULL;
+
+	//
+	// Binary search for the last checkpoint that starts before MediaTime.
+	UInt32 first = 0, last = this->GetNumIndexEntries();
+	while (first < last)
+	{
+		UInt32 middle = first + ((last - first) / 2);
+		if (fIndex[middle].fMediaTime < MediaTime)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return (first > 0) ? &fIndex[first - 1] : NULL;
+}
+
+QTAtom_stts_IndexEntry * QTAtom_stts::FindIndexEntryBySample(UInt32 SampleNumber)
+{
+	if (fIndex == NULL)
+		return NULL;
+
+	UInt32 first = 0, last = this->GetNumIndexEntries();
+	while (first < last)
+	{
+		UInt32 middle = first + ((last - first) / 2);
+		if (fIndex[middle].fSampleNumber < SampleNumber)
+			first = middle + 1;
+		else
+			last = middle;
+	}
+
+	return (first > 0) ? &fIndex[first - 1] : NULL;
+}
+
+
+
 // -------------------------------------
 // Debugging functions
 //
@@ -37,6 +37,15 @@
 #include "QTAtom.h"
 
 
+//
+// Seek index entry: the table walk's state at the start of entry fEntry
+struct QTAtom_stts_IndexEntry {
+	UInt32      fEntry;
+	UInt32      fSampleNumber;
+	UInt32      fMediaTime;
+};
+
+
 //
 // Class state cookie
 class QTAtom_stts_SampleTableControlBlock {
@@ -90,6 +99,15 @@ public:
 	bool      SampleNumberToMediaTime(UInt32 SampleNumber, UInt32 * MediaTime,
 		QTAtom_stts_SampleTableControlBlock * STCB);
 
+	//
+	// Seek index (see QTFileIndex). A checkpoint every kIndexInterval entries
+	// lets a lookup start next to its target instead of at the first entry.
+	enum { kIndexInterval = 32 };
+
+	UInt32      GetNumIndexEntries() { return (fNumEntries + kIndexInterval - 1) / kIndexInterval; }
+	void        BuildIndex(QTAtom_stts_IndexEntry * outIndex);
+	void        SetIndex(QTAtom_stts_IndexEntry * inIndex) { fIndex = inIndex; }
+
 
 	//
 	// Debugging functions.
@@ -97,6 +115,11 @@ public:
 	virtual void        DumpTable(void);
 
 protected:
+	//
+	// Protected member functions.
+	QTAtom_stts_IndexEntry *    FindIndexEntryByTime(UInt32 MediaTime);
+	QTAtom_stts_IndexEntry *    FindIndexEntryBySample(UInt32 SampleNumber);
+
 	//
 	// Protected member variables.
 	UInt8       fVersion;
@@ -106,6 +129,8 @@ protected:
 	char        *fTimeToSampleTable;
 	UInt32      fTableSize;
 
+	QTAtom_stts_IndexEntry  *fIndex;    // not ours, GetNumIndexEntries() long
+
 };
 
 //
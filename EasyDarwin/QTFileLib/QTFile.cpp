@@ -52,6 +52,7 @@
 
 #include "QTTrack.h"
 #include "QTHintTrack.h"
+#include "QTPacketizerTrack.h"
 #if MMAP_TABLES
 #include <sys/mman.h>
 #endif
@@ -182,22 +183,7 @@ QTFile::ErrorCode QTFile::Open(const char * MoviePath)
 	if (theErr != QTSS_NoErr)
 		return errFileNotFound;
 
-	QTSS_AttrInfoObject attrInfoObject;
-	QTSS_Error error = QTSS_GetAttrInfoByName(fMovieFD, "QTSSPosixFileSysModuleOSFileSource", &attrInfoObject);
-	if (QTSS_NoErr == error)
-	{
-		QTSS_AttributeID fdID;
-		UInt32 len = sizeof(fdID);
-		error = QTSS_GetValue(attrInfoObject, qtssAttrID, 0, &fdID, &len);
-
-		if (theErr == QTSS_NoErr && len > 0)
-		{
-			len = sizeof(fOSFileSourceFD);
-			error = QTSS_GetValue(fMovieFD, fdID, 0, &fOSFileSourceFD, &len);
-			if (theErr != QTSS_NoErr || len == 0)
-				fOSFileSourceFD = NULL;
-		}
-	}
+	fOSFileSourceFD = QTFile_FileControlBlock::GetOSFileSource(fMovieFD);
 
 #else
 	fMovieFD.Set(MoviePath);
@@ -239,10 +225,19 @@ QTFile::ErrorCode QTFile::Open(const char * MoviePath)
 	// NOTE that the tracks are *not* initialized here.  That is done when they
 	// are actually used; either directly or by a QTHintTrack.
 	DEBUG_PRINT(("QTFile::Open - Loading tracks.\n"));
+	//
+	// A movie without hint tracks has its H.264, H.265 and AAC tracks
+	// packetized as they are streamed.
+	bool hasHintTracks = false;
+	TOCEntry = NULL;
+	while (!hasHintTracks && FindTOCEntry("moov:trak", &TOCEntry, TOCEntry))
+		hasHintTracks = FindTOCEntry(":tref:hint", NULL, TOCEntry);
+
 	TOCEntry = NULL;
 	while (FindTOCEntry("moov:trak", &TOCEntry, TOCEntry)) {
 		// General vars
 		TrackListEntry  *ListEntry;
+		QTPacketizerTrack::PayloadType  payloadType;
 
 
 		//
@@ -257,6 +252,10 @@ QTFile::ErrorCode QTFile::Open(const char * MoviePath)
 			ListEntry->Track = new QTHintTrack(this, TOCEntry, fDebug, fDeepDebug);
 			ListEntry->IsHintTrack = true;
 		}
+		else if (!hasHintTracks && ((payloadType = QTPacketizerTrack::GetPayloadType(this, TOCEntry)) != QTPacketizerTrack::kUnsupported)) {
+			ListEntry->Track = new QTPacketizerTrack(this, TOCEntry, payloadType, fDebug, fDeepDebug);
+			ListEntry->IsHintTrack = true;
+		}
 		else {
 			ListEntry->Track = new QTTrack(this, TOCEntry, fDebug, fDeepDebug);
 			ListEntry->IsHintTrack = false;
@@ -308,38 +307,23 @@ char *QTFile::GetModDateStr()
 	return fModDateBuffer.GetDateBuffer();
 }
 
-void QTFile::AllocateBuffers(UInt32 inUnitSizeInK, UInt32 inBufferInc, UInt32 inBufferSizeUnits, UInt32 inMaxBitRateBuffSizeInBlocks, UInt32 inBitrate)
+void QTFile::AllocateBuffers(UInt32 inBitrate)
 {
+	if (fCacheBuffersSet)
+		return; // every session of this movie reads through the same cache
 
 #if DSS_USE_API_CALLBACKS
-	if (fOSFileSourceFD != NULL)
-	{
-		if (!fCacheBuffersSet)
-		{
-			fCacheBuffersSet = true;
-			fOSFileSourceFD->AllocateFileCache(inUnitSizeInK, inBufferSizeUnits, inBufferInc, inMaxBitRateBuffSizeInBlocks, inBitrate);
-			fOSFileSourceFD->EnableFileCache(fCacheBuffersSet);
-		}
-		else
-		{
-			fOSFileSourceFD->IncMaxBuffers();
-		}
-	}
+	if (fOSFileSourceFD == NULL)
+		return;
 
+	fOSFileSourceFD->AllocateFileCache(inBitrate);
+	fOSFileSourceFD->EnableFileCache(true);
 #else
-	if (!fCacheBuffersSet)
-	{
-		fCacheBuffersSet = true;
-		fMovieFD.AllocateFileCache(inUnitSizeInK, inBufferSizeUnits, inBufferInc, inMaxBitRateBuffSizeInBlocks, inBitrate);
-		fMovieFD.EnableFileCache(fCacheBuffersSet);
-	}
-	else
-	{
-		fMovieFD.IncMaxBuffers();
-	}
-
+	fMovieFD.AllocateFileCache(inBitrate);
+	fMovieFD.EnableFileCache(true);
 #endif
 
+	fCacheBuffersSet = true;
 }
 
 
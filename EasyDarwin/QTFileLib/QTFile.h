@@ -135,14 +135,8 @@ public:
 	bool      Read(UInt64 Offset, char * const Buffer, UInt32 Length, QTFile_FileControlBlock * FCB = NULL);
 
 
-	void        AllocateBuffers(UInt32 inUnitSizeInK, UInt32 inBufferInc, UInt32 inBufferSize, UInt32 inMaxBitRateBuffSizeInBlocks, UInt32 inBitrate);
-#if DSS_USE_API_CALLBACKS
-	void        IncBufferUserCount() { if (fOSFileSourceFD != NULL) fOSFileSourceFD->IncMaxBuffers(); }
-	void        DecBufferUserCount() { if (fOSFileSourceFD != NULL) fOSFileSourceFD->DecMaxBuffers(); }
-#else
-	void        IncBufferUserCount() { fMovieFD.IncMaxBuffers(); }
-	void        DecBufferUserCount() { fMovieFD.DecMaxBuffers(); }
-#endif
+	// Turns on the shared block cache for the movie's reads, reading ahead for inBitrate.
+	void        AllocateBuffers(UInt32 inBitrate);
 
 	inline bool       ValidTOC();
 
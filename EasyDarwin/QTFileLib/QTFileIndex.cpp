@@ -0,0 +1,275 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+//
+// QTFileIndex:
+//   Seek index for the hint tracks of a QTFile.
+
+
+// -------------------------------------
+// Includes
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "SafeStdLib.h"
+#include <string.h>
+#include <errno.h>
+
+#ifndef __Win32__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include "QTFile.h"
+#include "QTTrack.h"
+#include "QTFileIndex.h"
+
+
+// -------------------------------------
+// Constants
+//
+static const char*  sIndexFileSuffix = ".qtindex";
+
+
+// -------------------------------------
+// Class globals
+//
+bool QTFileIndex::sEnabled = true;
+bool QTFileIndex::sUseIndexFiles = false;
+
+
+// -------------------------------------
+// Constructors and destructors
+//
+QTFileIndex::QTFileIndex(char * inIndex, UInt32 inLength, bool inIsMapped)
+	: fIndex(inIndex),
+	fLength(inLength),
+	fIsMapped(inIsMapped)
+{
+}
+
+QTFileIndex::~QTFileIndex()
+{
+#ifndef __Win32__
+	if (fIsMapped)
+	{
+		(void)::munmap(fIndex, fLength);
+		return;
+	}
+#endif
+	delete[] fIndex;
+}
+
+
+// -------------------------------------
+// Class functions
+//
+void QTFileIndex::Configure(bool inEnabled, bool inUseIndexFiles)
+{
+	sEnabled = inEnabled;
+	sUseIndexFiles = inUseIndexFiles;
+}
+
+QTFileIndex* QTFileIndex::Load(QTFile * inFile, const char * inMoviePath, SInt64 inModDate, UInt64 inMovieLength)
+{
+	// General vars
+	QTTrack     *track;
+	UInt32      numTracks = 0;
+	UInt32      indexLength = sizeof(QTFileIndexHeader);
+	QTFileIndex *index = NULL;
+
+	if (!sEnabled)
+		return NULL;
+
+	//
+	// Only hint tracks are seeked. A track that won't initialize is left
+	// out; QTRTPFile won't be able to add it either.
+	for (track = NULL; inFile->NextTrack(&track, track); )
+	{
+		if (!inFile->IsHintTrack(track) || (track->Initialize() != QTTrack::errNoError))
+			continue;
+
+		numTracks++;
+		indexLength += sizeof(QTFileIndexTrack) + track->GetIndexLength();
+	}
+
+	if (numTracks == 0)
+		return NULL;
+
+	char* indexPath = new char[::strlen(inMoviePath) + ::strlen(sIndexFileSuffix) + 1];
+	::strcpy(indexPath, inMoviePath);
+	::strcat(indexPath, sIndexFileSuffix);
+
+	if (sUseIndexFiles)
+		index = QTFileIndex::Map(inFile, indexPath, numTracks, inModDate, inMovieLength);
+
+	if (index == NULL)
+	{
+		//
+		// Build the index from the tables we just parsed.
+		char* buffer = new char[indexLength];
+
+		QTFileIndexHeader* header = (QTFileIndexHeader*)buffer;
+		header->fMagic = kIndexFileMagic;
+		header->fVersion = kIndexFileVersion;
+		header->fModDate = inModDate;
+		header->fLength = inMovieLength;
+		header->fNumTracks = numTracks;
+		header->fReserved = 0;
+
+		char* pos = buffer + sizeof(QTFileIndexHeader);
+		for (track = NULL; inFile->NextTrack(&track, track); )
+		{
+			if (!inFile->IsHintTrack(track) || !track->IsInitialized())
+				continue;
+
+			QTFileIndexTrack* trackHeader = (QTFileIndexTrack*)pos;
+			trackHeader->fTrackID = track->GetTrackID();
+			trackHeader->fLength = track->GetIndexLength();
+			pos += sizeof(QTFileIndexTrack);
+
+			track->BuildIndex(pos);
+			pos += trackHeader->fLength;
+		}
+
+		if (!QTFileIndex::Attach(inFile, buffer, indexLength, numTracks, inModDate, inMovieLength))
+		{
+			delete[] buffer;
+			delete[] indexPath;
+			return NULL;
+		}
+
+		if (sUseIndexFiles)
+			QTFileIndex::Write(indexPath, buffer, indexLength);
+
+		index = new QTFileIndex(buffer, indexLength, false);
+	}
+
+	delete[] indexPath;
+	return index;
+}
+
+bool QTFileIndex::Attach(QTFile * inFile, char * inIndex, UInt32 inIndexLength, UInt32 inNumTracks, SInt64 inModDate, UInt64 inMovieLength)
+{
+	QTFileIndexHeader* header = (QTFileIndexHeader*)inIndex;
+
+	if ((inIndexLength < sizeof(QTFileIndexHeader))
+		|| (header->fMagic != kIndexFileMagic) || (header->fVersion != kIndexFileVersion)
+		|| (header->fModDate != inModDate) || (header->fLength != inMovieLength)
+		|| (header->fNumTracks != inNumTracks))
+		return false;
+
+	//
+	// Check every track's index before handing any of them out, so a
+	// partial index is never left in use.
+	for (int pass = 0; pass < 2; pass++)
+	{
+		char* pos = inIndex + sizeof(QTFileIndexHeader);
+		char* end = inIndex + inIndexLength;
+
+		for (UInt32 curTrack = 0; curTrack < inNumTracks; curTrack++)
+		{
+			QTFileIndexTrack    trackHeader;
+			QTTrack             *track;
+
+			if ((UInt32)(end - pos) < sizeof(QTFileIndexTrack))
+				return false;
+			::memcpy(&trackHeader, pos, sizeof(QTFileIndexTrack));
+			pos += sizeof(QTFileIndexTrack);
+
+			if ((trackHeader.fLength > (UInt32)(end - pos))
+				|| !inFile->FindTrack(trackHeader.fTrackID, &track)
+				|| !inFile->IsHintTrack(track) || !track->IsInitialized()
+				|| (trackHeader.fLength != track->GetIndexLength()))
+				return false;
+
+			if ((pass == 1) && !track->SetIndex(pos, trackHeader.fLength))
+				return false;
+
+			pos += trackHeader.fLength;
+		}
+
+		if (pos != end)
+			return false;
+	}
+
+	return true;
+}
+
+QTFileIndex* QTFileIndex::Map(QTFile * inFile, const char * inIndexPath, UInt32 inNumTracks, SInt64 inModDate, UInt64 inMovieLength)
+{
+#ifdef __Win32__
+	return NULL;
+#else
+	struct stat indexStat;
+
+	int fd = ::open(inIndexPath, O_RDONLY);
+	if (fd == -1)
+		return NULL;
+
+	if ((::fstat(fd, &indexStat) != 0) || (indexStat.st_size < (off_t)sizeof(QTFileIndexHeader)) || (indexStat.st_size > (off_t)kUInt32_Max))
+	{
+		::close(fd);
+		return NULL;
+	}
+
+	//
+	// Index files are only ever replaced by a rename, never rewritten in
+	// place, so the mapping stays good while the server uses it.
+	UInt32 indexLength = (UInt32)indexStat.st_size;
+	char* mappedIndex = (char*)::mmap(NULL, indexLength, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+
+	if (mappedIndex == (char*)MAP_FAILED)
+		return NULL;
+
+	if (!QTFileIndex::Attach(inFile, mappedIndex, indexLength, inNumTracks, inModDate, inMovieLength))
+	{
+		(void)::munmap(mappedIndex, indexLength);
+		return NULL;
+	}
+
+	return new QTFileIndex(mappedIndex, indexLength, true);
+#endif
+}
+
+void QTFileIndex::Write(const char * inIndexPath, char * inIndex, UInt32 inLength)
+{
+#ifndef __Win32__
+	//
+	// Write a temporary file and rename it over the old index. A movie
+	// directory we can't write to just means rebuilding the index each parse.
+	char* tempPath = new char[::strlen(inIndexPath) + 16];
+	qtss_sprintf(tempPath, "%s.%d", inIndexPath, (int)::getpid());
+
+	int fd = ::open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1)
+	{
+		delete[] tempPath;
+		return;
+	}
+
+	bool written = true;
+	for (UInt32 offset = 0; written && (offset < inLength); )
+	{
+		ssize_t result = ::write(fd, inIndex + offset, inLength - offset);
+		if (result > 0)
+			offset += (UInt32)result;
+		else if ((result == -1) && (errno == EINTR))
+			continue;
+		else
+			written = false;
+	}
+
+	if ((::close(fd) != 0) || !written || (::rename(tempPath, inIndexPath) != 0))
+		(void)::unlink(tempPath);
+
+	delete[] tempPath;
+#endif
+}
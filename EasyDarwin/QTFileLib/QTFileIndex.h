@@ -0,0 +1,94 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+//
+// QTFileIndex:
+//   Seek index for the hint tracks of a QTFile: checkpoints of the stts and
+//   stsc table walks, so seeks into a long movie start next to their target
+//   instead of walking the tables from the first entry.
+//
+//   The index is built when the movie is parsed. With index files on, it is
+//   also written next to the movie (its path plus ".qtindex") and later
+//   parses of the same, unchanged movie map that file instead.
+
+#ifndef QTFileIndex_H
+#define QTFileIndex_H
+
+
+//
+// Includes
+#include "OSHeaders.h"
+
+
+//
+// External classes
+class QTFile;
+
+
+//
+// QTFileIndex class
+class QTFileIndex {
+
+public:
+	//
+	// Class constants
+	enum {
+		kIndexFileMagic = FOUR_CHARS_TO_INT('Q', 'T', 'I', 'X'),  // host byte order, so a swapped file is rebuilt
+		kIndexFileVersion = 1
+	};
+
+	//
+	// Turns the index on or off for movies parsed afterwards, and whether it
+	// is kept in an index file.
+	static void         Configure(bool inEnabled, bool inUseIndexFiles);
+
+	//
+	// Initializes and indexes the hint tracks of a movie that was just
+	// opened. Returns NULL if the index is off or no track could be indexed.
+	// Delete the index after inFile, whose tracks point into it.
+	static QTFileIndex* Load(QTFile * inFile, const char * inMoviePath, SInt64 inModDate, UInt64 inMovieLength);
+
+	~QTFileIndex();
+
+	//
+	// Accessors
+	UInt32              GetLength() { return fLength; }
+	bool                IsMapped() { return fIsMapped; }
+
+protected:
+	//
+	// On-disk layout: a header, then per track a QTFileIndexTrack followed
+	// by that track's index.
+	struct QTFileIndexHeader {
+		UInt32      fMagic;
+		UInt32      fVersion;
+		SInt64      fModDate;       // mtime and length of the movie it was built from
+		UInt64      fLength;
+		UInt32      fNumTracks;
+		UInt32      fReserved;
+	};
+
+	struct QTFileIndexTrack {
+		UInt32      fTrackID;
+		UInt32      fLength;
+	};
+
+	QTFileIndex(char * inIndex, UInt32 inLength, bool inIsMapped);
+
+	static bool         Attach(QTFile * inFile, char * inIndex, UInt32 inIndexLength, UInt32 inNumTracks, SInt64 inModDate, UInt64 inMovieLength);
+	static QTFileIndex* Map(QTFile * inFile, const char * inIndexPath, UInt32 inNumTracks, SInt64 inModDate, UInt64 inMovieLength);
+	static void         Write(const char * inIndexPath, char * inIndex, UInt32 inLength);
+
+	char                *fIndex;
+	UInt32              fLength;
+	bool                fIsMapped;
+
+	static bool         sEnabled;
+	static bool         sUseIndexFiles;
+};
+
+#endif // QTFileIndex_H
@@ -53,20 +53,13 @@
 //
 
 QTFile_FileControlBlock::QTFile_FileControlBlock()
-	: fDataFD(NULL), fDataBufferPool(NULL),
-	fDataBufferSize(0), fDataBufferPosStart(0), fDataBufferPosEnd(0),
-	fCurrentDataBuffer(NULL), fPreviousDataBuffer(NULL),
-	fCurrentDataBufferLength(0), fPreviousDataBufferLength(0),
-	fNumBlocksPerBuff(1), fNumBuffs(1),
-	fCacheEnabled(false)
+	: fDataFD(NULL), fCacheEnabled(false)
 
 {
 }
 
 QTFile_FileControlBlock::~QTFile_FileControlBlock()
 {
-	if (fDataBufferPool != NULL)
-		delete[] fDataBufferPool;
 #if DSS_USE_API_CALLBACKS
 	(void)QTSS_CloseFileObject(fDataFD);
 #endif
@@ -112,203 +105,53 @@ bool QTFile_FileControlBlock::ReadInternal(FILE_SOURCE *dataFD, UInt64 inPositio
 
 bool QTFile_FileControlBlock::Read(FILE_SOURCE *dflt, UInt64 inPosition, void* inBuffer, UInt32 inLength)
 {
-	// Temporary vars
-	UInt32 rcSize;
-
-	// General vars
-	FILE_SOURCE     *dataFD;
-
-	// success or failure
-	bool result = false;
-
 	// Get the file descriptor.  If the FCB is NULL, or the descriptor in
 	// the FCB is -1, then we need to use the class' descriptor.
+	// Either way the file source underneath does the caching.
 	if (this->IsValid())
-		dataFD = &fDataFD;
-	else
-		dataFD = dflt;
-
-	if (
-		(!fCacheEnabled) ||    // file control block caching disabled
-		(inLength > fDataBufferSize) ||   // too big for this cache
-		(inPosition < fDataBufferPosStart) // backing up
-		)
-	{
-		//if ( !fCacheEnabled) qtss_printf("QTFile_FileControlBlock::Read  cache not enabled\n");
-		//if ( inLength > fDataBufferSize) qtss_printf("QTFile_FileControlBlock::Read  read too big for cache len=%"   _U32BITARG_   " max%"   _U32BITARG_   "\n",inLength,fDataBufferSize);
-		//if ( inPosition < fDataBufferPosStart) qtss_printf("QTFile_FileControlBlock::Read  backing up skipping cache missed by =%"   _U32BITARG_   " bytes\n", fDataBufferPosStart - inPosition);
-		result = this->ReadInternal(dataFD, inPosition, inBuffer, inLength);
-		goto done;
-	}
-
-
-	// Is the requested block of data in our data buffer?  If not, read in the
-	// section of the file where this piece of data is.
-	if ((inPosition < fDataBufferPosStart) || ((inPosition + inLength) > fDataBufferPosEnd))
-	{
-		// If this is a forward-moving, contiguous read, then we can keep the
-		// current buffer around.
-
-		if ((fCurrentDataBufferLength != 0)
-			&& ((fDataBufferPosEnd - fCurrentDataBufferLength) <= inPosition)
-			&& ((fDataBufferPosEnd + fDataBufferSize) >= (inPosition + inLength))
-			)
-		{
-			// Temporary vars
-			char        *TempDataBuffer;
-
-			//qtss_printf("QTFile_FileControlBlock::Read forward read inPosition=%" _64BITARG_ "u fPreviousDataBuffer=%" _64BITARG_ "u start=%" _64BITARG_ "u\n",inPosition,fDataBufferPosStart,fDataBufferPosEnd);
-
-			// First, demote the current buffer.
-			fDataBufferPosStart += fPreviousDataBufferLength;
-			TempDataBuffer = fPreviousDataBuffer;
-
-			fPreviousDataBuffer = fCurrentDataBuffer;
-			fPreviousDataBufferLength = fCurrentDataBufferLength;
-
-			fCurrentDataBuffer = TempDataBuffer;
-			fCurrentDataBufferLength = 0;
-
-			//
-			// Then, fill the now-current buffer with data.
-			if (!this->ReadInternal(dataFD, fDataBufferPosEnd, fCurrentDataBuffer, fDataBufferSize, &rcSize))
-				goto done;
-
-			//Assert(rcSize == fDataBufferSize);
-			fCurrentDataBufferLength = (UInt32)rcSize;
-			fDataBufferPosEnd += fCurrentDataBufferLength;
-		}
-		else
-		{
-			//qtss_printf("QTFile_FileControlBlock::Read not a contiguous forward read inPosition=%" _64BITARG_ "u fPreviousDataBuffer=%" _64BITARG_ "u missed=%" _64BITARG_ "d\n ",inPosition,fDataBufferPosStart,(fDataBufferPosStart > inPosition) ? fDataBufferPosStart-inPosition: inPosition - fDataBufferPosStart);
-
-			// We need to play with our current and previous data buffers in
-			// order to skip around while reading.
-			fCurrentDataBuffer = fDataBufferPool;
-			fCurrentDataBufferLength = 0;
-
-			fPreviousDataBuffer = (char *)fDataBufferPool + fDataBufferSize;
-			fPreviousDataBufferLength = 0;
-
-			fDataBufferPosStart = inPosition;
-
-			if (!this->ReadInternal(dataFD, fDataBufferPosStart, fCurrentDataBuffer, fDataBufferSize, &rcSize))
-				goto done;
-
-			//Assert(rcSize == fDataBufferSize);
-			fCurrentDataBufferLength = (UInt32)rcSize;
-			fDataBufferPosEnd = fDataBufferPosStart + fCurrentDataBufferLength;
-		}
-
-	}
-
-	//
-	// Copy the data out of our buffer(s).
-	{
-		// General vars
-		UInt64      ReadLength = inLength;
-		UInt64      ReadOffset = inPosition - fDataBufferPosStart;
-
-		//
-		// Figure out if doing a continuous copy would cause us to cross a
-		// buffer boundary.
-		if ((inPosition < (fDataBufferPosStart + fPreviousDataBufferLength))
-			&& ((ReadOffset + ReadLength) > fPreviousDataBufferLength)
-			)
-		{
-			// Temporary vars
-			char    *pBuffer = (char *)inBuffer;
-
-			//
-			// Read the first part of the block.
-			ReadLength = fDataBufferSize - ReadOffset;
-			if (ReadLength <= (fPreviousDataBufferLength - ReadOffset))
-				::memcpy(pBuffer, fPreviousDataBuffer + ReadOffset, (UInt32)ReadLength);
-			else
-				goto done;
-
-			pBuffer += ReadLength;
-
-			//
-			// Read the last part of the block.
-			ReadLength = inLength - ReadLength;
-			if (ReadLength <= fCurrentDataBufferLength)
-			{
-				::memcpy(pBuffer, fCurrentDataBuffer, (UInt32)ReadLength);
-				result = true;
-			}
-			//
-			// Or maybe this is a continuous copy out of the old buffer.
-		}
-		else if (inPosition < (fDataBufferPosEnd - fCurrentDataBufferLength))
-		{
-			if (ReadLength <= (fPreviousDataBufferLength - ReadOffset))
-			{
-				::memcpy(inBuffer, fPreviousDataBuffer + ReadOffset, (UInt32)ReadLength);
-
-				result = true;
-			}
-		}
-		else
-		{
-			ReadOffset -= fPreviousDataBufferLength;
-			if (ReadLength <= (fCurrentDataBufferLength - ReadOffset))
-			{
-				::memcpy(inBuffer, fCurrentDataBuffer + ReadOffset, (UInt32)ReadLength);
-				result = true;
-			}
-
-		}
-	}
-
-done:
-	// We're done.
-	return result;
+		return this->ReadInternal(&fDataFD, inPosition, inBuffer, inLength);
+
+	return this->ReadInternal(dflt, inPosition, inBuffer, inLength);
 }
 
 
-void QTFile_FileControlBlock::AdjustDataBufferBitRate(UInt32 inUnitSizeInK, UInt32 inFileBitRate, UInt32 inNumBuffSizeUnits, UInt32 inMaxBitRateBuffSizeInBlocks)
+void QTFile_FileControlBlock::AdjustDataBufferBitRate(UInt32 inFileBitRate)
 {
 	if (!fCacheEnabled)
 		return;
 
-	// General vars
-	UInt32  newDataBufferSizeInUnits = inNumBuffSizeUnits;
-	UInt32  newDataBufferSize = 0;
-	UInt32  newUnitSizeBytes = 0;
-
-	if (inUnitSizeInK < 1)
-		inUnitSizeInK = 32;
-
-	newUnitSizeBytes = inUnitSizeInK * 1024;
-
-	if (inMaxBitRateBuffSizeInBlocks < 1)
-		inMaxBitRateBuffSizeInBlocks = kMaxDefaultBlocks;
-
-	if (inFileBitRate == 0) // set the maximum
-		inFileBitRate = inMaxBitRateBuffSizeInBlocks * newUnitSizeBytes;
+#if DSS_USE_API_CALLBACKS
+	OSFileSource* theFileSource = GetOSFileSource(fDataFD);
+	if (theFileSource == NULL)
+		return;
+#else
+	OSFileSource* theFileSource = &fDataFD;
+#endif
 
-	if (inNumBuffSizeUnits < 1) // calculate if not set to a given number
-	{
-		newDataBufferSizeInUnits = (inFileBitRate + newUnitSizeBytes) / newUnitSizeBytes; // 32k bytes of buffer for every 32k bits in rate
-		if (newDataBufferSizeInUnits > inMaxBitRateBuffSizeInBlocks) // Limit the buffer size value to a reasonable maximum. should be pref
-			newDataBufferSizeInUnits = inMaxBitRateBuffSizeInBlocks;
-	}
+	theFileSource->AllocateFileCache(inFileBitRate);
+	theFileSource->EnableFileCache(true);
+}
 
-	newDataBufferSize = newDataBufferSizeInUnits * kBlockByteSize;
+#if DSS_USE_API_CALLBACKS
+OSFileSource* QTFile_FileControlBlock::GetOSFileSource(QTSS_Object inFileObject)
+{
+	if (inFileObject == NULL)
+		return NULL;
 
-	//qtss_printf("QTFile_FileControlBlock::AdjustDataBuffer private buffers NewDataBufferSizeInUnits =%"   _U32BITARG_   " NewDataBufferSize = %"   _U32BITARG_   "\n",newDataBufferSizeInUnits,newDataBufferSize);
+	QTSS_AttrInfoObject theAttrInfo = NULL;
+	if (QTSS_GetAttrInfoByName(inFileObject, "QTSSPosixFileSysModuleOSFileSource", &theAttrInfo) != QTSS_NoErr)
+		return NULL;
 
-	// Free the old buffer.
-	delete[] fDataBufferPool;
-	fDataBufferSize = newDataBufferSize;
-	fDataBufferPool = new char[2 * newDataBufferSize]; // 2 contiguous buffers
-	fCurrentDataBuffer = fDataBufferPool;
-	fPreviousDataBuffer = (char *)fDataBufferPool + newDataBufferSize;
+	QTSS_AttributeID theAttrID = qtssIllegalAttrID;
+	UInt32 theLen = sizeof(theAttrID);
+	if (QTSS_GetValue(theAttrInfo, qtssAttrID, 0, &theAttrID, &theLen) != QTSS_NoErr || theLen != sizeof(theAttrID))
+		return NULL;
 
-	fDataBufferPosStart = 0;
-	fDataBufferPosEnd = 0;
-	fCurrentDataBufferLength = 0;
-	fPreviousDataBuffer = 0;
+	OSFileSource* theFileSource = NULL;
+	theLen = sizeof(theFileSource);
+	if (QTSS_GetValue(inFileObject, theAttrID, 0, &theFileSource, &theLen) != QTSS_NoErr || theLen != sizeof(theFileSource))
+		return NULL;
 
+	return theFileSource;
 }
+#endif
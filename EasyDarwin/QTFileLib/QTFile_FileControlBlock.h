@@ -33,6 +33,7 @@
 //
 // Includes
 #include "OSHeaders.h"
+#include "OSFileSource.h"
 
 #if DSS_USE_API_CALLBACKS
 #include "QTSS.h"
@@ -66,11 +67,16 @@ public:
 	bool ReadInternal(FILE_SOURCE *dataFD, UInt64 inPosition, void* inBuffer, UInt32 inLength, UInt32 *inReadLenPtr = NULL);
 
 	//
-	// Buffer management functions
-	void AdjustDataBufferBitRate(UInt32 inUnitSizeInK = 32, UInt32 inFileBitRate = 32768, UInt32 inNumBuffSizeUnits = 0, UInt32 inMaxBitRateBuffSizeInBlocks = 8);
-	void AdjustDataBuffers(UInt32 inBlockSizeKBits = 32, UInt32 inBlockCountPerBuff = 1);
+	// Buffer management functions. Reads are cached in the process-wide
+	// OSBlockCache, which reads ahead for inFileBitRate (bits per second).
+	void AdjustDataBufferBitRate(UInt32 inFileBitRate = 32768);
 	void EnableCacheBuffers(bool enabled) { fCacheEnabled = enabled; }
 
+#if DSS_USE_API_CALLBACKS
+	// The OSFileSource the POSIX file system module keeps behind a file object, or NULL
+	static OSFileSource* GetOSFileSource(QTSS_Object inFileObject);
+#endif
+
 	// QTSS_ErrorCode Close();
 
 	bool IsValid()
@@ -88,24 +94,6 @@ private:
 	// File descriptor for this control block
 	FILE_SOURCE fDataFD;
 
-	enum
-	{
-		kMaxDefaultBlocks = 8,
-		kDataBufferUnitSizeExp = 15,   // 32Kbytes
-		kBlockByteSize = (1 << kDataBufferUnitSizeExp)
-	};
-	//
-	// Data buffer cache
-	char                *fDataBufferPool;
-
-	UInt32              fDataBufferSize;
-	UInt64              fDataBufferPosStart, fDataBufferPosEnd;
-
-	char                *fCurrentDataBuffer, *fPreviousDataBuffer;
-	UInt32              fCurrentDataBufferLength, fPreviousDataBufferLength;
-
-	UInt32              fNumBlocksPerBuff;
-	UInt32              fNumBuffs;
 	bool              fCacheEnabled;
 };
 
@@ -59,6 +59,7 @@
 #include "QTAtom_tref.h"
 
 #include "QTHintTrack.h"
+#include "QTPacketizerTrack.h"
 #include "OSMutex.h"
 #include "FastCopyMacros.h"
 #include "MyAssert.h"
@@ -142,6 +143,10 @@ QTHintTrack_HintTrackControlBlock::QTHintTrack_HintTrackControlBlock(QTFile_File
 {
 	fMediaTrackSTSC_STCB = NULL;
 	fMediaTrackRefIndex = -2;
+
+	fPackets = NULL;
+	fNumPackets = fMaxPackets = 0;
+	fNextSequenceNumber = 0;
 }
 
 QTHintTrack_HintTrackControlBlock::~QTHintTrack_HintTrackControlBlock()
@@ -151,6 +156,7 @@ QTHintTrack_HintTrackControlBlock::~QTHintTrack_HintTrackControlBlock()
 	delete[]fCachedHintTrackSample;
 
 	delete[] fRTPMetaInfoFieldArray;
+	delete[] fPackets;
 }
 
 void QTHintTrack_HintTrackControlBlock::Reset()
@@ -44,6 +44,7 @@
 class QTFile;
 class QTAtom_stsc_SampleTableControlBlock;
 class QTAtom_stts_SampleTableControlBlock;
+struct QTPacketizerTrack_Packet;
 
 
 class QTHintTrackRTPHeaderData {
@@ -119,6 +120,13 @@ public:
 	SInt32              fMediaTrackRefIndex;
 	QTAtom_stsc_SampleTableControlBlock * fMediaTrackSTSC_STCB;
 
+	//
+	// Packets planned for fCachedSample by QTPacketizerTrack
+	QTPacketizerTrack_Packet*   fPackets;
+	UInt32              fNumPackets, fMaxPackets;
+	UInt16              fNextSequenceNumber;
+	QTAtom_ctts_SampleTableControlBlock  fcttsSTCB;
+
 };
 
 
@@ -142,10 +150,10 @@ public:
 
 	//
 	// Accessors.
-	ErrorCode   GetSDPFileLength(int * Length);
-	char *      GetSDPFile(int * Length);
+	virtual ErrorCode   GetSDPFileLength(int * Length);
+	virtual char *      GetSDPFile(int * Length);
 
-	inline  UInt64      GetTotalRTPBytes() { return fHintInfoAtom ? fHintInfoAtom->GetTotalRTPBytes() : 0; }
+	virtual UInt64      GetTotalRTPBytes() { return fHintInfoAtom ? fHintInfoAtom->GetTotalRTPBytes() : 0; }
 	inline  UInt64      GetTotalRTPPackets() { return fHintInfoAtom ? fHintInfoAtom->GetTotalRTPPackets() : 0; }
 
 	inline  UInt32      GetFirstRTPTimestamp() { return fFirstRTPTimestamp; }
@@ -164,7 +172,7 @@ public:
 
 	inline  UInt16      GetRTPSequenceNumberRandomOffset() { return fSequenceNumberRandomOffset; }
 
-	ErrorCode   GetNumPackets(UInt32 SampleNumber, UInt16 * NumPackets,
+	virtual ErrorCode   GetNumPackets(UInt32 SampleNumber, UInt16 * NumPackets,
 		QTHintTrack_HintTrackControlBlock * HTCB = NULL);
 
 	//
@@ -178,7 +186,7 @@ public:
 	//      is a compressed field ID.
 	//
 	// Supported fields: tt, md, ft, pp, pn, sq
-	ErrorCode   GetPacket(UInt32 SampleNumber, UInt16 PacketNumber,
+	virtual ErrorCode   GetPacket(UInt32 SampleNumber, UInt16 PacketNumber,
 		char * Buffer, UInt32 * Length,
 		Float64 * TransmitTime,
 		bool dropBFrames,
@@ -0,0 +1,888 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+//
+// QTPacketizerTrack:
+//   Streams a media track that has no hint track by packetizing its samples
+//   as they are sent.
+
+
+// -------------------------------------
+// Includes
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include "SafeStdLib.h"
+#include <string.h>
+
+#ifndef __Win32__
+#include <netinet/in.h>
+#endif
+
+#include "QTFile.h"
+#include "QTAtom_stsd.h"
+#include "QTAtom_stsz.h"
+#include "QTAtom_mdhd.h"
+
+#include "QTPacketizerTrack.h"
+#include "ResizeableStringFormatter.h"
+#include "OSMutex.h"
+#include "FastCopyMacros.h"
+#include "MyAssert.h"
+#include "base64.h"
+
+
+// -------------------------------------
+// Macros
+//
+#define DEBUG_PRINT(s) if(fDebug) qtss_printf s
+#define DEEP_DEBUG_PRINT(s) if(fDeepDebug) qtss_printf s
+
+
+// -------------------------------------
+// Constants
+//
+enum
+{
+	kVisualSampleEntryLength = 86,      // through the visual sample entry's depth and color table id
+	kAudioSampleEntryLength = 36,       // through the sound sample entry's sample rate
+	kAudioVersionPos = 16,
+	kAudioChannelCountPos = 24,
+
+	kRTPHeaderLength = 12,
+	kAUHeaderLength = 4,                // AU-headers-length plus one 16 bit AU-header
+
+	kH264NALTypeSTAPA = 24,
+	kH264NALTypeFUA = 28,
+	kH265NALTypeAP = 48,
+	kH265NALTypeFU = 49,
+
+	kH265NALTypeVPS = 32,
+	kH265NALTypeSPS = 33,
+	kH265NALTypePPS = 34,
+
+	kInitialNumPackets = 16
+};
+
+
+// -------------------------------------
+// Sample description helpers
+//
+static bool FindChildBox(char * start, char * end, OSType boxType, char ** outData, UInt32 * outLength)
+{
+	while (start + 8 <= end)
+	{
+		UInt32      boxLength, thisType;
+
+		::memcpy(&boxLength, start, 4);
+		boxLength = ntohl(boxLength);
+		::memcpy(&thisType, start + 4, 4);
+		thisType = ntohl(thisType);
+
+		if ((boxLength < 8) || (boxLength > (UInt32)(end - start)))
+			return false;
+
+		if (thisType == boxType)
+		{
+			*outData = start + 8;
+			*outLength = boxLength - 8;
+			return true;
+		}
+
+		start += boxLength;
+	}
+
+	return false;
+}
+
+static void PutBase64(ResizeableStringFormatter * ioFormatter, char * inData, UInt32 inLength)
+{
+	char* encoded = new char[::Base64encode_len(inLength)];
+	::Base64encode(encoded, inData, inLength);
+	ioFormatter->Put(encoded);
+	delete[] encoded;
+}
+
+static void PutHex(ResizeableStringFormatter * ioFormatter, char * inData, UInt32 inLength)
+{
+	for (UInt32 i = 0; i < inLength; i++)
+		ioFormatter->PutFmtStr("%02X", (UInt8)inData[i]);
+}
+
+//
+// Walks the MPEG-4 descriptors of an esds box down to the
+// DecoderSpecificInfo, which holds the AudioSpecificConfig.
+static bool FindAudioSpecificConfig(char * esds, UInt32 esdsLength, char ** outConfig, UInt32 * outConfigLength)
+{
+	char*   pos = esds + 4;     // version and flags
+	char*   end = esds + esdsLength;
+
+	while (pos + 2 <= end)
+	{
+		UInt8   tag = (UInt8)*pos++;
+		UInt32  descLength = 0;
+
+		for (int i = 0; (i < 4) && (pos < end); i++)
+		{
+			UInt8 b = (UInt8)*pos++;
+			descLength = (descLength << 7) | (b & 0x7f);
+			if ((b & 0x80) == 0)
+				break;
+		}
+
+		switch (tag)
+		{
+		case 0x03: // ES_Descriptor, step into it
+			{
+				if (pos + 3 > end)
+					return false;
+
+				UInt8 flags = (UInt8)pos[2];
+				pos += 3;
+				if (flags & 0x80)   // streamDependenceFlag
+					pos += 2;
+				if ((flags & 0x40) && (pos < end))  // URL_Flag
+					pos += 1 + (UInt8)*pos;
+				if (flags & 0x20)   // OCRstreamFlag
+					pos += 2;
+			}
+			break;
+
+		case 0x04: // DecoderConfigDescriptor, step into it
+			pos += 13;
+			break;
+
+		case 0x05: // DecoderSpecificInfo
+			if ((descLength == 0) || (descLength > (UInt32)(end - pos)))
+				return false;
+			*outConfig = pos;
+			*outConfigLength = descLength;
+			return true;
+
+		default:
+			pos += descLength;
+			break;
+		}
+	}
+
+	return false;
+}
+
+
+// -------------------------------------
+// Class functions
+//
+QTPacketizerTrack::PayloadType QTPacketizerTrack::GetPayloadType(QTFile * File, QTFile::AtomTOCEntry * trakAtom)
+{
+	QTFile::AtomTOCEntry    *stsdTOCEntry;
+	UInt32                  dataFormat;
+
+	//
+	// The first sample description's data format follows the stsd version,
+	// flags, entry count and the entry's size.
+	if (!File->FindTOCEntry(":mdia:minf:stbl:stsd", &stsdTOCEntry, trakAtom))
+		return kUnsupported;
+	if ((stsdTOCEntry->AtomDataLength < 16) || !File->Read(stsdTOCEntry->AtomDataPos + 12, (char *)&dataFormat, 4))
+		return kUnsupported;
+
+	switch (ntohl(dataFormat))
+	{
+	case FOUR_CHARS_TO_INT('a', 'v', 'c', '1'):
+	case FOUR_CHARS_TO_INT('a', 'v', 'c', '3'):
+		return kH264;
+
+	case FOUR_CHARS_TO_INT('h', 'v', 'c', '1'):
+	case FOUR_CHARS_TO_INT('h', 'e', 'v', '1'):
+		return kH265;
+
+	case FOUR_CHARS_TO_INT('m', 'p', '4', 'a'):
+		return kAAC;
+	}
+
+	return kUnsupported;
+}
+
+
+// -------------------------------------
+// Constructors and destructors
+//
+QTPacketizerTrack::QTPacketizerTrack(QTFile * File, QTFile::AtomTOCEntry * trakAtom, PayloadType inPayloadType, bool Debug, bool DeepDebug)
+	: QTHintTrack(File, trakAtom, Debug, DeepDebug),
+	fPayloadType(inPayloadType),
+	fNALLengthSize(4),
+	fChannels(1),
+	fSDP(NULL),
+	fSDPLength(0),
+	fTotalRTPBytes(0)
+{
+}
+
+QTPacketizerTrack::~QTPacketizerTrack()
+{
+	delete[] fSDP;
+}
+
+
+// -------------------------------------
+// Initialization functions
+//
+QTTrack::ErrorCode QTPacketizerTrack::Initialize()
+{
+	// General vars
+	char        *sampleDescription;
+	UInt32      sampleDescriptionLength;
+	OSType      dataFormats[2];
+
+	//
+	// Don't initialize more than once.
+	if (IsHintTrackInitialized())
+		return errNoError;
+
+	//
+	// Initialize the QTTrack class.
+	if (QTTrack::Initialize() != errNoError)
+		return errInvalidQuickTimeFile;
+
+	switch (fPayloadType)
+	{
+	case kH264:
+		dataFormats[0] = FOUR_CHARS_TO_INT('a', 'v', 'c', '1');
+		dataFormats[1] = FOUR_CHARS_TO_INT('a', 'v', 'c', '3');
+		break;
+
+	case kH265:
+		dataFormats[0] = FOUR_CHARS_TO_INT('h', 'v', 'c', '1');
+		dataFormats[1] = FOUR_CHARS_TO_INT('h', 'e', 'v', '1');
+		break;
+
+	case kAAC:
+		dataFormats[0] = dataFormats[1] = FOUR_CHARS_TO_INT('m', 'p', '4', 'a');
+		break;
+
+	default:
+		return errInvalidQuickTimeFile;
+	}
+
+	if (!fSampleDescriptionAtom->FindSampleDescription(dataFormats[0], &sampleDescription, &sampleDescriptionLength)
+		&& !fSampleDescriptionAtom->FindSampleDescription(dataFormats[1], &sampleDescription, &sampleDescriptionLength))
+		return errInvalidQuickTimeFile;
+
+	//
+	// Video goes out on the 90kHz RTP clock, AAC on its sampling rate.
+	fRTPTimescale = (fPayloadType == kAAC) ? (UInt32)this->GetTimeScale() : 90000;
+	fMaxPacketSize = kMaxPayloadSize + kRTPHeaderLength;
+
+	//
+	// Estimate the stream size: every sample plus an RTP header for each
+	// packet it will probably take.
+	UInt32 numSamples = fSampleSizeAtom->GetNumEntries();
+	UInt32 sampleBytes = 0;
+	if ((numSamples > 0) && !this->SampleRangeSize(1, numSamples, &sampleBytes))
+		return errInvalidQuickTimeFile;
+
+	fTotalRTPBytes = (UInt64)sampleBytes
+		+ ((UInt64)numSamples + (sampleBytes / kMaxPayloadSize)) * (kRTPHeaderLength + kAUHeaderLength);
+
+	if (!this->ParseSampleDescription(sampleDescription, sampleDescriptionLength))
+		return errInvalidQuickTimeFile;
+
+	//
+	// Calculate the first RTP timestamp for this track.
+	if (GetFirstEditMovieTime() > 0)
+	{
+		UInt64 trackTime = GetFirstEditMovieTime();
+
+		trackTime *= fRTPTimescale;
+
+		if (fFile->GetTimeScale() > 0.0)
+			trackTime /= (UInt64)fFile->GetTimeScale();
+
+		fFirstRTPTimestamp = (UInt32)(trackTime & 0xffffffff);
+	}
+	else
+	{
+		fFirstRTPTimestamp = 0;
+	}
+
+	DEBUG_PRINT(("QTPacketizerTrack::Initialize - Packetizing track %" _U32BITARG_ " as payload type %d.\n", this->GetTrackID(), fPayloadType));
+
+	//
+	// This track has been successfully initialiazed.
+	fHintTrackInitialized = true;
+
+	return errNoError;
+}
+
+bool QTPacketizerTrack::ParseSampleDescription(char * sampleDescription, UInt32 sampleDescriptionLength)
+{
+	// General vars
+	char        *end = sampleDescription + sampleDescriptionLength;
+	char        *box;
+	UInt32      boxLength;
+	ResizeableStringFormatter   fmtp;
+
+	switch (fPayloadType)
+	{
+	case kH264:
+		{
+			if ((sampleDescriptionLength < kVisualSampleEntryLength)
+				|| !FindChildBox(sampleDescription + kVisualSampleEntryLength, end, FOUR_CHARS_TO_INT('a', 'v', 'c', 'C'), &box, &boxLength)
+				|| (boxLength < 7))
+				return false;
+
+			fNALLengthSize = (box[4] & 0x03) + 1;
+
+			fmtp.PutFmtStr("packetization-mode=1;profile-level-id=%02X%02X%02X;sprop-parameter-sets=", (UInt8)box[1], (UInt8)box[2], (UInt8)box[3]);
+
+			//
+			// The SPS count is followed by the SPS units, then the PPS count and units.
+			char* pos = box + 5;
+			char* boxEnd = box + boxLength;
+			bool first = true;
+			for (int setType = 0; (setType < 2) && (pos < boxEnd); setType++)
+			{
+				UInt32 numSets = (setType == 0) ? ((UInt8)*pos & 0x1f) : (UInt8)*pos;
+				pos++;
+
+				for (UInt32 i = 0; i < numSets; i++)
+				{
+					if (pos + 2 > boxEnd)
+						return false;
+
+					UInt32 setLength = ((UInt8)pos[0] << 8) | (UInt8)pos[1];
+					pos += 2;
+					if (setLength > (UInt32)(boxEnd - pos))
+						return false;
+
+					if (!first)
+						fmtp.PutChar(',');
+					PutBase64(&fmtp, pos, setLength);
+					first = false;
+					pos += setLength;
+				}
+			}
+		}
+		break;
+
+	case kH265:
+		{
+			ResizeableStringFormatter   vps, sps, pps;
+
+			if ((sampleDescriptionLength < kVisualSampleEntryLength)
+				|| !FindChildBox(sampleDescription + kVisualSampleEntryLength, end, FOUR_CHARS_TO_INT('h', 'v', 'c', 'C'), &box, &boxLength)
+				|| (boxLength < 23))
+				return false;
+
+			fNALLengthSize = (box[21] & 0x03) + 1;
+
+			//
+			// Each parameter set array is a NAL type, a count and the units.
+			char* pos = box + 23;
+			char* boxEnd = box + boxLength;
+			UInt32 numArrays = (UInt8)box[22];
+			for (UInt32 curArray = 0; curArray < numArrays; curArray++)
+			{
+				if (pos + 3 > boxEnd)
+					return false;
+
+				UInt32 nalType = (UInt8)pos[0] & 0x3f;
+				UInt32 numNALUnits = ((UInt8)pos[1] << 8) | (UInt8)pos[2];
+				pos += 3;
+
+				ResizeableStringFormatter* setFormatter = NULL;
+				if (nalType == kH265NALTypeVPS) setFormatter = &vps;
+				else if (nalType == kH265NALTypeSPS) setFormatter = &sps;
+				else if (nalType == kH265NALTypePPS) setFormatter = &pps;
+
+				for (UInt32 i = 0; i < numNALUnits; i++)
+				{
+					if (pos + 2 > boxEnd)
+						return false;
+
+					UInt32 nalLength = ((UInt8)pos[0] << 8) | (UInt8)pos[1];
+					pos += 2;
+					if (nalLength > (UInt32)(boxEnd - pos))
+						return false;
+
+					if (setFormatter != NULL)
+					{
+						if (setFormatter->GetBytesWritten() > 0)
+							setFormatter->PutChar(',');
+						PutBase64(setFormatter, pos, nalLength);
+					}
+					pos += nalLength;
+				}
+			}
+
+			fmtp.Put("sprop-vps=");
+			fmtp.Put(vps.GetBufPtr(), vps.GetBytesWritten());
+			fmtp.Put(";sprop-sps=");
+			fmtp.Put(sps.GetBufPtr(), sps.GetBytesWritten());
+			fmtp.Put(";sprop-pps=");
+			fmtp.Put(pps.GetBufPtr(), pps.GetBytesWritten());
+		}
+		break;
+
+	case kAAC:
+		{
+			char        *config;
+			UInt32      configLength;
+			UInt16      version, channels;
+
+			if (sampleDescriptionLength < kAudioSampleEntryLength)
+				return false;
+
+			MOVE_WORD(version, sampleDescription + kAudioVersionPos);
+			MOVE_WORD(channels, sampleDescription + kAudioChannelCountPos);
+			fChannels = ntohs(channels);
+			if (fChannels == 0)
+				fChannels = 1;
+
+			//
+			// Version 1 and 2 sound descriptions carry extra fields before the child boxes.
+			UInt32 childPos = kAudioSampleEntryLength;
+			version = ntohs(version);
+			if (version == 1)
+				childPos += 16;
+			else if (version == 2)
+				childPos += 36;
+
+			if ((childPos > sampleDescriptionLength)
+				|| !FindChildBox(sampleDescription + childPos, end, FOUR_CHARS_TO_INT('e', 's', 'd', 's'), &box, &boxLength)
+				|| !FindAudioSpecificConfig(box, boxLength, &config, &configLength))
+				return false;
+
+			fmtp.Put("streamtype=5;profile-level-id=15;mode=AAC-hbr;config=");
+			PutHex(&fmtp, config, configLength);
+			fmtp.Put(";sizeLength=13;indexLength=3;indexDeltaLength=3");
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	if ((fNALLengthSize == 3) && (fPayloadType != kAAC))
+		return false;
+
+	fmtp.PutTerminator();
+	this->BuildSDP(fmtp.GetBufPtr());
+
+	return true;
+}
+
+void QTPacketizerTrack::BuildSDP(const char * fmtpLine)
+{
+	ResizeableStringFormatter   sdp;
+	Float64     duration = (Float64)fMediaHeaderAtom->GetDuration() * this->GetTimeScaleRecip();
+
+	if (fPayloadType == kAAC)
+		sdp.PutFmtStr("m=audio 0 RTP/AVP %d\r\n", kRTPPayloadType);
+	else
+		sdp.PutFmtStr("m=video 0 RTP/AVP %d\r\n", kRTPPayloadType);
+
+	if (duration > 0.0)
+		sdp.PutFmtStr("b=AS:%" _U32BITARG_ "\r\n", (UInt32)(((Float64)fTotalRTPBytes * 8.0) / duration / 1000.0) + 1);
+
+	switch (fPayloadType)
+	{
+	case kH264:
+		sdp.PutFmtStr("a=rtpmap:%d H264/90000\r\n", kRTPPayloadType);
+		break;
+
+	case kH265:
+		sdp.PutFmtStr("a=rtpmap:%d H265/90000\r\n", kRTPPayloadType);
+		break;
+
+	default:
+		sdp.PutFmtStr("a=rtpmap:%d mpeg4-generic/%" _U32BITARG_ "/%" _U32BITARG_ "\r\n", kRTPPayloadType, fRTPTimescale, fChannels);
+		break;
+	}
+
+	sdp.PutFmtStr("a=fmtp:%d %s\r\n", kRTPPayloadType, fmtpLine);
+	sdp.PutFmtStr("a=control:trackID=%" _U32BITARG_ "\r\n", this->GetTrackID());
+
+	delete[] fSDP;
+	fSDPLength = sdp.GetBytesWritten();
+	fSDP = new char[fSDPLength];
+	::memcpy(fSDP, sdp.GetBufPtr(), fSDPLength);
+}
+
+
+// -------------------------------------
+// Accessors
+//
+QTTrack::ErrorCode QTPacketizerTrack::GetSDPFileLength(int * length)
+{
+	OSMutexLocker locker(fFile->GetMutex());
+
+	if (this->Initialize() != errNoError)
+		return errInvalidQuickTimeFile;
+
+	*length = (int)fSDPLength;
+	return errNoError;
+}
+
+char * QTPacketizerTrack::GetSDPFile(int * length)
+{
+	OSMutexLocker locker(fFile->GetMutex());
+
+	if (this->Initialize() != errNoError)
+		return NULL;
+
+	//
+	// The caller frees this like the buffer of a hinted track's 'sdp ' atom.
+	char* sdpBuffer = new char[fSDPLength];
+	::memcpy(sdpBuffer, fSDP, fSDPLength);
+	*length = (int)fSDPLength;
+	return sdpBuffer;
+}
+
+
+// -------------------------------------
+// Packet functions
+//
+inline UInt32 QTPacketizerTrack::GetNALLength(char * nalLengthPtr)
+{
+	UInt32 nalLength = 0;
+	for (UInt32 i = 0; i < fNALLengthSize; i++)
+		nalLength = (nalLength << 8) | (UInt8)nalLengthPtr[i];
+
+	return nalLength;
+}
+
+void QTPacketizerTrack::AddPacket(QTHintTrack_HintTrackControlBlock * htcb, UInt32 nalOffset, UInt32 offset, UInt32 length, UInt16 numNALUnits, UInt8 fragment)
+{
+	if (htcb->fNumPackets == htcb->fMaxPackets)
+	{
+		UInt32 newMaxPackets = (htcb->fMaxPackets == 0) ? kInitialNumPackets : htcb->fMaxPackets * 2;
+		QTPacketizerTrack_Packet* newPackets = new QTPacketizerTrack_Packet[newMaxPackets];
+		if (htcb->fNumPackets > 0)
+			::memcpy(newPackets, htcb->fPackets, htcb->fNumPackets * sizeof(QTPacketizerTrack_Packet));
+
+		delete[] htcb->fPackets;
+		htcb->fPackets = newPackets;
+		htcb->fMaxPackets = newMaxPackets;
+	}
+
+	QTPacketizerTrack_Packet* packet = &htcb->fPackets[htcb->fNumPackets++];
+	packet->fNALOffset = nalOffset;
+	packet->fOffset = offset;
+	packet->fLength = length;
+	packet->fNumNALUnits = numNALUnits;
+	packet->fFragment = fragment;
+}
+
+QTTrack::ErrorCode QTPacketizerTrack::PlanPackets(UInt32 sampleNumber, QTHintTrack_HintTrackControlBlock * htcb)
+{
+	// General vars
+	char        *sample;
+	UInt32      sampleLength;
+
+	//
+	// The plan stays valid as long as the sample stays in the HTCB's cache.
+	if ((sampleNumber == htcb->fCachedSampleNumber) && (htcb->fNumPackets > 0))
+		return errNoError;
+
+	htcb->fNumPackets = 0;
+	if (!this->GetSamplePtr(sampleNumber, &sample, &sampleLength, htcb))
+		return errInvalidQuickTimeFile;
+
+	if (fPayloadType == kAAC)
+	{
+		//
+		// One access unit per packet, fragmented if it doesn't fit.
+		UInt32 maxLength = kMaxPayloadSize - kAUHeaderLength;
+		if (sampleLength <= maxLength)
+		{
+			AddPacket(htcb, 0, 0, sampleLength, 1, kNotFragmented);
+		}
+		else
+		{
+			for (UInt32 offset = 0; offset < sampleLength; offset += maxLength)
+			{
+				UInt32 length = ((sampleLength - offset) > maxLength) ? maxLength : (sampleLength - offset);
+				UInt8 fragment = (offset == 0) ? kFirstFragment : ((offset + length == sampleLength) ? kLastFragment : kMiddleFragment);
+				AddPacket(htcb, 0, offset, length, 1, fragment);
+			}
+		}
+
+		return errNoError;
+	}
+
+	//
+	// Walk the length prefixed NAL units. Small units are aggregated into the
+	// previous packet while they fit, big ones are split into fragments.
+	UInt32      headerSize = this->GetPayloadHeaderSize();
+	UInt32      pos = 0;
+	bool        canAggregate = false;
+
+	while (pos + fNALLengthSize <= sampleLength)
+	{
+		UInt32 nalLength = this->GetNALLength(sample + pos);
+		UInt32 nalOffset = pos + fNALLengthSize;
+
+		if (nalLength > sampleLength - nalOffset)
+		{
+			DEBUG_PRINT(("QTPacketizerTrack::PlanPackets - Bad NAL length in sample %" _U32BITARG_ ".\n", sampleNumber));
+			break;
+		}
+
+		if (nalLength <= headerSize)
+		{
+			pos = nalOffset + nalLength;
+			canAggregate = false;
+			continue;
+		}
+
+		if (nalLength <= kMaxPayloadSize)
+		{
+			if (canAggregate)
+			{
+				QTPacketizerTrack_Packet* last = &htcb->fPackets[htcb->fNumPackets - 1];
+
+				//
+				// An aggregation packet replaces each length prefix with a
+				// 16 bit size and adds its own payload header.
+				UInt32 aggregateLength = headerSize
+					+ (last->fLength - (last->fNumNALUnits * fNALLengthSize)) + (last->fNumNALUnits * 2)
+					+ 2 + nalLength;
+
+				if (aggregateLength <= kMaxPayloadSize)
+				{
+					last->fLength = (nalOffset + nalLength) - last->fOffset;
+					last->fNumNALUnits++;
+					pos = nalOffset + nalLength;
+					continue;
+				}
+			}
+
+			AddPacket(htcb, nalOffset, pos, fNALLengthSize + nalLength, 1, kNotFragmented);
+			canAggregate = true;
+		}
+		else
+		{
+			//
+			// Fragments carry the NAL unit without its header, which is
+			// rebuilt into the FU headers.
+			UInt32 maxLength = kMaxPayloadSize - (headerSize + 1);
+			UInt32 bodyOffset = nalOffset + headerSize;
+			UInt32 bodyEnd = nalOffset + nalLength;
+			while (bodyOffset < bodyEnd)
+			{
+				UInt32 length = ((bodyEnd - bodyOffset) > maxLength) ? maxLength : (bodyEnd - bodyOffset);
+				UInt8 fragment = (bodyOffset == nalOffset + headerSize) ? kFirstFragment : ((bodyOffset + length == bodyEnd) ? kLastFragment : kMiddleFragment);
+				AddPacket(htcb, nalOffset, bodyOffset, length, 1, fragment);
+				bodyOffset += length;
+			}
+			canAggregate = false;
+		}
+
+		pos = nalOffset + nalLength;
+	}
+
+	return errNoError;
+}
+
+QTTrack::ErrorCode QTPacketizerTrack::GetNumPackets(UInt32 sampleNumber, UInt16 * numPackets, QTHintTrack_HintTrackControlBlock * htcb)
+{
+	Assert(htcb != NULL);
+
+	QTTrack::ErrorCode err = this->PlanPackets(sampleNumber, htcb);
+	if (err != errNoError)
+		return err;
+
+	if (htcb->fNumPackets > 0xFFFF)
+		return errInvalidQuickTimeFile;
+
+	*numPackets = (UInt16)htcb->fNumPackets;
+	return errNoError;
+}
+
+QTTrack::ErrorCode QTPacketizerTrack::GetPacket(UInt32 sampleNumber, UInt16 packetNumber, char * buffer, UInt32 * length
+	, Float64 * transmitTime, bool dropBFrames, bool /*dropRepeatPackets*/, UInt32 ssrc, QTHintTrack_HintTrackControlBlock * htcb)
+{
+	// Temporary vars
+	UInt16      tempInt16;
+	UInt32      tempInt32;
+
+	// General vars
+	UInt32      mediaTime, mediaTimeOffset = 0;
+	UInt32      rtpTimestamp;
+	Float64     timeScale = 1.0;
+	char        *sample;
+	char        *pPacketOutBuf;
+	QTTrack::ErrorCode  err;
+
+	Assert(htcb != NULL);
+
+	DEEP_DEBUG_PRINT(("QTPacketizerTrack::GetPacket - Building packet #%u in sample %" _U32BITARG_ ".\n", packetNumber, sampleNumber));
+
+	err = this->PlanPackets(sampleNumber, htcb);
+	if (err != errNoError)
+		return err;
+
+	if ((packetNumber == 0) || (packetNumber > htcb->fNumPackets))
+		return errInvalidQuickTimeFile;
+
+	QTPacketizerTrack_Packet* packet = &htcb->fPackets[packetNumber - 1];
+	sample = htcb->fCachedSample;
+
+	//
+	// Get the RTP timestamp for this sample. It is the presentation time, so
+	// it includes the composition offset when the track has one.
+	if (!this->GetSampleMediaTime(sampleNumber, &mediaTime, &htcb->fsttsSTCB))
+		return errInvalidQuickTimeFile;
+	(void)this->GetSampleMediaTimeOffset(sampleNumber, &mediaTimeOffset, &htcb->fcttsSTCB);
+
+	if (fRTPTimescale != this->GetTimeScale())
+		timeScale = (Float64)fRTPTimescale * (Float64)GetTimeScaleRecip();
+
+	rtpTimestamp = (UInt32)((Float64)(mediaTime + mediaTimeOffset) * timeScale);
+	rtpTimestamp += fFirstRTPTimestamp;
+
+	//
+	// Add the first edit's media time.
+	mediaTime += this->GetFirstEditMediaTime();
+	*transmitTime = mediaTime * fMediaHeaderAtom->GetTimeScaleRecip();
+
+	//
+	// Non-reference H.264 pictures (nal_ref_idc of 0) are what thinning drops.
+	if (dropBFrames && (fPayloadType == kH264))
+	{
+		bool isReference = false;
+		if (packet->fFragment != kNotFragmented)
+		{
+			isReference = (sample[packet->fNALOffset] & 0x60) != 0;
+		}
+		else
+		{
+			for (UInt32 pos = packet->fOffset; pos < packet->fOffset + packet->fLength; pos += fNALLengthSize + this->GetNALLength(sample + pos))
+				isReference |= (sample[pos + fNALLengthSize] & 0x60) != 0;
+		}
+
+		if (!isReference)
+			return QTTrack::errIsSkippedPacket;
+	}
+
+	//
+	// Size the payload and make sure it fits.
+	UInt32 payloadLength;
+	if (fPayloadType == kAAC)
+		payloadLength = kAUHeaderLength + packet->fLength;
+	else if (packet->fFragment != kNotFragmented)
+		payloadLength = this->GetPayloadHeaderSize() + 1 + packet->fLength;
+	else if (packet->fNumNALUnits == 1)
+		payloadLength = packet->fLength - fNALLengthSize;
+	else
+		payloadLength = this->GetPayloadHeaderSize() + packet->fLength - (packet->fNumNALUnits * fNALLengthSize) + (packet->fNumNALUnits * 2);
+
+	if (kRTPHeaderLength + payloadLength > *length)
+		return errInvalidQuickTimeFile;
+
+	pPacketOutBuf = buffer;
+
+	//
+	// Add in the RTP header. The marker is set on the last packet of a sample.
+	bool isLastPacket = (packetNumber == htcb->fNumPackets);
+	tempInt16 = htons((UInt16)(0x8000 | (isLastPacket ? 0x0080 : 0) | kRTPPayloadType));
+	COPY_WORD(pPacketOutBuf, &tempInt16);
+	pPacketOutBuf += 2;
+
+	tempInt16 = htons(htcb->fNextSequenceNumber++);
+	COPY_WORD(pPacketOutBuf, &tempInt16);
+	pPacketOutBuf += 2;
+
+	tempInt32 = htonl(rtpTimestamp);
+	COPY_LONG_WORD(pPacketOutBuf, &tempInt32);
+	pPacketOutBuf += 4;
+
+	tempInt32 = htonl(ssrc);
+	COPY_LONG_WORD(pPacketOutBuf, &tempInt32);
+	pPacketOutBuf += 4;
+
+	//
+	// Add in the payload.
+	if (fPayloadType == kAAC)
+	{
+		// AU-headers-length in bits, then a 13 bit AU-size and 3 bit AU-Index.
+		// A fragment's AU-size is that of the whole access unit.
+		tempInt16 = htons(16);
+		COPY_WORD(pPacketOutBuf, &tempInt16);
+		pPacketOutBuf += 2;
+
+		tempInt16 = htons((UInt16)(htcb->fCachedSampleLength << 3));
+		COPY_WORD(pPacketOutBuf, &tempInt16);
+		pPacketOutBuf += 2;
+
+		::memcpy(pPacketOutBuf, sample + packet->fOffset, packet->fLength);
+	}
+	else if (packet->fFragment != kNotFragmented)
+	{
+		char* nalHeader = sample + packet->fNALOffset;
+		UInt8 fuHeader = (packet->fFragment == kFirstFragment) ? 0x80 : ((packet->fFragment == kLastFragment) ? 0x40 : 0x00);
+
+		if (fPayloadType == kH264)
+		{
+			*pPacketOutBuf++ = (char)((nalHeader[0] & 0xe0) | kH264NALTypeFUA);
+			*pPacketOutBuf++ = (char)(fuHeader | (nalHeader[0] & 0x1f));
+		}
+		else
+		{
+			*pPacketOutBuf++ = (char)((nalHeader[0] & 0x81) | (kH265NALTypeFU << 1));
+			*pPacketOutBuf++ = nalHeader[1];
+			*pPacketOutBuf++ = (char)(fuHeader | ((nalHeader[0] >> 1) & 0x3f));
+		}
+
+		::memcpy(pPacketOutBuf, sample + packet->fOffset, packet->fLength);
+	}
+	else if (packet->fNumNALUnits == 1)
+	{
+		::memcpy(pPacketOutBuf, sample + packet->fOffset + fNALLengthSize, packet->fLength - fNALLengthSize);
+	}
+	else
+	{
+		char* firstNAL = sample + packet->fOffset + fNALLengthSize;
+
+		if (fPayloadType == kH264)
+		{
+			// STAP-A, with the highest nal_ref_idc and any forbidden bit of its units
+			UInt8 stapHeader = kH264NALTypeSTAPA;
+			for (UInt32 pos = packet->fOffset; pos < packet->fOffset + packet->fLength; pos += fNALLengthSize + this->GetNALLength(sample + pos))
+			{
+				UInt8 nalHeader = (UInt8)sample[pos + fNALLengthSize];
+				stapHeader |= nalHeader & 0x80;
+				if ((nalHeader & 0x60) > (stapHeader & 0x60))
+					stapHeader = (stapHeader & ~0x60) | (nalHeader & 0x60);
+			}
+			*pPacketOutBuf++ = (char)stapHeader;
+		}
+		else
+		{
+			*pPacketOutBuf++ = (char)((firstNAL[0] & 0x81) | (kH265NALTypeAP << 1));
+			*pPacketOutBuf++ = firstNAL[1];
+		}
+
+		for (UInt32 pos = packet->fOffset; pos < packet->fOffset + packet->fLength; )
+		{
+			UInt32 nalLength = this->GetNALLength(sample + pos);
+			tempInt16 = htons((UInt16)nalLength);
+			COPY_WORD(pPacketOutBuf, &tempInt16);
+			pPacketOutBuf += 2;
+
+			::memcpy(pPacketOutBuf, sample + pos + fNALLengthSize, nalLength);
+			pPacketOutBuf += nalLength;
+			pos += fNALLengthSize + nalLength;
+		}
+	}
+
+	*length = kRTPHeaderLength + payloadLength;
+
+	DEEP_DEBUG_PRINT(("QTPacketizerTrack::GetPacket - ..rtpTimestamp=%" _U32BITARG_ "; length=%" _U32BITARG_ "; transmitTime=%.2f\n", rtpTimestamp, *length, *transmitTime));
+
+	return errNoError;
+}
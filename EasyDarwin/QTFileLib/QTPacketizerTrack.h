@@ -0,0 +1,123 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+	Author: Fantasy@EasyDarwin.org
+*/
+//
+// QTPacketizerTrack:
+//   Streams a media track that has no hint track by packetizing its samples
+//   as they are sent. H.264 goes out per RFC 6184 (single NAL, STAP-A, FU-A),
+//   H.265 per RFC 7798 (single NAL, AP, FU) and AAC per RFC 3640 (AAC-hbr).
+//
+//   To QTRTPFile it looks like a hint track whose samples are the media
+//   samples, so seeking, thinning and the HTCB sample table caches all work
+//   the same way.
+
+#ifndef QTPacketizerTrack_H
+#define QTPacketizerTrack_H
+
+
+//
+// Includes
+#include "QTHintTrack.h"
+
+
+//
+// One packet of the sample in an HTCB's fCachedSample
+struct QTPacketizerTrack_Packet {
+	UInt32      fNALOffset;     // the NAL unit a fragment belongs to
+	UInt32      fOffset;        // bytes of the sample this packet carries
+	UInt32      fLength;
+	UInt16      fNumNALUnits;   // more than one for an aggregation packet
+	UInt8       fFragment;
+};
+
+
+//
+// QTPacketizerTrack class
+class QTPacketizerTrack : public QTHintTrack {
+
+public:
+	//
+	// Class constants
+	enum PayloadType {
+		kUnsupported = 0,
+		kH264 = 1,
+		kH265 = 2,
+		kAAC = 3
+	};
+
+	enum {
+		kNotFragmented = 0,
+		kFirstFragment = 1,
+		kMiddleFragment = 2,
+		kLastFragment = 3
+	};
+
+	enum {
+		kMaxPayloadSize = 1400,
+		kRTPPayloadType = 96
+	};
+
+	//
+	// Returns the payload type we would use for this trak, or kUnsupported.
+	static PayloadType  GetPayloadType(QTFile * File, QTFile::AtomTOCEntry * trakAtom);
+
+	//
+	// Constructors and destructor.
+	QTPacketizerTrack(QTFile * File, QTFile::AtomTOCEntry * trakAtom, PayloadType inPayloadType,
+		bool Debug = false, bool DeepDebug = false);
+	virtual             ~QTPacketizerTrack();
+
+
+	//
+	// Initialization functions.
+	virtual ErrorCode   Initialize();
+
+	//
+	// Accessors.
+	virtual ErrorCode   GetSDPFileLength(int * Length);
+	virtual char *      GetSDPFile(int * Length);
+
+	virtual UInt64      GetTotalRTPBytes() { return fTotalRTPBytes; }
+
+	//
+	// Packet functions
+	virtual ErrorCode   GetNumPackets(UInt32 SampleNumber, UInt16 * NumPackets,
+		QTHintTrack_HintTrackControlBlock * HTCB = NULL);
+
+	virtual ErrorCode   GetPacket(UInt32 SampleNumber, UInt16 PacketNumber,
+		char * Buffer, UInt32 * Length,
+		Float64 * TransmitTime,
+		bool dropBFrames,
+		bool dropRepeatPackets = false,
+		UInt32 SSRC = 0,
+		QTHintTrack_HintTrackControlBlock * HTCB = NULL);
+
+protected:
+	//
+	// Protected member functions.
+	bool        ParseSampleDescription(char * sampleDescription, UInt32 sampleDescriptionLength);
+	void        BuildSDP(const char * fmtpLine);
+
+	ErrorCode   PlanPackets(UInt32 sampleNumber, QTHintTrack_HintTrackControlBlock * htcb);
+	void        AddPacket(QTHintTrack_HintTrackControlBlock * htcb, UInt32 nalOffset, UInt32 offset, UInt32 length, UInt16 numNALUnits, UInt8 fragment);
+
+	inline UInt32   GetNALLength(char * nalLengthPtr);
+	inline UInt32   GetPayloadHeaderSize() { return (fPayloadType == kH265) ? 2 : 1; }
+
+	//
+	// Protected member variables.
+	PayloadType         fPayloadType;
+	UInt32              fNALLengthSize;
+	UInt32              fChannels;
+
+	char                *fSDP;
+	UInt32              fSDPLength;
+
+	UInt64              fTotalRTPBytes;
+};
+
+#endif // QTPacketizerTrack_H
@@ -36,12 +36,14 @@
 #include "SafeStdLib.h"
 #include <string.h>
 
+#include "OS.h"
 #include "OSMutex.h"
 
 #include "QTFile.h"
 
 #include "QTTrack.h"
 #include "QTHintTrack.h"
+#include "QTFileIndex.h"
 
 #include "QTRTPFile.h"
 
@@ -74,271 +76,343 @@ const RTPMetaInfoPacket::FieldID QTRTPFile::kMetaInfoFields[] =
 // -------------------------------------
 // Protected cache functions and variables.
 //
-OSMutex                         *QTRTPFile::gFileCacheMutex,
-*QTRTPFile::gFileCacheAddMutex;
-QTRTPFile::RTPFileCacheEntry    *QTRTPFile::gFirstFileCacheEntry = NULL;
+// Parsed movies are hashed by path. An entry stays in the table while it is
+// open and, after its last close, waits in the LRU until the cache needs the
+// room. An entry whose file has a new mod date or length is dropped.
+//
+class QTRTPFileCacheKey
+{
+public:
+
+	QTRTPFileCacheKey(const char* inFilename)
+		: fFilename(inFilename), fHashValue(0)
+	{
+		for (const char* theChar = inFilename; *theChar != '\0'; theChar++)
+			fHashValue = (fHashValue * 31) + (UInt8)*theChar;
+	}
+	QTRTPFileCacheKey(QTRTPFile::RTPFileCacheEntry* inEntry)
+		: fFilename(inEntry->fFilename), fHashValue(inEntry->fHashValue) {}
+
+	UInt32  GetHashKey() { return fHashValue; }
+
+	bool operator==(const QTRTPFileCacheKey& inKey) const
+	{
+		return (fHashValue == inKey.fHashValue) && (::strcmp(fFilename, inKey.fFilename) == 0);
+	}
+
+private:
+
+	const char* fFilename;
+	UInt32      fHashValue;
+};
+
+static const UInt32 kFileCacheTableSize = 1024;
+static const UInt64 kDefaultFileCacheMaxBytes = 64 * 1024 * 1024;
+
+OSMutex                         *QTRTPFile::gFileCacheMutex = NULL;
+OSHashTable<QTRTPFile::RTPFileCacheEntry, QTRTPFileCacheKey> *QTRTPFile::gFileCacheTable = NULL;
+OSQueue                         *QTRTPFile::gFileCacheLRU = NULL;
+UInt64                          QTRTPFile::gFileCacheBytes = 0;
+UInt64                          QTRTPFile::gFileCacheMaxBytes = kDefaultFileCacheMaxBytes;
+UInt64                          QTRTPFile::gFileCacheOpens = 0;
+UInt64                          QTRTPFile::gFileCacheHits = 0;
+SInt64                          QTRTPFile::gFileCacheOpenMicros = 0;
 
 void QTRTPFile::Initialize()
 {
+	if (QTRTPFile::gFileCacheMutex != NULL)
+		return;
+
 	QTRTPFile::gFileCacheMutex = new OSMutex();
-	QTRTPFile::gFileCacheAddMutex = new OSMutex();
+	QTRTPFile::gFileCacheTable = new OSHashTable<QTRTPFile::RTPFileCacheEntry, QTRTPFileCacheKey>(kFileCacheTableSize);
+	QTRTPFile::gFileCacheLRU = new OSQueue();
+}
+
+void QTRTPFile::SetFileCacheSize(UInt32 inMaxMBytes)
+{
+	OSMutexLocker       fileCacheMutex(QTRTPFile::gFileCacheMutex);
+
+	QTRTPFile::gFileCacheMaxBytes = (UInt64)inMaxMBytes << 20;
+	QTRTPFile::TrimFileCache();
 }
 
+QTRTPFile::ErrorCode QTRTPFile::PrewarmFileCache(const char * filePath)
+{
+	QTRTPFile::RTPFileCacheEntry    *fileCacheEntry = NULL;
+
+	ErrorCode rc = QTRTPFile::new_QTFile(filePath, &fileCacheEntry);
+	if (rc == errNoError)
+		QTRTPFile::delete_QTFile(fileCacheEntry);
+
+	return rc;
+}
+
+Float32 QTRTPFile::GetFileCacheHitPercent()
+{
+	if (QTRTPFile::gFileCacheMutex == NULL)
+		return 0;
+
+	OSMutexLocker       fileCacheMutex(QTRTPFile::gFileCacheMutex);
+	if (QTRTPFile::gFileCacheOpens == 0)
+		return 0;
+
+	return (Float32)(((Float64)QTRTPFile::gFileCacheHits * 100) / (Float64)QTRTPFile::gFileCacheOpens);
+}
+
+Float32 QTRTPFile::GetFileCacheAvgOpenMsec()
+{
+	if (QTRTPFile::gFileCacheMutex == NULL)
+		return 0;
+
+	OSMutexLocker       fileCacheMutex(QTRTPFile::gFileCacheMutex);
+	if (QTRTPFile::gFileCacheOpens == 0)
+		return 0;
+
+	return (Float32)(((Float64)QTRTPFile::gFileCacheOpenMicros / 1000) / (Float64)QTRTPFile::gFileCacheOpens);
+}
 
-QTRTPFile::ErrorCode QTRTPFile::new_QTFile(const char * filePath, QTFile ** theQTFile, bool debugFlag, bool deepDebugFlag)
+UInt64 QTRTPFile::GetFileCacheBytes()
+{
+	if (QTRTPFile::gFileCacheMutex == NULL)
+		return 0;
+
+	OSMutexLocker       fileCacheMutex(QTRTPFile::gFileCacheMutex);
+	return QTRTPFile::gFileCacheBytes;
+}
+
+
+QTRTPFile::ErrorCode QTRTPFile::new_QTFile(const char * filePath, QTRTPFile::RTPFileCacheEntry ** fileCacheEntry, bool debugFlag, bool deepDebugFlag)
 {
 	// Temporary vars
 	QTFile::ErrorCode   rcFile;
+	ErrorCode           rc = errNoError;
 
 	// General vars
-	OSMutexLocker       fileCacheAddMutex(QTRTPFile::gFileCacheAddMutex);
+	SInt64              startTime = OS::Microseconds();
+	SInt64              modDate = 0;
+	UInt64              length = 0;
+	UInt32              memSize = 0;
+	QTFile              *theQTFile;
+	QTFile::AtomTOCEntry    *moovTOCEntry;
 
-	QTRTPFile::RTPFileCacheEntry    *fileCacheEntry;
+	QTRTPFile::RTPFileCacheEntry    *listEntry;
 
 
 	//
-	// Find and return the QTFile object out of our cache, if it exists.
-	if (QTRTPFile::FindAndRefcountFileCacheEntry(filePath, &fileCacheEntry))
+	// A cached movie is only good for the version of the file it was parsed from.
+	struct stat fileStat;
+	if (::stat(filePath, &fileStat) == 0)
 	{
-		fileCacheAddMutex.Unlock();
-
-		fileCacheEntry->InitMutex->Lock();  // Guaranteed to block as the mutex
-											// is acquired before it is added to
-											// the list.
-		fileCacheEntry->InitMutex->Unlock();// Because we don't actually need it.
+		modDate = (SInt64)fileStat.st_mtime;
+		length = (UInt64)fileStat.st_size;
+	}
 
-		*theQTFile = fileCacheEntry->File;
-		Assert(*theQTFile);
+	OSMutexLocker       fileCacheMutex(QTRTPFile::gFileCacheMutex);
+	QTRTPFileCacheKey   key(filePath);
 
-		return errNoError;
+	listEntry = QTRTPFile::gFileCacheTable->Map(&key);
+	if ((listEntry != NULL) && ((listEntry->fModDate != modDate) || (listEntry->fLength != length)))
+	{
+		QTRTPFile::RemoveFileFromCache(listEntry);
+		listEntry = NULL;
 	}
 
+	QTRTPFile::gFileCacheOpens++;
 
-	//
-	// Construct our file object.
-	*theQTFile = new QTFile(debugFlag, deepDebugFlag);
-	if (*theQTFile == NULL)
-		return errInternalError;
 
 	//
-	// Open the specified movie.
-	if ((rcFile = (*theQTFile)->Open(filePath)) != QTFile::errNoError)
+	// Find and return the QTFile object out of our cache, if it exists.
+	if (listEntry != NULL)
 	{
-		delete *theQTFile;
+		QTRTPFile::gFileCacheHits++;
+		if (listEntry->ReferenceCount++ == 0)
+			QTRTPFile::gFileCacheLRU->Remove(&listEntry->fLRUElem);
 
-		switch (rcFile)
-		{
-		case errFileNotFound:
-			return errFileNotFound;
+		fileCacheMutex.Unlock();
 
-		case errInvalidQuickTimeFile:
-			return errInvalidQuickTimeFile;
+		listEntry->InitMutex->Lock();   // Blocks until the opener that added the
+										// entry is done parsing the movie.
+		listEntry->InitMutex->Unlock(); // Because we don't actually need it.
 
-		default:
-			return errInternalError;
+		if (listEntry->File == NULL)
+		{
+			rc = listEntry->fInitErr;
+			QTRTPFile::delete_QTFile(listEntry);
 		}
-	}
-
+		else
+			*fileCacheEntry = listEntry;
 
-	//
-	// Add this file to our cache and release the global add mutex.
-	QTRTPFile::AddFileToCache(filePath, &fileCacheEntry); // Grabs InitMutex.
-	fileCacheAddMutex.Unlock();
+		fileCacheMutex.Lock();
+		QTRTPFile::gFileCacheOpenMicros += OS::Microseconds() - startTime;
+		return rc;
+	}
 
 
 	//
-	// Finish setting up the fileCacheEntry.
-	if (fileCacheEntry != NULL)
-	{   // it may not have been cached..
-		fileCacheEntry->File = *theQTFile;
-		fileCacheEntry->InitMutex->Unlock();
-	}
+	// Add an entry for this file and hold its InitMutex while we parse the
+	// movie, so other opens of the same file wait for us instead of parsing it too.
+	listEntry = new QTRTPFile::RTPFileCacheEntry();
+	listEntry->InitMutex = new OSMutex();
+	listEntry->InitMutex->Lock();
 
-	//
-	// Return the file object.
-	return errNoError;
-}
+	listEntry->fFilename = new char[(::strlen(filePath) + 1)];
+	::strcpy(listEntry->fFilename, filePath);
+	listEntry->File = NULL;
+	listEntry->fIndex = NULL;
+	listEntry->fInitErr = errNoError;
+	listEntry->fModDate = modDate;
+	listEntry->fLength = length;
+	listEntry->fMemSize = 0;
 
+	listEntry->ReferenceCount = 1;
+	listEntry->fInTable = true;
 
-void QTRTPFile::delete_QTFile(QTFile * theQTFile)
-{
+	listEntry->fHashValue = key.GetHashKey();
+	listEntry->fNextHashEntry = NULL;
+	listEntry->fLRUElem.SetEnclosingObject(listEntry);
 
-	// General vars
-	OSMutexLocker                   fileCacheMutex(QTRTPFile::gFileCacheMutex);
-	QTRTPFile::RTPFileCacheEntry    *listEntry;
+	QTRTPFile::gFileCacheTable->Add(listEntry);
+	fileCacheMutex.Unlock();
 
 
 	//
-	// Find the specified cache entry.
-	for (listEntry = QTRTPFile::gFirstFileCacheEntry; listEntry != NULL; listEntry = listEntry->NextEntry)
+	// Construct our file object and open the specified movie.
+	theQTFile = new QTFile(debugFlag, deepDebugFlag);
+	if ((rcFile = theQTFile->Open(filePath)) != QTFile::errNoError)
 	{
-		//
-		// Check for matches.
-		if (listEntry->File != theQTFile)
-			continue;
+		delete theQTFile;
 
-		theQTFile->DecBufferUserCount();
-		//
-		// Delete the object if the reference count has dropped to zero.
-		if (--listEntry->ReferenceCount == 0)
+		switch (rcFile)
 		{
-			//
-			// Delete the file.
-			if (theQTFile != NULL)
-			{
-				delete theQTFile;
-			}
+		case QTFile::errFileNotFound:
+			rc = errFileNotFound;
+			break;
 
-			//
-			// Free our other vars.
-			if (listEntry->InitMutex != NULL)
-				delete listEntry->InitMutex;
+		case QTFile::errInvalidQuickTimeFile:
+			rc = errInvalidQuickTimeFile;
+			break;
 
-			if (listEntry->fFilename != NULL)
-				delete[] listEntry->fFilename;
+		default:
+			rc = errInternalError;
+			break;
+		}
 
-			//
-			// Remove this entry from the list.
-			if (listEntry->PrevEntry != NULL)
-				listEntry->PrevEntry->NextEntry = listEntry->NextEntry;
+		listEntry->fInitErr = rc;
 
-			if (listEntry->NextEntry != NULL)
-				listEntry->NextEntry->PrevEntry = listEntry->PrevEntry;
+		fileCacheMutex.Lock();
+		QTRTPFile::RemoveFileFromCache(listEntry);
+		fileCacheMutex.Unlock();
 
-			if (QTRTPFile::gFirstFileCacheEntry == listEntry)
-				QTRTPFile::gFirstFileCacheEntry = listEntry->NextEntry;
+		listEntry->InitMutex->Unlock();
+		QTRTPFile::delete_QTFile(listEntry);
+	}
+	else
+	{
+		//
+		// Index the hint tracks for seeking while other opens still wait for us.
+		listEntry->fIndex = QTFileIndex::Load(theQTFile, filePath, modDate, length);
 
-			delete listEntry;
+		//
+		// The parsed sample tables take about as much memory as the moov atom.
+		memSize = sizeof(QTFile) + ::strlen(filePath);
+		if (theQTFile->FindTOCEntry("moov", &moovTOCEntry))
+			memSize += (UInt32)moovTOCEntry->AtomDataLength;
+		if (listEntry->fIndex != NULL)
+			memSize += listEntry->fIndex->GetLength();
+
+		listEntry->File = theQTFile;
+
+		fileCacheMutex.Lock();
+		if (listEntry->fInTable)
+		{
+			listEntry->fMemSize = memSize;
+			QTRTPFile::gFileCacheBytes += memSize;
 		}
+		fileCacheMutex.Unlock();
 
-		//
-		// Return.
-		return;
+		listEntry->InitMutex->Unlock();
+		*fileCacheEntry = listEntry;
 	}
 
-	//
-	// The object was not in the cache.  Delete it
-	if (theQTFile != NULL)
-	{
-		delete theQTFile;
-	}
+	fileCacheMutex.Lock();
+	QTRTPFile::gFileCacheOpenMicros += OS::Microseconds() - startTime;
+	return rc;
 }
 
 
-void QTRTPFile::AddFileToCache(const char *inFilename, QTRTPFile::RTPFileCacheEntry ** newListEntry)
+void QTRTPFile::delete_QTFile(QTRTPFile::RTPFileCacheEntry * listEntry)
 {
-	// General vars
-	OSMutexLocker                   fileCacheMutex(QTRTPFile::gFileCacheMutex);
-	QTRTPFile::RTPFileCacheEntry*   listEntry;
-	QTRTPFile::RTPFileCacheEntry*   lastListEntry;
+	if (listEntry == NULL)
+		return;
 
+	OSMutexLocker                   fileCacheMutex(QTRTPFile::gFileCacheMutex);
 
-	//
-	// Add this track object to our track list.
-	(*newListEntry) = new QTRTPFile::RTPFileCacheEntry();
-	if ((*newListEntry) == NULL)
+	if (--listEntry->ReferenceCount > 0)
 		return;
 
-	(*newListEntry)->InitMutex = new OSMutex();
-	if ((*newListEntry)->InitMutex == NULL) {
-		delete (*newListEntry);
-		*newListEntry = NULL;
+	if (!listEntry->fInTable)
+	{
+		QTRTPFile::DeleteFileCacheEntry(listEntry);
 		return;
 	}
-	(*newListEntry)->InitMutex->Lock();
 
-	(*newListEntry)->fFilename = new char[(::strlen(inFilename) + 2)];
-	::strcpy((*newListEntry)->fFilename, inFilename);
-	(*newListEntry)->File = NULL;
+	//
+	// Keep the parsed movie for the next open. The least recently closed
+	// movies are the first to go when the cache is full.
+	QTRTPFile::gFileCacheLRU->EnQueue(&listEntry->fLRUElem);
+	QTRTPFile::TrimFileCache();
+}
 
-	(*newListEntry)->ReferenceCount = 1;
 
-	(*newListEntry)->PrevEntry = NULL;
-	(*newListEntry)->NextEntry = NULL;
+void QTRTPFile::RemoveFileFromCache(QTRTPFile::RTPFileCacheEntry * listEntry)
+{
+	// Called with gFileCacheMutex held. Entries still in use are deleted on their last release.
+	if (!listEntry->fInTable)
+		return;
 
-	//
-	// Make this the first entry if there are no entries, otherwise we need to
-	// find out where this file fits in the list and insert it there.
-	if (QTRTPFile::gFirstFileCacheEntry == NULL)
+	QTRTPFile::gFileCacheTable->Remove(listEntry);
+	listEntry->fInTable = false;
+
+	QTRTPFile::gFileCacheBytes -= listEntry->fMemSize;
+	listEntry->fMemSize = 0;
+
+	if (listEntry->ReferenceCount == 0)
 	{
-		QTRTPFile::gFirstFileCacheEntry = (*newListEntry);
+		QTRTPFile::gFileCacheLRU->Remove(&listEntry->fLRUElem);
+		QTRTPFile::DeleteFileCacheEntry(listEntry);
 	}
-	else
-	{
-		//
-		// Go through the cache list until we find an inode number greater than
-		// the one that we have now.  Insert it in the list when we find this.
-		for (listEntry = lastListEntry = QTRTPFile::gFirstFileCacheEntry; listEntry != NULL; listEntry = listEntry->NextEntry) {
-			//
-			// This is the last list entry that we saw (useful for later).
-			lastListEntry = listEntry;
-
-			//
-			// Skip this entry if this inode number is smaller than the one
-			// for our new entry.
-			if (strcmp(listEntry->fFilename, inFilename) < 0)
-				continue;
+}
 
-			//
-			// We've found a larger inode; insert this one in the list.
-			if (listEntry->PrevEntry == NULL)
-				QTRTPFile::gFirstFileCacheEntry = (*newListEntry);
-			else
-				listEntry->PrevEntry->NextEntry = (*newListEntry);
 
-			(*newListEntry)->PrevEntry = listEntry->PrevEntry;
+void QTRTPFile::DeleteFileCacheEntry(QTRTPFile::RTPFileCacheEntry * listEntry)
+{
+	if (listEntry->File != NULL)
+		delete listEntry->File;
 
-			listEntry->PrevEntry = (*newListEntry);
+	if (listEntry->fIndex != NULL)
+		delete listEntry->fIndex;
 
-			(*newListEntry)->NextEntry = listEntry;
+	if (listEntry->InitMutex != NULL)
+		delete listEntry->InitMutex;
 
-			return;
-		}
+	if (listEntry->fFilename != NULL)
+		delete[] listEntry->fFilename;
 
-		//
-		// We fell out of our loop; this means that we are the largest inode
-		// in the list; add ourselves to the end of the list.
-		if (lastListEntry == NULL) { // this can't happen, but..
-			QTRTPFile::gFirstFileCacheEntry = (*newListEntry);
-		}
-		else
-		{
-			lastListEntry->NextEntry = (*newListEntry);
-			(*newListEntry)->PrevEntry = lastListEntry;
-		}
-	}
+	delete listEntry;
 }
 
-bool QTRTPFile::FindAndRefcountFileCacheEntry(const char *inFilename, QTRTPFile::RTPFileCacheEntry **cacheEntry)
-{
-	// General vars
-	OSMutexLocker                   fileCacheMutex(QTRTPFile::gFileCacheMutex);
-	QTRTPFile::RTPFileCacheEntry    *listEntry;
-
 
-	//
-	// Find the specified cache entry.
-	for (listEntry = QTRTPFile::gFirstFileCacheEntry; listEntry != NULL; listEntry = listEntry->NextEntry)
+void QTRTPFile::TrimFileCache()
+{
+	// Called with gFileCacheMutex held.
+	while (QTRTPFile::gFileCacheBytes > QTRTPFile::gFileCacheMaxBytes)
 	{
-		//
-		// Check for matches.
-		if (::strcmp(listEntry->fFilename, inFilename) != 0)
-			continue;
-
-		//
-		// Update the reference count and set the return value.
-		listEntry->ReferenceCount++;
+		OSQueueElem* theElem = QTRTPFile::gFileCacheLRU->GetHead();
+		if (theElem == NULL)
+			break;
 
-		*cacheEntry = listEntry;
-
-		//
-		// Return.
-		return true;
+		QTRTPFile::RemoveFileFromCache((QTRTPFile::RTPFileCacheEntry*)theElem->GetEnclosingObject());
 	}
-
-	//
-	// The search failed.
-	return false;
 }
 
 
@@ -349,6 +423,7 @@ bool QTRTPFile::FindAndRefcountFileCacheEntry(const char *inFilename, QTRTPFile:
 QTRTPFile::QTRTPFile(bool debugFlag, bool deepDebugFlag)
 	: fDebug(debugFlag)
 	, fDeepDebug(deepDebugFlag)
+	, fFileCacheEntry(NULL)
 	, fFile(NULL)
 	, fFCB(NULL)
 	, fNumHintTracks(0)
@@ -399,7 +474,7 @@ QTRTPFile::~QTRTPFile()
 	if (fSDPFile != NULL)
 		delete[] fSDPFile;
 
-	this->delete_QTFile(fFile);
+	this->delete_QTFile(fFileCacheEntry);
 
 	if (fFCB != NULL)
 		delete fFCB;
@@ -421,12 +496,13 @@ QTRTPFile::ErrorCode QTRTPFile::Initialize(const char * filePath)
 
 	//
 	// Create our file object.
-	rc = this->new_QTFile(filePath, &fFile, fDebug, fDeepDebug);
+	rc = this->new_QTFile(filePath, &fFileCacheEntry, fDebug, fDeepDebug);
 	if (rc != errNoError)
 	{
-		fFile = NULL;
+		fFileCacheEntry = NULL;
 		return rc;
 	}
+	fFile = fFileCacheEntry->File;
 
 
 	//
@@ -875,13 +951,13 @@ UInt32 QTRTPFile::GetBytesPerSecond()
 }
 
 // -------------------------------------
-void QTRTPFile::AllocatePrivateBuffers(UInt32 inUnitSizeInK, UInt32 inNumBuffSizeUnits, UInt32 inMaxBitRateBuffSizeInBlocks)
+void QTRTPFile::AllocatePrivateBuffers()
 {
 
 	fFCB->EnableCacheBuffers(true);
 	UInt32 bytesPerSecond = this->GetBytesPerSecond();
 	UInt32 bitRate = bytesPerSecond * 8;
-	fFCB->AdjustDataBufferBitRate(inUnitSizeInK, bitRate, inNumBuffSizeUnits, inMaxBitRateBuffSizeInBlocks);
+	fFCB->AdjustDataBufferBitRate(bitRate);
 
 }
 
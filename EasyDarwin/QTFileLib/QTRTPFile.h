@@ -34,6 +34,8 @@
 //
 // Includes
 #include "OSHeaders.h"
+#include "OSQueue.h"
+#include "OSHashTable.h"
 #include "RTPMetaInfoPacket.h"
 #include "QTHintTrack.h"
 
@@ -51,9 +53,11 @@
 class OSMutex;
 
 class QTFile;
+class QTFileIndex;
 class QTFile_FileControlBlock;
 class QTHintTrack;
 class QTHintTrack_HintTrackControlBlock;
+class QTRTPFileCacheKey;
 
 class QTRTPFile {
 
@@ -83,14 +87,22 @@ public:
 		// File information
 		char*       fFilename;
 		QTFile      *File;
+		QTFileIndex *fIndex;        // seek index for File's hint tracks, deleted after it
+		ErrorCode   fInitErr;       // why File is NULL once InitMutex is released
+		SInt64      fModDate;       // mtime and length of the file when it was parsed
+		UInt64      fLength;
+		UInt32      fMemSize;       // estimated memory held by the parsed movie
 
 		//
 		// Reference count for this cache entry
 		int         ReferenceCount;
+		bool        fInTable;       // cleared when stale or evicted, deleted on its last release
 
 		//
-		// List pointers
-		RTPFileCacheEntry   *PrevEntry, *NextEntry;
+		// Hash table and LRU links. Only unreferenced entries are in the LRU.
+		UInt32              fHashValue;
+		RTPFileCacheEntry   *fNextHashEntry;
+		OSQueueElem         fLRUElem;
 	};
 
 	struct RTPTrackListEntry {
@@ -138,6 +150,21 @@ public:
 	// Global initialize function; CALL THIS FIRST!
 	static void         Initialize();
 
+	//
+	// Parsed movies stay cached after their last close until the cache holds more
+	// than inMaxMBytes. 0 keeps a movie only while it is open.
+	static void         SetFileCacheSize(UInt32 inMaxMBytes);
+
+	//
+	// Parses the movie into the cache ahead of its first open.
+	static ErrorCode    PrewarmFileCache(const char * FilePath);
+
+	//
+	// Cache stats since startup
+	static Float32      GetFileCacheHitPercent();
+	static Float32      GetFileCacheAvgOpenMsec();  // time Initialize spends getting the parsed movie
+	static UInt64       GetFileCacheBytes();
+
 	//
 	// Returns a static array of the RTP-Meta-Info fields supported by QTFileLib.
 	// It also returns field IDs for the fields it recommends being compressed.
@@ -154,12 +181,12 @@ public:
 	// Initialization functions.
 	virtual ErrorCode   Initialize(const char * FilePath);
 
-	void AllocateSharedBuffers(UInt32 inUnitSizeInK, UInt32 inBufferInc, UInt32 inBufferSizeUnits, UInt32 inMaxBitRateBuffSizeInBlocks)
+	void AllocateSharedBuffers()
 	{
-		fFile->AllocateBuffers(inUnitSizeInK, inBufferInc, inBufferSizeUnits, inMaxBitRateBuffSizeInBlocks, this->GetBytesPerSecond() * 8);
+		fFile->AllocateBuffers(this->GetBytesPerSecond() * 8);
 	}
 
-	void AllocatePrivateBuffers(UInt32 inUnitSizeInK, UInt32 inNumBuffSizeUnits, UInt32 inMaxBitRateBuffSizeInBlocks);
+	void AllocatePrivateBuffers();
 
 	//
 	// Accessors
@@ -236,14 +263,19 @@ public:
 protected:
 	//
 	// Protected cache functions and variables.
-	static  OSMutex             *gFileCacheMutex, *gFileCacheAddMutex;
-	static  RTPFileCacheEntry   *gFirstFileCacheEntry;
+	static  OSMutex             *gFileCacheMutex;
+	static  OSHashTable<RTPFileCacheEntry, QTRTPFileCacheKey>  *gFileCacheTable;
+	static  OSQueue             *gFileCacheLRU;
+	static  UInt64              gFileCacheBytes, gFileCacheMaxBytes;
+	static  UInt64              gFileCacheOpens, gFileCacheHits;
+	static  SInt64              gFileCacheOpenMicros;
 
-	static  ErrorCode   new_QTFile(const char * FilePath, QTFile ** File, bool Debug = false, bool DeepDebug = false);
-	static  void        delete_QTFile(QTFile * File);
+	static  ErrorCode   new_QTFile(const char * FilePath, RTPFileCacheEntry ** CacheEntry, bool Debug = false, bool DeepDebug = false);
+	static  void        delete_QTFile(RTPFileCacheEntry * CacheEntry);
 
-	static  void        AddFileToCache(const char *inFilename, QTRTPFile::RTPFileCacheEntry ** NewListEntry);
-	static  bool      FindAndRefcountFileCacheEntry(const char *inFilename, QTRTPFile::RTPFileCacheEntry **CacheEntry);
+	static  void        RemoveFileFromCache(RTPFileCacheEntry * CacheEntry);
+	static  void        DeleteFileCacheEntry(RTPFileCacheEntry * CacheEntry);
+	static  void        TrimFileCache();
 
 	//
 	// Protected member functions.
@@ -255,6 +287,7 @@ protected:
 	// Protected member variables.
 	bool              fDebug, fDeepDebug;
 
+	RTPFileCacheEntry   *fFileCacheEntry;
 	QTFile              *fFile;
 	QTFile_FileControlBlock *fFCB;
 
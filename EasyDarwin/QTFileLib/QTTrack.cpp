@@ -449,6 +449,39 @@ bool QTTrack::GetSample(UInt32 SampleNumber, char * Buffer, UInt32 * Length, QTF
 
 
 
+// -------------------------------------
+// Seek index
+//
+UInt32 QTTrack::GetIndexLength()
+{
+	Assert(fIsInitialized);
+	return (fTimeToSampleAtom->GetNumIndexEntries() * sizeof(QTAtom_stts_IndexEntry))
+		+ (fSampleToChunkAtom->GetNumIndexEntries() * sizeof(QTAtom_stsc_IndexEntry));
+}
+
+void QTTrack::BuildIndex(char * outIndex)
+{
+	Assert(fIsInitialized);
+	fTimeToSampleAtom->BuildIndex((QTAtom_stts_IndexEntry *)outIndex);
+	outIndex += fTimeToSampleAtom->GetNumIndexEntries() * sizeof(QTAtom_stts_IndexEntry);
+	fSampleToChunkAtom->BuildIndex((QTAtom_stsc_IndexEntry *)outIndex);
+}
+
+bool QTTrack::SetIndex(char * inIndex, UInt32 inLength)
+{
+	//
+	// The index must be for these tables and must be longword aligned.
+	if (!fIsInitialized || (inLength != this->GetIndexLength()) || (((PointerSizedInt)inIndex & 3) != 0))
+		return false;
+
+	fTimeToSampleAtom->SetIndex((QTAtom_stts_IndexEntry *)inIndex);
+	inIndex += fTimeToSampleAtom->GetNumIndexEntries() * sizeof(QTAtom_stts_IndexEntry);
+	fSampleToChunkAtom->SetIndex((QTAtom_stsc_IndexEntry *)inIndex);
+	return true;
+}
+
+
+
 // -------------------------------------
 // Debugging functions
 //
@@ -195,6 +195,13 @@ public:
 		else
 			return false;
 	}
+	//
+	// Seek index (see QTFileIndex), only for an initialized track. It is the
+	// stts checkpoints followed by the stsc checkpoints.
+	UInt32      GetIndexLength();
+	void        BuildIndex(char * outIndex);
+	bool        SetIndex(char * inIndex, UInt32 inLength);
+
 	//
 	// Debugging functions.
 	virtual void        DumpTrack();
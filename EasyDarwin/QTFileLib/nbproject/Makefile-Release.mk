@@ -53,6 +53,8 @@ OBJECTFILES= \
 	${OBJECTDIR}/QTFile.o \
 	${OBJECTDIR}/QTFile_FileControlBlock.o \
 	${OBJECTDIR}/QTHintTrack.o \
+	${OBJECTDIR}/QTFileIndex.o \
+	${OBJECTDIR}/QTPacketizerTrack.o \
 	${OBJECTDIR}/QTRTPFile.o \
 	${OBJECTDIR}/QTTrack.o
 
@@ -173,6 +175,16 @@ ${OBJECTDIR}/QTHintTrack.o: QTHintTrack.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -I. -I../RTPMetaInfoLib -I../RTPMetaInfoLib -I../APIStubLib -I../CommonUtilitiesLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTHintTrack.o QTHintTrack.cpp
 
+${OBJECTDIR}/QTFileIndex.o: QTFileIndex.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -I. -I../RTPMetaInfoLib -I../RTPMetaInfoLib -I../APIStubLib -I../CommonUtilitiesLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileIndex.o QTFileIndex.cpp
+
+${OBJECTDIR}/QTPacketizerTrack.o: QTPacketizerTrack.cpp 
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -I. -I../RTPMetaInfoLib -I../RTPMetaInfoLib -I../APIStubLib -I../CommonUtilitiesLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTPacketizerTrack.o QTPacketizerTrack.cpp
+
 ${OBJECTDIR}/QTRTPFile.o: QTRTPFile.cpp 
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
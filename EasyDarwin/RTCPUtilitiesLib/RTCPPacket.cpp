@@ -162,6 +162,58 @@ bool RTCPSenderReportPacket::ParseReport(UInt8* inPacketBuffer, UInt32 inPacketL
 }
 
 
+bool RTCPFeedbackPacket::ParseFeedback(UInt8* inPacketBuffer, UInt32 inPacketLength)
+{
+    bool ok = this->ParsePacket(inPacketBuffer, inPacketLength);
+    if (!ok)
+        return false;
+
+    //the header, the sender SSRC and the media source SSRC come before the FCIs
+    UInt32 thePacketLength = (this->GetPacketLength() * 4) + kRTCPHeaderSizeInBytes;
+    if (thePacketLength < kFCIOffset)
+        return false;
+
+    fNumNACKs = 0;
+    if (this->IsGenericNACK())
+        fNumNACKs = (thePacketLength - kFCIOffset) / kNACKSizeInBytes;
+
+    return true;
+}
+
+
+UInt32 RTCPFeedbackPacket::GetLostSeqNums(UInt16* outSeqNums, UInt32 inMaxSeqNums)
+{
+    UInt32 theNumSeqNums = 0;
+    for (UInt32 i = 0; i < fNumNACKs; i++)
+    {
+        UInt16 thePacketID = this->GetNACKPacketID(i);
+        UInt16 theBitmask = this->GetNACKBitmask(i);
+
+        if (theNumSeqNums == inMaxSeqNums)
+            break;
+        outSeqNums[theNumSeqNums++] = thePacketID;
+
+        //bit i of the mask is packet PID + i + 1
+        for (UInt16 theBit = 0; (theBit < 16) && (theNumSeqNums < inMaxSeqNums); theBit++)
+        {
+            if (theBitmask & (1 << theBit))
+                outSeqNums[theNumSeqNums++] = (UInt16)(thePacketID + theBit + 1);
+        }
+    }
+
+    return theNumSeqNums;
+}
+
+
+void RTCPFeedbackPacket::Dump()//Override
+{
+    RTCPPacket::Dump();
+    qtss_printf(" H_media_ssrc=%"   _U32BITARG_   "\n", this->GetMediaSSRC());
+    for (UInt32 i = 0; i < fNumNACKs; i++)
+        qtss_printf("              RTCP NACK[%"   _U32BITARG_   "] H_pid=%u H_blp=0x%04x\n", i, this->GetNACKPacketID(i), this->GetNACKBitmask(i));
+}
+
+
 void RTCPPacket::Dump()
 {  
     qtss_printf( "H_vers=%d, H_pad=%d, H_rprt_count=%d, H_type=%d, H_length=%d, H_ssrc=%" _S32BITARG_ "",
@@ -53,7 +53,9 @@ public:
 	{
 		kReceiverPacketType = 201,  //UInt32
 		kSDESPacketType = 202,  //UInt32
-		kAPPPacketType = 204   //UInt32
+		kAPPPacketType = 204,   //UInt32
+		kRTPFeedbackPacketType = 205,   //UInt32, RFC 4585 transport layer feedback
+		kPayloadFeedbackPacketType = 206    //UInt32, RFC 4585 payload specific feedback
 	};
 
 
@@ -205,6 +207,53 @@ protected:
 	};
 };
 
+// RFC 4585 feedback messages. The format (FMT) is in the report count field.
+class RTCPFeedbackPacket : public RTCPPacket
+{
+public:
+
+	enum
+	{
+		kGenericNACKFormat = 1,         // RTPFB
+		kPictureLossFormat = 1,         // PSFB, PLI
+		kFullIntraRequestFormat = 4     // PSFB, FIR
+	};
+
+	RTCPFeedbackPacket() : RTCPPacket(), fNumNACKs(0) {}
+
+	//Call this before any accessor method. Returns true if successful, false otherwise
+	bool ParseFeedback(UInt8* inPacketBuffer, UInt32 inPacketLength);
+
+	inline UInt32 GetMediaSSRC();
+
+	bool IsGenericNACK() { return (this->GetPacketType() == kRTPFeedbackPacketType) && (this->GetReportCount() == kGenericNACKFormat); }
+	bool IsKeyFrameRequest() { return (this->GetPacketType() == kPayloadFeedbackPacketType) && ((this->GetReportCount() == kPictureLossFormat) || (this->GetReportCount() == kFullIntraRequestFormat)); }
+
+	// Each generic NACK names a lost packet and, in a bitmask, which of the 16 after it are lost too
+	UInt32 GetNumNACKs() { return fNumNACKs; }
+	inline UInt16 GetNACKPacketID(UInt32 inNACKNum);
+	inline UInt16 GetNACKBitmask(UInt32 inNACKNum);
+
+	// Puts the sequence numbers of the lost packets in outSeqNums, at most inMaxSeqNums
+	// of them. Returns how many there are.
+	UInt32 GetLostSeqNums(UInt16* outSeqNums, UInt32 inMaxSeqNums);
+
+	virtual void Dump(); //Override
+
+private:
+
+	UInt32 fNumNACKs;
+
+	enum
+	{
+		kMediaSourceIDOffset = 8,
+		kFCIOffset = 12,
+		kNACKSizeInBytes = 4,
+		kNACKPacketIDOffset = 0,
+		kNACKBitmaskOffset = 2
+	};
+};
+
 
 /**************  RTCPPacket  inlines **************/
 inline int RTCPPacket::GetVersion()
@@ -297,6 +346,22 @@ inline UInt32 RTCPReceiverPacket::GetLastSenderReportDelay(int inReportNum)
 	return (UInt32)ntohl(*(UInt32*)&fRTCPReceiverReportArray[this->RecordOffset(inReportNum) + kLastSenderReportDelayOffset]);
 }
 
+/**************  RTCPFeedbackPacket  inlines **************/
+inline UInt32 RTCPFeedbackPacket::GetMediaSSRC()
+{
+	return (UInt32)ntohl(*(UInt32*)&fReceiverPacketBuffer[kMediaSourceIDOffset]);
+}
+
+inline UInt16 RTCPFeedbackPacket::GetNACKPacketID(UInt32 inNACKNum)
+{
+	return (UInt16)ntohs(*(UInt16*)&fReceiverPacketBuffer[kFCIOffset + (inNACKNum * kNACKSizeInBytes) + kNACKPacketIDOffset]);
+}
+
+inline UInt16 RTCPFeedbackPacket::GetNACKBitmask(UInt32 inNACKNum)
+{
+	return (UInt16)ntohs(*(UInt16*)&fReceiverPacketBuffer[kFCIOffset + (inNACKNum * kNACKSizeInBytes) + kNACKBitmaskOffset]);
+}
+
 
 /*
 Receiver Report
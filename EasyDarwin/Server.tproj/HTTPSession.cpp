@@ -11,6 +11,7 @@
 
 #include "HTTPSession.h"
 #include "QTSServerInterface.h"
+#include "ReflectorSessionCatalog.h"
 #include "OSArrayObjectDeleter.h"
 #include "QTSSMemoryDeleter.h"
 #include "QueryParamList.h"
@@ -303,7 +304,7 @@ SInt64 HTTPSession::Run()
 	return 0;
 }
 
-QTSS_Error HTTPSession::SendHTTPPacket(StrPtrLen* contentXML, bool connectionClose, bool decrement)
+QTSS_Error HTTPSession::SendHTTPPacket(StrPtrLen* contentXML, bool connectionClose, bool decrement, const char* contentType)
 {
     OSMutexLocker lock(&fSendMutex);
 
@@ -315,7 +316,7 @@ QTSS_Error HTTPSession::SendHTTPPacket(StrPtrLen* contentXML, bool connectionClo
 	if (connectionClose)
 		httpAck.AppendConnectionCloseHeader();
 
-    StrPtrLen type("application/json");
+    StrPtrLen type(const_cast<char*>(contentType));
     httpAck.AppendResponseHeader(httpContentTypeHeader, &type);
 
 	char respHeader[2048] = { 0 };
@@ -359,6 +360,11 @@ QTSS_Error HTTPSession::SetupRequest()
 				boost::erase_tail(sRequest, 1);
 			}
 			boost::split(path, sRequest, boost::is_any_of("/"), boost::token_compress_on);
+			if (path.size() == 1 && path[0] == "metrics")
+			{
+				return execNetMsgCSGetMetrics();
+			}
+
 			if (path.size() == 3)
 			{
 
@@ -571,10 +577,26 @@ QTSS_Error HTTPSession::execNetMsgCSGetRTSPLiveSessionsRESTful(const char* query
 		//}
 	}
 
+	string queryTemp;
+	if (queryString != NULL)
+	{
+		queryTemp = EasyUtil::Urldecode(queryString);
+	}
+
+	QueryParamList parList(const_cast<char *>(queryTemp.c_str()));
+	const char* chName = parList.DoFindCGIValueForParam(EASY_TAG_L_NAME);
+	const char* chChannel = parList.DoFindCGIValueForParam(EASY_TAG_L_CHANNEL);
+	const char* chPageNum = parList.DoFindCGIValueForParam(EASY_TAG_L_PAGE_NUM);
+	const char* chPageSize = parList.DoFindCGIValueForParam(EASY_TAG_L_PAGE_SIZE);
+
+	SInt32 theChannel = (chChannel != NULL) ? ::atoi(chChannel) : -1;
+	UInt32 thePageNum = (chPageNum != NULL) ? ::strtoul(chPageNum, NULL, 10) : 1;
+	UInt32 thePageSize = (chPageSize != NULL) ? ::strtoul(chPageSize, NULL, 10) : 0;
+
 	do
 	{
 		// ȡӦContent
-		char* msgContent = static_cast<char*>(Easy_GetRTSPPushSessions());
+		char* msgContent = static_cast<char*>(Easy_GetRTSPPushSessions(chName, theChannel, thePageNum, thePageSize));
 
 		StrPtrLen msgJson(msgContent);
 
@@ -716,8 +738,8 @@ QTSS_Error HTTPSession::execNetMsgCSUsageAck()
 		Json::Value value;
 		value[EASY_TAG_HTTP_METHOD] = EASY_TAG_HTTP_GET;
 		value[EASY_TAG_ACTION] = "GetRTSPLiveSessions";
-		value[EASY_TAG_PARAMETER] = "";
-		value[EASY_TAG_EXAMPLE] = "http://ip:port/api/[Version]/getrtsplivesessions";
+		value[EASY_TAG_PARAMETER] = "name=[Name]&channel=[Channel]&pagenum=[PageNum]&pagesize=[PageSize]";
+		value[EASY_TAG_EXAMPLE] = "http://ip:port/api/[Version]/getrtsplivesessions?name=live&pagenum=1&pagesize=100";
 		value[EASY_TAG_DESCRIPTION] = "get live sessions";
 		(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_API].append(value);
 	}
@@ -742,6 +764,16 @@ QTSS_Error HTTPSession::execNetMsgCSUsageAck()
 		(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_API].append(value);
 	}
 
+	{
+		Json::Value value;
+		value[EASY_TAG_HTTP_METHOD] = EASY_TAG_HTTP_GET;
+		value[EASY_TAG_ACTION] = "Metrics";
+		value[EASY_TAG_PARAMETER] = "";
+		value[EASY_TAG_EXAMPLE] = "http://ip:port/metrics";
+		value[EASY_TAG_DESCRIPTION] = "server and stream statistics in the Prometheus text format";
+		(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_API].append(value);
+	}
+
 	rsp.SetHead(header);
 	rsp.SetBody(body);
 	string msg = rsp.GetMsg();
@@ -751,6 +783,18 @@ QTSS_Error HTTPSession::execNetMsgCSUsageAck()
 	return QTSS_NoErr;
 }
 
+QTSS_Error HTTPSession::execNetMsgCSGetMetrics()
+{
+	ResizeableStringFormatter theMetrics(NULL, 0);
+	QTSServerInterface::GetServer()->WriteMetrics(&theMetrics);
+	ReflectorSessionCatalog::WriteMetrics(&theMetrics);
+
+	StrPtrLen theValue(theMetrics.GetBufPtr(), theMetrics.GetCurrentOffset());
+	this->SendHTTPPacket(&theValue, false, false, "text/plain; version=0.0.4");
+
+	return QTSS_NoErr;
+}
+
 QTSS_Error HTTPSession::execNetMsgCSGetServerVersionReqRESTful(const char* queryString)
 {
 	if (QTSServerInterface::GetServer()->GetPrefs()->CloudPlatformEnabled())
@@ -792,6 +836,28 @@ QTSS_Error HTTPSession::execNetMsgCSGetServerVersionReqRESTful(const char* query
 	body[EASY_TAG_SERVER_HARDWARE] = "x86";
 	body[EASY_TAG_SERVER_INTERFACE_VERSION] = "v1";
 
+	Float32 fileCacheHitPercent = 0;
+	UInt32 fileCacheHitPercentSize = sizeof(fileCacheHitPercent);
+	(void)QTSS_GetValue(QTSServerInterface::GetServer(), qtssSvrFileCacheHitPercent, 0, &fileCacheHitPercent, &fileCacheHitPercentSize);
+	UInt64 fileCacheBytesSaved = 0;
+	UInt32 fileCacheBytesSavedSize = sizeof(fileCacheBytesSaved);
+	(void)QTSS_GetValue(QTSServerInterface::GetServer(), qtssSvrFileCacheBytesSaved, 0, &fileCacheBytesSaved, &fileCacheBytesSavedSize);
+	UInt64 fileCacheEvictions = 0;
+	UInt32 fileCacheEvictionsSize = sizeof(fileCacheEvictions);
+	(void)QTSS_GetValue(QTSServerInterface::GetServer(), qtssSvrFileCacheEvictions, 0, &fileCacheEvictions, &fileCacheEvictionsSize);
+	Float32 movieCacheHitPercent = 0;
+	UInt32 movieCacheHitPercentSize = sizeof(movieCacheHitPercent);
+	(void)QTSS_GetValue(QTSServerInterface::GetServer(), qtssSvrMovieCacheHitPercent, 0, &movieCacheHitPercent, &movieCacheHitPercentSize);
+	Float32 movieCacheAvgOpenMsec = 0;
+	UInt32 movieCacheAvgOpenMsecSize = sizeof(movieCacheAvgOpenMsec);
+	(void)QTSS_GetValue(QTSServerInterface::GetServer(), qtssSvrMovieCacheAvgOpenMsec, 0, &movieCacheAvgOpenMsec, &movieCacheAvgOpenMsecSize);
+
+	body[EASY_TAG_FILE_CACHE_HIT_PERCENT] = fileCacheHitPercent;
+	body[EASY_TAG_FILE_CACHE_BYTES_SAVED] = Format("%" _64BITARG_ "u", fileCacheBytesSaved);
+	body[EASY_TAG_FILE_CACHE_EVICTIONS] = Format("%" _64BITARG_ "u", fileCacheEvictions);
+	body[EASY_TAG_MOVIE_CACHE_HIT_PERCENT] = movieCacheHitPercent;
+	body[EASY_TAG_MOVIE_CACHE_AVG_OPEN_MSEC] = movieCacheAvgOpenMsec;
+
 	rsp.SetHead(header);
 	rsp.SetBody(body);
 
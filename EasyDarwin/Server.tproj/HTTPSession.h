@@ -19,7 +19,7 @@ public:
 	virtual ~HTTPSession();
 
 	//Send HTTPPacket
-	QTSS_Error SendHTTPPacket(StrPtrLen* contentXML, bool connectionClose, bool decrement);
+	QTSS_Error SendHTTPPacket(StrPtrLen* contentXML, bool connectionClose, bool decrement, const char* contentType = "application/json");
 
 private:
 	SInt64 Run();
@@ -45,6 +45,9 @@ private:
 	QTSS_Error execNetMsgCSGetRTSPRecordSessionsRESTful(const char* queryString);
 	QTSS_Error execNetMsgCSRestartServiceRESTful(const char* queryString);
 
+	// Server and stream statistics for Prometheus to scrape
+	QTSS_Error execNetMsgCSGetMetrics();
+
 	// test current connections handled by this object against server pref connection limit
 	static inline bool OverMaxConnections(UInt32 buffer);
 
@@ -46,6 +46,8 @@
 #include "EasyProtocol.h"
 
 #include "ReflectorSession.h"
+#include "ReflectorSessionCatalog.h"
+#include "ResizeableStringFormatter.h"
 
 using namespace EasyDarwin::Protocol;
 using namespace std;
@@ -961,52 +963,136 @@ void QTSSCallbacks::QTSS_UnlockStdLib()
 	OS::GetStdLibMutex()->Unlock();
 }
 
-void* QTSSCallbacks::Easy_GetRTSPPushSessions()
+// Writes inString as a json string
+static void PutJSONString(StringFormatter* inFormatter, const char* inString)
 {
-	OSRefTable* reflectorSessionMap = QTSServerInterface::GetServer()->GetReflectorSessionMap();
+	inFormatter->PutChar('"');
+	for (const char* theChar = inString; *theChar != '\0'; theChar++)
+	{
+		if ((*theChar == '"') || (*theChar == '\\'))
+		{
+			inFormatter->PutChar('\\');
+			inFormatter->PutChar(*theChar);
+		}
+		else if ((UInt8)*theChar < 0x20)
+		{
+			char theEscape[8];
+			qtss_snprintf(theEscape, sizeof(theEscape), "\\u%04x", (UInt8)*theChar);
+			inFormatter->Put(theEscape);
+		}
+		else
+			inFormatter->PutChar(*theChar);
+	}
+	inFormatter->PutChar('"');
+}
 
-	EasyMsgSCRTSPLiveSessionsACK ack;
-	ack.SetHeaderValue(EASY_TAG_VERSION, "1.0");
-	ack.SetHeaderValue(EASY_TAG_CSEQ, "1");
+static void PutJSONField(StringFormatter* inFormatter, const char* inTag, const char* inValue, bool isFirst = false)
+{
+	if (!isFirst)
+		inFormatter->PutChar(',');
+	PutJSONString(inFormatter, inTag);
+	inFormatter->PutChar(':');
+	PutJSONString(inFormatter, inValue);
+}
 
-	UInt32 uIndex = 0;
-	OSMutexLocker locker(reflectorSessionMap->GetMutex());
+static void PutJSONField(StringFormatter* inFormatter, const char* inTag, UInt32 inValue, bool isFirst = false)
+{
+	char theValue[16];
+	qtss_snprintf(theValue, sizeof(theValue), "%" _U32BITARG_, inValue);
+
+	if (!isFirst)
+		inFormatter->PutChar(',');
+	PutJSONString(inFormatter, inTag);
+	inFormatter->PutChar(':');
+	inFormatter->Put(theValue);
+}
 
-	for (OSRefHashTableIter theIter(reflectorSessionMap->GetHashTable()); !theIter.IsDone(); theIter.Next())
+void* QTSSCallbacks::Easy_GetRTSPPushSessions(const char* inName, SInt32 inChannel, UInt32 inPageNum, UInt32 inPageSize)
+{
+	// Served from the catalog's snapshot, so the reflector session map is never locked
+	// here. The json is written straight out rather than built up with jsoncpp first.
+	ReflectorSessionCatalog::Snapshot* theSnapshot = ReflectorSessionCatalog::GetSnapshot();
+	UInt32 theNumEntries = (theSnapshot == NULL) ? 0 : theSnapshot->GetNumEntries();
+
+	if (inPageNum == 0)
+		inPageNum = 1;
+	UInt64 theFirst = (UInt64)(inPageNum - 1) * inPageSize;
+
+	ResizeableStringFormatter theSessions;
+	UInt32 theNumMatched = 0;
+	for (UInt32 x = 0; x < theNumEntries; x++)
 	{
-		OSRef* theRef = theIter.GetCurrent();
-		ReflectorSession* theSession = (ReflectorSession*)theRef->GetObject();
-
-		EasyDarwinRTSPSession session;
-		session.index = uIndex;
-		char* fullRequestURL = NULL;
-
-		RTPSession* clientSession = (RTPSession*)theSession->GetBroadcasterSession();
+		ReflectorSessionCatalog::Entry* theEntry = theSnapshot->GetEntry(x);
+		if ((inName != NULL) && (::strstr(theEntry->GetName(), inName) == NULL))
+			continue;
+		if ((inChannel >= 0) && (theEntry->GetChannel() != (UInt32)inChannel))
+			continue;
 
-		if (clientSession == NULL) continue;
+		UInt64 theIndex = theNumMatched++;
+		if ((theIndex < theFirst) || ((inPageSize > 0) && (theIndex >= theFirst + inPageSize)))
+			continue;
 
-		clientSession->GetValueAsString(qtssCliSesFullURL, 0, &fullRequestURL);
-		session.Url = fullRequestURL;
-		session.Name = theSession->GetStreamName()->Ptr;
-		session.numOutputs = theSession->GetNumOutputs();
-		session.channel = theSession->GetChannelNum();
-		ack.AddSession(session);
-		uIndex++;
+		// The snapshot keeps the session from being deleted while we read it
+		ReflectorSession* theSession = theEntry->GetSession();
+		UInt32 theGOPCacheHits = 0, theGOPCacheMisses = 0, theFirstFrameMSec = 0;
+		theSession->GetGOPCacheStats(&theGOPCacheHits, &theGOPCacheMisses, &theFirstFrameMSec);
+
+		if (theSessions.GetCurrentOffset() > 0)
+			theSessions.PutChar(',');
+		theSessions.PutChar('{');
+		PutJSONField(&theSessions, EASY_TAG_L_INDEX, (UInt32)theIndex, true);
+		PutJSONField(&theSessions, EASY_TAG_L_URL, theEntry->GetURL());
+		PutJSONField(&theSessions, EASY_TAG_L_NAME, theEntry->GetName());
+		PutJSONField(&theSessions, EASY_TAG_CHANNEL, theEntry->GetChannel());
+		PutJSONField(&theSessions, EASY_TAG_NUM_OUTPUTS, theSession->GetNumOutputs());
+		PutJSONField(&theSessions, EASY_TAG_BITRATE, theSession->GetBitRate());
+		PutJSONField(&theSessions, EASY_TAG_PACKET_MEMORY, theSession->GetPacketMemory());
+		PutJSONField(&theSessions, EASY_TAG_COPY_RATE, theSession->GetCopyRate());
+		PutJSONField(&theSessions, EASY_TAG_GOP_CACHE_HITS, theGOPCacheHits);
+		PutJSONField(&theSessions, EASY_TAG_GOP_CACHE_MISSES, theGOPCacheMisses);
+		PutJSONField(&theSessions, EASY_TAG_FIRST_FRAME_MSEC, theFirstFrameMSec);
+		theSessions.PutChar('}');
 	}
 
-	char count[16] = { 0 };
-	sprintf(count, "%d", uIndex);
-	ack.SetBodyValue(EASY_TAG_SESSION_COUNT, count);
-
-	string msg = ack.GetMsg();
-
-	UInt32 theMsgLen = strlen(msg.c_str());
+	UInt32 theVersion = (theSnapshot == NULL) ? 0 : theSnapshot->GetVersion();
+	if (theSnapshot != NULL)
+		ReflectorSessionCatalog::Release(theSnapshot);
+
+	char theCount[16];
+	ResizeableStringFormatter theMsg;
+	theMsg.Put("{\"" EASY_TAG_ROOT "\":{\"" EASY_TAG_HEADER "\":{");
+	PutJSONField(&theMsg, EASY_TAG_CSEQ, "1", true);
+	PutJSONField(&theMsg, EASY_TAG_MESSAGE_TYPE, EasyProtocol::GetMsgTypeString(MSG_SC_RTSP_LIVE_SESSIONS_ACK).c_str());
+	PutJSONField(&theMsg, EASY_TAG_VERSION, "1.0");
+	theMsg.Put("},\"" EASY_TAG_BODY "\":{");
+	qtss_snprintf(theCount, sizeof(theCount), "%" _U32BITARG_, theVersion);
+	PutJSONField(&theMsg, EASY_TAG_CATALOG_VERSION, theCount, true);
+	qtss_snprintf(theCount, sizeof(theCount), "%" _U32BITARG_, inPageNum);
+	PutJSONField(&theMsg, EASY_TAG_PAGE_NUM, theCount);
+	qtss_snprintf(theCount, sizeof(theCount), "%" _U32BITARG_, inPageSize);
+	PutJSONField(&theMsg, EASY_TAG_PAGE_SIZE, theCount);
+	qtss_snprintf(theCount, sizeof(theCount), "%" _U32BITARG_, theNumMatched);
+	PutJSONField(&theMsg, EASY_TAG_SESSION_COUNT, theCount);
+	theMsg.Put(",\"" EASY_TAG_SESSIONS "\":[");
+	theMsg.Put(theSessions.GetBufPtr(), theSessions.GetCurrentOffset());
+	theMsg.Put("]}}}");
+
+	UInt32 theMsgLen = theMsg.GetCurrentOffset();
 	char* retMsg = new char[theMsgLen + 1];
+	::memcpy(retMsg, theMsg.GetBufPtr(), theMsgLen);
 	retMsg[theMsgLen] = '\0';
-	strncpy(retMsg, msg.c_str(), strlen(msg.c_str()));
 	return (void*)retMsg;
 }
 
+QTSS_Error QTSSCallbacks::Easy_SetRTSPIngestHandler(QTSS_RTSPSessionObject inRTSPSession, QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie)
+{
+	if ((inRTSPSession == NULL) || (inClientSession == NULL))
+		return QTSS_BadArgument;
+
+	((RTSPSessionInterface*)inRTSPSession)->SetIngestHandler(inClientSession, inProc, inCookie);
+	return QTSS_NoErr;
+}
+
 
 //void *QTSSCallbacks::Easy_GetRTSPRecordSessions(char* inSessionName, UInt64 startTime, UInt64 endTime) 
 //{
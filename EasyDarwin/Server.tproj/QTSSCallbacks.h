@@ -157,7 +157,8 @@ public:
 	static void   QTSS_LockStdLib();
 	static void   QTSS_UnlockStdLib();
 
-	static void* Easy_GetRTSPPushSessions();
+	static void* Easy_GetRTSPPushSessions(const char* inName, SInt32 inChannel, UInt32 inPageNum, UInt32 inPageSize);
+	static QTSS_Error Easy_SetRTSPIngestHandler(QTSS_RTSPSessionObject inRTSPSession, QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie);
 };
 
 #endif //__QTSSCALLBACKS_H__
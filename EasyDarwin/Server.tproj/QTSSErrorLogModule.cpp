@@ -322,6 +322,10 @@ QTSS_Error LogError(QTSS_RoleParamPtr inParamBlock)
 		tempBuffer[sizeof(tempBuffer) - 1] = '\0'; //make sure it is 0 terminated.
 
 		sErrorLog->WriteToLog(tempBuffer, kAllowLogToRoll);
+
+		//the server may not get to write it out otherwise
+		if (verbLvl == qtssFatalVerbosity)
+			QTSSRollingLog::FlushAsyncWrites();
 	}
 	return QTSS_NoErr;
 }
@@ -403,6 +407,8 @@ void    WriteShutdownMessage()
 
 	if (result && sErrorLog != NULL)
 		sErrorLog->WriteToLog(tempBuffer, kAllowLogToRoll);
+
+	QTSSRollingLog::FlushAsyncWrites();
 }
 
 // This task runs once an hour to check and see if the log needs to roll.
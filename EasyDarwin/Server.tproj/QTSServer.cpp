@@ -883,6 +883,7 @@ void    QTSServer::InitCallbacks()
 	sCallbacks.addr[kUnlockStdLibCallback] = (QTSS_CallbackProcPtr)QTSSCallbacks::QTSS_UnlockStdLib;
 
 	sCallbacks.addr[kGetRTSPPushSessionsCallback] = (QTSS_CallbackProcPtr)QTSSCallbacks::Easy_GetRTSPPushSessions;
+	sCallbacks.addr[kSetRTSPIngestHandlerCallback] = (QTSS_CallbackProcPtr)QTSSCallbacks::Easy_SetRTSPIngestHandler;
 
 }
 
@@ -1258,15 +1259,17 @@ bool HTTPListenerSocket::OverMaxConnections(UInt32 buffer)
 
 UDPSocketPair*  RTPSocketPool::ConstructUDPSocketPair()
 {
-	Task* theTask = ((QTSServer*)QTSServerInterface::GetServer())->fRTCPTask;
+	RTCPTask* theTask = ((QTSServer*)QTSServerInterface::GetServer())->fRTCPTask;
 
 	//construct a pair of UDP sockets, the lower one for RTP data (outgoing only, no demuxer
 	//necessary), and one for RTCP data (incoming, so definitely need a demuxer).
 	//These are nonblocking sockets that DON'T receive events (we are going to poll for data)
 	// They do receive events - we don't poll from them anymore
+	UDPSocket* theRTCPSocket = new UDPSocket(theTask, UDPSocket::kWantsDemuxer | Socket::kNonBlockingSocketType);
+	theRTCPSocket->SetReadyQueue(theTask->GetReadyQueue());
+
 	return new
-		UDPSocketPair(new UDPSocket(theTask, Socket::kNonBlockingSocketType),
-			new UDPSocket(theTask, UDPSocket::kWantsDemuxer | Socket::kNonBlockingSocketType));
+		UDPSocketPair(new UDPSocket(theTask, Socket::kNonBlockingSocketType), theRTCPSocket);
 }
 
 void RTPSocketPool::DestructUDPSocketPair(UDPSocketPair* inPair)
@@ -39,6 +39,8 @@
 #include "UDPSocketPool.h"
 #include "RTSPProtocol.h"
 #include "RTPPacketResender.h"
+#include "OSBlockCache.h"
+#include "QTRTPFile.h"
 #include "revision.h"
 #include "EasyUtil.h"
 
@@ -103,11 +105,11 @@ QTSSAttrInfoDict::AttrInfo  QTSServerInterface::sAttributes[] =
 	/* 7  */ { "qtssSvrRTSPServerHeader",       NULL,   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModePreempSafe },
 	/* 8  */ { "qtssSvrState",              NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite  },
 	/* 9  */ { "qtssSvrIsOutOfDescriptors",     IsOutOfDescriptors,     qtssAttrDataTypeBool16, qtssAttrModeRead },
-	/* 10 */ { "qtssRTSPCurrentSessionCount",   NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead },
-	/* 11 */ { "qtssRTSPHTTPCurrentSessionCount",NULL,  qtssAttrDataTypeUInt32,     qtssAttrModeRead },
+	/* 10 */ { "qtssRTSPCurrentSessionCount",   GetNumRTSPSessions,     qtssAttrDataTypeUInt32,     qtssAttrModeRead },
+	/* 11 */ { "qtssRTSPHTTPCurrentSessionCount",GetNumRTSPHTTPSessions, qtssAttrDataTypeUInt32,     qtssAttrModeRead },
 	/* 12 */ { "qtssRTPSvrNumUDPSockets",       GetTotalUDPSockets,     qtssAttrDataTypeUInt32, qtssAttrModeRead },
-	/* 13 */ { "qtssRTPSvrCurConn",             NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead },
-	/* 14 */ { "qtssRTPSvrTotalConn",           NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead },
+	/* 13 */ { "qtssRTPSvrCurConn",             GetNumRTPSessions,      qtssAttrDataTypeUInt32,     qtssAttrModeRead },
+	/* 14 */ { "qtssRTPSvrTotalConn",           GetTotalRTPSessions,    qtssAttrDataTypeUInt32,     qtssAttrModeRead },
 	/* 15 */ { "qtssRTPSvrCurBandwidth",        NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead },
 	/* 16 */ { "qtssRTPSvrTotalBytes",          NULL,   qtssAttrDataTypeUInt64,     qtssAttrModeRead },
 	/* 17 */ { "qtssRTPSvrAvgBandwidth",        NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead },
@@ -129,8 +131,13 @@ QTSSAttrInfoDict::AttrInfo  QTSServerInterface::sAttributes[] =
 	/* 33  */ { "qtssSvrServerBuild",           NULL,   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModePreempSafe },
 	/* 34  */ { "qtssSvrServerPlatform",        NULL,   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModePreempSafe },
 	/* 35  */ { "qtssSvrRTSPServerComment",     NULL,   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModePreempSafe },
-	/* 36  */ { "qtssSvrNumThinned",            NULL,   qtssAttrDataTypeSInt32,     qtssAttrModeRead | qtssAttrModePreempSafe },
-	/* 37  */ { "qtssSvrNumThreads",            NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModePreempSafe }
+	/* 36  */ { "qtssSvrNumThinned",            GetNumThinned,  qtssAttrDataTypeSInt32,     qtssAttrModeRead | qtssAttrModePreempSafe },
+	/* 37  */ { "qtssSvrNumThreads",            NULL,   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModePreempSafe },
+	/* 38  */ { "qtssSvrFileCacheHitPercent",   GetFileCacheHitPercent,     qtssAttrDataTypeFloat32,    qtssAttrModeRead },
+	/* 39  */ { "qtssSvrFileCacheBytesSaved",   GetFileCacheBytesSaved,     qtssAttrDataTypeUInt64,     qtssAttrModeRead },
+	/* 40  */ { "qtssSvrFileCacheEvictions",    GetFileCacheEvictions,      qtssAttrDataTypeUInt64,     qtssAttrModeRead },
+	/* 41  */ { "qtssSvrMovieCacheHitPercent",  GetMovieCacheHitPercent,    qtssAttrDataTypeFloat32,    qtssAttrModeRead },
+	/* 42  */ { "qtssSvrMovieCacheAvgOpenMsec", GetMovieCacheAvgOpenMsec,   qtssAttrDataTypeFloat32,    qtssAttrModeRead }
 };
 
 void    QTSServerInterface::Initialize()
@@ -197,9 +204,6 @@ QTSServerInterface::QTSServerInterface()
 	fTotalRTPBytes(0),
 	fTotalRTPPackets(0),
 	fTotalRTPPacketsLost(0),
-	fPeriodicRTPBytes(0),
-	fPeriodicRTPPacketsLost(0),
-	fPeriodicRTPPackets(0),
 	fCurrentRTPBandwidthInBits(0),
 	fAvgRTPBandwidthInBits(0),
 	fRTPPacketsPerSecond(0),
@@ -211,12 +215,15 @@ QTSServerInterface::QTSServerInterface()
 	fSigTerm(false),
 	fDebugLevel(0),
 	fDebugOptions(0),
-	fMaxLate(0),
-	fTotalLate(0),
-	fCurrentMaxLate(0),
-	fTotalQuality(0),
+	fTotalLateCleared(0),
+	fTotalQualityCleared(0),
 	fNumThinned(0),
-	fNumThreads(0)
+	fNumThreads(0),
+	fFileCacheHitPercent(0),
+	fFileCacheBytesSaved(0),
+	fFileCacheEvictions(0),
+	fMovieCacheHitPercent(0),
+	fMovieCacheAvgOpenMsec(0)
 {
 	for (UInt32 y = 0; y < QTSSModule::kNumRoles; y++)
 	{
@@ -231,10 +238,6 @@ QTSServerInterface::QTSServerInterface()
 	this->SetVal(qtssSvrServerVersion, sServerVersionStr.Ptr, sServerVersionStr.Len);
 	this->SetVal(qtssSvrServerBuildDate, sServerBuildDateStr.Ptr, sServerBuildDateStr.Len);
 	this->SetVal(qtssSvrRTSPServerHeader, sServerHeaderPtr.Ptr, sServerHeaderPtr.Len);
-	this->SetVal(qtssRTSPCurrentSessionCount, &fNumRTSPSessions, sizeof(fNumRTSPSessions));
-	this->SetVal(qtssRTSPHTTPCurrentSessionCount, &fNumRTSPHTTPSessions, sizeof(fNumRTSPHTTPSessions));
-	this->SetVal(qtssRTPSvrCurConn, &fNumRTPSessions, sizeof(fNumRTPSessions));
-	this->SetVal(qtssRTPSvrTotalConn, &fTotalRTPSessions, sizeof(fTotalRTPSessions));
 	this->SetVal(qtssRTPSvrCurBandwidth, &fCurrentRTPBandwidthInBits, sizeof(fCurrentRTPBandwidthInBits));
 	this->SetVal(qtssRTPSvrTotalBytes, &fTotalRTPBytes, sizeof(fTotalRTPBytes));
 	this->SetVal(qtssRTPSvrAvgBandwidth, &fAvgRTPBandwidthInBits, sizeof(fAvgRTPBandwidthInBits));
@@ -248,7 +251,6 @@ QTSServerInterface::QTSServerInterface()
 	this->SetVal(qtssSvrRTSPServerComment, sServerCommentStr.Ptr, sServerCommentStr.Len);
 	this->SetVal(qtssSvrServerPlatform, sServerPlatformStr.Ptr, sServerPlatformStr.Len);
 
-	this->SetVal(qtssSvrNumThinned, &fNumThinned, sizeof(fNumThinned));
 	this->SetVal(qtssSvrNumThreads, &fNumThreads, sizeof(fNumThreads));
 
 	qtss_sprintf(fCloudServiceNodeID, "%s", EasyUtil::GetUUID().c_str());
@@ -274,6 +276,53 @@ void QTSServerInterface::LogError(QTSS_ErrorVerbosity inVerbosity, char* inBuffe
 	}
 }
 
+void QTSServerInterface::WriteMetrics(StringFormatter* ioOut)
+{
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtsp_sessions", "gauge", "RTSP sessions connected");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtsp_sessions", NULL, (SInt64)this->GetNumRTSPSessions());
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtsp_http_sessions", "gauge", "RTSP over HTTP sessions connected");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtsp_http_sessions", NULL, (SInt64)this->GetNumRTSPHTTPSessions());
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_sessions", "gauge", "RTP sessions");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_sessions", NULL, (SInt64)this->GetNumRTPSessions());
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_playing_sessions", "gauge", "RTP sessions playing");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_playing_sessions", NULL, (SInt64)this->GetNumRTPPlayingSessions());
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_sessions_total", "counter", "RTP sessions since startup");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_sessions_total", NULL, (SInt64)this->GetTotalRTPSessions());
+
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_sent_bytes_total", "counter", "RTP bytes sent");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_sent_bytes_total", NULL, OSCounters::Get(kRTPBytesCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_sent_packets_total", "counter", "RTP packets sent");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_sent_packets_total", NULL, OSCounters::Get(kRTPPacketsCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_lost_packets_total", "counter", "RTP packets reported lost by clients");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_lost_packets_total", NULL, OSCounters::Get(kRTPPacketsLostCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_nacked_packets_total", "counter", "RTP packets clients asked for again with RTCP NACKs");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_nacked_packets_total", NULL, OSCounters::Get(kRTPNACKedPacketsCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_retransmitted_packets_total", "counter", "RTP packets sent again in answer to NACKs and key frame requests");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_retransmitted_packets_total", NULL, OSCounters::Get(kRTPRetransmitsCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtcp_key_frame_requests_total", "counter", "RTCP PLIs and FIRs received from clients");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtcp_key_frame_requests_total", NULL, OSCounters::Get(kKeyFrameRequestsCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_reflector_fec_packets_total", "counter", "ULPFEC parity packets made by the reflector, once per stream");
+	OSCounters::WriteValue(ioOut, "easydarwin_reflector_fec_packets_total", NULL, OSCounters::Get(kFECPacketsCounter));
+	OSCounters::WriteHeader(ioOut, "easydarwin_rtp_bandwidth_bits", "gauge", "RTP bits per second sent, averaged over the avg_bandwidth_update_interval");
+	OSCounters::WriteValue(ioOut, "easydarwin_rtp_bandwidth_bits", NULL, (SInt64)fAvgRTPBandwidthInBits);
+	OSCounters::WriteHeader(ioOut, "easydarwin_thinned_streams", "gauge", "RTP streams being thinned");
+	OSCounters::WriteValue(ioOut, "easydarwin_thinned_streams", NULL, (SInt64)this->GetNumThinned());
+	OSCounters::WriteHeader(ioOut, "easydarwin_max_late_milliseconds", "gauge", "Latest an RTP packet has been sent since startup");
+	OSCounters::WriteValue(ioOut, "easydarwin_max_late_milliseconds", NULL, this->GetMaxLate());
+	OSCounters::WriteHeader(ioOut, "easydarwin_cpu_percent", "gauge", "Server CPU load");
+	OSCounters::WriteValue(ioOut, "easydarwin_cpu_percent", NULL, (Float64)fCPUPercent);
+
+	OSCounters::WriteHistogram(ioOut, "easydarwin_task_queue_latency_seconds", "Time from a task being signalled to it running", OSCounters::kTaskQueueLatency);
+	OSCounters::WriteHistogram(ioOut, "easydarwin_reflector_fanout_seconds", "Time to hand one batch of pushed packets to every viewer", kReflectorFanOutCounter);
+
+	OSCounters::WritePerThread(ioOut, "easydarwin_socket_reads_total", "counter", "Socket reads", OSCounters::kSocketReads);
+	OSCounters::WritePerThread(ioOut, "easydarwin_socket_reads_would_block_total", "counter", "Socket reads that found nothing to read", OSCounters::kSocketReadsWouldBlock);
+	OSCounters::WritePerThread(ioOut, "easydarwin_socket_writes_total", "counter", "Socket writes", OSCounters::kSocketWrites);
+	OSCounters::WritePerThread(ioOut, "easydarwin_socket_writes_would_block_total", "counter", "Socket writes refused because the socket was full", OSCounters::kSocketWritesWouldBlock);
+	OSCounters::WritePerThread(ioOut, "easydarwin_udp_batched_packets_total", "counter", "UDP packets sent in sendmmsg batches", OSCounters::kUDPBatchedPackets);
+	OSCounters::WritePerThread(ioOut, "easydarwin_udp_batch_syscalls_total", "counter", "sendmmsg calls", OSCounters::kUDPBatchSyscalls);
+}
+
 void QTSServerInterface::KillAllRTPSessions()
 {
 	OSMutexLocker locker(fRTPMap->GetMutex());
@@ -367,28 +416,19 @@ SInt64 RTPStatsUpdaterTask::Run()
 	// All of this must happen atomically wrt dictionary values we are manipulating
 	OSMutexLocker locker(&theServer->fMutex);
 
-	//First update total bytes. This must be done because total bytes is a 64 bit number,
-	//so no atomic functions can apply.
-	//
-	// NOTE: The line below is not thread safe on non-PowerPC platforms. This is
-	// because the fPeriodicRTPBytes variable is being manipulated from within an
-	// atomic_add. On PowerPC, assignments are atomic, so the assignment below is ok.
-	// On a non-PowerPC platform, the following would be thread safe:
-	//unsigned int periodicBytes = atomic_add(&theServer->fPeriodicRTPBytes, 0);
-	unsigned int periodicBytes = theServer->fPeriodicRTPBytes;
-	(void)atomic_sub(&theServer->fPeriodicRTPBytes, periodicBytes);
-	theServer->fTotalRTPBytes += periodicBytes;
+	//First bring the totals up to date. What was counted since last time is the
+	//difference to the previous total.
+	UInt64 totalBytes = (UInt64)OSCounters::Get(QTSServerInterface::kRTPBytesCounter);
+	UInt32 periodicBytes = (UInt32)(totalBytes - theServer->fTotalRTPBytes);
+	theServer->fTotalRTPBytes = totalBytes;
 
 	// Same deal for packet totals
-	unsigned int periodicPackets = theServer->fPeriodicRTPPackets;
-	(void)atomic_sub(&theServer->fPeriodicRTPPackets, periodicPackets);
-	theServer->fTotalRTPPackets += periodicPackets;
+	UInt64 totalPackets = (UInt64)OSCounters::Get(QTSServerInterface::kRTPPacketsCounter);
+	UInt32 periodicPackets = (UInt32)(totalPackets - theServer->fTotalRTPPackets);
+	theServer->fTotalRTPPackets = totalPackets;
 
 	// ..and for lost packet totals
-	unsigned int periodicPacketsLost = theServer->fPeriodicRTPPacketsLost;
-	(void)atomic_sub(&theServer->fPeriodicRTPPacketsLost, periodicPacketsLost);
-
-	theServer->fTotalRTPPacketsLost += periodicPacketsLost;
+	theServer->fTotalRTPPacketsLost = (UInt64)OSCounters::Get(QTSServerInterface::kRTPPacketsLostCounter);
 
 	SInt64 curTime = OS::Milliseconds();
 
@@ -525,6 +565,51 @@ void* QTSServerInterface::GetTotalUDPSockets(QTSSDictionary* inServer, UInt32* o
 	return &theServer->fTotalUDPSockets;
 }
 
+void* QTSServerInterface::GetNumRTSPSessions(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fNumRTSPSessions = theServer->GetNumRTSPSessions();
+
+	*outLen = sizeof(theServer->fNumRTSPSessions);
+	return &theServer->fNumRTSPSessions;
+}
+
+void* QTSServerInterface::GetNumRTSPHTTPSessions(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fNumRTSPHTTPSessions = theServer->GetNumRTSPHTTPSessions();
+
+	*outLen = sizeof(theServer->fNumRTSPHTTPSessions);
+	return &theServer->fNumRTSPHTTPSessions;
+}
+
+void* QTSServerInterface::GetNumRTPSessions(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fNumRTPSessions = theServer->GetNumRTPSessions();
+
+	*outLen = sizeof(theServer->fNumRTPSessions);
+	return &theServer->fNumRTPSessions;
+}
+
+void* QTSServerInterface::GetTotalRTPSessions(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fTotalRTPSessions = theServer->GetTotalRTPSessions();
+
+	*outLen = sizeof(theServer->fTotalRTPSessions);
+	return &theServer->fTotalRTPSessions;
+}
+
+void* QTSServerInterface::GetNumThinned(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fNumThinned = theServer->GetNumThinned();
+
+	*outLen = sizeof(theServer->fNumThinned);
+	return &theServer->fNumThinned;
+}
+
 void* QTSServerInterface::IsOutOfDescriptors(QTSSDictionary* inServer, UInt32* outLen)
 {
 	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
@@ -569,6 +654,61 @@ void* QTSServerInterface::GetNumWastedBytes(QTSSDictionary* inServer, UInt32* ou
 	return &theServer->fUDPWastageInBytes;
 }
 
+void* QTSServerInterface::GetFileCacheHitPercent(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+
+	UInt64 theHits = OSBlockCache::GetNumHits();
+	UInt64 theLookups = theHits + OSBlockCache::GetNumMisses();
+	theServer->fFileCacheHitPercent = 0;
+	if (theLookups > 0)
+		theServer->fFileCacheHitPercent = (Float32)(((Float64)theHits * 100) / (Float64)theLookups);
+
+	// Return the result
+	*outLen = sizeof(theServer->fFileCacheHitPercent);
+	return &theServer->fFileCacheHitPercent;
+}
+
+void* QTSServerInterface::GetFileCacheBytesSaved(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fFileCacheBytesSaved = OSBlockCache::GetBytesSaved();
+
+	// Return the result
+	*outLen = sizeof(theServer->fFileCacheBytesSaved);
+	return &theServer->fFileCacheBytesSaved;
+}
+
+void* QTSServerInterface::GetFileCacheEvictions(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fFileCacheEvictions = OSBlockCache::GetNumEvictions();
+
+	// Return the result
+	*outLen = sizeof(theServer->fFileCacheEvictions);
+	return &theServer->fFileCacheEvictions;
+}
+
+void* QTSServerInterface::GetMovieCacheHitPercent(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fMovieCacheHitPercent = QTRTPFile::GetFileCacheHitPercent();
+
+	// Return the result
+	*outLen = sizeof(theServer->fMovieCacheHitPercent);
+	return &theServer->fMovieCacheHitPercent;
+}
+
+void* QTSServerInterface::GetMovieCacheAvgOpenMsec(QTSSDictionary* inServer, UInt32* outLen)
+{
+	QTSServerInterface* theServer = (QTSServerInterface*)inServer;
+	theServer->fMovieCacheAvgOpenMsec = QTRTPFile::GetFileCacheAvgOpenMsec();
+
+	// Return the result
+	*outLen = sizeof(theServer->fMovieCacheAvgOpenMsec);
+	return &theServer->fMovieCacheAvgOpenMsec;
+}
+
 void* QTSServerInterface::TimeConnected(QTSSDictionary* inConnection, UInt32* outLen)
 {
 	SInt64 connectTime;
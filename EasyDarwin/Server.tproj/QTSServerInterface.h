@@ -44,6 +44,7 @@
 #include "QTSSMessages.h"
 #include "QTSSModule.h"
 #include "atomic.h"
+#include "OSCounters.h"
 
 #include "OSMutex.h"
 #include "Task.h"
@@ -86,6 +87,33 @@ public:
 	QTSServerInterface();
 	virtual ~QTSServerInterface() {}
 
+	//
+	// STATISTICS COUNTERS
+	// Kept in OSCounters, so bumping one takes no lock. The accessors below add
+	// up the threads' shares.
+	enum
+	{
+		kRTSPSessionsCounter = OSCounters::kFirstAppCounter,
+		kRTSPHTTPSessionsCounter,
+		kRTPSessionsCounter,
+		kRTPPlayingSessionsCounter,
+		kTotalRTPSessionsCounter,
+		kRTPBytesCounter,
+		kRTPPacketsCounter,
+		kRTPPacketsLostCounter,
+		kTotalLateCounter,
+		kCurrentMaxLateCounter,     // SetMax, reset by ClearCurrentMaxLate
+		kMaxLateCounter,            // SetMax, never reset
+		kTotalQualityCounter,
+		kNumThinnedCounter,
+		kRTPNACKedPacketsCounter,   // packets clients asked for again with RTCP NACKs
+		kRTPRetransmitsCounter,     // packets sent again
+		kKeyFrameRequestsCounter,   // RTCP PLIs and FIRs
+		kFECPacketsCounter,         // parity packets the reflector made
+		kReflectorFanOutCounter,    // histogram of the time to hand a packet to every viewer
+		kNumServerCounters = kReflectorFanOutCounter + OSCounters::kHistogramSize
+	};
+
 	//
 	//
 	// STATISTICS MANIPULATION
@@ -93,38 +121,37 @@ public:
 
 	void                AlterCurrentRTSPSessionCount(SInt32 inDifference)
 	{
-		OSMutexLocker locker(&fMutex); fNumRTSPSessions += inDifference;
+		OSCounters::Add(kRTSPSessionsCounter, inDifference);
 	}
 	void                AlterCurrentRTSPHTTPSessionCount(SInt32 inDifference)
 	{
-		OSMutexLocker locker(&fMutex); fNumRTSPHTTPSessions += inDifference;
+		OSCounters::Add(kRTSPHTTPSessionsCounter, inDifference);
 	}
 	void                SwapFromRTSPToHTTP()
 	{
-		OSMutexLocker locker(&fMutex); fNumRTSPSessions--; fNumRTSPHTTPSessions++;
+		OSCounters::Add(kRTSPSessionsCounter, -1); OSCounters::Add(kRTSPHTTPSessionsCounter, 1);
 	}
 
 	//total rtp bytes sent by the server
 	void            IncrementTotalRTPBytes(UInt32 bytes)
 	{
-		(void)atomic_add(&fPeriodicRTPBytes, bytes);
+		OSCounters::Add(kRTPBytesCounter, bytes);
 	}
 	//total rtp packets sent by the server
 	void            IncrementTotalPackets()
 	{
-		(void)atomic_add(&fPeriodicRTPPackets, 1);
-		//++fPeriodicRTPPackets;
+		OSCounters::Add(kRTPPacketsCounter, 1);
 	}
 	//total rtp bytes reported as lost by the clients
 	void            IncrementTotalRTPPacketsLost(UInt32 packets)
 	{
-		(void)atomic_add(&fPeriodicRTPPacketsLost, packets);
+		OSCounters::Add(kRTPPacketsLostCounter, packets);
 	}
 
 	// Also increments current RTP session count
 	void            IncrementTotalRTPSessions()
 	{
-		OSMutexLocker locker(&fMutex); fNumRTPSessions++; fTotalRTPSessions++;
+		OSCounters::Add(kRTPSessionsCounter, 1); OSCounters::Add(kTotalRTPSessionsCounter, 1);
         /*UInt32 numModules = QTSServerInterface::GetNumModulesInRole(QTSSModule::kRedisSetRTSPLoadRole);
 		for (UInt32 currentModule = 0; currentModule < numModules; currentModule++)
 		{
@@ -134,7 +161,7 @@ public:
 	}
 	void            AlterCurrentRTPSessionCount(SInt32 inDifference)
 	{
-		OSMutexLocker locker(&fMutex); fNumRTPSessions += inDifference;
+		OSCounters::Add(kRTPSessionsCounter, inDifference);
         /*UInt32 numModules = QTSServerInterface::GetNumModulesInRole(QTSSModule::kRedisSetRTSPLoadRole);
 		for (UInt32 currentModule = 0; currentModule < numModules; currentModule++)
 		{
@@ -147,40 +174,53 @@ public:
 	//track how many sessions are playing
 	void            AlterRTPPlayingSessions(SInt32 inDifference)
 	{
-		OSMutexLocker locker(&fMutex); fNumRTPPlayingSessions += inDifference;
+		OSCounters::Add(kRTPPlayingSessionsCounter, inDifference);
 	}
 
 
 	void            IncrementTotalLate(SInt64 milliseconds)
 	{
-		OSMutexLocker locker(&fMutex);
-		fTotalLate += milliseconds;
-		if (milliseconds > fCurrentMaxLate) fCurrentMaxLate = milliseconds;
-		if (milliseconds > fMaxLate) fMaxLate = milliseconds;
+		OSCounters::Add(kTotalLateCounter, milliseconds);
+		OSCounters::SetMax(kCurrentMaxLateCounter, milliseconds);
+		OSCounters::SetMax(kMaxLateCounter, milliseconds);
 	}
 
 	void            IncrementTotalQuality(SInt32 level)
 	{
-		OSMutexLocker locker(&fMutex); fTotalQuality += level;
+		OSCounters::Add(kTotalQualityCounter, level);
 	}
 
 
 	void            IncrementNumThinned(SInt32 inDifference)
 	{
-		OSMutexLocker locker(&fMutex); fNumThinned += inDifference;
+		OSCounters::Add(kNumThinnedCounter, inDifference);
+	}
+
+	void            IncrementTotalNACKedPackets(UInt32 packets)
+	{
+		OSCounters::Add(kRTPNACKedPacketsCounter, packets);
+	}
+	void            IncrementTotalRetransmits()
+	{
+		OSCounters::Add(kRTPRetransmitsCounter, 1);
+	}
+	void            IncrementTotalKeyFrameRequests()
+	{
+		OSCounters::Add(kKeyFrameRequestsCounter, 1);
 	}
 
+	//The counters only ever go up; clearing remembers where they stood.
 	void            ClearTotalLate()
 	{
-		OSMutexLocker locker(&fMutex); fTotalLate = 0;
+		fTotalLateCleared = OSCounters::Get(kTotalLateCounter);
 	}
 	void            ClearCurrentMaxLate()
 	{
-		OSMutexLocker locker(&fMutex); fCurrentMaxLate = 0;
+		OSCounters::ResetMax(kCurrentMaxLateCounter);
 	}
 	void            ClearTotalQuality()
 	{
-		OSMutexLocker locker(&fMutex); fTotalQuality = 0;
+		fTotalQualityCleared = OSCounters::Get(kTotalQualityCounter);
 	}
 
 
@@ -189,12 +229,15 @@ public:
 	// ACCESSORS
 
 	QTSS_ServerState    GetServerState() { return fServerState; }
-	UInt32              GetNumRTPSessions() { return fNumRTPSessions; }
-	UInt32              GetNumRTSPSessions() { return fNumRTSPSessions; }
-	UInt32              GetNumRTSPHTTPSessions() { return fNumRTSPHTTPSessions; }
+	//A session is counted on the thread that opens it and uncounted on the one that
+	//closes it, so a sum taken in between can dip below zero. The max connection
+	//checks compare these unsigned, so clamp.
+	UInt32              GetNumRTPSessions() { return ClampGauge(OSCounters::Get(kRTPSessionsCounter)); }
+	UInt32              GetNumRTSPSessions() { return ClampGauge(OSCounters::Get(kRTSPSessionsCounter)); }
+	UInt32              GetNumRTSPHTTPSessions() { return ClampGauge(OSCounters::Get(kRTSPHTTPSessionsCounter)); }
 
-	UInt32              GetTotalRTPSessions() { return fTotalRTPSessions; }
-	UInt32              GetNumRTPPlayingSessions() { return fNumRTPPlayingSessions; }
+	UInt32              GetTotalRTPSessions() { return (UInt32)OSCounters::Get(kTotalRTPSessionsCounter); }
+	UInt32              GetNumRTPPlayingSessions() { return ClampGauge(OSCounters::Get(kRTPPlayingSessionsCounter)); }
 
 	UInt32              GetCurBandwidthInBits() { return fCurrentRTPBandwidthInBits; }
 	UInt32              GetAvgBandwidthInBits() { return fAvgRTPBandwidthInBits; }
@@ -211,11 +254,14 @@ public:
 	void                SetDebugLevel(UInt32 debugLevel) { fDebugLevel = debugLevel; }
 	void                SetDebugOptions(UInt32 debugOptions) { fDebugOptions = debugOptions; }
 
-	SInt64				GetMaxLate() { return fMaxLate; };
-	SInt64				GetTotalLate() { return fTotalLate; };
-	SInt64				GetCurrentMaxLate() { return fCurrentMaxLate; };
-	SInt64				GetTotalQuality() { return fTotalQuality; };
-	SInt32				GetNumThinned() { return fNumThinned; };
+	SInt64				GetMaxLate() { return OSCounters::GetMax(kMaxLateCounter); };
+	SInt64				GetTotalLate() { return OSCounters::Get(kTotalLateCounter) - fTotalLateCleared; };
+	SInt64				GetCurrentMaxLate() { return OSCounters::GetMax(kCurrentMaxLateCounter); };
+	SInt64				GetTotalQuality() { return OSCounters::Get(kTotalQualityCounter) - fTotalQualityCleared; };
+	SInt32				GetNumThinned() { return (SInt32)OSCounters::Get(kNumThinnedCounter); };
+
+	// Writes the server statistics in the Prometheus text format
+	void				WriteMetrics(StringFormatter* ioOut);
 	UInt32				GetNumThreads() { return fNumThreads; };
 
 	//
@@ -369,6 +415,8 @@ private:
 
 	static void* TimeConnected(QTSSDictionary* inConnection, UInt32* outLen);
 
+	static UInt32       ClampGauge(SInt64 inSum) { return (inSum > 0) ? (UInt32)inSum : 0; }
+
 	static UInt32       sServerAPIVersion;
 	static StrPtrLen    sServerNameStr;
 	static StrPtrLen    sServerVersionStr;
@@ -381,6 +429,8 @@ private:
 
 	OSMutex             fMutex;
 
+	//Storage for the session count attributes; the live values are in OSCounters
+	//and the param retrieval functions copy them here.
 	UInt32              fNumRTSPSessions;
 	UInt32              fNumRTSPHTTPSessions;
 	UInt32              fNumRTPSessions;
@@ -390,6 +440,8 @@ private:
 
 	//stores the total number of connections since startup.
 	UInt32              fTotalRTPSessions;
+
+	//Totals since startup, brought up to date from OSCounters by RTPStatsUpdaterTask.
 	//stores the total number of bytes served since startup
 	UInt64              fTotalRTPBytes;
 	//total number of rtp packets sent since startup
@@ -397,16 +449,6 @@ private:
 	//stores the total number of bytes lost (as reported by clients) since startup
 	UInt64              fTotalRTPPacketsLost;
 
-	//because there is no 64 bit atomic add (for obvious reasons), we efficiently
-	//implement total byte counting by atomic adding to this variable, then every
-	//once in awhile updating the sTotalBytes.
-	
-	unsigned int        fPeriodicRTPBytes;
-
-	unsigned int        fPeriodicRTPPacketsLost;
-
-	unsigned int        fPeriodicRTPPackets;
-
 	//stores the current served bandwidth in BITS per second
 	UInt32              fCurrentRTPBandwidthInBits;
 	UInt32              fAvgRTPBandwidthInBits;
@@ -436,19 +478,37 @@ private:
 	UInt32              fDebugOptions;
 
 
-	SInt64          fMaxLate;
-	SInt64          fTotalLate;
-	SInt64          fCurrentMaxLate;
-	SInt64          fTotalQuality;
+	//counter values at the last ClearTotalLate and ClearTotalQuality
+	SInt64          fTotalLateCleared;
+	SInt64          fTotalQualityCleared;
 	SInt32          fNumThinned;
 	UInt32          fNumThreads;
 
+	// Storage for the file block cache stats
+	Float32         fFileCacheHitPercent;
+	UInt64          fFileCacheBytesSaved;
+	UInt64          fFileCacheEvictions;
+
+	// Storage for the parsed movie cache stats
+	Float32         fMovieCacheHitPercent;
+	Float32         fMovieCacheAvgOpenMsec;
+
 	// Param retrieval functions
 	static void* CurrentUnixTimeMilli(QTSSDictionary* inServer, UInt32* outLen);
 	static void* GetTotalUDPSockets(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetNumRTSPSessions(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetNumRTSPHTTPSessions(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetNumRTPSessions(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetTotalRTPSessions(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetNumThinned(QTSSDictionary* inServer, UInt32* outLen);
 	static void* IsOutOfDescriptors(QTSSDictionary* inServer, UInt32* outLen);
 	static void* GetNumUDPBuffers(QTSSDictionary* inServer, UInt32* outLen);
 	static void* GetNumWastedBytes(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetFileCacheHitPercent(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetFileCacheBytesSaved(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetFileCacheEvictions(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetMovieCacheHitPercent(QTSSDictionary* inServer, UInt32* outLen);
+	static void* GetMovieCacheAvgOpenMsec(QTSSDictionary* inServer, UInt32* outLen);
 
 	static QTSServerInterface*  sServer;
 	static QTSSAttrInfoDict::AttrInfo   sAttributes[];
@@ -182,7 +182,16 @@ QTSServerPrefs::PrefInfo QTSServerPrefs::sPrefInfo[] =
 	{ kDontAllowMultipleValues, "10008",     NULL					 }, //service_wan_port
 
 	{ kDontAllowMultipleValues, "0.0.0.0",	NULL					 }, //service_wan_ip
-	{ kDontAllowMultipleValues, "10554",	NULL					 }	//rtsp_wan_port
+	{ kDontAllowMultipleValues, "10554",	NULL					 },	//rtsp_wan_port
+
+	{ kDontAllowMultipleValues, "0",		NULL					 },	//run_num_event_threads
+	{ kDontAllowMultipleValues, "false",		NULL					 },	//enable_work_stealing_scheduler
+	{ kDontAllowMultipleValues, "10",		NULL					 },	//run_task_min_wait_msec
+	{ kDontAllowMultipleValues, "32",		NULL					 },	//udp_send_batch_size
+	{ kDontAllowMultipleValues, "true",		NULL					 },	//enable_udp_gso
+	{ kDontAllowMultipleValues, "true",		NULL					 },	//enable_async_logs
+	{ kDontAllowMultipleValues, "256",		NULL					 },	//async_log_buffer_kbytes
+	{ kDontAllowMultipleValues, "false",		NULL					 }	//async_log_drop_when_full
 };
 
 QTSSAttrInfoDict::AttrInfo  QTSServerPrefs::sAttributes[] =
@@ -274,7 +283,16 @@ QTSSAttrInfoDict::AttrInfo  QTSServerPrefs::sAttributes[] =
 	/* 83 */ { "service_wan_port",						NULL,                   qtssAttrDataTypeUInt16,     qtssAttrModeRead | qtssAttrModeWrite },
 
 	/* 84 */ { "service_wan_ip",						NULL,                   qtssAttrDataTypeCharArray,  qtssAttrModeRead | qtssAttrModeWrite },
-	/* 85 */ { "rtsp_wan_port",							NULL,                   qtssAttrDataTypeUInt16,     qtssAttrModeRead | qtssAttrModeWrite }
+	/* 85 */ { "rtsp_wan_port",							NULL,                   qtssAttrDataTypeUInt16,     qtssAttrModeRead | qtssAttrModeWrite },
+
+	/* 86 */ { "run_num_event_threads",					NULL,                   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 87 */ { "enable_work_stealing_scheduler",					NULL,                   qtssAttrDataTypeBool16,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 88 */ { "run_task_min_wait_msec",					NULL,                   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 89 */ { "udp_send_batch_size",					NULL,                   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 90 */ { "enable_udp_gso",					NULL,                   qtssAttrDataTypeBool16,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 91 */ { "enable_async_logs",					NULL,                   qtssAttrDataTypeBool16,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 92 */ { "async_log_buffer_kbytes",				NULL,                   qtssAttrDataTypeUInt32,     qtssAttrModeRead | qtssAttrModeWrite },
+	/* 93 */ { "async_log_drop_when_full",				NULL,                   qtssAttrDataTypeBool16,     qtssAttrModeRead | qtssAttrModeWrite }
 };
 
 
@@ -350,7 +368,15 @@ QTSServerPrefs::QTSServerPrefs(XMLPrefsParser* inPrefsSource, bool inWriteMissin
 	fAllowGuestAuthorizeDefault(true),
 	fServiceLANPort(10008),
 	fServiceWANPort(10008),
-	fRTSPWANPort(10554)
+	fRTSPWANPort(10554),
+	fNumEventThreads(0),
+	fEnableWorkStealing(false),
+	fTaskMinWaitMSec(10),
+	fUDPSendBatchSize(32),
+	fEnableUDPGSO(true),
+	fEnableAsyncLogs(true),
+	fAsyncLogBufferKBytes(256),
+	fAsyncLogDropWhenFull(false)
 {
 	SetupAttributes();
 	RereadServerPreferences(inWriteMissingPrefs);
@@ -444,6 +470,15 @@ void QTSServerPrefs::SetupAttributes()
 
 	this->SetVal(easyPrefsServiceWANIPAddr, &fRTSPWANAddr, sizeof(fRTSPWANAddr));
 	this->SetVal(easyPrefsRTSPWANPort, &fRTSPWANPort, sizeof(fRTSPWANPort));
+
+	this->SetVal(qtssPrefsNumEventThreads, &fNumEventThreads, sizeof(fNumEventThreads));
+	this->SetVal(qtssPrefsEnableWorkStealing, &fEnableWorkStealing, sizeof(fEnableWorkStealing));
+	this->SetVal(qtssPrefsTaskMinWaitTime, &fTaskMinWaitMSec, sizeof(fTaskMinWaitMSec));
+	this->SetVal(qtssPrefsUDPSendBatchSize, &fUDPSendBatchSize, sizeof(fUDPSendBatchSize));
+	this->SetVal(qtssPrefsEnableUDPGSO, &fEnableUDPGSO, sizeof(fEnableUDPGSO));
+	this->SetVal(qtssPrefsEnableAsyncLogs, &fEnableAsyncLogs, sizeof(fEnableAsyncLogs));
+	this->SetVal(qtssPrefsAsyncLogBufferKBytes, &fAsyncLogBufferKBytes, sizeof(fAsyncLogBufferKBytes));
+	this->SetVal(qtssPrefsAsyncLogDropWhenFull, &fAsyncLogDropWhenFull, sizeof(fAsyncLogDropWhenFull));
 }
 
 
@@ -568,6 +603,7 @@ void QTSServerPrefs::RereadServerPreferences(bool inWriteMissingPrefs)
 	QTSSModuleUtils::SetEnableRTSPErrorMsg(fEnableRTSPErrMsg);
 
 	QTSSRollingLog::SetCloseOnWrite(fCloseLogsOnWrite);
+	QTSSRollingLog::SetAsyncWrites(fEnableAsyncLogs, fAsyncLogBufferKBytes, fAsyncLogDropWhenFull);
 	//
 	// In case we made any changes, write out the prefs file
 	(void)fPrefsSource->WritePrefsFile();
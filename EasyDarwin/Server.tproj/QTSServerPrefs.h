@@ -207,6 +207,11 @@ public:
 
 	UInt32  GetNumThreads() { return fNumThreads; } //short tasks threads
 	UInt32  GetNumBlockingThreads() { return fNumRTSPThreads; } //return the number of threads that long tasks will be scheduled on -- RTSP processing for example.
+	UInt32  GetNumEventThreads() { return fNumEventThreads; } //number of epoll event threads, 0 means one per short task thread
+	bool    GetWorkStealingEnabled() { return fEnableWorkStealing; } //per-thread run queues with work stealing
+	UInt32  GetTaskMinWaitMSec() { return fTaskMinWaitMSec; } //timer resolution of the task threads
+	UInt32  GetUDPSendBatchSize() { return fUDPSendBatchSize; } //packets per sendmmsg() call
+	bool    GetUDPGSOEnabled() { return fEnableUDPGSO; } //UDP generic segmentation offload on batched sends
 
 	bool  GetDisableThinning() { return fDisableThinning; }
 
@@ -319,6 +324,15 @@ private:
 	char   fRTSPWANAddr[20];
 	UInt16 fRTSPWANPort;
 
+	UInt32 fNumEventThreads;
+	bool fEnableWorkStealing;
+	UInt32 fTaskMinWaitMSec;
+	UInt32 fUDPSendBatchSize;
+	bool fEnableUDPGSO;
+	bool fEnableAsyncLogs;
+	UInt32 fAsyncLogBufferKBytes;
+	bool fAsyncLogDropWhenFull;
+
 	enum //fPacketHeaderPrintfOptions
 	{
 		kRTPALL = 1 << 0,
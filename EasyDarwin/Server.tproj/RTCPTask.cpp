@@ -35,64 +35,53 @@
 
 SInt64 RTCPTask::Run()
 {
-	const UInt32 kMaxRTCPPacketSize = 2048;
-	char thePacketBuffer[kMaxRTCPPacketSize];
-	StrPtrLen thePacket(thePacketBuffer, 0);
 	QTSServerInterface* theServer = QTSServerInterface::GetServer();
 
-	//This task goes through all the UDPSockets in the RTPSocketPool, checking to see
-	//if they have data. If they do, it demuxes the packets and sends the packet onto
-	//the proper RTP session.
+	//The RTCP sockets that became readable are on fReadyQueue. Drain each of them with
+	//batched reads, demux the packets and send each one onto the proper RTP stream.
 	EventFlags events = this->GetEvents(); // get and clear events
 
 	if ((events & Task::kReadEvent) || (events & Task::kIdleEvent))
 	{
-		//Must be done atomically wrt the socket pool.
-
+		//Must be done atomically wrt the socket pool, sockets are only deleted under its mutex.
 		OSMutexLocker locker(theServer->GetSocketPool()->GetMutex());
-		for (OSQueueIter iter(theServer->GetSocketPool()->GetSocketQueue());
-			!iter.IsDone(); iter.Next())
+
+		for (UInt32 x = 0; x < kRecvBatchSize; x++)
+		{
+			fPackets[x].fBuffer = fPacketBuffers[x];
+			fPackets[x].fBufferLen = kMaxRTCPPacketSize;
+		}
+
+		for (OSQueueElem* theElem = fReadyQueue.DeQueue(); theElem != NULL; theElem = fReadyQueue.DeQueue())
 		{
-			UInt32 theRemoteAddr = 0;
-			UInt16 theRemotePort = 0;
+			UDPSocket* theSocket = (UDPSocket*)theElem->GetEnclosingObject();
+			Assert(theSocket != NULL);
 
-			UDPSocketPair* thePair = (UDPSocketPair*)iter.GetCurrent()->GetEnclosingObject();
-			Assert(thePair != NULL);
+			UDPDemuxer* theDemuxer = theSocket->GetDemuxer();
+			if (theDemuxer == NULL)
+				continue;
 
-			for (UInt32 x = 0; x < 2; x++)
+			OSMutexLocker demuxLocker(theDemuxer->GetMutex());
+			while (true) //get all the outstanding packets for this socket
 			{
-				UDPSocket* theSocket = NULL;
-				if (x == 0)
-					theSocket = thePair->GetSocketA();
-				else
-					theSocket = thePair->GetSocketB();
+				UInt32 theNumPackets = 0;
+				(void)theSocket->RecvBatch(fPackets, kRecvBatchSize, &theNumPackets);
 
-				UDPDemuxer* theDemuxer = theSocket->GetDemuxer();
-				if (theDemuxer == NULL)
-					continue;
-				else
+				for (UInt32 y = 0; y < theNumPackets; y++)
 				{
-					theDemuxer->GetMutex()->Lock();
-					while (true) //get all the outstanding packets for this socket
-					{
-						thePacket.Len = 0;
-						theSocket->RecvFrom(&theRemoteAddr, &theRemotePort, thePacket.Ptr,
-							kMaxRTCPPacketSize, &thePacket.Len);
-						if (thePacket.Len == 0)
-						{
-							theSocket->RequestEvent(EV_RE);
-							break;//no more packets on this socket!
-						}
+					StrPtrLen thePacket((char*)fPackets[y].fBuffer, fPackets[y].fLength);
+					if (thePacket.Len == 0)
+						continue;
+
+					RTPStream* theStream = (RTPStream*)theDemuxer->GetTask(fPackets[y].fRemoteAddr, fPackets[y].fRemotePort);
+					if (theStream != NULL)
+						theStream->ProcessIncomingRTCPPacket(&thePacket);
+				}
 
-						//if this socket has a demuxer, find the target RTPStream
-						if (theDemuxer != NULL)
-						{
-							RTPStream* theStream = (RTPStream*)theDemuxer->GetTask(theRemoteAddr, theRemotePort);
-							if (theStream != NULL)
-								theStream->ProcessIncomingRTCPPacket(&thePacket);
-						}
-					}
-					theDemuxer->GetMutex()->Unlock();
+				if (theNumPackets < kRecvBatchSize)
+				{
+					theSocket->RequestEvent(EV_RE);
+					break;//no more packets on this socket!
 				}
 			}
 		}
@@ -35,17 +35,31 @@
 #define __RTCP_TASK_H__
 
 #include "Task.h"
+#include "OSQueue.h"
+#include "UDPSocket.h"
 
 class RTCPTask : public Task
 {
 public:
-	//This task handles all incoming RTCP data. It just polls, so make sure
-	//to start the polling process by signalling a start event.
+	//This task handles all incoming RTCP data. The RTCP sockets put themselves
+	//on the ready queue when they become readable, and the task only reads those.
 	RTCPTask() : Task() { this->SetTaskName("RTCPTask"); this->Signal(Task::kStartEvent); }
 	virtual ~RTCPTask() {}
 
+	OSQueue*    GetReadyQueue() { return &fReadyQueue; }
+
 private:
 	virtual SInt64 Run();
+
+	enum
+	{
+		kMaxRTCPPacketSize = 2048,                          //UInt32
+		kRecvBatchSize = UDPSocket::kMaxRecvBatchSize       //UInt32
+	};
+
+	OSQueue         fReadyQueue;
+	UDPRecvPacket   fPackets[kRecvBatchSize];
+	char            fPacketBuffers[kRecvBatchSize][kMaxRTCPPacketSize];
 };
 
 #endif //__RTCP_TASK_H__
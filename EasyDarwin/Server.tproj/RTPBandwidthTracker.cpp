@@ -166,6 +166,32 @@ void RTPBandwidthTracker::AdjustWindowForRetransmit()
 	fIsRetransmitting = true;
 }
 
+bool RTPBandwidthTracker::CanRetransmit(UInt32 inNumBytes, UInt32 inSendBitsPerSec, SInt64 inCurTime)
+{
+	if (this->ReadyForAckProcessing() && this->IsFlowControlled())
+		return false;
+
+	SInt64 bytesPerSec = ((SInt64)inSendBitsPerSec / 8) * kRetransmitPercent / 100;
+	if (bytesPerSec < kMinRetransmitBytesPerSec)
+		bytesPerSec = kMinRetransmitBytesPerSec;
+
+	SInt64 maxBudget = bytesPerSec * kRetransmitBurstMSec / 1000;
+	if (fLastRetransmitTime == 0)
+		fRetransmitBudget = maxBudget;
+	else if (inCurTime > fLastRetransmitTime)
+		fRetransmitBudget += bytesPerSec * (inCurTime - fLastRetransmitTime) / 1000;
+
+	if (fRetransmitBudget > maxBudget)
+		fRetransmitBudget = maxBudget;
+	fLastRetransmitTime = inCurTime;
+
+	if (fRetransmitBudget < (SInt64)inNumBytes)
+		return false;
+
+	fRetransmitBudget -= inNumBytes;
+	return true;
+}
+
 void RTPBandwidthTracker::AddToRTTEstimate(SInt32 rttSampleMSecs)
 {
 	//  qtss_printf("%d ", rttSampleMSecs);
@@ -63,7 +63,9 @@ public:
 		fMinRTO(24000),
 		fTotalCongestionWindowSize(0),
 		fTotalRTO(0),
-		fNumStatsSamples(0)
+		fNumStatsSamples(0),
+		fRetransmitBudget(0),
+		fLastRetransmitTime(0)
 	{}
 
 	~RTPBandwidthTracker() {}
@@ -95,6 +97,14 @@ public:
 	// the tracker can adjust the window sizes and back off.
 	void AdjustWindowForRetransmit();
 
+	//
+	// Before sending a packet again because the client NACKed it (RFC 4585), ask
+	// the tracker whether there is room. Retransmissions get kRetransmitPercent of
+	// inSendBitsPerSec, the rate the client is being sent at, but no less than
+	// kMinRetransmitBytesPerSec. Unused room is saved up for kRetransmitBurstMSec.
+	// A client that acks must also have room in its congestion window.
+	bool CanRetransmit(UInt32 inNumBytes, UInt32 inSendBitsPerSec, SInt64 inCurTime);
+
 	//
 	// ACCESSORS
 	const bool ReadyForAckProcessing() { return (fClientWindow > 0 && fCongestionWindow > 0); } // see RTPBandwidthTracker::EmptyWindow for requirements
@@ -132,7 +142,11 @@ public:
 		// is currently not too sophisticated. This could probably be made
 		// better. During slow start, we just use 20, and afterwards, just use 100
 		kMinAckTimeout = 20,
-		kMaxAckTimeout = 100
+		kMaxAckTimeout = 100,
+
+		kRetransmitPercent = 25,
+		kMinRetransmitBytesPerSec = 8000,
+		kRetransmitBurstMSec = 2000
 	};
 
 private:
@@ -167,6 +181,11 @@ private:
 	SInt64              fTotalRTO;
 	SInt32              fNumStatsSamples;
 
+	//
+	// Room for retransmissions, see CanRetransmit
+	SInt64              fRetransmitBudget;
+	SInt64              fLastRetransmitTime;
+
 	enum
 	{
 		kMinRetransmitIntervalMSecs = 600,
@@ -519,6 +519,10 @@ SInt64 RTPSession::Run()
 				return kCantGetMutexIdleTime;
 			}
 
+			// Whatever the modules hung off our RTSP session for pushed data goes away with us
+			if (fRTSPSession != NULL)
+				fRTSPSession->ClearIngestHandler(this);
+
 			// The ClientSessionClosing role is allowed to do async stuff
 			fModuleState.curTask = this;
 			fModuleDoingAsyncStuff = true;  // So that we know to jump back to the
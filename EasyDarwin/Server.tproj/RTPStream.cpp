@@ -894,6 +894,42 @@ QTSS_Error RTPStream::ReliableRTPWrite(void* inBuffer, UInt32 inLen, const SInt6
 	return err;
 }
 
+//RetransmitWrite must be called from a fSession mutex protected caller
+QTSS_Error RTPStream::RetransmitWrite(void* inBuffer, UInt32 inLen, UInt32 inFlags, const SInt64& inCurTime)
+{
+	//
+	// TCP doesn't lose packets, and reliable UDP clients have fResender.
+	if ((fTransportType != qtssRTPTransportTypeUDP) || (inLen == 0))
+		return QTSS_NoErr;
+
+	//
+	// A packet sent again was due long ago, so it skips the overbuffer window and
+	// thinning. Only the bandwidth tracker holds it back.
+	if (!fSession->GetBandwidthTracker()->CanRetransmit(inLen, fSession->GetCurrentMovieBitRate(), inCurTime))
+		return QTSS_WouldBlock;
+
+	OS_Error theSendErr = OS_NoErr;
+	if (inFlags & qtssWriteFlagsBufferData)
+		theSendErr = fSockets->GetSocketA()->QueueSendTo(fRemoteAddr, fRemoteRTPPort, inBuffer, inLen);
+	else
+		theSendErr = fSockets->GetSocketA()->SendTo(fRemoteAddr, fRemoteRTPPort, inBuffer, inLen);
+
+	// A lost retransmit is not retried, the client asks again
+	if (theSendErr != OS_NoErr)
+		return QTSS_NoErr;
+
+	this->UDPMonitorWrite(inBuffer, inLen, kIsRTPPacket);
+	this->PrintPacketPrefEnabled((char*)inBuffer, inLen, (SInt32)RTPStream::rtp);
+
+	// fPacketCount is left alone, it is what receiver reports count losses against
+	fSession->UpdatePacketsSent(1);
+	fSession->UpdateBytesSent(inLen);
+	QTSServerInterface::GetServer()->IncrementTotalRTPBytes(inLen);
+	QTSServerInterface::GetServer()->IncrementTotalRetransmits();
+
+	return QTSS_NoErr;
+}
+
 void RTPStream::SetThinningParams()
 {
 	SInt32 toleranceAdjust = 1500 - (SInt32(fLateToleranceInSec * 1000));
@@ -1053,6 +1089,7 @@ QTSS_Error  RTPStream::Write(void* inBuffer, UInt32 inLen, UInt32* outLenWritten
 
 
 	QTSS_Error err = QTSS_NoErr;
+	OS_Error theSendErr = OS_NoErr;// a UDP packet that did not go out is dropped, not retried
 	SInt64 theTime = OS::Milliseconds();
 
 	//
@@ -1102,16 +1139,24 @@ QTSS_Error  RTPStream::Write(void* inBuffer, UInt32 inLen, UInt32* outLenWritten
 		}
 		else if (inLen > 0)
 		{
-			(void)this->fSockets->GetSocketB()->SendTo(fRemoteAddr, fRemoteRTCPPort, thePacket->packetData, inLen);
+			if (inFlags & qtssWriteFlagsBufferData)
+				theSendErr = this->fSockets->GetSocketB()->QueueSendTo(fRemoteAddr, fRemoteRTCPPort, thePacket->packetData, inLen);
+			else
+				theSendErr = this->fSockets->GetSocketB()->SendTo(fRemoteAddr, fRemoteRTCPPort, thePacket->packetData, inLen);
 
-			this->UDPMonitorWrite(thePacket->packetData, inLen, kIsRTCPPacket);
+			if (theSendErr == OS_NoErr)
+				this->UDPMonitorWrite(thePacket->packetData, inLen, kIsRTCPPacket);
 
 		}
 
 
-		if (err == QTSS_NoErr)
+		if (err == QTSS_NoErr && theSendErr == OS_NoErr)
 			this->PrintPacketPrefEnabled((char*)thePacket->packetData, inLen, (SInt32)RTPStream::rtcpSR);
 	}
+	else if ((inFlags & qtssWriteFlagsIsRTP) && (inFlags & qtssWriteFlagsIsRetransmission))
+	{
+		err = this->RetransmitWrite(thePacket->packetData, inLen, inFlags, theTime);
+	}
 	else if (inFlags & qtssWriteFlagsIsRTP)
 	{
 		{   //
@@ -1142,12 +1187,16 @@ QTSS_Error  RTPStream::Write(void* inBuffer, UInt32 inLen, UInt32* outLenWritten
 				err = this->ReliableRTPWrite(thePacket->packetData, inLen, theCurrentPacketDelay);
 			else if (inLen > 0)
 			{
-				(void)fSockets->GetSocketA()->SendTo(fRemoteAddr, fRemoteRTPPort, thePacket->packetData, inLen);
+				if (inFlags & qtssWriteFlagsBufferData)
+					theSendErr = fSockets->GetSocketA()->QueueSendTo(fRemoteAddr, fRemoteRTPPort, thePacket->packetData, inLen);
+				else
+					theSendErr = fSockets->GetSocketA()->SendTo(fRemoteAddr, fRemoteRTPPort, thePacket->packetData, inLen);
 
-				this->UDPMonitorWrite(thePacket->packetData, inLen, kIsRTPPacket);
+				if (theSendErr == OS_NoErr)
+					this->UDPMonitorWrite(thePacket->packetData, inLen, kIsRTPPacket);
 			}
 
-			if (err == QTSS_NoErr)
+			if (err == QTSS_NoErr && theSendErr == OS_NoErr)
 				this->PrintPacketPrefEnabled((char*)thePacket->packetData, inLen, (SInt32)RTPStream::rtp);
 
 			UInt16* theSeqNumP = (UInt16*)thePacket->packetData;
@@ -1204,7 +1253,7 @@ QTSS_Error  RTPStream::Write(void* inBuffer, UInt32 inLen, UInt32* outLenWritten
 #endif
 		//if (err != QTSS_NoErr)
 		//  qtss_printf("flow controlled\n");
-		if (err == QTSS_NoErr && inLen > 0)
+		if (err == QTSS_NoErr && theSendErr == OS_NoErr && inLen > 0)
 		{
 			// Update statistics if we were actually able to send the data (don't
 			// update if the socket is flow controlled or some such thing)
@@ -1473,6 +1522,9 @@ void RTPStream::ProcessIncomingRTCPPacket(StrPtrLen* inPacket)
 	bool hasPacketLoss = false;
 	UInt32 highestSeqNum = 0;
 	bool hasNADU = false;
+	UInt16 lostSeqNums[kMaxLostSeqNums];
+	UInt32 numLostSeqNums = 0;
+	bool keyFrameRequested = false;
 
 	// Modules are guarenteed atomic access to the session. Also, the RTSP Session accessed
 	// below could go away at any time. So we need to lock the RTP session mutex.
@@ -1635,6 +1687,37 @@ void RTPStream::ProcessIncomingRTCPPacket(StrPtrLen* inPacket)
 			}
 			break;
 
+		case RTCPPacket::kRTPFeedbackPacketType:
+		case RTCPPacket::kPayloadFeedbackPacketType:
+			{
+				DEBUG_RTCP_PRINTF(("RTPStream::ProcessIncomingRTCPPacket kFeedbackPacketType\n"));
+				RTCPFeedbackPacket feedbackPacket;
+				if (!feedbackPacket.ParseFeedback((UInt8*)currentPtr.Ptr, currentPtr.Len))
+				{
+					fSession->GetSessionMutex()->Unlock();
+					return;//abort if we discover a malformed feedback packet
+				}
+
+				//
+				// The RTCP modules answer these, see QTSS_RTCPProcess_Params
+				if (feedbackPacket.IsGenericNACK())
+				{
+					UInt32 numNACKed = feedbackPacket.GetLostSeqNums(&lostSeqNums[numLostSeqNums], kMaxLostSeqNums - numLostSeqNums);
+					QTSServerInterface::GetServer()->IncrementTotalNACKedPackets(numNACKed);
+					numLostSeqNums += numNACKed;
+				}
+				else if (feedbackPacket.IsKeyFrameRequest())
+				{
+					QTSServerInterface::GetServer()->IncrementTotalKeyFrameRequests();
+					keyFrameRequested = true;
+				}
+
+#ifdef DEBUG_RTCP_PACKETS
+				feedbackPacket.Dump();
+#endif
+			}
+			break;
+
 		case RTCPPacket::kSDESPacketType:
 			{
 				DEBUG_RTCP_PRINTF(("RTPStream::ProcessIncomingRTCPPacket kSDESPacketType\n"));
@@ -1671,6 +1754,9 @@ void RTPStream::ProcessIncomingRTCPPacket(StrPtrLen* inPacket)
 	theParams.rtcpProcessParams.inClientSession = fSession;
 	theParams.rtcpProcessParams.inRTCPPacketData = inPacket->Ptr;
 	theParams.rtcpProcessParams.inRTCPPacketDataLen = inPacket->Len;
+	theParams.rtcpProcessParams.inLostSeqNums = lostSeqNums;
+	theParams.rtcpProcessParams.inNumLostSeqNums = numLostSeqNums;
+	theParams.rtcpProcessParams.inKeyFrameRequested = keyFrameRequested;
 
 	// We don't allow async events from this role, so just set an empty module state.
 	OSThreadDataSetter theSetter(&sRTCPProcessModuleState, NULL);
@@ -94,9 +94,16 @@ class RTPStream : public QTSSDictionary, public UDPDemuxerTask
         
         // Write sends RTP data to the client. Caller must specify
         // either qtssWriteFlagsIsRTP or qtssWriteFlagsIsRTCP
+        //
+        // Over UDP, qtssWriteFlagsBufferData queues the packet on this thread's
+        // UDP send batch instead of sending it. The packet data must stay valid
+        // until Flush() (or UDPSocket::FlushSendBatch()) runs on the same thread.
         virtual QTSS_Error  Write(void* inBuffer, UInt32 inLen,
                                         UInt32* outLenWritten, QTSS_WriteFlags inFlags);
         
+        // Sends everything this thread has queued with qtssWriteFlagsBufferData
+        virtual QTSS_Error  Flush() { UDPSocket::FlushSendBatch(); return QTSS_NoErr; }
+        
         
         //UTILITY FUNCTIONS:
         //These are not necessary to call and do not manipulate the state of the
@@ -184,6 +191,7 @@ class RTPStream : public QTSSDictionary, public UDPDemuxerTask
             kSenderReportIntervalInSecs = 7,
             kNumPrebuiltChNums          = 10,
             kMaxQualityLevel            = 0,
+            kMaxLostSeqNums             = 256,  // NACKed packets passed to the RTCP modules per RTCP packet
             kIsRTCPPacket                 = TRUE,
             kIsRTPPacket                  = FALSE
         };
@@ -351,6 +359,9 @@ class RTPStream : public QTSSDictionary, public UDPDemuxerTask
         // implements the ReliableRTP protocol
         QTSS_Error  ReliableRTPWrite(void* inBuffer, UInt32 inLen, const SInt64& curPacketDelay);
 
+        // sends a packet the client NACKed again, see qtssWriteFlagsIsRetransmission
+        QTSS_Error  RetransmitWrite(void* inBuffer, UInt32 inLen, UInt32 inFlags, const SInt64& inCurTime);
+
          
         void        SetTCPThinningParams();
         QTSS_Error  TCPWrite(void* inBuffer, UInt32 inLen, UInt32* outLenWritten, UInt32 inFlags);
@@ -462,6 +462,8 @@ void RTSPRequest::ParseTransportHeader()
 				{
 					if (theTransportSubHeader.EqualIgnoreCase("RTP/AVP/TCP"))
 						fTransportType = qtssRTPTransportTypeTCP;
+					else if (theTransportSubHeader.EqualIgnoreCase("RTP/AVP/UDP"))
+						fTransportType = qtssRTPTransportTypeUDP;   // TCP stays the default, UDP only on request
 					break;
 				}
 			case 'c':   //client_port sub-header
@@ -42,6 +42,9 @@ RTSPRequestStream::RTSPRequestStream(TCPSocket* sock)
 	: fSocket(sock),
 	fRetreatBytes(0),
 	fRetreatBytesRead(0),
+	fReadBuffer(fRequestBuffer),
+	fReadBufferSize(kRequestBufferSizeInBytes),
+	fWantBufferSize(0),
 	fCurOffset(0),
 	fEncodedBytesRemaining(0),
 	fRequest(fRequestBuffer, 0),
@@ -76,7 +79,9 @@ QTSS_Error RTSPRequestStream::ReadRequest()
 			fRequestPtr = NULL;//flag that we no longer have a complete request
 
 			// Take all the retreated leftover data and move it to the beginning of the buffer
-			if ((fRetreatBytes > 0) && (fRequest.Len > 0))
+			if ((fWantBufferSize > fReadBufferSize) && !fDecode)
+				this->GrowBuffer();
+			else if ((fRetreatBytes > 0) && (fRequest.Len > 0))
 				::memmove(fRequest.Ptr, fRequest.Ptr + fRequest.Len + fRetreatBytesRead, fRetreatBytes);
 
 			// if we are decoding, we need to also move over the remaining encoded bytes
@@ -120,8 +125,8 @@ QTSS_Error RTSPRequestStream::ReadRequest()
 			else
 			{
 				// We don't have any new data, get some from the socket...
-				QTSS_Error sockErr = fSocket->Read(&fRequestBuffer[fCurOffset],
-					(kRequestBufferSizeInBytes - fCurOffset) - 1, &newOffset);
+				QTSS_Error sockErr = fSocket->Read(&fReadBuffer[fCurOffset],
+					(fReadBufferSize - fCurOffset) - 1, &newOffset);
 				//assume the client is dead if we get an error back
 				if (sockErr == EAGAIN)
 					return QTSS_NoErr;
@@ -147,7 +152,7 @@ QTSS_Error RTSPRequestStream::ReadRequest()
 			}
 			else
 				fRequest.Len += newOffset;
-			Assert(fRequest.Len < kRequestBufferSizeInBytes);
+			Assert(fRequest.Len < fReadBufferSize);
 			fCurOffset += newOffset;
 		}
 		Assert(newOffset > 0);
@@ -260,7 +265,7 @@ QTSS_Error RTSPRequestStream::ReadRequest()
 		}
 
 		//check for a full buffer
-		if (fCurOffset == kRequestBufferSizeInBytes - 1)
+		if (fCurOffset == fReadBufferSize - 1)
 		{
 			fRequestPtr = &fRequest;
 			return E2BIG;
@@ -268,6 +273,49 @@ QTSS_Error RTSPRequestStream::ReadRequest()
 	}
 }
 
+UInt32 RTSPRequestStream::GetDataPackets(StrPtrLen* outPackets, UInt32 inMaxPackets)
+{
+	Assert(fIsDataPacket && (fRequestPtr != NULL));
+	Assert(fRetreatBytesRead == 0);
+	if (inMaxPackets == 0)
+		return 0;
+
+	outPackets[0] = fRequest;
+	UInt32 theNumPackets = 1;
+
+	char* theNextPacket = fRequest.Ptr + fRequest.Len;
+	while ((theNumPackets < inMaxPackets) && (fRetreatBytes >= 4) && ('$' == *theNextPacket))
+	{
+		UInt16 theDataLen = 0;
+		::memcpy(&theDataLen, &theNextPacket[2], sizeof(theDataLen));
+		UInt32 theInterleavedPacketLen = ntohs(theDataLen) + 4;
+		if (theInterleavedPacketLen > fRetreatBytes)
+			break;
+
+		outPackets[theNumPackets++].Set(theNextPacket, theInterleavedPacketLen);
+		theNextPacket += theInterleavedPacketLen;
+		fRequest.Len += theInterleavedPacketLen;
+		fRetreatBytes -= theInterleavedPacketLen;
+	}
+
+	return theNumPackets;
+}
+
+void RTSPRequestStream::GrowBuffer()
+{
+	Assert(fEncodedBytesRemaining == 0);
+
+	char* theNewBuffer = new char[fWantBufferSize];
+	if (fRetreatBytes > 0)
+		::memcpy(theNewBuffer, fRequest.Ptr + fRequest.Len + fRetreatBytesRead, fRetreatBytes);
+
+	// fRequest.Ptr now owns the buffer, the destructor frees it
+	if (fRequest.Ptr != &fRequestBuffer[0])
+		delete[] fRequest.Ptr;
+	fRequest.Ptr = fReadBuffer = theNewBuffer;
+	fReadBufferSize = fWantBufferSize;
+}
+
 QTSS_Error RTSPRequestStream::Read(void* ioBuffer, UInt32 inBufLen, UInt32* outLengthRead)
 {
 	UInt32 theLengthRead = 0;
@@ -84,6 +84,22 @@ public:
 		//RequestArrived).
 	StrPtrLen*  GetRequestBuffer() { return fRequestPtr; }
 	bool      IsDataPacket() { return fIsDataPacket; }
+
+	//GetDataPackets
+	//Call right after ReadRequest returns a data packet. Returns that packet plus
+	//every complete '$' frame directly behind it in the buffer, up to inMaxPackets,
+	//each with its 4 byte header. They are all consumed as one request, so
+	//GetRequestBuffer spans the whole batch afterwards.
+	UInt32      GetDataPackets(StrPtrLen* outPackets, UInt32 inMaxPackets);
+
+	//Sessions that carry nothing but interleaved data can use a bigger buffer, so
+	//a single read picks up many packets. Takes effect at the next request.
+	void        SetDataPacketBufferSize(UInt32 inSize) { fWantBufferSize = inSize; }
+
+	enum
+	{
+		kDataPacketBufferSizeInBytes = 64 * 1024     //UInt32
+	};
 	void        ShowRTSP(bool enable) { fPrintRTSP = enable; }
 	void SnarfRetreat(RTSPRequestStream &fromRequest);
 
@@ -100,11 +116,17 @@ private:
 	// of data left undecoded in inSrcData
 	QTSS_Error              DecodeIncomingData(char* inSrcData, UInt32 inSrcDataLen);
 
+	// Switches to a heap buffer of fWantBufferSize, carrying the retreat bytes over
+	void                    GrowBuffer();
+
 	TCPSocket*              fSocket;
 	UInt32                  fRetreatBytes;
 	UInt32                  fRetreatBytesRead; // Used by Read() when it is reading RetreatBytes
 
 	char                    fRequestBuffer[kRequestBufferSizeInBytes];
+	char*                   fReadBuffer;        // fRequestBuffer, unless GrowBuffer replaced it
+	UInt32                  fReadBufferSize;
+	UInt32                  fWantBufferSize;
 	UInt32                  fCurOffset; // tracks how much valid data is in the above buffer
 	UInt32                  fEncodedBytesRemaining; // If we are decoding, tracks how many encoded bytes are in the buffer
 
@@ -359,6 +359,17 @@ SInt64 RTSPSession::Run()
 						break;
 					}
 				}
+
+				// A pusher with an ingest handler gets its data packets straight to the
+				// handler. Building a request and running the role chain per packet
+				// costs more than the packet itself.
+				if ((err == QTSS_RequestArrived) && fInputStream.IsDataPacket() && (fIngestProc != NULL))
+				{
+					fTimeoutTask.RefreshTimeout();
+					this->HandleIngestPackets();
+					continue;
+				}
+
 				fState = kHaveNonTunnelMessage;
 				// fall thru to kHaveNonTunnelMessage
 			}
@@ -2175,3 +2186,56 @@ void RTSPSession::HandleIncomingDataPacket()
 	}
 	fCurrentModule = 0;
 }
+
+void RTSPSession::HandleIngestPackets()
+{
+	// Take every complete frame that is already in the buffer, then resolve the
+	// RTP session and lock it once for the whole batch.
+	StrPtrLen thePackets[kMaxIngestBatchSize];
+	Easy_InterleavedPacket theIngestPackets[kMaxIngestBatchSize];
+	UInt32 theNumPackets = fInputStream.GetDataPackets(thePackets, kMaxIngestBatchSize);
+
+	UInt8 packetChannel = (UInt8)thePackets[0].Ptr[1];
+	StrPtrLen* theSessionID = this->GetSessionIDForChannelNum(packetChannel);
+	if (theSessionID == NULL)
+		theSessionID = &fLastRTPSessionIDPtr;
+
+	OSRefTable* theMap = QTSServerInterface::GetServer()->GetRTPSessionMap();
+	OSRef* theRef = theMap->Resolve(theSessionID);
+	if (theRef == NULL)
+		return;
+
+	// While we hold the ref the session can't unregister, so the handler it
+	// installed stays valid until we release it.
+	RTPSession* theSession = (RTPSession*)theRef->GetObject();
+	if (theSession == fIngestClientSession)
+	{
+		OSMutexLocker locker(theSession->GetMutex());
+		theSession->RefreshTimeout();
+
+		RTPStream* theStream = NULL;
+		UInt8 theStreamChannel = 0;
+		for (UInt32 x = 0; x < theNumPackets; x++)
+		{
+			packetChannel = (UInt8)thePackets[x].Ptr[1];
+			if ((theStream == NULL) || (packetChannel != theStreamChannel))
+			{
+				theStream = theSession->FindRTPStreamForChannelNum(packetChannel);
+				theStreamChannel = packetChannel;
+			}
+
+			if (theStream != NULL)
+			{
+				StrPtrLen packetWithoutHeaders(thePackets[x].Ptr + 4, thePackets[x].Len - 4);
+				theStream->ProcessIncomingInterleavedData(packetChannel, this, &packetWithoutHeaders);
+			}
+
+			theIngestPackets[x].inPacketData = thePackets[x].Ptr;
+			theIngestPackets[x].inPacketLen = thePackets[x].Len;
+		}
+
+		(fIngestProc)(fIngestCookie, theIngestPackets, theNumPackets);
+	}
+
+	theMap->Release(theRef);
+}
@@ -157,6 +157,12 @@ private:
 	QTSS_Error          PreFilterForHTTPProxyTunnel();              // prefilter for HTTP proxies
 	bool              ParseProxyTunnelHTTP();                     // use by PreFilterForHTTPProxyTunnel
 	void                HandleIncomingDataPacket();
+	void                HandleIngestPackets();
+
+	enum
+	{
+		kMaxIngestBatchSize = 64    //UInt32, '$' frames handed to the ingest handler at once
+	};
 
 	static              OSRefTable* sHTTPProxyTunnelMap;    // a map of available partners.
 
@@ -91,8 +91,6 @@ RTSPSessionInterface::RTSPSessionInterface()
 	fInputStream(&fSocket),
 	fOutputStream(&fSocket, &fTimeoutTask),
 	fSessionMutex(),
-	fTCPCoalesceBuffer(NULL),
-	fNumInCoalesceBuffer(0),
 	fSocket(NULL, Socket::kNonBlockingSocketType),
 	fOutputSocketP(&fSocket),
 	fInputSocketP(&fSocket),
@@ -101,6 +99,9 @@ RTSPSessionInterface::RTSPSessionInterface()
 	fObjectHolders(0),
 	fCurChannelNum(0),
 	fChNumToSessIDMap(NULL),
+	fIngestProc(NULL),
+	fIngestCookie(NULL),
+	fIngestClientSession(NULL),
 	fRequestBodyLen(-1),
 	fSentOptionsRequest(false),
 	fOptionsRequestSendTime(-1),
@@ -135,8 +136,6 @@ RTSPSessionInterface::~RTSPSessionInterface()
 	if (fInputSocketP != fOutputSocketP)
 		delete fInputSocketP;
 
-	delete[] fTCPCoalesceBuffer;
-
 	for (UInt8 x = 0; x < (fCurChannelNum >> 1); x++)
 		delete[] fChNumToSessIDMap[x].Ptr;
 	delete[] fChNumToSessIDMap;
@@ -222,11 +221,6 @@ QTSS_Error RTSPSessionInterface::RequestEvent(QTSS_EventType inEventMask)
 
 UInt8 RTSPSessionInterface::GetTwoChannelNumbers(StrPtrLen* inRTSPSessionID)
 {
-	//
-	// Allocate a TCP coalesce buffer if still needed
-	if (fTCPCoalesceBuffer != NULL)
-		fTCPCoalesceBuffer = new char[kTCPCoalesceBufferSize];
-
 	//
 	// Allocate 2 channel numbers
 	UInt8 theChannelNum = fCurChannelNum;
@@ -259,18 +253,47 @@ StrPtrLen*  RTSPSessionInterface::GetSessionIDForChannelNum(UInt8 inChannelNum)
 		return NULL;
 }
 
+void RTSPSessionInterface::SetIngestHandler(QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie)
+{
+	// Only ever called from this session's own thread, while it processes a request,
+	// so the read loop can't be looking at the handler right now.
+	fIngestProc = inProc;
+	fIngestCookie = inCookie;
+	fIngestClientSession = (inProc != NULL) ? inClientSession : NULL;
+
+	// A pusher sends nothing but '$' frames from here on, so give the request
+	// stream enough room to read many of them at once.
+	if (inProc != NULL)
+		fInputStream.SetDataPacketBufferSize(RTSPRequestStream::kDataPacketBufferSizeInBytes);
+}
+
+void RTSPSessionInterface::ClearIngestHandler(QTSS_ClientSessionObject inClientSession)
+{
+	// The client session is unregistered by now, so the read loop can no longer
+	// resolve it and won't call the handler again.
+	if (fIngestClientSession != inClientSession)
+		return;
+
+	fIngestProc = NULL;
+	fIngestCookie = NULL;
+	fIngestClientSession = NULL;
+}
+
 /*********************************
 /
 /   InterleavedWrite
 /
 /   Write the given RTP packet out on the RTSP channel in interleaved format.
+/   The packet is handed to writev() in place, behind a 4 byte '$' header, so
+/   a reflected packet buffer is never copied per viewer. Only the part the
+/   socket does not take right away is buffered by the RTSPResponseStream.
 /
 */
 
 QTSS_Error RTSPSessionInterface::InterleavedWrite(void* inBuffer, UInt32 inLen, UInt32* outLenWritten, unsigned char channel)
 {
 
-	if (inLen == 0 && fNumInCoalesceBuffer == 0)
+	if (inLen == 0)
 	{
 		if (outLenWritten != NULL)
 			*outLenWritten = 0;
@@ -297,83 +320,24 @@ QTSS_Error RTSPSessionInterface::InterleavedWrite(void* inBuffer, UInt32 inLen,
 
 	struct  iovec               iov[3];
 	QTSS_Error                  err = QTSS_NoErr;
+	struct RTPInterleaveHeader  rih;
 
+	rih.header = '$';
+	rih.channel = channel;
+	rih.len = htons((UInt16)inLen);
 
+	// skip iov[0], WriteV uses it for anything already sitting in the output buffer
+	iov[1].iov_base = (char*)&rih;
+	iov[1].iov_len = sizeof(rih);
 
-	// flush rules
-	if ((inLen > kTCPCoalesceDirectWriteSize || inLen == 0) && fNumInCoalesceBuffer > 0
-		|| (inLen + fNumInCoalesceBuffer + kInteleaveHeaderSize > kTCPCoalesceBufferSize) && fNumInCoalesceBuffer > 0
-		)
-	{
-		UInt32      buffLenWritten;
-
-		// skip iov[0], WriteV uses it
-		iov[1].iov_base = fTCPCoalesceBuffer;
-		iov[1].iov_len = fNumInCoalesceBuffer;
-
-		err = this->GetOutputStream()->WriteV(iov, 2, fNumInCoalesceBuffer, &buffLenWritten, RTSPResponseStream::kAllOrNothing);
-
-#if RTSP_SESSION_INTERFACE_DEBUGGING 
-		qtss_printf("InterleavedWrite: flushing %li\n", fNumInCoalesceBuffer);
-#endif
-
-		if (err == QTSS_NoErr)
-			fNumInCoalesceBuffer = 0;
-	}
-
-
-
-	if (err == QTSS_NoErr)
-	{
-
-		if (inLen > kTCPCoalesceDirectWriteSize)
-		{
-			struct RTPInterleaveHeader  rih;
-
-			// write direct to stream
-			rih.header = '$';
-			rih.channel = channel;
-			rih.len = htons((UInt16)inLen);
-
-			iov[1].iov_base = (char*)&rih;
-			iov[1].iov_len = sizeof(rih);
-
-			iov[2].iov_base = (char*)inBuffer;
-			iov[2].iov_len = inLen;
-
-			err = this->GetOutputStream()->WriteV(iov, 3, inLen + sizeof(rih), outLenWritten, RTSPResponseStream::kAllOrNothing);
-
-#if RTSP_SESSION_INTERFACE_DEBUGGING 
-			qtss_printf("InterleavedWrite: bypass %li\n", inLen);
-#endif
-
-		}
-		else
-		{
-			// coalesce with other small writes
-
-			fTCPCoalesceBuffer[fNumInCoalesceBuffer] = '$';
-			fNumInCoalesceBuffer++;;
+	iov[2].iov_base = (char*)inBuffer;
+	iov[2].iov_len = inLen;
 
-			fTCPCoalesceBuffer[fNumInCoalesceBuffer] = channel;
-			fNumInCoalesceBuffer++;
-
-			//*((short*)&fTCPCoalesceBuffer[fNumInCoalesceBuffer]) = htons(inLen);
-			// if we ever turn TCPCoalesce back on, this should be optimized
-			// for processors w/o alignment restrictions as above.
-
-			SInt16  pcketLen = htons((UInt16)inLen);
-			::memcpy(&fTCPCoalesceBuffer[fNumInCoalesceBuffer], &pcketLen, 2);
-			fNumInCoalesceBuffer += 2;
-
-			::memcpy(&fTCPCoalesceBuffer[fNumInCoalesceBuffer], inBuffer, inLen);
-			fNumInCoalesceBuffer += inLen;
+	err = this->GetOutputStream()->WriteV(iov, 3, inLen + sizeof(rih), outLenWritten, RTSPResponseStream::kAllOrNothing);
 
 #if RTSP_SESSION_INTERFACE_DEBUGGING 
-			qtss_printf("InterleavedWrite: coalesce %li, total bufff %li\n", inLen, fNumInCoalesceBuffer);
+	qtss_printf("InterleavedWrite: %li\n", inLen);
 #endif
-		}
-	}
 
 	if (err == QTSS_NoErr)
 	{
@@ -81,6 +81,12 @@ public:
 	// Given a channel number, returns the RTSP Session ID to which this channel number refers
 	StrPtrLen*  GetSessionIDForChannelNum(UInt8 inChannelNum);
 
+	// Interleaved push ingest. While a handler is set, data packets read off this
+	// session bypass the request state machine and go to the handler in batches.
+	// The handler belongs to inClientSession and is cleared when that session dies.
+	void                SetIngestHandler(QTSS_ClientSessionObject inClientSession, Easy_IngestProcPtr inProc, void* inCookie);
+	void                ClearIngestHandler(QTSS_ClientSessionObject inClientSession);
+
 	//Two main things are persistent through the course of a session, not
 	//associated with any one request. The RequestStream (which can be used for
 	//getting data from the client), and the socket. OOps, and the ResponseStream
@@ -161,15 +167,10 @@ protected:
 	// be prevented from writing while an RTSP request is in progress
 	OSMutex             fSessionMutex;
 
-	// for coalescing small interleaved writes into a single TCP frame
 	enum
 	{
-		kTCPCoalesceBufferSize = 1450 //1450 is the max data space in an TCP segment over ent
-		, kTCPCoalesceDirectWriteSize = 0 // if > this # bytes bypass coalescing and make a direct write
-		, kInteleaveHeaderSize = 4  // '$ '+ 1 byte ch ID + 2 bytes length
+		kInteleaveHeaderSize = 4  // '$ '+ 1 byte ch ID + 2 bytes length
 	};
-	char*       fTCPCoalesceBuffer;
-	SInt32      fNumInCoalesceBuffer;
 
 
 	//+rt  socket we get from "accept()"
@@ -187,6 +188,11 @@ protected:
 	UInt8               fCurChannelNum;
 	StrPtrLen*          fChNumToSessIDMap;
 
+	// Interleaved push ingest handler, see SetIngestHandler
+	Easy_IngestProcPtr          fIngestProc;
+	void*                       fIngestCookie;
+	QTSS_ClientSessionObject    fIngestClientSession;
+
 	QTSS_StreamRef      fStreamRef;
 
 	UInt32              fSessionID;
@@ -33,6 +33,7 @@
 #include "OS.h"
 #include "OSThread.h"
 #include "Socket.h"
+#include "UDPSocket.h"
 #include "SocketUtils.h"
 #include "ev.h"
 #include "OSArrayObjectDeleter.h"
@@ -58,6 +59,7 @@ bool sHasPID = false;
 UInt64 sLastStatusPackets = 0;
 UInt64 sLastDebugPackets = 0;
 SInt64 sLastDebugTotalQuality = 0;
+UInt32 sLastDebugSteals = 0;
 #ifdef __sgi__ 
 #include <sched.h>
 #endif
@@ -76,14 +78,11 @@ QTSS_ServerState StartServer(XMLPrefsParser* inPrefsSource, PrefsSource* inMessa
 	OS::Initialize();
 	OSThread::Initialize();
 
-	Socket::Initialize();
 	SocketUtils::Initialize(inDontFork);
 
 #if !MACOSXEVENTQUEUE
 
-#ifndef __Win32__    
-	::epollInit();
-#else
+#ifdef __Win32__    
 	::select_startevents();//initialize the select() implementation of the event queue        
 #endif
 
@@ -121,6 +120,7 @@ QTSS_ServerState StartServer(XMLPrefsParser* inPrefsSource, PrefsSource* inMessa
 		UInt32 numBlockingThreads = 0;
 		UInt32 numThreads = 0;
 		UInt32 numProcessors = 0;
+		UInt32 numEventThreads = 0;
 
 		if (OS::ThreadSafe())
 		{
@@ -159,11 +159,23 @@ QTSS_ServerState StartServer(XMLPrefsParser* inPrefsSource, PrefsSource* inMessa
 		//qtss_printf("Add threads shortask=%lu blocking=%lu\n",numShortTaskThreads, numBlockingThreads);
 		TaskThreadPool::SetNumShortTaskThreads(numShortTaskThreads);
 		TaskThreadPool::SetNumBlockingTaskThreads(numBlockingThreads);
+		TaskThreadPool::SetWorkStealing(sServer->GetPrefs()->GetWorkStealingEnabled());
+		TaskThreadPool::SetMinWaitTime(sServer->GetPrefs()->GetTaskMinWaitMSec());
+		UDPSocket::SetSendBatchSize(sServer->GetPrefs()->GetUDPSendBatchSize());
+		UDPSocket::SetGSOEnabled(sServer->GetPrefs()->GetUDPGSOEnabled());
 		TaskThreadPool::AddThreads(numThreads);
 		sServer->InitNumThreads(numThreads);
 
+		// One epoll reactor per event thread. By default pair them up with
+		// the short task threads, so each reactor feeds "its" task thread.
+		numEventThreads = sServer->GetPrefs()->GetNumEventThreads();
+		if (numEventThreads == 0)
+			numEventThreads = numShortTaskThreads;
+		Socket::Initialize(numEventThreads);
+
 #if DEBUG
 		qtss_printf("Number of task threads: %"   _U32BITARG_   "\n", numThreads);
+		qtss_printf("Number of event threads: %"   _U32BITARG_   "\n", numEventThreads);
 #endif
 
 		// Start up the server's global tasks, and start listening
@@ -404,7 +416,7 @@ void DebugLevel_1(FILE*   statusFile, FILE*   stdOut, bool printHeader)
 	if (printHeader)
 	{
 
-		print_status(statusFile, stdOut, "%s", "     RTP-Conns RTSP-Conns HTTP-Conns  kBits/Sec   Pkts/Sec   RTP-Playing   AvgDelay CurMaxDelay  MaxDelay  AvgQuality  NumThinned      Time\n");
+		print_status(statusFile, stdOut, "%s", "     RTP-Conns RTSP-Conns HTTP-Conns  kBits/Sec   Pkts/Sec   RTP-Playing   AvgDelay CurMaxDelay  MaxDelay  AvgQuality  NumThinned     Steals   RunQueue      Time\n");
 
 	}
 
@@ -473,6 +485,15 @@ void DebugLevel_1(FILE*   statusFile, FILE*   stdOut, bool printHeader)
 	qtss_snprintf(numStr, sizeof(numStr) - 1, "%" _S32BITARG_ "", (SInt32)sServer->GetNumThinned());
 	print_status(statusFile, stdOut, "%11s", numStr);
 
+	//task thread scheduler: tasks stolen since the last line, tasks waiting to run
+	UInt32 totalSteals = TaskThreadPool::GetNumSteals();
+	qtss_snprintf(numStr, sizeof(numStr) - 1, "%"   _U32BITARG_   "", totalSteals - sLastDebugSteals);
+	sLastDebugSteals = totalSteals;
+	print_status(statusFile, stdOut, "%11s", numStr);
+
+	qtss_snprintf(numStr, sizeof(numStr) - 1, "%"   _U32BITARG_   "", TaskThreadPool::GetQueueDepth());
+	print_status(statusFile, stdOut, "%11s", numStr);
+
 
 
 	char theDateBuffer[QTSSRollingLog::kMaxDateBufferSizeInBytes];
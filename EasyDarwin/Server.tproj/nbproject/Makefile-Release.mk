@@ -36,6 +36,7 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 # Object Files
 OBJECTFILES= \
 	${OBJECTDIR}/_ext/1321107971/QTAccessFile.o \
+	${OBJECTDIR}/_ext/1321107971/QTAccessFileCache.o \
 	${OBJECTDIR}/_ext/1321107971/QTSS3GPPModuleUtils.o \
 	${OBJECTDIR}/_ext/1321107971/QTSSModuleUtils.o \
 	${OBJECTDIR}/_ext/1321107971/QTSSRollingLog.o \
@@ -60,6 +61,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/_ext/1502317834/RTPSessionOutput.o \
 	${OBJECTDIR}/_ext/1502317834/RTSPSourceInfo.o \
 	${OBJECTDIR}/_ext/1502317834/ReflectorSession.o \
+	${OBJECTDIR}/_ext/1502317834/ReflectorSessionCatalog.o \
 	${OBJECTDIR}/_ext/1502317834/ReflectorStream.o \
 	${OBJECTDIR}/_ext/1502317834/RelayOutput.o \
 	${OBJECTDIR}/_ext/1502317834/RelaySDPSourceInfo.o \
@@ -150,6 +152,11 @@ ${OBJECTDIR}/_ext/1321107971/QTAccessFile.o: ../APICommonCode/QTAccessFile.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I.. -I../QTFileLib -I../OSMemoryLib -I../RTSPClientLib -I../APIModules -I../APICommonCode -I../APIModules/OSMemory_Modules -I../APIModules/QTSSAccessLogModule -I../APIModules/QTSSFileModule -I../APIModules/QTSSFlowControlModule -I../APIModules/QTSSReflectorModule -I../APIModules/QTSSSvrControlModule -I../APIModules/QTSSWebDebugModule -I../APIModules/QTSSWebStatsModule -I../APIModules/QTSSAuthorizeModule -I../APIModules/QTSSPOSIXFileSysModule -I../APIModules/QTSSAdminModule -I../APIModules/QTSSMP3StreamingModule -I../APIModules/QTSSRTPFileModule -I../APIModules/QTSSAccessModule -I../APIModules/QTSSHttpFileModule -I../QTFileTools/RTPFileGen.tproj -I../APIStubLib -I../CommonUtilitiesLib -I../RTCPUtilitiesLib -I../HTTPUtilitiesLib -I../RTPMetaInfoLib -I../PrefsSourceLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/1321107971/QTAccessFile.o ../APICommonCode/QTAccessFile.cpp
 
+${OBJECTDIR}/_ext/1321107971/QTAccessFileCache.o: ../APICommonCode/QTAccessFileCache.cpp 
+	${MKDIR} -p ${OBJECTDIR}/_ext/1321107971
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I.. -I../QTFileLib -I../OSMemoryLib -I../RTSPClientLib -I../APIModules -I../APICommonCode -I../APIModules/OSMemory_Modules -I../APIModules/QTSSAccessLogModule -I../APIModules/QTSSFileModule -I../APIModules/QTSSFlowControlModule -I../APIModules/QTSSReflectorModule -I../APIModules/QTSSSvrControlModule -I../APIModules/QTSSWebDebugModule -I../APIModules/QTSSWebStatsModule -I../APIModules/QTSSAuthorizeModule -I../APIModules/QTSSPOSIXFileSysModule -I../APIModules/QTSSAdminModule -I../APIModules/QTSSMP3StreamingModule -I../APIModules/QTSSRTPFileModule -I../APIModules/QTSSAccessModule -I../APIModules/QTSSHttpFileModule -I../QTFileTools/RTPFileGen.tproj -I../APIStubLib -I../CommonUtilitiesLib -I../RTCPUtilitiesLib -I../HTTPUtilitiesLib -I../RTPMetaInfoLib -I../PrefsSourceLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/1321107971/QTAccessFileCache.o ../APICommonCode/QTAccessFileCache.cpp
+
 ${OBJECTDIR}/_ext/1321107971/QTSS3GPPModuleUtils.o: ../APICommonCode/QTSS3GPPModuleUtils.cpp 
 	${MKDIR} -p ${OBJECTDIR}/_ext/1321107971
 	${RM} "$@.d"
@@ -270,6 +277,11 @@ ${OBJECTDIR}/_ext/1502317834/ReflectorSession.o: ../APIModules/QTSSReflectorModu
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I.. -I../QTFileLib -I../OSMemoryLib -I../RTSPClientLib -I../APIModules -I../APICommonCode -I../APIModules/OSMemory_Modules -I../APIModules/QTSSAccessLogModule -I../APIModules/QTSSFileModule -I../APIModules/QTSSFlowControlModule -I../APIModules/QTSSReflectorModule -I../APIModules/QTSSSvrControlModule -I../APIModules/QTSSWebDebugModule -I../APIModules/QTSSWebStatsModule -I../APIModules/QTSSAuthorizeModule -I../APIModules/QTSSPOSIXFileSysModule -I../APIModules/QTSSAdminModule -I../APIModules/QTSSMP3StreamingModule -I../APIModules/QTSSRTPFileModule -I../APIModules/QTSSAccessModule -I../APIModules/QTSSHttpFileModule -I../QTFileTools/RTPFileGen.tproj -I../APIStubLib -I../CommonUtilitiesLib -I../RTCPUtilitiesLib -I../HTTPUtilitiesLib -I../RTPMetaInfoLib -I../PrefsSourceLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/1502317834/ReflectorSession.o ../APIModules/QTSSReflectorModule/ReflectorSession.cpp
 
+${OBJECTDIR}/_ext/1502317834/ReflectorSessionCatalog.o: ../APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp 
+	${MKDIR} -p ${OBJECTDIR}/_ext/1502317834
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I. -I.. -I../QTFileLib -I../OSMemoryLib -I../RTSPClientLib -I../APIModules -I../APICommonCode -I../APIModules/OSMemory_Modules -I../APIModules/QTSSAccessLogModule -I../APIModules/QTSSFileModule -I../APIModules/QTSSFlowControlModule -I../APIModules/QTSSReflectorModule -I../APIModules/QTSSSvrControlModule -I../APIModules/QTSSWebDebugModule -I../APIModules/QTSSWebStatsModule -I../APIModules/QTSSAuthorizeModule -I../APIModules/QTSSPOSIXFileSysModule -I../APIModules/QTSSAdminModule -I../APIModules/QTSSMP3StreamingModule -I../APIModules/QTSSRTPFileModule -I../APIModules/QTSSAccessModule -I../APIModules/QTSSHttpFileModule -I../QTFileTools/RTPFileGen.tproj -I../APIStubLib -I../CommonUtilitiesLib -I../RTCPUtilitiesLib -I../HTTPUtilitiesLib -I../RTPMetaInfoLib -I../PrefsSourceLib -include ../PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/_ext/1502317834/ReflectorSessionCatalog.o ../APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp
+
 ${OBJECTDIR}/_ext/1502317834/ReflectorStream.o: ../APIModules/QTSSReflectorModule/ReflectorStream.cpp 
 	${MKDIR} -p ${OBJECTDIR}/_ext/1502317834
 	${RM} "$@.d"
@@ -40,6 +40,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/_ext/b9fc5c32/HTTPRequestStream.o \
 	${OBJECTDIR}/_ext/b9fc5c32/HTTPResponseStream.o \
 	${OBJECTDIR}/APICommonCode/QTAccessFile.o \
+	${OBJECTDIR}/APICommonCode/QTAccessFileCache.o \
 	${OBJECTDIR}/APICommonCode/QTSS3GPPModuleUtils.o \
 	${OBJECTDIR}/APICommonCode/QTSSModuleUtils.o \
 	${OBJECTDIR}/APICommonCode/QTSSRollingLog.o \
@@ -66,6 +67,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RTPSessionOutput.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RTSPSourceInfo.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o \
+	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorStream.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RelayOutput.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RelaySDPSourceInfo.o \
@@ -94,6 +96,8 @@ OBJECTFILES= \
 	${OBJECTDIR}/QTFileLib/QTFile.o \
 	${OBJECTDIR}/QTFileLib/QTFile_FileControlBlock.o \
 	${OBJECTDIR}/QTFileLib/QTHintTrack.o \
+	${OBJECTDIR}/QTFileLib/QTFileIndex.o \
+	${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o \
 	${OBJECTDIR}/QTFileLib/QTRTPFile.o \
 	${OBJECTDIR}/QTFileLib/QTTrack.o \
 	${OBJECTDIR}/RTCPUtilitiesLib/RTCPAPPNADUPacket.o \
@@ -193,6 +197,11 @@ ${OBJECTDIR}/APICommonCode/QTAccessFile.o: APICommonCode/QTAccessFile.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APICommonCode/QTAccessFile.o APICommonCode/QTAccessFile.cpp
 
+${OBJECTDIR}/APICommonCode/QTAccessFileCache.o: APICommonCode/QTAccessFileCache.cpp 
+	${MKDIR} -p ${OBJECTDIR}/APICommonCode
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APICommonCode/QTAccessFileCache.o APICommonCode/QTAccessFileCache.cpp
+
 ${OBJECTDIR}/APICommonCode/QTSS3GPPModuleUtils.o: APICommonCode/QTSS3GPPModuleUtils.cpp 
 	${MKDIR} -p ${OBJECTDIR}/APICommonCode
 	${RM} "$@.d"
@@ -323,6 +332,11 @@ ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o: APIModules/QTSSR
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o APIModules/QTSSReflectorModule/ReflectorSession.cpp
 
+${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o: APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp 
+	${MKDIR} -p ${OBJECTDIR}/APIModules/QTSSReflectorModule
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp
+
 ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorStream.o: APIModules/QTSSReflectorModule/ReflectorStream.cpp 
 	${MKDIR} -p ${OBJECTDIR}/APIModules/QTSSReflectorModule
 	${RM} "$@.d"
@@ -463,6 +477,16 @@ ${OBJECTDIR}/QTFileLib/QTHintTrack.o: QTFileLib/QTHintTrack.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTHintTrack.o QTFileLib/QTHintTrack.cpp
 
+${OBJECTDIR}/QTFileLib/QTFileIndex.o: QTFileLib/QTFileIndex.cpp 
+	${MKDIR} -p ${OBJECTDIR}/QTFileLib
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTFileIndex.o QTFileLib/QTFileIndex.cpp
+
+${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o: QTFileLib/QTPacketizerTrack.cpp 
+	${MKDIR} -p ${OBJECTDIR}/QTFileLib
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DCOMMON_UTILITIES_LIB -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebStatsModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/QTSSMP3StreamingModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -include ../Include/PlatformHeader.h -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o QTFileLib/QTPacketizerTrack.cpp
+
 ${OBJECTDIR}/QTFileLib/QTRTPFile.o: QTFileLib/QTRTPFile.cpp 
 	${MKDIR} -p ${OBJECTDIR}/QTFileLib
 	${RM} "$@.d"
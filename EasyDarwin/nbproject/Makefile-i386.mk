@@ -41,6 +41,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/_ext/b9fc5c32/HTTPRequest.o \
 	${OBJECTDIR}/_ext/a7d13d49/RTSPProtocol.o \
 	${OBJECTDIR}/APICommonCode/QTAccessFile.o \
+	${OBJECTDIR}/APICommonCode/QTAccessFileCache.o \
 	${OBJECTDIR}/APICommonCode/QTSSModuleUtils.o \
 	${OBJECTDIR}/APICommonCode/QTSSRollingLog.o \
 	${OBJECTDIR}/APICommonCode/SDPSourceInfo.o \
@@ -63,6 +64,7 @@ OBJECTFILES= \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RCFSourceInfo.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/RTPSessionOutput.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o \
+	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorStream.o \
 	${OBJECTDIR}/APIModules/QTSSReflectorModule/SequenceNumberMap.o \
 	${OBJECTDIR}/APIModules/QTSSWebDebugModule/QTSSWebDebugModule.o \
@@ -87,6 +89,8 @@ OBJECTFILES= \
 	${OBJECTDIR}/QTFileLib/QTFile.o \
 	${OBJECTDIR}/QTFileLib/QTFile_FileControlBlock.o \
 	${OBJECTDIR}/QTFileLib/QTHintTrack.o \
+	${OBJECTDIR}/QTFileLib/QTFileIndex.o \
+	${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o \
 	${OBJECTDIR}/QTFileLib/QTRTPFile.o \
 	${OBJECTDIR}/QTFileLib/QTTrack.o \
 	${OBJECTDIR}/RTCPUtilitiesLib/RTCPAPPNADUPacket.o \
@@ -184,6 +188,11 @@ ${OBJECTDIR}/APICommonCode/QTAccessFile.o: APICommonCode/QTAccessFile.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APICommonCode/QTAccessFile.o APICommonCode/QTAccessFile.cpp
 
+${OBJECTDIR}/APICommonCode/QTAccessFileCache.o: APICommonCode/QTAccessFileCache.cpp
+	${MKDIR} -p ${OBJECTDIR}/APICommonCode
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APICommonCode/QTAccessFileCache.o APICommonCode/QTAccessFileCache.cpp
+
 ${OBJECTDIR}/APICommonCode/QTSSModuleUtils.o: APICommonCode/QTSSModuleUtils.cpp
 	${MKDIR} -p ${OBJECTDIR}/APICommonCode
 	${RM} "$@.d"
@@ -294,6 +303,11 @@ ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o: APIModules/QTSSR
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSession.o APIModules/QTSSReflectorModule/ReflectorSession.cpp
 
+${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o: APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp
+	${MKDIR} -p ${OBJECTDIR}/APIModules/QTSSReflectorModule
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorSessionCatalog.o APIModules/QTSSReflectorModule/ReflectorSessionCatalog.cpp
+
 ${OBJECTDIR}/APIModules/QTSSReflectorModule/ReflectorStream.o: APIModules/QTSSReflectorModule/ReflectorStream.cpp
 	${MKDIR} -p ${OBJECTDIR}/APIModules/QTSSReflectorModule
 	${RM} "$@.d"
@@ -414,6 +428,16 @@ ${OBJECTDIR}/QTFileLib/QTHintTrack.o: QTFileLib/QTHintTrack.cpp
 	${RM} "$@.d"
 	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTHintTrack.o QTFileLib/QTHintTrack.cpp
 
+${OBJECTDIR}/QTFileLib/QTFileIndex.o: QTFileLib/QTFileIndex.cpp
+	${MKDIR} -p ${OBJECTDIR}/QTFileLib
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTFileIndex.o QTFileLib/QTFileIndex.cpp
+
+${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o: QTFileLib/QTPacketizerTrack.cpp
+	${MKDIR} -p ${OBJECTDIR}/QTFileLib
+	${RM} "$@.d"
+	$(COMPILE.cc) -O2 -DDSS_USE_API_CALLBACKS -D_REENTRANT -D__USE_POSIX -D__linux__ -I../HTTPUtilitiesLib -I../CommonUtilitiesLib -IServer.tproj -IQTFileLib/ -IRTPMetaInfoLib/ -IPrefsSourceLib/ -IAPIStubLib/ -IAPICommonCode/ -IRTCPUtilitiesLib/ -IRTSPClientLib/ -IAPIModules/QTSSFileModule/ -IAPIModules/QTSSHttpFileModule/ -IAPIModules/QTSSAccessModule/ -IAPIModules/QTSSAccessLogModule/ -IAPIModules/QTSSPOSIXFileSysModule -IAPIModules/QTSSAdminModule/ -IAPIModules/QTSSReflectorModule/ -IAPIModules/QTSSWebDebugModule/ -IAPIModules/QTSSFlowControlModule/ -IAPIModules/EasyHLSModule -IAPIModules/EasyRelayModule -IInclude -I. -I../Include -I../EasyProtocol/Include -I../EasyProtocol/jsoncpp/include -IAPIModules/EasyCMSModule -IAPIModules/EasyRedisModule -I../EasyRedisClient -I../RTSPUtilitiesLib -IAPIModules/EasyRTMPModule -IAPIModules/EasyHLSModule -include ../Include/PlatformHeader.h -std=c++11 -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/QTFileLib/QTPacketizerTrack.o QTFileLib/QTPacketizerTrack.cpp
+
 ${OBJECTDIR}/QTFileLib/QTRTPFile.o: QTFileLib/QTRTPFile.cpp
 	${MKDIR} -p ${OBJECTDIR}/QTFileLib
 	${RM} "$@.d"
@@ -0,0 +1,298 @@
+/*
+	Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+ * File:   EasyJsonReader.cpp
+ *
+ * Implementation of EasyJsonReader
+*/
+
+#include <EasyJsonReader.h>
+#include <EasyProtocolBase.h>
+#include <string.h>
+
+namespace EasyDarwin { namespace Protocol
+{
+	EasyJsonReader::EasyJsonReader()
+		: json_(NULL)
+		, len_(0)
+		, pos_(0)
+		, header_(kNone)
+		, body_(kNone)
+	{
+	}
+
+	bool EasyJsonReader::Parse(const char* json, size_t len)
+	{
+		json_ = json;
+		len_ = len;
+		pos_ = 0;
+		tokens_.clear();
+		arena_.clear();
+		header_ = kNone;
+		body_ = kNone;
+
+		SkipSpace();
+		bool ok = (json != NULL) && ParseValue(0);
+		SkipSpace();
+		if (!ok || pos_ != len_)
+		{
+			tokens_.clear();
+			return false;
+		}
+
+		int root = Find(0, EASY_TAG_ROOT);
+		header_ = Find(root, EASY_TAG_HEADER);
+		body_ = Find(root, EASY_TAG_BODY);
+		return true;
+	}
+
+	int EasyJsonReader::Find(int obj, const char* key) const
+	{
+		if (!IsObject(obj))
+			return kNone;
+
+		// Members are a key token followed by its value
+		int tok = obj + 1;
+		for (int i = 0; i < tokens_[obj].size; i++)
+		{
+			if (GetString(tok) == key)
+				return tok + 1;
+			tok = tokens_[tok + 1].next;
+		}
+
+		return kNone;
+	}
+
+	boost::string_ref EasyJsonReader::GetString(int tok) const
+	{
+		if (tok == kNone)
+			return boost::string_ref();
+
+		const Token& t = tokens_[tok];
+		if (t.escaped)
+			return boost::string_ref(arena_.data() + t.start, t.len);
+		return boost::string_ref(json_ + t.start, t.len);
+	}
+
+	int EasyJsonReader::GetMessageType() const
+	{
+		boost::string_ref type = GetHeaderValue(EASY_TAG_MESSAGE_TYPE);
+		return EasyProtocol::GetMsgType(type.data(), type.size());
+	}
+
+	void EasyJsonReader::SkipSpace()
+	{
+		while (pos_ < len_ && (json_[pos_] == ' ' || json_[pos_] == '\t' || json_[pos_] == '\r' || json_[pos_] == '\n'))
+			pos_++;
+	}
+
+	bool EasyJsonReader::ParseValue(int depth)
+	{
+		if (pos_ >= len_)
+			return false;
+
+		char c = json_[pos_];
+		if (c == '"')
+			return ParseString();
+		if (c != '{' && c != '[')
+			return ParsePrimitive();
+
+		if (depth >= kMaxDepth)
+			return false;
+
+		// tokens_ may grow under us, so keep the index rather than a reference
+		int self = static_cast<int>(tokens_.size());
+		Token t = { c == '{' ? kObject : kArray, false, pos_, 0, 0, 0 };
+		tokens_.push_back(t);
+
+		char close = (c == '{') ? '}' : ']';
+		int count = 0;
+		pos_++;
+		SkipSpace();
+		if (pos_ < len_ && json_[pos_] == close)
+		{
+			pos_++;
+		}
+		else
+		{
+			for (;;)
+			{
+				if (c == '{')
+				{
+					if (pos_ >= len_ || json_[pos_] != '"' || !ParseString())
+						return false;
+					SkipSpace();
+					if (pos_ >= len_ || json_[pos_] != ':')
+						return false;
+					pos_++;
+					SkipSpace();
+				}
+
+				if (!ParseValue(depth + 1))
+					return false;
+				count++;
+
+				SkipSpace();
+				if (pos_ >= len_)
+					return false;
+				if (json_[pos_] == ',')
+				{
+					pos_++;
+					SkipSpace();
+					continue;
+				}
+				if (json_[pos_] != close)
+					return false;
+				pos_++;
+				break;
+			}
+		}
+
+		tokens_[self].len = pos_ - tokens_[self].start;
+		tokens_[self].size = count;
+		tokens_[self].next = static_cast<int>(tokens_.size());
+		return true;
+	}
+
+	bool EasyJsonReader::ParseString()
+	{
+		// pos_ is on the opening quote
+		size_t start = ++pos_;
+		bool escaped = false;
+		for (; pos_ < len_; pos_++)
+		{
+			unsigned char c = static_cast<unsigned char>(json_[pos_]);
+			if (c == '"')
+				break;
+			if (c < 0x20)
+				return false;
+			if (c == '\\')
+			{
+				escaped = true;
+				pos_++;
+			}
+		}
+		if (pos_ >= len_)
+			return false;
+
+		Token t = { kString, escaped, start, pos_ - start, static_cast<int>(tokens_.size()) + 1, 0 };
+		if (escaped)
+		{
+			t.start = arena_.size();
+			if (!Unescape(start, pos_))
+				return false;
+			t.len = arena_.size() - t.start;
+		}
+		tokens_.push_back(t);
+		pos_++;
+		return true;
+	}
+
+	bool EasyJsonReader::ParsePrimitive()
+	{
+		size_t start = pos_;
+		while (pos_ < len_ && ::strchr(" \t\r\n,:]}", json_[pos_]) == NULL && json_[pos_] != '\0')
+			pos_++;
+
+		// Numbers, true, false and null are not checked beyond their first character
+		if (pos_ == start || ::strchr("-0123456789tfn", json_[start]) == NULL)
+			return false;
+
+		Token t = { kPrimitive, false, start, pos_ - start, static_cast<int>(tokens_.size()) + 1, 0 };
+		tokens_.push_back(t);
+		return true;
+	}
+
+	static int HexValue(const char* p)
+	{
+		int value = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			char c = p[i];
+			value <<= 4;
+			if (c >= '0' && c <= '9')		value |= c - '0';
+			else if (c >= 'a' && c <= 'f')	value |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F')	value |= c - 'A' + 10;
+			else return -1;
+		}
+		return value;
+	}
+
+	bool EasyJsonReader::Unescape(size_t start, size_t end)
+	{
+		for (size_t i = start; i < end; i++)
+		{
+			char c = json_[i];
+			if (c != '\\')
+			{
+				arena_ += c;
+				continue;
+			}
+
+			c = json_[++i];
+			switch (c)
+			{
+			case '"':	arena_ += '"';	break;
+			case '\\':	arena_ += '\\';	break;
+			case '/':	arena_ += '/';	break;
+			case 'b':	arena_ += '\b';	break;
+			case 'f':	arena_ += '\f';	break;
+			case 'n':	arena_ += '\n';	break;
+			case 'r':	arena_ += '\r';	break;
+			case 't':	arena_ += '\t';	break;
+			case 'u':
+			{
+				if (end - i < 5)
+					return false;
+				int cp = HexValue(json_ + i + 1);
+				if (cp < 0)
+					return false;
+				i += 4;
+
+				// A surrogate pair encodes one code point above U+FFFF
+				if (cp >= 0xD800 && cp <= 0xDBFF && end - i >= 7 && json_[i + 1] == '\\' && json_[i + 2] == 'u')
+				{
+					int low = HexValue(json_ + i + 3);
+					if (low >= 0xDC00 && low <= 0xDFFF)
+					{
+						cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+						i += 6;
+					}
+				}
+
+				if (cp < 0x80)
+				{
+					arena_ += static_cast<char>(cp);
+				}
+				else if (cp < 0x800)
+				{
+					arena_ += static_cast<char>(0xC0 | (cp >> 6));
+					arena_ += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else if (cp < 0x10000)
+				{
+					arena_ += static_cast<char>(0xE0 | (cp >> 12));
+					arena_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					arena_ += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				else
+				{
+					arena_ += static_cast<char>(0xF0 | (cp >> 18));
+					arena_ += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+					arena_ += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+					arena_ += static_cast<char>(0x80 | (cp & 0x3F));
+				}
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		return true;
+	}
+
+}}//namespace
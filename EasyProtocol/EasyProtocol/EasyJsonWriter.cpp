@@ -0,0 +1,262 @@
+/*
+	Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+ * File:   EasyJsonWriter.cpp
+ *
+ * Implementation of EasyJsonWriter and EasyMsgWriter
+*/
+
+#include <EasyJsonWriter.h>
+#include <EasyProtocol.h>
+#include <stdio.h>
+
+namespace EasyDarwin { namespace Protocol
+{
+	EasyJsonWriter::EasyJsonWriter(std::string& ioOut)
+		: out_(ioOut)
+		, depth_(0)
+	{
+		first_[0] = true;
+	}
+
+	void EasyJsonWriter::Key(const char* key)
+	{
+		if (!first_[depth_])
+			out_ += ',';
+		first_[depth_] = false;
+
+		if (key != NULL)
+		{
+			out_ += '"';
+			Escaped(key);
+			out_ += "\":";
+		}
+	}
+
+	void EasyJsonWriter::Open(char c)
+	{
+		out_ += c;
+		if (depth_ < kMaxDepth - 1)
+			depth_++;
+		first_[depth_] = true;
+	}
+
+	void EasyJsonWriter::Close(char c)
+	{
+		out_ += c;
+		if (depth_ > 0)
+			depth_--;
+	}
+
+	void EasyJsonWriter::StartObject(const char* key)
+	{
+		Key(key);
+		Open('{');
+	}
+
+	void EasyJsonWriter::EndObject()
+	{
+		Close('}');
+	}
+
+	void EasyJsonWriter::StartArray(const char* key)
+	{
+		Key(key);
+		Open('[');
+	}
+
+	void EasyJsonWriter::EndArray()
+	{
+		Close(']');
+	}
+
+	void EasyJsonWriter::String(const char* key, boost::string_ref value)
+	{
+		Key(key);
+		out_ += '"';
+		Escaped(value);
+		out_ += '"';
+	}
+
+	void EasyJsonWriter::Int(const char* key, long long value)
+	{
+		char buf[32];
+		int len = ::snprintf(buf, sizeof(buf), "%lld", value);
+		Key(key);
+		out_.append(buf, len);
+	}
+
+	void EasyJsonWriter::IntString(const char* key, long long value)
+	{
+		char buf[32];
+		int len = ::snprintf(buf, sizeof(buf), "%lld", value);
+		String(key, boost::string_ref(buf, len));
+	}
+
+	void EasyJsonWriter::Escaped(boost::string_ref value)
+	{
+		static const char kHex[] = "0123456789abcdef";
+
+		// Copy the runs that need no escaping in one go
+		const char* run = value.data();
+		const char* end = value.data() + value.size();
+		for (const char* p = run; p != end; ++p)
+		{
+			unsigned char c = static_cast<unsigned char>(*p);
+			if (c >= 0x20 && c != '"' && c != '\\')
+				continue;
+
+			out_.append(run, p - run);
+			run = p + 1;
+
+			switch (c)
+			{
+			case '"':	out_ += "\\\"";	break;
+			case '\\':	out_ += "\\\\";	break;
+			case '\b':	out_ += "\\b";	break;
+			case '\f':	out_ += "\\f";	break;
+			case '\n':	out_ += "\\n";	break;
+			case '\r':	out_ += "\\r";	break;
+			case '\t':	out_ += "\\t";	break;
+			default:
+				out_ += "\\u00";
+				out_ += kHex[c >> 4];
+				out_ += kHex[c & 0xf];
+				break;
+			}
+		}
+		out_.append(run, end - run);
+	}
+
+	EasyMsgWriter::EasyMsgWriter(std::string& ioOut, int msgType, boost::string_ref cseq)
+		: EasyJsonWriter(ioOut)
+	{
+		StartHeader(msgType, cseq);
+	}
+
+	EasyMsgWriter::EasyMsgWriter(std::string& ioOut, int msgType, boost::string_ref cseq, int error)
+		: EasyJsonWriter(ioOut)
+	{
+		StartHeader(msgType, cseq);
+		IntString(EASY_TAG_ERROR_NUM, error);
+		String(EASY_TAG_ERROR_STRING, EasyProtocol::GetErrorString(error));
+	}
+
+	void EasyMsgWriter::StartHeader(int msgType, boost::string_ref cseq)
+	{
+		StartObject();
+		StartObject(EASY_TAG_ROOT);
+		StartObject(EASY_TAG_HEADER);
+		String(EASY_TAG_VERSION, EASY_PROTOCOL_VERSION);
+		String(EASY_TAG_CSEQ, cseq);
+		String(EASY_TAG_MESSAGE_TYPE, EasyProtocol::GetMsgTypeString(msgType));
+	}
+
+	void EasyMsgWriter::StartBody()
+	{
+		EndObject();
+		StartObject(EASY_TAG_BODY);
+	}
+
+	void EasyMsgWriter::Finish()
+	{
+		EndObject();
+		EndObject();
+		EndObject();
+	}
+
+	void EasyMsgWriter::Device(const strDevice& device)
+	{
+		StartObject();
+		String(EASY_TAG_SERIAL, device.serial_);
+		String(EASY_TAG_NAME, device.name_);
+		String(EASY_TAG_TAG, device.tag_);
+		String(EASY_TAG_APP_TYPE, EasyProtocol::GetAppTypeString(device.eAppType));
+		String(EASY_TAG_TERMINAL_TYPE, EasyProtocol::GetTerminalTypeString(device.eDeviceType));
+		//EasyCamera devices also report their latest snapshot
+		if (device.eAppType == EASY_APP_TYPE_CAMERA)
+			String(EASY_TAG_SNAP_URL, device.snapJpgPath_);
+		EndObject();
+	}
+
+	void EasyMsgWriter::SDRegisterACK(std::string& out, boost::string_ref cseq, boost::string_ref serial)
+	{
+		EasyMsgWriter msg(out, MSG_SD_REGISTER_ACK, cseq, EASY_ERROR_SUCCESS_OK);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.Finish();
+	}
+
+	void EasyMsgWriter::SDPushStreamREQ(std::string& out, boost::string_ref cseq, boost::string_ref serverIP, boost::string_ref serverPort,
+		boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve,
+		boost::string_ref from, boost::string_ref to, boost::string_ref via)
+	{
+		EasyMsgWriter msg(out, MSG_SD_PUSH_STREAM_REQ, cseq);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERVER_IP, serverIP);
+		msg.String(EASY_TAG_SERVER_PORT, serverPort);
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.String(EASY_TAG_CHANNEL, channel);
+		msg.String(EASY_TAG_RESERVE, reserve);
+		msg.String(EASY_TAG_FROM, from);
+		msg.String(EASY_TAG_TO, to);
+		msg.String(EASY_TAG_VIA, via);
+		msg.Finish();
+	}
+
+	void EasyMsgWriter::SDStopStreamREQ(std::string& out, boost::string_ref cseq, boost::string_ref serial, boost::string_ref channel,
+		boost::string_ref reserve, boost::string_ref protocol,
+		boost::string_ref from, boost::string_ref to, boost::string_ref via)
+	{
+		EasyMsgWriter msg(out, MSG_SD_STREAM_STOP_REQ, cseq);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.String(EASY_TAG_CHANNEL, channel);
+		msg.String(EASY_TAG_RESERVE, reserve);
+		msg.String(EASY_TAG_PROTOCOL, protocol);
+		msg.String(EASY_TAG_FROM, from);
+		msg.String(EASY_TAG_TO, to);
+		msg.String(EASY_TAG_VIA, via);
+		msg.Finish();
+	}
+
+	void EasyMsgWriter::SCStartStreamACK(std::string& out, boost::string_ref cseq, int error, boost::string_ref service,
+		boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve)
+	{
+		EasyMsgWriter msg(out, MSG_SC_START_STREAM_ACK, cseq, error);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERVICE, service);
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.String(EASY_TAG_CHANNEL, channel);
+		msg.String(EASY_TAG_RESERVE, reserve);
+		msg.Finish();
+	}
+
+	void EasyMsgWriter::SCStopStreamACK(std::string& out, boost::string_ref cseq,
+		boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve)
+	{
+		EasyMsgWriter msg(out, MSG_SC_STOP_STREAM_ACK, cseq, EASY_ERROR_SUCCESS_OK);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.String(EASY_TAG_CHANNEL, channel);
+		msg.String(EASY_TAG_RESERVE, reserve);
+		msg.Finish();
+	}
+
+	void EasyMsgWriter::SCFreeStreamACK(std::string& out, boost::string_ref cseq,
+		boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve, boost::string_ref protocol)
+	{
+		EasyMsgWriter msg(out, MSG_SC_FREE_STREAM_ACK, cseq, EASY_ERROR_SUCCESS_OK);
+		msg.StartBody();
+		msg.String(EASY_TAG_SERIAL, serial);
+		msg.String(EASY_TAG_CHANNEL, channel);
+		msg.String(EASY_TAG_RESERVE, reserve);
+		msg.String(EASY_TAG_PROTOCOL, protocol);
+		msg.Finish();
+	}
+
+}}//namespace
@@ -627,6 +627,12 @@ namespace EasyDarwin { namespace Protocol
 		value[EASY_TAG_L_NAME] = session.Name;
 		value[EASY_TAG_CHANNEL] = session.channel;
 		value[EASY_TAG_NUM_OUTPUTS] = session.numOutputs;
+		value[EASY_TAG_BITRATE] = session.bitrate;
+		value[EASY_TAG_PACKET_MEMORY] = session.packetMemory;
+		value[EASY_TAG_COPY_RATE] = session.copyRate;
+		value[EASY_TAG_GOP_CACHE_HITS] = session.gopCacheHits;
+		value[EASY_TAG_GOP_CACHE_MISSES] = session.gopCacheMisses;
+		value[EASY_TAG_FIRST_FRAME_MSEC] = session.firstFrameMSec;
 		root[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_SESSIONS].append(value);
 		return true;
 	}
@@ -757,6 +763,64 @@ namespace EasyDarwin { namespace Protocol
 		return false;
 	}
 
+	bool strDevice::GetDevInfo(const EasyJsonReader& msg)
+	{
+		boost::string_ref terminalType = msg.GetHeaderValue(EASY_TAG_TERMINAL_TYPE);
+		boost::string_ref appType = msg.GetHeaderValue(EASY_TAG_APP_TYPE);
+		boost::string_ref serial = msg.GetBodyValue(EASY_TAG_SERIAL);
+
+		if (terminalType.empty() || serial.empty() || appType.empty())
+			return false;
+
+		eDeviceType = static_cast<EasyDarwinTerminalType>(EasyProtocol::GetTerminalType(terminalType.data(), terminalType.size()));
+		if (eDeviceType == -1)
+			return false;
+		eAppType = static_cast<EasyDarwinAppType>(EasyProtocol::GetAppType(appType.data(), appType.size()));
+		if (eAppType == -1)
+			return false;
+
+		serial_.assign(serial.data(), serial.size());
+		boost::string_ref value = msg.GetBodyValue(EASY_TAG_NAME);
+		name_.assign(value.data(), value.size());
+		value = msg.GetBodyValue(EASY_TAG_TOKEN);
+		password_.assign(value.data(), value.size());
+		value = msg.GetBodyValue(EASY_TAG_TAG);
+		tag_.assign(value.data(), value.size());
+		value = msg.GetBodyValue(EASY_TAG_CHANNEL_COUNT);
+		channelCount_.assign(value.data(), value.size());
+
+		if (eAppType == EASY_APP_TYPE_NVR)
+		{
+			int channels = msg.Find(msg.Body(), EASY_TAG_CHANNELS);
+			if (!msg.IsArray(channels))
+				return true;
+
+			for (int i = msg.First(channels); i != msg.End(channels); i = msg.Next(i))
+			{
+				boost::string_ref channelRef = msg.GetString(msg.Find(i, EASY_TAG_CHANNEL));
+				boost::string_ref status = msg.GetString(msg.Find(i, EASY_TAG_STATUS));
+				string channel(channelRef.data(), channelRef.size());
+
+				//As above, only the status of a known channel changes
+				EasyDevices::iterator it = channels_.find(channel);
+				if (it != channels_.end())
+				{
+					it->second.status_.assign(status.data(), status.size());
+				}
+				else
+				{
+					boost::string_ref name = msg.GetString(msg.Find(i, EASY_TAG_NAME));
+					EasyDevice camera;
+					camera.name_.assign(name.data(), name.size());
+					camera.channel_ = channel;
+					camera.status_.assign(status.data(), status.size());
+					channels_[channel] = camera;
+				}
+			}
+		}
+		return true;
+	}
+
 	void strDevice::HoldSnapPath(const string& strJpgPath, const string& strChannel)//յʱ
 	{
 		if (EASY_APP_TYPE_CAMERA == eAppType)//ͷͣôֻһ·
@@ -342,6 +342,27 @@ namespace EasyDarwin { namespace Protocol
 		return -1;
 	}
 
+	int EasyProtocol::GetMsgType(const char* sMessageType, size_t len)
+	{
+		return FindValue(MsgTypeMap, sizeof(MsgTypeMap) / sizeof(MsgType), sMessageType, len);
+	}
+
+	int EasyProtocol::FindValue(const MsgType* map, size_t count, const char* str, size_t len)
+	{
+		if (str == NULL || len == 0)
+			return -1;
+
+		for (size_t i = 0; i < count; i++)
+		{
+			if (::strncmp(map[i].str, str, len) == 0 && map[i].str[len] == '\0')
+			{
+				return map[i].value;
+			}
+		}
+
+		return -1;
+	}
+
 	std::string EasyProtocol::GetDeviceStatusString(int status)
 	{
 		for (int i = 0; i < sizeof(StatusMap) / sizeof(MsgType); i++)
@@ -433,6 +454,11 @@ namespace EasyDarwin { namespace Protocol
 		return -1;
 	}
 
+	int EasyProtocol::GetTerminalType(const char* sTerminalType, size_t len)
+	{
+		return FindValue(TerminalTypeMap, sizeof(TerminalTypeMap) / sizeof(MsgType), sTerminalType, len);
+	}
+
 	std::string EasyProtocol::GetTerminalTypeString(int iTerminalType)
 	{
 		for (int i = 0; i < sizeof(TerminalTypeMap) / sizeof(MsgType); i++)
@@ -460,6 +486,11 @@ namespace EasyDarwin { namespace Protocol
 		return -1;
 	}
 
+	int EasyProtocol::GetAppType(const char* sAppType, size_t len)
+	{
+		return FindValue(AppTypeMap, sizeof(AppTypeMap) / sizeof(MsgType), sAppType, len);
+	}
+
 
 	std::string EasyProtocol::GetAppTypeString(int iAppType)
 	{
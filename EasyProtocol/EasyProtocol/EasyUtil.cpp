@@ -31,6 +31,12 @@
 #include <boost/archive/iterators/binary_from_base64.hpp>  
 #include <boost/archive/iterators/transform_width.hpp>
 
+//The SSSE3 base64 kernel is compiled for that target alone and picked at run time
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define EASY_BASE64_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
 std::string EasyUtil::TimeT2String(EasyDarwinTimeFormat whatFormat, unsigned long time)
 {
 	struct tm local;
@@ -239,6 +245,163 @@ string EasyUtil::Base64Encode(const string &sInput)
 	return result.str();
 }
 
+// 0-63 for the base64 alphabet, 0x40 for whitespace, 0x80 for everything else
+static unsigned char sBase64Values[256];
+
+static bool InitBase64Values()
+{
+	memset(sBase64Values, 0x80, sizeof(sBase64Values));
+	const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	for (int i = 0; i < 64; i++)
+	{
+		sBase64Values[(unsigned char)alphabet[i]] = (unsigned char)i;
+	}
+	sBase64Values[(unsigned char)' '] = 0x40;
+	sBase64Values[(unsigned char)'\t'] = 0x40;
+	sBase64Values[(unsigned char)'\r'] = 0x40;
+	sBase64Values[(unsigned char)'\n'] = 0x40;
+	return true;
+}
+
+static bool sBase64ValuesReady = InitBase64Values();
+
+#if defined(EASY_BASE64_SSSE3)
+// Decodes whole 16 character blocks from src to dst, 12 bytes each, and stops at the
+// first block holding anything outside the alphabet. dst may be src, each block is
+// loaded before its output is stored. Returns the number of characters consumed.
+// Only call it when sHasSSSE3 is set.
+__attribute__((target("ssse3")))
+static size_t Base64DecodeBlocks(const char* src, size_t len, char* dst)
+{
+	const __m128i lutLo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+	const __m128i lutHi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+	const __m128i lutRoll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+	const __m128i mask2F = _mm_set1_epi8(0x2F);
+	const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+
+	size_t done = 0;
+	while (len - done >= 16)
+	{
+		__m128i chars = _mm_loadu_si128((const __m128i*)(src + done));
+
+		//the nibble lookups classify each character, any bit they share marks a bad one
+		__m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask2F);
+		__m128i loNibbles = _mm_and_si128(chars, mask2F);
+		__m128i hi = _mm_shuffle_epi8(lutHi, hiNibbles);
+		__m128i lo = _mm_shuffle_epi8(lutLo, loNibbles);
+		if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0)
+			break;
+
+		//shift each character range onto its 6 bit value, '/' gets a range of its own
+		__m128i roll = _mm_shuffle_epi8(lutRoll, _mm_add_epi8(_mm_cmpeq_epi8(chars, mask2F), hiNibbles));
+		__m128i values = _mm_add_epi8(chars, roll);
+
+		//4 x 6 bits -> 3 bytes in each lane, then pack the lanes together
+		__m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+		merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+		_mm_storeu_si128((__m128i*)(dst + (done / 4) * 3), _mm_shuffle_epi8(merged, pack));
+
+		done += 16;
+	}
+	return done;
+}
+
+static bool CPUHasSSSE3()
+{
+	//static initializers may run before libgcc has probed the CPU
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3") != 0;
+}
+
+static bool sHasSSSE3 = CPUHasSSSE3();
+#endif
+
+bool EasyUtil::Base64DecodeInPlace(string &ioData)
+{
+	if (ioData.empty())
+	{
+		return true;
+	}
+
+	char* data = &ioData[0];
+	size_t len = ioData.size();
+	size_t in = 0;
+	size_t out = 0;
+
+#if defined(EASY_BASE64_SSSE3)
+	if (sHasSSSE3)
+	{
+		in = Base64DecodeBlocks(data, len, data);
+		out = (in / 4) * 3;
+	}
+#endif
+
+	//four characters at a time while there is no whitespace or padding
+	while (len - in >= 4)
+	{
+		unsigned char v0 = sBase64Values[(unsigned char)data[in]];
+		unsigned char v1 = sBase64Values[(unsigned char)data[in + 1]];
+		unsigned char v2 = sBase64Values[(unsigned char)data[in + 2]];
+		unsigned char v3 = sBase64Values[(unsigned char)data[in + 3]];
+		if ((v0 | v1 | v2 | v3) >= 64)
+			break;
+
+		unsigned int bits = (v0 << 18) | (v1 << 12) | (v2 << 6) | v3;
+		data[out] = (char)(bits >> 16);
+		data[out + 1] = (char)(bits >> 8);
+		data[out + 2] = (char)bits;
+		in += 4;
+		out += 3;
+	}
+
+	//the rest one character at a time, stopping at the padding
+	unsigned int bits = 0;
+	int count = 0;
+	for (; in < len; in++)
+	{
+		unsigned char v = sBase64Values[(unsigned char)data[in]];
+		if (v < 64)
+		{
+			bits = (bits << 6) | v;
+			if (++count == 4)
+			{
+				data[out] = (char)(bits >> 16);
+				data[out + 1] = (char)(bits >> 8);
+				data[out + 2] = (char)bits;
+				out += 3;
+				bits = 0;
+				count = 0;
+			}
+		}
+		else if (data[in] == '=')
+		{
+			break;
+		}
+		else if (v != 0x40)
+		{
+			return false;
+		}
+	}
+
+	if (count == 1)
+	{
+		return false;
+	}
+	if (count == 2)
+	{
+		data[out++] = (char)(bits >> 4);
+	}
+	else if (count == 3)
+	{
+		data[out] = (char)(bits >> 10);
+		data[out + 1] = (char)(bits >> 2);
+		out += 2;
+	}
+
+	ioData.resize(out);
+	return true;
+}
+
 string EasyUtil::Base64Decode(const string &sInput)
 {
 	typedef boost::archive::iterators::transform_width<boost::archive::iterators::binary_from_base64<string::const_iterator>, 8, 6> Base64DecodeIterator;
@@ -0,0 +1,297 @@
+/*
+	Copyright (c) 2013-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+	File:       ProtocolBench.cpp
+
+	Contains:   Measures the messages EasyCMS handles most, both ways: through
+				EasyProtocol (a Json::Value tree, written by StyledWriter) and
+				through EasyJsonReader and EasyMsgWriter.
+
+				- decoding an NVR's register request, which is also its keepalive
+				- encoding the register ack and a start stream request
+				- encoding the device list for [devices] devices
+
+				For each it reports the time and the heap allocations per message,
+				and checks that both ways produce the same JSON document.
+
+				usage: ProtocolBench [devices] [iterations]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <string>
+#include <vector>
+#include <chrono>
+
+#include <EasyProtocol.h>
+#include <EasyJsonReader.h>
+#include <EasyJsonWriter.h>
+
+using namespace EasyDarwin::Protocol;
+
+static unsigned long long sNumAllocs = 0;
+
+void* operator new(size_t size)
+{
+	sNumAllocs++;
+	void* p = ::malloc(size ? size : 1);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void operator delete(void* p) noexcept { ::free(p); }
+void operator delete(void* p, size_t) noexcept { ::free(p); }
+
+static const char* sRegisterREQ =
+	"{\n"
+	"   \"EasyDarwin\" : {\n"
+	"      \"Body\" : {\n"
+	"         \"Channels\" : [\n"
+	"            { \"Channel\" : \"1\", \"Name\" : \"Gate \\\"north\\\"\", \"Status\" : \"online\" },\n"
+	"            { \"Channel\" : \"2\", \"Name\" : \"Lobby\", \"Status\" : \"online\" },\n"
+	"            { \"Channel\" : \"3\", \"Name\" : \"Parking \\u8f66\\u5e93\", \"Status\" : \"offline\" },\n"
+	"            { \"Channel\" : \"4\", \"Name\" : \"Roof\", \"Status\" : \"online\" }\n"
+	"         ],\n"
+	"         \"Name\" : \"NVR-0017\",\n"
+	"         \"Serial\" : \"001002000017\",\n"
+	"         \"Tag\" : \"building-a\",\n"
+	"         \"Token\" : \"f0e1d2c3\"\n"
+	"      },\n"
+	"      \"Header\" : {\n"
+	"         \"AppType\" : \"EasyNVR\",\n"
+	"         \"CSeq\" : \"42\",\n"
+	"         \"MessageType\" : \"MSG_DS_REGISTER_REQ\",\n"
+	"         \"TerminalType\" : \"ARM_Linux\",\n"
+	"         \"Version\" : \"v1\"\n"
+	"      }\n"
+	"   }\n"
+	"}\n";
+
+class Timer
+{
+public:
+	Timer() : fStart(std::chrono::steady_clock::now()), fAllocs(sNumAllocs) {}
+
+	void Report(const char* name, int iterations)
+	{
+		double usec = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - fStart).count();
+		printf("  %-28s %10.2f usec/msg %10.1f allocs/msg\n", name, usec / iterations,
+			double(sNumAllocs - fAllocs) / iterations);
+	}
+
+private:
+	std::chrono::steady_clock::time_point fStart;
+	unsigned long long fAllocs;
+};
+
+static bool SameDocument(const std::string& a, const std::string& b)
+{
+	Json::Reader reader;
+	Json::Value va, vb;
+	return reader.parse(a, va) && reader.parse(b, vb) && va == vb;
+}
+
+static void Check(const char* what, bool ok)
+{
+	printf("  %-28s %s\n", what, ok ? "same" : "DIFFERENT");
+	if (!ok)
+		::exit(1);
+}
+
+static void BenchRegister(int iterations)
+{
+	printf("register request (decode)\n");
+
+	std::string json(sRegisterREQ);
+	strDevice device;
+	size_t sink = 0;
+	{
+		Timer t;
+		for (int i = 0; i < iterations; i++)
+		{
+			EasyProtocol req(json);
+			int type = req.GetMessageType();
+			device.GetDevInfo(json);
+			sink += type + req.GetHeaderValue(EASY_TAG_CSEQ).size();
+		}
+		t.Report("EasyProtocol", iterations);
+	}
+
+	strDevice device2;
+	EasyJsonReader reader;
+	{
+		Timer t;
+		for (int i = 0; i < iterations; i++)
+		{
+			reader.Parse(json.data(), json.size());
+			int type = reader.GetMessageType();
+			device2.GetDevInfo(reader);
+			sink += type + reader.GetHeaderValue(EASY_TAG_CSEQ).size();
+		}
+		t.Report("EasyJsonReader", iterations);
+	}
+
+	bool same = device.serial_ == device2.serial_ && device.name_ == device2.name_ && device.tag_ == device2.tag_
+		&& device.password_ == device2.password_ && device.eAppType == device2.eAppType
+		&& device.eDeviceType == device2.eDeviceType && device.channels_.size() == device2.channels_.size();
+	for (EasyDevices::iterator it = device.channels_.begin(); same && it != device.channels_.end(); ++it)
+	{
+		EasyDevice& other = device2.channels_[it->first];
+		same = other.name_ == it->second.name_ && other.status_ == it->second.status_;
+	}
+	Check("device info", same && sink != 0);
+}
+
+static void BenchAcks(int iterations)
+{
+	printf("register ack, start stream request (encode)\n");
+
+	std::string oldAck, oldPush;
+	{
+		Timer t;
+		for (int i = 0; i < iterations; i++)
+		{
+			EasyProtocolACK rsp(MSG_SD_REGISTER_ACK);
+			EasyJsonValue header, body;
+			header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
+			header[EASY_TAG_CSEQ] = "42";
+			header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
+			header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
+			body[EASY_TAG_SERIAL] = "001002000017";
+			rsp.SetHead(header);
+			rsp.SetBody(body);
+			oldAck = rsp.GetMsg();
+
+			EasyProtocolACK req(MSG_SD_PUSH_STREAM_REQ);
+			EasyJsonValue reqHeader, reqBody;
+			reqHeader[EASY_TAG_CSEQ] = "43";
+			reqHeader[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
+			reqBody[EASY_TAG_SERVER_IP] = "192.168.1.10";
+			reqBody[EASY_TAG_SERVER_PORT] = "10554";
+			reqBody[EASY_TAG_SERIAL] = "001002000017";
+			reqBody[EASY_TAG_CHANNEL] = "1";
+			reqBody[EASY_TAG_RESERVE] = "1";
+			reqBody[EASY_TAG_FROM] = "7b1f3a9e-client";
+			reqBody[EASY_TAG_TO] = "0c44d2aa-device";
+			reqBody[EASY_TAG_VIA] = "cms-node-1";
+			req.SetHead(reqHeader);
+			req.SetBody(reqBody);
+			oldPush = req.GetMsg();
+		}
+		t.Report("EasyProtocolACK", iterations);
+	}
+
+	std::string newAck, newPush;
+	{
+		Timer t;
+		for (int i = 0; i < iterations; i++)
+		{
+			newAck.clear();
+			EasyMsgWriter::SDRegisterACK(newAck, "42", "001002000017");
+			newPush.clear();
+			EasyMsgWriter::SDPushStreamREQ(newPush, "43", "192.168.1.10", "10554", "001002000017", "1", "1",
+				"7b1f3a9e-client", "0c44d2aa-device", "cms-node-1");
+		}
+		t.Report("EasyMsgWriter", iterations);
+	}
+
+	printf("  %-28s %10u bytes %10u bytes\n", "register ack size", (unsigned)oldAck.size(), (unsigned)newAck.size());
+	Check("register ack", SameDocument(oldAck, newAck));
+	Check("start stream request", SameDocument(oldPush, newPush));
+}
+
+static void BenchDeviceList(int numDevices, int iterations)
+{
+	printf("device list of %d devices (encode)\n", numDevices);
+
+	std::vector<strDevice> devices(numDevices);
+	for (int i = 0; i < numDevices; i++)
+	{
+		char serial[32];
+		::snprintf(serial, sizeof(serial), "0010020%05d", i);
+		devices[i].serial_ = serial;
+		devices[i].name_ = std::string("Camera ") + serial;
+		devices[i].tag_ = (i % 3 == 0) ? "building-a" : "";
+		devices[i].eAppType = (i % 4 == 0) ? EASY_APP_TYPE_NVR : EASY_APP_TYPE_CAMERA;
+		devices[i].eDeviceType = EASY_TERMINAL_TYPE_ARM;
+		devices[i].snapJpgPath_ = std::string("http://192.168.1.10:10008/snap/") + serial + "/1.jpg";
+	}
+
+	std::string oldList;
+	{
+		Timer t;
+		for (int n = 0; n < iterations; n++)
+		{
+			EasyProtocolACK rsp(MSG_SC_DEVICE_LIST_ACK);
+			EasyJsonValue header, body;
+			header[EASY_TAG_VERSION] = EASY_PROTOCOL_VERSION;
+			header[EASY_TAG_CSEQ] = 1;
+			header[EASY_TAG_ERROR_NUM] = EASY_ERROR_SUCCESS_OK;
+			header[EASY_TAG_ERROR_STRING] = EasyProtocol::GetErrorString(EASY_ERROR_SUCCESS_OK);
+
+			Json::Value* proot = rsp.GetRoot();
+			for (int i = 0; i < numDevices; i++)
+			{
+				Json::Value value;
+				value[EASY_TAG_SERIAL] = devices[i].serial_;
+				value[EASY_TAG_NAME] = devices[i].name_;
+				value[EASY_TAG_TAG] = devices[i].tag_;
+				value[EASY_TAG_APP_TYPE] = EasyProtocol::GetAppTypeString(devices[i].eAppType);
+				value[EASY_TAG_TERMINAL_TYPE] = EasyProtocol::GetTerminalTypeString(devices[i].eDeviceType);
+				if (devices[i].eAppType == EASY_APP_TYPE_CAMERA)
+					value[EASY_TAG_SNAP_URL] = devices[i].snapJpgPath_;
+				(*proot)[EASY_TAG_ROOT][EASY_TAG_BODY][EASY_TAG_DEVICES].append(value);
+			}
+			body[EASY_TAG_DEVICE_COUNT] = numDevices;
+
+			rsp.SetHead(header);
+			rsp.SetBody(body);
+			oldList = rsp.GetMsg();
+		}
+		t.Report("EasyProtocolACK", iterations);
+	}
+
+	std::string newList;
+	{
+		Timer t;
+		for (int n = 0; n < iterations; n++)
+		{
+			newList.clear();
+			EasyMsgWriter rsp(newList, MSG_SC_DEVICE_LIST_ACK, "1", EASY_ERROR_SUCCESS_OK);
+			rsp.StartBody();
+			rsp.StartArray(EASY_TAG_DEVICES);
+			for (int i = 0; i < numDevices; i++)
+				rsp.Device(devices[i]);
+			rsp.EndArray();
+			rsp.IntString(EASY_TAG_DEVICE_COUNT, numDevices);
+			rsp.Finish();
+		}
+		t.Report("EasyMsgWriter", iterations);
+	}
+
+	printf("  %-28s %10u bytes %10u bytes\n", "message size", (unsigned)oldList.size(), (unsigned)newList.size());
+	Check("device list", SameDocument(oldList, newList));
+}
+
+int main(int argc, char* argv[])
+{
+	int numDevices = (argc > 1) ? ::atoi(argv[1]) : 5000;
+	int iterations = (argc > 2) ? ::atoi(argv[2]) : 20000;
+	if (numDevices <= 0 || iterations <= 0)
+	{
+		printf("usage: %s [devices] [iterations]\n", argv[0]);
+		return 1;
+	}
+
+	BenchRegister(iterations);
+	BenchAcks(iterations);
+	BenchDeviceList(numDevices, (iterations / 1000) > 0 ? iterations / 1000 : 1);
+	return 0;
+}
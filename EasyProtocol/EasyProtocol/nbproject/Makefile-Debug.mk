@@ -35,6 +35,8 @@ OBJECTDIR=${CND_BUILDDIR}/${CND_CONF}/${CND_PLATFORM}
 
 # Object Files
 OBJECTFILES= \
+	${OBJECTDIR}/EasyJsonReader.o \
+	${OBJECTDIR}/EasyJsonWriter.o \
 	${OBJECTDIR}/EasyProtocol.o \
 	${OBJECTDIR}/EasyProtocolBase.o \
 	${OBJECTDIR}/EasyUtil.o
@@ -66,6 +68,16 @@ ${CND_CONF}/libEasyProtocol.a: ${OBJECTFILES}
 	${AR} -rv ${CND_CONF}/libEasyProtocol.a ${OBJECTFILES} 
 	$(RANLIB) ${CND_CONF}/libEasyProtocol.a
 
+${OBJECTDIR}/EasyJsonReader.o: EasyJsonReader.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -I../jsoncpp/include -I../Include -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/EasyJsonReader.o EasyJsonReader.cpp
+
+${OBJECTDIR}/EasyJsonWriter.o: EasyJsonWriter.cpp
+	${MKDIR} -p ${OBJECTDIR}
+	${RM} "$@.d"
+	$(COMPILE.cc) -g -I../jsoncpp/include -I../Include -MMD -MP -MF "$@.d" -o ${OBJECTDIR}/EasyJsonWriter.o EasyJsonWriter.cpp
+
 ${OBJECTDIR}/EasyProtocol.o: EasyProtocol.cpp
 	${MKDIR} -p ${OBJECTDIR}
 	${RM} "$@.d"
@@ -0,0 +1,98 @@
+/*
+	Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+ * File:   EasyJsonReader.h
+ *
+ * Reads a message in place. Parse() indexes the text into a flat table of
+ * tokens and the values come back as string_refs into the caller's buffer,
+ * so nothing is copied. The one exception is a string with escapes, which is
+ * decoded once into a buffer the reader keeps.
+ *
+ * The buffer must outlive the reader's use of it. One reader can be reused
+ * for every message on a connection, and after the first few it does not
+ * allocate.
+*/
+
+#ifndef EASY_JSON_READER_H
+#define	EASY_JSON_READER_H
+
+#include <EasyProtocolDef.h>
+#include <string>
+#include <vector>
+#include <boost/utility/string_ref.hpp>
+
+namespace EasyDarwin { namespace Protocol
+{
+	class Easy_API EasyJsonReader
+	{
+	public:
+		enum { kNone = -1 };
+
+		EasyJsonReader();
+		~EasyJsonReader() {}
+
+		// False if json is not one complete JSON value
+		bool Parse(const char* json, size_t len);
+
+		// Tokens are indexes; kNone stands for a missing value and is accepted everywhere
+		int Root() const { return tokens_.empty() ? kNone : 0; }
+		int Header() const { return header_; }
+		int Body() const { return body_; }
+
+		// The value of key in an object
+		int Find(int obj, const char* key) const;
+
+		// Elements of an array: for (int i = First(arr); i != End(arr); i = Next(i))
+		int First(int tok) const { return Size(tok) > 0 ? tok + 1 : End(tok); }
+		int Next(int tok) const { return tok == kNone ? kNone : tokens_[tok].next; }
+		int End(int tok) const { return tok == kNone ? kNone : tokens_[tok].next; }
+		int Size(int tok) const { return tok == kNone ? 0 : tokens_[tok].size; }
+
+		bool IsObject(int tok) const { return tok != kNone && tokens_[tok].type == kObject; }
+		bool IsArray(int tok) const { return tok != kNone && tokens_[tok].type == kArray; }
+
+		// A string's value, a number's text, or empty if tok is kNone
+		boost::string_ref GetString(int tok) const;
+
+		boost::string_ref GetHeaderValue(const char* tag) const { return GetString(Find(header_, tag)); }
+		boost::string_ref GetBodyValue(const char* tag) const { return GetString(Find(body_, tag)); }
+
+		// As EasyProtocol::GetMessageType, -1 if unknown
+		int GetMessageType() const;
+
+	private:
+		enum { kObject, kArray, kString, kPrimitive };
+		enum { kMaxDepth = 32 };
+
+		struct Token
+		{
+			int type;
+			bool escaped;		// start is in arena_, not the message
+			size_t start;
+			size_t len;
+			int next;			// the token after this value and everything in it
+			int size;			// members of an object, elements of an array
+		};
+
+		bool ParseValue(int depth);
+		bool ParseString();
+		bool ParsePrimitive();
+		bool Unescape(size_t start, size_t end);
+		void SkipSpace();
+
+		const char* json_;
+		size_t len_;
+		size_t pos_;
+		std::vector<Token> tokens_;
+		std::string arena_;
+		int header_;
+		int body_;
+	};
+
+}
+}//namespace
+#endif	/* EASY_JSON_READER_H */
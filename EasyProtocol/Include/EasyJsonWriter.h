@@ -0,0 +1,110 @@
+/*
+	Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+ * File:   EasyJsonWriter.h
+ *
+ * Writes compact JSON straight into the caller's string, for messages that
+ * are built once and sent. There is no Json::Value tree and no indentation,
+ * and members come out in the order they are written.
+ *
+ * EasyMsgWriter adds the EasyDarwin envelope and the typed encoders for the
+ * messages the CMS sends most.
+*/
+
+#ifndef EASY_JSON_WRITER_H
+#define	EASY_JSON_WRITER_H
+
+#include <EasyProtocolDef.h>
+#include <string>
+#include <boost/utility/string_ref.hpp>
+
+namespace EasyDarwin { namespace Protocol
+{
+	class strDevice;
+
+	class Easy_API EasyJsonWriter
+	{
+	public:
+		// Appends to ioOut, which the caller may clear and reuse for the next message
+		explicit EasyJsonWriter(std::string& ioOut);
+		~EasyJsonWriter() {}
+
+		// A NULL key starts an array element or the outermost value
+		void StartObject(const char* key = NULL);
+		void EndObject();
+		void StartArray(const char* key = NULL);
+		void EndArray();
+
+		void String(const char* key, boost::string_ref value);
+		void Int(const char* key, long long value);
+
+		// Numbers the protocol carries as strings, as EasyProtocol::SetBodyValue does
+		void IntString(const char* key, long long value);
+
+		// True once every object and array started has been ended
+		bool Done() const { return depth_ == 0; }
+
+	protected:
+		std::string& out_;
+
+	private:
+		void Key(const char* key);
+		void Open(char c);
+		void Close(char c);
+		void Escaped(boost::string_ref value);
+
+		enum { kMaxDepth = 32 };
+
+		int depth_;
+		bool first_[kMaxDepth];	// nothing written yet at this level
+	};
+
+	// {"EasyDarwin":{"Header":{...},"Body":{...}}}. The header carries
+	// Version, CSeq and MessageType, and ErrorNum/ErrorString for an ack.
+	class Easy_API EasyMsgWriter : public EasyJsonWriter
+	{
+	public:
+		EasyMsgWriter(std::string& ioOut, int msgType, boost::string_ref cseq);
+		EasyMsgWriter(std::string& ioOut, int msgType, boost::string_ref cseq, int error);
+		~EasyMsgWriter() {}
+
+		// Ends the header and starts the body
+		void StartBody();
+		// Ends the body and the envelope
+		void Finish();
+
+		// A Devices element of MSG_SC_DEVICE_LIST_ACK
+		void Device(const strDevice& device);
+
+	public:
+		// Complete messages, appended to out
+		static void SDRegisterACK(std::string& out, boost::string_ref cseq, boost::string_ref serial);
+
+		static void SDPushStreamREQ(std::string& out, boost::string_ref cseq, boost::string_ref serverIP, boost::string_ref serverPort,
+			boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve,
+			boost::string_ref from, boost::string_ref to, boost::string_ref via);
+
+		static void SDStopStreamREQ(std::string& out, boost::string_ref cseq, boost::string_ref serial, boost::string_ref channel,
+			boost::string_ref reserve, boost::string_ref protocol,
+			boost::string_ref from, boost::string_ref to, boost::string_ref via);
+
+		static void SCStartStreamACK(std::string& out, boost::string_ref cseq, int error, boost::string_ref service,
+			boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve);
+
+		static void SCStopStreamACK(std::string& out, boost::string_ref cseq,
+			boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve);
+
+		static void SCFreeStreamACK(std::string& out, boost::string_ref cseq,
+			boost::string_ref serial, boost::string_ref channel, boost::string_ref reserve, boost::string_ref protocol);
+
+	private:
+		void StartHeader(int msgType, boost::string_ref cseq);
+	};
+
+}
+}//namespace
+#endif	/* EASY_JSON_WRITER_H */
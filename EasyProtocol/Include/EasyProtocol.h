@@ -8,6 +8,7 @@
 #define	EASY_PROTOCOL_H
 
 #include <EasyProtocolBase.h>
+#include <EasyJsonReader.h>
 #include <map>
 #include <boost/variant.hpp>
 #include <boost/lexical_cast.hpp>
@@ -330,7 +331,7 @@ namespace EasyDarwin { namespace Protocol
 	class EasyDarwinRTSPSession
 	{
 	public:
-		EasyDarwinRTSPSession() : index(0), channel(0), numOutputs(0)
+		EasyDarwinRTSPSession() : index(0), channel(0), numOutputs(0), bitrate(0), packetMemory(0), copyRate(0), gopCacheHits(0), gopCacheMisses(0), firstFrameMSec(0)
 		{
 		}
 
@@ -342,6 +343,12 @@ namespace EasyDarwin { namespace Protocol
 		std::string Name;
 		int channel;
 		int numOutputs;
+		unsigned int bitrate;
+		unsigned int packetMemory;	// bytes of reflector packet buffers
+		unsigned int copyRate;		// bytes per second copied into them
+		unsigned int gopCacheHits;	// players that started with the GOP cache
+		unsigned int gopCacheMisses;	// players that had to wait for a key frame
+		unsigned int firstFrameMSec;	// average PLAY to first frame of the hits
 	};
 
 	// MSG_SC_START_HLS_ACK
@@ -470,7 +477,8 @@ namespace EasyDarwin { namespace Protocol
 	{
 	public:
 		strDevice();
-		bool GetDevInfo(const string& msg);//JSONıõ豸Ϣ
+		bool GetDevInfo(const string& msg);
+		bool GetDevInfo(const EasyJsonReader& msg);//the same, from a message already parsed//JSONıõ豸Ϣ
 		void HoldSnapPath(const string& strJpgPath, const string& strChannel);//յ·
 	public:
 		string serial_;//豸к
@@ -83,6 +83,8 @@ namespace EasyDarwin { namespace Protocol
 
 		static std::string GetMsgTypeString(int type);
 		static int GetMsgType(const std::string& sMessageType);
+		//For a value that has not been copied out of the message, see EasyJsonReader
+		static int GetMsgType(const char* sMessageType, size_t len);
 
 		//enum EasyDarwinDeviceStatus
 		static std::string GetDeviceStatusString(int status);
@@ -102,10 +104,12 @@ namespace EasyDarwin { namespace Protocol
 
 		//enum EasyDarwinTerminalType
 		static int GetTerminalType(const std::string& sTerminalType);
+		static int GetTerminalType(const char* sTerminalType, size_t len);
 		static std::string GetTerminalTypeString(int iTerminalType);
 
 		//enum EasyDarwinAppType
 		static int GetAppType(const std::string& sAppType);
+		static int GetAppType(const char* sAppType, size_t len);
 		static std::string GetAppTypeString(int iAppType);
 
 		//enum EasyDarwinSnapType
@@ -159,6 +163,8 @@ namespace EasyDarwin { namespace Protocol
 		static MsgType TalkbackAudioTypeMap[];
 		static MsgType TalkbackCMDTypeMap[];
 
+		static int FindValue(const MsgType* map, size_t count, const char* str, size_t len);
+
 		Json::Reader reader;
 		Json::StyledWriter writer;//or StyledWriter FastWriter
 
@@ -127,6 +127,29 @@
 #define EASY_TAG_SESSION_COUNT							"SessionCount"
 #define EASY_TAG_RECORDS								"Records"
 #define	EASY_TAG_NUM_OUTPUTS							"NumOutputs"
+#define	EASY_TAG_PACKET_MEMORY							"PacketMemory"
+#define	EASY_TAG_COPY_RATE								"CopyRate"
+#define	EASY_TAG_GOP_CACHE_HITS							"GOPCacheHits"
+#define	EASY_TAG_GOP_CACHE_MISSES						"GOPCacheMisses"
+#define	EASY_TAG_FIRST_FRAME_MSEC						"FirstFrameMSec"
+#define	EASY_TAG_FILE_CACHE_HIT_PERCENT					"FileCacheHitPercent"
+#define	EASY_TAG_FILE_CACHE_BYTES_SAVED					"FileCacheBytesSaved"
+#define	EASY_TAG_FILE_CACHE_EVICTIONS					"FileCacheEvictions"
+#define	EASY_TAG_MOVIE_CACHE_HIT_PERCENT				"MovieCacheHitPercent"
+#define	EASY_TAG_MOVIE_CACHE_AVG_OPEN_MSEC				"MovieCacheAvgOpenMsec"
+#define	EASY_TAG_PAGE_SIZE								"PageSize"
+#define	EASY_TAG_L_PAGE_NUM								"pagenum"
+#define	EASY_TAG_L_PAGE_SIZE							"pagesize"
+#define	EASY_TAG_CATALOG_VERSION						"CatalogVersion"
+#define	EASY_TAG_SNAP_QUEUE_DEPTH						"SnapQueueDepth"
+#define	EASY_TAG_SNAP_QUEUE_MAX_DEPTH					"SnapQueueMaxDepth"
+#define	EASY_TAG_SNAP_WRITTEN							"SnapWritten"
+#define	EASY_TAG_SNAP_FAILED							"SnapFailed"
+#define	EASY_TAG_SNAP_SUPERSEDED						"SnapSuperseded"
+#define	EASY_TAG_SNAP_DROPPED							"SnapDropped"
+#define	EASY_TAG_SNAP_AVG_WRITE_MSEC					"SnapAvgWriteMSec"
+#define	EASY_TAG_SNAP_MAX_WRITE_MSEC					"SnapMaxWriteMSec"
+#define	EASY_TAG_SNAP_AVG_DELAY_MSEC					"SnapAvgDelayMSec"
 #define EASY_TAG_ACTION_TYPE                            "ActionType"
 #define EASY_TAG_L_ACTION_TYPE                          "actiontype"
 #define EASY_TAG_SPEED                                  "Speed"
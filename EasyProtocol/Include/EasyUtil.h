@@ -65,6 +65,11 @@ public:
 	static string Base64Encode(const string &sInput);
 	static string Base64Decode(const string &sInput);
 
+	//Decodes ioData over itself and shrinks it to the decoded bytes. Whitespace is
+	//skipped. Returns false, leaving ioData undefined, if it is not base64.
+	//On x86 CPUs with SSSE3 it decodes 16 characters per step.
+	static bool Base64DecodeInPlace(string &ioData);
+
 	static void DelChar(std::string &sInput, char ch);//删除字符串中的某个特定字符 
 
 	static unsigned char* Urldecode(unsigned char* encd, unsigned char* decd);
@@ -0,0 +1,122 @@
+/*
+	Copyright (c) 2012-2016 EasyDarwin.ORG.  All rights reserved.
+	Github: https://github.com/EasyDarwin
+	WEChat: EasyDarwin
+	Website: http://www.easydarwin.org
+*/
+/*
+ * File:   EasyRedisEventAdapter.h
+ *
+ * Runs a hiredis redisAsyncContext on the server's EventContext/Task model,
+ * the way the adapters shipped with hiredis do for other event libraries.
+ *
+ * The socket readiness reported by the EventThread only signals the owning
+ * Task. The context itself is only ever touched from that Task's Run: it
+ * calls HandleEvents() there, after issuing its commands, and hiredis does
+ * the reads, writes and reply callbacks on that thread.
+ *
+ * Header only, so EasyRedisClient itself does not depend on CommonUtilitiesLib.
+ */
+
+#ifndef EASYREDISEVENTADAPTER_H
+#define	EASYREDISEVENTADAPTER_H
+
+#include <unistd.h>
+
+#include "EventContext.h"
+#include "atomic.h"
+#include "async.h"
+
+class EasyRedisEventContext : public EventContext
+{
+public:
+
+	// Hooks ac's event callbacks to a new context that signals inTask.
+	// Returns NULL, leaving ac alone, if it cannot be attached.
+	static EasyRedisEventContext* Attach(redisAsyncContext* ac, Task* inTask)
+	{
+		if ((ac == NULL) || (ac->ev.data != NULL))
+			return NULL;
+
+		// EventContext closes its fd on Cleanup, and so does hiredis when
+		// the context is freed. Watch a dup of the socket instead.
+		int theFD = ::dup(ac->c.fd);
+		if (theFD < 0)
+			return NULL;
+
+		EasyRedisEventContext* theContext = new EasyRedisEventContext(ac, theFD, inTask);
+		ac->ev.data = theContext;
+		ac->ev.addRead = AddRead;
+		ac->ev.delRead = DelRead;
+		ac->ev.addWrite = AddWrite;
+		ac->ev.delWrite = DelWrite;
+		ac->ev.cleanup = Detach;
+		return theContext;
+	}
+
+	virtual ~EasyRedisEventContext() {}
+
+	// False once hiredis has freed the context; the owner may then delete this
+	bool IsAttached() const { return fAC != NULL; }
+
+	// Call from the owning Task's Run. Reads and writes whatever the socket
+	// was ready for, flushes commands issued since, and re-arms the socket.
+	void HandleEvents()
+	{
+		unsigned int theFired = 0;
+		do
+		{
+			theFired = fFired;
+		} while (!compare_and_store(theFired, 0, &fFired));
+
+		if ((fAC != NULL) && (theFired & EV_RE))
+			redisAsyncHandleRead(fAC);
+
+		// A connected socket is nearly always writable, so pipelined commands
+		// go out now rather than after another trip through the EventThread
+		if ((fAC != NULL) && (fWanted & EV_WR) && ((theFired & EV_WR) || (fAC->c.flags & REDIS_CONNECTED)))
+			redisAsyncHandleWrite(fAC);
+
+		if ((fAC != NULL) && (fWanted != 0))
+			this->RequestEvent(fWanted);
+	}
+
+protected:
+
+	virtual void ProcessEvent(int eventBits)
+	{
+		(void)atomic_or(&fFired, (unsigned int)(eventBits & (EV_RE | EV_WR)));
+		if (fOwner != NULL)
+			fOwner->Signal(Task::kReadEvent);
+	}
+
+private:
+
+	EasyRedisEventContext(redisAsyncContext* ac, int inFileDesc, Task* inTask)
+		: EventContext(EventContext::kInvalidFileDesc), fAC(ac), fOwner(inTask), fWanted(0), fFired(0)
+	{
+		this->InitNonBlocking(inFileDesc);
+		this->SetTask(inTask);
+	}
+
+	// The hooks only record what hiredis wants, HandleEvents arms the socket
+	static void AddRead(void* privdata) { static_cast<EasyRedisEventContext*>(privdata)->fWanted |= EV_RE; }
+	static void DelRead(void* privdata) { static_cast<EasyRedisEventContext*>(privdata)->fWanted &= ~EV_RE; }
+	static void AddWrite(void* privdata) { static_cast<EasyRedisEventContext*>(privdata)->fWanted |= EV_WR; }
+	static void DelWrite(void* privdata) { static_cast<EasyRedisEventContext*>(privdata)->fWanted &= ~EV_WR; }
+
+	static void Detach(void* privdata)
+	{
+		EasyRedisEventContext* theContext = static_cast<EasyRedisEventContext*>(privdata);
+		theContext->fAC = NULL;
+		theContext->fWanted = 0;
+		theContext->Cleanup();
+	}
+
+	redisAsyncContext*  fAC;
+	Task*               fOwner;
+	int                 fWanted;    // EV_RE | EV_WR, as hiredis asked for them
+	unsigned int        fFired;     // set by the EventThread, taken by HandleEvents
+};
+
+#endif	/* EASYREDISEVENTADAPTER_H */